@@ -85,6 +85,96 @@
 #define MAX_RT_MESSAGE_SIZE 256
 #endif 
 
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Pre-trigger burst capture
+//
+//  ENABLE_BURST_CAPTURE: Stream LSM6DSO accelerometer samples through the sensor FIFO into a
+//  circular buffer.  When a trigger fires, the buffer is frozen once BURST_DEFAULT_POST_SAMPLES
+//  have been captured after the trigger, and the pre/post trigger waveform is uploaded as a
+//  sequence of burst telemetry messages.
+//
+//  Triggers (device twin "burstTriggerMask", OR the bits together)
+//    1: Acceleration magnitude deviates from 1g by more than "burstThresholdG"
+//    2: LSM6DSO wake-up event, also uses "burstThresholdG"
+//    4: Pressure changes by more than "burstPressureDeltaHpa" between sensor reads
+//    The "burstTrigger" device twin and the "triggerBurst" direct method always trigger a capture
+//
+//  The capture rate ("burstOdrHz") and the pre/post trigger sample counts ("burstPreSamples",
+//  "burstPostSamples") can be changed from the device twin.  Pre + post samples must fit in
+//  BURST_MAX_SAMPLES.
+//
+//  Note: Pressure is read through the LSM6DSO sensor hub, which stops the accelerometer for the
+//  duration of each read.  Pressure reads are skipped while post trigger samples are being
+//  captured, but pre trigger data may include a short gap per sensor read period.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+//#define ENABLE_BURST_CAPTURE
+
+#ifdef ENABLE_BURST_CAPTURE
+
+#ifndef IOT_HUB_APPLICATION
+#error "ENABLE_BURST_CAPTURE uploads bursts as telemetry, enable IOT_HUB_APPLICATION"
+#endif
+
+// Circular buffer size in samples, each sample uses 6 bytes
+#define BURST_MAX_SAMPLES 1024
+
+// Samples per burst telemetry message
+#define BURST_UPLOAD_CHUNK_SAMPLES 64
+
+// How often the FIFO is drained, the FIFO must not wrap between drains at the highest rate
+#define BURST_DRAIN_PERIOD_MS 100
+
+#define BURST_DEFAULT_ODR_HZ 208
+#define BURST_DEFAULT_PRE_SAMPLES 256
+#define BURST_DEFAULT_POST_SAMPLES 256
+#define BURST_DEFAULT_TRIGGER_MASK 0x03
+#define BURST_DEFAULT_THRESHOLD_G 0.5f
+#define BURST_DEFAULT_PRESSURE_DELTA_HPA 1.0f
+#endif 
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  On-device motion classifier
+//
+//  ENABLE_MOTION_CLASSIFIER: Classify the board's motion (idle, moving, vibrating, tilted) on the
+//  device.  The LSM6DSO accelerometer and gyro are sampled every MOTION_SAMPLE_PERIOD_MS into a
+//  window of MOTION_WINDOW_SAMPLES.  Every MOTION_HOP_SAMPLES the window features are computed
+//  and classified by a small int8 decision tree, see motion_model.h.
+//
+//  The tree is loaded from MOTION_MODEL_FILE in the image package, so a retrained model only
+//  needs a new image.  The model in models/ was trained on synthetic traces with motion_bench
+//  (AvnetDefaultProject/HostTools).  For a real installation, record labelled data with
+//  MOTION_LOG_SAMPLES and retrain with motion_bench --train.
+//
+//  With a model loaded the telemetry message carries "motionState" and "motionConfidence" in
+//  place of the raw accelerometer and gyro readings, and each state change is sent as a
+//  "motionEvent" telemetry message.  A new state is only reported after it wins
+//  "motionConfirmWindows" windows in a row (device twin).  Without a model the raw readings are
+//  sent as before.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+//#define ENABLE_MOTION_CLASSIFIER
+
+#ifdef ENABLE_MOTION_CLASSIFIER
+
+#define MOTION_MODEL_FILE "models/motion_model.bin"
+
+// 25 Hz samples, 2 second windows classified every second
+#define MOTION_SAMPLE_PERIOD_MS 40
+#define MOTION_WINDOW_SAMPLES 50
+#define MOTION_HOP_SAMPLES 25
+
+#define MOTION_DEFAULT_CONFIRM_WINDOWS 2
+#define MOTION_MAX_CONFIRM_WINDOWS 10
+
+// Log every sample as "MOTION,ax,ay,az,gx,gy,gz" to record training data from the debug output
+//#define MOTION_LOG_SAMPLES
+#endif 
+
 //////////////////////////////////////////////////////////////////////////////////////////////////
 //
 //  Default timer values
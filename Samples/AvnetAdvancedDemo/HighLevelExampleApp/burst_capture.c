@@ -0,0 +1,416 @@
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+/*
+Pre-trigger burst capture
+
+    The LSM6DSO FIFO runs in stream mode at burstConfig.odrHz.  Every BURST_DRAIN_PERIOD_MS the
+    FIFO is drained into a circular buffer that always holds the most recent BURST_MAX_SAMPLES
+    accelerometer samples.
+
+    When a trigger fires the samples already in the buffer become the pre trigger history, the
+    next burstConfig.postSamples samples are captured, and the buffer is frozen.  The frozen burst
+    is uploaded one BURST_UPLOAD_CHUNK_SAMPLES message per drain period once the device is
+    connected, then the buffer is re-armed.
+
+    Each burst message contains
+        burstId, burstChunk, burstChunks: identifies the burst and the message within the burst
+        burstTrigger: the trigger source
+        burstTime: UTC time (seconds) the trigger fired
+        burstOdrHz: sample rate
+        burstFirstSample: index of the first sample in this message relative to the trigger,
+                          negative indexes are pre trigger samples
+        burstX, burstY, burstZ: acceleration in mg
+*/
+
+#include "burst_capture.h"
+
+#ifdef ENABLE_BURST_CAPTURE
+
+#include <math.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <applibs/log.h>
+#include "eventloop_timer_utilities.h"
+#include "i2c.h"
+
+#ifdef USE_IOT_CONNECT
+#include "iotConnect.h"
+#endif
+
+extern volatile sig_atomic_t exitCode;
+extern void SendTelemetry(const char *jsonMessage, bool appendIoTConnectHeader);
+extern bool IsConnectionReadyToSendTelemetry(void);
+extern bool IsIoTHubAuthenticated(void);
+
+// Samples pulled from the FIFO per lp_fifo_read() call
+#define BURST_FIFO_BATCH 128
+
+// Worst case message size: the header plus three arrays of "-2000," entries
+#define BURST_JSON_BUFFER_SIZE (256 + (BURST_UPLOAD_CHUNK_SAMPLES * 3 * 7))
+
+typedef enum {
+    BURST_STATE_ARMED = 0,
+    BURST_STATE_POST_TRIGGER = 1,
+    BURST_STATE_UPLOAD = 2
+} burstState_t;
+
+static const char *burstSourceNames[] = {"threshold", "wakeUp", "pressure", "twin", "directMethod"};
+
+burstConfig_t burstConfig = {.odrHz = BURST_DEFAULT_ODR_HZ,
+                             .preSamples = BURST_DEFAULT_PRE_SAMPLES,
+                             .postSamples = BURST_DEFAULT_POST_SAMPLES,
+                             .triggerMask = BURST_DEFAULT_TRIGGER_MASK,
+                             .thresholdG = BURST_DEFAULT_THRESHOLD_G,
+                             .pressureDeltaHpa = BURST_DEFAULT_PRESSURE_DELTA_HPA};
+
+// Backs the "burstTrigger" device twin
+bool burstTriggerRequested = false;
+
+static EventLoopTimer *burstDrainTimer = NULL;
+static bool fifoRunning = false;
+static burstState_t burstState = BURST_STATE_ARMED;
+
+// The circular capture buffer, raw LSM6DSO counts at 2g full scale
+static int16_t burstRing[BURST_MAX_SAMPLES][3];
+static int16_t fifoBatch[BURST_FIFO_BATCH][3];
+static int ringHead = 0;
+static int ringCount = 0;
+static int postRemaining = 0;
+
+// The burst being captured or uploaded
+static unsigned int burstId = 0;
+static burstSource_t recordSource;
+static time_t recordTime;
+static int recordOdrHz;
+static int recordPre;
+static int recordStart;
+static int recordLength;
+static int recordChunk;
+
+static unsigned int missedTriggers = 0;
+static unsigned int fifoOverruns = 0;
+static float lastPressure = NAN;
+
+static void BurstDrainTimerEventHandler(EventLoopTimer *timer);
+
+/// <summary>
+///     Drop the capture history and start collecting pre trigger samples again
+/// </summary>
+static void burstRearm(void)
+{
+    ringHead = 0;
+    ringCount = 0;
+    postRemaining = 0;
+    burstState = BURST_STATE_ARMED;
+}
+
+/// <summary>
+///     Post trigger capture is complete, mark the pre + post samples for upload
+/// </summary>
+static void burstFreeze(void)
+{
+    recordLength = recordPre + burstConfig.postSamples;
+    recordStart = (ringHead - recordLength + BURST_MAX_SAMPLES) % BURST_MAX_SAMPLES;
+    recordChunk = 0;
+    burstState = BURST_STATE_UPLOAD;
+
+    Log_Debug("Burst %u captured: %d pre, %d post samples\n", burstId, recordPre,
+              burstConfig.postSamples);
+}
+
+bool burst_Trigger(burstSource_t source)
+{
+    if (!fifoRunning || (burstState != BURST_STATE_ARMED)) {
+        missedTriggers++;
+        return false;
+    }
+
+    burstId++;
+    recordSource = source;
+    recordTime = time(NULL);
+    recordOdrHz = burstConfig.odrHz;
+    recordPre = (ringCount < burstConfig.preSamples) ? ringCount : burstConfig.preSamples;
+    postRemaining = burstConfig.postSamples;
+    burstState = BURST_STATE_POST_TRIGGER;
+
+    Log_Debug("Burst %u triggered by %s\n", burstId, burstSourceNames[source]);
+
+    if (postRemaining == 0) {
+        burstFreeze();
+    }
+    return true;
+}
+
+/// <summary>
+///     Returns true if the sample deviates from 1g by more than the configured threshold
+/// </summary>
+static bool burstOverThreshold(const int16_t *sample)
+{
+    float x = lsm6dso_from_fs2_to_mg(sample[0]) / 1000.0f;
+    float y = lsm6dso_from_fs2_to_mg(sample[1]) / 1000.0f;
+    float z = lsm6dso_from_fs2_to_mg(sample[2]) / 1000.0f;
+
+    return fabsf(sqrtf(x * x + y * y + z * z) - 1.0f) > burstConfig.thresholdG;
+}
+
+/// <summary>
+///     Add one sample to the circular buffer, checking the threshold trigger first so that the
+///     triggering sample is the first post trigger sample
+/// </summary>
+static void burstAddSample(const int16_t *sample)
+{
+    // Incoming samples are dropped while a frozen burst waits to be uploaded
+    if (burstState == BURST_STATE_UPLOAD) {
+        return;
+    }
+
+    if ((burstState == BURST_STATE_ARMED) && (burstConfig.triggerMask & BURST_TRIGGER_THRESHOLD) &&
+        (burstConfig.thresholdG > 0.0f) && burstOverThreshold(sample)) {
+        burst_Trigger(BURST_SOURCE_THRESHOLD);
+    }
+
+    memcpy(burstRing[ringHead], sample, sizeof(burstRing[0]));
+    ringHead = (ringHead + 1) % BURST_MAX_SAMPLES;
+    if (ringCount < BURST_MAX_SAMPLES) {
+        ringCount++;
+    }
+
+    if (burstState == BURST_STATE_POST_TRIGGER) {
+        if (--postRemaining == 0) {
+            burstFreeze();
+        }
+    }
+}
+
+/// <summary>
+///     Append ',' separated mg values for one axis of the samples in this chunk
+/// </summary>
+static int burstAppendAxis(char *buffer, size_t bufferSize, int offset, int first, int count,
+                           int axis)
+{
+    for (int i = 0; (i < count) && (offset < (int)bufferSize); i++) {
+        int index = (recordStart + first + i) % BURST_MAX_SAMPLES;
+        offset += snprintf(&buffer[offset], bufferSize - (size_t)offset, "%s%d", (i == 0) ? "" : ",",
+                           (int)lroundf(lsm6dso_from_fs2_to_mg(burstRing[index][axis])));
+    }
+    return offset;
+}
+
+/// <summary>
+///     Send the next chunk of the frozen burst, re-arm once the last chunk is sent
+/// </summary>
+static void burstUploadChunk(void)
+{
+    if (!IsIoTHubAuthenticated() || !IsConnectionReadyToSendTelemetry()) {
+        return;
+    }
+#ifdef USE_IOT_CONNECT
+    if (!IoTCConnected) {
+        return;
+    }
+#endif
+
+    int chunks = (recordLength + BURST_UPLOAD_CHUNK_SAMPLES - 1) / BURST_UPLOAD_CHUNK_SAMPLES;
+    int first = recordChunk * BURST_UPLOAD_CHUNK_SAMPLES;
+    int count = recordLength - first;
+    if (count > BURST_UPLOAD_CHUNK_SAMPLES) {
+        count = BURST_UPLOAD_CHUNK_SAMPLES;
+    }
+
+    char *pjsonBuffer = (char *)malloc(BURST_JSON_BUFFER_SIZE);
+    if (pjsonBuffer == NULL) {
+        Log_Debug("ERROR: not enough memory to send burst telemetry\n");
+        return;
+    }
+
+    int offset = snprintf(pjsonBuffer, BURST_JSON_BUFFER_SIZE,
+                          "{\"burstId\":%u,\"burstChunk\":%d,\"burstChunks\":%d,\"burstTrigger\":\"%s\","
+                          "\"burstTime\":%lld,\"burstOdrHz\":%d,\"burstFirstSample\":%d,\"burstX\":[",
+                          burstId, recordChunk, chunks, burstSourceNames[recordSource],
+                          (long long)recordTime, recordOdrHz, first - recordPre);
+    offset = burstAppendAxis(pjsonBuffer, BURST_JSON_BUFFER_SIZE, offset, first, count, 0);
+    offset += snprintf(&pjsonBuffer[offset], BURST_JSON_BUFFER_SIZE - (size_t)offset, "],\"burstY\":[");
+    offset = burstAppendAxis(pjsonBuffer, BURST_JSON_BUFFER_SIZE, offset, first, count, 1);
+    offset += snprintf(&pjsonBuffer[offset], BURST_JSON_BUFFER_SIZE - (size_t)offset, "],\"burstZ\":[");
+    offset = burstAppendAxis(pjsonBuffer, BURST_JSON_BUFFER_SIZE, offset, first, count, 2);
+    offset += snprintf(&pjsonBuffer[offset], BURST_JSON_BUFFER_SIZE - (size_t)offset, "]}");
+
+    if (offset < BURST_JSON_BUFFER_SIZE) {
+        SendTelemetry(pjsonBuffer, true);
+    } else {
+        Log_Debug("ERROR: burst chunk does not fit in %d bytes\n", BURST_JSON_BUFFER_SIZE);
+    }
+    free(pjsonBuffer);
+
+    if (++recordChunk >= chunks) {
+        Log_Debug("Burst %u uploaded in %d messages\n", burstId, chunks);
+        burstRearm();
+    }
+}
+
+/// <summary>
+///     Burst timer event:  Drain the FIFO, check the triggers and upload frozen bursts
+/// </summary>
+static void BurstDrainTimerEventHandler(EventLoopTimer *timer)
+{
+    bool overrun = false;
+    int count;
+
+    if (ConsumeEventLoopTimerEvent(timer) != 0) {
+        exitCode = ExitCode_BurstCaptureTimer_Consume;
+        return;
+    }
+
+    if (!fifoRunning) {
+        return;
+    }
+
+    // The wake-up event is latched, checking it also clears it
+    if (lp_fifo_wakeup_pending() && (burstConfig.triggerMask & BURST_TRIGGER_WAKE_UP)) {
+        burst_Trigger(BURST_SOURCE_WAKE_UP);
+    }
+
+    do {
+        count = lp_fifo_read(fifoBatch, BURST_FIFO_BATCH, &overrun);
+        if (overrun) {
+            fifoOverruns++;
+        }
+        for (int i = 0; i < count; i++) {
+            burstAddSample(fifoBatch[i]);
+        }
+    } while (count == BURST_FIFO_BATCH);
+
+    if (burstState == BURST_STATE_UPLOAD) {
+        burstUploadChunk();
+    }
+}
+
+/// <summary>
+///     Start the FIFO with the current configuration
+/// </summary>
+static void burstStartFifo(void)
+{
+    float wakeUpThresholdG = (burstConfig.triggerMask & BURST_TRIGGER_WAKE_UP) ? burstConfig.thresholdG : 0.0f;
+
+    fifoRunning = lp_fifo_start(burstConfig.odrHz, wakeUpThresholdG);
+    if (!fifoRunning) {
+        Log_Debug("Burst capture disabled, the LSM6DSO FIFO could not be started\n");
+    }
+}
+
+bool burst_ApplyConfig(const burstConfig_t *newConfig)
+{
+    if (!lp_fifo_rate_supported(newConfig->odrHz) || (newConfig->preSamples < 0) ||
+        (newConfig->postSamples < 1) ||
+        (newConfig->preSamples + newConfig->postSamples > BURST_MAX_SAMPLES) ||
+        (newConfig->triggerMask & ~BURST_TRIGGER_ALL) || (newConfig->thresholdG < 0.0f) ||
+        (newConfig->pressureDeltaHpa < 0.0f)) {
+        return false;
+    }
+
+    bool restartFifo = (newConfig->odrHz != burstConfig.odrHz) ||
+                       (newConfig->thresholdG != burstConfig.thresholdG) ||
+                       (newConfig->triggerMask != burstConfig.triggerMask);
+
+    // Samples collected under the old settings can't be mixed with new ones
+    if ((burstState == BURST_STATE_POST_TRIGGER) &&
+        (restartFifo || (newConfig->postSamples != burstConfig.postSamples))) {
+        Log_Debug("Burst %u dropped, capture settings changed\n", burstId);
+        burstRearm();
+    }
+
+    burstConfig = *newConfig;
+
+    if (restartFifo && (burstDrainTimer != NULL)) {
+        if (burstState == BURST_STATE_ARMED) {
+            burstRearm();
+        }
+        burstStartFifo();
+    }
+    return true;
+}
+
+void burst_PressureSample(float pressure)
+{
+    if (isnan(pressure)) {
+        return;
+    }
+
+    // lp_get_pressure() returns hPa / 1000
+    if (!isnan(lastPressure) && (burstConfig.triggerMask & BURST_TRIGGER_PRESSURE) &&
+        (fabsf(pressure - lastPressure) * 1000.0f > burstConfig.pressureDeltaHpa)) {
+        burst_Trigger(BURST_SOURCE_PRESSURE);
+    }
+    lastPressure = pressure;
+}
+
+bool burst_HoldSensorHub(void)
+{
+    return (burstState == BURST_STATE_POST_TRIGGER);
+}
+
+void burst_GetStatus(burstStatus_t *status)
+{
+    status->burstId = burstId;
+    status->armed = fifoRunning && (burstState == BURST_STATE_ARMED);
+    status->missedTriggers = missedTriggers;
+    status->fifoOverruns = fifoOverruns;
+}
+
+ExitCode burst_Init(EventLoop *el)
+{
+    static const struct timespec drainPeriod = {.tv_sec = 0,
+                                                .tv_nsec = BURST_DRAIN_PERIOD_MS * 1000 * 1000};
+
+    burstDrainTimer = CreateEventLoopPeriodicTimer(el, &BurstDrainTimerEventHandler, &drainPeriod);
+    if (burstDrainTimer == NULL) {
+        return ExitCode_Init_BurstCaptureTimer;
+    }
+
+    burstRearm();
+    burstStartFifo();
+
+    return ExitCode_Success;
+}
+
+void burst_Cleanup(void)
+{
+    DisposeEventLoopTimer(burstDrainTimer);
+    burstDrainTimer = NULL;
+
+    if (fifoRunning) {
+        lp_fifo_stop();
+        fifoRunning = false;
+    }
+}
+
+#endif // ENABLE_BURST_CAPTURE
@@ -0,0 +1,104 @@
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#ifndef C_BURST_CAPTURE_H
+#define C_BURST_CAPTURE_H
+
+#include <stdbool.h>
+#include <applibs/eventloop.h>
+#include "build_options.h"
+#include "exit_codes.h"
+
+#ifdef ENABLE_BURST_CAPTURE
+
+// Trigger mask bits, see build_options.h
+#define BURST_TRIGGER_THRESHOLD 0x01
+#define BURST_TRIGGER_WAKE_UP 0x02
+#define BURST_TRIGGER_PRESSURE 0x04
+#define BURST_TRIGGER_ALL (BURST_TRIGGER_THRESHOLD | BURST_TRIGGER_WAKE_UP | BURST_TRIGGER_PRESSURE)
+
+typedef enum {
+    BURST_SOURCE_THRESHOLD = 0,
+    BURST_SOURCE_WAKE_UP = 1,
+    BURST_SOURCE_PRESSURE = 2,
+    BURST_SOURCE_TWIN = 3,
+    BURST_SOURCE_DIRECT_METHOD = 4
+} burstSource_t;
+
+// Capture settings, each field is exposed as a device twin
+typedef struct {
+    int odrHz;
+    int preSamples;
+    int postSamples;
+    int triggerMask;
+    float thresholdG;
+    float pressureDeltaHpa;
+} burstConfig_t;
+
+typedef struct {
+    unsigned int burstId;
+    bool armed;
+    unsigned int missedTriggers;
+    unsigned int fifoOverruns;
+} burstStatus_t;
+
+extern burstConfig_t burstConfig;
+extern bool burstTriggerRequested;
+
+ExitCode burst_Init(EventLoop *el);
+void burst_Cleanup(void);
+
+/// <summary>
+///     Validate newConfig and make it the active configuration.  Changing the rate or the
+///     threshold restarts the FIFO and drops any capture that is collecting post trigger samples.
+/// </summary>
+/// <returns>false if any setting is out of range, burstConfig is left unchanged</returns>
+bool burst_ApplyConfig(const burstConfig_t *newConfig);
+
+/// <summary>
+///     Freeze the capture buffer around the current sample.  Returns false if a previous burst is
+///     still being captured or uploaded.
+/// </summary>
+bool burst_Trigger(burstSource_t source);
+
+/// <summary>
+///     Feed each periodic pressure reading to the pressure delta trigger
+/// </summary>
+void burst_PressureSample(float pressure);
+
+/// <summary>
+///     Returns true while post trigger samples are being captured.  Sensor hub reads stop the
+///     accelerometer, so the caller should skip them while this is set.
+/// </summary>
+bool burst_HoldSensorHub(void);
+
+void burst_GetStatus(burstStatus_t *status);
+
+#endif // ENABLE_BURST_CAPTURE
+
+#endif // C_BURST_CAPTURE_H
@@ -58,6 +58,8 @@ SOFTWARE.
 #include "exit_codes.h"
 #include "build_options.h"
 #include "m4_support.h"
+#include "burst_capture.h"
+#include "motion_classifier.h"
 
 // Constants
 #define JSON_BUFFER_SIZE 1024
@@ -141,6 +143,17 @@ void setRealTimeTelemetryInterval(void* thisTwinPtr, JSON_Object *desiredPropert
 // Custom handler for poll timer
 void setTelemetryTimerFunction(void* thisTwinPtr, JSON_Object *desiredProperties);
 
+#ifdef ENABLE_BURST_CAPTURE
+// Custom handlers for the burst capture settings and the burst trigger
+void setBurstConfigFunction(void* thisTwinPtr, JSON_Object *desiredProperties);
+void setBurstTriggerFunction(void* thisTwinPtr, JSON_Object *desiredProperties);
+#endif 
+
+#ifdef ENABLE_MOTION_CLASSIFIER
+// Custom handler for the motion classifier's confirm window count
+void setMotionConfirmWindowsFunction(void* thisTwinPtr, JSON_Object *desiredProperties);
+#endif 
+
 #define NO_GPIO_ASSOCIATED_WITH_TWIN -1
 
 #endif // C_DEVICE_TWIN_H
\ No newline at end of file
@@ -78,6 +78,18 @@ twin_t twinArray[] = {
 #ifdef M4_INTERCORE_COMMS    
     {.twinKey = "realTimeAutoTelemetryPeriod",.twinVar = &realTimeAutoTelemetryInterval,.twinFd = NULL,.twinGPIO = NO_GPIO_ASSOCIATED_WITH_TWIN,.twinType = TYPE_INT,.active_high = true,.twinHandler = (setRealTimeTelemetryInterval)},
 #endif     
+#ifdef ENABLE_BURST_CAPTURE
+    {.twinKey = "burstOdrHz",.twinVar = &burstConfig.odrHz,.twinFd = NULL,.twinGPIO = NO_GPIO_ASSOCIATED_WITH_TWIN,.twinType = TYPE_INT,.active_high = true,.twinHandler = (setBurstConfigFunction)},
+    {.twinKey = "burstPreSamples",.twinVar = &burstConfig.preSamples,.twinFd = NULL,.twinGPIO = NO_GPIO_ASSOCIATED_WITH_TWIN,.twinType = TYPE_INT,.active_high = true,.twinHandler = (setBurstConfigFunction)},
+    {.twinKey = "burstPostSamples",.twinVar = &burstConfig.postSamples,.twinFd = NULL,.twinGPIO = NO_GPIO_ASSOCIATED_WITH_TWIN,.twinType = TYPE_INT,.active_high = true,.twinHandler = (setBurstConfigFunction)},
+    {.twinKey = "burstTriggerMask",.twinVar = &burstConfig.triggerMask,.twinFd = NULL,.twinGPIO = NO_GPIO_ASSOCIATED_WITH_TWIN,.twinType = TYPE_INT,.active_high = true,.twinHandler = (setBurstConfigFunction)},
+    {.twinKey = "burstThresholdG",.twinVar = &burstConfig.thresholdG,.twinFd = NULL,.twinGPIO = NO_GPIO_ASSOCIATED_WITH_TWIN,.twinType = TYPE_FLOAT,.active_high = true,.twinHandler = (setBurstConfigFunction)},
+    {.twinKey = "burstPressureDeltaHpa",.twinVar = &burstConfig.pressureDeltaHpa,.twinFd = NULL,.twinGPIO = NO_GPIO_ASSOCIATED_WITH_TWIN,.twinType = TYPE_FLOAT,.active_high = true,.twinHandler = (setBurstConfigFunction)},
+    {.twinKey = "burstTrigger",.twinVar = &burstTriggerRequested,.twinFd = NULL,.twinGPIO = NO_GPIO_ASSOCIATED_WITH_TWIN,.twinType = TYPE_BOOL,.active_high = true,.twinHandler = (setBurstTriggerFunction)},
+#endif 
+#ifdef ENABLE_MOTION_CLASSIFIER
+    {.twinKey = "motionConfirmWindows",.twinVar = &motionConfirmWindows,.twinFd = NULL,.twinGPIO = NO_GPIO_ASSOCIATED_WITH_TWIN,.twinType = TYPE_INT,.active_high = true,.twinHandler = (setMotionConfirmWindowsFunction)},
+#endif 
     {.twinKey = "telemetryPeriod",.twinVar = &sendTelemetryPeriod,.twinFd = NULL,.twinGPIO = NO_GPIO_ASSOCIATED_WITH_TWIN,.twinType = TYPE_INT,.active_high = true,.twinHandler = (setTelemetryTimerFunction)}
 };
 
@@ -576,3 +588,81 @@ void setTelemetryTimerFunction(void* thisTwinPtr, JSON_Object *desiredProperties
     checkAndUpdateDeviceTwin(localTwinPtr->twinKey, localTwinPtr->twinVar, TYPE_INT, true, true);
 }
 
+#ifdef ENABLE_BURST_CAPTURE
+///<summary>
+///		Handler for the burst capture settings.  The twin variable is a field in burstConfig, so
+///     apply the new value to a copy and let burst_ApplyConfig() validate the whole configuration
+///</summary>
+void setBurstConfigFunction(void* thisTwinPtr, JSON_Object *desiredProperties){
+
+    // Declare a local variable to point to the deviceTwin table entry and cast the incomming void* to a twin_t*
+    twin_t *localTwinPtr = (twin_t*)thisTwinPtr;
+
+    burstConfig_t newConfig = burstConfig;
+    void *newValue = (char *)&newConfig + ((char *)localTwinPtr->twinVar - (char *)&burstConfig);
+
+    // Read the new value
+    if (localTwinPtr->twinType == TYPE_FLOAT) {
+        *(float *)newValue = (float)json_object_get_number(desiredProperties, localTwinPtr->twinKey);
+    }
+    else {
+        *(int *)newValue = (int)json_object_get_number(desiredProperties, localTwinPtr->twinKey);
+    }
+
+    if (!burst_ApplyConfig(&newConfig)) {
+
+        // The data is out of range, report the current value back with a failure status
+        Log_Debug("Received invalid device update for key %s.\n", localTwinPtr->twinKey);
+        checkAndUpdateDeviceTwin(localTwinPtr->twinKey, localTwinPtr->twinVar, localTwinPtr->twinType, true, false);
+        return;
+    }
+
+    // Send the reported property to the IoTHub
+    Log_Debug("Received device update for %s\n", localTwinPtr->twinKey);
+    checkAndUpdateDeviceTwin(localTwinPtr->twinKey, localTwinPtr->twinVar, localTwinPtr->twinType, true, true);
+}
+
+///<summary>
+///		Handler for the burstTrigger twin.  Setting it to true captures a burst, the reported
+///     property is always cleared so the twin can be used again.
+///</summary>
+void setBurstTriggerFunction(void* thisTwinPtr, JSON_Object *desiredProperties){
+
+    // Declare a local variable to point to the deviceTwin table entry and cast the incomming void* to a twin_t*
+    twin_t *localTwinPtr = (twin_t*)thisTwinPtr;
+    bool triggered = true;
+
+    if (json_object_get_boolean(desiredProperties, localTwinPtr->twinKey) == 1) {
+        triggered = burst_Trigger(BURST_SOURCE_TWIN);
+        Log_Debug("Received burst trigger, %s\n", triggered ? "capturing" : "capture already in progress");
+    }
+
+    *(bool *)localTwinPtr->twinVar = false;
+    checkAndUpdateDeviceTwin(localTwinPtr->twinKey, localTwinPtr->twinVar, TYPE_BOOL, true, triggered);
+}
+#endif // ENABLE_BURST_CAPTURE
+
+#ifdef ENABLE_MOTION_CLASSIFIER
+///<summary>
+///		Handler for motionConfirmWindows, the number of windows in a row a new motion state must
+///     win before it is reported
+///</summary>
+void setMotionConfirmWindowsFunction(void* thisTwinPtr, JSON_Object *desiredProperties){
+
+    // Declare a local variable to point to the deviceTwin table entry and cast the incomming void* to a twin_t*
+    twin_t *localTwinPtr = (twin_t*)thisTwinPtr;
+
+    int newValue = (int)json_object_get_number(desiredProperties, localTwinPtr->twinKey);
+    if ((newValue < 1) || (newValue > MOTION_MAX_CONFIRM_WINDOWS)) {
+
+        // The data is out of range, report the current value back with a failure status
+        Log_Debug("Received invalid device update for key %s.\n", localTwinPtr->twinKey);
+        checkAndUpdateDeviceTwin(localTwinPtr->twinKey, localTwinPtr->twinVar, TYPE_INT, true, false);
+        return;
+    }
+
+    *(int *)localTwinPtr->twinVar = newValue;
+    Log_Debug("Received device update. New %s is %d\n", localTwinPtr->twinKey, newValue);
+    checkAndUpdateDeviceTwin(localTwinPtr->twinKey, localTwinPtr->twinVar, TYPE_INT, true, true);
+}
+#endif // ENABLE_MOTION_CLASSIFIER
@@ -43,6 +43,7 @@ Direct Method implementation for Azure Sphere
 
 #include "direct_methods.h"
 #include "exit_codes.h"
+#include "burst_capture.h"
 
 #ifdef IOT_HUB_APPLICATION
 
@@ -57,6 +58,9 @@ Direct Method implementation for Azure Sphere
 // .dmCleanup - The handler that will be called at application exit time, NULL if not required
 direct_method_t dmArray[] = {
     {.dmName = "rebootDevice",.dmPayloadRequired=false,.dmInit=NULL,.dmHandler=dmRebootHandlerFunction,.dmCleanup=dmRebootCleanupFunction},
+#ifdef ENABLE_BURST_CAPTURE
+    {.dmName = "triggerBurst",.dmPayloadRequired=false,.dmInit=NULL,.dmHandler=dmTriggerBurstHandlerFunction,.dmCleanup=NULL},
+#endif 
 };
 
 // Calculate how many twin_t items are in the array.  We use this to iterate through the structure.
@@ -343,4 +347,39 @@ void dmRebootCleanupFunction(void){
     DisposeEventLoopTimer(rebootDeviceTimer);
 }
 
+#ifdef ENABLE_BURST_CAPTURE
+//////////////////////////////////////////////////////////////////////////////////////
+//
+//  Functions for triggerBurst directMethod
+//
+//  name: triggerBurst
+//  Payload: None
+//
+//////////////////////////////////////////////////////////////////////////////////////
+
+// The dmHandler takes the payload to process and returns a pointer to a response message on the heap
+int dmTriggerBurstHandlerFunction(JSON_Object *JsonPayloadObj, size_t payloadSize, char** responseMsg){
+
+    bool triggered = burst_Trigger(BURST_SOURCE_DIRECT_METHOD);
+
+    burstStatus_t status;
+    burst_GetStatus(&status);
+
+	// Construct the response message.  This will be displayed in the cloud when calling the direct method
+	static const char burstResponse[] = "{ \"success\" : %s, \"burstId\" : %u, \"missedTriggers\" : %u, \"fifoOverruns\" : %u}";
+    size_t mallocSize = sizeof(burstResponse) + 32;  // Add 32 to cover the values inserted into the response string
+	*responseMsg = (char *)malloc(mallocSize); 
+
+    if (*responseMsg == NULL) {
+	    exitCode = ExitCode_DirectMethodResponse_Malloc_failed;
+		return 400;
+	}
+
+    snprintf(*responseMsg, mallocSize, burstResponse, triggered ? "true" : "false", status.burstId,
+             status.missedTriggers, status.fifoOverruns);
+
+	return 200;
+}
+#endif // ENABLE_BURST_CAPTURE
+
 #endif 
\ No newline at end of file
@@ -110,5 +110,14 @@ int dmTelemetryHandlerFunction(JSON_Object *JsonPayloadObj, size_t payloadSize,
 void dmRebootCleanupFunction(void);
 void RebootDeviceEventHandler(EventLoopTimer*);
 
+#ifdef ENABLE_BURST_CAPTURE
+//////////////////////////////////////////////////////////////////////////////////////
+//
+//  Functions for triggerBurst directMethod
+//
+//////////////////////////////////////////////////////////////////////////////////////
+int dmTriggerBurstHandlerFunction(JSON_Object *JsonPayloadObj, size_t payloadSize, char** responsePayload);
+#endif 
+
 
 #endif 
\ No newline at end of file
@@ -87,6 +87,15 @@ typedef enum {
 
     ExitCode_Init_LocationFromIPTimer = 55,
 
+    ExitCode_Init_DpsPnPTimer = 56,
+    ExitCode_DpsPnPTimer_Consume = 57,
+
+    ExitCode_Init_BurstCaptureTimer = 58,
+    ExitCode_BurstCaptureTimer_Consume = 59,
+
+    ExitCode_Init_MotionTimer = 60,
+    ExitCode_MotionTimer_Consume = 61,
+
 } ExitCode;
 
 #endif 
\ No newline at end of file
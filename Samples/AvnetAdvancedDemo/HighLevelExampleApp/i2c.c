@@ -95,6 +95,10 @@ static stmdev_ctx_t pressure_ctx;
 static bool initialized = false;
 bool lps22hhDetected = false;
 
+// The accelerometer ODR restored after each sensor hub transaction.  The burst capture
+// logic raises this so that the FIFO keeps filling at the capture rate.
+static lsm6dso_odr_xl_t xlActiveOdr = LSM6DSO_XL_ODR_104Hz;
+
 // Global variables to hold the most recent sensor data
 AccelerationgForce acceleration_g;
 AngularRateDegreesPerSecond angular_rate_dps;
@@ -667,7 +671,7 @@ static int32_t lsm6dso_read_lps22hh_cx(void *ctx, uint8_t reg, uint8_t *data, ui
     lsm6dso_sh_master_set(&dev_ctx, PROPERTY_ENABLE);
 
     /* Enable accelerometer to trigger Sensor Hub operation. */
-    lsm6dso_xl_data_rate_set(&dev_ctx, LSM6DSO_XL_ODR_104Hz);
+    lsm6dso_xl_data_rate_set(&dev_ctx, xlActiveOdr);
 
     /* Wait Sensor Hub operation flag set. */
     lsm6dso_acceleration_raw_get(&dev_ctx, buf_raw);
@@ -697,7 +701,226 @@ static int32_t lsm6dso_read_lps22hh_cx(void *ctx, uint8_t reg, uint8_t *data, ui
 #endif
 
     /* Re-enable accelerometer */
-    lsm6dso_xl_data_rate_set(&dev_ctx, LSM6DSO_XL_ODR_104Hz);
+    lsm6dso_xl_data_rate_set(&dev_ctx, xlActiveOdr);
 
     return ret;
-}
\ No newline at end of file
+}
+
+#ifdef ENABLE_BURST_CAPTURE
+
+// Each FIFO word is a tag byte followed by six data bytes
+#define FIFO_WORD_SIZE 7
+
+// Maximum number of FIFO words to pull from the device in one I2C transaction.  FIFO_DATA_OUT
+// rolls over from 0x7E back to 0x78, so consecutive words can be read in a single burst.
+#define FIFO_READ_WORDS 32
+
+// Wake-up threshold LSb with LSM6DSO_LSb_FS_DIV_64 and a 2g full scale
+#define WAKE_UP_THRESHOLD_LSB_G (2.0f / 64.0f)
+
+typedef struct {
+    int odrHz;
+    lsm6dso_odr_xl_t xlOdr;
+    lsm6dso_bdr_xl_t xlBatchRate;
+} fifoRate_t;
+
+// Supported capture rates.  Rates above 833Hz would need a faster I2C bus to keep up.
+static const fifoRate_t fifoRates[] = {
+    {26, LSM6DSO_XL_ODR_26Hz, LSM6DSO_XL_BATCHED_AT_26Hz},
+    {52, LSM6DSO_XL_ODR_52Hz, LSM6DSO_XL_BATCHED_AT_52Hz},
+    {104, LSM6DSO_XL_ODR_104Hz, LSM6DSO_XL_BATCHED_AT_104Hz},
+    {208, LSM6DSO_XL_ODR_208Hz, LSM6DSO_XL_BATCHED_AT_208Hz},
+    {416, LSM6DSO_XL_ODR_417Hz, LSM6DSO_XL_BATCHED_AT_417Hz},
+    {833, LSM6DSO_XL_ODR_833Hz, LSM6DSO_XL_BATCHED_AT_833Hz},
+};
+
+/// <summary>
+///     Returns true if odrHz is one of the rates lp_fifo_start() accepts
+/// </summary>
+bool lp_fifo_rate_supported(int odrHz)
+{
+    for (size_t i = 0; i < sizeof(fifoRates) / sizeof(fifoRate_t); i++) {
+        if (fifoRates[i].odrHz == odrHz) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/// <summary>
+///     Start batching accelerometer samples into the LSM6DSO FIFO at odrHz in stream mode, so
+///     the FIFO always holds the most recent samples.  If wakeUpThresholdG is greater than zero
+///     the wake-up detector is armed and latched so lp_fifo_wakeup_pending() can poll it.
+/// </summary>
+bool lp_fifo_start(int odrHz, float wakeUpThresholdG)
+{
+    const fifoRate_t *rate = NULL;
+
+    if (!initialized) {
+        return false;
+    }
+
+    for (size_t i = 0; i < sizeof(fifoRates) / sizeof(fifoRate_t); i++) {
+        if (fifoRates[i].odrHz == odrHz) {
+            rate = &fifoRates[i];
+        }
+    }
+
+    if (rate == NULL) {
+        Log_Debug("LSM6DSO: Unsupported FIFO rate %d Hz\n", odrHz);
+        return false;
+    }
+
+    // Flush anything left over from a previous configuration
+    lsm6dso_fifo_mode_set(&dev_ctx, LSM6DSO_BYPASS_MODE);
+
+    // Run the accelerometer at the capture rate, and keep it there across sensor hub reads
+    xlActiveOdr = rate->xlOdr;
+    lsm6dso_xl_data_rate_set(&dev_ctx, xlActiveOdr);
+
+    // Only the accelerometer is batched, the gyro stays on the periodic read path
+    lsm6dso_fifo_xl_batch_set(&dev_ctx, rate->xlBatchRate);
+    lsm6dso_fifo_gy_batch_set(&dev_ctx, LSM6DSO_GY_NOT_BATCHED);
+    lsm6dso_fifo_mode_set(&dev_ctx, LSM6DSO_STREAM_MODE);
+
+    // Configure the wake-up detector.  The event is latched until WAKE_UP_SRC is read.
+    lsm6dso_pin_int1_route_t int1Route;
+    memset(&int1Route, 0x00, sizeof(int1Route));
+
+    if (wakeUpThresholdG > 0.0f) {
+
+        int threshold = (int)(wakeUpThresholdG / WAKE_UP_THRESHOLD_LSB_G);
+        if (threshold < 1) {
+            threshold = 1;
+        } else if (threshold > 63) {
+            threshold = 63;
+        }
+
+        lsm6dso_wkup_ths_weight_set(&dev_ctx, LSM6DSO_LSb_FS_DIV_64);
+        lsm6dso_wkup_threshold_set(&dev_ctx, (uint8_t)threshold);
+        lsm6dso_wkup_dur_set(&dev_ctx, 0);
+        lsm6dso_int_notification_set(&dev_ctx, LSM6DSO_BASE_LATCHED_EMB_PULSED);
+
+        // Routing the event also sets INTERRUPTS_ENABLE, which the detector needs to run
+        int1Route.wake_up = PROPERTY_ENABLE;
+    }
+    lsm6dso_pin_int1_route_set(&dev_ctx, int1Route);
+
+    Log_Debug("LSM6DSO: FIFO streaming at %d Hz, wake-up threshold %.3f g\n", odrHz,
+              wakeUpThresholdG);
+    return true;
+}
+
+/// <summary>
+///     Stop batching into the FIFO and restore the default accelerometer rate
+/// </summary>
+void lp_fifo_stop(void)
+{
+    if (!initialized) {
+        return;
+    }
+
+    lsm6dso_pin_int1_route_t int1Route;
+    memset(&int1Route, 0x00, sizeof(int1Route));
+    lsm6dso_pin_int1_route_set(&dev_ctx, int1Route);
+
+    lsm6dso_fifo_xl_batch_set(&dev_ctx, LSM6DSO_XL_NOT_BATCHED);
+    lsm6dso_fifo_mode_set(&dev_ctx, LSM6DSO_BYPASS_MODE);
+
+    xlActiveOdr = LSM6DSO_XL_ODR_104Hz;
+    lsm6dso_xl_data_rate_set(&dev_ctx, xlActiveOdr);
+}
+
+/// <summary>
+///     Drain up to maxSamples raw accelerometer samples from the FIFO, oldest first.
+///     *overrun is set if the FIFO wrapped since the last call, meaning samples were lost.
+/// </summary>
+/// <returns>The number of samples written to samples[], or -1 if the device is not available</returns>
+int lp_fifo_read(int16_t (*samples)[3], int maxSamples, bool *overrun)
+{
+    uint8_t fifoWords[FIFO_READ_WORDS * FIFO_WORD_SIZE];
+    axis3bit16_t rawSample;
+    uint16_t level = 0;
+    uint8_t ovr = 0;
+    int count = 0;
+
+    if (!initialized) {
+        return -1;
+    }
+
+    lsm6dso_fifo_ovr_flag_get(&dev_ctx, &ovr);
+    *overrun = (ovr != 0);
+
+    lsm6dso_fifo_data_level_get(&dev_ctx, &level);
+
+    while ((level > 0) && (count < maxSamples)) {
+
+        uint16_t words = level;
+        if (words > FIFO_READ_WORDS) {
+            words = FIFO_READ_WORDS;
+        }
+        if (words > (uint16_t)(maxSamples - count)) {
+            words = (uint16_t)(maxSamples - count);
+        }
+
+        lsm6dso_read_reg(&dev_ctx, LSM6DSO_FIFO_DATA_OUT_TAG, fifoWords,
+                         (uint16_t)(words * FIFO_WORD_SIZE));
+
+        for (uint16_t i = 0; i < words; i++) {
+
+            uint8_t *word = &fifoWords[i * FIFO_WORD_SIZE];
+
+            // The sensor tag lives in the upper five bits of the tag byte
+            if ((word[0] >> 3) != LSM6DSO_XL_NC_TAG) {
+                continue;
+            }
+
+            memcpy(rawSample.u8bit, &word[1], sizeof(rawSample.u8bit));
+            samples[count][0] = rawSample.i16bit[0];
+            samples[count][1] = rawSample.i16bit[1];
+            samples[count][2] = rawSample.i16bit[2];
+            count++;
+        }
+
+        level = (uint16_t)(level - words);
+    }
+
+    return count;
+}
+
+/// <summary>
+///     Returns true if the wake-up detector fired since the last call.  Reading WAKE_UP_SRC
+///     clears the latched event.
+/// </summary>
+bool lp_fifo_wakeup_pending(void)
+{
+    lsm6dso_wake_up_src_t wakeUpSrc;
+
+    if (!initialized) {
+        return false;
+    }
+
+    memset(&wakeUpSrc, 0x00, sizeof(wakeUpSrc));
+    lsm6dso_read_reg(&dev_ctx, LSM6DSO_WAKE_UP_SRC, (uint8_t *)&wakeUpSrc, 1);
+
+    return (wakeUpSrc.wu_ia != 0);
+}
+
+#endif // ENABLE_BURST_CAPTURE
+
+#ifdef ENABLE_MOTION_CLASSIFIER
+/// <summary>
+///     Run the gyro and accelerometer fast enough for the motion classifier's sample rate.
+///     lp_imu_initialize() leaves both at 12.5Hz, the accelerometer only moves to its active rate
+///     after the first sensor hub read.
+/// </summary>
+void lp_motion_rates_set(void)
+{
+    if (!initialized) {
+        return;
+    }
+
+    lsm6dso_gy_data_rate_set(&dev_ctx, LSM6DSO_GY_ODR_52Hz);
+    lsm6dso_xl_data_rate_set(&dev_ctx, xlActiveOdr);
+}
+#endif // ENABLE_MOTION_CLASSIFIER
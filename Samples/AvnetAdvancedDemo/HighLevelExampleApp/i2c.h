@@ -45,3 +45,15 @@ float lp_get_temperature_lps22h(void); // get_temperature() from lsm6dso is fast
 void lp_calibrate_angular_rate(void);
 AngularRateDegreesPerSecond lp_get_angular_rate(void);
 AccelerationgForce lp_get_acceleration(void);
+
+#ifdef ENABLE_BURST_CAPTURE
+bool lp_fifo_rate_supported(int odrHz);
+bool lp_fifo_start(int odrHz, float wakeUpThresholdG);
+void lp_fifo_stop(void);
+int lp_fifo_read(int16_t (*samples)[3], int maxSamples, bool *overrun);
+bool lp_fifo_wakeup_pending(void);
+#endif
+
+#ifdef ENABLE_MOTION_CLASSIFIER
+void lp_motion_rates_set(void);
+#endif
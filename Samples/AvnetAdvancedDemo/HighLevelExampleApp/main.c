@@ -32,6 +32,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "build_options.h"
@@ -82,6 +83,9 @@
 #include "m4_support.h"
 #endif 
 
+#include "burst_capture.h"
+#include "motion_classifier.h"
+
 // The following #include imports a "sample appliance" definition. This app comes with multiple
 // implementations of the sample appliance, each in a separate directory, which allow the code to
 // run on different hardware.
@@ -113,6 +117,23 @@
 #define dpsUrl "global.azure-devices-provisioning.net"
 static PROV_DEVICE_RESULT dpsRegisterStatus = PROV_DEVICE_REG_HUB_NOT_SPECIFIED;
 static char* iotHubUri = NULL;
+
+// DPS provisioning is driven from the event loop.  dpsPnPWorkTimer calls Prov_Device_LL_DoWork()
+// every DPS_PNP_WORK_PERIOD_MS until the registration callback fires, dpsPnPTimeoutTimer gives up
+// after DPS_PNP_TIMEOUT_SECONDS.
+#define DPS_PNP_WORK_PERIOD_MS 25
+#define DPS_PNP_TIMEOUT_SECONDS 60
+static PROV_DEVICE_LL_HANDLE dpsPnPProvHandle = NULL;
+static bool dpsPnPSecurityInitialized = false;
+static bool dpsRegisterCompleted = false;
+static EventLoopTimer *dpsPnPWorkTimer = NULL;
+static EventLoopTimer *dpsPnPTimeoutTimer = NULL;
+
+// Provisioning stall measurements.  The longest single Prov_Device_LL_DoWork() call is the longest
+// the event loop is held off while provisioning, it's logged when provisioning finishes.
+static struct timespec dpsPnPStartTime;
+static long dpsPnPMaxDoWorkUs = 0;
+static unsigned int dpsPnPDoWorkCalls = 0;
 #endif 
 volatile sig_atomic_t exitCode = ExitCode_Success;
 
@@ -188,9 +209,15 @@ static void ParseCommandLineArguments(int argc, char *argv[]);
 static bool SetUpAzureIoTHubClientWithDaa(void);
 static bool SetUpAzureIoTHubClientWithDps(void);
 #ifdef USE_PNP
-static bool ProvisionWithDpsPnP(void);
+static bool StartProvisionWithDpsPnP(void);
+static void DpsPnPWorkTimerEventHandler(EventLoopTimer *timer);
+static void DpsPnPTimeoutTimerEventHandler(EventLoopTimer *timer);
+static void CompleteProvisionWithDpsPnP(void);
+static void CleanupProvisionWithDpsPnP(void);
 #endif
+static void FinishAzureIoTHubClientSetup(bool isClientSetupSuccessful);
 bool IsConnectionReadyToSendTelemetry(void);
+bool IsIoTHubAuthenticated(void);
 static ExitCode ReadIoTEdgeCaCertContent(void);
 #endif // IOT_HUB_APPLICATION
 // Initialization/Cleanup
@@ -551,10 +578,19 @@ static void ReadSensorTimerEventHandler(EventLoopTimer *timer)
     lsm6dso_temperature = lp_get_temperature();
     Log_Debug("LSM6DSO: Temperature1 [degC]: %.2f\n", lsm6dso_temperature);
 
+#ifdef ENABLE_BURST_CAPTURE
+    // Reading the LPS22HH stops the accelerometer, don't leave a gap in a burst being captured
+  	if (lps22hhDetected && !burst_HoldSensorHub()) {
+#else
   	if (lps22hhDetected) {
+#endif 
 
         pressure_kPa = lp_get_pressure();
         lps22hh_temperature = lp_get_temperature_lps22h();
+
+#ifdef ENABLE_BURST_CAPTURE
+        burst_PressureSample(pressure_kPa);
+#endif 
     
 		Log_Debug("LPS22HH: Pressure     [kPa] : %.2f\n", pressure_kPa);
         Log_Debug("LPS22HH: Temperature2 [degC]: %.2f\n", lps22hh_temperature);
@@ -654,6 +690,15 @@ static void SendTelemetryTimerEventHandler(EventLoopTimer *timer)
                     Log_Debug("ERROR: not enough memory to send telemetry\n");
             }
 
+#ifdef ENABLE_MOTION_CLASSIFIER
+            // The classifier replaces the raw accelerometer and gyro readings with its state
+            if (motion_ModelLoaded()) {
+                snprintf(pjsonBuffer, JSON_BUFFER_SIZE,
+                    "{\"motionState\":\"%s\", \"motionConfidence\":%.2f, \"pressure\": %.2f, "
+                    "\"rssi\": %d}",
+                    motion_StateName(), motion_Confidence(), pressure_kPa, network_data.rssi);
+            } else
+#endif 
             snprintf(pjsonBuffer, JSON_BUFFER_SIZE,
                 "{\"gX\":%.2lf, \"gY\":%.2lf, \"gZ\":%.2lf, \"aX\": %.2f, \"aY\": "
                 "%.2f, \"aZ\": %.2f, \"pressure\": %.2f, \"rssi\": %d}",
@@ -899,6 +944,15 @@ static ExitCode InitPeripheralsAndHandlers(void)
         return ExitCode_Init_AzureTimer;
     }
 
+#ifdef USE_PNP
+    // DPS provisioning timers, these are armed by StartProvisionWithDpsPnP()
+    dpsPnPWorkTimer = CreateEventLoopDisarmedTimer(eventLoop, &DpsPnPWorkTimerEventHandler);
+    dpsPnPTimeoutTimer = CreateEventLoopDisarmedTimer(eventLoop, &DpsPnPTimeoutTimerEventHandler);
+    if ((dpsPnPWorkTimer == NULL) || (dpsPnPTimeoutTimer == NULL)) {
+        return ExitCode_Init_DpsPnPTimer;
+    }
+#endif // USE_PNP
+
 #endif // IOT_HUB_APPLICATION
 
 #ifdef USE_IOT_CONNECT
@@ -912,6 +966,20 @@ static ExitCode InitPeripheralsAndHandlers(void)
     // Initialize the i2c sensors
     lp_imu_initialize();
 
+#ifdef ENABLE_BURST_CAPTURE
+    // Start streaming accelerometer data into the capture buffer, requires the sensors above
+    if (burst_Init(eventLoop) != ExitCode_Success) {
+        return ExitCode_Init_BurstCaptureTimer;
+    }
+#endif 
+
+#ifdef ENABLE_MOTION_CLASSIFIER
+    // Load the motion model and start sampling, requires the sensors above
+    if (motion_Init(eventLoop) != ExitCode_Success) {
+        return ExitCode_Init_MotionTimer;
+    }
+#endif 
+
 #ifdef M4_INTERCORE_COMMS
     InitM4Interfaces();
 #endif
@@ -943,6 +1011,14 @@ static void ClosePeripheralsAndHandlers(void)
     DisposeEventLoopTimer(sensorPollTimer);
     DisposeEventLoopTimer(telemetrytxIntervalr);
 
+#ifdef ENABLE_BURST_CAPTURE
+    burst_Cleanup();
+#endif 
+
+#ifdef ENABLE_MOTION_CLASSIFIER
+    motion_Cleanup();
+#endif 
+
 #ifdef M4_INTERCORE_COMMS    
     CleanupM4Resources();
 #endif 
@@ -951,6 +1027,11 @@ static void ClosePeripheralsAndHandlers(void)
 #endif 
 #ifdef IOT_HUB_APPLICATION    
     DisposeEventLoopTimer(azureTimer);
+#ifdef USE_PNP
+    CleanupProvisionWithDpsPnP();
+    DisposeEventLoopTimer(dpsPnPWorkTimer);
+    DisposeEventLoopTimer(dpsPnPTimeoutTimer);
+#endif // USE_PNP
 
     // Cleanup andy resources allocated by the direct method handlers
     CleanupDirectMethods();
@@ -1029,6 +1110,7 @@ static void SetUpAzureIoTHubClient(void)
 
     if (iothubClientHandle != NULL) {
         IoTHubDeviceClient_LL_Destroy(iothubClientHandle);
+        iothubClientHandle = NULL;
     }
 
     if ((connectionType == ConnectionType_Direct) || (connectionType == ConnectionType_IoTEdge)) {
@@ -1038,10 +1120,27 @@ static void SetUpAzureIoTHubClient(void)
     }
 #ifdef USE_PNP           
     else if (connectionType == ConnectionType_PnP){
-        isClientSetupSuccessful = ProvisionWithDpsPnP();
+
+        // Provisioning completes from the event loop and then calls FinishAzureIoTHubClientSetup().
+        // Mark authentication as initiated so the Azure timer doesn't start another attempt meanwhile.
+        if (StartProvisionWithDpsPnP()) {
+            iotHubClientAuthenticationState = IoTHubClientAuthenticationState_AuthenticationInitiated;
+            return;
+        }
     }
 #endif 
+    FinishAzureIoTHubClientSetup(isClientSetupSuccessful);
+}
+
+/// <summary>
+///     Completes setting up the Azure IoT Hub connection once the iothubClientHandle has been
+///     created, or schedules a retry with backoff if it could not be created.
+/// </summary>
+static void FinishAzureIoTHubClientSetup(bool isClientSetupSuccessful)
+{
     if (!isClientSetupSuccessful) {
+        iotHubClientAuthenticationState = IoTHubClientAuthenticationState_NotAuthenticated;
+
         // If we fail to connect, reduce the polling frequency, starting at
         // AzureIoTMinReconnectPeriodSeconds and with a backoff up to
         // AzureIoTMaxReconnectPeriodSeconds
@@ -1246,6 +1345,14 @@ bool IsConnectionReadyToSendTelemetry(void)
     return true;
 }
 
+/// <summary>
+///     Returns true once the IoT Hub client has authenticated
+/// </summary>
+bool IsIoTHubAuthenticated(void)
+{
+    return (iotHubClientAuthenticationState == IoTHubClientAuthenticationState_Authenticated);
+}
+
 /// <summary>
 ///     Sends telemetry to Azure IoT Hub
 /// </summary>
@@ -1473,6 +1580,7 @@ void TwinReportState(const char *jsonState)
 /// </summary>
 static void RegisterDeviceCallback(PROV_DEVICE_RESULT registerResult, const char* callbackHubUri, const char* deviceId, void* userContext)
 {
+    dpsRegisterCompleted = true;
     dpsRegisterStatus = registerResult;
 
 	if (registerResult == PROV_DEVICE_RESULT_OK && callbackHubUri != NULL) {
@@ -1507,16 +1615,18 @@ bool lp_isDeviceAuthReady(void) {
 
 
 /// <summary>
-///     Provision with DPS and assign IoT Plug and Play Model ID
+///     Starts provisioning with DPS and assigning the IoT Plug and Play Model ID.  The work is done
+///     from DpsPnPWorkTimerEventHandler() so the event loop keeps running while provisioning.
 /// </summary>
-static bool ProvisionWithDpsPnP(void)
+/// <returns>true if provisioning was started</returns>
+static bool StartProvisionWithDpsPnP(void)
 {
-	PROV_DEVICE_LL_HANDLE prov_handle = NULL;
 	PROV_DEVICE_RESULT prov_result;
-	bool result = false;
-	char* dtdlBuffer = NULL;
 	int deviceIdForDaaCertUsage = 0;  // set DaaCertUsage to false
 
+	// allow for JSON format "{\"modelId\":\"%s\"}", 14 char, plus null and a couple of extra :)
+	static char dtdlBuffer[sizeof(IOT_PLUG_AND_PLAY_MODEL_ID) + 20];
+
 	if (!lp_isNetworkReady() || !lp_isDeviceAuthReady()) {
 		return false;
 	}
@@ -1524,21 +1634,13 @@ static bool ProvisionWithDpsPnP(void)
 //    #define IOT_PLUG_AND_PLAY_MODEL_ID "dtmi:com:example:azuresphere:avnetoob;1"	// https://docs.microsoft.com/en-us/azure/iot-pnp/overview-iot-plug-and-play
     const char* _deviceTwinModelId = IOT_PLUG_AND_PLAY_MODEL_ID;
 
-	if (_deviceTwinModelId != NULL && strlen(_deviceTwinModelId) > 0)
+	dtdlBuffer[0] = '\0';
+	if (strlen(_deviceTwinModelId) > 0)
 	{
-		size_t modelIdLen = 20; // allow for JSON format "{\"modelId\":\"%s\"}", 14 char, plus null and a couple of extra :)
-		modelIdLen += strlen(_deviceTwinModelId); // allow for twin property name in JSON response
-
-		dtdlBuffer = (char*)malloc(modelIdLen);
-		if (dtdlBuffer == NULL) {
-			Log_Debug("ERROR: PnP Model ID malloc failed.\n");
-			goto cleanup;
-		}
-
-		int len = snprintf(dtdlBuffer, modelIdLen, "{\"modelId\":\"%s\"}", _deviceTwinModelId);
-		if (len < 0 || len >= modelIdLen) {
+		int len = snprintf(dtdlBuffer, sizeof(dtdlBuffer), "{\"modelId\":\"%s\"}", _deviceTwinModelId);
+		if (len < 0 || len >= sizeof(dtdlBuffer)) {
 			Log_Debug("ERROR: Cannot write Model ID to buffer.\n");
-			goto cleanup;
+			return false;
 		}
 	}
 
@@ -1547,63 +1649,138 @@ static bool ProvisionWithDpsPnP(void)
 		Log_Debug("ERROR: Failed to initiate X509 Certificate security\n");
 		goto cleanup;
 	}
+	dpsPnPSecurityInitialized = true;
 
 	// Create Provisioning Client for communication with DPS using MQTT protocol
-	if ((prov_handle = Prov_Device_LL_Create(dpsUrl, scopeId, Prov_Device_MQTT_Protocol)) == NULL) {
+	if ((dpsPnPProvHandle = Prov_Device_LL_Create(dpsUrl, scopeId, Prov_Device_MQTT_Protocol)) == NULL) {
 		Log_Debug("ERROR: Failed to create Provisioning Client\n");
 		goto cleanup;
 	}
 
 	// Sets Device ID on Provisioning Client
-	if ((prov_result = Prov_Device_LL_SetOption(prov_handle, "SetDeviceId", &deviceIdForDaaCertUsage)) != PROV_DEVICE_RESULT_OK) {
+	if ((prov_result = Prov_Device_LL_SetOption(dpsPnPProvHandle, "SetDeviceId", &deviceIdForDaaCertUsage)) != PROV_DEVICE_RESULT_OK) {
 		Log_Debug("ERROR: Failed to set Device ID in Provisioning Client, error=%d\n", prov_result);
 		goto cleanup;
 	}
 
 	// Sets Model ID provisioning data
-	if (dtdlBuffer != NULL) {
-		if ((prov_result = Prov_Device_LL_Set_Provisioning_Payload(prov_handle, dtdlBuffer)) != PROV_DEVICE_RESULT_OK) {
+	if (dtdlBuffer[0] != '\0') {
+		if ((prov_result = Prov_Device_LL_Set_Provisioning_Payload(dpsPnPProvHandle, dtdlBuffer)) != PROV_DEVICE_RESULT_OK) {
 			Log_Debug("Error: Failed to set Model ID in Provisioning Client, error=%d\n", prov_result);
 			goto cleanup;
 		}
 	}
 
 	// Sets the callback function for device registration
-	if ((prov_result = Prov_Device_LL_Register_Device(prov_handle, RegisterDeviceCallback, NULL, NULL, NULL)) != PROV_DEVICE_RESULT_OK) {
+	if ((prov_result = Prov_Device_LL_Register_Device(dpsPnPProvHandle, RegisterDeviceCallback, NULL, NULL, NULL)) != PROV_DEVICE_RESULT_OK) {
 		Log_Debug("ERROR: Failed to set callback function for device registration, error=%d\n", prov_result);
 		goto cleanup;
 	}
 
-	// Begin provisioning device with DPS
-	// Initiates timer to prevent timing out
-	static const long timeoutMs = 60000; // aloow up to 60 seconds before timeout
-	static const long workDelayMs = 25;
-	const struct timespec sleepTime = { .tv_sec = 0, .tv_nsec = workDelayMs * 1000 * 1000 };
-	long time_elapsed = 0;
-
 	dpsRegisterStatus = PROV_DEVICE_REG_HUB_NOT_SPECIFIED;
+	dpsRegisterCompleted = false;
+	dpsPnPMaxDoWorkUs = 0;
+	dpsPnPDoWorkCalls = 0;
+	clock_gettime(CLOCK_MONOTONIC, &dpsPnPStartTime);
+
+	// Begin provisioning device with DPS, the timeout timer stops us from waiting forever
+	static const struct timespec workPeriod = {.tv_sec = 0, .tv_nsec = DPS_PNP_WORK_PERIOD_MS * 1000 * 1000};
+	static const struct timespec timeoutPeriod = {.tv_sec = DPS_PNP_TIMEOUT_SECONDS, .tv_nsec = 0};
+
+	if ((SetEventLoopTimerPeriod(dpsPnPWorkTimer, &workPeriod) != 0) ||
+		(SetEventLoopTimerOneShot(dpsPnPTimeoutTimer, &timeoutPeriod) != 0)) {
+		Log_Debug("ERROR: Failed to start the provisioning timers: %s (%d)\n", strerror(errno), errno);
+		goto cleanup;
+	}
+
+	return true;
+
+cleanup:
+	CleanupProvisionWithDpsPnP();
+	return false;
+}
+
+/// <summary>
+///     DPS provisioning work timer event:  Run the provisioning client and check for completion
+/// </summary>
+static void DpsPnPWorkTimerEventHandler(EventLoopTimer *timer)
+{
+	if (ConsumeEventLoopTimerEvent(timer) != 0) {
+		exitCode = ExitCode_DpsPnPTimer_Consume;
+		return;
+	}
+
+	if (dpsPnPProvHandle == NULL) {
+		return;
+	}
 
-	while (dpsRegisterStatus != PROV_DEVICE_RESULT_OK && time_elapsed < timeoutMs) {
-		Prov_Device_LL_DoWork(prov_handle);
-		nanosleep(&sleepTime, NULL);
-		time_elapsed += workDelayMs;
+	// Time the call, this is how long the rest of the application waits on provisioning
+	struct timespec before, after;
+	clock_gettime(CLOCK_MONOTONIC, &before);
+	Prov_Device_LL_DoWork(dpsPnPProvHandle);
+	clock_gettime(CLOCK_MONOTONIC, &after);
+
+	long doWorkUs = ((after.tv_sec - before.tv_sec) * 1000000) + ((after.tv_nsec - before.tv_nsec) / 1000);
+	if (doWorkUs > dpsPnPMaxDoWorkUs) {
+		dpsPnPMaxDoWorkUs = doWorkUs;
+	}
+	dpsPnPDoWorkCalls++;
+
+	if (dpsRegisterCompleted) {
+		CompleteProvisionWithDpsPnP();
+	}
+}
+
+/// <summary>
+///     DPS provisioning timeout timer event:  Give up and let the Azure timer retry with backoff
+/// </summary>
+static void DpsPnPTimeoutTimerEventHandler(EventLoopTimer *timer)
+{
+	if (ConsumeEventLoopTimerEvent(timer) != 0) {
+		exitCode = ExitCode_DpsPnPTimer_Consume;
+		return;
 	}
 
+	Log_Debug("ERROR: Timed out waiting for device provisioning service to provision device\n");
+	Log_Debug("INFO: DPS provisioning: %u DoWork calls, longest DoWork (event loop stall) %ld us\n",
+			  dpsPnPDoWorkCalls, dpsPnPMaxDoWorkUs);
+
+	CleanupProvisionWithDpsPnP();
+	FinishAzureIoTHubClientSetup(false);
+}
+
+/// <summary>
+///     Creates the IoT Hub client once DPS has called RegisterDeviceCallback()
+/// </summary>
+static void CompleteProvisionWithDpsPnP(void)
+{
+	bool result = false;
+	const char* _deviceTwinModelId = IOT_PLUG_AND_PLAY_MODEL_ID;
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	long provisioningMs = ((now.tv_sec - dpsPnPStartTime.tv_sec) * 1000) + ((now.tv_nsec - dpsPnPStartTime.tv_nsec) / 1000000);
+	Log_Debug("INFO: DPS provisioning finished in %ld ms: %u DoWork calls, longest DoWork (event loop stall) %ld us\n",
+			  provisioningMs, dpsPnPDoWorkCalls, dpsPnPMaxDoWorkUs);
+
 	if (dpsRegisterStatus != PROV_DEVICE_RESULT_OK) {
 		Log_Debug("ERROR: Failed to register device with provisioning service\n");
 		goto cleanup;
 	}
 
+	if (iotHubUri == NULL) {
+		Log_Debug("ERROR: Device registration did not return an IoT Hub URI\n");
+		goto cleanup;
+	}
+
 	if ((iothubClientHandle = IoTHubDeviceClient_LL_CreateWithAzureSphereFromDeviceAuth(iotHubUri, MQTT_Protocol)) == NULL) {
-		Log_Debug("ERROR: Failed to create client IoT Hub Client Handle\n");
+		Log_Debug("ERROR: Failed to create client IoT Hub Client Handle\n");
 		goto cleanup;
 	}
 
 	// IOTHUB_CLIENT_RESULT iothub_result 
 	int deviceId = 1;
 	if (IoTHubDeviceClient_LL_SetOption(iothubClientHandle, "SetDeviceId", &deviceId) != IOTHUB_CLIENT_OK) {
-		IoTHubDeviceClient_LL_Destroy(iothubClientHandle);
-		iothubClientHandle = NULL;
 		Log_Debug("ERROR: Failed to set Device ID on IoT Hub Client\n");
 		goto cleanup;
 	}
@@ -1615,7 +1792,7 @@ static bool ProvisionWithDpsPnP(void)
 		goto cleanup;
 	}
 
-	if (dtdlBuffer != NULL) {
+	if (strlen(_deviceTwinModelId) > 0) {
 		if (IoTHubDeviceClient_LL_SetOption(iothubClientHandle, OPTION_MODEL_ID, _deviceTwinModelId) != IOTHUB_CLIENT_OK)
 		{
 			Log_Debug("ERROR: failure setting option \"%s\"\n", OPTION_MODEL_ID);
@@ -1626,9 +1803,26 @@ static bool ProvisionWithDpsPnP(void)
 	result = true;
 
 cleanup:
-	if (dtdlBuffer != NULL) {
-		free(dtdlBuffer);
-		dtdlBuffer = NULL;
+	if (!result && (iothubClientHandle != NULL)) {
+		IoTHubDeviceClient_LL_Destroy(iothubClientHandle);
+		iothubClientHandle = NULL;
+	}
+
+	CleanupProvisionWithDpsPnP();
+	FinishAzureIoTHubClientSetup(result);
+}
+
+/// <summary>
+///     Stops the provisioning timers and releases the provisioning client
+/// </summary>
+static void CleanupProvisionWithDpsPnP(void)
+{
+	if (dpsPnPWorkTimer != NULL) {
+		DisarmEventLoopTimer(dpsPnPWorkTimer);
+	}
+
+	if (dpsPnPTimeoutTimer != NULL) {
+		DisarmEventLoopTimer(dpsPnPTimeoutTimer);
 	}
 
 	if (iotHubUri != NULL) {
@@ -1636,12 +1830,15 @@ cleanup:
 		iotHubUri = NULL;
 	}
 
-	if (prov_handle != NULL) {
-		Prov_Device_LL_Destroy(prov_handle);
+	if (dpsPnPProvHandle != NULL) {
+		Prov_Device_LL_Destroy(dpsPnPProvHandle);
+		dpsPnPProvHandle = NULL;
 	}
 
-	prov_dev_security_deinit();
-	return result;
+	if (dpsPnPSecurityInitialized) {
+		prov_dev_security_deinit();
+		dpsPnPSecurityInitialized = false;
+	}
 }
 
 #endif // USE_PNP
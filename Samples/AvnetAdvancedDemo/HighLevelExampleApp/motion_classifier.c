@@ -0,0 +1,303 @@
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+
+/*
+Motion classifier
+
+    Samples the LSM6DSO accelerometer and gyro every MOTION_SAMPLE_PERIOD_MS into a circular
+    window.  Every MOTION_HOP_SAMPLES samples, once the window is full, the window features are
+    computed and classified by the int8 decision tree from MOTION_MODEL_FILE (see motion_model.h).
+
+    The class a window is given only becomes the reported state after motionConfirmWindows
+    windows in a row agree, so a single odd window does not cause a transition.  Each transition
+    is sent as a telemetry event:
+
+        {"motionEvent": "moving", "motionPrevious": "idle", "motionConfidence": 0.94,
+         "motionPreviousSeconds": 125, "motionTransitions": 7}
+
+    If the device is not connected the latest transition is held and sent once it is,
+    motionTransitions counts every transition so the cloud can see any that were replaced.
+*/
+
+#include "motion_classifier.h"
+
+#ifdef ENABLE_MOTION_CLASSIFIER
+
+#ifndef IOT_HUB_APPLICATION
+#error "ENABLE_MOTION_CLASSIFIER sends motion events as telemetry, enable IOT_HUB_APPLICATION"
+#endif
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <applibs/log.h>
+#include <applibs/storage.h>
+#include "eventloop_timer_utilities.h"
+#include "i2c.h"
+
+#ifdef USE_IOT_CONNECT
+#include "iotConnect.h"
+#endif
+
+extern volatile sig_atomic_t exitCode;
+extern void SendTelemetry(const char *jsonMessage, bool appendIoTConnectHeader);
+extern bool IsConnectionReadyToSendTelemetry(void);
+extern bool IsIoTHubAuthenticated(void);
+
+#define MOTION_STATE_UNKNOWN -1
+#define MOTION_EVENT_BUFFER_SIZE 256
+
+int motionConfirmWindows = MOTION_DEFAULT_CONFIRM_WINDOWS;
+
+static EventLoopTimer *motionSampleTimer = NULL;
+static motionModel_t motionModel;
+static bool modelLoaded = false;
+
+static motionSample_t window[MOTION_WINDOW_SAMPLES];
+static int windowHead = 0;
+static int windowCount = 0;
+static int samplesSinceClassify = 0;
+
+// The reported state and the candidate that is waiting to be confirmed
+static int state = MOTION_STATE_UNKNOWN;
+static uint8_t stateConfidence = 0;
+static time_t stateSince;
+static int candidate = MOTION_STATE_UNKNOWN;
+static int candidateWindows = 0;
+static unsigned int transitions = 0;
+
+// Latest transition not yet sent
+static bool eventPending = false;
+static int eventState;
+static int eventPrevious;
+static uint8_t eventConfidence;
+static long eventPreviousSeconds;
+
+static void MotionSampleTimerEventHandler(EventLoopTimer *timer);
+
+/// <summary>
+///     Read the model file from the image package into motionModel
+/// </summary>
+static bool motionLoadModel(void)
+{
+    static uint8_t fileBuffer[MOTION_MODEL_MAX_SIZE + 1];
+
+    int modelFd = Storage_OpenFileInImagePackage(MOTION_MODEL_FILE);
+    if (modelFd == -1) {
+        Log_Debug("Motion classifier: could not open %s: %s (%d)\n", MOTION_MODEL_FILE,
+                  strerror(errno), errno);
+        return false;
+    }
+
+    // Read one byte more than the largest model so an oversized file is rejected
+    size_t length = 0;
+    ssize_t readSize;
+    while ((length < sizeof(fileBuffer)) &&
+           ((readSize = read(modelFd, &fileBuffer[length], sizeof(fileBuffer) - length)) > 0)) {
+        length += (size_t)readSize;
+    }
+    close(modelFd);
+
+    const char *error = motionModel_Parse(&motionModel, fileBuffer, length);
+    if (error != NULL) {
+        Log_Debug("Motion classifier: %s is invalid, %s\n", MOTION_MODEL_FILE, error);
+        return false;
+    }
+
+    Log_Debug("Motion classifier: loaded %s, %d classes, %d nodes\n", MOTION_MODEL_FILE,
+              motionModel.classCount, motionModel.nodeCount);
+    return true;
+}
+
+/// <summary>
+///     Send the pending transition event if the device can send telemetry
+/// </summary>
+static void motionSendEvent(void)
+{
+    if (!eventPending || !IsIoTHubAuthenticated() || !IsConnectionReadyToSendTelemetry()) {
+        return;
+    }
+#ifdef USE_IOT_CONNECT
+    if (!IoTCConnected) {
+        return;
+    }
+#endif
+
+    char eventBuffer[MOTION_EVENT_BUFFER_SIZE];
+    snprintf(eventBuffer, sizeof(eventBuffer),
+             "{\"motionEvent\":\"%s\",\"motionPrevious\":\"%s\",\"motionConfidence\":%.2f,"
+             "\"motionPreviousSeconds\":%ld,\"motionTransitions\":%u}",
+             motionModel.className[eventState],
+             (eventPrevious == MOTION_STATE_UNKNOWN) ? "unknown" : motionModel.className[eventPrevious],
+             eventConfidence / 255.0f, eventPreviousSeconds, transitions);
+
+    SendTelemetry(eventBuffer, true);
+    eventPending = false;
+}
+
+/// <summary>
+///     Classify the window and update the reported state
+/// </summary>
+static void motionClassifyWindow(void)
+{
+    motionSample_t ordered[MOTION_WINDOW_SAMPLES];
+    float features[MOTION_FEATURE_COUNT];
+    int8_t quantized[MOTION_FEATURE_COUNT];
+    uint8_t confidence;
+
+    // windowHead is the oldest sample once the window is full
+    int tail = MOTION_WINDOW_SAMPLES - windowHead;
+    memcpy(ordered, &window[windowHead], sizeof(motionSample_t) * (size_t)tail);
+    memcpy(&ordered[tail], window, sizeof(motionSample_t) * (size_t)windowHead);
+
+    motionModel_Features(ordered, MOTION_WINDOW_SAMPLES, features);
+    motionModel_Quantize(&motionModel, features, quantized);
+    int windowClass = motionModel_Classify(&motionModel, quantized, &confidence);
+
+    if (windowClass == state) {
+        stateConfidence = confidence;
+        candidate = MOTION_STATE_UNKNOWN;
+        candidateWindows = 0;
+        return;
+    }
+
+    if (windowClass != candidate) {
+        candidate = windowClass;
+        candidateWindows = 0;
+    }
+
+    // The first state is taken straight away, there is nothing to confirm it against
+    if ((++candidateWindows < motionConfirmWindows) && (state != MOTION_STATE_UNKNOWN)) {
+        return;
+    }
+
+    time_t now = time(NULL);
+
+    eventPending = true;
+    eventState = windowClass;
+    eventPrevious = state;
+    eventConfidence = confidence;
+    eventPreviousSeconds = (state == MOTION_STATE_UNKNOWN) ? 0 : (long)(now - stateSince);
+    transitions++;
+
+    Log_Debug("Motion state %s -> %s (%.2f)\n",
+              (state == MOTION_STATE_UNKNOWN) ? "unknown" : motionModel.className[state],
+              motionModel.className[windowClass], confidence / 255.0f);
+
+    state = windowClass;
+    stateConfidence = confidence;
+    stateSince = now;
+    candidate = MOTION_STATE_UNKNOWN;
+    candidateWindows = 0;
+}
+
+/// <summary>
+///     Motion timer event:  Take one accelerometer and gyro sample, classify every hop
+/// </summary>
+static void MotionSampleTimerEventHandler(EventLoopTimer *timer)
+{
+    if (ConsumeEventLoopTimerEvent(timer) != 0) {
+        exitCode = ExitCode_MotionTimer_Consume;
+        return;
+    }
+
+    AccelerationgForce accel = lp_get_acceleration();
+    AngularRateDegreesPerSecond gyro = lp_get_angular_rate();
+
+    motionSample_t *sample = &window[windowHead];
+    sample->ax = accel.x;
+    sample->ay = accel.y;
+    sample->az = accel.z;
+    sample->gx = gyro.x;
+    sample->gy = gyro.y;
+    sample->gz = gyro.z;
+
+#ifdef MOTION_LOG_SAMPLES
+    Log_Debug("MOTION,%.4f,%.4f,%.4f,%.2f,%.2f,%.2f\n", sample->ax, sample->ay, sample->az,
+              sample->gx, sample->gy, sample->gz);
+#endif
+
+    windowHead = (windowHead + 1) % MOTION_WINDOW_SAMPLES;
+    if (windowCount < MOTION_WINDOW_SAMPLES) {
+        windowCount++;
+    }
+
+    if ((++samplesSinceClassify >= MOTION_HOP_SAMPLES) && (windowCount == MOTION_WINDOW_SAMPLES)) {
+        samplesSinceClassify = 0;
+        motionClassifyWindow();
+    }
+
+    motionSendEvent();
+}
+
+ExitCode motion_Init(EventLoop *el)
+{
+    static const struct timespec samplePeriod = {.tv_sec = 0,
+                                                 .tv_nsec = MOTION_SAMPLE_PERIOD_MS * 1000 * 1000};
+
+    modelLoaded = motionLoadModel();
+    if (!modelLoaded) {
+        Log_Debug("Motion classifier disabled, sending raw readings\n");
+        return ExitCode_Success;
+    }
+
+    motionSampleTimer = CreateEventLoopPeriodicTimer(el, &MotionSampleTimerEventHandler, &samplePeriod);
+    if (motionSampleTimer == NULL) {
+        return ExitCode_Init_MotionTimer;
+    }
+
+    lp_motion_rates_set();
+    return ExitCode_Success;
+}
+
+void motion_Cleanup(void)
+{
+    DisposeEventLoopTimer(motionSampleTimer);
+    motionSampleTimer = NULL;
+}
+
+bool motion_ModelLoaded(void)
+{
+    return modelLoaded;
+}
+
+const char *motion_StateName(void)
+{
+    return (state == MOTION_STATE_UNKNOWN) ? "unknown" : motionModel.className[state];
+}
+
+float motion_Confidence(void)
+{
+    return stateConfidence / 255.0f;
+}
+
+#endif // ENABLE_MOTION_CLASSIFIER
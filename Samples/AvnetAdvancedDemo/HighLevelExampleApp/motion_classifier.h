@@ -0,0 +1,62 @@
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+
+#ifndef C_MOTION_CLASSIFIER_H
+#define C_MOTION_CLASSIFIER_H
+
+#include <stdbool.h>
+#include <applibs/eventloop.h>
+#include "build_options.h"
+#include "exit_codes.h"
+#include "motion_model.h"
+
+#ifdef ENABLE_MOTION_CLASSIFIER
+
+// Backs the "motionConfirmWindows" device twin
+extern int motionConfirmWindows;
+
+ExitCode motion_Init(EventLoop *el);
+void motion_Cleanup(void);
+
+/// <summary>
+///     Returns true if a model was loaded from the image package.  Without a model the
+///     classifier does not run and the application sends the raw readings.
+/// </summary>
+bool motion_ModelLoaded(void);
+
+/// <summary>
+///     The reported motion state and the confidence (0..1) of the latest window that agreed with
+///     it.  The state is "unknown" until the first window is classified.
+/// </summary>
+const char *motion_StateName(void);
+float motion_Confidence(void);
+
+#endif // ENABLE_MOTION_CLASSIFIER
+
+#endif // C_MOTION_CLASSIFIER_H
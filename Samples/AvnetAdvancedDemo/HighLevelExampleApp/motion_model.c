@@ -0,0 +1,219 @@
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+
+#include "motion_model.h"
+#include "build_options.h"
+
+#ifdef ENABLE_MOTION_CLASSIFIER
+
+#include <math.h>
+#include <string.h>
+
+#define RADIANS_TO_DEGREES (180.0f / 3.14159265f)
+
+uint32_t motionModel_Checksum(const uint8_t *data, size_t length)
+{
+    uint32_t hash = 2166136261u;
+
+    for (size_t i = 0; i < length; i++) {
+        hash ^= data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+const char *motionModel_Parse(motionModel_t *model, const uint8_t *data, size_t length)
+{
+    if ((length < MOTION_MODEL_HEADER_SIZE + 4) || (memcmp(data, MOTION_MODEL_MAGIC, 4) != 0)) {
+        return "not a motion model";
+    }
+
+    int featureCount = data[4];
+    int classCount = data[5];
+    int nodeCount = data[6];
+
+    if (featureCount != MOTION_FEATURE_COUNT) {
+        return "wrong feature count";
+    }
+    if ((classCount < 1) || (classCount > MOTION_MAX_CLASSES) || (nodeCount < 1)) {
+        return "bad class or node count";
+    }
+
+    size_t expected = MOTION_MODEL_HEADER_SIZE + ((size_t)featureCount * 8) +
+                      ((size_t)classCount * MOTION_CLASS_NAME_SIZE) + ((size_t)nodeCount * 4) + 4;
+    if (length != expected) {
+        return "wrong length";
+    }
+
+    uint32_t checksum;
+    memcpy(&checksum, &data[length - 4], sizeof(checksum));
+    if (checksum != motionModel_Checksum(data, length - 4)) {
+        return "checksum mismatch";
+    }
+
+    const uint8_t *next = &data[MOTION_MODEL_HEADER_SIZE];
+
+    memset(model, 0, sizeof(*model));
+    model->classCount = classCount;
+    model->nodeCount = nodeCount;
+
+    memcpy(model->offset, next, sizeof(float) * MOTION_FEATURE_COUNT);
+    next += sizeof(float) * MOTION_FEATURE_COUNT;
+    memcpy(model->scale, next, sizeof(float) * MOTION_FEATURE_COUNT);
+    next += sizeof(float) * MOTION_FEATURE_COUNT;
+
+    for (int i = 0; i < classCount; i++) {
+        memcpy(model->className[i], next, MOTION_CLASS_NAME_SIZE);
+        model->className[i][MOTION_CLASS_NAME_SIZE - 1] = '\0';
+        next += MOTION_CLASS_NAME_SIZE;
+    }
+
+    for (int i = 0; i < MOTION_FEATURE_COUNT; i++) {
+        if (!(model->scale[i] > 0.0f) || isinf(model->scale[i]) || !isfinite(model->offset[i])) {
+            return "bad feature scale";
+        }
+    }
+
+    for (int i = 0; i < nodeCount; i++, next += 4) {
+
+        motionNode_t *node = &model->nodes[i];
+        node->feature = (int8_t)next[0];
+        node->threshold = (int8_t)next[1];
+        node->left = next[2];
+        node->right = next[3];
+
+        if (node->feature == MOTION_NODE_LEAF) {
+            if ((uint8_t)node->threshold >= classCount) {
+                return "leaf class out of range";
+            }
+        }
+        else if ((node->feature < 0) || (node->feature >= MOTION_FEATURE_COUNT) ||
+                 (node->left <= i) || (node->left >= nodeCount) ||
+                 (node->right <= i) || (node->right >= nodeCount)) {
+            return "bad split node";
+        }
+    }
+
+    return NULL;
+}
+
+void motionModel_Features(const motionSample_t *window, int count, float *features)
+{
+    float accelSum = 0.0f, accelSquares = 0.0f, accelMin = INFINITY, accelMax = -INFINITY;
+    float gyroSum = 0.0f, gyroSquares = 0.0f, jerkSum = 0.0f;
+    float meanX = 0.0f, meanY = 0.0f, meanZ = 0.0f;
+    float previous = 0.0f;
+
+    memset(features, 0, sizeof(float) * MOTION_FEATURE_COUNT);
+    if (count < 2) {
+        return;
+    }
+
+    for (int i = 0; i < count; i++) {
+
+        const motionSample_t *s = &window[i];
+        float accel = sqrtf((s->ax * s->ax) + (s->ay * s->ay) + (s->az * s->az));
+        float gyro = sqrtf((s->gx * s->gx) + (s->gy * s->gy) + (s->gz * s->gz));
+
+        accelSum += accel;
+        accelSquares += accel * accel;
+        accelMin = fminf(accelMin, accel);
+        accelMax = fmaxf(accelMax, accel);
+        gyroSum += gyro;
+        gyroSquares += gyro * gyro;
+        meanX += s->ax;
+        meanY += s->ay;
+        meanZ += s->az;
+
+        if (i > 0) {
+            jerkSum += fabsf(accel - previous);
+        }
+        previous = accel;
+    }
+
+    float n = (float)count;
+    float accelMean = accelSum / n;
+    float gyroMean = gyroSum / n;
+
+    features[MOTION_FEATURE_ACCEL_MEAN] = accelMean;
+    features[MOTION_FEATURE_ACCEL_STD] = sqrtf(fmaxf(0.0f, (accelSquares / n) - (accelMean * accelMean)));
+    features[MOTION_FEATURE_ACCEL_RANGE] = accelMax - accelMin;
+    features[MOTION_FEATURE_ACCEL_JERK] = jerkSum / (n - 1.0f);
+    features[MOTION_FEATURE_GYRO_MEAN] = gyroMean;
+    features[MOTION_FEATURE_GYRO_STD] = sqrtf(fmaxf(0.0f, (gyroSquares / n) - (gyroMean * gyroMean)));
+
+    // Mean crossings need the mean, so take a second pass over the magnitudes
+    int crossings = 0;
+    bool above = false;
+    for (int i = 0; i < count; i++) {
+        const motionSample_t *s = &window[i];
+        bool nowAbove = sqrtf((s->ax * s->ax) + (s->ay * s->ay) + (s->az * s->az)) > accelMean;
+        if ((i > 0) && (nowAbove != above)) {
+            crossings++;
+        }
+        above = nowAbove;
+    }
+    features[MOTION_FEATURE_ACCEL_CROSSINGS] = 100.0f * (float)crossings / (n - 1.0f);
+
+    // The mean acceleration vector is gravity when the board is not accelerating
+    float gravity = sqrtf((meanX * meanX) + (meanY * meanY) + (meanZ * meanZ));
+    if (gravity > 0.0f) {
+        features[MOTION_FEATURE_TILT] = acosf(fmaxf(-1.0f, fminf(1.0f, meanZ / gravity))) * RADIANS_TO_DEGREES;
+    }
+}
+
+void motionModel_Quantize(const motionModel_t *model, const float *features, int8_t *quantized)
+{
+    for (int i = 0; i < MOTION_FEATURE_COUNT; i++) {
+
+        float q = roundf((features[i] - model->offset[i]) / model->scale[i]) - 128.0f;
+        if (!(q > -128.0f)) {
+            q = -128.0f;    // Also catches NAN from a failed sensor read
+        }
+        else if (q > 127.0f) {
+            q = 127.0f;
+        }
+        quantized[i] = (int8_t)q;
+    }
+}
+
+int motionModel_Classify(const motionModel_t *model, const int8_t *quantized, uint8_t *confidence)
+{
+    const motionNode_t *node = &model->nodes[0];
+
+    // Parse() checked that children follow their parent, so this always reaches a leaf
+    while (node->feature != MOTION_NODE_LEAF) {
+        node = &model->nodes[(quantized[node->feature] <= node->threshold) ? node->left : node->right];
+    }
+
+    *confidence = node->left;
+    return (uint8_t)node->threshold;
+}
+
+#endif // ENABLE_MOTION_CLASSIFIER
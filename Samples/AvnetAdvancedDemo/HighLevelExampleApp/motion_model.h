@@ -0,0 +1,139 @@
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+
+#ifndef C_MOTION_MODEL_H
+#define C_MOTION_MODEL_H
+
+/*
+Motion model
+
+    Window features and the int8 decision tree used by the motion classifier.  This file has no
+    Azure Sphere dependencies so the host tools can train and benchmark the same code.
+
+    Features, computed over one window of accelerometer (g) and gyro (dps) samples:
+        0 accelMean:      mean acceleration magnitude (g)
+        1 accelStd:       standard deviation of the acceleration magnitude (g)
+        2 accelRange:     largest minus smallest acceleration magnitude (g)
+        3 accelJerk:      mean absolute change in acceleration magnitude between samples (g)
+        4 accelCrossings: percent of samples where the magnitude crosses its mean
+        5 gyroMean:       mean angular rate magnitude (dps)
+        6 gyroStd:        standard deviation of the angular rate magnitude (dps)
+        7 tilt:           angle between the mean acceleration vector and the board Z axis (deg)
+
+    Each feature is quantized to int8 with the model's per feature offset and scale, offset is
+    the bottom of the range the model was trained on:
+        q = clamp(round((feature - offset) / scale) - 128, -128, 127)
+
+    Model file, little endian:
+        char     magic[4]       "MTN1"
+        uint8_t  featureCount   MOTION_FEATURE_COUNT
+        uint8_t  classCount     1..MOTION_MAX_CLASSES
+        uint8_t  nodeCount      1..MOTION_MAX_NODES
+        uint8_t  reserved       0
+        float    offset[featureCount]
+        float    scale[featureCount]
+        char     className[classCount][MOTION_CLASS_NAME_SIZE], NUL padded
+        node     nodes[nodeCount], 4 bytes each, node 0 is the root:
+                     split: feature, threshold, left, right.  Go left if q[feature] <= threshold.
+                     leaf:  MOTION_NODE_LEAF, class, confidence (0..255), 0
+        uint32_t checksum       FNV-1a of all the bytes before it
+
+    A split's children must come after it in the node array, so every walk ends at a leaf in at
+    most nodeCount steps.
+*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define MOTION_FEATURE_COUNT 8
+#define MOTION_MAX_CLASSES 8
+#define MOTION_MAX_NODES 255
+#define MOTION_CLASS_NAME_SIZE 12
+#define MOTION_NODE_LEAF -1
+
+#define MOTION_MODEL_MAGIC "MTN1"
+#define MOTION_MODEL_HEADER_SIZE 8
+#define MOTION_MODEL_MAX_SIZE                                                              \
+    (MOTION_MODEL_HEADER_SIZE + (MOTION_FEATURE_COUNT * 8) +                               \
+     (MOTION_MAX_CLASSES * MOTION_CLASS_NAME_SIZE) + (MOTION_MAX_NODES * 4) + 4)
+
+typedef enum {
+    MOTION_FEATURE_ACCEL_MEAN = 0,
+    MOTION_FEATURE_ACCEL_STD = 1,
+    MOTION_FEATURE_ACCEL_RANGE = 2,
+    MOTION_FEATURE_ACCEL_JERK = 3,
+    MOTION_FEATURE_ACCEL_CROSSINGS = 4,
+    MOTION_FEATURE_GYRO_MEAN = 5,
+    MOTION_FEATURE_GYRO_STD = 6,
+    MOTION_FEATURE_TILT = 7
+} motionFeature_t;
+
+typedef struct {
+    float ax, ay, az;
+    float gx, gy, gz;
+} motionSample_t;
+
+typedef struct {
+    int8_t feature;
+    int8_t threshold;
+    uint8_t left;
+    uint8_t right;
+} motionNode_t;
+
+typedef struct {
+    int classCount;
+    int nodeCount;
+    float offset[MOTION_FEATURE_COUNT];
+    float scale[MOTION_FEATURE_COUNT];
+    char className[MOTION_MAX_CLASSES][MOTION_CLASS_NAME_SIZE];
+    motionNode_t nodes[MOTION_MAX_NODES];
+} motionModel_t;
+
+/// <summary>
+///     Load a model from the contents of a model file.  Returns NULL on success, or a short
+///     description of what is wrong with the file.
+/// </summary>
+const char *motionModel_Parse(motionModel_t *model, const uint8_t *data, size_t length);
+
+/// <summary>
+///     Compute the window features.  window[] is in time order, oldest first.
+/// </summary>
+void motionModel_Features(const motionSample_t *window, int count, float *features);
+
+void motionModel_Quantize(const motionModel_t *model, const float *features, int8_t *quantized);
+
+/// <summary>
+///     Walk the tree, returns the class index and sets *confidence to the leaf's confidence
+/// </summary>
+int motionModel_Classify(const motionModel_t *model, const int8_t *quantized, uint8_t *confidence);
+
+uint32_t motionModel_Checksum(const uint8_t *data, size_t length);
+
+#endif // C_MOTION_MODEL_H
@@ -67,6 +67,11 @@ SOFTWARE.
 //     currently being applied.  In this case the application may want to delay sleeping until the 
 //     update has been applied.
 //
+//  4. When OTA_TRAFFIC_AWARE_DEFERRAL is enabled the device twin "otaTargetUtcTime" also accepts the
+//     string "auto".  In this mode the module selects the lowest activity hour of the day (based on
+//     telemetry rate, direct method calls and resend queue depth) that falls within the OS deferral
+//     limit.  See build_options.h for details.
+//
 //   app_manifest.json - The implementation requies the folowing entrys:
 //      "SystemEventNotifications": true,
 //      "SoftwareUpdateDeferral": true,
@@ -83,6 +88,11 @@ SOFTWARE.
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
 #include "deferred_updates.h"
+#include "../common/schema_keys.h"
+#ifdef OTA_TRAFFIC_AWARE_DEFERRAL
+#include "../common/linkedList.h"
+#include "../common/work_queue.h"
+#endif // OTA_TRAFFIC_AWARE_DEFERRAL
 
 extern EventLoop *eventLoop;
 extern volatile sig_atomic_t exitCode;
@@ -118,6 +128,66 @@ static const char *UpdateTypeToString(SysEvent_UpdateType updateType);
 static bool WriteDelayTimeUTCToMutableFile(delayTimeUTC_t dataToWrite);
 static bool ReadDelayTimeUTCFromMutableFile(delayTimeUTC_t* readData);
 
+#ifdef OTA_TRAFFIC_AWARE_DEFERRAL
+
+// Signature used to validate the activity histogram read from mutable storage
+#define OTA_ACTIVITY_SIGNATURE 0x4F544141
+
+// Weight given to a new day's data for each hour in the histogram
+#define OTA_ACTIVITY_ALPHA 0.25f
+
+// Relative cost of the different activity types when scoring an hour.  A direct method usually
+// means someone is interacting with the device, and queued telemetry would be delayed even longer.
+#define OTA_DIRECT_METHOD_WEIGHT 10.0f
+#define OTA_QUEUE_DEPTH_WEIGHT 5.0f
+
+// Only fold an hour into the histogram if we observed at least this much of it
+#define OTA_MIN_OBSERVED_SECONDS (30*60)
+
+// How often we sample the resend queue and check for the end of the current hour
+#define OTA_ACTIVITY_TICK_SECONDS 60
+
+// The histogram and the data gap record, persisted in mutable storage
+static otaActivityState_t otaActivity;
+
+// Counters for the hour currently being observed
+static int activityHour = -1;
+static time_t activityHourStart;
+static uint32_t hourTelemetryCount;
+static uint32_t hourDirectMethodCount;
+static uint32_t hourQueueDepthSum;
+static uint32_t hourQueueDepthSamples;
+
+// Time the last telemetry message was successfully handed to the IoTHub client
+static time_t lastTelemetrySentTime;
+
+static EventLoopTimer *otaActivityTimer = NULL;
+
+static void otaActivityTimerEventHandler(EventLoopTimer *timer);
+static void otaActivity_Tick(time_t now);
+static float otaActivity_Score(const otaActivityBucket_t *bucket);
+static int otaActivity_SelectWindow(int maxDeferralMinutes, int *windowHour, float *windowScore);
+static bool WriteOtaActivityToMutableFile(void);
+static bool ReadOtaActivityFromMutableFile(otaActivityState_t *readData);
+
+#ifdef ENABLE_WORK_QUEUE
+// A snapshot of the data to write, owned by the worker until the completion function runs
+typedef struct {
+    int fd;
+    bool writeDelayData;
+    delayTimeUTC_t delayData;
+    otaActivityState_t activity;
+    size_t expected;        // Size of the write that failed
+    ssize_t written;        // What pwrite() returned for it
+} otaActivityWrite_t;
+
+static bool WriteOtaActivityOnWorker(void);
+static int otaActivityWriteJob(void *context);
+static void otaActivityWriteComplete(void *context, int result);
+#endif // ENABLE_WORK_QUEUE
+
+#endif // OTA_TRAFFIC_AWARE_DEFERRAL
+
 /// <summary>
 ///     Initialize system resources for deferring OTA updates
 /// </summary>
@@ -152,6 +222,22 @@ ExitCode deferredOtaUpdate_Init(void){
         return ExitCode_SetUpSysEvent_RegisterEvent;
     }
 
+#ifdef OTA_TRAFFIC_AWARE_DEFERRAL
+    // Pull the activity histogram from mutable storage, if it's not there start with an empty histogram
+    if (!ReadOtaActivityFromMutableFile(&otaActivity)){
+        memset(&otaActivity, 0, sizeof(otaActivityState_t));
+        otaActivity.signature = OTA_ACTIVITY_SIGNATURE;
+    }
+
+    // Set up a timer to sample the resend queue and close out each hour, hours with no traffic
+    // still need to make it into the histogram.
+    static const struct timespec otaActivityPeriod = {.tv_sec = OTA_ACTIVITY_TICK_SECONDS, .tv_nsec = 0};
+    otaActivityTimer = CreateEventLoopPeriodicTimer(eventLoop, &otaActivityTimerEventHandler, &otaActivityPeriod);
+    if (otaActivityTimer == NULL) {
+        return ExitCode_DeferredUpdate_CreateTimer;
+    }
+#endif // OTA_TRAFFIC_AWARE_DEFERRAL
+
     return ExitCode_Success;
 }
 
@@ -161,6 +247,10 @@ ExitCode deferredOtaUpdate_Init(void){
 void deferredOtaUpdate_Cleanup(void){
 
     SysEvent_UnregisterForEventNotifications(otaUpdateEventReg);
+
+#ifdef OTA_TRAFFIC_AWARE_DEFERRAL
+    DisposeEventLoopTimer(otaActivityTimer);
+#endif // OTA_TRAFFIC_AWARE_DEFERRAL
 }
 
 /// <summary>
@@ -205,10 +295,9 @@ static void deferredOtaUpdateCallback(SysEvent_Events event, SysEvent_Status sta
     // message my not be sent.  Consider enabling the ENABLE_TELEMETRY_RESEND_LOGIC build flag so 
     // that this telemetry message will be queued up and sent as soon as the IoTHub connection is 
     // established.
-    Cloud_SendTelemetry(true, 3*ARGS_PER_TELEMETRY_ITEM, 
-                              TYPE_STRING, "otaUpdateType", UpdateTypeToString(data.update_type),
-                              TYPE_STRING, "otaUpdateStatus", EventStatusToString(status),
-                              TYPE_INT, "otaMaxDeferalTime", data.max_deferral_time_in_minutes);
+    SCHEMA_SEND_TELEMETRY(true, SCHEMA_TELEMETRY(otaUpdateType, UpdateTypeToString(data.update_type)),
+                                SCHEMA_TELEMETRY(otaUpdateStatus, EventStatusToString(status)),
+                                SCHEMA_TELEMETRY(otaMaxDeferalTime, data.max_deferral_time_in_minutes));
 
 #endif // defined(SEND_OTA_STATUS_TELEMETRY) && defined(IOT_HUB_APPLICATION)
 
@@ -252,6 +341,49 @@ static void deferredOtaUpdateCallback(SysEvent_Events event, SysEvent_Status sta
                 // Declare a local variable for code efficiency
                 int newDelayTime = deferredOtaUpdateTime;
 
+#ifdef OTA_TRAFFIC_AWARE_DEFERRAL
+                // If the application is in "auto" mode, then pick the quietest hour within the
+                // OS deferral limit and defer the update until the start of that hour.
+                if((newDelayTime == 0) && (otaTargetUtcHour == OTA_TARGET_UTC_AUTO)){
+
+                    int windowHour;
+                    float windowScore;
+                    newDelayTime = otaActivity_SelectWindow(data.max_deferral_time_in_minutes, &windowHour, &windowScore);
+
+                    // Predict the gap in our telemetry data, the outage plus the time until the next
+                    // telemetry message would have been sent anyway.
+                    const otaActivityBucket_t *window = &otaActivity.bucket[windowHour];
+                    otaActivity.predictedGapSeconds = OTA_EXPECTED_OUTAGE_SECONDS;
+                    if(window->avgTelemetry > 0.0f){
+                        otaActivity.predictedGapSeconds += (int)(3600.0f / window->avgTelemetry);
+                    }
+
+                    Log_Debug("INFO: Selected OTA window %02d:00 UTC, activity %.2f, predicted data gap %d seconds\n",
+                              windowHour, windowScore, otaActivity.predictedGapSeconds);
+
+#ifdef IOT_HUB_APPLICATION
+                    // Report the window start as HH:MM (UTC)
+                    char windowString[6];
+                    time_t windowStart = time(NULL) + (newDelayTime * 60);
+                    struct tm tWindow;
+                    memcpy(&tWindow, gmtime(&windowStart), sizeof(struct tm));
+                    snprintf(windowString, sizeof(windowString), "%02d:%02d", tWindow.tm_hour, tWindow.tm_min);
+                    SCHEMA_SEND_TELEMETRY(true, SCHEMA_TELEMETRY(otaWindowStartUtc, windowString),
+                                                SCHEMA_TELEMETRY(otaWindowDelay, newDelayTime),
+                                                SCHEMA_TELEMETRY(otaWindowActivity, windowScore),
+                                                SCHEMA_TELEMETRY(otaPredictedGapSecs, otaActivity.predictedGapSeconds));
+#endif // IOT_HUB_APPLICATION
+
+                    // We're in the quietest window right now, let the update proceed
+                    if(newDelayTime == 0){
+                        otaUpdateInProgress = true;
+                        pendingOtaUpdate = false;
+                        Log_Debug("INFO: Allowing update.\n");
+                        break;
+                    }
+                }
+#endif // OTA_TRAFFIC_AWARE_DEFERRAL
+
                 // If the defferedOTAUpdateTime is zero, then determine delay based on target UTC tod (Hr:Min)
                 // calculate the delay time from now until the target time
                 if(newDelayTime == 0){
@@ -330,8 +462,7 @@ static void deferredOtaUpdateCallback(SysEvent_Events event, SysEvent_Status sta
                 // message my not be sent.  Consider enabling the ENABLE_TELEMETRY_RESEND_LOGIC build flag so 
                 // that this telemetry message will be queued up and sent as soon as the IoTHub connection is 
                 // established.
-                Cloud_SendTelemetry(true, 1*ARGS_PER_TELEMETRY_ITEM, 
-                              TYPE_INT, "otaUpdateDelayPeriod", newDelayTime);
+                SCHEMA_SEND_TELEMETRY(true, SCHEMA_TELEMETRY(otaUpdateDelayPeriod, newDelayTime));
 
 #endif // defined(SEND_OTA_STATUS_TELEMETRY) && defined(IOT_HUB_APPLICATION)
             }
@@ -345,6 +476,13 @@ static void deferredOtaUpdateCallback(SysEvent_Events event, SysEvent_Status sta
 #ifdef ENABLE_OTA_DEBUG_TO_UART        
             SendUartMessage("INFO: Final update. App will update in 10 seconds.\n\r");
 #endif // ENABLE_OTA_DEBUG_TO_UART        
+#ifdef OTA_TRAFFIC_AWARE_DEFERRAL
+            // Save the histogram and remember when we last sent telemetry so we can report the
+            // actual data gap after the update has been applied.
+            otaActivity.lastTelemetryTime = lastTelemetrySentTime;
+            otaActivity.gapReportPending = (lastTelemetrySentTime != 0);
+            WriteOtaActivityToMutableFile();
+#endif // OTA_TRAFFIC_AWARE_DEFERRAL
             // Terminate app before it is forcibly shut down and replaced.
             // The application may be restarted before the update is applied.
             exitCode = ExitCode_UpdateCallback_FinalUpdate;
@@ -538,8 +676,10 @@ void setOtaTargetUtcTime(void* thisTwinPtr, JSON_Object *desiredProperties){
 
         // The string is NOT empty, move the string into the local variable that we'll manuipulate.  Make a clean copy to return with the 
         // reported property message.
-        strncpy((char *)tempTargetTime, (char *)json_object_get_string(desiredProperties, localTwinPtr->twinKey), 16);
-        strncpy(returnString, tempTargetTime, strlen(tempTargetTime));
+        strncpy(tempTargetTime, json_object_get_string(desiredProperties, localTwinPtr->twinKey), sizeof(tempTargetTime) - 1);
+        tempTargetTime[sizeof(tempTargetTime) - 1] = '\0';
+        // strncpy() zero filled tempTargetTime, copy the first 8 characters, HH:MM:xx
+        memcpy(returnString, tempTargetTime, sizeof(returnString) - 1);
 
         // The incomming data must be in the following format: "HH:MM:xx"
         //
@@ -614,6 +754,17 @@ void setOtaTargetUtcTime(void* thisTwinPtr, JSON_Object *desiredProperties){
                     return;
             }
         }
+#ifdef OTA_TRAFFIC_AWARE_DEFERRAL
+        // "auto", select the update window from the activity histogram
+        else if ((stringSize == 4) && (strncmp(tempTargetTime, "auto", 4) == 0)){
+            otaTargetUtcHour = OTA_TARGET_UTC_AUTO;
+            otaTargetUtcMinute = 0;
+            acceptOtaUpdate = false;
+            deferredOtaUpdateTime = 0;
+
+            // Fall through to write these values to mutable storage
+        }
+#endif // OTA_TRAFFIC_AWARE_DEFERRAL
         // The string is empty, disable the deferred update logic
         else if (stringSize == 0){
             Log_Debug("Empty string, disable deferring OTA updates!\n");
@@ -625,7 +776,7 @@ void setOtaTargetUtcTime(void* thisTwinPtr, JSON_Object *desiredProperties){
         }
         // The string is the incorrect length and therefore can't be processed
         else{
-            Log_Debug("ERROR: String is incorrect length: %d!\n", stringSize);
+            Log_Debug("ERROR: String is incorrect length: %zu!\n", stringSize);
             return;
         }
     }
@@ -648,6 +799,12 @@ void setOtaTargetUtcTime(void* thisTwinPtr, JSON_Object *desiredProperties){
         SysEvent_ResumeEvent(SysEvent_Events_UpdateReadyForInstall);
     }
 
+#ifdef OTA_TRAFFIC_AWARE_DEFERRAL
+    if(otaTargetUtcHour == OTA_TARGET_UTC_AUTO){
+        Log_Debug("Defering next OTA update until the lowest activity window\n");
+    }
+    else
+#endif // OTA_TRAFFIC_AWARE_DEFERRAL
     Log_Debug("Defering next OTA update until %d:%d UTC\n", otaTargetUtcHour, otaTargetUtcMinute);
 #ifdef ENABLE_OTA_DEBUG_TO_UART    
     SendUartMessage("Defering next OTA update until.\n\r");
@@ -697,7 +854,7 @@ static bool WriteDelayTimeUTCToMutableFile(delayTimeUTC_t dataToWrite)
         // For simplicity, this sample logs an error here. In the general case, this should be
         // handled by retrying the write with the remaining data until all the data has been
         // written.
-        Log_Debug("ERROR: Only wrote %d of %d bytes requested\n", ret, (int)sizeof(delayTimeUTC_t));
+        Log_Debug("ERROR: Only wrote %zd of %d bytes requested\n", ret, (int)sizeof(delayTimeUTC_t));
         returnValue = false;
     }
     close(fd);
@@ -729,3 +886,349 @@ static bool ReadDelayTimeUTCFromMutableFile(delayTimeUTC_t* readData)
 
     return true;
 }
+
+#ifdef OTA_TRAFFIC_AWARE_DEFERRAL
+/// <summary>
+///     Record a telemetry send in the activity histogram.  Called from Cloud_SendTelemetry()
+///
+///     The first successful send after an update has been applied also reports the actual
+///     data gap.
+/// </summary>
+void otaActivity_RecordTelemetry(bool sent){
+
+    time_t now = time(NULL);
+    otaActivity_Tick(now);
+    hourTelemetryCount++;
+
+    if(!sent){
+        return;
+    }
+
+    lastTelemetrySentTime = now;
+
+    if(otaActivity.gapReportPending){
+
+        // Clear the flag first, we're about to send telemetry and will be called again
+        otaActivity.gapReportPending = false;
+        WriteOtaActivityToMutableFile();
+
+        int actualGapSeconds = (int)(now - otaActivity.lastTelemetryTime);
+        Log_Debug("INFO: OTA data gap %d seconds, predicted %d seconds\n", actualGapSeconds, otaActivity.predictedGapSeconds);
+
+#ifdef IOT_HUB_APPLICATION
+        SCHEMA_SEND_TELEMETRY(true, SCHEMA_TELEMETRY(otaActualGapSecs, actualGapSeconds),
+                                    SCHEMA_TELEMETRY(otaPredictedGapSecs, otaActivity.predictedGapSeconds));
+#endif // IOT_HUB_APPLICATION
+    }
+}
+
+/// <summary>
+///     Record a direct method call in the activity histogram.  Called from DeviceMethodCallbackHandler()
+/// </summary>
+void otaActivity_RecordDirectMethod(void){
+
+    otaActivity_Tick(time(NULL));
+    hourDirectMethodCount++;
+}
+
+/// <summary>
+///     otaActivityTimer event:  Sample the telemetry resend queue depth and close out the
+///     current hour if needed
+/// </summary>
+static void otaActivityTimerEventHandler(EventLoopTimer *timer){
+
+    if (ConsumeEventLoopTimerEvent(timer) != 0) {
+        exitCode = ExitCode_TelemetryTimer_Consume;
+        return;
+    }
+
+    otaActivity_Tick(time(NULL));
+
+#if defined(IOT_HUB_APPLICATION) && defined(ENABLE_TELEMETRY_RESEND_LOGIC)
+    hourQueueDepthSum += GetListLength();
+#endif // defined(IOT_HUB_APPLICATION) && defined(ENABLE_TELEMETRY_RESEND_LOGIC)
+    hourQueueDepthSamples++;
+}
+
+/// <summary>
+///     Check to see if we moved into a new hour.  If so fold the counters for the hour we just
+///     finished into the histogram and start counting for the new hour.
+/// </summary>
+static void otaActivity_Tick(time_t now){
+
+    struct tm tNow;
+    memcpy(&tNow, gmtime(&now), sizeof(struct tm));
+
+    if(tNow.tm_hour == activityHour){
+        return;
+    }
+
+    // Only use the hour if we observed enough of it, a partial hour after startup would make
+    // the hour look quieter than it really is.
+    time_t observedSeconds = now - activityHourStart;
+    if((activityHour >= 0) && (observedSeconds >= OTA_MIN_OBSERVED_SECONDS)){
+
+        // Scale the counts to a full hour
+        float scale = 3600.0f / (float)observedSeconds;
+        float telemetry = (float)hourTelemetryCount * scale;
+        float directMethods = (float)hourDirectMethodCount * scale;
+        float queueDepth = (hourQueueDepthSamples > 0) ? (float)hourQueueDepthSum / (float)hourQueueDepthSamples : 0.0f;
+
+        otaActivityBucket_t *bucket = &otaActivity.bucket[activityHour];
+        if(bucket->daysObserved == 0){
+            bucket->avgTelemetry = telemetry;
+            bucket->avgDirectMethods = directMethods;
+            bucket->avgQueueDepth = queueDepth;
+        }
+        else{
+            bucket->avgTelemetry += OTA_ACTIVITY_ALPHA * (telemetry - bucket->avgTelemetry);
+            bucket->avgDirectMethods += OTA_ACTIVITY_ALPHA * (directMethods - bucket->avgDirectMethods);
+            bucket->avgQueueDepth += OTA_ACTIVITY_ALPHA * (queueDepth - bucket->avgQueueDepth);
+        }
+
+        if(bucket->daysObserved < UINT16_MAX){
+            bucket->daysObserved++;
+        }
+
+        // Save the histogram once a day so we don't lose everything on a restart
+        if(tNow.tm_hour == 0){
+            WriteOtaActivityToMutableFile();
+        }
+    }
+
+    // Start counting for the new hour
+    activityHour = tNow.tm_hour;
+    activityHourStart = now;
+    hourTelemetryCount = 0;
+    hourDirectMethodCount = 0;
+    hourQueueDepthSum = 0;
+    hourQueueDepthSamples = 0;
+}
+
+/// <summary>
+///     Calculate the activity score for one hour of the day, lower is quieter
+/// </summary>
+static float otaActivity_Score(const otaActivityBucket_t *bucket){
+
+    return bucket->avgTelemetry + 
+           (OTA_DIRECT_METHOD_WEIGHT * bucket->avgDirectMethods) + 
+           (OTA_QUEUE_DEPTH_WEIGHT * bucket->avgQueueDepth);
+}
+
+/// <summary>
+///     Find the lowest activity hour that starts within maxDeferralMinutes from now.  
+///
+///     Returns the number of minutes to defer the update, zero if the update should be
+///     applied right away.  Ties go to the earliest hour.
+/// </summary>
+static int otaActivity_SelectWindow(int maxDeferralMinutes, int *windowHour, float *windowScore){
+
+    time_t timeNow = time(NULL);
+    struct tm tNow;
+    memcpy(&tNow, gmtime(&timeNow), sizeof(struct tm));
+
+    int bestDelay = 0;
+    *windowHour = tNow.tm_hour;
+    *windowScore = -1.0f;
+
+    for(int i = 0; i < OTA_ACTIVITY_HOURS; i++){
+
+        // The current hour can start right away, the others start at the top of the hour
+        int delay = (i == 0) ? 0 : (i * 60) - tNow.tm_min;
+        if(delay > maxDeferralMinutes){
+            break;
+        }
+
+        int hour = (tNow.tm_hour + i) % OTA_ACTIVITY_HOURS;
+        const otaActivityBucket_t *bucket = &otaActivity.bucket[hour];
+
+        // Skip hours we don't know anything about
+        if(bucket->daysObserved == 0){
+            continue;
+        }
+
+        float score = otaActivity_Score(bucket);
+        if((*windowScore < 0.0f) || (score < *windowScore)){
+            *windowScore = score;
+            *windowHour = hour;
+            bestDelay = delay;
+        }
+    }
+
+    if(*windowScore < 0.0f){
+        Log_Debug("INFO: No activity history, allowing update now\n");
+    }
+
+    return bestDelay;
+}
+
+/// <summary>
+/// Write the activity histogram to the device's persistent data file.  The data lives
+/// directly after the delayTimeUTC_t data.
+/// </summary>
+static bool WriteOtaActivityToMutableFile(void)
+{
+    bool returnValue = true;
+
+#ifdef ENABLE_WORK_QUEUE
+    // Write from a worker thread so a slow flash write does not hold up the event loop.  Fall
+    // back to writing here if the work queue is not running or is full.
+    if (WriteOtaActivityOnWorker()) {
+        return true;
+    }
+#endif // ENABLE_WORK_QUEUE
+
+    int fd = Storage_OpenMutableFile();
+    if (fd == -1) {
+        Log_Debug("ERROR: Could not open mutable file:  %s (%d).\n", strerror(errno), errno);
+        exitCode = ExitCode_WriteFile_OpenMutableFile;
+        return false;
+    }
+
+    // If the delayTimeUTC_t data has never been written, write the current settings first.  Otherwise
+    // the hole in front of our data would read back as valid delayTimeUTC_t data.
+    if (lseek(fd, 0, SEEK_END) < (off_t)sizeof(delayTimeUTC_t)){
+        delayTimeUTC_t delayData = {.OTATargetUtcHour = otaTargetUtcHour,
+                                    .OTATargetUtcMinute = otaTargetUtcMinute,
+                                    .ACCEPTOtaUpdate = acceptOtaUpdate};
+        ssize_t written = pwrite(fd, &delayData, sizeof(delayTimeUTC_t), 0);
+        if (written == -1){
+            Log_Debug("ERROR: An error occurred while writing to mutable file:  %s (%d).\n",
+                      strerror(errno), errno);
+            close(fd);
+            return false;
+        }
+        if (written < sizeof(delayTimeUTC_t)){
+            Log_Debug("ERROR: Only wrote %zd of %d bytes requested\n", written, (int)sizeof(delayTimeUTC_t));
+            close(fd);
+            return false;
+        }
+    }
+
+    ssize_t ret = pwrite(fd, &otaActivity, sizeof(otaActivityState_t), sizeof(delayTimeUTC_t));
+    if (ret == -1) {
+        Log_Debug("ERROR: An error occurred while writing to mutable file:  %s (%d).\n",
+                  strerror(errno), errno);
+        exitCode = ExitCode_WriteFile_Write;
+        returnValue = false;
+    } else if (ret < sizeof(otaActivityState_t)) {
+        Log_Debug("ERROR: Only wrote %zd of %d bytes requested\n", ret, (int)sizeof(otaActivityState_t));
+        returnValue = false;
+    }
+    close(fd);
+    return returnValue;
+}
+
+#ifdef ENABLE_WORK_QUEUE
+/// <summary>
+/// Open the mutable file on the main thread and queue the writes.  Returns false if the job
+/// could not be queued.
+/// </summary>
+static bool WriteOtaActivityOnWorker(void)
+{
+    otaActivityWrite_t *writeData = malloc(sizeof(otaActivityWrite_t));
+    if (writeData == NULL) {
+        return false;
+    }
+
+    writeData->fd = Storage_OpenMutableFile();
+    if (writeData->fd == -1) {
+        free(writeData);
+        return false;
+    }
+
+    // Same rule as WriteOtaActivityToMutableFile(), write the delayTimeUTC_t data first if the
+    // file is too short to hold it
+    writeData->writeDelayData = (lseek(writeData->fd, 0, SEEK_END) < (off_t)sizeof(delayTimeUTC_t));
+    writeData->delayData.OTATargetUtcHour = otaTargetUtcHour;
+    writeData->delayData.OTATargetUtcMinute = otaTargetUtcMinute;
+    writeData->delayData.ACCEPTOtaUpdate = acceptOtaUpdate;
+    writeData->activity = otaActivity;
+
+    if (!workQueue_Submit(otaActivityWriteJob, otaActivityWriteComplete, writeData)) {
+        close(writeData->fd);
+        free(writeData);
+        return false;
+    }
+
+    return true;
+}
+
+/// <summary>
+/// Worker thread: write the snapshot and close the file.  Returns 0, the errno value if pwrite()
+/// failed, or EIO for a short write.  The failed write is recorded in writeData for the log.
+/// </summary>
+static int otaActivityWriteJob(void *context)
+{
+    otaActivityWrite_t *writeData = (otaActivityWrite_t *)context;
+    int result = 0;
+
+    if (writeData->writeDelayData) {
+        writeData->expected = sizeof(delayTimeUTC_t);
+        writeData->written = pwrite(writeData->fd, &writeData->delayData, sizeof(delayTimeUTC_t), 0);
+        if (writeData->written != (ssize_t)writeData->expected) {
+            result = (writeData->written == -1) ? errno : EIO;
+        }
+    }
+
+    if (result == 0) {
+        writeData->expected = sizeof(otaActivityState_t);
+        writeData->written = pwrite(writeData->fd, &writeData->activity, sizeof(otaActivityState_t),
+                                    sizeof(delayTimeUTC_t));
+        if (writeData->written != (ssize_t)writeData->expected) {
+            result = (writeData->written == -1) ? errno : EIO;
+        }
+    }
+
+    close(writeData->fd);
+    return result;
+}
+
+/// <summary>
+/// Main thread: report the result of the write
+/// </summary>
+static void otaActivityWriteComplete(void *context, int result)
+{
+    otaActivityWrite_t *writeData = (otaActivityWrite_t *)context;
+
+    if (result != 0) {
+        if (writeData->written == -1) {
+            Log_Debug("ERROR: An error occurred while writing to mutable file:  %s (%d).\n",
+                      strerror(result), result);
+            exitCode = ExitCode_WriteFile_Write;
+        } else {
+            Log_Debug("ERROR: Only wrote %zd of %zu bytes requested\n", writeData->written,
+                      writeData->expected);
+        }
+    }
+
+    free(writeData);
+}
+#endif // ENABLE_WORK_QUEUE
+
+/// <summary>
+///  Read the activity histogram from mutable storage
+/// </summary>
+static bool ReadOtaActivityFromMutableFile(otaActivityState_t *readData)
+{
+    int fd = Storage_OpenMutableFile();
+    if (fd == -1) {
+        Log_Debug("ERROR: Could not open mutable file:  %s (%d).\n", strerror(errno), errno);
+        exitCode = ExitCode_ReadFile_OpenMutableFile;
+        return false;
+    }
+    ssize_t ret = pread(fd, readData, sizeof(otaActivityState_t), sizeof(delayTimeUTC_t));
+    if (ret == -1) {
+        Log_Debug("ERROR: An error occurred while reading file:  %s (%d).\n", strerror(errno),
+                  errno);
+        exitCode = ExitCode_ReadFile_Read;
+    }
+    close(fd);
+
+    if ((ret < sizeof(otaActivityState_t)) || (readData->signature != OTA_ACTIVITY_SIGNATURE)) {
+        return false;
+    }
+
+    return true;
+}
+#endif // OTA_TRAFFIC_AWARE_DEFERRAL
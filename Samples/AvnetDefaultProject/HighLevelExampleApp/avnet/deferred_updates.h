@@ -61,6 +61,37 @@ typedef struct {
 // Variables to hold a target UTC time to apply updates.  Initialize to invalid values.
 //extern char otaTargetUtcTime[];
 
+#ifdef OTA_TRAFFIC_AWARE_DEFERRAL
+
+// otaTargetUtcHour value used when the device twin "otaTargetUtcTime" is set to "auto"
+#define OTA_TARGET_UTC_AUTO -1
+
+#define OTA_ACTIVITY_HOURS 24
+
+// Define one hour of day entry in the activity histogram.  Values are exponentially
+// weighted averages across days.
+typedef struct {
+    float avgTelemetry;         // Telemetry messages per hour
+    float avgDirectMethods;     // Direct method calls per hour
+    float avgQueueDepth;        // Mean telemetry resend queue depth
+    uint16_t daysObserved;      // Number of times this hour has been closed out
+} otaActivityBucket_t;
+
+// Define the structure we write/read to/from mutable storage after the delayTimeUTC_t data
+typedef struct {
+    uint32_t signature;
+    otaActivityBucket_t bucket[OTA_ACTIVITY_HOURS];
+    time_t lastTelemetryTime;   // Last telemetry sent before the update was applied
+    int predictedGapSeconds;    // Data gap predicted when the window was selected
+    bool gapReportPending;      // Report the actual gap once telemetry is sent again
+} otaActivityState_t;
+
+// Functions to feed the activity histogram
+void otaActivity_RecordTelemetry(bool sent);
+void otaActivity_RecordDirectMethod(void);
+
+#endif // OTA_TRAFFIC_AWARE_DEFERRAL
+
 ExitCode deferredOtaUpdate_Init(void);
 void deferredOtaUpdate_Cleanup(void);
 ExitCode WaitForSigTerm(time_t);
@@ -46,6 +46,16 @@ SOFTWARE.
 #include "../common/exitcodes.h"
 #include "build_options.h"
 #include "m4_support.h"
+#include "mem_accounting.h"
+#include "../common/app_log.h"
+#include "sensor_registry.h"
+#include "rules_engine.h"
+#include "live_mode.h"
+#include "../common/anomaly_detector.h"
+#include "../common/adaptive_period.h"
+#include "../common/key_dictionary.h"
+#include "deferred_updates.h"
+#include "../common/schema_keys.h"
 
 #include <applibs/eventloop.h>
 #include "eventloop_timer_utilities.h"
@@ -71,7 +81,13 @@ int sendTelemetryPeriod = SEND_TELEMETRY_PERIOD_SECONDS;
 // update, and used when we send a device twin reported property
 int desiredVersion = 0;
 
+// True while the handlers run for a desired properties patch, false for the full twin that is
+// sent on connect.  The full twin repeats desired values that have already been handled.
+bool desiredPatch = false;
+
 // Define each device twin key that we plan to catch, process, and send reported property for.
+// The entries are generated from SCHEMA_GPIO_TWIN_LIST and SCHEMA_TWIN_LIST in schema.h, add new
+// device twins there.
 // .twinKey - The JSON Key piece of the key: value pair
 // .twinVar - The address of the application variable keep this key: value pair data
 // .twinFD - The associated File Descriptor for this item.  This is usually a GPIO FD.  NULL if NA.
@@ -81,99 +97,35 @@ int desiredVersion = 0;
 // .twinHandler - The handler that will be called for this device twin.  The function must have the signaure 
 //                void <yourFunctionName>(void* thisTwinPtr, JSON_Object *desiredProperties);
 // 
-twin_t twinArray[] = {
-#ifndef GUARDIAN_100
-	{
-        .twinKey = "appLed",
-        .twinVar = &appLedIsOn,
-        .twinFd = &appLedFd,
-        .twinGPIO = SAMPLE_APP_LED,
-        .twinType = TYPE_BOOL,
-        .active_high = false,
-        .twinHandler = (genericGPIODTFunction)
-    },
-#endif // !GUARDIAN_100    
-    {
-        .twinKey = "sensorPollPeriod",
-        .twinVar = &readSensorPeriod,
-        .twinFd = NULL,
-        .twinGPIO = NO_GPIO_ASSOCIATED_WITH_TWIN,
-        .twinType = TYPE_INT,
-        .active_high = true,
-        .twinHandler = (setSensorPollTimerFunction)
-    },   
-    {
-        .twinKey = "telemetryPeriod",
-        .twinVar = &sendTelemetryPeriod,
-        .twinFd = NULL,
-        .twinGPIO = NO_GPIO_ASSOCIATED_WITH_TWIN,
-        .twinType = TYPE_INT,
-        .active_high = true,
-        .twinHandler = (setTelemetryTimerFunction)
-    },
-#ifdef M4_INTERCORE_COMMS
-    {
-        .twinKey = "realTimeAutoTelemetryPeriod",
-        .twinVar = &realTimeAutoTelemetryInterval,
-        .twinFd = NULL,
-        .twinGPIO = NO_GPIO_ASSOCIATED_WITH_TWIN,
-        .twinType = TYPE_INT,
-        .active_high = true,
-        .twinHandler = (setRealTimeTelemetryInterval)
-    },
-#endif     
-#ifdef OLED_SD1306	
-    {
-        .twinKey = "OledDisplayMsg1",
-        .twinVar = oled_ms1,
-        .twinFd = NULL,
-        .twinGPIO = NO_GPIO_ASSOCIATED_WITH_TWIN,
-        .twinType = TYPE_STRING,
-        .active_high = true,
-        .twinHandler = (genericStringDTFunction)
-    },
-	{
-        .twinKey = "OledDisplayMsg2",
-        .twinVar = oled_ms2,
-        .twinFd = NULL,
-        .twinGPIO = NO_GPIO_ASSOCIATED_WITH_TWIN,
-        .twinType = TYPE_STRING,
-        .active_high = true,
-        .twinHandler = (genericStringDTFunction)
+#define SCHEMA_GPIO_TWIN_ENTRY(key, variable, fd, gpio, activeHigh, description) \
+    {                                                                               \
+        .twinKey = SCHEMA_KEY(key),                                                 \
+        .twinVar = SCHEMA_VARIABLE_BOOL(variable),                                  \
+        .twinFd = fd,                                                               \
+        .twinGPIO = gpio,                                                           \
+        .twinType = TYPE_BOOL,                                                      \
+        .active_high = activeHigh,                                                  \
+        .twinHandler = (genericGPIODTFunction)                                      \
     },
-	{
-        .twinKey = "OledDisplayMsg3",
-        .twinVar = oled_ms3,
-        .twinFd = NULL,
-        .twinGPIO = NO_GPIO_ASSOCIATED_WITH_TWIN,
-        .twinType = TYPE_STRING,
-        .active_high = true,
-        .twinHandler = (genericStringDTFunction)
+#define SCHEMA_TWIN_ENTRY(key, type, variable, handler, description)               \
+    {                                                                               \
+        .twinKey = SCHEMA_KEY(key),                                                 \
+        .twinVar = SCHEMA_VARIABLE_##type(variable),                                \
+        .twinFd = NULL,                                                             \
+        .twinGPIO = NO_GPIO_ASSOCIATED_WITH_TWIN,                                   \
+        .twinType = TYPE_##type,                                                    \
+        .active_high = true,                                                        \
+        .twinHandler = (handler)                                                    \
     },
-	{
-        .twinKey = "OledDisplayMsg4",
-        .twinVar = oled_ms4,
-        .twinFd = NULL,
-        .twinGPIO = NO_GPIO_ASSOCIATED_WITH_TWIN,
-        .twinType = TYPE_STRING,
-        .active_high = true,
-        .twinHandler = (genericStringDTFunction)
-    },
-#endif  
-#ifdef DEFER_OTA_UPDATES
-    {   // Define a target time UTC "HR:MN" and defer OTA updates until that time
-        .twinKey = "otaTargetUtcTime",
-        .twinVar = NULL,  // Note this entry is NULL only because the custom handler does not utilize the entry
-        .twinFd = NULL,  
-        .twinGPIO = NO_GPIO_ASSOCIATED_WITH_TWIN,
-        .twinType = TYPE_STRING,
-        .active_high = true,
-        .twinHandler = (setOtaTargetUtcTime)
-    }  
-#endif  
+
+twin_t twinArray[] = {
+    SCHEMA_GPIO_TWIN_LIST(SCHEMA_GPIO_TWIN_ENTRY)
+    SCHEMA_TWIN_LIST(SCHEMA_TWIN_ENTRY)
 };
 
-// Calculate how many twin_t items are in the array.  We use this to iterate through the structure.
+#undef SCHEMA_GPIO_TWIN_ENTRY
+#undef SCHEMA_TWIN_ENTRY
+
 int twinArraySize = sizeof(twinArray) / sizeof(twin_t);
 
 ///<summary>
@@ -248,9 +200,9 @@ void genericGPIODTFunction(void* thisTwinPtr, JSON_Object *desiredProperties){
     
     // Check to make sure we we able to set the GPIO signal
     if (result != 0) {
-        Log_Debug("Fd: %d\n", localTwinPtr->twinFd);
+        Log_Debug("Fd: %d\n", *localTwinPtr->twinFd);
         Log_Debug("FAILURE: Could not set GPIO_%d, %d output value %d: %s (%d).\n",
-                    localTwinPtr->twinGPIO, localTwinPtr->twinFd,
+                    localTwinPtr->twinGPIO, *localTwinPtr->twinFd,
                     (GPIO_Value) * (bool *)localTwinPtr->twinVar, strerror(errno), errno);
         exitCode = ExitCode_SetGPIO_Failed;
     }
@@ -304,15 +256,19 @@ void setSensorPollTimerFunction(void* thisTwinPtr, JSON_Object *desiredPropertie
     // Make sure that the new timer variable is not zero or negitive
     if(tempSensorPollPeriod > 0){
 
+#ifndef ENABLE_SENSOR_REGISTRY
  	    // Define a new timespec variable for the timer and change the timer period
 	    struct timespec newPeriod = { .tv_sec = tempSensorPollPeriod,.tv_nsec = 0 };
         SetEventLoopTimerPeriod(sensorPollTimer, &newPeriod);
+#endif // !ENABLE_SENSOR_REGISTRY
 
     }
     else if(tempSensorPollPeriod == 0){
 
+#ifndef ENABLE_SENSOR_REGISTRY
         // If the new period is zero, then stop the timer
         DisarmEventLoopTimer(sensorPollTimer);
+#endif // !ENABLE_SENSOR_REGISTRY
     
     }
     else{
@@ -331,6 +287,11 @@ void setSensorPollTimerFunction(void* thisTwinPtr, JSON_Object *desiredPropertie
     // Send the reported property to the IoTHub
     Log_Debug("Received device update. New %s is %d\n", localTwinPtr->twinKey, *(int *)localTwinPtr->twinVar);
     updateDeviceTwin(true, ARGS_PER_TWIN_ITEM*1, TYPE_INT, localTwinPtr->twinKey, *(int *)localTwinPtr->twinVar);
+
+#ifdef ENABLE_SENSOR_REGISTRY
+    // Reschedule the sensors that use the default period
+    sensorRegistry_DefaultPeriodChanged();
+#endif // ENABLE_SENSOR_REGISTRY
 }
 
 #ifdef M4_INTERCORE_COMMS
@@ -392,7 +353,7 @@ Cloud_Result updateDeviceTwin(bool ioTRwFormat, int arg_count, ...)
 	char* resultTxt = "Property successfully updated";
 
     // Allocate a buffer to build dynamic keys
-    char* pjsonBuffer = (char *)malloc(LOCAL_BUFFER_SIZE);
+    char* pjsonBuffer = (char *)APP_MALLOC(MEM_TAG_DEVICE_TWIN, LOCAL_BUFFER_SIZE);
     if (pjsonBuffer == NULL) {
 		Log_Debug("ERROR: not enough memory to report device twin changes.");
 	}
@@ -454,20 +415,24 @@ Cloud_Result updateDeviceTwin(bool ioTRwFormat, int arg_count, ...)
 
             int dataType = va_arg(inputList, int);
             // Pull the data type from the list 
+
+            // Pull the current "key" before the value, the order two va_arg() calls
+            // in the same argument list are evaluated in is unspecified
+            char* keyString = va_arg(inputList, char*);
             switch (dataType) {
 
 		        // report current device twin data as reported properties to IoTHub
 		        case TYPE_BOOL:
-                    json_object_dotset_boolean(root_object, va_arg(inputList, char*), va_arg(inputList, int)? 1: 0);
+                    json_object_dotset_boolean(root_object, keyString, va_arg(inputList, int)? 1: 0);
 			        break;
 		        case TYPE_FLOAT:
-                    json_object_dotset_number(root_object, va_arg(inputList, char*), va_arg(inputList, double));
+                    json_object_dotset_number(root_object, keyString, va_arg(inputList, double));
 			        break;
 		        case TYPE_INT:
-                    json_object_dotset_number(root_object, va_arg(inputList, char*), va_arg(inputList, int));
+                    json_object_dotset_number(root_object, keyString, va_arg(inputList, int));
 			        break;
  		        case TYPE_STRING:
-                    json_object_dotset_string(root_object, va_arg(inputList, char*), va_arg(inputList, char*));
+                    json_object_dotset_string(root_object, keyString, va_arg(inputList, char*));
 			        break;
 	        }
         }
@@ -486,6 +451,7 @@ Cloud_Result updateDeviceTwin(bool ioTRwFormat, int arg_count, ...)
         Log_Debug("WARNING: Could not send device twin update to cloud: %s\n", CloudResultToString(result));
 
         // Output the device update to help debug the issue
+        json_free_serialized_string(serializedJson);
         serializedJson = json_serialize_to_string_pretty(root_value);
         Log_Debug("%s\n", serializedJson);
     }
@@ -496,7 +462,7 @@ Cloud_Result updateDeviceTwin(bool ioTRwFormat, int arg_count, ...)
     
 #ifdef USE_PNP    
     if(pjsonBuffer != NULL){
-        free(pjsonBuffer);
+        APP_FREE(pjsonBuffer);
     }
 #endif 
 
@@ -521,6 +487,7 @@ void DeviceTwinCallbackHandler(const char *nullTerminatedJsonString)
 
     JSON_Object *rootObject = json_value_get_object(rootProperties);
     JSON_Object *desiredProperties = json_object_dotget_object(rootObject, "desired");
+    desiredPatch = (desiredProperties == NULL);
     if (desiredProperties == NULL) {
         desiredProperties = rootObject;
     }
@@ -545,6 +512,11 @@ void DeviceTwinCallbackHandler(const char *nullTerminatedJsonString)
         }
     }
 
+#ifdef ENABLE_SENSOR_REGISTRY
+    // The sensor registry generates a <sensorName>PeriodMs key for each sensor
+    sensorRegistry_DeviceTwinHandler(desiredProperties);
+#endif // ENABLE_SENSOR_REGISTRY
+
 cleanup:
     // Release the allocated memory.
     json_value_free(rootProperties);
@@ -581,6 +553,10 @@ void sendInitialDeviceTwinReportedProperties(void)
             break;
         }
     }
+
+#ifdef ENABLE_SENSOR_REGISTRY
+    sensorRegistry_SendReportedPeriods();
+#endif // ENABLE_SENSOR_REGISTRY
 }
 
 /// <summary>
@@ -640,8 +616,12 @@ void setTelemetryTimerFunction(void* thisTwinPtr, JSON_Object *desiredProperties
     // Updte the variable referenced in the twin table
     *(int *)(twin_t*)localTwinPtr->twinVar = (int)json_object_get_number(desiredProperties, localTwinPtr->twinKey);
     
+    // The adaptive scheduler owns the timer, the new value is its starting and fallback period
+    if(ADAPTIVE_PERIOD_ENABLED()){
+        Log_Debug("Adaptive telemetry period is enabled, %s only sets the starting period\n", localTwinPtr->twinKey);
+    }
     // Make sure that the new timer variable is not zero or negitive
-    if(*(int *)localTwinPtr->twinVar > 0){
+    else if(*(int *)localTwinPtr->twinVar > 0){
 
  	    // Define a new timespec variable for the timer and change the timer period
 	    struct timespec newPeriod = { .tv_sec = *(int *)localTwinPtr->twinVar,.tv_nsec = 0 };
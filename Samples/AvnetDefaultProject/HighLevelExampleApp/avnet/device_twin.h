@@ -90,8 +90,10 @@ extern volatile sig_atomic_t exitCode;
 extern EventLoopTimer *telemetrytxIntervalr;
 extern EventLoopTimer *sensorPollTimer;
 extern int readSensorPeriod;
+extern int sendTelemetryPeriod;
 
 int desiredVersion;
+extern bool desiredPatch;
 
 // Declare any device twin handlers here
 void genericIntDTFunction(void* thisTwinPtr, JSON_Object *desiredProperties);
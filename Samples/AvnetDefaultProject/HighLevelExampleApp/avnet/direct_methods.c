@@ -44,10 +44,39 @@ Direct Method implementation for Azure Sphere
 #include "direct_methods.h"
 #include "../common/exitcodes.h"
 
+char *dmSerializeResponse(JSON_Value *responseValue)
+{
+    // Parson's allocations may be tracked by the heap accounting, the response is released with
+    // free() by the Azure IoT library so copy it with strdup()
+    char *response = NULL;
+    char *serializedJson = json_serialize_to_string(responseValue);
+    if (serializedJson != NULL) {
+        response = strdup(serializedJson);
+        json_free_serialized_string(serializedJson);
+    }
+    json_value_free(responseValue);
+    return response;
+}
+
 #ifdef IOT_HUB_APPLICATION
 
 #include <stdlib.h>
 #include "../common/cloud.h"
+#include "mem_accounting.h"
+#ifdef OTA_TRAFFIC_AWARE_DEFERRAL
+#include "deferred_updates.h"
+#endif 
+#include "../common/trace_ring.h"
+#include "../common/latency_trace.h"
+#include "../common/boot_timeline.h"
+#include "../common/wakeup_profile.h"
+#include "../common/work_queue.h"
+#include "../common/anomaly_detector.h"
+#include "../common/timeseries_store.h"
+#include "live_mode.h"
+#include "../common/telemetry_pipeline.h"
+#include "../common/adaptive_period.h"
+#include "../common/schema_keys.h"
 
 EventLoopTimer *rebootDeviceTimer = NULL;
 
@@ -61,7 +90,37 @@ EventLoopTimer *rebootDeviceTimer = NULL;
 direct_method_t dmArray[] = {
 	{.dmName = "test",.dmPayloadRequired=true,.dmInit=dmTestInitFunction,.dmHandler=dmTestHandlerFunction,.dmCleanup=dmTestCleanupFunction},
     {.dmName = "rebootDevice",.dmPayloadRequired=false,.dmInit=dmRebootInitFunction,.dmHandler=dmRebootHandlerFunction,.dmCleanup=dmRebootCleanupFunction},
-	{.dmName = "setTelemetryTxInterval",.dmPayloadRequired=true,.dmInit=NULL,.dmHandler = dmSetTelemetryTxTimeHandlerFunction,.dmCleanup=NULL}
+	{.dmName = "setTelemetryTxInterval",.dmPayloadRequired=true,.dmInit=NULL,.dmHandler = dmSetTelemetryTxTimeHandlerFunction,.dmCleanup=NULL},
+#ifdef ENABLE_HEAP_ACCOUNTING
+	{.dmName = "getHeapStats",.dmPayloadRequired=false,.dmInit=NULL,.dmHandler = dmGetHeapStatsHandlerFunction,.dmCleanup=NULL},
+#endif // ENABLE_HEAP_ACCOUNTING
+#ifdef ENABLE_TRACE_RING
+	{.dmName = "dumpTrace",.dmPayloadRequired=false,.dmInit=NULL,.dmHandler = dmDumpTraceHandlerFunction,.dmCleanup=NULL},
+#endif // ENABLE_TRACE_RING
+#ifdef ENABLE_LATENCY_TRACE
+	{.dmName = "getLatencyStats",.dmPayloadRequired=false,.dmInit=NULL,.dmHandler = dmGetLatencyStatsHandlerFunction,.dmCleanup=NULL},
+#endif // ENABLE_LATENCY_TRACE
+#ifdef ENABLE_BOOT_TIMELINE
+	{.dmName = "getBootTimeline",.dmPayloadRequired=false,.dmInit=NULL,.dmHandler = dmGetBootTimelineHandlerFunction,.dmCleanup=NULL},
+#endif // ENABLE_BOOT_TIMELINE
+#ifdef ENABLE_WAKEUP_PROFILE
+	{.dmName = "getWakeupProfile",.dmPayloadRequired=false,.dmInit=NULL,.dmHandler = dmGetWakeupProfileHandlerFunction,.dmCleanup=NULL},
+#endif // ENABLE_WAKEUP_PROFILE
+#ifdef ENABLE_WORK_QUEUE
+	{.dmName = "getWorkQueueStats",.dmPayloadRequired=false,.dmInit=NULL,.dmHandler = dmGetWorkQueueStatsHandlerFunction,.dmCleanup=NULL},
+#endif // ENABLE_WORK_QUEUE
+#ifdef ENABLE_ANOMALY_DETECTOR
+	{.dmName = "getAnomalyStats",.dmPayloadRequired=false,.dmInit=NULL,.dmHandler = dmGetAnomalyStatsHandlerFunction,.dmCleanup=NULL},
+#endif // ENABLE_ANOMALY_DETECTOR
+#ifdef ENABLE_TIMESERIES_STORE
+	{.dmName = "getHistory",.dmPayloadRequired=false,.dmInit=NULL,.dmHandler = dmGetHistoryHandlerFunction,.dmCleanup=NULL},
+#endif // ENABLE_TIMESERIES_STORE
+#ifdef ENABLE_LIVE_MODE
+	{.dmName = "liveMode",.dmPayloadRequired=false,.dmInit=NULL,.dmHandler = dmLiveModeHandlerFunction,.dmCleanup=NULL},
+#endif // ENABLE_LIVE_MODE
+#ifdef ENABLE_TELEMETRY_PIPELINE
+	{.dmName = "getPipelineStats",.dmPayloadRequired=false,.dmInit=NULL,.dmHandler = dmGetPipelineStatsHandlerFunction,.dmCleanup=NULL},
+#endif // ENABLE_TELEMETRY_PIPELINE
 };
 
 // Calculate how many twin_t items are in the array.  We use this to iterate through the structure.
@@ -146,6 +205,11 @@ extern int DeviceMethodCallbackHandler(const char *methodName, const unsigned ch
 
     Log_Debug("Received Device Method callback: Method name %s.\n", methodName);
 
+#ifdef OTA_TRAFFIC_AWARE_DEFERRAL
+    // Feed the direct method activity into the OTA activity histogram
+    otaActivity_RecordDirectMethod();
+#endif // OTA_TRAFFIC_AWARE_DEFERRAL
+
     /////////////////////////////////////////////////////////////////////////////
     //
     // Step1: Prepare the JSON payload for processing
@@ -154,7 +218,7 @@ extern int DeviceMethodCallbackHandler(const char *methodName, const unsigned ch
 
     // Copy the payload on to the heap then null terminate it
     // The maximum size direct method payload is 128KB
-    directMethodPayload = malloc(payloadSize+1);
+    directMethodPayload = APP_MALLOC(MEM_TAG_DIRECT_METHOD, payloadSize+1);
 	memcpy(directMethodPayload, payload, payloadSize);
 	directMethodPayload[payloadSize] = '\0';
 	
@@ -196,6 +260,8 @@ extern int DeviceMethodCallbackHandler(const char *methodName, const unsigned ch
             break;
         }
     }
+
+    TRACE(TRACE_EVT_DIRECT_METHOD, payloadSize, result);
     
     /////////////////////////////////////////////////////////////////////////////
     //
@@ -214,7 +280,7 @@ extern int DeviceMethodCallbackHandler(const char *methodName, const unsigned ch
 
             // Update the "pass value by reference" variables
             *responsePayloadSize = strlen(responseMsg);
-            *responsePayload = responseMsg;
+            *responsePayload = (unsigned char *)responseMsg;
             goto cleanup;
         }
         // The direct method did not create a response message, but it returned 200, so create a canned
@@ -233,7 +299,7 @@ extern int DeviceMethodCallbackHandler(const char *methodName, const unsigned ch
 		    }
         
             // Copy the canned success response string into the dynamic memory
-            strncpy (*responsePayload, successResponse, strlen(successResponse));
+            memcpy(*responsePayload, successResponse, mallocSize);
             *responsePayloadSize = mallocSize;
             goto cleanup;
         }
@@ -268,13 +334,13 @@ payloadError:
     }
         
     // Construct the response message
-    *responsePayloadSize = (size_t)snprintf(*responsePayload, mallocSize, cannedResponse, methodName);
+    *responsePayloadSize = (size_t)snprintf((char *)*responsePayload, mallocSize, cannedResponse, methodName);
 
 cleanup:    
     // Release the memory allocated by this routine
     // Note memory must be released in this order since payloadJson refers to directMethodPayload
     json_value_free(payloadJson);
-   	free (directMethodPayload);
+   	APP_FREE(directMethodPayload);
     
     return result;
 }
@@ -364,8 +430,12 @@ int dmSetTelemetryTxTimeHandlerFunction(JSON_Object *JsonPayloadObj, size_t payl
     // Construct the response message
     snprintf(*responseMsg, mallocSize, newtxIntervalResponse, newtxInterval);
 
+    // The adaptive scheduler owns the timer, the new value is its starting and fallback period
+    if(ADAPTIVE_PERIOD_ENABLED()){
+        sendTelemetryPeriod = newtxInterval;
+    }
     // Make sure that the new timer variable is not zero or negitive
-    if(newtxInterval > 0){
+    else if(newtxInterval > 0){
 
     	// Define a new timespec variable for the timer and change the timer period
 	    struct timespec newAccelReadPeriod = { .tv_sec = newtxInterval,.tv_nsec = 0 };
@@ -379,8 +449,8 @@ int dmSetTelemetryTxTimeHandlerFunction(JSON_Object *JsonPayloadObj, size_t payl
     }
 
     // Send the reported property to the IoTHub since this is also a device twin property
-    Log_Debug("Received device update from direct method. New %s is %d\n", "telemetryPeriod", newtxInterval);
-    updateDeviceTwin(true, ARGS_PER_TWIN_ITEM*1, TYPE_INT, "telemetryPeriod", newtxInterval);
+    Log_Debug("Received device update from direct method. New %s is %d\n", SCHEMA_KEY(telemetryPeriod), newtxInterval);
+    SCHEMA_UPDATE_DEVICE_TWIN(true, SCHEMA_PROPERTY(telemetryPeriod, newtxInterval));
 
 	return 200;
 }
@@ -84,6 +84,10 @@ typedef struct {
 	bool dmPayloadRequired;
 } direct_method_t;
 
+// Serialize a handler's response into memory the Azure IoT library can free() and release
+// responseValue.  Returns NULL if the response could not be allocated.
+char *dmSerializeResponse(JSON_Value *responseValue);
+
 //////////////////////////////////////////////////////////////////////////////////////
 //
 //  Functions for test directMethod
@@ -29,6 +29,8 @@ SOFTWARE.
 
 #include "iotConnect.h"
 #include "../common/cloud.h"
+#include "mem_accounting.h"
+#include "../common/boot_timeline.h"
 
 #ifdef USE_IOT_CONNECT
 
@@ -128,7 +130,7 @@ static IOTHUBMESSAGE_DISPOSITION_RESULT receiveMessageCallback(IOTHUB_MESSAGE_HA
     }
 
     // 'buffer' is not null terminated, make a copy and null terminate it.
-    unsigned char *str_msg = (unsigned char *)malloc(size + 1);
+    unsigned char *str_msg = (unsigned char *)APP_MALLOC(MEM_TAG_IOTCONNECT, size + 1);
     if (str_msg == NULL) {
         Log_Debug("ERROR: could not allocate buffer for incoming message\n");
         abort();
@@ -168,7 +170,7 @@ static IOTHUBMESSAGE_DISPOSITION_RESULT receiveMessageCallback(IOTHUB_MESSAGE_HA
 
     // Using the mesage string get a pointer to the rootMessage
     JSON_Value *rootMessage = NULL;
-    rootMessage = json_parse_string(str_msg);
+    rootMessage = json_parse_string((const char *)str_msg);
     if (rootMessage == NULL) {
         Log_Debug("WARNING: Cannot parse the string as JSON content.\n");
         goto cleanup;
@@ -220,6 +222,7 @@ static IOTHUBMESSAGE_DISPOSITION_RESULT receiveMessageCallback(IOTHUB_MESSAGE_HA
                 // Set the IoTConnect Connected flag to true
                 IoTCConnected = true;
                 Log_Debug("Set the IoTCConnected flag to true!\n");
+                BOOT_MARK(BOOT_PHASE_IOTCONNECT_READY);
             }
         }
         else{
@@ -235,7 +238,7 @@ static IOTHUBMESSAGE_DISPOSITION_RESULT receiveMessageCallback(IOTHUB_MESSAGE_HA
 cleanup:
     // Release the allocated memory.
     json_value_free(rootMessage);
-    free(str_msg);
+    APP_FREE(str_msg);
 
     return IOTHUBMESSAGE_ACCEPTED;
 }
@@ -293,10 +296,10 @@ bool FormatTelemetryForIoTConnect(const char *originalJsonMessage, char *modifie
         Log_Debug(
             "\nERROR: FormatTelemetryForIoTConnect() modified buffer size can't hold modified "
             "message\n");
-        Log_Debug("                 Original message size: %d\n", strlen(originalJsonMessage));
+        Log_Debug("                 Original message size: %zu\n", strlen(originalJsonMessage));
         Log_Debug("Additional IoTConnect message overhead: %d\n", IOTC_TELEMETRY_OVERHEAD);
-        Log_Debug("           Required target buffer size: %d\n", maxModifiedMessageSize);
-        Log_Debug("             Actural target buffersize: %d\n\n", modifiedBufferSize);
+        Log_Debug("           Required target buffer size: %zu\n", maxModifiedMessageSize);
+        Log_Debug("             Actural target buffersize: %zu\n\n", modifiedBufferSize);
         return false;
     }
 
@@ -0,0 +1,520 @@
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Live mode
+//
+//  A live session streams the sensor registry outputs at a fast rate for a bounded time.  When
+//  a session starts the registry reads every enabled sensor at least every periodMs (see
+//  sensorRegistry_SetLivePeriod()) and a sample timer copies the latest value of every output
+//  into a frame.  Every batchFrames frames one telemetry message is sent:
+//
+//      {"liveSession": 3, "liveSeq": 0, "liveOffsetMs": 0, "liveFramePeriodMs": 1000,
+//       "wifiRssi": [-52, -53, ...], "memoryHighWaterKB": [112, 112, ...]}
+//
+//  liveOffsetMs is the time of the first frame from the start of the session.  Outputs without a
+//  valid reading are null.  The batches are sent as they are, without the IoTConnect header and
+//  without the telemetry resend logic, a lost batch is not sent again.
+//
+//  Only a desired properties patch that contains liveMode starts a session.  The value left in
+//  the full twin is not run again when the device restarts or reconnects, liveMode is reported
+//  as 0 until the next update.
+//
+//  The session ends when the first of these happens, then the sensors go back to their own
+//  periods and the liveMode reported property goes back to 0:
+//
+//      - its duration is up (checked by the sample timer)
+//      - the next batch would go over maxMessages or maxBytes
+//      - liveMode is set to 0, or the direct method is called with durationSeconds 0
+//      - the watchdog timer fires LIVE_MODE_WATCHDOG_GRACE_SECONDS after the end time, in case
+//        the sample timer did not end it
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "live_mode.h"
+
+#ifdef ENABLE_LIVE_MODE
+
+#ifndef IOT_HUB_APPLICATION
+#error "ENABLE_LIVE_MODE requires IOT_HUB_APPLICATION, sessions are started from the device twin"
+#endif
+
+#include <signal.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <applibs/log.h>
+#include "../common/app_log.h"
+#include "device_twin.h"
+#include "sensor_registry.h"
+#include "../common/azure_iot.h"
+#include "../common/eventloop_timer_utilities.h"
+#include "../common/schema_keys.h"
+#include "../common/monotonic_time.h"
+#include "direct_methods.h"
+
+extern volatile sig_atomic_t exitCode;
+
+// The liveMode twin is the requested duration, the live* twins are the session settings
+int liveModeSeconds = 0;
+liveModeConfig_t liveModeConfig = {.periodMs = LIVE_MODE_DEFAULT_PERIOD_MS,
+                                   .batchFrames = LIVE_MODE_DEFAULT_BATCH_FRAMES,
+                                   .maxMessages = LIVE_MODE_DEFAULT_MAX_MESSAGES,
+                                   .maxBytes = LIVE_MODE_DEFAULT_MAX_BYTES};
+
+static const char *endReasonNames[] = {
+    [LIVE_END_NONE] = "none",
+    [LIVE_END_DURATION] = "duration",
+    [LIVE_END_MESSAGE_BUDGET] = "messageBudget",
+    [LIVE_END_BYTE_BUDGET] = "byteBudget",
+    [LIVE_END_STOPPED] = "stopped",
+    [LIVE_END_WATCHDOG] = "watchdog"
+};
+
+static struct {
+    bool active;
+    liveModeConfig_t config;
+    uint32_t sessionId;
+    uint64_t startMs;
+    uint64_t endMs;
+    uint32_t messages;
+    uint32_t bytes;
+    uint32_t sequence;
+    int frameCount;
+    uint64_t firstFrameMs;
+    int outputCount;
+    int outputIndex[LIVE_MODE_MAX_OUTPUTS];     // See sensorRegistry_FindOutput()
+    const char *outputKey[LIVE_MODE_MAX_OUTPUTS];
+    liveEndReason_t lastEndReason;
+} session;
+
+static float frameValues[LIVE_MODE_MAX_BATCH_FRAMES][LIVE_MODE_MAX_OUTPUTS];
+static bool frameValid[LIVE_MODE_MAX_BATCH_FRAMES][LIVE_MODE_MAX_OUTPUTS];
+
+static EventLoopTimer *liveSampleTimer = NULL;
+static EventLoopTimer *liveWatchdogTimer = NULL;
+
+static void LiveSampleTimerEventHandler(EventLoopTimer *timer);
+static void LiveWatchdogTimerEventHandler(EventLoopTimer *timer);
+static bool ValidConfig(const liveModeConfig_t *config);
+static void ResolveOutputs(void);
+static liveEndReason_t SendBatch(void);
+static void EndSession(liveEndReason_t reason);
+
+ExitCode liveMode_Init(EventLoop *el)
+{
+    liveSampleTimer = CreateEventLoopDisarmedTimer(el, &LiveSampleTimerEventHandler);
+    liveWatchdogTimer = CreateEventLoopDisarmedTimer(el, &LiveWatchdogTimerEventHandler);
+    if ((liveSampleTimer == NULL) || (liveWatchdogTimer == NULL)) {
+        return ExitCode_Init_LiveModeTimer;
+    }
+    return ExitCode_Success;
+}
+
+void liveMode_Cleanup(void)
+{
+    session.active = false;
+    DisposeEventLoopTimer(liveSampleTimer);
+    DisposeEventLoopTimer(liveWatchdogTimer);
+    liveSampleTimer = NULL;
+    liveWatchdogTimer = NULL;
+}
+
+bool liveMode_Start(int durationSeconds, const liveModeConfig_t *config)
+{
+    if ((durationSeconds <= 0) || !ValidConfig(config) || (liveSampleTimer == NULL)) {
+        LOG_ERROR(APP_LOG_CAT_SENSOR, "ERROR: Invalid live mode request\n");
+        return false;
+    }
+
+    if (durationSeconds > LIVE_MODE_MAX_DURATION_SECONDS) {
+        LOG_WARN(APP_LOG_CAT_SENSOR, "Live mode duration limited to %d seconds\n", LIVE_MODE_MAX_DURATION_SECONDS);
+        durationSeconds = LIVE_MODE_MAX_DURATION_SECONDS;
+    }
+
+    if (session.active) {
+        liveMode_Stop(LIVE_END_STOPPED);
+    }
+
+    session.active = true;
+    session.config = *config;
+    session.sessionId++;
+    session.startMs = monotonicMs();
+    session.endMs = session.startMs + ((uint64_t)durationSeconds * 1000);
+    session.messages = 0;
+    session.bytes = 0;
+    session.sequence = 0;
+    session.frameCount = 0;
+    session.lastEndReason = LIVE_END_NONE;
+    ResolveOutputs();
+
+    sensorRegistry_SetLivePeriod(config->periodMs);
+
+    struct timespec period = {.tv_sec = config->periodMs / 1000,
+                              .tv_nsec = (long)(config->periodMs % 1000) * 1000 * 1000};
+    SetEventLoopTimerPeriod(liveSampleTimer, &period);
+
+    struct timespec watchdog = {.tv_sec = durationSeconds + LIVE_MODE_WATCHDOG_GRACE_SECONDS,
+                                .tv_nsec = 0};
+    SetEventLoopTimerOneShot(liveWatchdogTimer, &watchdog);
+
+    liveModeSeconds = durationSeconds;
+    LOG_INFO(APP_LOG_CAT_SENSOR, "Live mode session %u: %d s at %d ms, %d frames per message, %d outputs\n",
+                                 session.sessionId, durationSeconds, config->periodMs, config->batchFrames,
+                                 session.outputCount);
+    SCHEMA_UPDATE_DEVICE_TWIN(true, SCHEMA_PROPERTY(liveMode, liveModeSeconds));
+    SCHEMA_UPDATE_DEVICE_TWIN(false, SCHEMA_PROPERTY(liveModeStatus, "running"));
+    return true;
+}
+
+void liveMode_Stop(liveEndReason_t reason)
+{
+    if (!session.active) {
+        return;
+    }
+
+    // Send the partial batch, unless that would go over the budget
+    if (session.frameCount > 0) {
+        liveEndReason_t budgetReason = SendBatch();
+        if (budgetReason != LIVE_END_NONE) {
+            reason = budgetReason;
+        }
+    }
+    EndSession(reason);
+}
+
+bool liveMode_IsActive(void)
+{
+    return session.active;
+}
+
+/// <summary>
+///     Live sample timer event:  Copy the latest output values into a frame, send the batch when
+///     it's full, and end the session when its time is up
+/// </summary>
+static void LiveSampleTimerEventHandler(EventLoopTimer *timer)
+{
+    if (ConsumeEventLoopTimerEvent(timer) != 0) {
+        exitCode = ExitCode_LiveModeTimer_Consume;
+        return;
+    }
+
+    if (!session.active) {
+        return;
+    }
+
+    uint64_t now = monotonicMs();
+    if (now >= session.endMs) {
+        liveMode_Stop(LIVE_END_DURATION);
+        return;
+    }
+
+    if (session.frameCount == 0) {
+        session.firstFrameMs = now;
+    }
+
+    for (int i = 0; i < session.outputCount; i++) {
+        uint64_t readMs;
+        frameValid[session.frameCount][i] =
+            sensorRegistry_GetValueByIndex(session.outputIndex[i], &frameValues[session.frameCount][i], &readMs);
+    }
+    session.frameCount++;
+
+    if (session.frameCount >= session.config.batchFrames) {
+        liveEndReason_t budgetReason = SendBatch();
+        if (budgetReason != LIVE_END_NONE) {
+            EndSession(budgetReason);
+        }
+    }
+}
+
+/// <summary>
+///     Live watchdog timer event:  End a session that outlived its end time
+/// </summary>
+static void LiveWatchdogTimerEventHandler(EventLoopTimer *timer)
+{
+    if (ConsumeEventLoopTimerEvent(timer) != 0) {
+        exitCode = ExitCode_LiveModeTimer_Consume;
+        return;
+    }
+
+    if (session.active) {
+        LOG_WARN(APP_LOG_CAT_SENSOR, "WARNING: Live mode session %u outlived its end time\n", session.sessionId);
+        liveMode_Stop(LIVE_END_WATCHDOG);
+    }
+}
+
+static bool ValidConfig(const liveModeConfig_t *config)
+{
+    return (config->periodMs >= LIVE_MODE_MIN_PERIOD_MS) && (config->batchFrames > 0) &&
+           (config->batchFrames <= LIVE_MODE_MAX_BATCH_FRAMES) && (config->maxMessages > 0) &&
+           (config->maxBytes > 0);
+}
+
+/// <summary>
+///     Pick the outputs of every enabled sensor, up to LIVE_MODE_MAX_OUTPUTS
+/// </summary>
+static void ResolveOutputs(void)
+{
+    session.outputCount = 0;
+
+    for (int i = 0; i < sensorArraySize; i++) {
+
+        const sensor_t *sensor = &sensorArray[i];
+        if ((sensor->periodMs == 0) && (sensor->overridePeriodMs == 0)) {
+            continue;
+        }
+
+        for (int j = 0; j < sensor->outputCount; j++) {
+            if (session.outputCount == LIVE_MODE_MAX_OUTPUTS) {
+                LOG_WARN(APP_LOG_CAT_SENSOR, "WARNING: Live mode streams the first %d outputs\n", LIVE_MODE_MAX_OUTPUTS);
+                return;
+            }
+            session.outputIndex[session.outputCount] = (i * SENSOR_MAX_OUTPUTS) + j;
+            session.outputKey[session.outputCount] = sensor->outputs[j].key;
+            session.outputCount++;
+        }
+    }
+}
+
+/// <summary>
+///     Send the frames collected so far as one message.  Returns the budget that stopped the
+///     send, or LIVE_END_NONE.
+/// </summary>
+static liveEndReason_t SendBatch(void)
+{
+    if (session.messages >= (uint32_t)session.config.maxMessages) {
+        return LIVE_END_MESSAGE_BUDGET;
+    }
+
+    JSON_Value *rootValue = json_value_init_object();
+    JSON_Object *rootObject = json_value_get_object(rootValue);
+
+    json_object_set_number(rootObject, SCHEMA_KEY(liveSession), SCHEMA_VALUE(liveSession, (int)session.sessionId));
+    json_object_set_number(rootObject, SCHEMA_KEY(liveSeq), SCHEMA_VALUE(liveSeq, (int)session.sequence));
+    json_object_set_number(rootObject, SCHEMA_KEY(liveOffsetMs), SCHEMA_VALUE(liveOffsetMs, (int)(session.firstFrameMs - session.startMs)));
+    json_object_set_number(rootObject, SCHEMA_KEY(liveFramePeriodMs), SCHEMA_VALUE(liveFramePeriodMs, session.config.periodMs));
+
+    for (int i = 0; i < session.outputCount; i++) {
+
+        JSON_Value *seriesValue = json_value_init_array();
+        JSON_Array *series = json_value_get_array(seriesValue);
+
+        for (int frame = 0; frame < session.frameCount; frame++) {
+            if (frameValid[frame][i]) {
+                json_array_append_number(series, frameValues[frame][i]);
+            }
+            else {
+                json_array_append_null(series);
+            }
+        }
+        json_object_set_value(rootObject, session.outputKey[i], seriesValue);
+    }
+
+    session.frameCount = 0;
+
+    char *serializedJson = json_serialize_to_string(rootValue);
+    json_value_free(rootValue);
+    if (serializedJson == NULL) {
+        return LIVE_END_NONE;
+    }
+
+    liveEndReason_t result = LIVE_END_NONE;
+    size_t length = strlen(serializedJson);
+
+    if (session.bytes + length > (size_t)session.config.maxBytes) {
+        result = LIVE_END_BYTE_BUDGET;
+    }
+    else if (AzureIoT_SendTelemetry(serializedJson, NULL) == AzureIoT_Result_OK) {
+        // Only messages the SDK accepted count against the hub quota
+        session.messages++;
+        session.bytes += (uint32_t)length;
+    }
+    session.sequence++;
+
+    json_free_serialized_string(serializedJson);
+    return result;
+}
+
+static void EndSession(liveEndReason_t reason)
+{
+    session.active = false;
+    session.lastEndReason = reason;
+
+    DisarmEventLoopTimer(liveSampleTimer);
+    DisarmEventLoopTimer(liveWatchdogTimer);
+    sensorRegistry_SetLivePeriod(0);
+
+    liveModeSeconds = 0;
+    LOG_INFO(APP_LOG_CAT_SENSOR, "Live mode session %u ended (%s): %u messages, %u bytes\n", session.sessionId,
+                                 endReasonNames[reason], session.messages, session.bytes);
+    SCHEMA_UPDATE_DEVICE_TWIN(true, SCHEMA_PROPERTY(liveMode, liveModeSeconds));
+    SCHEMA_UPDATE_DEVICE_TWIN(false, SCHEMA_PROPERTY(liveModeStatus, endReasonNames[reason]));
+}
+
+///<summary>
+///		Handler for the liveMode device twin, the number of seconds to stream
+///</summary>
+void setLiveModeFunction(void* thisTwinPtr, JSON_Object *desiredProperties){
+
+    // Declare a local variable to point to the deviceTwin table entry and cast the incomming void* to a twin_t*
+    twin_t *localTwinPtr = (twin_t*)thisTwinPtr;
+
+    int newSeconds = (int)json_object_get_number(desiredProperties, localTwinPtr->twinKey);
+
+    // Only a patch is a request.  The full twin after a boot or reconnect repeats the last
+    // liveMode, report what is actually running.
+    if (!desiredPatch) {
+        updateDeviceTwin(true, ARGS_PER_TWIN_ITEM*1, TYPE_INT, localTwinPtr->twinKey, liveModeSeconds);
+        return;
+    }
+
+    if (newSeconds == 0) {
+        liveMode_Stop(LIVE_END_STOPPED);
+    }
+    else if (!liveMode_Start(newSeconds, &liveModeConfig)) {
+        LOG_WARN(APP_LOG_CAT_TWIN, "Received invalid device update for key %s.\n", localTwinPtr->twinKey);
+        updateDeviceTwin(true, ARGS_PER_TWIN_ITEM*1, TYPE_INT, localTwinPtr->twinKey, liveModeSeconds);
+    }
+}
+
+///<summary>
+///		Handler for livePeriodMs, liveBatchFrames, liveMaxMessages and liveMaxBytes.  A running
+///     session keeps the settings it started with.
+///</summary>
+void setLiveModeConfigFunction(void* thisTwinPtr, JSON_Object *desiredProperties){
+
+    // Declare a local variable to point to the deviceTwin table entry and cast the incomming void* to a twin_t*
+    twin_t *localTwinPtr = (twin_t*)thisTwinPtr;
+
+    liveModeConfig_t newConfig = liveModeConfig;
+    int newValue = (int)json_object_get_number(desiredProperties, localTwinPtr->twinKey);
+
+    if (localTwinPtr->twinVar == &liveModeConfig.periodMs) {
+        newConfig.periodMs = newValue;
+    }
+    else if (localTwinPtr->twinVar == &liveModeConfig.batchFrames) {
+        newConfig.batchFrames = newValue;
+    }
+    else if (localTwinPtr->twinVar == &liveModeConfig.maxMessages) {
+        newConfig.maxMessages = newValue;
+    }
+    else if (localTwinPtr->twinVar == &liveModeConfig.maxBytes) {
+        newConfig.maxBytes = newValue;
+    }
+
+    if (ValidConfig(&newConfig)) {
+        liveModeConfig = newConfig;
+        LOG_INFO(APP_LOG_CAT_TWIN, "Received device update. New %s is %d\n", localTwinPtr->twinKey, *(int *)localTwinPtr->twinVar);
+    }
+    else {
+        LOG_WARN(APP_LOG_CAT_TWIN, "Received invalid device update for key %s.\n", localTwinPtr->twinKey);
+    }
+    updateDeviceTwin(true, ARGS_PER_TWIN_ITEM*1, TYPE_INT, localTwinPtr->twinKey, *(int *)localTwinPtr->twinVar);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+//
+//  Functions for liveMode directMethod
+//
+//  name: liveMode
+//  Payload: {}, {"durationSeconds": <n>, "periodMs": <ms>, "batchFrames": <n>,
+//            "maxMessages": <n>, "maxBytes": <n>}
+//
+//////////////////////////////////////////////////////////////////////////////////////
+
+int dmLiveModeHandlerFunction(JSON_Object *JsonPayloadObj, size_t payloadSize, char** responseMsg){
+
+    *responseMsg = NULL;
+
+    if ((JsonPayloadObj != NULL) &&
+        json_object_has_value_of_type(JsonPayloadObj, "durationSeconds", JSONNumber)) {
+
+        int durationSeconds = (int)json_object_get_number(JsonPayloadObj, "durationSeconds");
+
+        static const struct {
+            const char *key;
+            size_t offset;
+        } overrides[] = {
+            {"periodMs", offsetof(liveModeConfig_t, periodMs)},
+            {"batchFrames", offsetof(liveModeConfig_t, batchFrames)},
+            {"maxMessages", offsetof(liveModeConfig_t, maxMessages)},
+            {"maxBytes", offsetof(liveModeConfig_t, maxBytes)}
+        };
+
+        liveModeConfig_t config = liveModeConfig;
+        for (size_t i = 0; i < sizeof(overrides) / sizeof(overrides[0]); i++) {
+            if (json_object_has_value_of_type(JsonPayloadObj, overrides[i].key, JSONNumber)) {
+                *(int *)((char *)&config + overrides[i].offset) =
+                    (int)json_object_get_number(JsonPayloadObj, overrides[i].key);
+            }
+        }
+
+        if (durationSeconds == 0) {
+            liveMode_Stop(LIVE_END_STOPPED);
+        }
+        else if (!liveMode_Start(durationSeconds, &config)) {
+            return 400;
+        }
+    }
+
+    JSON_Value *rootValue = json_value_init_object();
+    JSON_Object *rootObject = json_value_get_object(rootValue);
+
+    json_object_set_boolean(rootObject, "active", session.active);
+    json_object_set_number(rootObject, "session", session.sessionId);
+    if (session.active) {
+        uint64_t now = monotonicMs();
+        json_object_set_number(rootObject, "remainingSeconds",
+                               (now < session.endMs) ? (double)(session.endMs - now) / 1000.0 : 0);
+    }
+    else {
+        json_object_set_string(rootObject, "lastEnd", endReasonNames[session.lastEndReason]);
+    }
+    json_object_set_number(rootObject, "periodMs", session.config.periodMs);
+    json_object_set_number(rootObject, "batchFrames", session.config.batchFrames);
+    json_object_set_number(rootObject, "messages", session.messages);
+    json_object_set_number(rootObject, "maxMessages", session.config.maxMessages);
+    json_object_set_number(rootObject, "bytes", session.bytes);
+    json_object_set_number(rootObject, "maxBytes", session.config.maxBytes);
+
+    *responseMsg = dmSerializeResponse(rootValue);
+
+    if(*responseMsg == NULL){
+        LOG_ERROR(APP_LOG_CAT_DM, "ERROR: Could not allocate live mode response\n");
+        return 400;
+    }
+
+    return 200;
+}
+
+#endif // ENABLE_LIVE_MODE
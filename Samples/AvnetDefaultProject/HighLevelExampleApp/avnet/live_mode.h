@@ -0,0 +1,110 @@
+#ifndef LIVE_MODE_H
+#define LIVE_MODE_H
+
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "build_options.h"
+
+// Hard limits, the twin and direct method can't ask for more than these
+#ifndef LIVE_MODE_MAX_DURATION_SECONDS
+#define LIVE_MODE_MAX_DURATION_SECONDS 3600
+#endif
+
+#ifndef LIVE_MODE_MIN_PERIOD_MS
+#define LIVE_MODE_MIN_PERIOD_MS 200
+#endif
+
+// Most samples in one batch and most sensor outputs in one sample
+#define LIVE_MODE_MAX_BATCH_FRAMES 60
+#define LIVE_MODE_MAX_OUTPUTS 16
+
+// Defaults for the live* device twins
+#define LIVE_MODE_DEFAULT_PERIOD_MS 1000
+#define LIVE_MODE_DEFAULT_BATCH_FRAMES 10
+#define LIVE_MODE_DEFAULT_MAX_MESSAGES 360
+#define LIVE_MODE_DEFAULT_MAX_BYTES (256 * 1024)
+
+// The watchdog ends a session this long after its end time if the sample timer has not
+#define LIVE_MODE_WATCHDOG_GRACE_SECONDS 5
+
+typedef enum {
+    LIVE_END_NONE = 0,
+    LIVE_END_DURATION,
+    LIVE_END_MESSAGE_BUDGET,
+    LIVE_END_BYTE_BUDGET,
+    LIVE_END_STOPPED,
+    LIVE_END_WATCHDOG
+} liveEndReason_t;
+
+typedef struct {
+    int periodMs;
+    int batchFrames;
+    int maxMessages;
+    int maxBytes;
+} liveModeConfig_t;
+
+#ifdef ENABLE_LIVE_MODE
+
+#ifndef ENABLE_SENSOR_REGISTRY
+#error "ENABLE_LIVE_MODE requires ENABLE_SENSOR_REGISTRY"
+#endif
+
+#include <applibs/eventloop.h>
+#include "parson.h"
+#include "../common/exitcodes.h"
+
+extern int liveModeSeconds;
+extern liveModeConfig_t liveModeConfig;
+
+ExitCode liveMode_Init(EventLoop *el);
+void liveMode_Cleanup(void);
+
+/// <summary>
+///     Start a session of durationSeconds with config, replacing any running session.  Returns
+///     false if the config is out of range.
+/// </summary>
+bool liveMode_Start(int durationSeconds, const liveModeConfig_t *config);
+
+// End the running session, the samples collected so far are sent if the budget allows
+void liveMode_Stop(liveEndReason_t reason);
+
+bool liveMode_IsActive(void);
+
+// Device twin handlers for liveMode and the live* settings
+void setLiveModeFunction(void* thisTwinPtr, JSON_Object *desiredProperties);
+void setLiveModeConfigFunction(void* thisTwinPtr, JSON_Object *desiredProperties);
+
+// Direct method handler
+int dmLiveModeHandlerFunction(JSON_Object *JsonPayloadObj, size_t payloadSize, char** responsePayload);
+
+#endif // ENABLE_LIVE_MODE
+
+#endif // LIVE_MODE_H
@@ -93,6 +93,13 @@ Instructions to add a real time application
 */
 
 #include "m4_support.h"
+#include "mem_accounting.h"
+#include "../common/trace_ring.h"
+#include "../common/latency_trace.h"
+#include "../common/app_log.h"
+#include "sensor_registry.h"
+#include "../common/sample_observer.h"
+#include "../common/schema_keys.h"
 
 #ifdef OLED_SD1306
 // Status variables
@@ -108,6 +115,7 @@ m4_support_t m4Array[] = {
     {
         .m4Name="AvnetLightSensor",
         .m4RtComponentID="b2cec904-1c60-411b-8f62-5ffe9684b8ce",
+        .m4Fd=-1,
         .m4InitHandler=genericM4Init,
         .m4rawDataHandler=alsPt19RawDataHandler,
         .m4Handler=genericM4Handler,
@@ -122,6 +130,7 @@ m4_support_t m4Array[] = {
     {
         .m4Name="AvnetGroveGPS",
         .m4RtComponentID="592b46b7-5552-4c58-9163-9185f46b96aa",
+        .m4Fd=-1,
         .m4InitHandler=genericM4Init,
         .m4Handler=genericM4Handler,
         .m4rawDataHandler=groveGPSRawDataHandler,
@@ -136,6 +145,7 @@ m4_support_t m4Array[] = {
     {
         .m4Name="AvnetGenericRTApp",
         .m4RtComponentID="9f19b84b-d83c-442b-b8b8-ce095a3b9b33",
+        .m4Fd=-1,
         .m4InitHandler=genericM4Init,
         .m4Handler=genericM4Handler,
         .m4rawDataHandler=referenceRawDataHandler,
@@ -148,6 +158,20 @@ m4_support_t m4Array[] = {
 
 static EventRegistration *rtAppEventReg = NULL;
 
+#ifdef ENABLE_WAKEUP_PROFILE
+/// <summary>
+///     Profile wrapper registered in place of the m4Handler, context is the m4Array entry
+/// </summary>
+static void profiledM4Handler(EventLoop *el, int fd, EventLoop_IoEvents events, void *context)
+{
+    m4_support_t* m4Entry = (m4_support_t*)context;
+
+    uint64_t startUs = wakeupProfile_Begin();
+    m4Entry->m4Handler(el, fd, events, NULL);
+    wakeupProfile_End(m4Entry->m4Profile, startUs);
+}
+#endif // ENABLE_WAKEUP_PROFILE
+
 // Calculate how many twin_t items are in the array.  We use this to iterate through the structure.
 int m4ArraySize = sizeof(m4Array)/sizeof(m4_support_t);
 
@@ -165,15 +189,21 @@ int realTimeAutoTelemetryInterval = 0;
 /// </summary>
 int sendInterCoreCommand(INTER_CORE_CMD cmd, int fd){
 
+    // The real time application is not connected, its init failed or has not run yet
+    if (fd < 0) {
+        return -1;
+    }
+
 	// Send the command to the real time application
  	ic_command_block.cmd = cmd;
 
-  	Log_Debug("Sending Command ID: %d\n", ic_command_block.cmd);
+  	LOG_DEBUG_RL(APP_LOG_CAT_M4, APP_LOG_RATE_LIMIT_MS, "Sending Command ID: %d\n", ic_command_block.cmd);
 
     int bytesSent = send( fd, &ic_command_block, sizeof(ic_command_block), 0);
+    TRACE(TRACE_EVT_M4_TX, cmd, bytesSent);
     if (bytesSent == -1)
     {
-   		Log_Debug("ERROR: Unable to send message: %d (%s)\n", errno, strerror(errno));
+   		LOG_ERROR(APP_LOG_CAT_M4, "ERROR: Unable to send message: %d (%s)\n", errno, strerror(errno));
            exitCode = ExitCode_Write_RT_Socket;
     }
 
@@ -202,6 +232,11 @@ sig_atomic_t InitM4Interfaces(void){
     // Traverse the M4 table, call the init routine for each entry
     for (int i = 0; i < m4ArraySize; i++)
     {
+#ifdef ENABLE_WAKEUP_PROFILE
+        // Each real time application is reported under its own name
+        m4Array[i].m4Profile = wakeupProfile_Register(m4Array[i].m4Name);
+#endif // ENABLE_WAKEUP_PROFILE
+
         // Each entry must have an init routine
         result = m4Array[i].m4InitHandler(&m4Array[i]);
         if(result != ExitCode_Success){
@@ -270,12 +305,20 @@ sig_atomic_t genericM4Init(void* thisM4Entry){
 		if (result == -1)
 		{
 			Log_Debug("ERROR: Unable to set socket timeout: %d (%s)\n", errno, strerror(errno));
+			close(m4Entry->m4Fd);
+			m4Entry->m4Fd = -1;
 			return ExitCode_Init_Open_Socket;
 		}
 
     	// Register handler for incoming messages from real-time capable application.
+#ifdef ENABLE_WAKEUP_PROFILE
+        rtAppEventReg = EventLoop_RegisterIo(eventLoop, m4Entry->m4Fd, EventLoop_Input, profiledM4Handler, m4Entry);
+#else
         rtAppEventReg = EventLoop_RegisterIo(eventLoop, m4Entry->m4Fd, EventLoop_Input, m4Entry->m4Handler, NULL);
+#endif // ENABLE_WAKEUP_PROFILE
         if (rtAppEventReg == NULL) {
+            close(m4Entry->m4Fd);
+            m4Entry->m4Fd = -1;
             return ExitCode_Init_RegisterIo;
         }
 
@@ -319,12 +362,13 @@ void genericM4Handler(EventLoop *el, int fd, EventLoop_IoEvents events, void *co
     int bytesReceived = recv(fd, rxBuf, sizeof(rxBuf), 0);
 
     if (bytesReceived == -1) {
-        Log_Debug("ERROR: Unable to receive message: %d (%s)\n", errno, strerror(errno));
+        LOG_ERROR_RL(APP_LOG_CAT_M4, APP_LOG_RATE_LIMIT_MS, "ERROR: Unable to receive message: %d (%s)\n", errno, strerror(errno));
         return;
     }
 
     // Cast the response message so we can index into the data
     responsePtr = (IC_COMMAND_RESPONSE_BLOCK*)rxBuf;
+    TRACE(TRACE_EVT_M4_RX, responsePtr->cmd, bytesReceived);
 
     switch (responsePtr->cmd)
     
@@ -340,7 +384,7 @@ void genericM4Handler(EventLoop *el, int fd, EventLoop_IoEvents events, void *co
 
             // Null terminate the string before processing
             rxBuf[bytesReceived] = '\0';
-            Log_Debug("RX: %s\n", &rxBuf[1]);
+            LOG_DEBUG_RL(APP_LOG_CAT_M4, APP_LOG_RATE_LIMIT_MS, "RX: %s\n", &rxBuf[1]);
 
             // We need to handle two different cases here.  
             // 1. IoTHub or IoTCentral application: In this case we can just pass the already formatted JSON
@@ -360,11 +404,13 @@ void genericM4Handler(EventLoop *el, int fd, EventLoop_IoEvents events, void *co
             // If rootProperties == NULL, then the JSON is invalid
             if (rootProperties != NULL) {
 
-                // Call the routine to send the JSON as telemetry
-                 AzureIoT_SendTelemetry(&rxBuf[1], NULL);
+                // Call the routine to send the JSON as telemetry, the real time core sampled the
+                // data just before sending it
+                LATENCY_MARK_CAPTURE();
+                AzureIoT_SendTelemetry(&rxBuf[1], NULL);
             }
             else{
-                Log_Debug("WARNING: Cannot parse the string as JSON content.\n");
+                LOG_WARN_RL(APP_LOG_CAT_M4, APP_LOG_RATE_LIMIT_MS, "WARNING: Cannot parse the string as JSON content.\n");
             }
 
 #elif defined(USE_IOT_CONNECT)
@@ -376,7 +422,7 @@ void genericM4Handler(EventLoop *el, int fd, EventLoop_IoEvents events, void *co
             char *ioTConnectTelemetryBuffer;
             size_t ioTConnectMessageSize = bytesReceived + IOTC_TELEMETRY_OVERHEAD;
 
-            ioTConnectTelemetryBuffer = malloc(ioTConnectMessageSize);
+            ioTConnectTelemetryBuffer = APP_MALLOC(MEM_TAG_M4, ioTConnectMessageSize);
             if (ioTConnectTelemetryBuffer == NULL) {
                 exitCode = ExitCode_IoTCMalloc_Failed;
                 return;
@@ -387,12 +433,14 @@ void genericM4Handler(EventLoop *el, int fd, EventLoop_IoEvents events, void *co
             if(FormatTelemetryForIoTConnect(&rxBuf[1], ioTConnectTelemetryBuffer,
                                       ioTConnectMessageSize)){
 
-                // Call the routine to send the JSON as telemetry
+                // Call the routine to send the JSON as telemetry, the real time core sampled the
+                // data just before sending it
+                LATENCY_MARK_CAPTURE();
                 AzureIoT_SendTelemetry(ioTConnectTelemetryBuffer, NULL);
             }
 
             // Free the memory
-            free(ioTConnectTelemetryBuffer);
+            APP_FREE(ioTConnectTelemetryBuffer);
 
 #endif 
             // Release the allocated memory.
@@ -424,12 +472,12 @@ void genericM4Handler(EventLoop *el, int fd, EventLoop_IoEvents events, void *co
             break;
 
         case IC_HEARTBEAT:
-            Log_Debug("RealTime App responded with Heartbeat response\n");        
+            LOG_DEBUG(APP_LOG_CAT_M4, "RealTime App responded with Heartbeat response\n");        
             break;
 
         case IC_UNKNOWN:
         default:
-            Log_Debug("Warning: Unknown response from real time application\n");
+            LOG_WARN_RL(APP_LOG_CAT_M4, APP_LOG_RATE_LIMIT_MS, "Warning: Unknown response from real time application\n");
             break;
     }
 }
@@ -474,6 +522,18 @@ void RequestRawData(void) {
     }
 }
 
+#ifdef ENABLE_SENSOR_REGISTRY
+/// <summary>
+///     Sensor registry read function for the real time applications.  The raw data arrives later
+///     through each application's m4rawDataHandler, so there are no values to return here.
+/// </summary>
+bool readRealTimeSensors(void *thisSensor)
+{
+    RequestRawData();
+    return false;
+}
+#endif // ENABLE_SENSOR_REGISTRY
+
 /// <summary>
 ///     RequestRealTimeTelemetry()
 /// 
@@ -527,13 +587,18 @@ void sendRealTimeTelemetryInterval(INTER_CORE_CMD cmd, uint32_t newInterval)
     // Traverse the m4 array, send the new interval to each real time application
     for (int i = 0; i < m4ArraySize; i++)
     {
+        // Skip real time applications that are not connected
+        if (m4Array[i].m4Fd < 0) {
+            continue;
+        }
 
-      	Log_Debug("Sending Command ID: %d\n", ic_command_block.cmd);
+      	LOG_DEBUG(APP_LOG_CAT_M4, "Sending Command ID: %d\n", ic_command_block.cmd);
 
         int bytesSent = send( m4Array[i].m4Fd, &ic_command_block, sizeof(ic_command_block), 0);
+        TRACE(TRACE_EVT_M4_TX, cmd, bytesSent);
         if (bytesSent == -1)
         {
-   		    Log_Debug("ERROR: Unable to send message: %d (%s)\n", errno, strerror(errno));
+   		    LOG_ERROR(APP_LOG_CAT_M4, "ERROR: Unable to send message: %d (%s)\n", errno, strerror(errno));
             exitCode = ExitCode_Write_RT_Socket;
         }
     }
@@ -583,7 +648,8 @@ void alsPt19RawDataHandler(void* msg){
     } IC_COMMAND_BLOCK_ALS_PT19;
 
     IC_COMMAND_BLOCK_ALS_PT19 *messageData = (IC_COMMAND_BLOCK_ALS_PT19*) msg;
-    Log_Debug("RX Raw Data: lightSensorAdcData: %d\n", messageData->lightSensorAdcData);
+    LOG_DEBUG_RL(APP_LOG_CAT_SENSOR, APP_LOG_RATE_LIMIT_MS, "RX Raw Data: lightSensorAdcData: %d\n", messageData->lightSensorAdcData);
+    SAMPLE_PUBLISH(SCHEMA_KEY(lightSensorAdc), (float)messageData->lightSensorAdcData);
 
     // Add message structure and logic to do something with the raw data from the 
     // real time application
@@ -612,8 +678,10 @@ void referenceRawDataHandler(void* msg){
     } IC_COMMAND_BLOCK_GENERIC_RT_APP;
 
     IC_COMMAND_BLOCK_GENERIC_RT_APP *messageData = (IC_COMMAND_BLOCK_GENERIC_RT_APP*) msg;
-    Log_Debug("RX Raw Data: rawData8bit: %d, rawDataFloat: %.2f\n",
+    LOG_DEBUG_RL(APP_LOG_CAT_SENSOR, APP_LOG_RATE_LIMIT_MS, "RX Raw Data: rawData8bit: %d, rawDataFloat: %.2f\n",
                             messageData->rawData8bit, messageData->rawDataFloat);
+    SAMPLE_PUBLISH(SCHEMA_KEY(rawData8bit), (float)messageData->rawData8bit);
+    SAMPLE_PUBLISH(SCHEMA_KEY(rawDataFloat), messageData->rawDataFloat);
 
     // Add message structure and logic to do something with the raw data from the 
     // real time application
@@ -651,8 +719,10 @@ void groveGPSRawDataHandler(void* msg){
 
     // Cast the message so we can index into the data to pull the GPS data out of it
     IC_COMMAND_BLOCK_GROVE_GPS *messageData = (IC_COMMAND_BLOCK_GROVE_GPS*) msg;
-    Log_Debug("RX Raw Data: fix_qual: %d, numstats: %d, lat: %lf, lon: %lf, alt: %.2f\n",
+    LOG_DEBUG_RL(APP_LOG_CAT_SENSOR, APP_LOG_RATE_LIMIT_MS, "RX Raw Data: fix_qual: %d, numstats: %d, lat: %lf, lon: %lf, alt: %.2f\n",
                             messageData->fix_qual, messageData->numsats, messageData->lat, messageData->lon, messageData->alt);
+    SAMPLE_PUBLISH(SCHEMA_KEY(gpsAltitude), messageData->alt);
+    SAMPLE_PUBLISH(SCHEMA_KEY(gpsNumSats), (float)messageData->numsats);
         
 #ifdef OLED_SD1306
     // Update the global GPS variables
@@ -672,17 +742,17 @@ void groveGPSRawDataHandler(void* msg){
         static const char gpsDataJsonString[] = "{\"DeviceLocation\":{\"lat\": %.5f,\"lon\": %.5f,\"alt\": %.2f}}";
 
         size_t twinBufferSize = sizeof(gpsDataJsonString)+48;
-        char *pjsonBuffer = (char *)malloc(twinBufferSize);
+        char *pjsonBuffer = (char *)APP_MALLOC(MEM_TAG_M4, twinBufferSize);
 	    if (pjsonBuffer == NULL) {
             Log_Debug("ERROR: not enough memory to report GPS location data.");
     	}
 
         // Build out the JSON and send it as a device twin update
 	    snprintf(pjsonBuffer, twinBufferSize, gpsDataJsonString, messageData->lat, messageData->lon, messageData->alt );
-	    Log_Debug("[MCU] Updating device twin: %s\n", pjsonBuffer);
+	    LOG_DEBUG(APP_LOG_CAT_SENSOR, "[MCU] Updating device twin: %s\n", pjsonBuffer);
         AzureIoT_DeviceTwinReportState(pjsonBuffer, NULL);
 	    if(pjsonBuffer != NULL){
-            free(pjsonBuffer);
+            APP_FREE(pjsonBuffer);
         }
 
     }
@@ -46,6 +46,7 @@ SOFTWARE.
 #include "signal.h"
 #include "build_options.h"
 #include "../common/exitcodes.h"
+#include "../common/wakeup_profile.h"
 #include "../common/azure_iot.h"
 #include "iotConnect.h"
 #include <applibs/log.h>
@@ -132,6 +133,9 @@ typedef struct {
 	m4RequestTelemetry m4TelemetryHandler;
 	int m4Fd;
 	uint8_t m4InterfaceVersion;
+#ifdef ENABLE_WAKEUP_PROFILE
+	wakeupSource_t *m4Profile; // Set by InitM4Interfaces()
+#endif // ENABLE_WAKEUP_PROFILE
 } m4_support_t;
 
 /////////////////////////////////////////////////////////////////////////////////////
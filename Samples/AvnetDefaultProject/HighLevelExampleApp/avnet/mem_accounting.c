@@ -0,0 +1,290 @@
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Per module heap accounting
+//
+//  Every allocation made through APP_MALLOC() (and every allocation parson makes) carries a small
+//  header with the allocation size and a tag that identifies the module that made the allocation.
+//  For each tag we track the live bytes, peak bytes, allocation/free counts and a size class 
+//  histogram.  
+//
+//  Note that memory handed to the Azure IoT SDK (for example direct method responses) is freed by 
+//  the SDK with free() and must NOT be allocated with APP_MALLOC().  Memory allocated inside the 
+//  SDK is not tracked.  The difference between the process memory usage and the tracked live bytes 
+//  gives an idea of how much memory the SDK and the runtime are using.
+//
+//  The getHeapStats direct method returns the complete breakdown.  When a tag's peak grows by more
+//  than MEM_ACCT_REPORT_THRESHOLD_BYTES the new peak is sent as a read only device twin 
+//  "heapPeak<TagName>".
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "mem_accounting.h"
+
+#ifdef ENABLE_HEAP_ACCOUNTING
+
+#include <string.h>
+#include <applibs/log.h>
+#include <applibs/applications.h>
+#include "device_twin.h"
+#include "direct_methods.h"
+#include "../common/schema_keys.h"
+
+// Only report a new peak if it's this much larger than the last peak we reported
+#define MEM_ACCT_REPORT_THRESHOLD_BYTES 256
+
+// Used to catch pointers that were not allocated by memAcct_Malloc()
+#define MEM_ACCT_MAGIC 0xA5E7
+
+// Header stored in front of each allocation.  The header is 8 bytes to keep the returned
+// pointer 8 byte aligned.
+typedef struct {
+    uint32_t size;
+    uint16_t tag;
+    uint16_t magic;
+} memAcctHeader_t;
+
+// Tag names, used for the direct method response and the device twin keys
+#define MEM_TAG_NAME(id, name, description, arg) #name,
+static const char *memTagNames[MEM_TAG_COUNT] = {
+    MEM_TAG_LIST(MEM_TAG_NAME, )
+};
+#undef MEM_TAG_NAME
+
+static memTagStats_t memStats[MEM_TAG_COUNT];
+static size_t totalLiveBytes = 0;
+static size_t totalPeakBytes = 0;
+
+static void *parsonMalloc(size_t size);
+static void parsonFree(void *ptr);
+static int sizeToClass(size_t size);
+
+/// <summary>
+///     Reset the accounting data and install the accounting allocators into parson.  This
+///     must be called before any JSON values are created.
+/// </summary>
+void memAcct_Init(void){
+
+    memset(memStats, 0, sizeof(memStats));
+    totalLiveBytes = 0;
+    totalPeakBytes = 0;
+
+    json_set_allocation_functions(parsonMalloc, parsonFree);
+}
+
+/// <summary>
+///     Allocate size bytes and charge the allocation to the given tag
+/// </summary>
+void *memAcct_Malloc(memTag_t tag, size_t size){
+
+    if(tag >= MEM_TAG_COUNT){
+        tag = MEM_TAG_OTHER;
+    }
+
+    memTagStats_t *stats = &memStats[tag];
+
+    memAcctHeader_t *header = (memAcctHeader_t *)malloc(sizeof(memAcctHeader_t) + size);
+    if(header == NULL){
+        stats->failedCount++;
+        return NULL;
+    }
+
+    header->size = (uint32_t)size;
+    header->tag = (uint16_t)tag;
+    header->magic = MEM_ACCT_MAGIC;
+
+    stats->allocCount++;
+    stats->sizeClass[sizeToClass(size)]++;
+    stats->liveBytes += size;
+    if(stats->liveBytes > stats->peakBytes){
+        stats->peakBytes = stats->liveBytes;
+    }
+
+    totalLiveBytes += size;
+    if(totalLiveBytes > totalPeakBytes){
+        totalPeakBytes = totalLiveBytes;
+    }
+
+    return (void *)(header + 1);
+}
+
+/// <summary>
+///     Free memory allocated by memAcct_Malloc()
+/// </summary>
+void memAcct_Free(void *ptr){
+
+    if(ptr == NULL){
+        return;
+    }
+
+    memAcctHeader_t *header = ((memAcctHeader_t *)ptr) - 1;
+    if(header->magic != MEM_ACCT_MAGIC){
+        Log_Debug("ERROR: memAcct_Free() called with untracked pointer %p\n", ptr);
+        return;
+    }
+
+    memTagStats_t *stats = &memStats[header->tag];
+    stats->freeCount++;
+    stats->liveBytes -= header->size;
+    totalLiveBytes -= header->size;
+
+    // Clear the magic number to catch double frees
+    header->magic = 0;
+    free(header);
+}
+
+/// <summary>
+///     Send a read only device twin update for each tag whose peak has grown past the
+///     reporting threshold.  Called from checkMemoryUsageHighWaterMark()
+/// </summary>
+void memAcct_ReportPeaks(void){
+
+    for(int i = 0; i < MEM_TAG_COUNT; i++){
+
+        memTagStats_t *stats = &memStats[i];
+
+        if(stats->peakBytes >= stats->lastReportedPeak + MEM_ACCT_REPORT_THRESHOLD_BYTES){
+
+            // Update the reported peak first, sending the update allocates memory too
+            stats->lastReportedPeak = stats->peakBytes;
+            Log_Debug("Heap peak for %s: %zu bytes\n", memTagNames[i], stats->peakBytes);
+
+#ifdef IOT_HUB_APPLICATION
+            // One case per tag, each sends its own heapPeak<name> key from schema.h
+#define MEM_TAG_REPORT_PEAK(id, name, description, arg)                                          \
+            case MEM_TAG_##id:                                                                   \
+                SCHEMA_UPDATE_DEVICE_TWIN(false, SCHEMA_PROPERTY(heapPeak##name, (int)stats->peakBytes)); \
+                break;
+            switch (i) {
+                MEM_TAG_LIST(MEM_TAG_REPORT_PEAK, )
+            }
+#undef MEM_TAG_REPORT_PEAK
+#endif // IOT_HUB_APPLICATION
+        }
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+//
+//  Functions for getHeapStats directMethod
+//
+//  name: getHeapStats
+//  Payload: {}, or {"resetPeaks": true}
+//
+//  Returns the accounting data for every tag
+//
+//////////////////////////////////////////////////////////////////////////////////////
+
+int dmGetHeapStatsHandlerFunction(JSON_Object *JsonPayloadObj, size_t payloadSize, char** responseMsg){
+
+    // Build the response before resetting the peaks so the caller sees the peaks that were reset
+    JSON_Value *rootValue = json_value_init_object();
+    JSON_Object *rootObject = json_value_get_object(rootValue);
+    char keyBuffer[64];
+
+    for(int i = 0; i < MEM_TAG_COUNT; i++){
+
+        memTagStats_t *stats = &memStats[i];
+
+        snprintf(keyBuffer, sizeof(keyBuffer), "tags.%s.live", memTagNames[i]);
+        json_object_dotset_number(rootObject, keyBuffer, stats->liveBytes);
+        snprintf(keyBuffer, sizeof(keyBuffer), "tags.%s.peak", memTagNames[i]);
+        json_object_dotset_number(rootObject, keyBuffer, stats->peakBytes);
+        snprintf(keyBuffer, sizeof(keyBuffer), "tags.%s.allocs", memTagNames[i]);
+        json_object_dotset_number(rootObject, keyBuffer, stats->allocCount);
+        snprintf(keyBuffer, sizeof(keyBuffer), "tags.%s.frees", memTagNames[i]);
+        json_object_dotset_number(rootObject, keyBuffer, stats->freeCount);
+        snprintf(keyBuffer, sizeof(keyBuffer), "tags.%s.failed", memTagNames[i]);
+        json_object_dotset_number(rootObject, keyBuffer, stats->failedCount);
+
+        JSON_Value *histValue = json_value_init_array();
+        JSON_Array *histArray = json_value_get_array(histValue);
+        for(int j = 0; j < MEM_ACCT_SIZE_CLASSES; j++){
+            json_array_append_number(histArray, stats->sizeClass[j]);
+        }
+        snprintf(keyBuffer, sizeof(keyBuffer), "tags.%s.sizeClasses", memTagNames[i]);
+        json_object_dotset_value(rootObject, keyBuffer, histValue);
+    }
+
+    json_object_dotset_number(rootObject, "trackedLive", totalLiveBytes);
+    json_object_dotset_number(rootObject, "trackedPeak", totalPeakBytes);
+    json_object_dotset_number(rootObject, "processKB", Applications_GetUserModeMemoryUsageInKB());
+    json_object_dotset_number(rootObject, "processPeakKB", Applications_GetPeakUserModeMemoryUsageInKB());
+
+    *responseMsg = dmSerializeResponse(rootValue);
+
+    // Reset the peaks if requested
+    if((JsonPayloadObj != NULL) && (json_object_get_boolean(JsonPayloadObj, "resetPeaks") == 1)){
+
+        for(int i = 0; i < MEM_TAG_COUNT; i++){
+            memStats[i].peakBytes = memStats[i].liveBytes;
+            memStats[i].lastReportedPeak = memStats[i].liveBytes;
+        }
+        totalPeakBytes = totalLiveBytes;
+    }
+
+    if(*responseMsg == NULL){
+        Log_Debug("ERROR: Could not allocate heap stats response\n");
+        return 400;
+    }
+
+    return 200;
+}
+
+/// <summary>
+///     parson allocation hooks
+/// </summary>
+static void *parsonMalloc(size_t size){
+
+    return memAcct_Malloc(MEM_TAG_PARSON, size);
+}
+
+static void parsonFree(void *ptr){
+
+    memAcct_Free(ptr);
+}
+
+/// <summary>
+///     Map an allocation size to a histogram size class
+/// </summary>
+static int sizeToClass(size_t size){
+
+    int sizeClass = 0;
+    size_t classLimit = 16;
+
+    while((size > classLimit) && (sizeClass < MEM_ACCT_SIZE_CLASSES - 1)){
+        classLimit <<= 1;
+        sizeClass++;
+    }
+
+    return sizeClass;
+}
+
+#endif // ENABLE_HEAP_ACCOUNTING
@@ -0,0 +1,94 @@
+#ifndef MEM_ACCOUNTING_H
+#define MEM_ACCOUNTING_H
+
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "build_options.h"
+#include "parson.h"
+
+// Define the modules that we account heap usage for.  X(id, name, "description", arg)
+//      name - Used in the getHeapStats response and for the heapPeak<name> device twin
+//      arg  - The second argument of MEM_TAG_LIST(), passed through to X.  schema.h passes its
+//             own X in to generate the heapPeak<name> keys
+#define MEM_TAG_LIST(X, arg) \
+    X(PARSON,        Parson,       "Installed into parson, all JSON values and serialized strings", arg) \
+    X(RESEND_LIST,   ResendList,   "Telemetry resend linked list nodes", arg) \
+    X(TELEMETRY,     Telemetry,    "Telemetry formatting buffers", arg) \
+    X(DEVICE_TWIN,   DeviceTwin,   "Device twin formatting buffers", arg) \
+    X(DIRECT_METHOD, DirectMethod, "Direct method payload copies", arg) \
+    X(IOTCONNECT,    IoTConnect,   "IoTConnect C2D message buffers", arg) \
+    X(M4,            M4,           "Real time application buffers", arg) \
+    X(OTHER,         Other,        "Allocations without a tag of their own", arg)
+
+#define MEM_TAG_ENUM(id, name, description, arg) MEM_TAG_##id,
+typedef enum {
+    MEM_TAG_LIST(MEM_TAG_ENUM, )
+    MEM_TAG_COUNT
+} memTag_t;
+#undef MEM_TAG_ENUM
+
+// Size classes in the per tag histogram: <=16, <=32, <=64, <=128, <=256, <=512, <=1K, <=2K, <=4K, >4K bytes
+#define MEM_ACCT_SIZE_CLASSES 10
+
+#ifdef ENABLE_HEAP_ACCOUNTING
+
+// Accounting data for one tag
+typedef struct {
+    size_t liveBytes;
+    size_t peakBytes;
+    size_t lastReportedPeak;
+    uint32_t allocCount;
+    uint32_t freeCount;
+    uint32_t failedCount;
+    uint32_t sizeClass[MEM_ACCT_SIZE_CLASSES];
+} memTagStats_t;
+
+void memAcct_Init(void);
+void *memAcct_Malloc(memTag_t tag, size_t size);
+void memAcct_Free(void *ptr);
+void memAcct_ReportPeaks(void);
+
+// Direct method handler
+int dmGetHeapStatsHandlerFunction(JSON_Object *JsonPayloadObj, size_t payloadSize, char** responsePayload);
+
+// Application code allocates through these macros so that the accounting can be compiled out
+#define APP_MALLOC(tag, size) memAcct_Malloc(tag, size)
+#define APP_FREE(ptr) memAcct_Free(ptr)
+
+#else
+
+#define APP_MALLOC(tag, size) malloc(size)
+#define APP_FREE(ptr) free(ptr)
+
+#endif // ENABLE_HEAP_ACCOUNTING
+
+#endif // MEM_ACCOUNTING_H
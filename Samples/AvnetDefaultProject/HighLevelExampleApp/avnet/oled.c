@@ -65,7 +65,7 @@ void update_oled()
 		case CLOUD_MESSAGE:
 		{
 			clear_oled_buffer();
-			sd1306_draw_string(0, 0, " Cloud Twin", FONT_SIZE_TITLE, white_pixel);
+			sd1306_draw_string(0, 0, (uint8_t *)" Cloud Twin", FONT_SIZE_TITLE, white_pixel);
 
 			sd1306_draw_string(OLED_LINE_1_X, OLED_LINE_1_Y, oled_ms1, FONT_SIZE_LINE, white_pixel);
 			sd1306_draw_string(OLED_LINE_2_X, OLED_LINE_2_Y, oled_ms2, FONT_SIZE_LINE, white_pixel);
@@ -145,13 +145,13 @@ void oled_i2c_bus_status(uint8_t sensor_number)
 			clear_oled_buffer();
 
 			// Draw the title
-			sd1306_draw_string(OLED_TITLE_X, OLED_TITLE_Y, " I2C Init", FONT_SIZE_TITLE, white_pixel);
+			sd1306_draw_string(OLED_TITLE_X, OLED_TITLE_Y, (uint8_t *)" I2C Init", FONT_SIZE_TITLE, white_pixel);
 
 			// Draw a label at line 1
 			sd1306_draw_string(OLED_LINE_1_X, OLED_LINE_1_Y, str_bus_sta, FONT_SIZE_LINE, white_pixel);
 
 			// I2C bus OK, if not OLED doesn't show a image
-			sd1306_draw_string(sizeof(str_bus_sta) * 6, OLED_LINE_1_Y, "OK", FONT_SIZE_LINE, white_pixel);
+			sd1306_draw_string(sizeof(str_bus_sta) * 6, OLED_LINE_1_Y, (uint8_t *)"OK", FONT_SIZE_LINE, white_pixel);
 		}
 		break;
 		case I2C_INIT:
@@ -162,13 +162,13 @@ void oled_i2c_bus_status(uint8_t sensor_number)
 			clear_oled_buffer();
 
 			// Draw the title
-			sd1306_draw_string(OLED_TITLE_X, OLED_TITLE_Y, " I2C Init", FONT_SIZE_TITLE, white_pixel);
+			sd1306_draw_string(OLED_TITLE_X, OLED_TITLE_Y, (uint8_t *)" I2C Init", FONT_SIZE_TITLE, white_pixel);
 
 			// Draw a label at line 1
 			sd1306_draw_string(OLED_LINE_1_X, OLED_LINE_1_Y, str_bus_sta, FONT_SIZE_LINE, white_pixel);
 
 			// I2C bus OK, if not OLED doesn't show a image
-			sd1306_draw_string(sizeof(str_bus_sta) * 6, OLED_LINE_1_Y, "OK", FONT_SIZE_LINE, white_pixel);
+			sd1306_draw_string(sizeof(str_bus_sta) * 6, OLED_LINE_1_Y, (uint8_t *)"OK", FONT_SIZE_LINE, white_pixel);
 
 #ifdef M4_INTERCORE_COMMS
 			// Draw a label at line 2
@@ -245,7 +245,7 @@ void update_network()
 	clear_oled_buffer();
 
 	// Draw the title
-	sd1306_draw_string(OLED_TITLE_X, OLED_TITLE_Y, "  Network", FONT_SIZE_TITLE, white_pixel);
+	sd1306_draw_string(OLED_TITLE_X, OLED_TITLE_Y, (uint8_t *)"  Network", FONT_SIZE_TITLE, white_pixel);
 
 	// Draw a label at line 1
 	sd1306_draw_string(OLED_LINE_1_X, OLED_LINE_1_Y, str_SSID, FONT_SIZE_LINE, white_pixel);
@@ -283,14 +283,14 @@ void update_network()
 	// Convert RSSI value to string (Currently RSSI is always zero)
 	intToStr(network_data.rssi, string_data, 1);
 
-	strcpy(string_data, "%d");
-	snprintf(string_data, 10, aux_data_str, network_data.rssi);
+	strcpy((char *)string_data, "%d");
+	snprintf((char *)string_data, 10, (const char *)aux_data_str, network_data.rssi);
 
 	// Draw RSSI value
 	sd1306_draw_string(sizeof(str_RSSI) * 6, OLED_LINE_3_Y, string_data, FONT_SIZE_LINE, white_pixel);
 
 	// Draw dBm unit
-	sd1306_draw_string(sizeof(str_freq) * 6 + (get_str_size(string_data) + 1) * 6, OLED_LINE_3_Y, "dBm", FONT_SIZE_LINE, white_pixel);
+	sd1306_draw_string(sizeof(str_freq) * 6 + (get_str_size(string_data) + 1) * 6, OLED_LINE_3_Y, (uint8_t *)"dBm", FONT_SIZE_LINE, white_pixel);
 
 	// Send the buffer to OLED RAM
 	sd1306_refresh();
@@ -492,5 +492,5 @@ const unsigned char Image_avnet_bmp[BUFFER_SIZE] =
 
 uint8_t get_str_size(uint8_t * str)
 {
-	return strlen(str);
+	return strlen((const char *)str);
 }
\ No newline at end of file
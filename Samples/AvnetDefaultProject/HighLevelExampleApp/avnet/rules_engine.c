@@ -0,0 +1,851 @@
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Local rules engine
+//
+//  Rules are delivered in the "rules" device twin as one string, separated by ';'.  Each rule is
+//  an expression over the sensor registry output keys and the real time application channels
+//  (SCHEMA_RT_APP_TELEMETRY_LIST in schema.h), "->", and one or more actions:
+//
+//      wifiRssi < -80 -> alert(weakSignal); rate(memoryHighWaterKB) > 10 -> gpio(appLed)
+//      gpsNumSats < 4 -> alert(gpsFixLost)
+//
+//  Expressions support numbers, keys, rate(key) (change per second between the last two
+//  readings of that key), ( ), unary - and !, * /, + -, < <= > >=, == !=, && and ||.  A rule that
+//  references a key with no valid reading is false.
+//
+//  Actions:
+//      alert(name)                     Send a ruleAlert telemetry message right away
+//      gpio(twinKey)                   Turn on a GPIO from twinArray[] (e.g. appLed)
+//      sensorPeriod(sensorName, ms)    Read a sensor at a different period
+//      telemetryPeriod(seconds)        Send telemetry at a different period
+//
+//  Actions run when the rule becomes true.  gpio() and the period actions are undone when the
+//  rule becomes false again.
+//
+//  When the twin arrives each rule is compiled into a short stack machine program with the keys
+//  already resolved to sensor registry indexes or real time application channels.  The rules run
+//  after every sensor registry read, and after each sample of a real time application channel
+//  that a rule uses.  Those samples come from the raw data handlers through rulesEngine_Observe(),
+//  a sample observer.
+//  The RULES_MAX_* limits in rules_engine.h bound the code size and stack depth, so an
+//  evaluation takes a bounded amount of time and no memory is allocated.  If any rule fails to
+//  compile the previous rules stay in place and the error is reported in "rulesStatus".
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "rules_engine.h"
+
+#ifdef ENABLE_RULES_ENGINE
+
+#ifndef IOT_HUB_APPLICATION
+#error "ENABLE_RULES_ENGINE requires IOT_HUB_APPLICATION, rules are delivered in the device twin"
+#endif
+
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <applibs/gpio.h>
+#include <applibs/log.h>
+#include "../common/app_log.h"
+#include "device_twin.h"
+#include "sensor_registry.h"
+#include "../common/eventloop_timer_utilities.h"
+#include "../common/adaptive_period.h"
+#include "../common/schema_keys.h"
+
+char rulesText[RULES_TEXT_MAX_LENGTH] = "";
+
+static rule_t rules[RULES_MAX_RULES];
+static int ruleCount = 0;
+
+// New rules are compiled here so a bad twin update leaves the running rules alone
+static rule_t compiledRules[RULES_MAX_RULES];
+
+// The real time application channels rules can use, NULL terminated so the list can be empty
+#define RULES_CHANNEL_NAME(key, type, description) #key,
+static const char *const channelNames[] = {
+    SCHEMA_RT_APP_TELEMETRY_LIST(RULES_CHANNEL_NAME)
+    NULL
+};
+#undef RULES_CHANNEL_NAME
+
+#define RULES_CHANNEL_COUNT ((int)(sizeof(channelNames) / sizeof(channelNames[0])) - 1)
+
+// Latest sample of each real time application channel
+typedef struct {
+    float value;
+    uint64_t readMs;
+    bool valid;
+    bool used;                  // Referenced by a running rule
+} ruleChannel_t;
+
+static ruleChannel_t channels[sizeof(channelNames) / sizeof(channelNames[0])];
+
+typedef enum {
+    TOKEN_END,
+    TOKEN_NUMBER,
+    TOKEN_NAME,
+    TOKEN_OPERATOR,
+    TOKEN_LPAREN,
+    TOKEN_RPAREN,
+    TOKEN_COMMA,
+    TOKEN_SEMICOLON,
+    TOKEN_ARROW
+} ruleToken_t;
+
+typedef struct {
+    const char *text;
+    ruleOpcode_t op;
+    int precedence;             // Binary operator precedence, 0 for unary only
+} ruleOperator_t;
+
+// Two character operators first so the longest match wins
+static const ruleOperator_t ruleOperators[] = {
+    {"||", RULE_OP_OR, 1},
+    {"&&", RULE_OP_AND, 2},
+    {"==", RULE_OP_EQ, 3},
+    {"!=", RULE_OP_NE, 3},
+    {"<=", RULE_OP_LE, 4},
+    {">=", RULE_OP_GE, 4},
+    {"<", RULE_OP_LT, 4},
+    {">", RULE_OP_GT, 4},
+    {"+", RULE_OP_ADD, 5},
+    {"-", RULE_OP_SUB, 5},
+    {"*", RULE_OP_MUL, 6},
+    {"/", RULE_OP_DIV, 6},
+    {"!", RULE_OP_NOT, 0},
+};
+
+typedef struct {
+    const char *pos;
+    const char *tokenStart;
+    ruleToken_t token;
+    float number;
+    char name[RULES_NAME_LENGTH];
+    const ruleOperator_t *operator;
+    rule_t *rule;
+    int stackDepth;
+    const char *error;
+} ruleParser_t;
+
+static int CompileRules(const char *text, char *status, size_t statusSize);
+static void ParseRule(ruleParser_t *parser);
+static void ParseExpression(ruleParser_t *parser, int minPrecedence);
+static void ParseUnary(ruleParser_t *parser);
+static void ParsePrimary(ruleParser_t *parser);
+static void ParseAction(ruleParser_t *parser);
+static void NextToken(ruleParser_t *parser);
+static void Expect(ruleParser_t *parser, ruleToken_t token, const char *error);
+static void Emit(ruleParser_t *parser, ruleOpcode_t op, int outputIndex, int rateSlot, float constant);
+static void Fail(ruleParser_t *parser, const char *error);
+static bool RunRule(rule_t *rule);
+static bool ReadInput(int outputIndex, float *value, uint64_t *readMs);
+static int FindChannel(const char *name);
+static void MarkUsedChannels(void);
+static float UpdateRate(ruleRate_t *rate, float value, uint64_t readMs);
+static void RunActions(const rule_t *rule, int ruleIndex, bool ruleHolds);
+static void ReleaseRules(void);
+
+void rulesEngine_Evaluate(void)
+{
+    for (int i = 0; i < ruleCount; i++) {
+
+        bool ruleHolds = RunRule(&rules[i]);
+
+        // Actions only run when the rule changes state
+        if (ruleHolds != rules[i].active) {
+            rules[i].active = ruleHolds;
+            if (ruleHolds) {
+                rules[i].triggerCount++;
+            }
+            LOG_INFO_RL(APP_LOG_CAT_SENSOR, APP_LOG_RATE_LIMIT_MS, "Rule %d %s\n", i, ruleHolds ? "triggered" : "cleared");
+            RunActions(&rules[i], i, ruleHolds);
+        }
+    }
+}
+
+void rulesEngine_Observe(const char *channelName, float value, uint64_t timeMs)
+{
+    int channel = FindChannel(channelName);
+    if (channel < 0) {
+        return;
+    }
+
+    channels[channel].value = value;
+    channels[channel].readMs = timeMs;
+    channels[channel].valid = isfinite(value);
+
+    if (channels[channel].used) {
+        rulesEngine_Evaluate();
+    }
+}
+
+void rulesEngine_Cleanup(void)
+{
+    ReleaseRules();
+    ruleCount = 0;
+}
+
+///<summary>
+///		Device twin handler for the rules string.  The new rules only replace the running rules
+///     if every rule compiles.
+///</summary>
+void setRulesFunction(void* thisTwinPtr, JSON_Object *desiredProperties){
+
+    // Declare a local variable to point to the deviceTwin table entry and cast the incomming void* to a twin_t*
+    twin_t *localTwinPtr = (twin_t*)thisTwinPtr;
+    char status[96];
+
+    const char *newRules = json_object_get_string(desiredProperties, localTwinPtr->twinKey);
+    if (newRules == NULL) {
+        newRules = "";
+    }
+
+    int newRuleCount = -1;
+    if (strlen(newRules) >= RULES_TEXT_MAX_LENGTH) {
+        snprintf(status, sizeof(status), "error: rules longer than %d characters", RULES_TEXT_MAX_LENGTH - 1);
+    }
+    else {
+        newRuleCount = CompileRules(newRules, status, sizeof(status));
+    }
+
+    if (newRuleCount >= 0) {
+
+        // Undo whatever the old rules are driving before they're replaced
+        ReleaseRules();
+        memcpy(rules, compiledRules, sizeof(rule_t) * (size_t)newRuleCount);
+        ruleCount = newRuleCount;
+        MarkUsedChannels();
+        strcpy(rulesText, newRules);
+        LOG_INFO(APP_LOG_CAT_TWIN, "Received device update. New %s is %s\n", localTwinPtr->twinKey, rulesText);
+    }
+    else {
+        LOG_WARN(APP_LOG_CAT_TWIN, "Received invalid device update for key %s, %s\n", localTwinPtr->twinKey, status);
+    }
+
+    // Report the rules that are running and how the update went
+    updateDeviceTwin(true, ARGS_PER_TWIN_ITEM*1, TYPE_STRING, localTwinPtr->twinKey, rulesText);
+    SCHEMA_UPDATE_DEVICE_TWIN(false, SCHEMA_PROPERTY(rulesStatus, status));
+}
+
+/// <summary>
+///     Compile every rule in text into compiledRules[].  Returns the number of rules, or -1 with
+///     the error in status.
+/// </summary>
+static int CompileRules(const char *text, char *status, size_t statusSize)
+{
+    ruleParser_t parser = {.pos = text};
+    int count = 0;
+
+    NextToken(&parser);
+
+    while ((parser.error == NULL) && (parser.token != TOKEN_END)) {
+
+        // Allow empty rules, e.g. a trailing ';'
+        if (parser.token == TOKEN_SEMICOLON) {
+            NextToken(&parser);
+            continue;
+        }
+
+        if (count == RULES_MAX_RULES) {
+            Fail(&parser, "too many rules");
+            break;
+        }
+
+        memset(&compiledRules[count], 0, sizeof(rule_t));
+        parser.rule = &compiledRules[count];
+        parser.stackDepth = 0;
+
+        ParseRule(&parser);
+        if (parser.error == NULL) {
+            count++;
+        }
+    }
+
+    if (parser.error != NULL) {
+        snprintf(status, statusSize, "error: rule %d: %s at '%.16s'", count + 1, parser.error,
+                 parser.tokenStart);
+        return -1;
+    }
+
+    snprintf(status, statusSize, "%d rules", count);
+    return count;
+}
+
+/// <summary>
+///     rule := expression "->" action { "," action } [ ";" ]
+/// </summary>
+static void ParseRule(ruleParser_t *parser)
+{
+    ParseExpression(parser, 1);
+    Expect(parser, TOKEN_ARROW, "expected '->'");
+
+    ParseAction(parser);
+    while ((parser->error == NULL) && (parser->token == TOKEN_COMMA)) {
+        NextToken(parser);
+        ParseAction(parser);
+    }
+
+    if ((parser->error == NULL) && (parser->token != TOKEN_END)) {
+        Expect(parser, TOKEN_SEMICOLON, "expected ';'");
+    }
+}
+
+/// <summary>
+///     Precedence climbing over the binary operators in ruleOperators[]
+/// </summary>
+static void ParseExpression(ruleParser_t *parser, int minPrecedence)
+{
+    ParseUnary(parser);
+
+    while ((parser->error == NULL) && (parser->token == TOKEN_OPERATOR) &&
+           (parser->operator->precedence >= minPrecedence)) {
+
+        const ruleOperator_t *operator = parser->operator;
+        NextToken(parser);
+
+        // Left associative, the right hand side only takes tighter binding operators
+        ParseExpression(parser, operator->precedence + 1);
+        Emit(parser, operator->op, 0, 0, 0.0f);
+    }
+}
+
+static void ParseUnary(ruleParser_t *parser)
+{
+    if ((parser->error == NULL) && (parser->token == TOKEN_OPERATOR) &&
+        ((parser->operator->op == RULE_OP_SUB) || (parser->operator->op == RULE_OP_NOT))) {
+
+        ruleOpcode_t op = (parser->operator->op == RULE_OP_SUB) ? RULE_OP_NEG : RULE_OP_NOT;
+        NextToken(parser);
+        ParseUnary(parser);
+        Emit(parser, op, 0, 0, 0.0f);
+        return;
+    }
+
+    ParsePrimary(parser);
+}
+
+/// <summary>
+///     primary := number | key | "rate" "(" key ")" | "(" expression ")"
+/// </summary>
+static void ParsePrimary(ruleParser_t *parser)
+{
+    if (parser->error != NULL) {
+        return;
+    }
+
+    switch (parser->token) {
+    case TOKEN_NUMBER:
+        Emit(parser, RULE_OP_CONST, 0, 0, parser->number);
+        NextToken(parser);
+        return;
+
+    case TOKEN_LPAREN:
+        NextToken(parser);
+        ParseExpression(parser, 1);
+        Expect(parser, TOKEN_RPAREN, "expected ')'");
+        return;
+
+    case TOKEN_NAME:
+        break;
+
+    default:
+        Fail(parser, "expected a value");
+        return;
+    }
+
+    bool isRate = (strcmp(parser->name, "rate") == 0);
+    if (isRate) {
+        NextToken(parser);
+        Expect(parser, TOKEN_LPAREN, "expected '('");
+        if (parser->error != NULL) {
+            return;
+        }
+        if (parser->token != TOKEN_NAME) {
+            Fail(parser, "expected a key");
+            return;
+        }
+    }
+
+    int outputIndex = sensorRegistry_FindOutput(parser->name);
+    if (outputIndex < 0) {
+        int channel = FindChannel(parser->name);
+        if (channel < 0) {
+            Fail(parser, "unknown key");
+            return;
+        }
+        outputIndex = RULE_CHANNEL_INDEX(channel);
+    }
+
+    if (isRate) {
+        if (parser->rule->rateCount == RULES_MAX_RATES) {
+            Fail(parser, "too many rate()s");
+            return;
+        }
+        Emit(parser, RULE_OP_RATE, outputIndex, parser->rule->rateCount++, 0.0f);
+        NextToken(parser);
+        Expect(parser, TOKEN_RPAREN, "expected ')'");
+    }
+    else {
+        Emit(parser, RULE_OP_LOAD, outputIndex, 0, 0.0f);
+        NextToken(parser);
+    }
+}
+
+/// <summary>
+///     action := name "(" arguments ")", see the list at the top of this file
+/// </summary>
+static void ParseAction(ruleParser_t *parser)
+{
+    if (parser->error != NULL) {
+        return;
+    }
+    if (parser->token != TOKEN_NAME) {
+        Fail(parser, "expected an action");
+        return;
+    }
+    if (parser->rule->actionCount == RULES_MAX_ACTIONS) {
+        Fail(parser, "too many actions");
+        return;
+    }
+
+    ruleAction_t *action = &parser->rule->actions[parser->rule->actionCount];
+
+    if (strcmp(parser->name, "alert") == 0) {
+        action->type = RULE_ACTION_ALERT;
+    }
+    else if (strcmp(parser->name, "gpio") == 0) {
+        action->type = RULE_ACTION_GPIO;
+    }
+    else if (strcmp(parser->name, "sensorPeriod") == 0) {
+        action->type = RULE_ACTION_SENSOR_PERIOD;
+    }
+    else if (strcmp(parser->name, "telemetryPeriod") == 0) {
+        action->type = RULE_ACTION_TELEMETRY_PERIOD;
+    }
+    else {
+        Fail(parser, "unknown action");
+        return;
+    }
+
+    NextToken(parser);
+    Expect(parser, TOKEN_LPAREN, "expected '('");
+    if (parser->error != NULL) {
+        return;
+    }
+
+    switch (action->type) {
+    case RULE_ACTION_ALERT:
+        if (parser->token != TOKEN_NAME) {
+            Fail(parser, "expected an alert name");
+            return;
+        }
+        strcpy(action->name, parser->name);
+        NextToken(parser);
+        break;
+
+    case RULE_ACTION_GPIO:
+        action->target = -1;
+        for (int i = 0; (i < twinArraySize) && (parser->token == TOKEN_NAME); i++) {
+            if ((twinArray[i].twinGPIO != NO_GPIO_ASSOCIATED_WITH_TWIN) &&
+                (strcmp(twinArray[i].twinKey, parser->name) == 0)) {
+                action->target = i;
+            }
+        }
+        if (action->target < 0) {
+            Fail(parser, "expected a GPIO twin key");
+            return;
+        }
+        NextToken(parser);
+        break;
+
+    case RULE_ACTION_SENSOR_PERIOD:
+        action->target = (parser->token == TOKEN_NAME) ? sensorRegistry_FindSensor(parser->name) : -1;
+        if (action->target < 0) {
+            Fail(parser, "expected a sensor name");
+            return;
+        }
+        NextToken(parser);
+        Expect(parser, TOKEN_COMMA, "expected ','");
+        if (parser->error != NULL) {
+            return;
+        }
+        if ((parser->token != TOKEN_NUMBER) || (parser->number < SENSOR_REGISTRY_MIN_PERIOD_MS)) {
+            Fail(parser, "expected a period in ms");
+            return;
+        }
+        action->value = (int)parser->number;
+        NextToken(parser);
+        break;
+
+    case RULE_ACTION_TELEMETRY_PERIOD:
+        if ((parser->token != TOKEN_NUMBER) || (parser->number < 1)) {
+            Fail(parser, "expected a period in seconds");
+            return;
+        }
+        action->value = (int)parser->number;
+        NextToken(parser);
+        break;
+    }
+
+    Expect(parser, TOKEN_RPAREN, "expected ')'");
+    if (parser->error == NULL) {
+        parser->rule->actionCount++;
+    }
+}
+
+static void NextToken(ruleParser_t *parser)
+{
+    while (isspace((unsigned char)*parser->pos)) {
+        parser->pos++;
+    }
+
+    parser->tokenStart = parser->pos;
+    char c = *parser->pos;
+
+    if (c == '\0') {
+        parser->token = TOKEN_END;
+        return;
+    }
+
+    if (isdigit((unsigned char)c) || (c == '.')) {
+        char *end;
+        parser->number = strtof(parser->pos, &end);
+        parser->pos = end;
+        parser->token = TOKEN_NUMBER;
+        return;
+    }
+
+    if (isalpha((unsigned char)c) || (c == '_')) {
+        size_t length = 0;
+        while (isalnum((unsigned char)parser->pos[length]) || (parser->pos[length] == '_')) {
+            length++;
+        }
+        if (length >= sizeof(parser->name)) {
+            Fail(parser, "name too long");
+            parser->token = TOKEN_END;
+            return;
+        }
+        memcpy(parser->name, parser->pos, length);
+        parser->name[length] = '\0';
+        parser->pos += length;
+        parser->token = TOKEN_NAME;
+        return;
+    }
+
+    if (strncmp(parser->pos, "->", 2) == 0) {
+        parser->pos += 2;
+        parser->token = TOKEN_ARROW;
+        return;
+    }
+
+    switch (c) {
+    case '(': parser->token = TOKEN_LPAREN; parser->pos++; return;
+    case ')': parser->token = TOKEN_RPAREN; parser->pos++; return;
+    case ',': parser->token = TOKEN_COMMA; parser->pos++; return;
+    case ';': parser->token = TOKEN_SEMICOLON; parser->pos++; return;
+    default: break;
+    }
+
+    for (size_t i = 0; i < sizeof(ruleOperators) / sizeof(ruleOperators[0]); i++) {
+        size_t length = strlen(ruleOperators[i].text);
+        if (strncmp(parser->pos, ruleOperators[i].text, length) == 0) {
+            parser->operator = &ruleOperators[i];
+            parser->pos += length;
+            parser->token = TOKEN_OPERATOR;
+            return;
+        }
+    }
+
+    Fail(parser, "unexpected character");
+    parser->token = TOKEN_END;
+}
+
+static void Expect(ruleParser_t *parser, ruleToken_t token, const char *error)
+{
+    if (parser->error != NULL) {
+        return;
+    }
+    if (parser->token != token) {
+        Fail(parser, error);
+        return;
+    }
+    NextToken(parser);
+}
+
+/// <summary>
+///     Append an instruction, checking the code size and the stack depth it needs
+/// </summary>
+static void Emit(ruleParser_t *parser, ruleOpcode_t op, int outputIndex, int rateSlot, float constant)
+{
+    if (parser->error != NULL) {
+        return;
+    }
+
+    rule_t *rule = parser->rule;
+    if (rule->codeLength == RULES_MAX_CODE) {
+        Fail(parser, "expression too long");
+        return;
+    }
+
+    switch (op) {
+    case RULE_OP_CONST:
+    case RULE_OP_LOAD:
+    case RULE_OP_RATE:
+        parser->stackDepth++;
+        break;
+    case RULE_OP_NEG:
+    case RULE_OP_NOT:
+        break;
+    default:
+        parser->stackDepth--;
+        break;
+    }
+
+    if (parser->stackDepth > RULES_MAX_STACK) {
+        Fail(parser, "expression too deep");
+        return;
+    }
+
+    rule->code[rule->codeLength++] = (ruleInstruction_t){.op = (uint8_t)op,
+                                                         .rateSlot = (uint8_t)rateSlot,
+                                                         .outputIndex = (int16_t)outputIndex,
+                                                         .constant = constant};
+}
+
+static void Fail(ruleParser_t *parser, const char *error)
+{
+    // Keep the first error, it's the one that explains the rest
+    if (parser->error == NULL) {
+        parser->error = error;
+    }
+}
+
+/// <summary>
+///     Run a rule's program, true if the rule holds.  The compiler has already checked the stack
+///     depth, so there are no checks here.
+/// </summary>
+static bool RunRule(rule_t *rule)
+{
+    float stack[RULES_MAX_STACK];
+    int top = 0;
+    float value;
+    uint64_t readMs;
+
+    for (int pc = 0; pc < rule->codeLength; pc++) {
+
+        const ruleInstruction_t *instruction = &rule->code[pc];
+
+        switch (instruction->op) {
+        case RULE_OP_CONST:
+            stack[top++] = instruction->constant;
+            continue;
+        case RULE_OP_LOAD:
+            if (!ReadInput(instruction->outputIndex, &value, &readMs)) {
+                return false;
+            }
+            stack[top++] = value;
+            continue;
+        case RULE_OP_RATE:
+            if (!ReadInput(instruction->outputIndex, &value, &readMs)) {
+                return false;
+            }
+            stack[top++] = UpdateRate(&rule->rates[instruction->rateSlot], value, readMs);
+            continue;
+        case RULE_OP_NEG:
+            stack[top - 1] = -stack[top - 1];
+            continue;
+        case RULE_OP_NOT:
+            stack[top - 1] = (stack[top - 1] == 0.0f) ? 1.0f : 0.0f;
+            continue;
+        default:
+            break;
+        }
+
+        // Binary operators
+        float b = stack[--top];
+        float a = stack[top - 1];
+        float result;
+
+        switch (instruction->op) {
+        case RULE_OP_ADD: result = a + b; break;
+        case RULE_OP_SUB: result = a - b; break;
+        case RULE_OP_MUL: result = a * b; break;
+        case RULE_OP_DIV: result = (b != 0.0f) ? (a / b) : 0.0f; break;
+        case RULE_OP_LT: result = (a < b); break;
+        case RULE_OP_LE: result = (a <= b); break;
+        case RULE_OP_GT: result = (a > b); break;
+        case RULE_OP_GE: result = (a >= b); break;
+        case RULE_OP_EQ: result = (a == b); break;
+        case RULE_OP_NE: result = (a != b); break;
+        case RULE_OP_AND: result = ((a != 0.0f) && (b != 0.0f)); break;
+        case RULE_OP_OR: result = ((a != 0.0f) || (b != 0.0f)); break;
+        default: result = 0.0f; break;
+        }
+        stack[top - 1] = result;
+    }
+
+    return (top == 1) && (stack[0] != 0.0f);
+}
+
+/// <summary>
+///     The latest value of a sensor registry output or real time application channel, false if
+///     there's no valid reading
+/// </summary>
+static bool ReadInput(int outputIndex, float *value, uint64_t *readMs)
+{
+    if (outputIndex >= 0) {
+        return sensorRegistry_GetValueByIndex(outputIndex, value, readMs);
+    }
+
+    const ruleChannel_t *channel = &channels[RULE_CHANNEL_INDEX(outputIndex)];
+    if (!channel->valid) {
+        return false;
+    }
+    *value = channel->value;
+    *readMs = channel->readMs;
+    return true;
+}
+
+/// <summary>
+///     Index of a real time application channel in channelNames[], -1 if there's no such channel
+/// </summary>
+static int FindChannel(const char *name)
+{
+    for (int i = 0; i < RULES_CHANNEL_COUNT; i++) {
+        if (strcmp(channelNames[i], name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/// <summary>
+///     Flag the real time application channels the running rules use, their samples run the rules
+/// </summary>
+static void MarkUsedChannels(void)
+{
+    for (int i = 0; i < RULES_CHANNEL_COUNT; i++) {
+        channels[i].used = false;
+    }
+
+    for (int i = 0; i < ruleCount; i++) {
+        for (int pc = 0; pc < rules[i].codeLength; pc++) {
+            const ruleInstruction_t *instruction = &rules[i].code[pc];
+            if (((instruction->op == RULE_OP_LOAD) || (instruction->op == RULE_OP_RATE)) &&
+                (instruction->outputIndex < 0)) {
+                channels[RULE_CHANNEL_INDEX(instruction->outputIndex)].used = true;
+            }
+        }
+    }
+}
+
+/// <summary>
+///     Change per second between the last two reads of a value.  Zero until the sensor has been
+///     read twice.
+/// </summary>
+static float UpdateRate(ruleRate_t *rate, float value, uint64_t readMs)
+{
+    if (readMs != rate->lastReadMs) {
+        if (rate->lastReadMs != 0) {
+            rate->ratePerSecond = (value - rate->lastValue) * 1000.0f / (float)(readMs - rate->lastReadMs);
+        }
+        rate->lastValue = value;
+        rate->lastReadMs = readMs;
+    }
+    return rate->ratePerSecond;
+}
+
+static void RunActions(const rule_t *rule, int ruleIndex, bool ruleHolds)
+{
+    for (int i = 0; i < rule->actionCount; i++) {
+
+        const ruleAction_t *action = &rule->actions[i];
+
+        switch (action->type) {
+        case RULE_ACTION_ALERT:
+            if (ruleHolds) {
+                // Rules run after the registry reads, which marked the capture time
+                SCHEMA_SEND_TELEMETRY(true, SCHEMA_TELEMETRY(ruleAlert, action->name),
+                                            SCHEMA_TELEMETRY(ruleIndex, ruleIndex));
+            }
+            break;
+
+        case RULE_ACTION_GPIO: {
+            twin_t *twin = &twinArray[action->target];
+            GPIO_SetValue(*twin->twinFd, (ruleHolds == twin->active_high) ? GPIO_Value_High : GPIO_Value_Low);
+            break;
+        }
+
+        case RULE_ACTION_SENSOR_PERIOD:
+            sensorRegistry_SetPeriodOverride(action->target, ruleHolds ? action->value : 0);
+            break;
+
+        case RULE_ACTION_TELEMETRY_PERIOD: {
+#ifdef ENABLE_ADAPTIVE_TELEMETRY
+            // Go back to the adaptive period when the rule clears
+            if (adaptivePeriod_Enabled()) {
+                adaptivePeriod_SetOverride(ruleHolds ? action->value : 0);
+                break;
+            }
+#endif // ENABLE_ADAPTIVE_TELEMETRY
+
+            // Go back to the telemetryPeriod device twin setting when the rule clears
+            int periodSeconds = ruleHolds ? action->value : sendTelemetryPeriod;
+            if (periodSeconds > 0) {
+                struct timespec newPeriod = {.tv_sec = periodSeconds, .tv_nsec = 0};
+                SetEventLoopTimerPeriod(telemetrytxIntervalr, &newPeriod);
+            }
+            else {
+                DisarmEventLoopTimer(telemetrytxIntervalr);
+            }
+            break;
+        }
+        }
+    }
+}
+
+/// <summary>
+///     Undo the actions of every rule that currently holds
+/// </summary>
+static void ReleaseRules(void)
+{
+    for (int i = 0; i < ruleCount; i++) {
+        if (rules[i].active) {
+            rules[i].active = false;
+            RunActions(&rules[i], i, false);
+        }
+    }
+}
+
+#endif // ENABLE_RULES_ENGINE
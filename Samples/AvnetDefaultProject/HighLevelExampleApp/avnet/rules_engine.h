@@ -0,0 +1,134 @@
+#ifndef RULES_ENGINE_H
+#define RULES_ENGINE_H
+
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "build_options.h"
+
+// Size of the "rules" device twin string
+#define RULES_TEXT_MAX_LENGTH 512
+
+// Limits on the compiled rules, these bound the time and memory each evaluation takes
+#define RULES_MAX_RULES 8
+#define RULES_MAX_CODE 24       // Instructions per rule expression
+#define RULES_MAX_STACK 8       // Evaluation stack depth
+#define RULES_MAX_RATES 2       // rate() calls per rule
+#define RULES_MAX_ACTIONS 3     // Actions per rule
+#define RULES_NAME_LENGTH 24    // alert() names
+
+typedef enum {
+    RULE_OP_CONST,
+    RULE_OP_LOAD,               // Push a sensor value, ends the evaluation (false) if it's not valid
+    RULE_OP_RATE,               // Push a sensor value's change per second
+    RULE_OP_NEG,
+    RULE_OP_NOT,
+    RULE_OP_ADD,
+    RULE_OP_SUB,
+    RULE_OP_MUL,
+    RULE_OP_DIV,
+    RULE_OP_LT,
+    RULE_OP_LE,
+    RULE_OP_GT,
+    RULE_OP_GE,
+    RULE_OP_EQ,
+    RULE_OP_NE,
+    RULE_OP_AND,
+    RULE_OP_OR
+} ruleOpcode_t;
+
+typedef struct {
+    uint8_t op;                 // ruleOpcode_t
+    uint8_t rateSlot;           // RULE_OP_RATE only
+    int16_t outputIndex;        // RULE_OP_LOAD/RULE_OP_RATE, see sensorRegistry_FindOutput(), or
+                                // RULE_CHANNEL_INDEX(n) for a real time application channel
+    float constant;             // RULE_OP_CONST only
+} ruleInstruction_t;
+
+// Real time application channels are encoded below the sensor registry output indexes
+#define RULE_CHANNEL_INDEX(channel) (-1 - (channel))
+
+typedef enum {
+    RULE_ACTION_ALERT,              // alert(name): send a ruleAlert telemetry message right away
+    RULE_ACTION_GPIO,               // gpio(twinKey): drive a GPIO from twinArray[] while the rule holds
+    RULE_ACTION_SENSOR_PERIOD,      // sensorPeriod(sensorName, ms): read a sensor faster/slower while the rule holds
+    RULE_ACTION_TELEMETRY_PERIOD    // telemetryPeriod(seconds): change the telemetry period while the rule holds
+} ruleActionType_t;
+
+typedef struct {
+    ruleActionType_t type;
+    int target;                 // twinArray[] or sensorArray[] index
+    int value;                  // Period for the period actions
+    char name[RULES_NAME_LENGTH];
+} ruleAction_t;
+
+typedef struct {
+    float lastValue;
+    float ratePerSecond;
+    uint64_t lastReadMs;
+} ruleRate_t;
+
+typedef struct {
+    ruleInstruction_t code[RULES_MAX_CODE];
+    int codeLength;
+    ruleAction_t actions[RULES_MAX_ACTIONS];
+    int actionCount;
+    ruleRate_t rates[RULES_MAX_RATES];
+    int rateCount;
+    bool active;
+    uint32_t triggerCount;
+} rule_t;
+
+#ifdef ENABLE_RULES_ENGINE
+
+#ifndef ENABLE_SENSOR_REGISTRY
+#error "ENABLE_RULES_ENGINE requires ENABLE_SENSOR_REGISTRY"
+#endif
+
+#include "parson.h"
+
+extern char rulesText[RULES_TEXT_MAX_LENGTH];
+
+// Runs every rule against the latest sensor values, called by the sensor registry after a read
+void rulesEngine_Evaluate(void);
+
+// Sample observer (sample_observer.h), keeps the latest real time application samples and runs
+// the rules that use them
+void rulesEngine_Observe(const char *channel, float value, uint64_t timeMs);
+
+// Releases anything the active rules are driving (GPIOs, period changes)
+void rulesEngine_Cleanup(void);
+
+// Device twin handler for the "rules" key
+void setRulesFunction(void* thisTwinPtr, JSON_Object *desiredProperties);
+
+#endif // ENABLE_RULES_ENGINE
+
+#endif // RULES_ENGINE_H
@@ -27,6 +27,7 @@ SOFTWARE.
 
 #include "sd1306.h"
 #include "font.h"
+#include "../common/trace_ring.h"
 
 // pixel data of OLED screen
 uint8_t oled_buffer[BUFFER_SIZE];
@@ -68,6 +69,7 @@ int32_t sd1306_send_command(uint8_t addr, uint8_t cmd)
 	data_to_send[1] = cmd;
 	// Send the data by I2C bus
 	retval = I2CMaster_Write(i2cFd, addr, data_to_send, 2);
+	TRACE(TRACE_EVT_I2C_WRITE, addr, retval);
 	return retval;
 }
 
@@ -93,6 +95,7 @@ int32_t sd1306_write_data(uint8_t addr, uint8_t *data)
 
 	// Send the data by I2C bus
 	retval = I2CMaster_Write(i2cFd, addr, data_to_send, 1025);
+	TRACE(TRACE_EVT_I2C_WRITE, addr, retval);
 	return retval;
 }
 
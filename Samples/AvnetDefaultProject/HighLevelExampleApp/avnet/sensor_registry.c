@@ -0,0 +1,423 @@
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Sensor registry
+//
+//  Each sensor the high level application reads is an entry in sensorArray[] below, with its read
+//  function, how often to read it and the keys/units of the values it produces.  A single
+//  one shot timer is always armed for the sensor that is due next.  When it fires, every sensor
+//  that is due is read and the timer is re-armed for the next one, so each sensor is read at its
+//  own rate without a timer per sensor.
+//
+//  Each sensor gets a device twin key "<sensorName>PeriodMs" to change its period at runtime, 0
+//  stops reading the sensor.  Sensors with .periodMs = SENSOR_PERIOD_DEFAULT follow the
+//  sensorPollPeriod device twin until they are given their own period.
+//
+//  To add a sensor write a read function with the sensorReadFunction signature, declare it in
+//  sensor_registry.h and add an entry to sensorArray[].
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "sensor_registry.h"
+
+#ifdef ENABLE_SENSOR_REGISTRY
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <applibs/log.h>
+#include "../common/app_log.h"
+#include "device_twin.h"
+#include "../common/eventloop_timer_utilities.h"
+#include "../common/latency_trace.h"
+#include "rules_engine.h"
+#include "../common/sample_observer.h"
+#include "../common/schema_keys.h"
+#include "../common/monotonic_time.h"
+
+// Output keys are declared in SCHEMA_SENSOR_TELEMETRY_LIST and each sensor's period twin in
+// SCHEMA_SENSOR_PROPERTY_LIST (schema.h)
+sensor_t sensorArray[] = {
+    {
+        .sensorName = "wifi",
+        .readFunction = readWifiSensor,
+        .periodMs = SENSOR_PERIOD_DEFAULT,
+        .outputs = {{SCHEMA_KEY(wifiRssi), "dBm"}, {SCHEMA_KEY(wifiFrequency), "MHz"}}
+    },
+    {
+        .sensorName = "memory",
+        .readFunction = readMemorySensor,
+        .periodMs = SENSOR_PERIOD_DEFAULT,
+        .outputs = {{SCHEMA_KEY(memoryHighWaterKB), "KiB"}}
+    },
+#ifdef M4_INTERCORE_COMMS
+    {
+        // Asks each real time application for raw data, the responses arrive through the
+        // m4rawDataHandler
+        .sensorName = "realTime",
+        .readFunction = readRealTimeSensors,
+        .periodMs = SENSOR_PERIOD_DEFAULT,
+    },
+#endif // M4_INTERCORE_COMMS
+};
+
+int sensorArraySize = sizeof(sensorArray) / sizeof(sensor_t);
+
+static EventLoopTimer *sensorRegistryTimer = NULL;
+
+// Live mode period, 0 when no live session is running
+static int livePeriodMs = 0;
+
+static void SensorRegistryTimerEventHandler(EventLoopTimer *timer);
+static void ScheduleNextRead(void);
+static int EffectivePeriodMs(const sensor_t *sensor);
+static void ReportPeriod(const sensor_t *sensor);
+
+ExitCode sensorRegistry_Init(EventLoop *el)
+{
+    sensorRegistryTimer = CreateEventLoopDisarmedTimer(el, &SensorRegistryTimerEventHandler);
+    if (sensorRegistryTimer == NULL) {
+        return ExitCode_Init_sensorPollTimer;
+    }
+
+    uint64_t now = monotonicMs();
+
+    for (int i = 0; i < sensorArraySize; i++) {
+
+        sensor_t *sensor = &sensorArray[i];
+
+        sensor->outputCount = 0;
+        while ((sensor->outputCount < SENSOR_MAX_OUTPUTS) && (sensor->outputs[sensor->outputCount].key != NULL)) {
+            sensor->outputCount++;
+        }
+
+        snprintf(sensor->periodTwinKey, sizeof(sensor->periodTwinKey), "%sPeriodMs", sensor->sensorName);
+        sensor->valid = false;
+        sensor->readCount = 0;
+        sensor->lastReadMs = 0;
+        sensor->overridePeriodMs = 0;
+
+        // The first read happens one period after startup, as the sensorPollTimer always did
+        sensor->nextReadMs = now + (uint64_t)EffectivePeriodMs(sensor);
+
+        LOG_INFO(APP_LOG_CAT_SENSOR, "Sensor %s every %d ms\n", sensor->sensorName, EffectivePeriodMs(sensor));
+        for (int j = 0; j < sensor->outputCount; j++) {
+            LOG_INFO(APP_LOG_CAT_SENSOR, "    %s (%s)\n", sensor->outputs[j].key, sensor->outputs[j].units);
+        }
+    }
+
+    ScheduleNextRead();
+    return ExitCode_Success;
+}
+
+void sensorRegistry_Cleanup(void)
+{
+    DisposeEventLoopTimer(sensorRegistryTimer);
+    sensorRegistryTimer = NULL;
+}
+
+void sensorRegistry_DefaultPeriodChanged(void)
+{
+    uint64_t now = monotonicMs();
+
+    for (int i = 0; i < sensorArraySize; i++) {
+        if (sensorArray[i].periodMs == SENSOR_PERIOD_DEFAULT) {
+            sensorArray[i].nextReadMs = now + (uint64_t)EffectivePeriodMs(&sensorArray[i]);
+            ReportPeriod(&sensorArray[i]);
+        }
+    }
+
+    ScheduleNextRead();
+}
+
+/// <summary>
+///     Called from DeviceTwinCallbackHandler(), handles any <sensorName>PeriodMs keys
+/// </summary>
+void sensorRegistry_DeviceTwinHandler(JSON_Object *desiredProperties)
+{
+    bool periodChanged = false;
+
+    for (int i = 0; i < sensorArraySize; i++) {
+
+        sensor_t *sensor = &sensorArray[i];
+
+        if (json_object_has_value(desiredProperties, sensor->periodTwinKey) == 0) {
+            continue;
+        }
+
+        int newPeriodMs = (int)json_object_get_number(desiredProperties, sensor->periodTwinKey);
+        if ((newPeriodMs < 0) || ((newPeriodMs > 0) && (newPeriodMs < SENSOR_REGISTRY_MIN_PERIOD_MS))) {
+
+            // The data is out of range, report the current period back without changing anything
+            LOG_WARN(APP_LOG_CAT_TWIN, "Received invalid device update for key %s.\n", sensor->periodTwinKey);
+            ReportPeriod(sensor);
+            continue;
+        }
+
+        sensor->periodMs = newPeriodMs;
+        sensor->nextReadMs = monotonicMs() + (uint64_t)newPeriodMs;
+        periodChanged = true;
+
+        LOG_INFO(APP_LOG_CAT_TWIN, "Received device update. New %s is %d\n", sensor->periodTwinKey, newPeriodMs);
+        ReportPeriod(sensor);
+    }
+
+    if (periodChanged) {
+        ScheduleNextRead();
+    }
+}
+
+void sensorRegistry_SendReportedPeriods(void)
+{
+    for (int i = 0; i < sensorArraySize; i++) {
+        ReportPeriod(&sensorArray[i]);
+    }
+}
+
+bool sensorRegistry_GetValue(const char *key, float *value)
+{
+    for (int i = 0; i < sensorArraySize; i++) {
+        for (int j = 0; j < sensorArray[i].outputCount; j++) {
+            if (strcmp(sensorArray[i].outputs[j].key, key) == 0) {
+                *value = sensorArray[i].values[j];
+                return sensorArray[i].valid;
+            }
+        }
+    }
+    return false;
+}
+
+bool sensorRegistry_SetValue(const char *key, float value)
+{
+    for (int i = 0; i < sensorArraySize; i++) {
+        for (int j = 0; j < sensorArray[i].outputCount; j++) {
+            if (strcmp(sensorArray[i].outputs[j].key, key) == 0) {
+                sensorArray[i].values[j] = value;
+                sensorArray[i].valid = true;
+                sensorArray[i].lastReadMs = monotonicMs();
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+int sensorRegistry_FindSensor(const char *sensorName)
+{
+    for (int i = 0; i < sensorArraySize; i++) {
+        if (strcmp(sensorArray[i].sensorName, sensorName) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int sensorRegistry_FindOutput(const char *key)
+{
+    for (int i = 0; i < sensorArraySize; i++) {
+        for (int j = 0; j < sensorArray[i].outputCount; j++) {
+            if (strcmp(sensorArray[i].outputs[j].key, key) == 0) {
+                return (i * SENSOR_MAX_OUTPUTS) + j;
+            }
+        }
+    }
+    return -1;
+}
+
+bool sensorRegistry_GetValueByIndex(int outputIndex, float *value, uint64_t *readMs)
+{
+    if ((outputIndex < 0) || (outputIndex >= sensorArraySize * SENSOR_MAX_OUTPUTS)) {
+        return false;
+    }
+
+    const sensor_t *sensor = &sensorArray[outputIndex / SENSOR_MAX_OUTPUTS];
+    if ((outputIndex % SENSOR_MAX_OUTPUTS) >= sensor->outputCount) {
+        return false;
+    }
+
+    *value = sensor->values[outputIndex % SENSOR_MAX_OUTPUTS];
+    *readMs = sensor->lastReadMs;
+    return sensor->valid;
+}
+
+void sensorRegistry_SetPeriodOverride(int sensorIndex, int periodMs)
+{
+    sensor_t *sensor = &sensorArray[sensorIndex];
+
+    if (sensor->overridePeriodMs == periodMs) {
+        return;
+    }
+    sensor->overridePeriodMs = periodMs;
+
+    // Don't wait out the old period before the faster one takes effect
+    uint64_t nextReadMs = monotonicMs() + (uint64_t)EffectivePeriodMs(sensor);
+    if ((sensor->nextReadMs > nextReadMs) || (periodMs == 0)) {
+        sensor->nextReadMs = nextReadMs;
+    }
+
+    LOG_DEBUG(APP_LOG_CAT_SENSOR, "Sensor %s period %d ms\n", sensor->sensorName, EffectivePeriodMs(sensor));
+    ScheduleNextRead();
+}
+
+void sensorRegistry_SetLivePeriod(int periodMs)
+{
+    if (livePeriodMs == periodMs) {
+        return;
+    }
+    livePeriodMs = periodMs;
+
+    // Bring the next read of each sensor forward to the new period, the same as an override
+    uint64_t now = monotonicMs();
+    for (int i = 0; i < sensorArraySize; i++) {
+        sensor_t *sensor = &sensorArray[i];
+        int sensorPeriodMs = EffectivePeriodMs(sensor);
+        if ((sensorPeriodMs > 0) && (sensor->nextReadMs > now + (uint64_t)sensorPeriodMs)) {
+            sensor->nextReadMs = now + (uint64_t)sensorPeriodMs;
+        }
+    }
+
+    LOG_DEBUG(APP_LOG_CAT_SENSOR, "Sensor registry live period %d ms\n", periodMs);
+    ScheduleNextRead();
+}
+
+/// <summary>
+///     Sensor registry timer event:  Read every sensor that is due, then arm the timer for the
+///     next one
+/// </summary>
+static void SensorRegistryTimerEventHandler(EventLoopTimer *timer)
+{
+    if (ConsumeEventLoopTimerEvent(timer) != 0) {
+        exitCode = ExitCode_ReadSensorTimer_Consume;
+        return;
+    }
+
+    uint64_t now = monotonicMs();
+#ifdef ENABLE_RULES_ENGINE
+    bool sensorRead = false;
+#endif // ENABLE_RULES_ENGINE
+
+    for (int i = 0; i < sensorArraySize; i++) {
+
+        sensor_t *sensor = &sensorArray[i];
+        int periodMs = EffectivePeriodMs(sensor);
+
+        if ((periodMs <= 0) || (sensor->nextReadMs > now)) {
+            continue;
+        }
+
+        sensor->valid = sensor->readFunction(sensor);
+        sensor->readCount++;
+        sensor->lastReadMs = now;
+
+        // Telemetry built from this sample is timed from the read
+        if (sensor->valid) {
+            LATENCY_MARK_CAPTURE();
+        }
+
+#ifdef ENABLE_SAMPLE_OBSERVERS
+        for (int j = 0; (j < sensor->outputCount) && sensor->valid; j++) {
+            SAMPLE_PUBLISH(sensor->outputs[j].key, sensor->values[j]);
+        }
+#endif // ENABLE_SAMPLE_OBSERVERS
+
+#ifdef ENABLE_RULES_ENGINE
+        sensorRead = true;
+#endif // ENABLE_RULES_ENGINE
+
+        // Stay on the sensor's own schedule, but don't try to catch up on reads we missed
+        sensor->nextReadMs += (uint64_t)periodMs;
+        if (sensor->nextReadMs <= now) {
+            sensor->nextReadMs = now + (uint64_t)periodMs;
+        }
+    }
+
+#ifdef ENABLE_RULES_ENGINE
+    // Rules may change sensor periods, so run them before picking the next read time
+    if (sensorRead) {
+        rulesEngine_Evaluate();
+    }
+#endif // ENABLE_RULES_ENGINE
+
+    ScheduleNextRead();
+}
+
+/// <summary>
+///     Arm the timer for the enabled sensor with the earliest nextReadMs, or disarm it if every
+///     sensor is disabled
+/// </summary>
+static void ScheduleNextRead(void)
+{
+    uint64_t nextReadMs = UINT64_MAX;
+
+    for (int i = 0; i < sensorArraySize; i++) {
+        if ((EffectivePeriodMs(&sensorArray[i]) > 0) && (sensorArray[i].nextReadMs < nextReadMs)) {
+            nextReadMs = sensorArray[i].nextReadMs;
+        }
+    }
+
+    if (nextReadMs == UINT64_MAX) {
+        DisarmEventLoopTimer(sensorRegistryTimer);
+        return;
+    }
+
+    // A zero timespec would disarm the timer, so a sensor that is already due waits 1 ms
+    uint64_t now = monotonicMs();
+    uint64_t delayMs = (nextReadMs > now) ? (nextReadMs - now) : 1;
+
+    struct timespec delay = {.tv_sec = (time_t)(delayMs / 1000),
+                             .tv_nsec = (long)((delayMs % 1000) * 1000 * 1000)};
+    SetEventLoopTimerOneShot(sensorRegistryTimer, &delay);
+}
+
+static int EffectivePeriodMs(const sensor_t *sensor)
+{
+    int periodMs = sensor->periodMs;
+    if (sensor->overridePeriodMs > 0) {
+        periodMs = sensor->overridePeriodMs;
+    }
+    else if (sensor->periodMs == SENSOR_PERIOD_DEFAULT) {
+        periodMs = readSensorPeriod * 1000;
+    }
+
+    // A live session only speeds up sensors that are enabled
+    if ((livePeriodMs > 0) && (periodMs > livePeriodMs)) {
+        return livePeriodMs;
+    }
+    return periodMs;
+}
+
+static void ReportPeriod(const sensor_t *sensor)
+{
+#ifdef IOT_HUB_APPLICATION
+    updateDeviceTwin(true, ARGS_PER_TWIN_ITEM*1, TYPE_INT, sensor->periodTwinKey, EffectivePeriodMs(sensor));
+#endif // IOT_HUB_APPLICATION
+}
+
+#endif // ENABLE_SENSOR_REGISTRY
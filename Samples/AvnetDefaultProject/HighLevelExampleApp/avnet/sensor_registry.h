@@ -0,0 +1,123 @@
+#ifndef SENSOR_REGISTRY_H
+#define SENSOR_REGISTRY_H
+
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "build_options.h"
+
+// Most output values a single sensor can declare
+#define SENSOR_MAX_OUTPUTS 4
+
+// Use the sensorPollPeriod device twin (readSensorPeriod) as this sensor's period
+#define SENSOR_PERIOD_DEFAULT -1
+
+// Smallest per sensor period accepted from the <sensorName>PeriodMs device twin
+#ifndef SENSOR_REGISTRY_MIN_PERIOD_MS
+#define SENSOR_REGISTRY_MIN_PERIOD_MS 100
+#endif
+
+// Room for "<sensorName>PeriodMs"
+#define SENSOR_TWIN_KEY_LENGTH 32
+
+// One value produced by a sensor read
+typedef struct {
+    const char *key;    // Telemetry key, must be unique across all sensors
+    const char *units;
+} sensorOutput_t;
+
+// The read function is passed its sensorArray[] entry.  It writes one value per declared output
+// into values[] and returns true if they are valid.  Sensors that respond asynchronously (real
+// time applications) can publish their values later with sensorRegistry_SetValue().
+typedef bool (*sensorReadFunction)(void*);
+
+typedef struct {
+    char *sensorName;
+    sensorReadFunction readFunction;
+    int periodMs;                               // 0 to disable, SENSOR_PERIOD_DEFAULT to follow sensorPollPeriod
+    sensorOutput_t outputs[SENSOR_MAX_OUTPUTS];
+
+    // Managed by the registry
+    int outputCount;
+    float values[SENSOR_MAX_OUTPUTS];
+    bool valid;
+    uint32_t readCount;
+    uint64_t lastReadMs;
+    uint64_t nextReadMs;
+    int overridePeriodMs;                       // Set by a rule, takes priority over periodMs
+    char periodTwinKey[SENSOR_TWIN_KEY_LENGTH];
+} sensor_t;
+
+#ifdef ENABLE_SENSOR_REGISTRY
+
+#include <applibs/eventloop.h>
+#include "parson.h"
+#include "../common/exitcodes.h"
+
+extern sensor_t sensorArray[];
+extern int sensorArraySize;
+
+ExitCode sensorRegistry_Init(EventLoop *el);
+void sensorRegistry_Cleanup(void);
+
+// Called after the sensorPollPeriod twin changes readSensorPeriod
+void sensorRegistry_DefaultPeriodChanged(void);
+
+// Device twin support for the generated <sensorName>PeriodMs keys
+void sensorRegistry_DeviceTwinHandler(JSON_Object *desiredProperties);
+void sensorRegistry_SendReportedPeriods(void);
+
+// Latest value for an output key, returns false if the key is unknown or has no valid reading
+bool sensorRegistry_GetValue(const char *key, float *value);
+bool sensorRegistry_SetValue(const char *key, float value);
+
+// Lookups for code that resolves keys once and reads values often.  An output index covers every
+// output of every sensor, sensorIndex * SENSOR_MAX_OUTPUTS + output.
+int sensorRegistry_FindSensor(const char *sensorName);
+int sensorRegistry_FindOutput(const char *key);
+bool sensorRegistry_GetValueByIndex(int outputIndex, float *value, uint64_t *readMs);
+
+// Temporarily read a sensor at periodMs, 0 goes back to its own period
+void sensorRegistry_SetPeriodOverride(int sensorIndex, int periodMs);
+
+// Read every enabled sensor at least every periodMs, 0 goes back to the sensors' own periods.
+// Used by live mode, sensors that are already faster and disabled sensors are not changed.
+void sensorRegistry_SetLivePeriod(int periodMs);
+
+// Sensor read functions
+bool readWifiSensor(void *thisSensor);
+bool readMemorySensor(void *thisSensor);
+#ifdef M4_INTERCORE_COMMS
+bool readRealTimeSensors(void *thisSensor);
+#endif // M4_INTERCORE_COMMS
+
+#endif // ENABLE_SENSOR_REGISTRY
+
+#endif // SENSOR_REGISTRY_H
@@ -0,0 +1,364 @@
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Variance adaptive telemetry period
+//
+//  adaptivePeriod_Observe() is a sample observer (sample_observer.h), it sees every sample from
+//  the sensor path and the real time application raw data handlers with its channel name.  Each
+//  channel keeps two exponentially weighted means and variances (channel_stats.h), a fast one
+//  for recent activity (ADAPTIVE_FAST_HALF_LIFE_SECONDS) and a slow one for the channel's
+//  normal activity (ADAPTIVE_SLOW_HALF_LIFE_SECONDS).  A channel's activity is the ratio of the two
+//  variances.  It is about 1 for a channel behaving as usual, more when the channel is noisier
+//  or moving faster than usual (a ramp shows up as variance around the lagging mean) and less
+//  when it has gone quiet.  The units cancel, so channels of any kind can be compared.
+//
+//  The most active channel listed in the adaptiveChannels device twin (every channel when it is
+//  empty) sets a target period between adaptiveMinSeconds and adaptiveMaxSeconds:
+//
+//      activity <= ADAPTIVE_QUIET_RATIO    adaptiveMaxSeconds
+//      activity >= ADAPTIVE_ACTIVE_RATIO   adaptiveMinSeconds
+//      in between                          geometric interpolation on log(activity)
+//
+//  The period in use only moves when the target is more than ADAPTIVE_HYSTERESIS away from it.
+//  A shorter target is applied as soon as a sample calls for it, so a burst is reported
+//  densely from its start.  A longer target is approached on each telemetry message, at most
+//  ADAPTIVE_MAX_GROWTH at a time, so a device goes quiet gradually.  The period in use is sent
+//  as the adaptivePeriodSeconds reported property.
+//
+//  While it is enabled the scheduler owns the telemetry timer.  The telemetryPeriod device
+//  twin and direct method set the starting period and the period used when the scheduler is
+//  disabled, the offline backlog multiplier and the rules engine telemetryPeriod action are
+//  applied on top through adaptivePeriod_SetMultiplier() and adaptivePeriod_SetOverride().
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "adaptive_period.h"
+
+#ifdef ENABLE_ADAPTIVE_TELEMETRY
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <applibs/log.h>
+#include "app_log.h"
+#include "eventloop_timer_utilities.h"
+#include "../avnet/device_twin.h"
+#include "schema_keys.h"
+
+int adaptiveMinSeconds = ADAPTIVE_DEFAULT_MIN_SECONDS;
+int adaptiveMaxSeconds = ADAPTIVE_DEFAULT_MAX_SECONDS;
+char adaptiveChannels[ADAPTIVE_CHANNELS_MAX_LENGTH] = "";
+
+static adaptiveChannel_t channels[ADAPTIVE_MAX_CHANNELS];
+static int channelCount = 0;
+
+// The adaptive period, 0 until the scheduler has started
+static int periodSeconds = 0;
+static int periodMultiplier = 1;
+static int overrideSeconds = 0;
+
+static adaptiveChannel_t *FindChannel(const char *name);
+static bool IsSelected(const char *name);
+static int TargetPeriod(void);
+static void StartPeriod(void);
+static void SetPeriod(int seconds);
+static void ApplyTimer(void);
+static int ClampPeriod(int seconds);
+
+void adaptivePeriod_Observe(const char *channelName, float value, uint64_t timeMs)
+{
+    adaptiveChannel_t *channel = FindChannel(channelName);
+    if ((channel == NULL) || !isfinite(value)) {
+        return;
+    }
+
+    ewmaStats_Update(&channel->fast, value, timeMs, (float)ADAPTIVE_FAST_HALF_LIFE_SECONDS, ADAPTIVE_WARMUP_SAMPLES);
+    ewmaStats_Update(&channel->slow, value, timeMs, (float)ADAPTIVE_SLOW_HALF_LIFE_SECONDS, ADAPTIVE_WARMUP_SAMPLES);
+
+    if (!adaptivePeriod_Enabled() || !channel->selected) {
+        return;
+    }
+
+    // Report a burst right away
+    StartPeriod();
+    int target = TargetPeriod();
+    if ((target > 0) && ((float)target < (float)periodSeconds * (1.0f - ADAPTIVE_HYSTERESIS))) {
+        SetPeriod(target);
+    }
+}
+
+void adaptivePeriod_TimerTick(void)
+{
+    if (!adaptivePeriod_Enabled()) {
+        return;
+    }
+
+    StartPeriod();
+    int target = TargetPeriod();
+    if (target == 0) {
+        return;
+    }
+
+    if ((float)target < (float)periodSeconds * (1.0f - ADAPTIVE_HYSTERESIS)) {
+        SetPeriod(target);
+    }
+    else if ((float)target > (float)periodSeconds * (1.0f + ADAPTIVE_HYSTERESIS)) {
+        int grown = (int)ceilf((float)periodSeconds * ADAPTIVE_MAX_GROWTH);
+        SetPeriod((target < grown) ? target : grown);
+    }
+}
+
+bool adaptivePeriod_Enabled(void)
+{
+    return (adaptiveMinSeconds > 0) && (adaptiveMaxSeconds > 0);
+}
+
+void adaptivePeriod_SetMultiplier(int multiplier)
+{
+    periodMultiplier = multiplier;
+    if (adaptivePeriod_Enabled()) {
+        StartPeriod();
+        ApplyTimer();
+    }
+}
+
+void adaptivePeriod_SetOverride(int seconds)
+{
+    overrideSeconds = seconds;
+    if (adaptivePeriod_Enabled()) {
+        StartPeriod();
+        ApplyTimer();
+    }
+}
+
+#ifdef IOT_HUB_APPLICATION
+///<summary>
+///		Device twin handler for adaptiveMinSeconds and adaptiveMaxSeconds.  0 disables the
+///     scheduler and the telemetryPeriod device twin sets the period again.
+///</summary>
+void setAdaptivePeriodFunction(void* thisTwinPtr, JSON_Object *desiredProperties){
+
+    // Declare a local variable to point to the deviceTwin table entry and cast the incomming void* to a twin_t*
+    twin_t *localTwinPtr = (twin_t*)thisTwinPtr;
+
+    int newValue = (int)json_object_get_number(desiredProperties, localTwinPtr->twinKey);
+    if (newValue >= 0) {
+        *(int *)localTwinPtr->twinVar = newValue;
+        LOG_INFO(APP_LOG_CAT_TWIN, "Received device update. New %s is %d\n", localTwinPtr->twinKey, newValue);
+    }
+    else {
+        LOG_WARN(APP_LOG_CAT_TWIN, "Received invalid device update for key %s.\n", localTwinPtr->twinKey);
+    }
+    updateDeviceTwin(true, ARGS_PER_TWIN_ITEM*1, TYPE_INT, localTwinPtr->twinKey, *(int *)localTwinPtr->twinVar);
+
+    if (adaptivePeriod_Enabled()) {
+
+        // Keep the period in use if it's still inside the bounds
+        StartPeriod();
+        SetPeriod(ClampPeriod(periodSeconds));
+    }
+    else if (periodSeconds != 0) {
+
+        // Back to the telemetryPeriod device twin
+        periodSeconds = 0;
+        if (telemetrytxIntervalr == NULL) {
+            return;
+        }
+        if (sendTelemetryPeriod > 0) {
+            struct timespec newPeriod = {.tv_sec = sendTelemetryPeriod * periodMultiplier, .tv_nsec = 0};
+            SetEventLoopTimerPeriod(telemetrytxIntervalr, &newPeriod);
+        }
+        else {
+            DisarmEventLoopTimer(telemetrytxIntervalr);
+        }
+    }
+}
+
+///<summary>
+///		Device twin handler for adaptiveChannels, a comma separated list of the channels that
+///     set the period.  An empty list selects every channel.
+///</summary>
+void setAdaptiveChannelsFunction(void* thisTwinPtr, JSON_Object *desiredProperties){
+
+    // Declare a local variable to point to the deviceTwin table entry and cast the incomming void* to a twin_t*
+    twin_t *localTwinPtr = (twin_t*)thisTwinPtr;
+
+    const char *newChannels = json_object_get_string(desiredProperties, localTwinPtr->twinKey);
+    if (newChannels == NULL) {
+        newChannels = "";
+    }
+
+    if (strlen(newChannels) < ADAPTIVE_CHANNELS_MAX_LENGTH) {
+        strcpy(adaptiveChannels, newChannels);
+        LOG_INFO(APP_LOG_CAT_TWIN, "Received device update. New %s is %s\n", localTwinPtr->twinKey, adaptiveChannels);
+
+        // The statistics are kept, only the selection changes
+        for (int i = 0; i < channelCount; i++) {
+            channels[i].selected = IsSelected(channels[i].name);
+        }
+    }
+    else {
+        LOG_WARN(APP_LOG_CAT_TWIN, "Received invalid device update for key %s, longer than %d characters\n",
+                                   localTwinPtr->twinKey, ADAPTIVE_CHANNELS_MAX_LENGTH - 1);
+    }
+
+    updateDeviceTwin(true, ARGS_PER_TWIN_ITEM*1, TYPE_STRING, localTwinPtr->twinKey, adaptiveChannels);
+}
+#endif // IOT_HUB_APPLICATION
+
+/// <summary>
+///     The period the most active selected channel calls for, 0 if no selected channel has
+///     finished warming up
+/// </summary>
+static int TargetPeriod(void)
+{
+    float activity = 0.0f;
+    bool warm = false;
+
+    for (int i = 0; i < channelCount; i++) {
+
+        const adaptiveChannel_t *channel = &channels[i];
+        if (!channel->selected || (channel->slow.sampleCount < ADAPTIVE_WARMUP_SAMPLES)) {
+            continue;
+        }
+
+        // A channel that has never moved would divide by zero, allow it 0.1% of its level
+        float level = 1e-3f * fabsf(channel->slow.mean);
+        float normalVariance = fmaxf(channel->slow.variance, fmaxf(level * level, 1e-6f));
+        activity = fmaxf(activity, channel->fast.variance / normalVariance);
+        warm = true;
+    }
+
+    if (!warm) {
+        return 0;
+    }
+
+    int minSeconds = (adaptiveMinSeconds < adaptiveMaxSeconds) ? adaptiveMinSeconds : adaptiveMaxSeconds;
+    int maxSeconds = (adaptiveMinSeconds < adaptiveMaxSeconds) ? adaptiveMaxSeconds : adaptiveMinSeconds;
+    if (activity <= ADAPTIVE_QUIET_RATIO) {
+        return maxSeconds;
+    }
+
+    float position = fminf(logf(activity / ADAPTIVE_QUIET_RATIO) / logf(ADAPTIVE_ACTIVE_RATIO / ADAPTIVE_QUIET_RATIO), 1.0f);
+    float target = (float)maxSeconds * powf((float)minSeconds / (float)maxSeconds, position);
+    return ClampPeriod((int)lroundf(target));
+}
+
+/// <summary>
+///     Start from the telemetryPeriod device twin the first time the scheduler runs
+/// </summary>
+static void StartPeriod(void)
+{
+    if (periodSeconds == 0) {
+        periodSeconds = ClampPeriod(sendTelemetryPeriod);
+        ApplyTimer();
+    }
+}
+
+static void SetPeriod(int seconds)
+{
+    if (seconds == periodSeconds) {
+        return;
+    }
+
+    LOG_DEBUG(APP_LOG_CAT_SENSOR, "Adaptive telemetry period %d -> %d seconds\n", periodSeconds, seconds);
+    periodSeconds = seconds;
+    ApplyTimer();
+    SCHEMA_UPDATE_DEVICE_TWIN(false, SCHEMA_PROPERTY(adaptivePeriodSeconds, periodSeconds));
+}
+
+/// <summary>
+///     Restart the telemetry timer with the adaptive period (times the offline multiplier), or
+///     the rules engine override
+/// </summary>
+static void ApplyTimer(void)
+{
+    if (telemetrytxIntervalr == NULL) {
+        return;
+    }
+
+    int seconds = (overrideSeconds > 0) ? overrideSeconds : periodSeconds * periodMultiplier;
+    struct timespec newPeriod = {.tv_sec = seconds, .tv_nsec = 0};
+    SetEventLoopTimerPeriod(telemetrytxIntervalr, &newPeriod);
+}
+
+static int ClampPeriod(int seconds)
+{
+    int minSeconds = (adaptiveMinSeconds < adaptiveMaxSeconds) ? adaptiveMinSeconds : adaptiveMaxSeconds;
+    int maxSeconds = (adaptiveMinSeconds < adaptiveMaxSeconds) ? adaptiveMaxSeconds : adaptiveMinSeconds;
+
+    if (seconds < minSeconds) {
+        return minSeconds;
+    }
+    return (seconds > maxSeconds) ? maxSeconds : seconds;
+}
+
+/// <summary>
+///     Find a channel by name, adding it if there's room
+/// </summary>
+static adaptiveChannel_t *FindChannel(const char *name)
+{
+    int previousCount = channelCount;
+    adaptiveChannel_t *channel = CHANNEL_TABLE_FIND(channels, channelCount, name, true);
+
+    // Work out whether a new channel is selected once, when it is added
+    if (channelCount != previousCount) {
+        channel->selected = IsSelected(name);
+    }
+    return channel;
+}
+
+/// <summary>
+///     True if name is in the adaptiveChannels list, or the list is empty
+/// </summary>
+static bool IsSelected(const char *name)
+{
+    if (adaptiveChannels[0] == '\0') {
+        return true;
+    }
+
+    size_t nameLength = strlen(name);
+    const char *entry = adaptiveChannels;
+    while (*entry != '\0') {
+
+        while (*entry == ' ') {
+            entry++;
+        }
+        size_t entryLength = strcspn(entry, ", ");
+        if ((entryLength == nameLength) && (strncmp(entry, name, nameLength) == 0)) {
+            return true;
+        }
+        entry += entryLength;
+        entry += strspn(entry, ", ");
+    }
+    return false;
+}
+
+#endif // ENABLE_ADAPTIVE_TELEMETRY
@@ -0,0 +1,127 @@
+#ifndef ADAPTIVE_PERIOD_H
+#define ADAPTIVE_PERIOD_H
+
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "build_options.h"
+#include "channel_stats.h"
+
+// Most channels tracked at once, samples for any further channels are ignored
+#ifndef ADAPTIVE_MAX_CHANNELS
+#define ADAPTIVE_MAX_CHANNELS 8
+#endif
+
+// Longest adaptiveChannels device twin, including the NUL
+#define ADAPTIVE_CHANNELS_MAX_LENGTH 128
+
+// Defaults for the adaptive period device twins
+#define ADAPTIVE_DEFAULT_MIN_SECONDS 10
+#define ADAPTIVE_DEFAULT_MAX_SECONDS 300
+
+// Half lives of the short term (recent activity) and long term (normal activity) statistics
+#define ADAPTIVE_FAST_HALF_LIFE_SECONDS 30
+#define ADAPTIVE_SLOW_HALF_LIFE_SECONDS 1800
+
+// Samples a channel needs before it can move the period
+#define ADAPTIVE_WARMUP_SAMPLES 10
+
+// Short term variance, as a multiple of the long term variance, that sends at the maximum and
+// minimum periods.  The short term variance of a steady channel wanders above and below the
+// long term one, up to ADAPTIVE_QUIET_RATIO counts as quiet.  9 is a standard deviation three
+// times the normal one.
+#define ADAPTIVE_QUIET_RATIO 2.0f
+#define ADAPTIVE_ACTIVE_RATIO 9.0f
+
+// The period only changes when the target is this fraction shorter or longer than the period
+// in use, and grows by at most ADAPTIVE_MAX_GROWTH per telemetry message
+#define ADAPTIVE_HYSTERESIS 0.2f
+#define ADAPTIVE_MAX_GROWTH 1.25f
+
+typedef struct {
+    const char *name;           // Not copied, must stay valid (string literal or table entry)
+    bool selected;              // Listed in adaptiveChannels (or the list is empty)
+    ewmaStats_t fast;           // Half life ADAPTIVE_FAST_HALF_LIFE_SECONDS
+    ewmaStats_t slow;           // Half life ADAPTIVE_SLOW_HALF_LIFE_SECONDS
+} adaptiveChannel_t;
+
+#ifdef ENABLE_ADAPTIVE_TELEMETRY
+
+#include "parson.h"
+
+// Device twin settings
+extern int adaptiveMinSeconds;
+extern int adaptiveMaxSeconds;
+extern char adaptiveChannels[ADAPTIVE_CHANNELS_MAX_LENGTH];
+
+/// <summary>
+///     Update the channel's statistics with a new sample.  If the channels have become more
+///     active the telemetry period is shortened right away.
+/// </summary>
+void adaptivePeriod_Observe(const char *channel, float value, uint64_t timeMs);
+
+/// <summary>
+///     Called by the telemetry timer.  If the channels have quietened down the telemetry period
+///     is lengthened, by at most ADAPTIVE_MAX_GROWTH each time.
+/// </summary>
+void adaptivePeriod_TimerTick(void);
+
+/// <summary>
+///     True when adaptiveMinSeconds and adaptiveMaxSeconds are set.  The scheduler then owns the
+///     telemetry timer and telemetryPeriod is only the starting period.
+/// </summary>
+bool adaptivePeriod_Enabled(void);
+
+/// <summary>
+///     Run the telemetry timer at multiplier times the adaptive period (offline backlog)
+/// </summary>
+void adaptivePeriod_SetMultiplier(int multiplier);
+
+/// <summary>
+///     Hold the telemetry timer at seconds (rules engine telemetryPeriod action), 0 to go back
+///     to the adaptive period
+/// </summary>
+void adaptivePeriod_SetOverride(int seconds);
+
+#ifdef IOT_HUB_APPLICATION
+// Device twin handlers for adaptiveMinSeconds/adaptiveMaxSeconds and adaptiveChannels
+void setAdaptivePeriodFunction(void* thisTwinPtr, JSON_Object *desiredProperties);
+void setAdaptiveChannelsFunction(void* thisTwinPtr, JSON_Object *desiredProperties);
+#endif // IOT_HUB_APPLICATION
+
+#define ADAPTIVE_PERIOD_ENABLED() adaptivePeriod_Enabled()
+
+#else
+
+#define ADAPTIVE_PERIOD_ENABLED() false
+
+#endif // ENABLE_ADAPTIVE_TELEMETRY
+
+#endif // ADAPTIVE_PERIOD_H
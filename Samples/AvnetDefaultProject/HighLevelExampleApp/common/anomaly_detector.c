@@ -0,0 +1,253 @@
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Streaming anomaly detector
+//
+//  anomaly_Observe() is a sample observer (sample_observer.h), it sees every sample from the
+//  sensor path and the real time application raw data handlers with its channel name.  Each
+//  channel keeps an exponentially weighted mean and variance (channel_stats.h).  The weight of
+//  a sample halves every anomalyHalfLifeSeconds, so channels sampled at different rates forget
+//  at the same speed.
+//
+//  Each new sample is scored against the statistics from before it arrived.  When
+//  |value - mean| / stddev exceeds anomalyZThreshold an anomaly telemetry message is sent with
+//  the channel, value, mean, standard deviation and z-score.  Only the first sample of an
+//  excursion is reported, the next report waits until the channel has come back under the
+//  threshold.  The sample is then folded into the statistics, so a lasting step change becomes
+//  the new normal.
+//
+//  When the anomalySummaryOnly device twin is true the routine telemetry timer sends one summary
+//  message per channel (count, min, max, mean, standard deviation) instead of the regular
+//  telemetry, so the cloud only sees summaries plus anomalies.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "anomaly_detector.h"
+
+#ifdef ENABLE_ANOMALY_DETECTOR
+
+#include <math.h>
+#include <stdio.h>
+#include <applibs/log.h>
+#include "app_log.h"
+#include "cloud.h"
+#include "latency_trace.h"
+#include "../avnet/device_twin.h"
+#include "schema_keys.h"
+#include "../avnet/direct_methods.h"
+
+float anomalyZThreshold = ANOMALY_DEFAULT_Z_THRESHOLD;
+int anomalyHalfLifeSeconds = ANOMALY_DEFAULT_HALF_LIFE_SECONDS;
+bool anomalySummaryOnly = false;
+
+static anomalyChannel_t channels[ANOMALY_MAX_CHANNELS];
+static int channelCount = 0;
+
+static void SendAnomaly(const anomalyChannel_t *channel, float value, float stdDev, float zScore);
+
+void anomaly_Observe(const char *channelName, float value, uint64_t timeMs)
+{
+    anomalyChannel_t *channel = CHANNEL_TABLE_FIND(channels, channelCount, channelName, true);
+    if ((channel == NULL) || !isfinite(value)) {
+        return;
+    }
+
+    if (channel->periodCount == 0) {
+        channel->periodMin = value;
+        channel->periodMax = value;
+    }
+    else {
+        channel->periodMin = fminf(channel->periodMin, value);
+        channel->periodMax = fmaxf(channel->periodMax, value);
+    }
+    channel->periodCount++;
+
+    ewmaStats_t *stats = &channel->stats;
+    if (stats->sampleCount > 0) {
+
+        // Score the sample against the statistics from before it arrived
+        float diff = value - stats->mean;
+        float stdDev = sqrtf(stats->variance);
+        float zScore;
+
+        if (stdDev > 0.0f) {
+            zScore = diff / stdDev;
+        }
+        else {
+            // A channel that has never moved, any change at all is an anomaly
+            zScore = (diff == 0.0f) ? 0.0f : copysignf(INFINITY, diff);
+        }
+
+        if (stats->sampleCount >= ANOMALY_WARMUP_SAMPLES) {
+
+            bool anomalous = (fabsf(zScore) > anomalyZThreshold);
+            if (anomalous && !channel->inAnomaly) {
+                channel->anomalyCount++;
+                SendAnomaly(channel, value, stdDev, zScore);
+            }
+            channel->inAnomaly = anomalous;
+        }
+    }
+
+    ewmaStats_Update(stats, value, timeMs, (float)anomalyHalfLifeSeconds, ANOMALY_WARMUP_SAMPLES);
+}
+
+void anomaly_SendSummaries(void)
+{
+    for (int i = 0; i < channelCount; i++) {
+
+        anomalyChannel_t *channel = &channels[i];
+        if (channel->periodCount == 0) {
+            continue;
+        }
+
+        SCHEMA_SEND_TELEMETRY(true, SCHEMA_TELEMETRY(summaryChannel, channel->name),
+                                    SCHEMA_TELEMETRY(summaryCount, (int)channel->periodCount),
+                                    SCHEMA_TELEMETRY(summaryMin, channel->periodMin),
+                                    SCHEMA_TELEMETRY(summaryMax, channel->periodMax),
+                                    SCHEMA_TELEMETRY(summaryMean, channel->stats.mean),
+                                    SCHEMA_TELEMETRY(summaryStdDev, sqrtf(channel->stats.variance)));
+
+        channel->periodCount = 0;
+    }
+}
+
+#ifdef IOT_HUB_APPLICATION
+///<summary>
+///		Device twin handler for the anomaly detector settings.  The threshold and half life
+///     must be greater than zero.
+///</summary>
+void setAnomalyConfigFunction(void* thisTwinPtr, JSON_Object *desiredProperties){
+
+    // Declare a local variable to point to the deviceTwin table entry and cast the incomming void* to a twin_t*
+    twin_t *localTwinPtr = (twin_t*)thisTwinPtr;
+
+    switch (localTwinPtr->twinType) {
+    case TYPE_FLOAT: {
+        float newValue = (float)json_object_get_number(desiredProperties, localTwinPtr->twinKey);
+        if (newValue > 0.0f) {
+            *(float *)localTwinPtr->twinVar = newValue;
+            LOG_INFO(APP_LOG_CAT_TWIN, "Received device update. New %s is %0.2f\n", localTwinPtr->twinKey, newValue);
+        }
+        else {
+            LOG_WARN(APP_LOG_CAT_TWIN, "Received invalid device update for key %s.\n", localTwinPtr->twinKey);
+        }
+        updateDeviceTwin(true, ARGS_PER_TWIN_ITEM*1, TYPE_FLOAT, localTwinPtr->twinKey, *(float *)localTwinPtr->twinVar);
+        break;
+    }
+
+    case TYPE_INT: {
+        int newValue = (int)json_object_get_number(desiredProperties, localTwinPtr->twinKey);
+        if (newValue > 0) {
+            *(int *)localTwinPtr->twinVar = newValue;
+            LOG_INFO(APP_LOG_CAT_TWIN, "Received device update. New %s is %d\n", localTwinPtr->twinKey, newValue);
+        }
+        else {
+            LOG_WARN(APP_LOG_CAT_TWIN, "Received invalid device update for key %s.\n", localTwinPtr->twinKey);
+        }
+        updateDeviceTwin(true, ARGS_PER_TWIN_ITEM*1, TYPE_INT, localTwinPtr->twinKey, *(int *)localTwinPtr->twinVar);
+        break;
+    }
+
+    case TYPE_BOOL:
+        *(bool *)localTwinPtr->twinVar = (bool)json_object_get_boolean(desiredProperties, localTwinPtr->twinKey);
+        LOG_INFO(APP_LOG_CAT_TWIN, "Received device update. New %s is %s\n", localTwinPtr->twinKey,
+                                   *(bool *)localTwinPtr->twinVar ? "true" : "false");
+        updateDeviceTwin(true, ARGS_PER_TWIN_ITEM*1, TYPE_BOOL, localTwinPtr->twinKey, *(bool *)localTwinPtr->twinVar);
+        break;
+
+    default:
+        break;
+    }
+}
+#endif // IOT_HUB_APPLICATION
+
+//////////////////////////////////////////////////////////////////////////////////////
+//
+//  Functions for getAnomalyStats directMethod
+//
+//  name: getAnomalyStats
+//  Payload: {}
+//
+//  Returns the current settings and, for each channel, the sample count, mean,
+//  standard deviation and number of anomalies reported
+//
+//////////////////////////////////////////////////////////////////////////////////////
+
+int dmGetAnomalyStatsHandlerFunction(JSON_Object *JsonPayloadObj, size_t payloadSize, char** responseMsg){
+
+    JSON_Value *rootValue = json_value_init_object();
+    JSON_Object *rootObject = json_value_get_object(rootValue);
+    char keyBuffer[64];
+
+    json_object_dotset_number(rootObject, "zThreshold", anomalyZThreshold);
+    json_object_dotset_number(rootObject, "halfLifeSeconds", anomalyHalfLifeSeconds);
+    json_object_dotset_boolean(rootObject, "summaryOnly", anomalySummaryOnly);
+
+    for(int i = 0; i < channelCount; i++){
+
+        snprintf(keyBuffer, sizeof(keyBuffer), "channels.%s.samples", channels[i].name);
+        json_object_dotset_number(rootObject, keyBuffer, channels[i].stats.sampleCount);
+        snprintf(keyBuffer, sizeof(keyBuffer), "channels.%s.mean", channels[i].name);
+        json_object_dotset_number(rootObject, keyBuffer, channels[i].stats.mean);
+        snprintf(keyBuffer, sizeof(keyBuffer), "channels.%s.stdDev", channels[i].name);
+        json_object_dotset_number(rootObject, keyBuffer, sqrtf(channels[i].stats.variance));
+        snprintf(keyBuffer, sizeof(keyBuffer), "channels.%s.anomalies", channels[i].name);
+        json_object_dotset_number(rootObject, keyBuffer, channels[i].anomalyCount);
+    }
+
+    *responseMsg = dmSerializeResponse(rootValue);
+
+    if(*responseMsg == NULL){
+        LOG_ERROR(APP_LOG_CAT_DM, "ERROR: Could not allocate anomaly stats response\n");
+        return 400;
+    }
+
+    return 200;
+}
+
+static void SendAnomaly(const anomalyChannel_t *channel, float value, float stdDev, float zScore)
+{
+    // A channel that never moved has an infinite z-score, JSON can't carry that
+    float reportedZScore = isfinite(zScore) ? zScore : copysignf(999.0f, zScore);
+
+    LOG_INFO_RL(APP_LOG_CAT_SENSOR, APP_LOG_RATE_LIMIT_MS, "Anomaly on %s: %.3f (mean %.3f, stddev %.3f, z %.1f)\n",
+                channel->name, value, channel->stats.mean, stdDev, reportedZScore);
+
+    LATENCY_MARK_CAPTURE();
+    SCHEMA_SEND_TELEMETRY(true, SCHEMA_TELEMETRY(anomalyChannel, channel->name),
+                                SCHEMA_TELEMETRY(anomalyValue, value),
+                                SCHEMA_TELEMETRY(anomalyMean, channel->stats.mean),
+                                SCHEMA_TELEMETRY(anomalyStdDev, stdDev),
+                                SCHEMA_TELEMETRY(anomalyZScore, reportedZScore),
+                                SCHEMA_TELEMETRY(anomalySamples, (int)channel->stats.sampleCount));
+}
+
+#endif // ENABLE_ANOMALY_DETECTOR
@@ -0,0 +1,93 @@
+#ifndef ANOMALY_DETECTOR_H
+#define ANOMALY_DETECTOR_H
+
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "build_options.h"
+#include "channel_stats.h"
+
+// Most channels tracked at once, samples for any further channels are ignored
+#ifndef ANOMALY_MAX_CHANNELS
+#define ANOMALY_MAX_CHANNELS 16
+#endif
+
+// Samples a channel needs before its statistics are trusted
+#ifndef ANOMALY_WARMUP_SAMPLES
+#define ANOMALY_WARMUP_SAMPLES 10
+#endif
+
+// Defaults for the anomaly device twins
+#define ANOMALY_DEFAULT_Z_THRESHOLD 4.0f
+#define ANOMALY_DEFAULT_HALF_LIFE_SECONDS 300
+
+typedef struct {
+    const char *name;           // Not copied, must stay valid (string literal or table entry)
+    ewmaStats_t stats;          // Half life anomalyHalfLifeSeconds
+    bool inAnomaly;             // Only report the first sample of each excursion
+    uint32_t anomalyCount;
+
+    // Since the last summary
+    uint32_t periodCount;
+    float periodMin;
+    float periodMax;
+} anomalyChannel_t;
+
+#ifdef ENABLE_ANOMALY_DETECTOR
+
+#include "parson.h"
+
+// Device twin settings
+extern float anomalyZThreshold;
+extern int anomalyHalfLifeSeconds;
+extern bool anomalySummaryOnly;
+
+/// <summary>
+///     Update the channel's statistics with a new sample and send an anomaly event if the sample
+///     is more than anomalyZThreshold standard deviations from the channel's mean
+/// </summary>
+void anomaly_Observe(const char *channel, float value, uint64_t timeMs);
+
+/// <summary>
+///     Send one summary message per channel for the samples since the last summary
+/// </summary>
+void anomaly_SendSummaries(void);
+
+#ifdef IOT_HUB_APPLICATION
+// Device twin handler for anomalyZThreshold, anomalyHalfLifeSeconds and anomalySummaryOnly
+void setAnomalyConfigFunction(void* thisTwinPtr, JSON_Object *desiredProperties);
+#endif // IOT_HUB_APPLICATION
+
+// Direct method handler
+int dmGetAnomalyStatsHandlerFunction(JSON_Object *JsonPayloadObj, size_t payloadSize, char** responsePayload);
+
+#endif // ENABLE_ANOMALY_DETECTOR
+
+#endif // ANOMALY_DETECTOR_H
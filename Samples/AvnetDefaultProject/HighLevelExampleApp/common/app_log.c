@@ -0,0 +1,201 @@
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Leveled, rate limited logging
+//
+//  Use LOG_ERROR/LOG_WARN/LOG_INFO/LOG_DEBUG/LOG_VERBOSE(category, format, ...) in place of
+//  Log_Debug().  Each macro has a _RL(category, periodMs, format, ...) variant that outputs at most
+//  one message per period from that call site, use these in paths that run for every message.
+//
+//  Compile time: Levels above APP_LOG_COMPILE_LEVEL (build_options.h) expand to nothing.
+//
+//  Runtime: Each category has a level, set with the device twins
+//
+//      "logLevel": 0-5                      Sets every category (0=off .. 5=verbose)
+//      "logCategoryLevels": "m4=5,iot=2"    Overrides the level for the listed categories
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "app_log.h"
+#include "monotonic_time.h"
+
+#ifdef IOT_HUB_APPLICATION
+#include "../avnet/device_twin.h"
+#endif
+
+#define APP_LOG_INITIAL_LEVEL(id, name) APP_LOG_DEFAULT_LEVEL,
+uint8_t appLogLevels[APP_LOG_CAT_COUNT] = {
+    APP_LOG_CATEGORY_LIST(APP_LOG_INITIAL_LEVEL)
+};
+#undef APP_LOG_INITIAL_LEVEL
+
+#define APP_LOG_CATEGORY_NAME(id, name) name,
+static const char *appLogCategoryNames[APP_LOG_CAT_COUNT] = {
+    APP_LOG_CATEGORY_LIST(APP_LOG_CATEGORY_NAME)
+};
+#undef APP_LOG_CATEGORY_NAME
+
+// Device twin variables
+int appLogLevel = APP_LOG_DEFAULT_LEVEL;
+char appLogCategoryLevels[APP_LOG_CATEGORY_LEVELS_SIZE] = "";
+
+static void applyCategoryLevels(void);
+
+/// <summary>
+///     Returns true if the call site may output a message now.  When a message is allowed after
+///     some were suppressed, outputs a line with the suppressed count first.
+/// </summary>
+bool appLog_RateLimit(appLogRateLimit_t *state, uint32_t periodMs)
+{
+    int64_t nowMs = (int64_t)monotonicMs();
+
+    if ((state->lastOutputMs != 0) && ((nowMs - state->lastOutputMs) < (int64_t)periodMs)) {
+        state->suppressed++;
+        return false;
+    }
+
+    if (state->suppressed > 0) {
+        Log_Debug("[%u similar messages suppressed]\n", state->suppressed);
+        state->suppressed = 0;
+    }
+
+    state->lastOutputMs = nowMs;
+    return true;
+}
+
+/// <summary>
+///     Set the runtime level for a category by name, returns false if the name or level is invalid
+/// </summary>
+bool appLog_SetLevel(const char *categoryName, int level)
+{
+    if ((level < APP_LOG_LEVEL_OFF) || (level > APP_LOG_LEVEL_VERBOSE)) {
+        return false;
+    }
+
+    for (int i = 0; i < APP_LOG_CAT_COUNT; i++) {
+        if (strcmp(categoryName, appLogCategoryNames[i]) == 0) {
+            appLogLevels[i] = (uint8_t)level;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/// <summary>
+///     Set every category to appLogLevel, then apply the "name=level" overrides from
+///     appLogCategoryLevels
+/// </summary>
+static void applyCategoryLevels(void)
+{
+    char overrides[APP_LOG_CATEGORY_LEVELS_SIZE];
+    char *savePtr = NULL;
+
+    for (int i = 0; i < APP_LOG_CAT_COUNT; i++) {
+        appLogLevels[i] = (uint8_t)appLogLevel;
+    }
+
+    strncpy(overrides, appLogCategoryLevels, sizeof(overrides) - 1);
+    overrides[sizeof(overrides) - 1] = '\0';
+
+    for (char *entry = strtok_r(overrides, ", ", &savePtr); entry != NULL;
+         entry = strtok_r(NULL, ", ", &savePtr)) {
+
+        char *separator = strchr(entry, '=');
+        if (separator == NULL) {
+            Log_Debug("WARNING: Ignoring log level override \"%s\"\n", entry);
+            continue;
+        }
+
+        *separator = '\0';
+        if (!appLog_SetLevel(entry, atoi(separator + 1))) {
+            Log_Debug("WARNING: Ignoring log level override \"%s=%s\"\n", entry, separator + 1);
+        }
+    }
+}
+
+#ifdef IOT_HUB_APPLICATION
+
+///<summary>
+///		Device twin handler for logLevel, sets the level for every category
+///</summary>
+void setLogLevelFunction(void* thisTwinPtr, JSON_Object *desiredProperties){
+
+    // Declare a local variable to point to the deviceTwin table entry and cast the incomming void* to a twin_t*
+    twin_t *localTwinPtr = (twin_t*)thisTwinPtr;
+
+    int newLevel = (int)json_object_get_number(desiredProperties, localTwinPtr->twinKey);
+
+    if((newLevel >= APP_LOG_LEVEL_OFF) && (newLevel <= APP_LOG_LEVEL_VERBOSE)){
+        appLogLevel = newLevel;
+        applyCategoryLevels();
+        Log_Debug("Received device update. New %s is %d\n", localTwinPtr->twinKey, appLogLevel);
+    }
+    else{
+        Log_Debug("Received invalid device update for key %s.\n", localTwinPtr->twinKey);
+    }
+
+    if(newLevel > APP_LOG_COMPILE_LEVEL){
+        Log_Debug("WARNING: Messages above log level %d are not compiled into this image\n", APP_LOG_COMPILE_LEVEL);
+    }
+
+    // Send the reported property to the IoTHub
+    updateDeviceTwin(true, ARGS_PER_TWIN_ITEM*1, TYPE_INT, localTwinPtr->twinKey, appLogLevel);
+}
+
+///<summary>
+///		Device twin handler for logCategoryLevels, "category=level" pairs separated by commas
+///</summary>
+void setLogCategoryLevelsFunction(void* thisTwinPtr, JSON_Object *desiredProperties){
+
+    // Declare a local variable to point to the deviceTwin table entry and cast the incomming void* to a twin_t*
+    twin_t *localTwinPtr = (twin_t*)thisTwinPtr;
+
+    const char *newLevels = json_object_get_string(desiredProperties, localTwinPtr->twinKey);
+
+    if((newLevels != NULL) && (strlen(newLevels) >= sizeof(appLogCategoryLevels))){
+        Log_Debug("Received invalid device update for key %s.\n", localTwinPtr->twinKey);
+    }
+    else{
+        strcpy(appLogCategoryLevels, (newLevels != NULL) ? newLevels : "");
+        applyCategoryLevels();
+        Log_Debug("Received device update. New %s is %s\n", localTwinPtr->twinKey, appLogCategoryLevels);
+    }
+
+    // Send the reported property to the IoTHub
+    updateDeviceTwin(true, ARGS_PER_TWIN_ITEM*1, TYPE_STRING, localTwinPtr->twinKey, appLogCategoryLevels);
+}
+
+#endif // IOT_HUB_APPLICATION
@@ -0,0 +1,170 @@
+#ifndef APP_LOG_H
+#define APP_LOG_H
+
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <applibs/log.h>
+#include "build_options.h"
+#include "parson.h"
+
+// Log levels, a message is output when its level is <= the level set for its category
+#define APP_LOG_LEVEL_OFF       0
+#define APP_LOG_LEVEL_ERROR     1
+#define APP_LOG_LEVEL_WARN      2
+#define APP_LOG_LEVEL_INFO      3
+#define APP_LOG_LEVEL_DEBUG     4
+#define APP_LOG_LEVEL_VERBOSE   5
+
+// Messages above this level are removed at compile time, see build_options.h
+#ifndef APP_LOG_COMPILE_LEVEL
+#define APP_LOG_COMPILE_LEVEL APP_LOG_LEVEL_DEBUG
+#endif
+
+// Initial runtime level for every category, can be changed with the logLevel device twin
+#ifndef APP_LOG_DEFAULT_LEVEL
+#define APP_LOG_DEFAULT_LEVEL APP_LOG_LEVEL_INFO
+#endif
+
+// Define the log categories.  X(id, "name"), the name is used in the logCategoryLevels device twin
+#define APP_LOG_CATEGORY_LIST(X) \
+    X(APP_LOG_CAT_APP,    "app") \
+    X(APP_LOG_CAT_IOT,    "iot") \
+    X(APP_LOG_CAT_TWIN,   "twin") \
+    X(APP_LOG_CAT_DM,     "dm") \
+    X(APP_LOG_CAT_M4,     "m4") \
+    X(APP_LOG_CAT_SENSOR, "sensor")
+
+#define APP_LOG_CATEGORY_ENUM(id, name) id,
+typedef enum {
+    APP_LOG_CATEGORY_LIST(APP_LOG_CATEGORY_ENUM)
+    APP_LOG_CAT_COUNT
+} appLogCategory_t;
+#undef APP_LOG_CATEGORY_ENUM
+
+// Default period for the rate limited macros
+#ifndef APP_LOG_RATE_LIMIT_MS
+#define APP_LOG_RATE_LIMIT_MS 5000
+#endif
+
+// Per call site state for the rate limited macros
+typedef struct {
+    int64_t lastOutputMs;
+    uint32_t suppressed;
+} appLogRateLimit_t;
+
+// Current runtime level for each category
+extern uint8_t appLogLevels[APP_LOG_CAT_COUNT];
+
+// Device twin variables
+#define APP_LOG_CATEGORY_LEVELS_SIZE 64
+extern int appLogLevel;
+extern char appLogCategoryLevels[APP_LOG_CATEGORY_LEVELS_SIZE];
+
+bool appLog_RateLimit(appLogRateLimit_t *state, uint32_t periodMs);
+bool appLog_SetLevel(const char *categoryName, int level);
+
+// Device twin handlers
+void setLogLevelFunction(void* thisTwinPtr, JSON_Object *desiredProperties);
+void setLogCategoryLevelsFunction(void* thisTwinPtr, JSON_Object *desiredProperties);
+
+static inline bool appLog_Enabled(appLogCategory_t category, int level)
+{
+    return level <= appLogLevels[category];
+}
+
+#define APP_LOG_EMIT(category, level, ...)                                                      \
+    do {                                                                                        \
+        if (appLog_Enabled(category, level)) {                                                  \
+            Log_Debug(__VA_ARGS__);                                                             \
+        }                                                                                       \
+    } while (0)
+
+// Outputs at most one message every periodMs from this call site, the next message that is
+// output reports how many were dropped.
+#define APP_LOG_EMIT_RL(category, level, periodMs, ...)                                         \
+    do {                                                                                        \
+        static appLogRateLimit_t appLogCallSite = {0};                                          \
+        if (appLog_Enabled(category, level) && appLog_RateLimit(&appLogCallSite, periodMs)) {   \
+            Log_Debug(__VA_ARGS__);                                                             \
+        }                                                                                       \
+    } while (0)
+
+// Compiled out messages keep their arguments referenced, so -Werror builds don't fail on variables
+// that are only logged, but the dead branch is removed and the strings are not in the image.
+#define APP_LOG_NOTHING(...)                                                                    \
+    do {                                                                                        \
+        if (0) {                                                                                \
+            Log_Debug(__VA_ARGS__);                                                             \
+        }                                                                                       \
+    } while (0)
+
+// Level specific macros.  Levels above APP_LOG_COMPILE_LEVEL are compiled out.
+#if APP_LOG_COMPILE_LEVEL >= APP_LOG_LEVEL_ERROR
+#define LOG_ERROR(category, ...) APP_LOG_EMIT(category, APP_LOG_LEVEL_ERROR, __VA_ARGS__)
+#define LOG_ERROR_RL(category, periodMs, ...) APP_LOG_EMIT_RL(category, APP_LOG_LEVEL_ERROR, periodMs, __VA_ARGS__)
+#else
+#define LOG_ERROR(category, ...) APP_LOG_NOTHING(__VA_ARGS__)
+#define LOG_ERROR_RL(category, periodMs, ...) APP_LOG_NOTHING(__VA_ARGS__)
+#endif
+
+#if APP_LOG_COMPILE_LEVEL >= APP_LOG_LEVEL_WARN
+#define LOG_WARN(category, ...) APP_LOG_EMIT(category, APP_LOG_LEVEL_WARN, __VA_ARGS__)
+#define LOG_WARN_RL(category, periodMs, ...) APP_LOG_EMIT_RL(category, APP_LOG_LEVEL_WARN, periodMs, __VA_ARGS__)
+#else
+#define LOG_WARN(category, ...) APP_LOG_NOTHING(__VA_ARGS__)
+#define LOG_WARN_RL(category, periodMs, ...) APP_LOG_NOTHING(__VA_ARGS__)
+#endif
+
+#if APP_LOG_COMPILE_LEVEL >= APP_LOG_LEVEL_INFO
+#define LOG_INFO(category, ...) APP_LOG_EMIT(category, APP_LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_INFO_RL(category, periodMs, ...) APP_LOG_EMIT_RL(category, APP_LOG_LEVEL_INFO, periodMs, __VA_ARGS__)
+#else
+#define LOG_INFO(category, ...) APP_LOG_NOTHING(__VA_ARGS__)
+#define LOG_INFO_RL(category, periodMs, ...) APP_LOG_NOTHING(__VA_ARGS__)
+#endif
+
+#if APP_LOG_COMPILE_LEVEL >= APP_LOG_LEVEL_DEBUG
+#define LOG_DEBUG(category, ...) APP_LOG_EMIT(category, APP_LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define LOG_DEBUG_RL(category, periodMs, ...) APP_LOG_EMIT_RL(category, APP_LOG_LEVEL_DEBUG, periodMs, __VA_ARGS__)
+#else
+#define LOG_DEBUG(category, ...) APP_LOG_NOTHING(__VA_ARGS__)
+#define LOG_DEBUG_RL(category, periodMs, ...) APP_LOG_NOTHING(__VA_ARGS__)
+#endif
+
+#if APP_LOG_COMPILE_LEVEL >= APP_LOG_LEVEL_VERBOSE
+#define LOG_VERBOSE(category, ...) APP_LOG_EMIT(category, APP_LOG_LEVEL_VERBOSE, __VA_ARGS__)
+#define LOG_VERBOSE_RL(category, periodMs, ...) APP_LOG_EMIT_RL(category, APP_LOG_LEVEL_VERBOSE, periodMs, __VA_ARGS__)
+#else
+#define LOG_VERBOSE(category, ...) APP_LOG_NOTHING(__VA_ARGS__)
+#define LOG_VERBOSE_RL(category, periodMs, ...) APP_LOG_NOTHING(__VA_ARGS__)
+#endif
+
+#endif // APP_LOG_H
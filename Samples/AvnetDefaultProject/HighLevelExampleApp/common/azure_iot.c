@@ -1,6 +1,7 @@
 /* Copyright (c) Microsoft Corporation. All rights reserved.
    Licensed under the MIT License. */
 
+#include <stdio.h>
 #include <stdlib.h>
 
 #include <applibs/eventloop.h>
@@ -12,6 +13,12 @@
 #include "eventloop_timer_utilities.h"
 #include "exitcodes.h"
 #include "connection.h"
+#include "trace_ring.h"
+#include "latency_trace.h"
+#include "boot_timeline.h"
+#include "app_log.h"
+#include "key_dictionary.h"
+#include "cloud_blob.h"
 
 static void AzureTimerEventHandler(EventLoopTimer *timer);
 static void SetUpAzureIoTHubClient(void);
@@ -19,6 +26,8 @@ static void ConnectionStatusCallback(IOTHUB_CLIENT_CONNECTION_STATUS result,
                                      IOTHUB_CLIENT_CONNECTION_STATUS_REASON reason,
                                      void *userContextCallback);
 void SendEventCallback(IOTHUB_CLIENT_CONFIRMATION_RESULT result, void *context);
+static AzureIoT_Result SendTelemetryMessage(const uint8_t *data, size_t length, bool isString,
+                                            const char *contentType, void *context);
 static void DeviceTwinCallback(DEVICE_TWIN_UPDATE_STATE updateState, const unsigned char *payload,
                                size_t payloadSize, void *userContextCallback);
 static void ReportedStateCallback(int result, void *context);
@@ -108,9 +117,11 @@ static void ConnectionCallbackHandler(Connection_Status status,
         break;
     case Connection_Started:
         Log_Debug("INFO: Azure IoT Hub connection started.\n");
+        BOOT_MARK(BOOT_PHASE_CONNECT_START);
         break;
     case Connection_Complete: {
         Log_Debug("INFO: Azure IoT Hub connection complete.\n");
+        BOOT_MARK(BOOT_PHASE_CONNECT_COMPLETE);
 
         iothubClientHandle = clientHandle;
 
@@ -176,6 +187,9 @@ static void AzureTimerEventHandler(EventLoopTimer *timer)
     // Check whether the device is connected to the internet.
     Networking_InterfaceConnectionStatus status;
     if (Networking_GetInterfaceConnectionStatus(networkInterface, &status) == 0) {
+        if (status & Networking_InterfaceConnectionStatus_ConnectedToInternet) {
+            BOOT_MARK(BOOT_PHASE_NETWORK_READY);
+        }
         if ((status & Networking_InterfaceConnectionStatus_ConnectedToInternet) &&
             (iotHubClientAuthenticationState == IoTHubClientAuthenticationState_NotAuthenticated)) {
             SetUpAzureIoTHubClient();
@@ -190,7 +204,9 @@ static void AzureTimerEventHandler(EventLoopTimer *timer)
     }
 
     if (iothubClientHandle != NULL) {
+        TRACE(TRACE_EVT_DOWORK_START, 0, 0);
         IoTHubDeviceClient_LL_DoWork(iothubClientHandle);
+        TRACE(TRACE_EVT_DOWORK_END, 0, 0);
     }
 }
 
@@ -201,6 +217,13 @@ static void AzureTimerEventHandler(EventLoopTimer *timer)
 /// </summary>
 static void SetUpAzureIoTHubClient(void)
 {
+#ifdef ENABLE_BLOB_UPLOAD
+    // A worker is uploading a blob part with the handle, try again on the next timer event
+    if (cloudBlob_ClientInUse()) {
+        return;
+    }
+#endif // ENABLE_BLOB_UPLOAD
+
     if (iothubClientHandle != NULL) {
         IoTHubDeviceClient_LL_Destroy(iothubClientHandle);
         iothubClientHandle = NULL;
@@ -222,6 +245,7 @@ static void ConnectionStatusCallback(IOTHUB_CLIENT_CONNECTION_STATUS result,
 {
     Log_Debug("Azure IoT connection status: %s\n",
               IOTHUB_CLIENT_CONNECTION_STATUS_REASONStrings(reason));
+    TRACE(TRACE_EVT_CONNECTION_STATUS, result, reason);
 
     iotHubClientAuthenticationState = result == IOTHUB_CLIENT_CONNECTION_AUTHENTICATED
                                           ? IoTHubClientAuthenticationState_Authenticated
@@ -230,6 +254,9 @@ static void ConnectionStatusCallback(IOTHUB_CLIENT_CONNECTION_STATUS result,
     if (iotHubClientAuthenticationState == IoTHubClientAuthenticationState_NotAuthenticated) {
         ConnectionCallbackHandler(Connection_NotStarted, NULL);
     }
+    else {
+        BOOT_MARK(BOOT_PHASE_HUB_AUTHENTICATED);
+    }
 
     if (callbacks.connectionStatusCallbackFunction != NULL) {
         callbacks.connectionStatusCallbackFunction(result ==
@@ -251,8 +278,11 @@ static void DeviceTwinCallback(DEVICE_TWIN_UPDATE_STATE updateState, const unsig
     // Statically allocate this for more predictable memory use patterns
     static char nullTerminatedJsonString[MAX_DEVICE_TWIN_PAYLOAD_SIZE + 1];
 
+    TRACE(TRACE_EVT_TWIN_RX, payloadSize, updateState);
+    BOOT_MARK(BOOT_PHASE_FIRST_TWIN);
+
     if (payloadSize > MAX_DEVICE_TWIN_PAYLOAD_SIZE) {
-        Log_Debug("ERROR: Device twin payload size (%u bytes) exceeds maximum (%u bytes).\n",
+        Log_Debug("ERROR: Device twin payload size (%zu bytes) exceeds maximum (%u bytes).\n",
                   payloadSize, MAX_DEVICE_TWIN_PAYLOAD_SIZE);
 
         failureCallbackFunction(ExitCode_PayloadSize_TooLarge);
@@ -272,7 +302,32 @@ static void DeviceTwinCallback(DEVICE_TWIN_UPDATE_STATE updateState, const unsig
 
 AzureIoT_Result AzureIoT_SendTelemetry(const char *jsonMessage, void *context)
 {
-    Log_Debug("Sending Azure IoT Hub telemetry: %s.\n", jsonMessage);
+    LOG_DEBUG_RL(APP_LOG_CAT_IOT, APP_LOG_RATE_LIMIT_MS, "Sending Azure IoT Hub telemetry: %s.\n", jsonMessage);
+
+    return SendTelemetryMessage((const uint8_t *)jsonMessage, strlen(jsonMessage), true, NULL, context);
+}
+
+AzureIoT_Result AzureIoT_SendTelemetryBinary(const uint8_t *data, size_t length,
+                                             const char *contentType, void *context)
+{
+    LOG_DEBUG_RL(APP_LOG_CAT_IOT, APP_LOG_RATE_LIMIT_MS, "Sending Azure IoT Hub binary telemetry: %zu bytes.\n", length);
+
+    return SendTelemetryMessage(data, length, false, contentType, context);
+}
+
+/// <summary>
+///     Create the IoT Hub message and hand it to the client.  String messages are created with
+///     IoTHubMessage_CreateFromString() as the SDK samples do, the rest as byte arrays.
+/// </summary>
+static AzureIoT_Result SendTelemetryMessage(const uint8_t *data, size_t length, bool isString,
+                                            const char *contentType, void *context)
+{
+#ifdef ENABLE_LATENCY_TRACE
+    // Claim the capture and enqueue times for this message before any early return so they
+    // are not applied to the next message
+    latencyStamp_t latencyStamp;
+    latencyTrace_TakePending(&latencyStamp);
+#endif // ENABLE_LATENCY_TRACE
 
     // Check whether the device is connected to the internet.
     if (IsConnectionReadyToSendTelemetry() == false) {
@@ -281,26 +336,70 @@ AzureIoT_Result AzureIoT_SendTelemetry(const char *jsonMessage, void *context)
 
     if (iotHubClientAuthenticationState != IoTHubClientAuthenticationState_Authenticated) {
         // AzureIoT client is not authenticated. Log a warning and return.
-        Log_Debug("WARNING: Azure IoT Hub is not authenticated. Not sending telemetry.\n");
+        LOG_WARN_RL(APP_LOG_CAT_IOT, APP_LOG_RATE_LIMIT_MS, "WARNING: Azure IoT Hub is not authenticated. Not sending telemetry.\n");
         return AzureIoT_Result_OtherFailure;
     }
 
-    IOTHUB_MESSAGE_HANDLE messageHandle = IoTHubMessage_CreateFromString(jsonMessage);
+#ifdef ENABLE_TELEMETRY_KEY_DICTIONARY
+    // Send short keys if the keyDictionary device twin selected a dictionary, the message
+    // property tells the cloud which one
+    const char *dictionaryId = NULL;
+    const char *compactMessage = isString ? keyDictionary_CompactMessage((const char *)data, &dictionaryId) : NULL;
+    if (compactMessage != NULL) {
+        data = (const uint8_t *)compactMessage;
+        length = strlen(compactMessage);
+    }
+#endif // ENABLE_TELEMETRY_KEY_DICTIONARY
+
+    IOTHUB_MESSAGE_HANDLE messageHandle = isString ? IoTHubMessage_CreateFromString((const char *)data)
+                                                   : IoTHubMessage_CreateFromByteArray(data, length);
 
     if (messageHandle == 0) {
-        Log_Debug("ERROR: unable to create a new IoTHubMessage.\n");
+        LOG_ERROR_RL(APP_LOG_CAT_IOT, APP_LOG_RATE_LIMIT_MS, "ERROR: unable to create a new IoTHubMessage.\n");
         return AzureIoT_Result_OtherFailure;
     }
 
+    if (contentType != NULL) {
+        IoTHubMessage_SetContentTypeSystemProperty(messageHandle, contentType);
+    }
+
+#ifdef ENABLE_TELEMETRY_KEY_DICTIONARY
+    // Short keys can't be sent without the dictionary id
+    if ((compactMessage != NULL) &&
+        (IoTHubMessage_SetProperty(messageHandle, KEY_DICTIONARY_PROPERTY, dictionaryId) != IOTHUB_MESSAGE_OK)) {
+        LOG_ERROR_RL(APP_LOG_CAT_IOT, APP_LOG_RATE_LIMIT_MS, "ERROR: unable to set the key dictionary message property.\n");
+        IoTHubMessage_Destroy(messageHandle);
+        return AzureIoT_Result_OtherFailure;
+    }
+#endif // ENABLE_TELEMETRY_KEY_DICTIONARY
+
     AzureIoT_Result result = AzureIoT_Result_OK;
 
+#ifdef ENABLE_LATENCY_TRACE
+#ifdef LATENCY_TRACE_MESSAGE_PROPERTY
+    // Tell the cloud how old the sample was when the device handed it to the SDK
+    char captureAgeMs[12];
+    snprintf(captureAgeMs, sizeof(captureAgeMs), "%u", (unsigned int)latencyTrace_AgeMs(&latencyStamp));
+    IoTHubMessage_SetProperty(messageHandle, "captureAgeMs", captureAgeMs);
+#endif // LATENCY_TRACE_MESSAGE_PROPERTY
+
+    // The SDK hands the trace record back to SendEventCallback() in place of the context
+    void *sdkContext = latencyTrace_Submit(&latencyStamp, context);
+#else
+    void *sdkContext = context;
+#endif // ENABLE_LATENCY_TRACE
+
     if (IoTHubDeviceClient_LL_SendEventAsync(iothubClientHandle, messageHandle, SendEventCallback,
-                                             context) != IOTHUB_CLIENT_OK) {
-        Log_Debug("ERROR: failure requesting IoTHubClient to send telemetry event.\n");
+                                             sdkContext) != IOTHUB_CLIENT_OK) {
+        LOG_ERROR_RL(APP_LOG_CAT_IOT, APP_LOG_RATE_LIMIT_MS, "ERROR: failure requesting IoTHubClient to send telemetry event.\n");
         result = AzureIoT_Result_OtherFailure;
+#ifdef ENABLE_LATENCY_TRACE
+        latencyTrace_Release(sdkContext);
+#endif // ENABLE_LATENCY_TRACE
     } else {
-        Log_Debug("INFO: IoTHubClient accepted the telemetry event for delivery.\n");
+        LOG_VERBOSE(APP_LOG_CAT_IOT, "INFO: IoTHubClient accepted the telemetry event for delivery.\n");
     }
+    TRACE(TRACE_EVT_TELEMETRY_SEND, length, result);
 
     IoTHubMessage_Destroy(messageHandle);
     return result;
@@ -311,7 +410,15 @@ AzureIoT_Result AzureIoT_SendTelemetry(const char *jsonMessage, void *context)
 /// </summary>
 void SendEventCallback(IOTHUB_CLIENT_CONFIRMATION_RESULT result, void *context)
 {
-    Log_Debug("INFO: Azure IoT Hub send telemetry event callback: status code %d.\n", result);
+    LOG_DEBUG_RL(APP_LOG_CAT_IOT, APP_LOG_RATE_LIMIT_MS, "INFO: Azure IoT Hub send telemetry event callback: status code %d.\n", result);
+#ifdef ENABLE_LATENCY_TRACE
+    // Record the stage times and recover the application's context
+    context = latencyTrace_Complete(context, result == IOTHUB_CLIENT_CONFIRMATION_OK);
+#endif // ENABLE_LATENCY_TRACE
+    TRACE(TRACE_EVT_TELEMETRY_ACK, result, (uintptr_t)context);
+    if (result == IOTHUB_CLIENT_CONFIRMATION_OK) {
+        BOOT_MARK(BOOT_PHASE_FIRST_TELEMETRY_ACK);
+    }
 
     if (callbacks.sendTelemetryCallbackFunction != NULL) {
         callbacks.sendTelemetryCallbackFunction(result == IOTHUB_CLIENT_CONFIRMATION_OK, context);
@@ -330,18 +437,20 @@ AzureIoT_Result AzureIoT_DeviceTwinReportState(const char *jsonState, void *cont
 
     if (iotHubClientAuthenticationState != IoTHubClientAuthenticationState_Authenticated) {
         // AzureIoT client is not authenticated. Log a warning and return.
-        Log_Debug("WARNING: Azure IoT Hub is not authenticated. Not sending device twin.\n");
+        LOG_WARN_RL(APP_LOG_CAT_TWIN, APP_LOG_RATE_LIMIT_MS, "WARNING: Azure IoT Hub is not authenticated. Not sending device twin.\n");
         return AzureIoT_Result_NotAuthenticated;
     }
 
     if (IoTHubDeviceClient_LL_SendReportedState(
             iothubClientHandle, (const unsigned char *)jsonState, strlen(jsonState),
             ReportedStateCallback, context) != IOTHUB_CLIENT_OK) {
-        Log_Debug("ERROR: Azure IoT Hub client error when reporting state '%s'.\n", jsonState);
+        TRACE(TRACE_EVT_TWIN_REPORT, strlen(jsonState), AzureIoT_Result_SendReportedState_Failed);
+        LOG_ERROR_RL(APP_LOG_CAT_TWIN, APP_LOG_RATE_LIMIT_MS, "ERROR: Azure IoT Hub client error when reporting state '%s'.\n", jsonState);
         return AzureIoT_Result_SendReportedState_Failed;
     }
 
-    Log_Debug("INFO: Azure IoT Hub client accepted request to report state '%s'.\n", jsonState);
+    TRACE(TRACE_EVT_TWIN_REPORT, strlen(jsonState), AzureIoT_Result_OK);
+    LOG_DEBUG_RL(APP_LOG_CAT_TWIN, APP_LOG_RATE_LIMIT_MS, "INFO: Azure IoT Hub client accepted request to report state '%s'.\n", jsonState);
     return AzureIoT_Result_OK;
 }
 
@@ -352,6 +461,7 @@ AzureIoT_Result AzureIoT_DeviceTwinReportState(const char *jsonState, void *cont
 static void ReportedStateCallback(int result, void *context)
 {
     Log_Debug("INFO: Azure IoT Hub Device Twin reported state callback: status code %d.\n", result);
+    TRACE(TRACE_EVT_TWIN_REPORT_ACK, result, (uintptr_t)context);
 
     if (callbacks.deviceTwinReportStateAckCallbackTypeFunction != NULL) {
         callbacks.deviceTwinReportStateAckCallbackTypeFunction(result != 0, context);
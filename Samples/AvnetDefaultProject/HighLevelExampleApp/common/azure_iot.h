@@ -154,6 +154,18 @@ void AzureIoT_Cleanup(void);
 /// <returns>An <see cref="AzureIoT_Result" /> indicating success or failure.</returns>
 AzureIoT_Result AzureIoT_SendTelemetry(const char *jsonMessage, void *context);
 
+/// <summary>
+///     Enqueue binary telemetry to send to the Azure IoT Hub, see
+///     <see cref="AzureIoT_SendTelemetry" />.
+/// </summary>
+/// <param name="data">The telemetry to send.</param>
+/// <param name="length">The number of bytes in data.</param>
+/// <param name="contentType">The message content type, or NULL.</param>
+/// <param name="context">An optional context, which will be passed to the callback.</param>
+/// <returns>An <see cref="AzureIoT_Result" /> indicating success or failure.</returns>
+AzureIoT_Result AzureIoT_SendTelemetryBinary(const uint8_t *data, size_t length,
+                                             const char *contentType, void *context);
+
 /// <summary>
 ///     Enqueue a report containing Device Twin properties to send to the Azure IoT Hub. The report
 ///     is not sent immediately; the function will return immediately, and then call the
@@ -0,0 +1,212 @@
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Boot timeline
+//
+//  Startup code calls BOOT_MARK(phase) at each phase boundary.  The first time a phase is reached
+//  the CLOCK_MONOTONIC time is saved, later calls for the same phase are ignored so reconnects do
+//  not move the boot timeline.
+//
+//  Once the first telemetry message is acknowledged, bootTimeline_ReportIfComplete() sends the
+//  timeline as a single telemetry message.  Each phase is reported as milliseconds since the
+//  application started, plus the time the OS took to start the application.  The timeline is
+//  reported once per boot and stays available through the getBootTimeline direct method.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "boot_timeline.h"
+
+#ifdef ENABLE_BOOT_TIMELINE
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <applibs/log.h>
+#include "app_log.h"
+
+#include "cloud.h"
+#include "../avnet/device_twin.h"
+#include "schema_keys.h"
+#include "../avnet/direct_methods.h"
+
+#define BOOT_PHASE_NAME(id, name, telemetryKey) name,
+static const char *bootPhaseNames[BOOT_PHASE_COUNT] = {
+    BOOT_PHASE_LIST(BOOT_PHASE_NAME)
+};
+#undef BOOT_PHASE_NAME
+
+// CLOCK_MONOTONIC time each phase was reached, 0 if the phase has not been reached
+static uint64_t phaseUs[BOOT_PHASE_COUNT];
+
+// CLOCK_BOOTTIME when the application started, the time the OS took to start the application
+static uint64_t kernelToAppUs = 0;
+
+static bool timelineReported = false;
+
+static uint64_t clockUs(clockid_t clock);
+static int phaseOffsetMs(bootPhase_t phase);
+static int phaseDeltaMs(bootPhase_t phase);
+
+/// <summary>
+///     Record the first time a boot phase is reached
+/// </summary>
+void bootTimeline_Mark(bootPhase_t phase){
+
+    if((phase >= BOOT_PHASE_COUNT) || (phaseUs[phase] != 0)){
+        return;
+    }
+
+    // Only count an ack once application telemetry has been sent
+    if((phase == BOOT_PHASE_FIRST_TELEMETRY_ACK) && (phaseUs[BOOT_PHASE_FIRST_TELEMETRY] == 0)){
+        return;
+    }
+
+    phaseUs[phase] = clockUs(CLOCK_MONOTONIC);
+
+    if(phase == BOOT_PHASE_APP_START){
+        kernelToAppUs = clockUs(CLOCK_BOOTTIME);
+    }
+
+    LOG_DEBUG(APP_LOG_CAT_APP, "BOOT: %s at %d ms\n", bootPhaseNames[phase], phaseOffsetMs(phase));
+}
+
+/// <summary>
+///     Send the timeline as telemetry once the first telemetry message has been acknowledged.
+///     Called from the telemetry timer, does nothing after the timeline has been sent.
+/// </summary>
+void bootTimeline_ReportIfComplete(void){
+
+    if(timelineReported || (phaseUs[BOOT_PHASE_FIRST_TELEMETRY_ACK] == 0)){
+        return;
+    }
+
+#define BOOT_PHASE_TELEMETRY_ARG(id, name, telemetryKey) SCHEMA_TELEMETRY(telemetryKey, phaseOffsetMs(id)),
+
+    Cloud_Result result = SCHEMA_SEND_TELEMETRY(true, BOOT_PHASE_LIST(BOOT_PHASE_TELEMETRY_ARG)
+                                                      SCHEMA_TELEMETRY(bootKernelToAppMs, (int)(kernelToAppUs / 1000)));
+
+#undef BOOT_PHASE_TELEMETRY_ARG
+
+    // If the send fails try again on the next telemetry period
+    if(result == Cloud_Result_OK){
+        timelineReported = true;
+        LOG_INFO(APP_LOG_CAT_APP, "BOOT: Timeline sent, first telemetry acknowledged %d ms after the application started\n",
+                                  phaseOffsetMs(BOOT_PHASE_FIRST_TELEMETRY_ACK));
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+//
+//  Functions for getBootTimeline directMethod
+//
+//  name: getBootTimeline
+//  Payload: {}
+//
+//  Returns the time each phase was reached (atMs) and the time since the previous phase
+//  that was reached (deltaMs).  Phases that have not been reached report -1.
+//
+//////////////////////////////////////////////////////////////////////////////////////
+
+int dmGetBootTimelineHandlerFunction(JSON_Object *JsonPayloadObj, size_t payloadSize, char** responseMsg){
+
+    JSON_Value *rootValue = json_value_init_object();
+    JSON_Object *rootObject = json_value_get_object(rootValue);
+    char keyBuffer[64];
+
+    json_object_dotset_number(rootObject, "kernelToAppMs", (double)(kernelToAppUs / 1000));
+    json_object_dotset_boolean(rootObject, "reported", timelineReported);
+
+    for(int i = 0; i < BOOT_PHASE_COUNT; i++){
+
+        snprintf(keyBuffer, sizeof(keyBuffer), "phases.%s.atMs", bootPhaseNames[i]);
+        json_object_dotset_number(rootObject, keyBuffer, phaseOffsetMs((bootPhase_t)i));
+        snprintf(keyBuffer, sizeof(keyBuffer), "phases.%s.deltaMs", bootPhaseNames[i]);
+        json_object_dotset_number(rootObject, keyBuffer, phaseDeltaMs((bootPhase_t)i));
+    }
+
+    *responseMsg = dmSerializeResponse(rootValue);
+
+    if(*responseMsg == NULL){
+        LOG_ERROR(APP_LOG_CAT_DM, "ERROR: Could not allocate boot timeline response\n");
+        return 400;
+    }
+
+    return 200;
+}
+
+/// <summary>
+///     Read a clock in microseconds
+/// </summary>
+static uint64_t clockUs(clockid_t clock){
+
+    struct timespec now;
+    clock_gettime(clock, &now);
+
+    return ((uint64_t)now.tv_sec * 1000000) + ((uint64_t)now.tv_nsec / 1000);
+}
+
+/// <summary>
+///     Milliseconds from the application start to a phase, -1 if the phase was not reached
+/// </summary>
+static int phaseOffsetMs(bootPhase_t phase){
+
+    if((phaseUs[phase] == 0) || (phaseUs[BOOT_PHASE_APP_START] == 0)){
+        return -1;
+    }
+
+    return (int)((phaseUs[phase] - phaseUs[BOOT_PHASE_APP_START]) / 1000);
+}
+
+/// <summary>
+///     Milliseconds from the latest earlier phase that was reached to this phase, -1 if the
+///     phase was not reached.  Phases can complete out of order, for example the network is
+///     often ready before the peripherals are initialized, so the delta can be 0.
+/// </summary>
+static int phaseDeltaMs(bootPhase_t phase){
+
+    if(phaseUs[phase] == 0){
+        return -1;
+    }
+
+    uint64_t previousUs = 0;
+    for(int i = 0; i < BOOT_PHASE_COUNT; i++){
+        if((i != phase) && (phaseUs[i] != 0) && (phaseUs[i] <= phaseUs[phase]) && (phaseUs[i] > previousUs)){
+            previousUs = phaseUs[i];
+        }
+    }
+
+    return (previousUs == 0) ? 0 : (int)((phaseUs[phase] - previousUs) / 1000);
+}
+
+#endif // ENABLE_BOOT_TIMELINE
@@ -0,0 +1,81 @@
+#ifndef BOOT_TIMELINE_H
+#define BOOT_TIMELINE_H
+
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#include "build_options.h"
+
+// Define the boot phases in the order they normally complete.  X(id, "name", telemetryKey)
+// The telemetry keys are declared in SCHEMA_BOOT_TELEMETRY_LIST (schema.h).
+// Each phase is recorded the first time it is reached.  Phases for features that are not
+// built in are reported as -1.
+#define BOOT_PHASE_LIST(X) \
+    X(BOOT_PHASE_APP_START,          "appStart",          bootAppStartMs) \
+    X(BOOT_PHASE_WIFI_CONFIG,        "wifiConfig",        bootWifiConfigMs) \
+    X(BOOT_PHASE_DIRECT_METHODS,     "directMethods",     bootDirectMethodsMs) \
+    X(BOOT_PHASE_M4_CONNECT,         "m4Connect",         bootM4ConnectMs) \
+    X(BOOT_PHASE_I2C_OLED,           "i2cOled",           bootI2cOledMs) \
+    X(BOOT_PHASE_USER_INTERFACE,     "userInterface",     bootUserInterfaceMs) \
+    X(BOOT_PHASE_OTA_REGISTER,       "otaRegister",       bootOtaRegisterMs) \
+    X(BOOT_PHASE_CLOUD_INIT,         "cloudInit",         bootCloudInitMs) \
+    X(BOOT_PHASE_NETWORK_READY,      "networkReady",      bootNetworkReadyMs) \
+    X(BOOT_PHASE_CONNECT_START,      "connectStart",      bootConnectStartMs) \
+    X(BOOT_PHASE_CONNECT_COMPLETE,   "connectComplete",   bootConnectCompleteMs) \
+    X(BOOT_PHASE_HUB_AUTHENTICATED,  "hubAuthenticated",  bootHubAuthenticatedMs) \
+    X(BOOT_PHASE_FIRST_TWIN,         "firstTwin",         bootFirstTwinMs) \
+    X(BOOT_PHASE_IOTCONNECT_READY,   "iotConnectReady",   bootIoTConnectReadyMs) \
+    X(BOOT_PHASE_FIRST_TELEMETRY,    "firstTelemetry",    bootFirstTelemetryMs) \
+    X(BOOT_PHASE_FIRST_TELEMETRY_ACK,"firstTelemetryAck", bootFirstTelemetryAckMs)
+
+#define BOOT_PHASE_ENUM(id, name, telemetryKey) id,
+typedef enum {
+    BOOT_PHASE_LIST(BOOT_PHASE_ENUM)
+    BOOT_PHASE_COUNT
+} bootPhase_t;
+#undef BOOT_PHASE_ENUM
+
+#ifdef ENABLE_BOOT_TIMELINE
+
+#include "parson.h"
+
+void bootTimeline_Mark(bootPhase_t phase);
+void bootTimeline_ReportIfComplete(void);
+
+// Direct method handler
+int dmGetBootTimelineHandlerFunction(JSON_Object *JsonPayloadObj, size_t payloadSize, char** responsePayload);
+
+#define BOOT_MARK(phase) bootTimeline_Mark(phase)
+
+#else
+
+#define BOOT_MARK(phase)
+
+#endif // ENABLE_BOOT_TIMELINE
+
+#endif // BOOT_TIMELINE_H
@@ -160,6 +160,27 @@
 
 //#define ENABLE_TELEMETRY_RESEND_LOGIC
 
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Bounded telemetry backlog while offline
+//
+//  ENABLE_OFFLINE_BACKLOG: Enable to keep the resend list under BACKLOG_MAX_BYTES (16 KB) during
+//  an outage of any length.  This addresses limitation 1 above.  When the list is over the limit
+//  the oldest messages are compacted, BACKLOG_COMPACT_GROUP (8) at a time, into one summary
+//  message with the min, max, mean and count of each numeric key.  Older summaries are in turn
+//  compacted into coarser summaries, so recent data keeps its full resolution.  Each summary
+//  carries "backlogFrom", "backlogTo" and "backlogMessages".
+//
+//  While offline the telemetry and sensor poll timers run BACKLOG_OFFLINE_PERIOD_MULTIPLIER (4)
+//  times slower.  After reconnecting the backlogLastOutageSeconds, backlogCompactions,
+//  backlogMessagesDropped and backlogPeakBytes read only device twins are sent.
+//
+//  Requires ENABLE_TELEMETRY_RESEND_LOGIC.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+//#define ENABLE_OFFLINE_BACKLOG
+
 //////////////////////////////////////////////////////////////////////////////////////////////////
 //
 //  Defer OTA update logic
@@ -221,6 +242,47 @@
 // TYPE_INT {"otaMaxDeferalTime", data.max_deferral_time_in_minutes)}  // Max allowable deferment time from the OS
 //#define SEND_OTA_STATUS_TELEMETRY // Send OTA events and defer details as telemetry
 
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Traffic aware OTA deferral
+//
+//  OTA_TRAFFIC_AWARE_DEFERRAL: Enable to let the application pick the time to apply OTA updates
+//  based on its own traffic history.  Requires DEFER_OTA_UPDATES.
+//
+//  The deferred update module keeps a rolling histogram, by hour of day (UTC), of the telemetry
+//  rate, direct method activity and telemetry resend queue depth (ENABLE_TELEMETRY_RESEND_LOGIC).
+//  Each hour is weighted into the histogram as it closes out, so the histogram tracks changes in
+//  the device's traffic pattern over a few days.  The histogram is saved to mutable storage once
+//  a day and just before an update is applied.
+//
+//  To enable the feature send the device twin "otaTargetUtcTime": "auto".  When an update is
+//  pending the application selects the quietest hour that falls within the OS deferral limit and
+//  defers the update until the start of that hour.  Hours with no history are not considered, if
+//  there is no history at all the update is applied right away.
+//
+//  The following telemetry is sent when a window is selected
+//
+//  TYPE_STRING {"otaWindowStartUtc", "HH:MM"}       // Start of the selected window (UTC)
+//  TYPE_INT {"otaWindowDelay", minutes}             // Deferral time in minutes
+//  TYPE_FLOAT {"otaWindowActivity", score}          // Activity score of the selected hour
+//  TYPE_INT {"otaPredictedGapSecs", seconds}        // Predicted gap in the telemetry data
+//
+//  and once telemetry flows again after the update has been applied
+//
+//  TYPE_INT {"otaActualGapSecs", seconds}           // Measured gap in the telemetry data
+//  TYPE_INT {"otaPredictedGapSecs", seconds}        // Gap predicted when the window was selected
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+//#define OTA_TRAFFIC_AWARE_DEFERRAL
+
+#ifndef DEFER_OTA_UPDATES
+#undef OTA_TRAFFIC_AWARE_DEFERRAL
+#endif
+
+// Expected time the device is off line while an update is applied, used to predict the data gap
+#define OTA_EXPECTED_OUTAGE_SECONDS 180
+
 //////////////////////////////////////////////////////////////////////////////////////////////////
 //
 //  Optional connection to real-time M4 application
@@ -275,6 +337,397 @@
 #define DEVICE_MODEL "Azure Sphere Starter Kit" // {"model"; "Avnet Starter Kit"}
 #endif 
 
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Application logging
+//
+//  APP_LOG_COMPILE_LEVEL: LOG_xxx() messages above this level are removed at compile time.
+//  0=off, 1=error, 2=warn, 3=info, 4=debug, 5=verbose.  Set to 2 for production builds so the
+//  per message debug output in the telemetry and M4 paths costs nothing.
+//
+//  APP_LOG_DEFAULT_LEVEL: Runtime level for every category at startup.  Change it at runtime
+//  with the "logLevel" device twin, or per category with "logCategoryLevels", for example
+//  "m4=5,iot=2".  Categories: app, iot, twin, dm, m4, sensor.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#define APP_LOG_COMPILE_LEVEL 4
+#define APP_LOG_DEFAULT_LEVEL 3
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Per module heap accounting
+//
+//  ENABLE_HEAP_ACCOUNTING: Enable to track heap usage by application module.  checkMemoryUsageHighWaterMark()
+//  only reports the process wide peak, this feature shows which module is using the memory.
+//
+//  Application allocations are made with APP_MALLOC(tag, size)/APP_FREE(ptr) and the accounting 
+//  allocators are installed into parson.  For each tag (Parson, ResendList, Telemetry, DeviceTwin,
+//  DirectMethod, IoTConnect, M4, Other) the implementation tracks live bytes, peak bytes, allocation
+//  and free counts and a histogram of allocation sizes.  Memory allocated inside the Azure IoT SDK is
+//  not tracked.
+//
+//  Direct method getHeapStats: Returns the complete breakdown.  Send {"resetPeaks": true} to reset
+//  the peak values after reading them.
+//
+//  Device twin "heapPeak<TagName>": Sent as a read only property when a tag's peak grows by more
+//  than 256 bytes.
+//
+//  When disabled APP_MALLOC()/APP_FREE() map to malloc()/free() and there is no overhead.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+//#define ENABLE_HEAP_ACCOUNTING
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Binary trace ring
+//
+//  ENABLE_TRACE_RING: Enable to record telemetry sends/acks, device twin traffic, DoWork calls,
+//  connection status changes, direct methods, I2C writes and M4 messages into an in memory ring of
+//  16 byte binary records.  Recording an event does not format or log anything, so the ring captures
+//  timing that Log_Debug() calls would disturb.  The ring holds the last TRACE_RING_ENTRIES (1024)
+//  events.
+//
+//  Direct method dumpTrace: Returns the ring as base64 data.  Send {"records": <n>} to return only
+//  the last n records, or {"target": "log"} to write the ring to the debug output.
+//
+//  The ring is also written to the debug output when the application exits with an error.
+//
+//  Build the decoder in Samples/AvnetDefaultProject/HostTools and run trace_decode against the
+//  direct method response or the captured debug output to get a timeline.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+//#define ENABLE_TRACE_RING
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Sample to ack latency tracing
+//
+//  ENABLE_LATENCY_TRACE: Enable to time each telemetry message from the moment its sample was 
+//  taken until the IoT Hub acknowledges it.  The capture, enqueue and hand off to the Azure IoT SDK 
+//  times travel with the message and the ack time is recorded in SendEventCallback().  Four stages
+//  are tracked: build (capture to enqueue), queue (enqueue to SDK, includes time on the resend
+//  list), ack (SDK to ack) and total.
+//
+//  Each stage is kept as a log2 millisecond histogram so percentiles are computed on the device.
+//  Up to LATENCY_TRACE_MAX_IN_FLIGHT (32) messages are traced at once, messages sent while all
+//  trace records are in use are counted as untraced.
+//
+//  Direct method getLatencyStats: Returns count, mean, p50, p90, p99 and max (microseconds) for each
+//  stage.  Send {"reset": true} to clear the statistics after reading them.
+//
+//  LATENCY_TRACE_MESSAGE_PROPERTY: Also add a "captureAgeMs" application property to each 
+//  telemetry message with the age of the sample when it was handed to the SDK.  Cloud side 
+//  consumers can subtract this from the enqueued time to measure the end to end latency.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+//#define ENABLE_LATENCY_TRACE
+//#define LATENCY_TRACE_MESSAGE_PROPERTY
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Boot timeline
+//
+//  ENABLE_BOOT_TIMELINE: Enable to record when each startup phase completes: wifi configuration,
+//  direct method init, M4 connect, I2C/OLED init, user interface, OTA registration, cloud init,
+//  network ready, connection (DPS) start and complete, IoT Hub authentication, first device twin,
+//  IoTConnect handshake, first telemetry sent and first telemetry acknowledged.  Only the first 
+//  time each phase is reached is recorded, reconnects do not change the timeline.
+//
+//  Once the first telemetry message is acknowledged the timeline is sent as one telemetry 
+//  message on the next telemetry period.  It is sent once per boot.
+//
+//  TYPE_INT {"boot<Phase>Ms", ms}            // Milliseconds from application start to each phase,
+//                                            // -1 if the phase was not reached or not built in
+//  TYPE_INT {"bootKernelToAppMs", ms}        // Time from device boot to application start
+//
+//  Direct method getBootTimeline: Returns the time of each phase and the time since the previous
+//  phase.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+//#define ENABLE_BOOT_TIMELINE
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Wakeup and CPU duty profile
+//
+//  ENABLE_WAKEUP_PROFILE: Enable to count how often each event loop timer and real time 
+//  application socket wakes the application and how long its handler runs.  Timers are named
+//  after their handler function (ButtonPollTimerEventHandler, UpdateOledEventHandler, 
+//  AzureTimerEventHandler, ReadSensorTimerEventHandler ...), real time applications by their
+//  m4Array name.  CPU duty is reported in parts per million of wall time.
+//
+//  Every WAKEUP_PROFILE_SUMMARY_PERIOD_SECONDS (10 minutes) the per source figures for the last
+//  period are written to the debug output and these totals are sent as telemetry
+//
+//  TYPE_INT {"wakeupLoopWakes", n}                // Returns from EventLoop_Run()
+//  TYPE_INT {"wakeupDispatches", n}               // Handler calls, all sources
+//  TYPE_INT {"wakeupCpuDutyPpm", ppm}             // Time in handlers / wall time
+//  TYPE_STRING {"wakeupTopSource", name}          // Source with the most dispatches
+//  TYPE_INT {"wakeupTopSourceDispatches", n}
+//
+//  Direct method getWakeupProfile: Returns the per source totals since the application started.
+//  Send {"reset": true} to clear the totals after reading them.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+//#define ENABLE_WAKEUP_PROFILE
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Worker thread offload
+//
+//  ENABLE_WORK_QUEUE: Enable to start WORK_QUEUE_THREADS (2) worker threads that run blocking 
+//  work off the event loop thread.  Modules call workQueue_Submit(job, complete, context), the job
+//  runs on a worker and complete() is called back on the event loop through an eventfd.  Jobs must
+//  not call Applibs functions, do those on the main thread before submitting the job.
+//
+//  When enabled the OTA activity histogram (OTA_TRAFFIC_AWARE_DEFERRAL) is written to mutable 
+//  storage from a worker thread.
+//
+//  Direct method getWorkQueueStats: Returns job counts, queue depth and the wait, run and total
+//  job times.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+//#define ENABLE_WORK_QUEUE
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Asynchronous peripheral initialization
+//
+//  InitPeripheralsAndHandlers() describes each subsystem as a step with the steps it depends on.
+//  Without this option every step runs in order before the event loop starts and any failure
+//  ends the application.
+//
+//  ENABLE_ASYNC_INIT: Enable to start the cloud connection first and bring up the slower
+//  subsystems (real time cores, user interface/I2C/OLED, deferred OTA) one at a time from the
+//  event loop.  If an optional subsystem fails it is logged and the application runs without
+//  it, along with anything that depends on it.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+//#define ENABLE_ASYNC_INIT
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Sensor registry
+//
+//  ENABLE_SENSOR_REGISTRY: Enable to read the sensors listed in sensorArray[] (avnet/sensor_registry.c)
+//  each at its own period instead of reading everything from the sensorPollTimer.  Every entry
+//  declares its read function, period and the keys and units of the values it produces.
+//
+//  Each sensor gets a "<sensorName>PeriodMs" device twin key to change its period, 0 stops reading
+//  it.  Sensors that don't set their own period follow the sensorPollPeriod device twin.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+//#define ENABLE_SENSOR_REGISTRY
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Local rules engine
+//
+//  ENABLE_RULES_ENGINE: Enable to run threshold rules on the device after each sensor read.  The
+//  rules come from the "rules" device twin, for example
+//
+//      "wifiRssi < -80 -> alert(weakSignal); rate(memoryHighWaterKB) > 10 -> gpio(appLed)"
+//
+//  Rules can use the sensorArray[] output keys and the real time application raw data channels
+//  (lightSensorAdc, rawData8bit, rawDataFloat, gpsAltitude, gpsNumSats).  To use another value
+//  in a rule add it to sensorArray[], or add its key to SCHEMA_RT_APP_TELEMETRY_LIST in schema.h
+//  and publish its samples with SAMPLE_PUBLISH().
+//
+//  Each rule is compiled on the device when the twin arrives.  Actions are alert(name),
+//  gpio(twinKey), sensorPeriod(sensorName, ms) and telemetryPeriod(seconds).  The "rulesStatus"
+//  reported property shows the number of rules running or why the new rules were rejected.  See
+//  avnet/rules_engine.c for the full syntax.
+//
+//  Requires ENABLE_SENSOR_REGISTRY.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+//#define ENABLE_RULES_ENGINE
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Streaming anomaly detection
+//
+//  ENABLE_ANOMALY_DETECTOR: Enable to keep an exponentially weighted mean and variance for every
+//  sensor channel (sensor reads and real time application raw data).  A sample more than
+//  anomalyZThreshold (4.0) standard deviations from its channel's mean is sent right away as an
+//  anomaly telemetry message with the value, mean, standard deviation and z-score.
+//
+//  Device twins:
+//      anomalyZThreshold:      z-score that counts as an anomaly
+//      anomalyHalfLifeSeconds: Age at which a sample has half the weight of a new one (300)
+//      anomalySummaryOnly:     When true the telemetry timer sends one summary message per
+//                              channel (count, min, max, mean, stddev) instead of the routine
+//                              telemetry
+//
+//  Direct method getAnomalyStats: Returns the statistics for each channel.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+//#define ENABLE_ANOMALY_DETECTOR
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Compressed sensor history
+//
+//  ENABLE_TIMESERIES_STORE: Enable to keep the recent history of every sensor channel (sensor
+//  reads and real time application raw data) in RAM.  Samples are compressed with delta-of-delta
+//  timestamps and XOR'd floats into TS_STORE_BLOCK_COUNT (64) blocks of TS_STORE_BLOCK_BYTES
+//  (256) bytes, 16 KB in total.  Noisy sensor readings take 2 to 6 bytes per sample, see
+//  HostTools/bench/ts_bench.c.  When the pool is full the oldest blocks are reused.
+//
+//  Direct method getHistory: {"channel": "wifiRssi", "seconds": 300, "points": 30} returns the
+//  min, max and mean of the channel over the last 300 seconds in 30 buckets.  Without a channel
+//  it returns the samples and bytes stored for every channel.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+//#define ENABLE_TIMESERIES_STORE
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Chunked blob upload
+//
+//  ENABLE_BLOB_UPLOAD: Enable to upload large diagnostic captures to the storage account linked
+//  to the IoT Hub (IoT Hub file upload).  The data is read from the application in
+//  CLOUD_BLOB_CHUNK_BYTES (4 KB) blocks as the upload proceeds, so a capture is never copied into
+//  RAM as a whole.  Captures larger than CLOUD_BLOB_PART_BYTES (64 KB) are uploaded as separate
+//  blobs named <name>.part000, <name>.part001, ...  If a part fails it is retried with an
+//  exponential backoff and the parts already uploaded are not sent again.  Each part is uploaded
+//  with the SDK's blocking IoTHubDeviceClient_LL_UploadMultipleBlocksToBlob() from a work queue
+//  job, see common/cloud_blob.c.  Requires ENABLE_WORK_QUEUE.
+//
+//  Direct method dumpTrace: {"target": "blob"} uploads the trace ring as TRACE lines
+//  (requires ENABLE_TRACE_RING), HostTools/trace_decode reads the blob.
+//
+//  Use HostTools/blob_bench to measure throughput and heap use against a local storage stand-in.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+//#define ENABLE_BLOB_UPLOAD
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Live mode
+//
+//  ENABLE_LIVE_MODE: Enable to let the cloud stream one device's sensor registry outputs at a
+//  fast rate for a limited time, for commissioning and troubleshooting.  While a session runs
+//  every enabled sensor is read at least every livePeriodMs and the values are sent in batches of
+//  liveBatchFrames samples per telemetry message.  The session ends on its own when its duration
+//  is up, or when it has used its message or byte budget, and the sensors go back to their
+//  normal periods.  A watchdog timer ends the session even if the sample timer stops.
+//
+//  Device twins:
+//      liveMode:           Seconds to stream, each update starts a session.  0 ends the
+//                          session.  The reported value goes back to 0 when the session ends,
+//                          and liveModeStatus reports "running" or why the session ended.
+//      livePeriodMs:       Sample period (1000), not less than LIVE_MODE_MIN_PERIOD_MS (200)
+//      liveBatchFrames:    Samples per telemetry message (10)
+//      liveMaxMessages:    Message budget per session (360)
+//      liveMaxBytes:       Byte budget per session (262144)
+//
+//  Direct method liveMode: {"durationSeconds": 120} starts a session with the twin settings,
+//  any of "periodMs", "batchFrames", "maxMessages" and "maxBytes" override them for that session.
+//  {"durationSeconds": 0} ends the session.  Returns the session status.
+//
+//  Sessions are limited to LIVE_MODE_MAX_DURATION_SECONDS (3600) whatever is requested.  The
+//  liveMode left in the desired properties is not run again after a restart or reconnect, only
+//  a desired properties patch that contains liveMode starts a session.
+//
+//  Requires ENABLE_SENSOR_REGISTRY.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+//#define ENABLE_LIVE_MODE
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Telemetry pipelines
+//
+//  ENABLE_TELEMETRY_PIPELINE: Enable to route every sensor reading (the sensor registry outputs,
+//  or wifiRssi without the registry) through the staged pipelines built in main.c:
+//
+//      source -> filters -> aggregate -> encoder -> queue -> sink
+//
+//  Each stage is a small struct of function pointers with its own in/out/dropped/bytes
+//  counters, and no stage allocates memory.  The pipelines are flushed by the telemetry timer.
+//  The sample pipeline sends the latest reading of each channel that moved, as JSON, to
+//  IoTConnect or the IoT Hub.  Built in stages:
+//
+//      Filters:    key select, deadband
+//      Aggregates: batch (every sample), reduce (latest, mean, min or max per channel)
+//      Encoders:   JSON, binary
+//      Sinks:      IoT Hub, IoTConnect (JSON only), UART, debug log
+//
+//  A sink that can't send (not connected) keeps up to PIPELINE_QUEUE_DEPTH (4) encoded messages
+//  and drops the oldest after that.
+//
+//  TELEMETRY_PIPELINE_UART: Also send every sample, batched and binary encoded, to this UART.
+//  Add the ISU to the Uart capability in app_manifest.json.
+//
+//  Direct method getPipelineStats: Returns the counters of every stage.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+//#define ENABLE_TELEMETRY_PIPELINE
+//#define TELEMETRY_PIPELINE_UART AVNET_MT3620_SK_ISU0_UART
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Variance adaptive telemetry period
+//
+//  ENABLE_ADAPTIVE_TELEMETRY: Enable to set the telemetry period from how much the sensor
+//  channels are changing.  Each channel keeps a fast (30 second half life) and a slow (30 minute
+//  half life) variance.  When the fast variance rises above the slow one the period shortens
+//  toward adaptiveMinSeconds right away, when the channels settle it grows back toward 
+//  adaptiveMaxSeconds by at most 25% per message.  See common/adaptive_period.c.
+//
+//  Device twins:
+//
+//  adaptiveMinSeconds, adaptiveMaxSeconds: The period bounds (10 and 300 seconds), 0 in 
+//  either turns the adaptive period off and the telemetryPeriod device twin sets the period.
+//  adaptiveChannels: Comma separated channel names that set the period, for example
+//  "wifiRssi,memoryHighWaterKB".  Empty uses every channel.
+//
+//  While enabled telemetryPeriod is the starting period, the rules engine telemetryPeriod
+//  action overrides the adaptive period while its rule holds and the offline backlog still
+//  stretches the period while disconnected.  The "adaptivePeriodSeconds" reported property
+//  shows the period in use.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+//#define ENABLE_ADAPTIVE_TELEMETRY
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Telemetry key dictionary
+//
+//  ENABLE_TELEMETRY_KEY_DICTIONARY: Enable to send telemetry with short JSON keys, for metered
+//  links where the keys are most of the message.  The short keys come from the versioned
+//  dictionaries in common/key_dictionary.c, the keyDictionary device twin selects one by id
+//  ("av1").  Messages with short keys carry the id in the "kd" message property so the cloud
+//  can expand the keys.  Until the twin is set, or for any message that can't be shortened
+//  safely, telemetry is sent with full keys.
+//
+//  The key_dictionary_bench host tool shows the bytes saved on the sample payloads and prints
+//  the dictionaries for the cloud side.
+//
+//  Not available with USE_IOT_CONNECT, IoTConnect matches the full keys to the template
+//  attributes.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+//#define ENABLE_TELEMETRY_KEY_DICTIONARY
+
 //////////////////////////////////////////////////////////////////////////////////////////////////
 //
 //  Debug control
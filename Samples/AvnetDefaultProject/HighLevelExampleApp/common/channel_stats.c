@@ -0,0 +1,84 @@
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#include "channel_stats.h"
+
+#include <math.h>
+#include <string.h>
+
+void *channelTable_Find(void *records, size_t recordSize, int *count, int maxCount, const char *name,
+                        bool add)
+{
+    uint8_t *record = records;
+
+    for (int i = 0; i < *count; i++, record += recordSize) {
+
+        // Callers normally pass the same pointer every time, only compare the strings if not
+        const char *recordName = *(const char **)record;
+        if ((recordName == name) || (strcmp(recordName, name) == 0)) {
+            return record;
+        }
+    }
+
+    if (!add || (*count >= maxCount)) {
+        return NULL;
+    }
+
+    (*count)++;
+    memset(record, 0, recordSize);
+    *(const char **)record = name;
+    return record;
+}
+
+void ewmaStats_Update(ewmaStats_t *stats, float value, uint64_t timeMs, float halfLifeSeconds,
+                      uint32_t warmupSamples)
+{
+    if (stats->sampleCount == 0) {
+        stats->mean = value;
+        stats->variance = 0.0f;
+        stats->sampleCount = 1;
+        stats->lastSampleMs = timeMs;
+        return;
+    }
+
+    // Time based weight, alpha = 1 - 2^(-dt/halfLife)
+    float dtSeconds = (float)(timeMs - stats->lastSampleMs) / 1000.0f;
+    float alpha = 1.0f - exp2f(-dtSeconds / halfLifeSeconds);
+    if (stats->sampleCount < warmupSamples) {
+        alpha = fmaxf(alpha, 1.0f / (float)(stats->sampleCount + 1));
+    }
+
+    // Incremental exponentially weighted mean and variance
+    float diff = value - stats->mean;
+    float increment = alpha * diff;
+    stats->mean += increment;
+    stats->variance = (1.0f - alpha) * (stats->variance + (diff * increment));
+
+    stats->sampleCount++;
+    stats->lastSampleMs = timeMs;
+}
@@ -0,0 +1,72 @@
+#ifndef CHANNEL_STATS_H
+#define CHANNEL_STATS_H
+
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Per channel bookkeeping shared by the modules that watch the sensor samples (anomaly detector,
+// adaptive telemetry period, time series store).
+//
+// Channel tables are small fixed arrays of records whose first member is the channel name,
+// declared as "const char *name".  The name is not copied, it must stay valid (string literal
+// or table entry).
+
+// Exponentially weighted mean and variance with a time based weight.  A sample's weight halves
+// every halfLifeSeconds, so channels sampled at different rates forget at the same speed.
+typedef struct {
+    uint32_t sampleCount;
+    uint64_t lastSampleMs;
+    float mean;
+    float variance;
+} ewmaStats_t;
+
+/// <summary>
+///     Find the record for name in a channel table, adding it (zeroed, with the name set) if add
+///     is true and there's room.  Returns NULL if the channel isn't found and can't be added.
+/// </summary>
+void *channelTable_Find(void *records, size_t recordSize, int *count, int maxCount, const char *name,
+                        bool add);
+
+// channelTable_Find() on a channel table declared as an array
+#define CHANNEL_TABLE_FIND(table, count, name, add) \
+    channelTable_Find(table, sizeof(table[0]), &(count), (int)(sizeof(table) / sizeof(table[0])), name, add)
+
+/// <summary>
+///     Fold a sample taken at timeMs into the statistics.  The first sample sets the mean, until
+///     warmupSamples have been seen each sample weighs at least 1/n so the statistics start as a
+///     plain average instead of being swamped by the first sample.
+/// </summary>
+void ewmaStats_Update(ewmaStats_t *stats, float value, uint64_t timeMs, float halfLifeSeconds,
+                      uint32_t warmupSamples);
+
+#endif // CHANNEL_STATS_H
@@ -18,9 +18,21 @@
 #include "../avnet/device_twin.h"
 #include "../avnet/direct_methods.h"
 #include "../avnet/m4_support.h"
+#include "../avnet/mem_accounting.h"
 #if defined(IOT_HUB_APPLICATION) && defined(ENABLE_TELEMETRY_RESEND_LOGIC)
 #include "linkedList.h"
 #endif 
+#include "latency_trace.h"
+#include "boot_timeline.h"
+#include "anomaly_detector.h"
+#include "offline_backlog.h"
+#include "cloud_blob.h"
+#include "telemetry_pipeline.h"
+#include "adaptive_period.h"
+#include "schema_keys.h"
+#ifdef OTA_TRAFFIC_AWARE_DEFERRAL
+#include "../avnet/deferred_updates.h"
+#endif 
 
 
 // This file implements the interface described in cloud.h in terms of an Azure IoT Hub.
@@ -48,11 +60,16 @@ void AzureIoT_SendTelemetryCallback(bool success, void *context){
 
     telemetryNode_t* thisNode = (telemetryNode_t*)context;
 
+#ifdef ENABLE_OFFLINE_BACKLOG
+    // The SDK is done with this copy of the node, the backlog frees it when no copies are left
+    backlog_SendCompleted(thisNode, success);
+#else
     // If the message was successfully sent, then find and remove the message Node from
     // the linked List
     if(success){
         DeleteNode(thisNode);
     }
+#endif // ENABLE_OFFLINE_BACKLOG
 }
 #endif // defined(IOT_HUB_APPLICATION) && defined(ENABLE_TELEMETRY_RESEND_LOGIC)
 
@@ -90,11 +107,23 @@ ExitCode Cloud_Initialize(EventLoop *el, void *backendContext,
 #endif 
         .deviceMethodCallbackFunction = DeviceMethodCallbackHandler};
 
+#ifdef ENABLE_BLOB_UPLOAD
+    ExitCode blobExitCode = cloudBlob_Init(el, failureCallback);
+    if (blobExitCode != ExitCode_Success) {
+        return blobExitCode;
+    }
+#endif // ENABLE_BLOB_UPLOAD
+
     return AzureIoT_Initialize(el, failureCallback, azureSpherePnPModelId, backendContext, callbacks);
 }
 
 void Cloud_Cleanup(void)
 {
+#ifdef ENABLE_BLOB_UPLOAD
+    // Stop any upload before the client it runs on is destroyed
+    cloudBlob_Cleanup();
+#endif // ENABLE_BLOB_UPLOAD
+
     AzureIoT_Cleanup();
 
 
@@ -143,17 +172,40 @@ void SendTelemetryTimerEventHandler(EventLoopTimer *timer)
         return;
     }
 
+#ifdef ENABLE_ADAPTIVE_TELEMETRY
+    // Lengthen the period once the channels settle, before the timer fires again
+    adaptivePeriod_TimerTick();
+#endif // ENABLE_ADAPTIVE_TELEMETRY
+
+#ifdef ENABLE_BOOT_TIMELINE
+    // Send the boot timeline once the first telemetry message has been acknowledged
+    bootTimeline_ReportIfComplete();
+#endif // ENABLE_BOOT_TIMELINE
+
+#ifdef ENABLE_TELEMETRY_PIPELINE
+    // Send what the pipelines have collected over the telemetry period
+    pipeline_FlushAll();
+#endif // ENABLE_TELEMETRY_PIPELINE
+
+#ifdef ENABLE_ANOMALY_DETECTOR
+    // Send channel summaries in place of the routine telemetry, anomalies are sent as they happen
+    if (anomalySummaryOnly) {
+        anomaly_SendSummaries();
+        return;
+    }
+#endif // ENABLE_ANOMALY_DETECTOR
+
 #ifdef M4_INTERCORE_COMMS
     // Send each real time core a message requesting telemetry
     RequestRealTimeTelemetry();
 
 #endif     
 
-    // Send an example telemetry message
-    Cloud_SendTelemetry(true, 3*ARGS_PER_TELEMETRY_ITEM, 
-                              TYPE_STRING, "sampleKeyString", "AvnetKnowsIoT",
-                              TYPE_INT, "sampleKeyInt", (int)(rand()%100),
-                              TYPE_FLOAT, "sampleKeyFloat", ((float)rand()/(float)(RAND_MAX)) * 100);
+    // Send an example telemetry message, the sample values are generated here
+    LATENCY_MARK_CAPTURE();
+    SCHEMA_SEND_TELEMETRY(true, SCHEMA_TELEMETRY(sampleKeyString, "AvnetKnowsIoT"),
+                                SCHEMA_TELEMETRY(sampleKeyInt, (int)(rand()%100)),
+                                SCHEMA_TELEMETRY(sampleKeyFloat, ((float)rand()/(float)(RAND_MAX)) * 100));
 
 #ifdef IOT_HUB_APPLICATION
 //    SendTelemetry(pjsonBuffer, true);
@@ -182,6 +234,7 @@ Cloud_Result Cloud_SendTelemetry(bool IoTConnectFormat, int arg_count, ...)
 
     // Make sure we have an triple number of {DataType, "Key", "Value"} arguments
     if(arg_count%3 == 1){
+        LATENCY_DISCARD_PENDING();
         return Cloud_Result_OtherFailure;
     }
 
@@ -189,6 +242,7 @@ Cloud_Result Cloud_SendTelemetry(bool IoTConnectFormat, int arg_count, ...)
     // If we need to send in IoTConnect format, but we're not connected to IoTConnect, then
     // return an error and don't send any telemetry.
     if (IoTConnectFormat && !IoTConnectIsConnected()) {
+        LATENCY_DISCARD_PENDING();
         return Cloud_Result_IoTConnect_unassociated;
     }
 #endif
@@ -209,7 +263,7 @@ Cloud_Result Cloud_SendTelemetry(bool IoTConnectFormat, int arg_count, ...)
 
 #define LOCAL_BUFFER_SIZE 128
 
-    char* pjsonBuffer = (char *)malloc(LOCAL_BUFFER_SIZE);
+    char* pjsonBuffer = (char *)APP_MALLOC(MEM_TAG_TELEMETRY, LOCAL_BUFFER_SIZE);
     if (pjsonBuffer == NULL) {
 		Log_Debug("ERROR: not enough memory to send telemetry.");
 	}
@@ -270,20 +324,24 @@ Cloud_Result Cloud_SendTelemetry(bool IoTConnectFormat, int arg_count, ...)
 
             int dataType = va_arg(inputList, int);
             // Pull the data type from the list 
+
+            // Pull the current "key" before the value, the order two va_arg() calls
+            // in the same argument list are evaluated in is unspecified
+            char* keyString = va_arg(inputList, char*);
             switch (dataType) {
 
 		        // report current device twin data as reported properties to IoTHub
 		        case TYPE_BOOL:
-                    json_object_dotset_boolean(root_object, va_arg(inputList, char*), va_arg(inputList, int)? 1: 0);
+                    json_object_dotset_boolean(root_object, keyString, va_arg(inputList, int)? 1: 0);
 			        break;
 		        case TYPE_FLOAT:
-                    json_object_dotset_number(root_object, va_arg(inputList, char*), va_arg(inputList, double));
+                    json_object_dotset_number(root_object, keyString, va_arg(inputList, double));
 			        break;
 		        case TYPE_INT:
-                    json_object_dotset_number(root_object, va_arg(inputList, char*), va_arg(inputList, int));
+                    json_object_dotset_number(root_object, keyString, va_arg(inputList, int));
 			        break;
  		        case TYPE_STRING:
-                    json_object_dotset_string(root_object, va_arg(inputList, char*), va_arg(inputList, char*));
+                    json_object_dotset_string(root_object, keyString, va_arg(inputList, char*));
 			        break;
 	        }
         }
@@ -300,27 +358,55 @@ Cloud_Result Cloud_SendTelemetry(bool IoTConnectFormat, int arg_count, ...)
         json_array_append_value(myArray,array_value_object);
         json_object_dotset_value(root_object,"d", myArrayValue);
     }
+    else {
+
+        // The IoT Connect structures were not added to the root object, free them here
+        json_value_free(array_value_object);
+        json_value_free(myArrayValue);
+    }
 
 #endif // USE_IOT_CONNECT
 
     // Serialize the structure and send it as telemetry
     serializedJson = json_serialize_to_string(root_value); // leaf_value
+    LATENCY_MARK_ENQUEUE();
     
 #if defined(IOT_HUB_APPLICATION) && defined(ENABLE_TELEMETRY_RESEND_LOGIC)    
     // Add the telemetry JSON into a linked list in case the send fails
     telemetryNode_t* telemetryListNodePtr = InsertAtTail(serializedJson, strlen(serializedJson));
+#ifdef ENABLE_LATENCY_TRACE
+    // Keep the original timestamps in case the message has to be resent
+    if(telemetryListNodePtr != NULL){
+        latencyTrace_PeekPending(&telemetryListNodePtr->latencyStamp);
+    }
+#endif // ENABLE_LATENCY_TRACE
 
     // Send the telemetry messsage
     AzureIoT_Result aziotResult = AzureIoT_SendTelemetry(serializedJson, telemetryListNodePtr);
+
+#ifdef ENABLE_OFFLINE_BACKLOG
+    // Keep the unsent telemetry within its memory budget
+    backlog_SendAttempted(telemetryListNodePtr, aziotResult == AzureIoT_Result_OK);
+    backlog_CheckSize();
+#endif // ENABLE_OFFLINE_BACKLOG
 #else
     AzureIoT_Result aziotResult = AzureIoT_SendTelemetry(serializedJson, NULL);
 #endif 
     result = AzureIoTToCloudResult(aziotResult);
+    if (result == Cloud_Result_OK) {
+        BOOT_MARK(BOOT_PHASE_FIRST_TELEMETRY);
+    }
+
+#ifdef OTA_TRAFFIC_AWARE_DEFERRAL
+    // Feed the telemetry rate into the OTA activity histogram
+    otaActivity_RecordTelemetry(result == Cloud_Result_OK);
+#endif // OTA_TRAFFIC_AWARE_DEFERRAL
 
     if (result != Cloud_Result_OK) {
         Log_Debug("WARNING: Could not send telemetry to cloud: %s\n", CloudResultToString(result));
         
         // Output the telemetry Json structure as debuh
+        json_free_serialized_string(serializedJson);
         serializedJson = json_serialize_to_string_pretty(root_value); // leaf_value
         Log_Debug("%s\n", serializedJson);
     }
@@ -331,7 +417,7 @@ Cloud_Result Cloud_SendTelemetry(bool IoTConnectFormat, int arg_count, ...)
     
 #ifdef USE_IOT_CONNECT    
     if(pjsonBuffer != NULL){
-       free(pjsonBuffer);
+       APP_FREE(pjsonBuffer);
     }
 #endif     
 
@@ -0,0 +1,378 @@
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Chunked blob upload
+//
+//  Uploads a capture to the storage account linked to the IoT Hub with
+//  IoTHubDeviceClient_LL_UploadMultipleBlocksToBlob().  The Azure Sphere SDK only has the blocking
+//  call, so each part is uploaded from a work queue job (common/work_queue.h) and the event loop
+//  keeps running.  The SDK asks for the blob one block at a time from the worker thread, and each
+//  block is read from the application's source callback into a single CLOUD_BLOB_CHUNK_BYTES
+//  buffer.  Nothing else is buffered, so a capture of any size costs one chunk of RAM.  The source
+//  callback runs on the worker thread.
+//
+//  A capture larger than CLOUD_BLOB_PART_BYTES is split into parts and each part is uploaded as
+//  its own blob, <name>.part000, <name>.part001, ...  The SDK restarts a failed blob from the
+//  beginning, splitting the capture bounds what a failure costs: only the failed part is read
+//  and sent again.
+//
+//  The upload uses its own HTTPS connection in the SDK, DoWork keeps running on the main thread
+//  while a part uploads, the same way the SDK's convenience layer runs it from a thread.  The
+//  client handle must not be destroyed while a part is uploading, SetUpAzureIoTHubClient() waits
+//  for cloudBlob_ClientInUse() to return false.
+//
+//      Uploading:  A job is uploading the current part, its completion starts the next part
+//      Retry:      Wait out the backoff on the blob timer, then start the same part again
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "cloud_blob.h"
+
+#ifdef ENABLE_BLOB_UPLOAD
+
+#include <stdio.h>
+#include <string.h>
+#include <applibs/log.h>
+#include "app_log.h"
+#include <iothub_device_client_ll.h>
+
+#include "eventloop_timer_utilities.h"
+#include "work_queue.h"
+
+extern IOTHUB_DEVICE_CLIENT_LL_HANDLE iothubClientHandle;
+
+typedef enum {
+    BLOB_STATE_IDLE = 0,
+    BLOB_STATE_UPLOADING,
+    BLOB_STATE_RETRY
+} blobState_t;
+
+// The worker reads the upload settings while a part is uploading, the main thread does not
+// change them until the job's completion.  cancelled and partOffset are shared while it runs.
+static struct {
+    blobState_t state;
+    char name[CLOUD_BLOB_MAX_NAME];
+    char partName[CLOUD_BLOB_MAX_NAME];
+    size_t totalBytes;
+    cloudBlobSourceCallback_t source;
+    cloudBlobDoneCallback_t done;
+    void *context;
+    IOTHUB_DEVICE_CLIENT_LL_HANDLE client;  // Handle the current part is uploading with
+    uint32_t part;
+    uint32_t partCount;
+    size_t partOffset;          // Bytes of the current part handed to the SDK
+    uint32_t attempts;          // Failures of the current part
+    uint32_t retries;
+    bool cancelled;
+    bool sourceFailed;
+} upload;
+
+static unsigned char chunk[CLOUD_BLOB_CHUNK_BYTES];
+static EventLoopTimer *blobTimer = NULL;
+static ExitCode_CallbackType failureCallbackFunction = NULL;
+
+static void BlobTimerEventHandler(EventLoopTimer *timer);
+static int UploadPartJob(void *context);
+static void UploadPartComplete(void *context, int result);
+static IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_RESULT GetBlockCallback(IOTHUB_CLIENT_FILE_UPLOAD_RESULT result,
+                                                                  unsigned char const **data,
+                                                                  size_t *size, void *context);
+static void startPart(void);
+static void partFailed(void);
+static void finishUpload(bool success);
+static size_t partLength(uint32_t part);
+
+ExitCode cloudBlob_Init(EventLoop *eventLoop, ExitCode_CallbackType failureCallback)
+{
+    failureCallbackFunction = failureCallback;
+
+    blobTimer = CreateEventLoopDisarmedTimer(eventLoop, &BlobTimerEventHandler);
+    if (blobTimer == NULL) {
+        return ExitCode_Init_BlobUploadTimer;
+    }
+
+    return ExitCode_Success;
+}
+
+void cloudBlob_Cleanup(void)
+{
+    // A part still uploading is aborted at its next block, its completion is ignored once the
+    // state is idle
+    __atomic_store_n(&upload.cancelled, true, __ATOMIC_RELEASE);
+    upload.state = BLOB_STATE_IDLE;
+    upload.done = NULL;
+
+    DisposeEventLoopTimer(blobTimer);
+    blobTimer = NULL;
+}
+
+bool cloudBlob_Upload(const char *name, size_t totalBytes, cloudBlobSourceCallback_t source,
+                      cloudBlobDoneCallback_t done, void *context)
+{
+    if (upload.state != BLOB_STATE_IDLE) {
+        LOG_ERROR(APP_LOG_CAT_IOT, "ERROR: Blob upload of %s is still running\n", upload.name);
+        return false;
+    }
+
+    // Leave room for the ".part000" suffix, which caps an upload at 1000 parts
+    if ((name == NULL) || (source == NULL) || (totalBytes == 0) || (blobTimer == NULL) ||
+        (strlen(name) + 9 > sizeof(upload.name)) ||
+        (totalBytes > (size_t)CLOUD_BLOB_PART_BYTES * 1000)) {
+        LOG_ERROR(APP_LOG_CAT_IOT, "ERROR: Invalid blob upload request\n");
+        return false;
+    }
+
+    memset(&upload, 0, sizeof(upload));
+    strcpy(upload.name, name);
+    upload.totalBytes = totalBytes;
+    upload.source = source;
+    upload.done = done;
+    upload.context = context;
+    upload.partCount = (uint32_t)((totalBytes + CLOUD_BLOB_PART_BYTES - 1) / CLOUD_BLOB_PART_BYTES);
+
+    LOG_INFO(APP_LOG_CAT_IOT, "Blob upload of %s started: %zu bytes in %u part(s)\n", upload.name, totalBytes,
+                              upload.partCount);
+
+    startPart();
+    return true;
+}
+
+void cloudBlob_Cancel(void)
+{
+    switch (upload.state) {
+    case BLOB_STATE_UPLOADING:
+        // The next block request aborts the part and the job completes with the failure
+        __atomic_store_n(&upload.cancelled, true, __ATOMIC_RELEASE);
+        break;
+    case BLOB_STATE_RETRY:
+        upload.cancelled = true;
+        finishUpload(false);
+        break;
+    case BLOB_STATE_IDLE:
+    default:
+        break;
+    }
+}
+
+bool cloudBlob_ClientInUse(void)
+{
+    return (upload.state == BLOB_STATE_UPLOADING);
+}
+
+void cloudBlob_GetStatus(cloudBlobStatus_t *status)
+{
+    memset(status, 0, sizeof(*status));
+    if (upload.state == BLOB_STATE_IDLE) {
+        return;
+    }
+
+    status->active = true;
+    strcpy(status->name, upload.name);
+    status->totalBytes = upload.totalBytes;
+    status->bytesSent = ((size_t)upload.part * CLOUD_BLOB_PART_BYTES) +
+                        __atomic_load_n(&upload.partOffset, __ATOMIC_RELAXED);
+    status->part = upload.part;
+    status->partCount = upload.partCount;
+    status->retries = upload.retries;
+    status->waitingToRetry = (upload.state == BLOB_STATE_RETRY);
+}
+
+/// <summary>
+///     Blob timer event:  The retry backoff is over, start the part again
+/// </summary>
+static void BlobTimerEventHandler(EventLoopTimer *timer)
+{
+    if (ConsumeEventLoopTimerEvent(timer) != 0) {
+        failureCallbackFunction(ExitCode_BlobUploadTimer_Consume);
+        return;
+    }
+
+    if (upload.state == BLOB_STATE_RETRY) {
+        startPart();
+    }
+}
+
+/// <summary>
+///     Queue the upload of the current part
+/// </summary>
+static void startPart(void)
+{
+    if (upload.partCount == 1) {
+        strcpy(upload.partName, upload.name);
+    } else {
+        snprintf(upload.partName, sizeof(upload.partName), "%.118s.part%03u", upload.name, upload.part % 1000);
+    }
+
+    upload.partOffset = 0;
+    upload.sourceFailed = false;
+    upload.client = iothubClientHandle;
+    upload.state = BLOB_STATE_UPLOADING;
+
+    if ((upload.client == NULL) || !workQueue_Submit(UploadPartJob, UploadPartComplete, NULL)) {
+        LOG_WARN(APP_LOG_CAT_IOT, "WARNING: Could not start the upload of %s\n", upload.partName);
+        partFailed();
+    }
+}
+
+/// <summary>
+///     Work queue job:  Upload the current part, returns the IOTHUB_CLIENT_RESULT
+/// </summary>
+static int UploadPartJob(void *context)
+{
+    return (int)IoTHubDeviceClient_LL_UploadMultipleBlocksToBlob(upload.client, upload.partName,
+                                                                 GetBlockCallback, NULL);
+}
+
+/// <summary>
+///     Work queue completion:  Start the next part, or retry the part that failed
+/// </summary>
+static void UploadPartComplete(void *context, int result)
+{
+    if (upload.state != BLOB_STATE_UPLOADING) {
+        return;
+    }
+
+    if (result != IOTHUB_CLIENT_OK) {
+        partFailed();
+        return;
+    }
+
+    upload.part++;
+    upload.attempts = 0;
+    LOG_DEBUG(APP_LOG_CAT_IOT, "Blob upload of %s: part %u of %u done\n", upload.name, upload.part,
+                               upload.partCount);
+
+    if (upload.part == upload.partCount) {
+        finishUpload(true);
+    } else {
+        startPart();
+    }
+}
+
+/// <summary>
+///     Called by the SDK on the worker thread.  With data and size set it asks for the next block
+///     of the part, a zero size ends the part.  With data and size NULL it reports the part's
+///     result, which the job also returns.
+/// </summary>
+static IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_RESULT GetBlockCallback(IOTHUB_CLIENT_FILE_UPLOAD_RESULT result,
+                                                                  unsigned char const **data,
+                                                                  size_t *size, void *context)
+{
+    if ((data == NULL) || (size == NULL)) {
+        return IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_OK;
+    }
+
+    if (__atomic_load_n(&upload.cancelled, __ATOMIC_ACQUIRE)) {
+        return IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_ABORT;
+    }
+
+    size_t remaining = partLength(upload.part) - upload.partOffset;
+    if (remaining == 0) {
+        *data = NULL;
+        *size = 0;
+        return IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_OK;
+    }
+
+    size_t length = (remaining < sizeof(chunk)) ? remaining : sizeof(chunk);
+    size_t offset = ((size_t)upload.part * CLOUD_BLOB_PART_BYTES) + upload.partOffset;
+    if (upload.source(offset, chunk, length, upload.context) != (int)length) {
+        upload.sourceFailed = true;
+        return IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_ABORT;
+    }
+
+    __atomic_store_n(&upload.partOffset, upload.partOffset + length, __ATOMIC_RELAXED);
+    *data = chunk;
+    *size = length;
+    return IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_OK;
+}
+
+/// <summary>
+///     The current part failed, schedule a retry or give up
+/// </summary>
+static void partFailed(void)
+{
+    if (upload.sourceFailed) {
+        LOG_ERROR(APP_LOG_CAT_IOT, "ERROR: Blob upload of %s could not read part %u at offset %zu\n", upload.name,
+                                   upload.part, ((size_t)upload.part * CLOUD_BLOB_PART_BYTES) + upload.partOffset);
+    }
+    if (upload.cancelled || upload.sourceFailed) {
+        finishUpload(false);
+        return;
+    }
+
+    upload.retries++;
+    if (++upload.attempts >= CLOUD_BLOB_MAX_ATTEMPTS) {
+        LOG_ERROR(APP_LOG_CAT_IOT, "ERROR: Blob upload of %s failed, part %u failed %u times\n", upload.name,
+                                   upload.part, upload.attempts);
+        finishUpload(false);
+        return;
+    }
+
+    uint32_t backoffMs = CLOUD_BLOB_RETRY_MIN_MS;
+    for (uint32_t i = 1; (i < upload.attempts) && (backoffMs < CLOUD_BLOB_RETRY_MAX_MS); i++) {
+        backoffMs *= 2;
+    }
+    if (backoffMs > CLOUD_BLOB_RETRY_MAX_MS) {
+        backoffMs = CLOUD_BLOB_RETRY_MAX_MS;
+    }
+
+    LOG_WARN_RL(APP_LOG_CAT_IOT, APP_LOG_RATE_LIMIT_MS, "WARNING: Blob upload of %s: part %u failed, retrying in %u ms\n",
+                upload.name, upload.part, backoffMs);
+    upload.partOffset = 0;
+    upload.state = BLOB_STATE_RETRY;
+
+    struct timespec backoff = {.tv_sec = backoffMs / 1000, .tv_nsec = (long)(backoffMs % 1000) * 1000000};
+    SetEventLoopTimerOneShot(blobTimer, &backoff);
+}
+
+static void finishUpload(bool success)
+{
+    cloudBlobDoneCallback_t done = upload.done;
+
+    upload.state = BLOB_STATE_IDLE;
+    DisarmEventLoopTimer(blobTimer);
+
+    LOG_INFO(APP_LOG_CAT_IOT, "Blob upload of %s %s after %u retries\n", upload.name,
+                              success ? "complete" : (upload.cancelled ? "cancelled" : "failed"), upload.retries);
+
+    if (done != NULL) {
+        done(success, upload.name, upload.context);
+    }
+}
+
+static size_t partLength(uint32_t part)
+{
+    size_t start = (size_t)part * CLOUD_BLOB_PART_BYTES;
+    size_t remaining = upload.totalBytes - start;
+    return (remaining < CLOUD_BLOB_PART_BYTES) ? remaining : CLOUD_BLOB_PART_BYTES;
+}
+
+#endif // ENABLE_BLOB_UPLOAD
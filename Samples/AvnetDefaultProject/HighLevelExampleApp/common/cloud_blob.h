@@ -0,0 +1,127 @@
+#ifndef CLOUD_BLOB_H
+#define CLOUD_BLOB_H
+
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "build_options.h"
+
+// Size of the blocks handed to the Azure IoT SDK, the only buffer the upload uses
+#ifndef CLOUD_BLOB_CHUNK_BYTES
+#define CLOUD_BLOB_CHUNK_BYTES (4 * 1024)
+#endif
+
+// Captures larger than this are uploaded as several blobs.  A failed part is uploaded again
+// from its start, the parts before it are kept.
+#ifndef CLOUD_BLOB_PART_BYTES
+#define CLOUD_BLOB_PART_BYTES (64 * 1024)
+#endif
+
+// Retry backoff, doubles from the minimum up to the maximum for each failure of the same part
+#ifndef CLOUD_BLOB_RETRY_MIN_MS
+#define CLOUD_BLOB_RETRY_MIN_MS 2000
+#endif
+
+#ifndef CLOUD_BLOB_RETRY_MAX_MS
+#define CLOUD_BLOB_RETRY_MAX_MS (5 * 60 * 1000)
+#endif
+
+// Failures of a single part before the upload is abandoned
+#ifndef CLOUD_BLOB_MAX_ATTEMPTS
+#define CLOUD_BLOB_MAX_ATTEMPTS 8
+#endif
+
+// Longest blob name, the part suffix included
+#define CLOUD_BLOB_MAX_NAME 128
+
+/// <summary>
+///     Called for each block of the upload.  Copy size bytes starting at offset into buffer and
+///     return the number of bytes copied, anything other than size aborts the upload.  A part is
+///     read again from its start when it is retried, so the same offset must return the same
+///     data.
+/// </summary>
+typedef int (*cloudBlobSourceCallback_t)(size_t offset, unsigned char *buffer, size_t size,
+                                         void *context);
+
+/// <summary>
+///     Called once when the upload completes, fails or is cancelled
+/// </summary>
+typedef void (*cloudBlobDoneCallback_t)(bool success, const char *name, void *context);
+
+typedef struct {
+    bool active;
+    char name[CLOUD_BLOB_MAX_NAME];
+    size_t totalBytes;
+    size_t bytesSent;           // Bytes handed to the SDK, the current part included
+    uint32_t part;              // Part being uploaded, counts from zero
+    uint32_t partCount;
+    uint32_t retries;           // Failed attempts over the whole upload
+    bool waitingToRetry;
+} cloudBlobStatus_t;
+
+#ifdef ENABLE_BLOB_UPLOAD
+
+#ifndef ENABLE_WORK_QUEUE
+#error "ENABLE_BLOB_UPLOAD requires ENABLE_WORK_QUEUE, the SDK's blob upload call blocks"
+#endif
+
+#include <applibs/eventloop.h>
+#include "exitcodes.h"
+
+ExitCode cloudBlob_Init(EventLoop *eventLoop, ExitCode_CallbackType failureCallback);
+void cloudBlob_Cleanup(void);
+
+/// <summary>
+///     Start uploading totalBytes bytes read from source to the blob name.  Only one upload runs
+///     at a time, returns false if one is already running or the arguments are invalid.  The
+///     upload continues across disconnects until it succeeds or a part fails
+///     CLOUD_BLOB_MAX_ATTEMPTS times.  done may be NULL.
+/// </summary>
+bool cloudBlob_Upload(const char *name, size_t totalBytes, cloudBlobSourceCallback_t source,
+                      cloudBlobDoneCallback_t done, void *context);
+
+/// <summary>
+///     Stop the running upload.  The done callback is called with success false once the SDK
+///     has released the current part.
+/// </summary>
+void cloudBlob_Cancel(void);
+
+/// <summary>
+///     True while a worker is uploading a part with iothubClientHandle, the handle must not be
+///     destroyed until it returns false
+/// </summary>
+bool cloudBlob_ClientInUse(void);
+
+void cloudBlob_GetStatus(cloudBlobStatus_t *status);
+
+#endif // ENABLE_BLOB_UPLOAD
+
+#endif // CLOUD_BLOB_H
@@ -13,6 +13,14 @@
 #include <applibs/eventloop.h>
 
 #include "eventloop_timer_utilities.h"
+#include "wakeup_profile.h"
+
+#ifdef ENABLE_WAKEUP_PROFILE
+// The header maps the create functions onto CreateEventLoopNamedTimer(), define the functions
+// themselves below for callers that take their address
+#undef CreateEventLoopPeriodicTimer
+#undef CreateEventLoopDisarmedTimer
+#endif // ENABLE_WAKEUP_PROFILE
 
 static int SetTimerPeriod(int timerFd, const struct timespec *initial,
                           const struct timespec *repeat);
@@ -37,6 +45,9 @@ struct EventLoopTimer {
     EventLoopTimerHandler handler;
     int fd;
     EventRegistration *registration;
+#ifdef ENABLE_WAKEUP_PROFILE
+    wakeupSource_t *profile;
+#endif // ENABLE_WAKEUP_PROFILE
 };
 
 // This satisfies the EventLoopIoCallback signature.
@@ -44,7 +55,15 @@ static void TimerCallback(EventLoop *el, int fd, EventLoop_IoEvents events, void
 {
     EventLoopTimer *timer = (EventLoopTimer *)context;
 
+#ifdef ENABLE_WAKEUP_PROFILE
+    // Copy the profile pointer first, the handler may dispose of the timer
+    wakeupSource_t *profile = timer->profile;
+    uint64_t startUs = wakeupProfile_Begin();
+    timer->handler(timer);
+    wakeupProfile_End(profile, startUs);
+#else
     timer->handler(timer);
+#endif // ENABLE_WAKEUP_PROFILE
 }
 
 EventLoopTimer *CreateEventLoopPeriodicTimer(EventLoop *eventLoop, EventLoopTimerHandler handler,
@@ -66,6 +85,9 @@ EventLoopTimer *CreateEventLoopPeriodicTimer(EventLoop *eventLoop, EventLoopTime
     // Initialize to unused values in case have to clean up partially initialized object.
     timer->fd = -1;
     timer->registration = NULL;
+#ifdef ENABLE_WAKEUP_PROFILE
+    timer->profile = wakeupProfile_Register("unnamedTimer");
+#endif // ENABLE_WAKEUP_PROFILE
 
     timer->fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
     if (timer->fd == -1) {
@@ -96,6 +118,19 @@ EventLoopTimer *CreateEventLoopDisarmedTimer(EventLoop *eventLoop, EventLoopTime
     return CreateEventLoopPeriodicTimer(eventLoop, handler, NULL);
 }
 
+#ifdef ENABLE_WAKEUP_PROFILE
+EventLoopTimer *CreateEventLoopNamedTimer(EventLoop *eventLoop, EventLoopTimerHandler handler,
+                                          const struct timespec *period, const char *name)
+{
+    EventLoopTimer *timer = CreateEventLoopPeriodicTimer(eventLoop, handler, period);
+    if (timer != NULL) {
+        timer->profile = wakeupProfile_Register(name);
+    }
+
+    return timer;
+}
+#endif // ENABLE_WAKEUP_PROFILE
+
 void DisposeEventLoopTimer(EventLoopTimer *timer)
 {
     if (timer == NULL) {
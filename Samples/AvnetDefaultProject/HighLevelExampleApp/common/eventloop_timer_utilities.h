@@ -8,6 +8,8 @@
 
 #include <applibs/eventloop.h>
 
+#include "build_options.h"
+
 /// <summary>
 /// Opaque handle. Obtain via <see cref="CreateEventLoopPeriodicTimer" />
 /// or <see cref="CreateEventLoopDisarmedTimer" /> and dispose of via
@@ -100,3 +102,24 @@ int SetEventLoopTimerOneShot(EventLoopTimer *timer, const struct timespec *delay
 /// <seealso cref="SetEventLoopTimerOneShot" />
 /// <seealso cref="SetEventLoopTimerPeriod" />
 int DisarmEventLoopTimer(EventLoopTimer *timer);
+
+#ifdef ENABLE_WAKEUP_PROFILE
+/// <summary>
+/// Create a timer that is reported under the given name in the wakeup profile. When
+/// ENABLE_WAKEUP_PROFILE is defined <see cref="CreateEventLoopPeriodicTimer" /> and
+/// <see cref="CreateEventLoopDisarmedTimer" /> call this with the handler's name, so every
+/// timer is profiled without changing the callers.
+/// </summary>
+/// <param name="eventLoop">Event loop to which the timer will be added.</param>
+/// <param name="handler">Callback to invoke when the timer expires.</param>
+/// <param name="period">Timer period, or NULL to create a disarmed timer.</param>
+/// <param name="name">Name in the wakeup profile, must remain valid while the timer exists.</param>
+/// <returns>As <see cref="CreateEventLoopPeriodicTimer" />.</returns>
+EventLoopTimer *CreateEventLoopNamedTimer(EventLoop *eventLoop, EventLoopTimerHandler handler,
+                                          const struct timespec *period, const char *name);
+
+#define CreateEventLoopPeriodicTimer(eventLoop, handler, period) \
+    CreateEventLoopNamedTimer(eventLoop, handler, period, #handler)
+#define CreateEventLoopDisarmedTimer(eventLoop, handler) \
+    CreateEventLoopNamedTimer(eventLoop, handler, NULL, #handler)
+#endif // ENABLE_WAKEUP_PROFILE
@@ -105,6 +105,17 @@ typedef enum {
     ExitCode_ReadFile_Read = 71, 
     ExitCode_WriteFile_OpenMutableFile = 72,
     ExitCode_WriteFile_Write = 73,
+    ExitCode_Init_WakeupProfileTimer = 74,
+    ExitCode_WakeupProfileTimer_Consume = 75,
+    ExitCode_Init_WorkQueue = 76,
+    ExitCode_Init_InitSequenceTimer = 77,
+    ExitCode_InitSequenceTimer_Consume = 78,
+    ExitCode_Init_InitSequenceDependency = 79,
+    ExitCode_Init_BlobUploadTimer = 80,
+    ExitCode_BlobUploadTimer_Consume = 81,
+    ExitCode_Init_LiveModeTimer = 82,
+    ExitCode_LiveModeTimer_Consume = 83,
+    ExitCode_Init_TelemetryPipeline = 84,
 
 } ExitCode;
 
@@ -0,0 +1,312 @@
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Dependency ordered initialization
+//
+//  main.c describes each subsystem as a step in a table: an init function, the steps it depends
+//  on, and whether it is optional and/or may run in the background.  initSequence_Run() runs
+//  the foreground steps in table order straight away, so the cloud connection can be started
+//  before the slow peripherals (I2C sensors/OLED, real time cores) are brought up.  The
+//  background steps are then run one per event loop dispatch from a one shot timer, so the
+//  network and cloud handlers keep getting serviced between them.
+//
+//  A step only runs once every step in its dependsOn mask is done.  A foreground step that
+//  depends on a background step waits and runs in the background.  If a dependency failed or
+//  was skipped the step is skipped as well.  An optional step that fails or is skipped is
+//  logged and the application carries on without it, a required step ends the application.
+//
+//  Without ENABLE_ASYNC_INIT every step runs in table order from initSequence_Run() and the
+//  first failure is returned, which is how InitPeripheralsAndHandlers() has always behaved.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <time.h>
+#include <applibs/log.h>
+#include "app_log.h"
+
+#include "init_sequence.h"
+#include "eventloop_timer_utilities.h"
+#include "monotonic_time.h"
+
+static initStep_t *sequence = NULL;
+static int sequenceCount = 0;
+static EventLoop *initEventLoop = NULL;
+static ExitCode_CallbackType failureCallbackFunction = NULL;
+static uint64_t sequenceStartMs = 0;
+
+#ifdef ENABLE_ASYNC_INIT
+static EventLoopTimer *backgroundInitTimer = NULL;
+
+// Gap between background steps, long enough for the event loop to dispatch anything else that
+// is ready before the next step starts
+static const struct timespec backgroundStepDelay = {.tv_sec = 0, .tv_nsec = 1000 * 1000};
+
+static void BackgroundInitTimerEventHandler(EventLoopTimer *timer);
+#endif // ENABLE_ASYNC_INIT
+
+static initStepState DependencyState(const initStep_t *step);
+static ExitCode TryStep(initStep_t *step, bool *stepRan);
+static void LogSummary(void);
+
+ExitCode initSequence_Run(EventLoop *el, initStep_t *steps, int stepCount,
+                          ExitCode_CallbackType failureCallback)
+{
+    sequence = steps;
+    sequenceCount = (stepCount > INIT_SEQUENCE_MAX_STEPS) ? INIT_SEQUENCE_MAX_STEPS : stepCount;
+    initEventLoop = el;
+    failureCallbackFunction = failureCallback;
+    sequenceStartMs = monotonicMs();
+
+    for (int i = 0; i < sequenceCount; i++) {
+        sequence[i].state = INIT_STEP_PENDING;
+        sequence[i].result = ExitCode_Success;
+        sequence[i].durationMs = 0;
+    }
+
+    bool stepRan;
+
+#ifdef ENABLE_ASYNC_INIT
+
+    for (int i = 0; i < sequenceCount; i++) {
+        if (sequence[i].background) {
+            continue;
+        }
+
+        ExitCode result = TryStep(&sequence[i], &stepRan);
+        if (result != ExitCode_Success) {
+            return result;
+        }
+    }
+
+    if (initSequence_IsComplete()) {
+        LogSummary();
+        return ExitCode_Success;
+    }
+
+    LOG_INFO(APP_LOG_CAT_APP, "Init: foreground steps done in %u ms, continuing in the background\n",
+                              (uint32_t)(monotonicMs() - sequenceStartMs));
+
+    backgroundInitTimer = CreateEventLoopDisarmedTimer(initEventLoop, &BackgroundInitTimerEventHandler);
+    if (backgroundInitTimer == NULL) {
+        return ExitCode_Init_InitSequenceTimer;
+    }
+    SetEventLoopTimerOneShot(backgroundInitTimer, &backgroundStepDelay);
+    return ExitCode_Success;
+
+#else // !ENABLE_ASYNC_INIT
+
+    for (int i = 0; i < sequenceCount; i++) {
+        ExitCode result = TryStep(&sequence[i], &stepRan);
+        if (result != ExitCode_Success) {
+            return result;
+        }
+
+        // A step that depends on a later step in the table can never run
+        if (sequence[i].state == INIT_STEP_PENDING) {
+            LOG_ERROR(APP_LOG_CAT_APP, "ERROR: Init step %s depends on a step later in the table\n", sequence[i].name);
+            return ExitCode_Init_InitSequenceDependency;
+        }
+    }
+
+    LogSummary();
+    return ExitCode_Success;
+
+#endif // ENABLE_ASYNC_INIT
+}
+
+bool initSequence_IsComplete(void)
+{
+    for (int i = 0; i < sequenceCount; i++) {
+        if (sequence[i].state == INIT_STEP_PENDING) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void initSequence_Cleanup(void)
+{
+#ifdef ENABLE_ASYNC_INIT
+    DisposeEventLoopTimer(backgroundInitTimer);
+    backgroundInitTimer = NULL;
+#endif // ENABLE_ASYNC_INIT
+}
+
+#ifdef ENABLE_ASYNC_INIT
+/// <summary>
+///     Background init timer: runs the next step that is ready, then re-arms until every step
+///     has run or been skipped
+/// </summary>
+static void BackgroundInitTimerEventHandler(EventLoopTimer *timer)
+{
+    if (ConsumeEventLoopTimerEvent(timer) != 0) {
+        failureCallbackFunction(ExitCode_InitSequenceTimer_Consume);
+        return;
+    }
+
+    bool stepRan = false;
+    bool progress = false;
+
+    // Skipped steps cost nothing, so keep going until one step has actually run
+    for (int i = 0; (i < sequenceCount) && !stepRan; i++) {
+        if (sequence[i].state != INIT_STEP_PENDING) {
+            continue;
+        }
+
+        ExitCode result = TryStep(&sequence[i], &stepRan);
+        if (result != ExitCode_Success) {
+            failureCallbackFunction(result);
+            return;
+        }
+        progress |= (sequence[i].state != INIT_STEP_PENDING);
+    }
+
+    if (!progress && !initSequence_IsComplete()) {
+
+        // Nothing left can run, the remaining steps depend on each other
+        for (int i = 0; i < sequenceCount; i++) {
+            if (sequence[i].state != INIT_STEP_PENDING) {
+                continue;
+            }
+
+            LOG_ERROR(APP_LOG_CAT_APP, "ERROR: Init step %s has a circular dependency\n", sequence[i].name);
+            sequence[i].state = INIT_STEP_SKIPPED;
+            sequence[i].result = ExitCode_Init_InitSequenceDependency;
+            if (!sequence[i].optional) {
+                failureCallbackFunction(ExitCode_Init_InitSequenceDependency);
+                return;
+            }
+        }
+    }
+
+    if (initSequence_IsComplete()) {
+        LogSummary();
+        return;
+    }
+
+    SetEventLoopTimerOneShot(backgroundInitTimer, &backgroundStepDelay);
+}
+#endif // ENABLE_ASYNC_INIT
+
+/// <summary>
+///     Returns INIT_STEP_DONE when every dependency is done, INIT_STEP_SKIPPED when any of them
+///     failed or was skipped, otherwise INIT_STEP_PENDING
+/// </summary>
+static initStepState DependencyState(const initStep_t *step)
+{
+    initStepState dependencyState = INIT_STEP_DONE;
+
+    for (int i = 0; i < sequenceCount; i++) {
+        if ((step->dependsOn & INIT_DEP(i)) == 0) {
+            continue;
+        }
+
+        switch (sequence[i].state) {
+        case INIT_STEP_FAILED:
+        case INIT_STEP_SKIPPED:
+            return INIT_STEP_SKIPPED;
+        case INIT_STEP_PENDING:
+            dependencyState = INIT_STEP_PENDING;
+            break;
+        default:
+            break;
+        }
+    }
+
+    return dependencyState;
+}
+
+/// <summary>
+///     Runs or skips the step if its dependencies allow it.  Returns the exit code to end the
+///     application with, ExitCode_Success if the application can carry on.
+/// </summary>
+static ExitCode TryStep(initStep_t *step, bool *stepRan)
+{
+    *stepRan = false;
+
+    switch (DependencyState(step)) {
+    case INIT_STEP_PENDING:
+        return ExitCode_Success;
+
+    case INIT_STEP_SKIPPED:
+        step->state = INIT_STEP_SKIPPED;
+        step->result = ExitCode_Init_InitSequenceDependency;
+        LOG_WARN(APP_LOG_CAT_APP, "Init: skipping %s, a step it depends on did not complete\n", step->name);
+#ifdef ENABLE_ASYNC_INIT
+        if (step->optional) {
+            return ExitCode_Success;
+        }
+#endif // ENABLE_ASYNC_INIT
+        return step->result;
+
+    default:
+        break;
+    }
+
+    uint64_t startMs = monotonicMs();
+    step->result = step->init(initEventLoop);
+    step->durationMs = (uint32_t)(monotonicMs() - startMs);
+    *stepRan = true;
+
+    if (step->result == ExitCode_Success) {
+        step->state = INIT_STEP_DONE;
+        return ExitCode_Success;
+    }
+
+    step->state = INIT_STEP_FAILED;
+#ifdef ENABLE_ASYNC_INIT
+    if (step->optional) {
+        LOG_WARN(APP_LOG_CAT_APP, "Init: optional step %s failed with exit code %d, continuing without it\n",
+                                  step->name, step->result);
+        return ExitCode_Success;
+    }
+#endif // ENABLE_ASYNC_INIT
+
+    LOG_ERROR(APP_LOG_CAT_APP, "ERROR: Init step %s failed with exit code %d\n", step->name, step->result);
+    return step->result;
+}
+
+static void LogSummary(void)
+{
+    static const char *stateNames[] = {"pending", "done", "failed", "skipped"};
+
+    LOG_INFO(APP_LOG_CAT_APP, "Init: all steps finished in %u ms\n", (uint32_t)(monotonicMs() - sequenceStartMs));
+    for (int i = 0; i < sequenceCount; i++) {
+#ifdef ENABLE_ASYNC_INIT
+        const char *where = sequence[i].background ? " (background)" : "";
+#else
+        const char *where = "";
+#endif // ENABLE_ASYNC_INIT
+        LOG_INFO(APP_LOG_CAT_APP, "Init:   %-16s %-8s %5u ms%s\n", sequence[i].name, stateNames[sequence[i].state],
+                                  sequence[i].durationMs, where);
+    }
+}
+
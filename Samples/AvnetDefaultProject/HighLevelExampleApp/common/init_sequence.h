@@ -0,0 +1,82 @@
+#ifndef INIT_SEQUENCE_H
+#define INIT_SEQUENCE_H
+
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <applibs/eventloop.h>
+#include "build_options.h"
+#include "exitcodes.h"
+
+// Most steps a sequence can hold, one dependsOn bit per step
+#define INIT_SEQUENCE_MAX_STEPS 32
+
+// Builds a dependsOn mask from a step's index in the table
+#define INIT_DEP(stepIndex) (1u << (stepIndex))
+
+typedef ExitCode (*initStepFunction)(EventLoop *el);
+
+typedef enum {
+    INIT_STEP_PENDING,
+    INIT_STEP_DONE,
+    INIT_STEP_FAILED,
+    INIT_STEP_SKIPPED
+} initStepState;
+
+typedef struct {
+    const char *name;
+    initStepFunction init;
+    uint32_t dependsOn;     // INIT_DEP() mask of steps that must be done before this one runs
+    bool optional;          // On failure log it and carry on without this subsystem
+    bool background;        // Run from the event loop after InitPeripheralsAndHandlers() returns
+    initStepState state;
+    ExitCode result;
+    uint32_t durationMs;
+} initStep_t;
+
+/// <summary>
+///     Runs every foreground step in table order and schedules the background steps on the
+///     event loop.  Returns the exit code of the first required foreground step that fails.
+///     A required background step that fails is reported through failureCallback.
+///
+///     When ENABLE_ASYNC_INIT is not defined every step runs here in table order, and any
+///     failure is returned, optional or not.
+/// </summary>
+ExitCode initSequence_Run(EventLoop *el, initStep_t *steps, int stepCount,
+                          ExitCode_CallbackType failureCallback);
+
+/// <summary>
+///     True once no step is left pending
+/// </summary>
+bool initSequence_IsComplete(void);
+
+void initSequence_Cleanup(void);
+
+#endif // INIT_SEQUENCE_H
@@ -0,0 +1,365 @@
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Telemetry key dictionary
+//
+//  Short keys for the telemetry keys of this application and the other Avnet samples.  When
+//  the keyDictionary device twin names one of the dictionaries below every outgoing IoT Hub
+//  telemetry message has its object keys replaced by their short keys, for example
+//
+//      {"wifiRssi":-52,"memoryHighWaterKB":212}  ->  {"wR":-52,"mH":212}
+//
+//  and is sent with the dictionary id in the "kd" message property.  The cloud looks the id up
+//  in its copy of the table and expands the keys again, a message without the property has
+//  full keys.  Keys that are not in the dictionary are sent as they are.  A message is sent
+//  with full keys when
+//
+//      - the device twin is empty (the default) or names a dictionary the device doesn't have
+//      - it has a key that is not in the dictionary but is one of its short keys
+//      - it is longer than KEY_DICTIONARY_BUFFER_SIZE, or nothing in it could be shortened
+//
+//  A published dictionary must never change, the cloud may have messages in flight or in
+//  storage that used it.  To change the keys add a new table with the next id and keep the
+//  old one.  The entries are sorted by key (strcmp() order) for the binary search, the
+//  key_dictionary_bench host tool checks the tables and prints them for the cloud side.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "key_dictionary.h"
+
+#ifdef ENABLE_TELEMETRY_KEY_DICTIONARY
+
+#include <ctype.h>
+#include <string.h>
+
+// Version 1, the DefaultProject telemetry and the AdvancedDemo, RSL10 and Methane click samples
+static const keyDictionaryEntry_t avnetV1[] = {
+    {"DeviceLocation",             "DL"},
+    {"MemoryHighWaterKB",          "MH"},
+    {"MethaneVoltage",             "MV"},
+    {"RSL10Sensors",               "RS"},
+    {"Tracking",                   "Tr"},
+    {"acc_x",                      "ax"},
+    {"acc_y",                      "ay"},
+    {"acc_z",                      "az"},
+    {"address",                    "ad"},
+    {"anomalyChannel",             "aC"},
+    {"anomalyMean",                "aM"},
+    {"anomalySamples",             "aN"},
+    {"anomalyStdDev",              "aS"},
+    {"anomalyValue",               "aV"},
+    {"anomalyZScore",              "aZs"},
+    {"battery",                    "bt"},
+    {"bootAppStartMs",             "bA"},
+    {"bootCloudInitMs",            "bC"},
+    {"bootConnectCompleteMs",      "bCC"},
+    {"bootConnectStartMs",         "bCS"},
+    {"bootDirectMethodsMs",        "bD"},
+    {"bootFirstTelemetryAckMs",    "bFA"},
+    {"bootFirstTelemetryMs",       "bF"},
+    {"bootFirstTwinMs",            "bFT"},
+    {"bootHubAuthenticatedMs",     "bH"},
+    {"bootI2cOledMs",              "bI"},
+    {"bootIoTConnectReadyMs",      "bIC"},
+    {"bootKernelToAppMs",          "bK"},
+    {"bootM4ConnectMs",            "bM"},
+    {"bootNetworkReadyMs",         "bN"},
+    {"bootOtaRegisterMs",          "bO"},
+    {"bootUserInterfaceMs",        "bU"},
+    {"bootWifiConfigMs",           "bW"},
+    {"burstChunk",                 "uC"},
+    {"burstChunks",                "uN"},
+    {"burstFirstSample",           "uF"},
+    {"burstId",                    "uI"},
+    {"burstOdrHz",                 "uO"},
+    {"burstTime",                  "uTm"},
+    {"burstTrigger",               "uT"},
+    {"burstX",                     "uX"},
+    {"burstY",                     "uY"},
+    {"burstZ",                     "uZ"},
+    {"fix_qual",                   "fQ"},
+    {"horiz_dilution",             "hD"},
+    {"humidity",                   "h"},
+    {"light",                      "l"},
+    {"memoryHighWaterKB",          "mH"},
+    {"motionConfidence",           "mC"},
+    {"motionEvent",                "mE"},
+    {"motionPrevious",             "mP"},
+    {"motionPreviousSeconds",      "mPS"},
+    {"motionState",                "mS"},
+    {"motionTransitions",          "mT"},
+    {"numSat",                     "nS"},
+    {"orient_w",                   "ow"},
+    {"orient_x",                   "ox"},
+    {"orient_y",                   "oy"},
+    {"orient_z",                   "oz"},
+    {"otaActualGapSecs",           "oAG"},
+    {"otaMaxDeferalTime",          "oM"},
+    {"otaPredictedGapSecs",        "oPG"},
+    {"otaUpdateDelayPeriod",       "oD"},
+    {"otaUpdateStatus",            "oS"},
+    {"otaUpdateType",              "oT"},
+    {"otaWindowActivity",          "oWA"},
+    {"otaWindowDelay",             "oWD"},
+    {"otaWindowStartUtc",          "oWS"},
+    {"pressure",                   "p"},
+    {"rssi",                       "r"},
+    {"ruleAlert",                  "rA"},
+    {"ruleIndex",                  "rI"},
+    {"sampleKeyFloat",             "sF"},
+    {"sampleKeyInt",               "sI"},
+    {"sampleKeyString",            "sS"},
+    {"summaryChannel",             "sC"},
+    {"summaryCount",               "sN"},
+    {"summaryMax",                 "sMx"},
+    {"summaryMean",                "sM"},
+    {"summaryMin",                 "sMn"},
+    {"summaryStdDev",              "sD"},
+    {"temperature",                "t"},
+    {"wakeupCpuDutyPpm",           "kC"},
+    {"wakeupDispatches",           "kD"},
+    {"wakeupLoopWakes",            "kW"},
+    {"wakeupTopSource",            "kT"},
+    {"wakeupTopSourceDispatches",  "kTD"},
+    {"wifiFrequency",              "wF"},
+    {"wifiRssi",                   "wR"},
+};
+
+const keyDictionary_t keyDictionaries[] = {
+    {"av1", avnetV1, sizeof(avnetV1) / sizeof(avnetV1[0])},
+};
+const size_t keyDictionaryCount = sizeof(keyDictionaries) / sizeof(keyDictionaries[0]);
+
+// Device twin setting
+char keyDictionaryId[KEY_DICTIONARY_ID_MAX_LENGTH] = "";
+
+// The dictionary keyDictionaryId names, NULL to send full keys
+static const keyDictionary_t *activeDictionary = NULL;
+
+static const keyDictionaryEntry_t *FindKey(const keyDictionary_t *dictionary, const char *key, size_t length);
+static bool IsShortKey(const keyDictionary_t *dictionary, const char *key, size_t length);
+
+const char *keyDictionary_Validate(const keyDictionary_t *dictionary)
+{
+    for (size_t i = 0; i < dictionary->entryCount; i++) {
+
+        const keyDictionaryEntry_t *entry = &dictionary->entries[i];
+        size_t shortLength = strlen(entry->shortKey);
+
+        if ((i > 0) && (strcmp(dictionary->entries[i - 1].key, entry->key) >= 0)) {
+            return "entries are not sorted by key";
+        }
+        if ((shortLength == 0) || (shortLength >= strlen(entry->key))) {
+            return "short key is not shorter than its key";
+        }
+        if (shortLength > KEY_DICTIONARY_SHORT_KEY_MAX_LENGTH) {
+            return "short key is longer than KEY_DICTIONARY_SHORT_KEY_MAX_LENGTH";
+        }
+        if (FindKey(dictionary, entry->shortKey, shortLength) != NULL) {
+            return "short key is also a key";
+        }
+        for (size_t j = 0; j < i; j++) {
+            if (strcmp(dictionary->entries[j].shortKey, entry->shortKey) == 0) {
+                return "short key is used twice";
+            }
+        }
+    }
+    return NULL;
+}
+
+size_t keyDictionary_Compact(const keyDictionary_t *dictionary, const char *jsonMessage,
+                             char *out, size_t outSize)
+{
+    const char *next = jsonMessage;
+    size_t used = 0;
+    bool replaced = false;
+
+    while (*next != '\0') {
+
+        // Copy everything outside strings
+        if (*next != '"') {
+            if (used + 1 >= outSize) {
+                return 0;
+            }
+            out[used++] = *next++;
+            continue;
+        }
+
+        const char *text = next + 1;
+        const char *end = text;
+        while ((*end != '\0') && (*end != '"')) {
+            if ((end[0] == '\\') && (end[1] != '\0')) {
+                end++;
+            }
+            end++;
+        }
+        if (*end == '\0') {
+            return 0;
+        }
+        size_t length = (size_t)(end - text);
+        next = end + 1;
+
+        // A string followed by a colon is an object key
+        const char *after = next;
+        while (isspace((unsigned char)*after)) {
+            after++;
+        }
+        if (*after == ':') {
+            const keyDictionaryEntry_t *entry = FindKey(dictionary, text, length);
+            if (entry != NULL) {
+                text = entry->shortKey;
+                length = strlen(entry->shortKey);
+                replaced = true;
+            }
+            else if (IsShortKey(dictionary, text, length)) {
+                return 0;
+            }
+        }
+
+        if (used + length + 2 >= outSize) {
+            return 0;
+        }
+        out[used++] = '"';
+        memcpy(&out[used], text, length);
+        used += length;
+        out[used++] = '"';
+    }
+
+    out[used] = '\0';
+    return replaced ? used : 0;
+}
+
+const char *keyDictionary_CompactMessage(const char *jsonMessage, const char **dictionaryId)
+{
+    static char compactMessage[KEY_DICTIONARY_BUFFER_SIZE];
+
+    if ((activeDictionary == NULL) ||
+        (keyDictionary_Compact(activeDictionary, jsonMessage, compactMessage, sizeof(compactMessage)) == 0)) {
+        return NULL;
+    }
+
+    *dictionaryId = activeDictionary->id;
+    return compactMessage;
+}
+
+#ifdef IOT_HUB_APPLICATION
+#include <applibs/log.h>
+#include "app_log.h"
+#include "../avnet/device_twin.h"
+
+///<summary>
+///		Device twin handler for keyDictionary, the id of the dictionary to send telemetry with.
+///     An empty string sends full keys, an id the device doesn't have is rejected.
+///</summary>
+void setKeyDictionaryFunction(void* thisTwinPtr, JSON_Object *desiredProperties){
+
+    // Declare a local variable to point to the deviceTwin table entry and cast the incomming void* to a twin_t*
+    twin_t *localTwinPtr = (twin_t*)thisTwinPtr;
+
+    const char *newId = json_object_get_string(desiredProperties, localTwinPtr->twinKey);
+    if ((newId == NULL) || (newId[0] == '\0')) {
+        activeDictionary = NULL;
+        keyDictionaryId[0] = '\0';
+        LOG_INFO(APP_LOG_CAT_TWIN, "Received device update. Telemetry is sent with full keys\n");
+    }
+    else {
+        const keyDictionary_t *newDictionary = NULL;
+        for (size_t i = 0; i < keyDictionaryCount; i++) {
+            if (strcmp(keyDictionaries[i].id, newId) == 0) {
+                newDictionary = &keyDictionaries[i];
+            }
+        }
+
+        const char *problem = (newDictionary == NULL) ? "unknown dictionary" : keyDictionary_Validate(newDictionary);
+        if (problem == NULL) {
+            activeDictionary = newDictionary;
+            strcpy(keyDictionaryId, newDictionary->id);
+            LOG_INFO(APP_LOG_CAT_TWIN, "Received device update. Telemetry is sent with the %s key dictionary\n", keyDictionaryId);
+        }
+        else {
+            LOG_WARN(APP_LOG_CAT_TWIN, "Received invalid device update for key %s, %s: %s\n", localTwinPtr->twinKey, problem, newId);
+        }
+    }
+
+    // Report the dictionary in use so the cloud can see a rejected id
+    updateDeviceTwin(true, ARGS_PER_TWIN_ITEM*1, TYPE_STRING, localTwinPtr->twinKey, keyDictionaryId);
+}
+#endif // IOT_HUB_APPLICATION
+
+/// <summary>
+///     Binary search for the entry with the length characters at key as its key
+/// </summary>
+static const keyDictionaryEntry_t *FindKey(const keyDictionary_t *dictionary, const char *key, size_t length)
+{
+    size_t low = 0;
+    size_t high = dictionary->entryCount;
+
+    while (low < high) {
+        size_t middle = low + ((high - low) / 2);
+        const char *entryKey = dictionary->entries[middle].key;
+
+        int compare = strncmp(entryKey, key, length);
+        if ((compare == 0) && (entryKey[length] != '\0')) {
+            compare = 1;
+        }
+
+        if (compare == 0) {
+            return &dictionary->entries[middle];
+        }
+        if (compare < 0) {
+            low = middle + 1;
+        }
+        else {
+            high = middle;
+        }
+    }
+    return NULL;
+}
+
+/// <summary>
+///     True if the length characters at key are one of the dictionary's short keys
+/// </summary>
+static bool IsShortKey(const keyDictionary_t *dictionary, const char *key, size_t length)
+{
+    // Most keys that get here are long, don't scan the table for them
+    if ((length == 0) || (length > KEY_DICTIONARY_SHORT_KEY_MAX_LENGTH)) {
+        return false;
+    }
+
+    for (size_t i = 0; i < dictionary->entryCount; i++) {
+        const char *shortKey = dictionary->entries[i].shortKey;
+        if ((shortKey[0] == key[0]) && (strncmp(shortKey, key, length) == 0) && (shortKey[length] == '\0')) {
+            return true;
+        }
+    }
+    return false;
+}
+
+#endif // ENABLE_TELEMETRY_KEY_DICTIONARY
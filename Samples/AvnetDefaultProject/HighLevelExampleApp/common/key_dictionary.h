@@ -0,0 +1,107 @@
+#ifndef KEY_DICTIONARY_H
+#define KEY_DICTIONARY_H
+
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "build_options.h"
+
+#ifdef ENABLE_TELEMETRY_KEY_DICTIONARY
+
+#if defined(USE_IOT_CONNECT)
+#error "ENABLE_TELEMETRY_KEY_DICTIONARY can't be used with USE_IOT_CONNECT, IoTConnect matches the full keys to the template attributes"
+#endif
+
+// Message property that carries the dictionary id of a message sent with short keys
+#define KEY_DICTIONARY_PROPERTY "kd"
+
+// Longest dictionary id, including the NUL
+#define KEY_DICTIONARY_ID_MAX_LENGTH 8
+
+// Longest short key
+#define KEY_DICTIONARY_SHORT_KEY_MAX_LENGTH 3
+
+// Largest message that is compacted, longer messages are sent with full keys
+#ifndef KEY_DICTIONARY_BUFFER_SIZE
+#define KEY_DICTIONARY_BUFFER_SIZE 1024
+#endif
+
+typedef struct {
+    const char *key;
+    const char *shortKey;
+} keyDictionaryEntry_t;
+
+typedef struct {
+    const char *id;                         // Sent in the KEY_DICTIONARY_PROPERTY message property
+    const keyDictionaryEntry_t *entries;    // Sorted by key
+    size_t entryCount;
+} keyDictionary_t;
+
+// Every published dictionary, the cloud expands short keys with the one named in the message
+extern const keyDictionary_t keyDictionaries[];
+extern const size_t keyDictionaryCount;
+
+/// <summary>
+///     Returns NULL if the dictionary can be used, or what is wrong with it: entries out of
+///     order, a short key that is not shorter than its key or longer than
+///     KEY_DICTIONARY_SHORT_KEY_MAX_LENGTH, or a short key that is also a key or another
+///     entry's short key.
+/// </summary>
+const char *keyDictionary_Validate(const keyDictionary_t *dictionary);
+
+/// <summary>
+///     Copy jsonMessage to out with every object key in the dictionary replaced by its short
+///     key.  Returns the length written, or 0 if the message should be sent with full keys: no
+///     key was replaced, out is too small, or the message has a key that is not in the
+///     dictionary but matches a short key, which the cloud would expand.
+/// </summary>
+size_t keyDictionary_Compact(const keyDictionary_t *dictionary, const char *jsonMessage,
+                             char *out, size_t outSize);
+
+// Device twin setting, the id of the dictionary to send with, empty for full keys
+extern char keyDictionaryId[KEY_DICTIONARY_ID_MAX_LENGTH];
+
+/// <summary>
+///     Compact an outgoing telemetry message with the dictionary the keyDictionary device twin
+///     selected.  Returns the compacted message and sets *dictionaryId, or returns NULL to
+///     send the message as it is.  The message is valid until the next call.
+/// </summary>
+const char *keyDictionary_CompactMessage(const char *jsonMessage, const char **dictionaryId);
+
+#ifdef IOT_HUB_APPLICATION
+#include "parson.h"
+
+// Device twin handler for keyDictionary
+void setKeyDictionaryFunction(void* thisTwinPtr, JSON_Object *desiredProperties);
+#endif // IOT_HUB_APPLICATION
+
+#endif // ENABLE_TELEMETRY_KEY_DICTIONARY
+
+#endif // KEY_DICTIONARY_H
@@ -0,0 +1,408 @@
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Sample to ack latency tracing
+//
+//  Each telemetry message carries the time its sample was taken through the send pipeline
+//
+//  capture  LATENCY_MARK_CAPTURE() when the sample is read.  If no capture was marked the time
+//           Cloud_SendTelemetry() was called is used.
+//  enqueue  LATENCY_MARK_ENQUEUE() after the message is serialized and queued for sending.
+//  handoff  AzureIoT_SendTelemetry() hands the message to IoTHubDeviceClient_LL_SendEventAsync().
+//           The stamp is copied into a record from a fixed pool and the record is passed to the
+//           SDK as the message context.
+//  ack      SendEventCallback() receives the record back, the stage times are added to the
+//           histograms and the record is returned to the pool.
+//
+//  Messages resent from the resend list keep their original capture and enqueue times so the
+//  queue stage includes the time spent waiting for the connection.
+//
+//  Stages are kept as log2 millisecond histograms so percentiles can be computed on the device
+//  without storing samples.  Percentiles are interpolated inside the bucket that holds the
+//  requested rank and clamped to the maximum seen, so they are estimates.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "latency_trace.h"
+#include "monotonic_time.h"
+#include "../avnet/direct_methods.h"
+
+#ifdef ENABLE_LATENCY_TRACE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <applibs/log.h>
+#include "app_log.h"
+
+// Define the traced stages.  X(id, "name")
+#define LATENCY_STAGE_LIST(X) \
+    X(LATENCY_STAGE_BUILD,  "build")  /* capture -> enqueue  */ \
+    X(LATENCY_STAGE_QUEUE,  "queue")  /* enqueue -> handoff  */ \
+    X(LATENCY_STAGE_ACK,    "ack")    /* handoff -> ack      */ \
+    X(LATENCY_STAGE_TOTAL,  "total")  /* capture -> ack      */
+
+#define LATENCY_STAGE_ENUM(id, name) id,
+typedef enum {
+    LATENCY_STAGE_LIST(LATENCY_STAGE_ENUM)
+    LATENCY_STAGE_COUNT
+} latencyStage_t;
+#undef LATENCY_STAGE_ENUM
+
+#define LATENCY_STAGE_NAME(id, name) name,
+static const char *latencyStageNames[LATENCY_STAGE_COUNT] = {
+    LATENCY_STAGE_LIST(LATENCY_STAGE_NAME)
+};
+#undef LATENCY_STAGE_NAME
+
+// Statistics for one stage
+typedef struct {
+    uint32_t count;
+    uint64_t sumUs;
+    uint64_t maxUs;
+    uint32_t bucket[LATENCY_TRACE_BUCKETS];
+} latencyStageStats_t;
+
+// A message that has been handed to the SDK and is waiting for the ack
+typedef struct {
+    void *appContext;
+    latencyStamp_t stamp;
+    uint64_t handoffUs;
+    bool inUse;
+} latencyRecord_t;
+
+static latencyRecord_t recordPool[LATENCY_TRACE_MAX_IN_FLIGHT];
+static latencyStageStats_t stageStats[LATENCY_STAGE_COUNT];
+static latencyStamp_t pendingStamp = {0, 0};
+
+static uint32_t ackedCount = 0;
+static uint32_t failedCount = 0;
+static uint32_t untracedCount = 0;
+static uint32_t inFlightPeak = 0;
+
+static latencyRecord_t *contextToRecord(void *sdkContext);
+static void addSample(latencyStage_t stage, uint64_t startUs, uint64_t endUs);
+static uint64_t stagePercentileUs(const latencyStageStats_t *stats, uint32_t percent);
+
+/// <summary>
+///     Record the time the sample for the next telemetry message was taken
+/// </summary>
+void latencyTrace_MarkCapture(void){
+
+    pendingStamp.captureUs = monotonicUs();
+    pendingStamp.enqueueUs = 0;
+}
+
+/// <summary>
+///     Record the time the next telemetry message was serialized and queued
+/// </summary>
+void latencyTrace_MarkEnqueue(void){
+
+    uint64_t now = monotonicUs();
+
+    if(pendingStamp.captureUs == 0){
+        pendingStamp.captureUs = now;
+    }
+    pendingStamp.enqueueUs = now;
+}
+
+/// <summary>
+///     Forget a marked capture when the message will not be sent
+/// </summary>
+void latencyTrace_DiscardPending(void){
+
+    pendingStamp.captureUs = 0;
+    pendingStamp.enqueueUs = 0;
+}
+
+/// <summary>
+///     Copy the pending stamp without consuming it, used to save the stamp with a resend list node
+/// </summary>
+void latencyTrace_PeekPending(latencyStamp_t *stamp){
+
+    *stamp = pendingStamp;
+}
+
+/// <summary>
+///     Restore a saved stamp before resending a message
+/// </summary>
+void latencyTrace_SetPending(const latencyStamp_t *stamp){
+
+    pendingStamp = *stamp;
+}
+
+/// <summary>
+///     Consume the pending stamp.  Messages sent without a marked capture or enqueue time
+///     (for example telemetry from the real time cores) are stamped with the current time.
+/// </summary>
+void latencyTrace_TakePending(latencyStamp_t *stamp){
+
+    uint64_t now = monotonicUs();
+
+    *stamp = pendingStamp;
+    if(stamp->captureUs == 0){
+        stamp->captureUs = now;
+    }
+    if(stamp->enqueueUs == 0){
+        stamp->enqueueUs = now;
+    }
+
+    latencyTrace_DiscardPending();
+}
+
+/// <summary>
+///     Return the age of a sample in milliseconds
+/// </summary>
+uint32_t latencyTrace_AgeMs(const latencyStamp_t *stamp){
+
+    return (uint32_t)((monotonicUs() - stamp->captureUs) / 1000);
+}
+
+/// <summary>
+///     Take a record from the pool for a message that is being handed to the SDK.  Returns the
+///     context to pass to the SDK, this is appContext if the pool is exhausted.
+/// </summary>
+void *latencyTrace_Submit(const latencyStamp_t *stamp, void *appContext){
+
+    uint32_t inFlight = 0;
+    latencyRecord_t *freeRecord = NULL;
+
+    for(int i = 0; i < LATENCY_TRACE_MAX_IN_FLIGHT; i++){
+        if(recordPool[i].inUse){
+            inFlight++;
+        }
+        else if(freeRecord == NULL){
+            freeRecord = &recordPool[i];
+        }
+    }
+
+    if(freeRecord == NULL){
+        untracedCount++;
+        return appContext;
+    }
+
+    freeRecord->appContext = appContext;
+    freeRecord->stamp = *stamp;
+    freeRecord->handoffUs = monotonicUs();
+    freeRecord->inUse = true;
+
+    if(++inFlight > inFlightPeak){
+        inFlightPeak = inFlight;
+    }
+
+    return freeRecord;
+}
+
+/// <summary>
+///     Return a record to the pool without recording it, used when the SDK rejects the message.
+///     Returns the application context.
+/// </summary>
+void *latencyTrace_Release(void *sdkContext){
+
+    latencyRecord_t *record = contextToRecord(sdkContext);
+    if(record == NULL){
+        return sdkContext;
+    }
+
+    record->inUse = false;
+    return record->appContext;
+}
+
+/// <summary>
+///     Called from the send event callback.  Adds the stage times to the histograms, returns
+///     the record to the pool and returns the application context.
+/// </summary>
+void *latencyTrace_Complete(void *sdkContext, bool success){
+
+    latencyRecord_t *record = contextToRecord(sdkContext);
+    if(record == NULL){
+        return sdkContext;
+    }
+
+    if(success){
+
+        uint64_t ackUs = monotonicUs();
+
+        addSample(LATENCY_STAGE_BUILD, record->stamp.captureUs, record->stamp.enqueueUs);
+        addSample(LATENCY_STAGE_QUEUE, record->stamp.enqueueUs, record->handoffUs);
+        addSample(LATENCY_STAGE_ACK, record->handoffUs, ackUs);
+        addSample(LATENCY_STAGE_TOTAL, record->stamp.captureUs, ackUs);
+        ackedCount++;
+    }
+    else{
+        failedCount++;
+    }
+
+    record->inUse = false;
+    return record->appContext;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+//
+//  Functions for getLatencyStats directMethod
+//
+//  name: getLatencyStats
+//  Payload: {}, or {"reset": true}
+//
+//  Returns count, mean, p50, p90, p99 and max in microseconds for each stage
+//
+//////////////////////////////////////////////////////////////////////////////////////
+
+int dmGetLatencyStatsHandlerFunction(JSON_Object *JsonPayloadObj, size_t payloadSize, char** responseMsg){
+
+    JSON_Value *rootValue = json_value_init_object();
+    JSON_Object *rootObject = json_value_get_object(rootValue);
+    char keyBuffer[64];
+
+    uint32_t inFlight = 0;
+    for(int i = 0; i < LATENCY_TRACE_MAX_IN_FLIGHT; i++){
+        if(recordPool[i].inUse){
+            inFlight++;
+        }
+    }
+
+    json_object_dotset_number(rootObject, "acked", ackedCount);
+    json_object_dotset_number(rootObject, "failed", failedCount);
+    json_object_dotset_number(rootObject, "untraced", untracedCount);
+    json_object_dotset_number(rootObject, "inFlight", inFlight);
+    json_object_dotset_number(rootObject, "inFlightPeak", inFlightPeak);
+
+    for(int i = 0; i < LATENCY_STAGE_COUNT; i++){
+
+        latencyStageStats_t *stats = &stageStats[i];
+        uint64_t meanUs = (stats->count == 0) ? 0 : stats->sumUs / stats->count;
+
+        snprintf(keyBuffer, sizeof(keyBuffer), "stages.%s.count", latencyStageNames[i]);
+        json_object_dotset_number(rootObject, keyBuffer, stats->count);
+        snprintf(keyBuffer, sizeof(keyBuffer), "stages.%s.meanUs", latencyStageNames[i]);
+        json_object_dotset_number(rootObject, keyBuffer, (double)meanUs);
+        snprintf(keyBuffer, sizeof(keyBuffer), "stages.%s.p50Us", latencyStageNames[i]);
+        json_object_dotset_number(rootObject, keyBuffer, (double)stagePercentileUs(stats, 50));
+        snprintf(keyBuffer, sizeof(keyBuffer), "stages.%s.p90Us", latencyStageNames[i]);
+        json_object_dotset_number(rootObject, keyBuffer, (double)stagePercentileUs(stats, 90));
+        snprintf(keyBuffer, sizeof(keyBuffer), "stages.%s.p99Us", latencyStageNames[i]);
+        json_object_dotset_number(rootObject, keyBuffer, (double)stagePercentileUs(stats, 99));
+        snprintf(keyBuffer, sizeof(keyBuffer), "stages.%s.maxUs", latencyStageNames[i]);
+        json_object_dotset_number(rootObject, keyBuffer, (double)stats->maxUs);
+    }
+
+    *responseMsg = dmSerializeResponse(rootValue);
+
+    // Reset the statistics if requested, records in flight are left alone
+    if((JsonPayloadObj != NULL) && (json_object_get_boolean(JsonPayloadObj, "reset") == 1)){
+
+        memset(stageStats, 0, sizeof(stageStats));
+        ackedCount = 0;
+        failedCount = 0;
+        untracedCount = 0;
+        inFlightPeak = inFlight;
+    }
+
+    if(*responseMsg == NULL){
+        LOG_ERROR(APP_LOG_CAT_DM, "ERROR: Could not allocate latency stats response\n");
+        return 400;
+    }
+
+    return 200;
+}
+
+/// <summary>
+///     Return the pool record for an SDK context, or NULL if the message was not traced
+/// </summary>
+static latencyRecord_t *contextToRecord(void *sdkContext){
+
+    uintptr_t address = (uintptr_t)sdkContext;
+    uintptr_t poolStart = (uintptr_t)&recordPool[0];
+    uintptr_t poolEnd = (uintptr_t)&recordPool[LATENCY_TRACE_MAX_IN_FLIGHT];
+
+    if((address < poolStart) || (address >= poolEnd) || (((address - poolStart) % sizeof(latencyRecord_t)) != 0)){
+        return NULL;
+    }
+
+    latencyRecord_t *record = (latencyRecord_t *)sdkContext;
+    return record->inUse ? record : NULL;
+}
+
+/// <summary>
+///     Add one sample to a stage
+/// </summary>
+static void addSample(latencyStage_t stage, uint64_t startUs, uint64_t endUs){
+
+    latencyStageStats_t *stats = &stageStats[stage];
+    uint64_t elapsedUs = (endUs > startUs) ? (endUs - startUs) : 0;
+    uint64_t elapsedMs = elapsedUs / 1000;
+
+    int bucket = 0;
+    while((elapsedMs > 0) && (bucket < LATENCY_TRACE_BUCKETS - 1)){
+        elapsedMs >>= 1;
+        bucket++;
+    }
+
+    stats->bucket[bucket]++;
+    stats->count++;
+    stats->sumUs += elapsedUs;
+    if(elapsedUs > stats->maxUs){
+        stats->maxUs = elapsedUs;
+    }
+}
+
+/// <summary>
+///     Estimate a percentile by interpolating inside the bucket that holds it, clamped to the max
+/// </summary>
+static uint64_t stagePercentileUs(const latencyStageStats_t *stats, uint32_t percent){
+
+    if(stats->count == 0){
+        return 0;
+    }
+
+    // Rank of the requested sample, 1 based
+    uint32_t rank = (uint32_t)(((uint64_t)stats->count * percent + 99) / 100);
+    uint32_t seen = 0;
+
+    for(int i = 0; i < LATENCY_TRACE_BUCKETS; i++){
+
+        if((stats->bucket[i] != 0) && (seen + stats->bucket[i] >= rank)){
+
+            // Bucket 0 holds < 1ms, bucket i holds [2^(i-1), 2^i) ms
+            uint64_t lowerUs = (i == 0) ? 0 : ((uint64_t)1 << (i - 1)) * 1000;
+            uint64_t upperUs = ((uint64_t)1 << i) * 1000;
+            uint64_t estimateUs = lowerUs + ((upperUs - lowerUs) * (rank - seen)) / stats->bucket[i];
+
+            return (estimateUs < stats->maxUs) ? estimateUs : stats->maxUs;
+        }
+        seen += stats->bucket[i];
+    }
+
+    return stats->maxUs;
+}
+
+#endif // ENABLE_LATENCY_TRACE
@@ -0,0 +1,82 @@
+#ifndef LATENCY_TRACE_H
+#define LATENCY_TRACE_H
+
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "build_options.h"
+
+// Number of telemetry messages that can be traced while waiting for the IoT Hub ack.  Messages
+// sent while every record is in use are sent untraced and counted in "untraced".
+#ifndef LATENCY_TRACE_MAX_IN_FLIGHT
+#define LATENCY_TRACE_MAX_IN_FLIGHT 32
+#endif
+
+// Histogram buckets: <1ms, <2ms, <4ms ... <2^(n-2)ms, and everything longer
+#define LATENCY_TRACE_BUCKETS 20
+
+// Timestamps that travel with a telemetry message until it is handed to the Azure IoT SDK.
+// Times are CLOCK_MONOTONIC in microseconds.
+typedef struct {
+    uint64_t captureUs;     // The sample was taken
+    uint64_t enqueueUs;     // The message was serialized and queued for sending
+} latencyStamp_t;
+
+#ifdef ENABLE_LATENCY_TRACE
+
+#include "parson.h"
+
+void latencyTrace_MarkCapture(void);
+void latencyTrace_MarkEnqueue(void);
+void latencyTrace_DiscardPending(void);
+void latencyTrace_PeekPending(latencyStamp_t *stamp);
+void latencyTrace_SetPending(const latencyStamp_t *stamp);
+void latencyTrace_TakePending(latencyStamp_t *stamp);
+uint32_t latencyTrace_AgeMs(const latencyStamp_t *stamp);
+void *latencyTrace_Submit(const latencyStamp_t *stamp, void *appContext);
+void *latencyTrace_Release(void *sdkContext);
+void *latencyTrace_Complete(void *sdkContext, bool success);
+
+// Direct method handler
+int dmGetLatencyStatsHandlerFunction(JSON_Object *JsonPayloadObj, size_t payloadSize, char** responsePayload);
+
+#define LATENCY_MARK_CAPTURE() latencyTrace_MarkCapture()
+#define LATENCY_MARK_ENQUEUE() latencyTrace_MarkEnqueue()
+#define LATENCY_DISCARD_PENDING() latencyTrace_DiscardPending()
+
+#else
+
+#define LATENCY_MARK_CAPTURE()
+#define LATENCY_MARK_ENQUEUE()
+#define LATENCY_DISCARD_PENDING()
+
+#endif // ENABLE_LATENCY_TRACE
+
+#endif // LATENCY_TRACE_H
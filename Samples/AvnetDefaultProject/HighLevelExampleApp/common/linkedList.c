@@ -31,6 +31,7 @@ SOFTWARE.
 /* Doubly Linked List implementation */
 
 #include "linkedList.h"
+#include "../avnet/mem_accounting.h"
 
 #if defined(IOT_HUB_APPLICATION) && defined(ENABLE_TELEMETRY_RESEND_LOGIC)    
 
@@ -44,17 +45,23 @@ telemetryNode_t* GetNewNode(const char* telemetryJson, size_t stringLen) {
 
 	int nodeSize = sizeof(telemetryNode_t) + stringLen + 1;
 
-	telemetryNode_t* newNode = (telemetryNode_t*)malloc(nodeSize);
+	telemetryNode_t* newNode = (telemetryNode_t*)APP_MALLOC(MEM_TAG_RESEND_LIST, nodeSize);
 
 	// Verify we were able to allocate memory for the new node, if not
 	// then set exitCode to reflect the erro.  The main loop will see this
 	// change and exit.
 	if(newNode == NULL){
 		exitCode = ExitCode_AddTelemetry_Malloc_Failed;
+		return NULL;
 	}
 
-	newNode->prev = NULL;
-	newNode->next = NULL;
+	// Start from a clean node, every field not set below is zero
+	memset(newNode, 0, sizeof(telemetryNode_t));
+#ifdef ENABLE_OFFLINE_BACKLOG
+	newNode->firstTime = time(NULL);
+	newNode->lastTime = newNode->firstTime;
+	newNode->messageCount = 1;
+#endif // ENABLE_OFFLINE_BACKLOG
 	strncpy (newNode->telemetryJson, telemetryJson, stringLen);
 	newNode->telemetryJson[stringLen] = '\0';
 	return newNode;
@@ -63,6 +70,9 @@ telemetryNode_t* GetNewNode(const char* telemetryJson, size_t stringLen) {
 //Inserts a Node at head of doubly linked list
 telemetryNode_t* InsertAtHead(char* x, int stringLen) {
 	telemetryNode_t* newNode = GetNewNode(x, stringLen);
+	if(newNode == NULL) {
+		return NULL;
+	}
 	if(head == NULL) {
 		head = newNode;
 		return head;
@@ -79,6 +89,9 @@ telemetryNode_t* InsertAtHead(char* x, int stringLen) {
 telemetryNode_t* InsertAtTail(char* x, int stringLen) {
 	telemetryNode_t* temp = head;
 	telemetryNode_t* newNode = GetNewNode(x, stringLen);
+	if(newNode == NULL) {
+		return NULL;
+	}
 	if(head == NULL) {
 		head = newNode;
 		return head;
@@ -89,6 +102,24 @@ telemetryNode_t* InsertAtTail(char* x, int stringLen) {
 	return newNode;
 }
 
+//Inserts a Node in front of nextNode, which must be in the list
+telemetryNode_t* InsertBefore(telemetryNode_t* nextNode, char* x, int stringLen) {
+	telemetryNode_t* newNode = GetNewNode(x, stringLen);
+	if(newNode == NULL) {
+		return NULL;
+	}
+	newNode->next = nextNode;
+	newNode->prev = nextNode->prev;
+	if(nextNode->prev == NULL) {
+		head = newNode;
+	}
+	else {
+		nextNode->prev->next = newNode;
+	}
+	nextNode->prev = newNode;
+	return newNode;
+}
+
 // Remove a Node from the list
 bool DeleteNode(telemetryNode_t* nodeToRemove){
 
@@ -121,7 +152,7 @@ bool DeleteNode(telemetryNode_t* nodeToRemove){
 
             // We just found the Node to remove and reset pointers in the 
             // rest of the list to orphan this node, zap it and return true.
-			free(temp);
+			APP_FREE(temp);
             return true;
 
         }
@@ -131,6 +162,17 @@ bool DeleteNode(telemetryNode_t* nodeToRemove){
     return false;
 }
 
+// Return true if nodeToFind is in the list, the node itself is not dereferenced
+bool IsNodeInList(const telemetryNode_t* nodeToFind){
+
+	for(telemetryNode_t* temp = head; temp != NULL; temp = temp->next) {
+		if(temp == nodeToFind){
+			return true;
+		}
+	}
+	return false;
+}
+
 //Prints all the elements in linked list in forward traversal order
 void Print() {
 	telemetryNode_t* temp = head;
@@ -163,6 +205,18 @@ void ReversePrint() {
 	Log_Debug("\n");
 }
 
+// Return the number of nodes in the list
+int GetListLength(void){
+
+	int length = 0;
+	telemetryNode_t* temp = head;
+	while(temp != NULL) {
+		length++;
+		temp = temp->next;
+	}
+	return length;
+}
+
 // Remove all the nodes in the list
 void DeleteEntireList(void){
 
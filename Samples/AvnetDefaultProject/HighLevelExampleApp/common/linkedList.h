@@ -32,10 +32,13 @@ SOFTWARE.
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
 #include <applibs/log.h>
 #include "../common/exitcodes.h"
 #include "signal.h"
 #include "build_options.h"
+#include "latency_trace.h"
 
 #if defined(IOT_HUB_APPLICATION) && defined(ENABLE_TELEMETRY_RESEND_LOGIC)    
 
@@ -45,6 +48,17 @@ extern volatile sig_atomic_t exitCode;
 typedef struct telemetryNode {
 	struct telemetryNode* next;
 	struct telemetryNode* prev;
+#ifdef ENABLE_LATENCY_TRACE
+	latencyStamp_t latencyStamp; // Capture and enqueue times of the original send
+#endif // ENABLE_LATENCY_TRACE
+#ifdef ENABLE_OFFLINE_BACKLOG
+	time_t firstTime;       // Wall clock time of the oldest message this node covers
+	time_t lastTime;        // Wall clock time of the newest message this node covers
+	uint32_t messageCount;  // Telemetry messages folded into this node
+	uint8_t level;          // 0 for a message as sent, n for a summary of level n-1 nodes
+	uint8_t sendsPending;   // Sends accepted by the IoT Hub SDK and not yet called back
+	bool delivered;         // A send succeeded, the node is freed when sendsPending reaches 0
+#endif // ENABLE_OFFLINE_BACKLOG
 	char telemetryJson[]; // Dynamic array to hold the telemetry message text
 } telemetryNode_t;
 
@@ -54,8 +68,11 @@ void InitLinkedList(void);
 telemetryNode_t* GetNewNode(const char* telemetryJson, size_t stringLen);
 telemetryNode_t* InsertAtHead(char* x, int stringLen);
 telemetryNode_t* InsertAtTail(char* x, int stringLen);
+telemetryNode_t* InsertBefore(telemetryNode_t* nextNode, char* x, int stringLen);
 bool DeleteNode(telemetryNode_t* nodeToRemove);
+bool IsNodeInList(const telemetryNode_t* nodeToFind);
 void DeleteEntireList(void);
+int GetListLength(void);
 void Print(void);
 void ReversePrint(void);
 #endif // defined(IOT_HUB_APPLICATION) && defined(ENABLE_TELEMETRY_RESEND_LOGIC)    
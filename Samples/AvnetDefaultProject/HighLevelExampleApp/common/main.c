@@ -69,6 +69,23 @@ SOFTWARE.
 #include "../avnet/direct_methods.h"
 #include "../avnet/oled.h"
 #include "../avnet/iotConnect.h"
+#include "../avnet/mem_accounting.h"
+#include "trace_ring.h"
+#include "latency_trace.h"
+#include "boot_timeline.h"
+#include "wakeup_profile.h"
+#include "work_queue.h"
+#include "init_sequence.h"
+#include "../avnet/sensor_registry.h"
+#include "../avnet/rules_engine.h"
+#include "../avnet/live_mode.h"
+#include "anomaly_detector.h"
+#include "timeseries_store.h"
+#include "offline_backlog.h"
+#include "telemetry_pipeline.h"
+#include "adaptive_period.h"
+#include "sample_observer.h"
+#include "schema_keys.h"
 #ifdef DEFER_OTA_UPDATES
 #include "../avnet/deferred_updates.h"
 #endif 
@@ -109,7 +126,9 @@ static bool isConnected = false;
 
 // Avnet additions
 static void ReadWifiConfig(bool);
+#ifndef ENABLE_SENSOR_REGISTRY
 static void ReadSensorTimerEventHandler(EventLoopTimer *timer);
+#endif // !ENABLE_SENSOR_REGISTRY
 
 // Variable used to update sensorPollTimer
 int readSensorPeriod = SENSOR_READ_PERIOD_SECONDS;
@@ -117,6 +136,50 @@ int readSensorPeriod = SENSOR_READ_PERIOD_SECONDS;
 // Global variable to hold wifi network configuration data
 network_var network_data;
 
+#ifdef ENABLE_TELEMETRY_PIPELINE
+// Telemetry pipelines, see common/telemetry_pipeline.h.  Each pipeline is put together from
+// stage structs, change the encoder or sink initializer to change how its samples are sent.
+
+// Routine sensor telemetry: the latest reading of each channel, sent once per telemetry period.
+// Channels that stay within 1 unit (dBm, MHz, KiB) of the last reading passed aren't sent.
+static pipelineDeadband_t sensorDeadband = {.deadband = 1.0f};
+static pipelineFilter_t sensorFilters[] = {PIPELINE_DEADBAND_FILTER(&sensorDeadband)};
+static pipelineReduce_t sensorLatest = {.mode = PIPELINE_REDUCE_LATEST};
+static pipeline_t sensorPipeline = {
+    .name = "sensors",
+    .filters = sensorFilters,
+    .filterCount = sizeof(sensorFilters) / sizeof(pipelineFilter_t),
+    .aggregate = PIPELINE_REDUCE_STAGE(&sensorLatest),
+    .encoder = PIPELINE_JSON_ENCODER,
+#if defined(USE_IOT_CONNECT)
+    .sink = PIPELINE_IOT_CONNECT_SINK,
+#elif defined(IOT_HUB_APPLICATION)
+    .sink = PIPELINE_IOT_HUB_SINK,
+#else
+    .sink = PIPELINE_LOG_SINK,
+#endif // USE_IOT_CONNECT
+};
+
+#ifdef TELEMETRY_PIPELINE_UART
+// Every sample, batched and binary encoded, to a local UART
+static pipelineBatch_t uartBatch;
+static pipelineUartSink_t uartSink = {.uartId = TELEMETRY_PIPELINE_UART};
+static pipeline_t uartPipeline = {
+    .name = "uart",
+    .aggregate = PIPELINE_BATCH_STAGE(&uartBatch),
+    .encoder = PIPELINE_BINARY_ENCODER,
+    .sink = PIPELINE_UART_SINK(&uartSink),
+};
+#endif // TELEMETRY_PIPELINE_UART
+
+static pipeline_t *pipelineTable[] = {
+    &sensorPipeline,
+#ifdef TELEMETRY_PIPELINE_UART
+    &uartPipeline,
+#endif // TELEMETRY_PIPELINE_UART
+};
+#endif // ENABLE_TELEMETRY_PIPELINE
+
 /// <summary>
 ///     Signal handler for termination requests. This handler must be async-signal-safe.
 /// </summary>
@@ -132,9 +195,16 @@ static void TerminationHandler(int signalNumber)
 int main(int argc, char *argv[])
 {
     Log_Debug("Avnet Default Application starting.\n");
+    BOOT_MARK(BOOT_PHASE_APP_START);
+
+#ifdef ENABLE_HEAP_ACCOUNTING
+    // Install the heap accounting allocators before anything allocates JSON data
+    memAcct_Init();
+#endif // ENABLE_HEAP_ACCOUNTING
 
     // Read the current wifi configuration, output debug
     ReadWifiConfig(true);
+    BOOT_MARK(BOOT_PHASE_WIFI_CONFIG);
 
 #ifdef IOT_HUB_APPLICATION
     bool isNetworkingReady = false;
@@ -153,6 +223,7 @@ int main(int argc, char *argv[])
     // Main loop
     while (exitCode == ExitCode_Success) {
         EventLoop_Run_Result result = EventLoop_Run(eventLoop, -1, true);
+        WAKEUP_PROFILE_LOOP_WAKE();
         // Continue if interrupted by signal, e.g. due to breakpoint being set.
         if (result == EventLoop_Run_Failed && errno != EINTR) {
             exitCode = ExitCode_Main_EventLoopFail;
@@ -171,6 +242,13 @@ int main(int argc, char *argv[])
     }
 #endif // DEFER_OTA_UPDATES
 
+#ifdef ENABLE_TRACE_RING
+    // Capture the events leading up to the failure
+    if ((exitCode != ExitCode_Success) && (exitCode != ExitCode_TermHandler_SigTerm)) {
+        traceRing_DumpToLog();
+    }
+#endif // ENABLE_TRACE_RING
+
     Log_Debug("Application exiting.\n");
 
     return exitCode;
@@ -221,10 +299,9 @@ static void ConnectionChangedCallbackHandler(bool connected)
 
         // Send up device and application details as read only device twin updates.  These constants
         // are defined in the build_options.h file
-        Cloud_Result result =  updateDeviceTwin(false, ARGS_PER_TWIN_ITEM*3, 
-                                                                TYPE_STRING, "versionString", VERSION_STRING, 
-                                                                TYPE_STRING, "manufacturer", DEVICE_MFG,
-                                                                TYPE_STRING, "model", DEVICE_MODEL);
+        Cloud_Result result = SCHEMA_UPDATE_DEVICE_TWIN(false, SCHEMA_PROPERTY(versionString, VERSION_STRING),
+                                                               SCHEMA_PROPERTY(manufacturer, DEVICE_MFG),
+                                                               SCHEMA_PROPERTY(model, DEVICE_MODEL));
         if (result != Cloud_Result_OK) {
             Log_Debug("WARNING: Could not send device details to cloud: %s\n",
                       CloudResultToString(result));
@@ -239,8 +316,21 @@ static void ConnectionChangedCallbackHandler(bool connected)
 
             do{
                 
+#ifdef ENABLE_OFFLINE_BACKLOG
+                // Skip nodes that were delivered and are only waiting for the SDK to call back
+                if(!backlog_CanResend(currentNode)){
+                    currentNode = currentNode->next;
+                    continue;
+                }
+#endif // ENABLE_OFFLINE_BACKLOG
+
                 Log_Debug("Attempting to resend telemetry after reconnect!\n");
 
+#ifdef ENABLE_LATENCY_TRACE
+                // Report the resent message against the time its sample was taken
+                latencyTrace_SetPending(&currentNode->latencyStamp);
+#endif // ENABLE_LATENCY_TRACE
+
                 // Attempt to send the message again using the same linked list node
                 AzureIoT_Result aziotResult = AzureIoT_SendTelemetry(currentNode->telemetryJson, currentNode);
                 Cloud_Result result = AzureIoTToCloudResult(aziotResult);
@@ -250,6 +340,10 @@ static void ConnectionChangedCallbackHandler(bool connected)
                     Log_Debug("WARNING: Could not send telemetry to cloud: %s.\n", CloudResultToString(result));
                 }
 
+#ifdef ENABLE_OFFLINE_BACKLOG
+                backlog_SendAttempted(currentNode, result == Cloud_Result_OK);
+#endif // ENABLE_OFFLINE_BACKLOG
+
                 // Move the pointer to the next item in the list
                 currentNode = currentNode->next;
 
@@ -274,30 +368,39 @@ static void ConnectionChangedCallbackHandler(bool connected)
         // Read the current wifi configuration
         ReadWifiConfig(true);        
     }
+
+#ifdef ENABLE_OFFLINE_BACKLOG
+    // Slow down or restore sampling, any held telemetry was resent above
+    backlog_ConnectionChanged(connected);
+#endif // ENABLE_OFFLINE_BACKLOG
 }
 #endif // IOT_HUB_APPLICATION
 
 /// <summary>
-///     Set up SIGTERM termination handler, initialize peripherals, and set up event handlers.
+///     Init steps for InitPeripheralsAndHandlers(), see init_sequence.c.  Each step is a subsystem
+///     with the steps it needs done first.  Without ENABLE_ASYNC_INIT they run in table order.
 /// </summary>
-/// <returns>
-///     ExitCode_Success if all resources were allocated successfully; otherwise another
-///     ExitCode value which indicates the specific failure.
-/// </returns>
-static ExitCode InitPeripheralsAndHandlers(void)
-{
-    struct sigaction action;
-    memset(&action, 0, sizeof(struct sigaction));
-    action.sa_handler = TerminationHandler;
-    sigaction(SIGTERM, &action, NULL);
-
-    eventLoop = EventLoop_Create();
-    if (eventLoop == NULL) {
-        Log_Debug("Could not create event loop.\n");
-        return ExitCode_Init_EventLoop;
-    }
+typedef enum {
+#ifdef IOT_HUB_APPLICATION
+    INIT_DIRECT_METHODS,
+#endif // IOT_HUB_APPLICATION
+#ifdef M4_INTERCORE_COMMS
+    INIT_M4,
+#endif // M4_INTERCORE_COMMS
+    INIT_USER_INTERFACE,
+    INIT_SENSOR_TIMER,
+#ifdef DEFER_OTA_UPDATES
+    INIT_DEFERRED_OTA,
+#endif // DEFER_OTA_UPDATES
+#ifdef IOT_HUB_APPLICATION
+    INIT_CLOUD,
+#endif // IOT_HUB_APPLICATION
+    INIT_STEP_COUNT
+} appInitStep;
 
 #ifdef IOT_HUB_APPLICATION
+static ExitCode InitDirectMethodsStep(EventLoop *el)
+{
     // Iterate across all the device twin items and open any File Descriptors
     deviceTwinOpenFDs();
 
@@ -307,55 +410,160 @@ static ExitCode InitPeripheralsAndHandlers(void)
     if ( result != ExitCode_Success){
         return result;
     }
-
+    BOOT_MARK(BOOT_PHASE_DIRECT_METHODS);
+    return ExitCode_Success;
+}
 #endif // IOT_HUB_APPLICATION
 
 #ifdef M4_INTERCORE_COMMS
+static ExitCode InitM4Step(EventLoop *el)
+{
     // Iterate across all Real time application init routines.  Each real time application
     // can implement its own specific routine
     ExitCode m4ReturnStatus = InitM4Interfaces();
     if (m4ReturnStatus != ExitCode_Success){
         return m4ReturnStatus;
     }
-#endif
+    BOOT_MARK(BOOT_PHASE_M4_CONNECT);
+    return ExitCode_Success;
+}
+#endif // M4_INTERCORE_COMMS
 
+static ExitCode InitUserInterfaceStep(EventLoop *el)
+{
     // Initialize the button user interface
 #ifdef GUARDIAN_100
     ExitCode interfaceExitCode =
-        UserInterface_Initialise(eventLoop, NULL, ExitCodeCallbackHandler);
+        UserInterface_Initialise(el, NULL, ExitCodeCallbackHandler);
 #else // !GUARDIAN_100    
     ExitCode interfaceExitCode =
-        UserInterface_Initialise(eventLoop, ButtonPressedCallbackHandler, ExitCodeCallbackHandler);
+        UserInterface_Initialise(el, ButtonPressedCallbackHandler, ExitCodeCallbackHandler);
 #endif // GUARDIAN_100    
 
     if (interfaceExitCode != ExitCode_Success) {
         return interfaceExitCode;
     }
+    BOOT_MARK(BOOT_PHASE_USER_INTERFACE);
+    return ExitCode_Success;
+}
 
+static ExitCode InitSensorTimerStep(EventLoop *el)
+{
+#ifdef ENABLE_SENSOR_REGISTRY
+    // Each sensor in sensorArray[] is read at its own period from one timer
+    ExitCode registryExitCode = sensorRegistry_Init(el);
+#ifdef ENABLE_LIVE_MODE
+    if (registryExitCode == ExitCode_Success) {
+        registryExitCode = liveMode_Init(el);
+    }
+#endif // ENABLE_LIVE_MODE
+    return registryExitCode;
+#else
     // Set up a timer to poll the sensors.  SENSOR_READ_PERIOD_SECONDS is defined in build_options.h
     static const struct timespec readSensorPeriod = {.tv_sec = SENSOR_READ_PERIOD_SECONDS,
                                                      .tv_nsec = SENSOR_READ_PERIOD_NANO_SECONDS};
-    sensorPollTimer = CreateEventLoopPeriodicTimer(eventLoop, &ReadSensorTimerEventHandler, &readSensorPeriod);
+    sensorPollTimer = CreateEventLoopPeriodicTimer(el, &ReadSensorTimerEventHandler, &readSensorPeriod);
     if (sensorPollTimer == NULL) {
         return ExitCode_Init_sensorPollTimer;
     }
+    return ExitCode_Success;
+#endif // ENABLE_SENSOR_REGISTRY
+}
 
 #ifdef DEFER_OTA_UPDATES
+static ExitCode InitDeferredOtaStep(EventLoop *el)
+{
     // Initialize the deferred OTA Update logic/resources
     ExitCode DeferredUpdateInitExitCode = deferredOtaUpdate_Init();
     if (DeferredUpdateInitExitCode != ExitCode_Success) {
         return DeferredUpdateInitExitCode;
     }
+    BOOT_MARK(BOOT_PHASE_OTA_REGISTER);
+    return ExitCode_Success;
+}
 #endif // DEFER_OTA_UPDATES
 
 #ifdef IOT_HUB_APPLICATION    
+static ExitCode InitCloudStep(EventLoop *el)
+{
     void *connectionContext = Options_GetConnectionContext();
 
-    return Cloud_Initialize(eventLoop, connectionContext, ExitCodeCallbackHandler,
-                            DisplayAlertCallbackHandler, ConnectionChangedCallbackHandler);
-#else 
-    return ExitCode_Success;
-#endif 
+    ExitCode cloudExitCode = Cloud_Initialize(el, connectionContext, ExitCodeCallbackHandler,
+                                              DisplayAlertCallbackHandler, ConnectionChangedCallbackHandler);
+    BOOT_MARK(BOOT_PHASE_CLOUD_INIT);
+    return cloudExitCode;
+}
+#endif // IOT_HUB_APPLICATION
+
+// With ENABLE_ASYNC_INIT the foreground steps (no background flag) run before the event loop
+// starts, so the cloud connection is started before the slow peripherals are brought up.  The
+// real time cores, the user interface (I2C/OLED) and deferred OTA can fail without ending the
+// application.
+static initStep_t initSteps[INIT_STEP_COUNT] = {
+#ifdef IOT_HUB_APPLICATION
+    [INIT_DIRECT_METHODS] = {.name = "directMethods", .init = InitDirectMethodsStep},
+#endif // IOT_HUB_APPLICATION
+#ifdef M4_INTERCORE_COMMS
+    [INIT_M4] = {.name = "m4", .init = InitM4Step, .optional = true, .background = true},
+#endif // M4_INTERCORE_COMMS
+    [INIT_USER_INTERFACE] = {.name = "userInterface", .init = InitUserInterfaceStep, 
+                             .optional = true, .background = true},
+    [INIT_SENSOR_TIMER] = {.name = "sensorTimer", .init = InitSensorTimerStep},
+#ifdef DEFER_OTA_UPDATES
+    [INIT_DEFERRED_OTA] = {.name = "deferredOta", .init = InitDeferredOtaStep,
+                           .optional = true, .background = true},
+#endif // DEFER_OTA_UPDATES
+#ifdef IOT_HUB_APPLICATION
+    [INIT_CLOUD] = {.name = "cloud", .init = InitCloudStep, .dependsOn = INIT_DEP(INIT_DIRECT_METHODS)},
+#endif // IOT_HUB_APPLICATION
+};
+
+/// <summary>
+///     Set up SIGTERM termination handler, initialize peripherals, and set up event handlers.
+/// </summary>
+/// <returns>
+///     ExitCode_Success if all resources were allocated successfully; otherwise another
+///     ExitCode value which indicates the specific failure.
+/// </returns>
+static ExitCode InitPeripheralsAndHandlers(void)
+{
+    struct sigaction action;
+    memset(&action, 0, sizeof(struct sigaction));
+    action.sa_handler = TerminationHandler;
+    sigaction(SIGTERM, &action, NULL);
+
+    eventLoop = EventLoop_Create();
+    if (eventLoop == NULL) {
+        Log_Debug("Could not create event loop.\n");
+        return ExitCode_Init_EventLoop;
+    }
+
+#ifdef ENABLE_WAKEUP_PROFILE
+    // Start the periodic wakeup summary
+    ExitCode wakeupProfileExitCode = wakeupProfile_Init(eventLoop);
+    if (wakeupProfileExitCode != ExitCode_Success) {
+        return wakeupProfileExitCode;
+    }
+#endif // ENABLE_WAKEUP_PROFILE
+
+#ifdef ENABLE_WORK_QUEUE
+    // Start the worker threads before any module can submit work
+    ExitCode workQueueExitCode = workQueue_Init(eventLoop);
+    if (workQueueExitCode != ExitCode_Success) {
+        return workQueueExitCode;
+    }
+#endif // ENABLE_WORK_QUEUE
+
+#ifdef ENABLE_TELEMETRY_PIPELINE
+    // Route sensor samples through the pipelines in pipelineTable[]
+    ExitCode pipelineExitCode = pipeline_Init(pipelineTable, sizeof(pipelineTable) / sizeof(pipeline_t *));
+    if (pipelineExitCode != ExitCode_Success) {
+        return pipelineExitCode;
+    }
+#endif // ENABLE_TELEMETRY_PIPELINE
+
+    // Bring up the subsystems, see initSteps[] above
+    return initSequence_Run(eventLoop, initSteps, INIT_STEP_COUNT, ExitCodeCallbackHandler);
 }
 
 /// <summary>
@@ -365,8 +573,31 @@ void ClosePeripheralsAndHandlers(void)
 {
     Log_Debug("Releasing system resources\n");
 
+#ifdef ENABLE_RULES_ENGINE
+    // Turn off any GPIOs the rules are driving
+    rulesEngine_Cleanup();
+#endif // ENABLE_RULES_ENGINE
+
+    initSequence_Cleanup();
     DisposeEventLoopTimer(telemetryTimer);
     DisposeEventLoopTimer(sensorPollTimer);
+#ifdef ENABLE_LIVE_MODE
+    liveMode_Cleanup();
+#endif // ENABLE_LIVE_MODE
+#ifdef ENABLE_SENSOR_REGISTRY
+    sensorRegistry_Cleanup();
+#endif // ENABLE_SENSOR_REGISTRY
+#ifdef ENABLE_WAKEUP_PROFILE
+    wakeupProfile_Cleanup();
+#endif // ENABLE_WAKEUP_PROFILE
+#ifdef ENABLE_WORK_QUEUE
+    // Finishes queued jobs and runs their completion functions
+    workQueue_Cleanup();
+#endif // ENABLE_WORK_QUEUE
+#ifdef ENABLE_TELEMETRY_PIPELINE
+    // Hands the sinks what is still queued while the cloud client exists
+    pipeline_Cleanup();
+#endif // ENABLE_TELEMETRY_PIPELINE
     Cloud_Cleanup();
     UserInterface_Cleanup();
     Connection_Cleanup();
@@ -425,10 +656,9 @@ static void ReadWifiConfig(bool outputDebug){
 
         if((iothubClientHandle != NULL) && (ssidChanged)){
 
-            updateDeviceTwin(false, ARGS_PER_TWIN_ITEM*3, 
-                                    TYPE_STRING, "ssid", &network_data.SSID,
-                                    TYPE_INT, "freq", network_data.frequency_MHz,
-                                    TYPE_STRING, "bssid", &bssid);               
+            SCHEMA_UPDATE_DEVICE_TWIN(false, SCHEMA_PROPERTY(ssid, network_data.SSID),
+                                             SCHEMA_PROPERTY(freq, network_data.frequency_MHz),
+                                             SCHEMA_PROPERTY(bssid, bssid));
             
             // Reset the flag 
             ssidChanged = false;
@@ -444,6 +674,26 @@ static void ReadWifiConfig(bool outputDebug){
     }
 }
 
+#ifdef ENABLE_SENSOR_REGISTRY
+/// <summary>
+///     Sensor registry read function for the wifi sensor
+/// </summary>
+bool readWifiSensor(void *thisSensor)
+{
+    sensor_t *sensor = (sensor_t*)thisSensor;
+
+    // Read the current wifi configuration
+    ReadWifiConfig(false);
+
+    sensor->values[0] = (float)network_data.rssi;
+    sensor->values[1] = (float)network_data.frequency_MHz;
+
+    // Zero frequency means we're not connected to a network
+    return (network_data.frequency_MHz != 0);
+}
+
+#else // !ENABLE_SENSOR_REGISTRY
+
 /// <summary>
 ///     Senspr timer event:  Read the sensors
 /// </summary>
@@ -465,6 +715,9 @@ static void ReadSensorTimerEventHandler(EventLoopTimer *timer)
 
     // Read the current wifi configuration
     ReadWifiConfig(false);
+    if (network_data.frequency_MHz != 0) {
+        SAMPLE_PUBLISH(SCHEMA_KEY(wifiRssi), (float)network_data.rssi);
+    }
 
     // Call the routine to read/report the application's high water memory usage
     // This routine will send a device twin update if the high water mark increased
@@ -472,4 +725,5 @@ static void ReadSensorTimerEventHandler(EventLoopTimer *timer)
 
 
 }
+#endif // ENABLE_SENSOR_REGISTRY
 
@@ -0,0 +1,447 @@
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Offline telemetry backlog
+//
+//  With ENABLE_TELEMETRY_RESEND_LOGIC every telemetry message stays in the linked list until the
+//  IoT Hub confirms it.  During an outage the list would grow until the heap runs out.  This
+//  module keeps the list under BACKLOG_MAX_BYTES so an outage of any length degrades the history
+//  instead of ending the application.
+//
+//  After each new telemetry message the list size is checked.  While it is over the limit the oldest run
+//  of up to BACKLOG_COMPACT_GROUP nodes at the same level is replaced with one summary node one
+//  level up.  Level 0 is a message as it was sent, level 1 summarizes BACKLOG_COMPACT_GROUP
+//  messages, level 2 summarizes BACKLOG_COMPACT_GROUP level 1 summaries and so on.  The lowest
+//  level with a full run is compacted first, otherwise the level with the longest run, so the
+//  list settles into a few nodes per level with the newest data at the finest resolution.  Only
+//  when no two neighbouring nodes share a level is the oldest node dropped.
+//
+//  A summary keeps the original message envelope (IoTConnect or plain) and replaces each numeric
+//  key with {"min", "max", "mean", "count"}.  Other values keep the newest one.  The summary adds
+//  "backlogFrom" and "backlogTo" (UTC times of the first and last message it covers) and
+//  "backlogMessages".
+//
+//  Nodes the IoT Hub SDK is still holding are never compacted, the send callback refers to them.
+//
+//  While offline the telemetry timer (and the sensor poll timer when the sensor registry isn't
+//  used) run BACKLOG_OFFLINE_PERIOD_MULTIPLIER times slower.  On reconnect the periods are
+//  restored, the list is resent by the connection handler and the outage is reported in the
+//  backlog* read only device twins.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "offline_backlog.h"
+
+#ifdef ENABLE_OFFLINE_BACKLOG
+
+#include <string.h>
+#include <time.h>
+#include <applibs/eventloop.h>
+#include <applibs/log.h>
+#include "app_log.h"
+#include "eventloop_timer_utilities.h"
+#include "parson.h"
+#include "../avnet/device_twin.h"
+#include "adaptive_period.h"
+#include "schema_keys.h"
+
+static backlogStats_t stats;
+static bool offline = false;
+static time_t offlineSince = 0;
+
+static size_t NodeBytes(const telemetryNode_t *node);
+static size_t ListBytes(void);
+static bool CompactOldest(void);
+static bool DropOldest(void);
+static bool CompactRun(telemetryNode_t *first, int count);
+static JSON_Object *DataObject(JSON_Value *rootValue);
+static void MergeData(JSON_Object *summary, JSON_Object *data);
+static void MergeStats(JSON_Object *summary, const char *key, double min, double max, double mean,
+                       double count);
+static void SetTimerPeriods(int multiplier);
+
+void backlog_ConnectionChanged(bool connected)
+{
+    if (!connected && !offline) {
+
+        offline = true;
+        offlineSince = time(NULL);
+        stats.outages++;
+        SetTimerPeriods(BACKLOG_OFFLINE_PERIOD_MULTIPLIER);
+        LOG_INFO(APP_LOG_CAT_IOT, "Backlog: offline, holding up to %d bytes of telemetry\n", BACKLOG_MAX_BYTES);
+    }
+    else if (connected && offline) {
+
+        offline = false;
+        stats.lastOutageSeconds = (uint32_t)(time(NULL) - offlineSince);
+        SetTimerPeriods(1);
+
+        LOG_INFO(APP_LOG_CAT_IOT, "Backlog: online after %u seconds, %d messages held, %u compactions, %u dropped\n",
+                                  stats.lastOutageSeconds, GetListLength(), stats.compactions, stats.messagesDropped);
+
+        SCHEMA_UPDATE_DEVICE_TWIN(false, SCHEMA_PROPERTY(backlogLastOutageSeconds, (int)stats.lastOutageSeconds),
+                                         SCHEMA_PROPERTY(backlogCompactions, (int)stats.compactions),
+                                         SCHEMA_PROPERTY(backlogMessagesDropped, (int)stats.messagesDropped),
+                                         SCHEMA_PROPERTY(backlogPeakBytes, (int)stats.peakBytes));
+    }
+}
+
+void backlog_SendAttempted(telemetryNode_t *node, bool accepted)
+{
+    if ((node != NULL) && accepted && (node->sendsPending < UINT8_MAX)) {
+        node->sendsPending++;
+    }
+}
+
+void backlog_CheckSize(void)
+{
+    size_t bytes = ListBytes();
+    if (bytes > stats.peakBytes) {
+        stats.peakBytes = (uint32_t)bytes;
+    }
+
+    // Each pass removes at least one node, stop if only pending nodes are left
+    while (bytes > BACKLOG_MAX_BYTES) {
+
+        if (!CompactOldest() && !DropOldest()) {
+            break;
+        }
+        bytes = ListBytes();
+    }
+}
+
+void backlog_SendCompleted(telemetryNode_t *node, bool success)
+{
+    // A resent node can be with the SDK more than once, and the context of a late callback may
+    // no longer be in the list.  Don't touch it unless it is.
+    if (!IsNodeInList(node)) {
+        return;
+    }
+
+    if (node->sendsPending > 0) {
+        node->sendsPending--;
+    }
+    if (success) {
+        node->delivered = true;
+    }
+
+    if (node->delivered && (node->sendsPending == 0)) {
+        DeleteNode(node);
+    }
+}
+
+bool backlog_CanResend(const telemetryNode_t *node)
+{
+    // A saturated count would let the node be freed while the SDK still holds it
+    return !node->delivered && (node->sendsPending < UINT8_MAX);
+}
+
+const backlogStats_t *backlog_GetStats(void)
+{
+    return &stats;
+}
+
+static size_t NodeBytes(const telemetryNode_t *node)
+{
+    return sizeof(telemetryNode_t) + strlen(node->telemetryJson) + 1;
+}
+
+static size_t ListBytes(void)
+{
+    size_t bytes = 0;
+    for (telemetryNode_t *node = head; node != NULL; node = node->next) {
+        bytes += NodeBytes(node);
+    }
+    return bytes;
+}
+
+/// <summary>
+///     Find the oldest run of idle nodes at each level and compact the best one.  Returns false
+///     if there is no run of two or more.
+/// </summary>
+static bool CompactOldest(void)
+{
+    telemetryNode_t *runStart[BACKLOG_MAX_LEVELS] = {NULL};
+    int runLength[BACKLOG_MAX_LEVELS] = {0};
+
+    telemetryNode_t *node = head;
+    while (node != NULL) {
+
+        if (node->sendsPending != 0) {
+            node = node->next;
+            continue;
+        }
+
+        // Measure the run of idle nodes at this node's level
+        int level = (node->level < BACKLOG_MAX_LEVELS) ? node->level : BACKLOG_MAX_LEVELS - 1;
+        telemetryNode_t *first = node;
+        int length = 0;
+        while ((node != NULL) && (node->sendsPending == 0) && (node->level == first->level) &&
+               (length < BACKLOG_COMPACT_GROUP)) {
+            length++;
+            node = node->next;
+        }
+
+        // Keep the oldest run, unless a later one is longer
+        if (length > runLength[level]) {
+            runStart[level] = first;
+            runLength[level] = length;
+        }
+    }
+
+    int chosen = -1;
+    for (int level = 0; level < BACKLOG_MAX_LEVELS; level++) {
+
+        if (runLength[level] == BACKLOG_COMPACT_GROUP) {
+            chosen = level;
+            break;
+        }
+        if ((runLength[level] >= 2) && ((chosen < 0) || (runLength[level] > runLength[chosen]))) {
+            chosen = level;
+        }
+    }
+
+    if (chosen < 0) {
+        return false;
+    }
+
+    return CompactRun(runStart[chosen], runLength[chosen]);
+}
+
+/// <summary>
+///     Last resort, drop the oldest node the SDK isn't holding
+/// </summary>
+static bool DropOldest(void)
+{
+    for (telemetryNode_t *node = head; node != NULL; node = node->next) {
+
+        if (node->sendsPending == 0) {
+            LOG_WARN_RL(APP_LOG_CAT_IOT, APP_LOG_RATE_LIMIT_MS, "Backlog: dropping %u messages\n", node->messageCount);
+            stats.messagesDropped += node->messageCount;
+            DeleteNode(node);
+            return true;
+        }
+    }
+    return false;
+}
+
+/// <summary>
+///     Replace count nodes starting at first with one summary node
+/// </summary>
+static bool CompactRun(telemetryNode_t *first, int count)
+{
+    JSON_Value *summaryValue = json_value_init_object();
+    JSON_Object *summary = json_value_get_object(summaryValue);
+    JSON_Value *envelope = NULL;
+
+    telemetryNode_t *last = first;
+    uint32_t messageCount = 0;
+
+    for (int i = 0; i < count; i++) {
+
+        if (i > 0) {
+            last = last->next;
+        }
+        messageCount += last->messageCount;
+
+        JSON_Value *rootValue = json_parse_string(last->telemetryJson);
+        if (rootValue == NULL) {
+            continue;
+        }
+
+        MergeData(summary, DataObject(rootValue));
+
+        // The first message's envelope carries the summary
+        if (envelope == NULL) {
+            envelope = rootValue;
+        }
+        else {
+            json_value_free(rootValue);
+        }
+    }
+
+    char timeString[32];
+    strftime(timeString, sizeof(timeString), "%Y-%m-%dT%H:%M:%SZ", gmtime(&first->firstTime));
+    json_object_set_string(summary, SCHEMA_KEY(backlogFrom), SCHEMA_VALUE(backlogFrom, timeString));
+    strftime(timeString, sizeof(timeString), "%Y-%m-%dT%H:%M:%SZ", gmtime(&last->lastTime));
+    json_object_set_string(summary, SCHEMA_KEY(backlogTo), SCHEMA_VALUE(backlogTo, timeString));
+    json_object_set_number(summary, SCHEMA_KEY(backlogMessages), SCHEMA_VALUE(backlogMessages, (int)messageCount));
+
+    // Put the summary where the message data was: d[0].d for IoTConnect, the root otherwise
+    JSON_Value *outputValue = summaryValue;
+    if (envelope != NULL) {
+
+        JSON_Array *dataArray = json_object_get_array(json_value_get_object(envelope), "d");
+        JSON_Object *firstEntry = json_array_get_object(dataArray, 0);
+        if (json_object_get_object(firstEntry, "d") != NULL) {
+            json_object_set_value(firstEntry, "d", summaryValue);
+            outputValue = envelope;
+        }
+        else {
+            json_value_free(envelope);
+        }
+    }
+
+    char *serializedJson = json_serialize_to_string(outputValue);
+    telemetryNode_t *summaryNode = NULL;
+    if (serializedJson != NULL) {
+        summaryNode = InsertBefore(first, serializedJson, (int)strlen(serializedJson));
+        json_free_serialized_string(serializedJson);
+    }
+    json_value_free(outputValue);
+
+    if (summaryNode == NULL) {
+        return false;
+    }
+
+    summaryNode->firstTime = first->firstTime;
+    summaryNode->lastTime = last->lastTime;
+    summaryNode->messageCount = messageCount;
+    summaryNode->level = (uint8_t)((first->level < UINT8_MAX) ? first->level + 1 : UINT8_MAX);
+#ifdef ENABLE_LATENCY_TRACE
+    // Report the summary against its oldest sample
+    summaryNode->latencyStamp = first->latencyStamp;
+#endif // ENABLE_LATENCY_TRACE
+
+    // Release the nodes the summary replaces
+    telemetryNode_t *node = first;
+    for (int i = 0; i < count; i++) {
+        telemetryNode_t *next = node->next;
+        DeleteNode(node);
+        node = next;
+    }
+
+    stats.compactions++;
+    return true;
+}
+
+/// <summary>
+///     The object holding the telemetry "key": value pairs, d[0].d in IoTConnect messages
+/// </summary>
+static JSON_Object *DataObject(JSON_Value *rootValue)
+{
+    JSON_Object *rootObject = json_value_get_object(rootValue);
+    JSON_Array *dataArray = json_object_get_array(rootObject, "d");
+    JSON_Object *data = json_object_get_object(json_array_get_object(dataArray, 0), "d");
+
+    return (data != NULL) ? data : rootObject;
+}
+
+/// <summary>
+///     Fold one message or summary into the summary being built
+/// </summary>
+static void MergeData(JSON_Object *summary, JSON_Object *data)
+{
+    size_t keyCount = json_object_get_count(data);
+
+    for (size_t i = 0; i < keyCount; i++) {
+
+        const char *key = json_object_get_name(data, i);
+        JSON_Value *value = json_object_get_value_at(data, i);
+
+        // Recomputed from the node times
+        if ((strcmp(key, SCHEMA_KEY(backlogFrom)) == 0) || (strcmp(key, SCHEMA_KEY(backlogTo)) == 0) ||
+            (strcmp(key, SCHEMA_KEY(backlogMessages)) == 0)) {
+            continue;
+        }
+
+        if (json_value_get_type(value) == JSONNumber) {
+            double number = json_value_get_number(value);
+            MergeStats(summary, key, number, number, number, 1);
+        }
+        else if ((json_value_get_type(value) == JSONObject) &&
+                 json_object_has_value_of_type(json_value_get_object(value), "count", JSONNumber)) {
+            JSON_Object *stat = json_value_get_object(value);
+            MergeStats(summary, key, json_object_get_number(stat, "min"), json_object_get_number(stat, "max"),
+                       json_object_get_number(stat, "mean"), json_object_get_number(stat, "count"));
+        }
+        else {
+            // Strings, booleans and anything else keep the newest value
+            json_object_set_value(summary, key, json_value_deep_copy(value));
+        }
+    }
+}
+
+static void MergeStats(JSON_Object *summary, const char *key, double min, double max, double mean,
+                       double count)
+{
+    JSON_Object *stat = json_object_get_object(summary, key);
+
+    if ((stat == NULL) || !json_object_has_value_of_type(stat, "count", JSONNumber)) {
+        JSON_Value *statValue = json_value_init_object();
+        stat = json_value_get_object(statValue);
+        json_object_set_number(stat, "min", min);
+        json_object_set_number(stat, "max", max);
+        json_object_set_number(stat, "mean", mean);
+        json_object_set_number(stat, "count", count);
+        json_object_set_value(summary, key, statValue);
+        return;
+    }
+
+    double oldCount = json_object_get_number(stat, "count");
+    double newCount = oldCount + count;
+    double oldMean = json_object_get_number(stat, "mean");
+
+    if (min < json_object_get_number(stat, "min")) {
+        json_object_set_number(stat, "min", min);
+    }
+    if (max > json_object_get_number(stat, "max")) {
+        json_object_set_number(stat, "max", max);
+    }
+    json_object_set_number(stat, "mean", ((oldMean * oldCount) + (mean * count)) / newCount);
+    json_object_set_number(stat, "count", newCount);
+}
+
+/// <summary>
+///     Run the telemetry (and legacy sensor poll) timers at multiplier times their configured
+///     periods.  Disabled timers are left alone.
+/// </summary>
+static void SetTimerPeriods(int multiplier)
+{
+#ifdef ENABLE_ADAPTIVE_TELEMETRY
+    // The adaptive scheduler applies the multiplier to its own period
+    adaptivePeriod_SetMultiplier(multiplier);
+#endif // ENABLE_ADAPTIVE_TELEMETRY
+
+    if ((telemetrytxIntervalr != NULL) && (sendTelemetryPeriod > 0) && !ADAPTIVE_PERIOD_ENABLED()) {
+        struct timespec newPeriod = {.tv_sec = sendTelemetryPeriod * multiplier, .tv_nsec = 0};
+        SetEventLoopTimerPeriod(telemetrytxIntervalr, &newPeriod);
+    }
+
+#ifndef ENABLE_SENSOR_REGISTRY
+    if ((sensorPollTimer != NULL) && (readSensorPeriod > 0)) {
+        struct timespec newPeriod = {.tv_sec = readSensorPeriod * multiplier, .tv_nsec = 0};
+        SetEventLoopTimerPeriod(sensorPollTimer, &newPeriod);
+    }
+#endif // !ENABLE_SENSOR_REGISTRY
+}
+
+#endif // ENABLE_OFFLINE_BACKLOG
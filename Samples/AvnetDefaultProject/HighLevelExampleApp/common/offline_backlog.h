@@ -0,0 +1,104 @@
+#ifndef OFFLINE_BACKLOG_H
+#define OFFLINE_BACKLOG_H
+
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "build_options.h"
+
+// Most memory the unsent telemetry list may hold, node headers included
+#ifndef BACKLOG_MAX_BYTES
+#define BACKLOG_MAX_BYTES (16 * 1024)
+#endif
+
+// Number of same level nodes folded into one summary
+#ifndef BACKLOG_COMPACT_GROUP
+#define BACKLOG_COMPACT_GROUP 8
+#endif
+
+// Summary levels tracked when choosing what to compact, deeper levels are treated as the last one
+#define BACKLOG_MAX_LEVELS 8
+
+// While offline the telemetry and sensor poll periods are multiplied by this
+#ifndef BACKLOG_OFFLINE_PERIOD_MULTIPLIER
+#define BACKLOG_OFFLINE_PERIOD_MULTIPLIER 4
+#endif
+
+typedef struct {
+    uint32_t compactions;       // Summaries created
+    uint32_t messagesDropped;   // Messages discarded when nothing was left to compact
+    uint32_t outages;
+    uint32_t lastOutageSeconds;
+    uint32_t peakBytes;
+} backlogStats_t;
+
+#ifdef ENABLE_OFFLINE_BACKLOG
+
+#if !defined(IOT_HUB_APPLICATION) || !defined(ENABLE_TELEMETRY_RESEND_LOGIC)
+#error "ENABLE_OFFLINE_BACKLOG requires ENABLE_TELEMETRY_RESEND_LOGIC in an IoT Hub application"
+#endif
+
+#include "linkedList.h"
+
+/// <summary>
+///     Called from the application's connection changed handler.  Going offline stretches the
+///     telemetry and sensor poll periods, coming back restores them and reports the outage.
+/// </summary>
+void backlog_ConnectionChanged(bool connected);
+
+/// <summary>
+///     Called after each attempt to send a list node, accepted is true if the IoT Hub SDK took
+///     the message
+/// </summary>
+void backlog_SendAttempted(telemetryNode_t *node, bool accepted);
+
+/// <summary>
+///     Compact the list until it fits in BACKLOG_MAX_BYTES.  Nodes may be deleted, don't call
+///     this while walking the list.
+/// </summary>
+void backlog_CheckSize(void);
+
+/// <summary>
+///     Called from the send callback for every send of a list node.  The node is freed once a
+///     send has succeeded and the SDK holds no other copy of it.
+/// </summary>
+void backlog_SendCompleted(telemetryNode_t *node, bool success);
+
+/// <summary>
+///     False if the node was already delivered and only waits for the SDK to call back
+/// </summary>
+bool backlog_CanResend(const telemetryNode_t *node);
+
+const backlogStats_t *backlog_GetStats(void);
+
+#endif // ENABLE_OFFLINE_BACKLOG
+
+#endif // OFFLINE_BACKLOG_H
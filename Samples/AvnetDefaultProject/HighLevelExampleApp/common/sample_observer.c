@@ -0,0 +1,78 @@
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#include "sample_observer.h"
+
+#ifdef ENABLE_SAMPLE_OBSERVERS
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "anomaly_detector.h"
+#include "timeseries_store.h"
+#include "telemetry_pipeline.h"
+#include "adaptive_period.h"
+#include "../avnet/rules_engine.h"
+#include "monotonic_time.h"
+
+#ifdef ENABLE_TIMESERIES_STORE
+static void tsStoreObserver(const char *channel, float value, uint64_t timeMs)
+{
+    // A full channel table or an out of order sample just isn't stored
+    (void)tsStore_Append(channel, timeMs, value);
+}
+#endif // ENABLE_TIMESERIES_STORE
+
+// The modules that see every sample, in the order they see it
+static const sampleObserver_t observers[] = {
+#ifdef ENABLE_ANOMALY_DETECTOR
+    anomaly_Observe,
+#endif // ENABLE_ANOMALY_DETECTOR
+#ifdef ENABLE_TIMESERIES_STORE
+    tsStoreObserver,
+#endif // ENABLE_TIMESERIES_STORE
+#ifdef ENABLE_TELEMETRY_PIPELINE
+    pipeline_Push,
+#endif // ENABLE_TELEMETRY_PIPELINE
+#ifdef ENABLE_ADAPTIVE_TELEMETRY
+    adaptivePeriod_Observe,
+#endif // ENABLE_ADAPTIVE_TELEMETRY
+#ifdef ENABLE_RULES_ENGINE
+    rulesEngine_Observe,
+#endif // ENABLE_RULES_ENGINE
+};
+
+void sampleObserver_Publish(const char *channel, float value)
+{
+    uint64_t now = monotonicMs();
+
+    for (size_t i = 0; i < sizeof(observers) / sizeof(observers[0]); i++) {
+        observers[i](channel, value, now);
+    }
+}
+
+#endif // ENABLE_SAMPLE_OBSERVERS
@@ -0,0 +1,66 @@
+#ifndef SAMPLE_OBSERVER_H
+#define SAMPLE_OBSERVER_H
+
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+
+#include <stdint.h>
+#include "build_options.h"
+
+// Every sensor sample, from the sensor registry, ReadSensorTimerEventHandler() or the real time
+// application raw data handlers, is published once with SAMPLE_PUBLISH(channel, value).  The
+// sample is passed, with the time it was published, to each observer in the table in
+// sample_observer.c.  A module that wants the samples adds its observer to the table.
+//
+// The channel name is not copied, it must stay valid (string literal or table entry).  Use
+// SCHEMA_KEY() so the channel is also a telemetry key in schema.h.
+
+typedef void (*sampleObserver_t)(const char *channel, float value, uint64_t timeMs);
+
+#if defined(ENABLE_ANOMALY_DETECTOR) || defined(ENABLE_TIMESERIES_STORE) || defined(ENABLE_TELEMETRY_PIPELINE) || \
+    defined(ENABLE_ADAPTIVE_TELEMETRY) || defined(ENABLE_RULES_ENGINE)
+#define ENABLE_SAMPLE_OBSERVERS
+#endif
+
+#ifdef ENABLE_SAMPLE_OBSERVERS
+
+/// <summary>
+///     Pass a sample to every observer
+/// </summary>
+void sampleObserver_Publish(const char *channel, float value);
+
+#define SAMPLE_PUBLISH(channel, value) sampleObserver_Publish(channel, value)
+
+#else
+
+#define SAMPLE_PUBLISH(channel, value)
+
+#endif // ENABLE_SAMPLE_OBSERVERS
+
+#endif // SAMPLE_OBSERVER_H
@@ -0,0 +1,396 @@
+#ifndef SCHEMA_H
+#define SCHEMA_H
+
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+
+#include "build_options.h"
+#include "sample_observer.h"
+#include "../avnet/mem_accounting.h"
+
+// The cloud schema.  Every device twin key, read only reported property and telemetry key the
+// application sends is declared once here, the lists below generate:
+//
+//      twinArray[] (avnet/device_twin.c)
+//      SCHEMA_KEY(), SCHEMA_TELEMETRY() and SCHEMA_PROPERTY() (schema_keys.h) used at every
+//      Cloud_SendTelemetry() and updateDeviceTwin() call
+//      The DTDL model for IOT_PLUG_AND_PLAY_MODEL_ID and the IoTConnect template attributes
+//      (HostTools/schema_dtdl.c, written by the HostTools build)
+//
+// A key that is misspelled, sent with the wrong kind of value, or sent as telemetry when it is
+// a property (or the other way round) does not compile.  A key used in two lists does not
+// compile.  Entries are conditional on the same build options as the code that sends them, so
+// the DTDL only describes what is built in.
+//
+// Types are INT, FLOAT, BOOL or STRING.  Keys must be valid DTDL names: a letter first, then
+// letters, digits and '_', at most 64 characters.
+
+// Writable device twins, in the order they are handled when a desired properties patch arrives.
+// GPIO twins are BOOL and use genericGPIODTFunction().
+// X(key, variable, fd, GPIO, activeHigh, "description")
+#ifndef GUARDIAN_100
+#define SCHEMA_GPIO_TWIN_LIST(X) \
+    X(appLed, &appLedIsOn, &appLedFd, SAMPLE_APP_LED, false, "Starter Kit application LED")
+#else
+#define SCHEMA_GPIO_TWIN_LIST(X)
+#endif // !GUARDIAN_100
+
+// X(key, type, variable, handler, "description")
+//      variable - The application variable the handler updates, NULL if the handler keeps its own
+//      handler  - void <handler>(void* thisTwinPtr, JSON_Object *desiredProperties);
+#define SCHEMA_BASE_TWIN_LIST(X) \
+    X(sensorPollPeriod,  INT,    &readSensorPeriod,     setSensorPollTimerFunction,   "Seconds between sensor reads") \
+    X(telemetryPeriod,   INT,    &sendTelemetryPeriod,  setTelemetryTimerFunction,    "Seconds between telemetry messages") \
+    X(logLevel,          INT,    &appLogLevel,          setLogLevelFunction,          "Most detailed debug output, 0 off, 1 error, 2 warn, 3 info, 4 debug, 5 verbose") \
+    X(logCategoryLevels, STRING, appLogCategoryLevels,  setLogCategoryLevelsFunction, "Per category log levels, category=level,...")
+
+#ifdef M4_INTERCORE_COMMS
+#define SCHEMA_M4_TWIN_LIST(X) \
+    X(realTimeAutoTelemetryPeriod, INT, &realTimeAutoTelemetryInterval, setRealTimeTelemetryInterval, "Seconds between real time application telemetry, 0 to disable")
+#else
+#define SCHEMA_M4_TWIN_LIST(X)
+#endif // M4_INTERCORE_COMMS
+
+#ifdef OLED_SD1306
+#define SCHEMA_OLED_TWIN_LIST(X) \
+    X(OledDisplayMsg1, STRING, oled_ms1, genericStringDTFunction, "OLED display line 1") \
+    X(OledDisplayMsg2, STRING, oled_ms2, genericStringDTFunction, "OLED display line 2") \
+    X(OledDisplayMsg3, STRING, oled_ms3, genericStringDTFunction, "OLED display line 3") \
+    X(OledDisplayMsg4, STRING, oled_ms4, genericStringDTFunction, "OLED display line 4")
+#else
+#define SCHEMA_OLED_TWIN_LIST(X)
+#endif // OLED_SD1306
+
+#ifdef ENABLE_RULES_ENGINE
+#define SCHEMA_RULES_TWIN_LIST(X) \
+    X(rules, STRING, rulesText, setRulesFunction, "Local threshold rules, see avnet/rules_engine.c")
+#else
+#define SCHEMA_RULES_TWIN_LIST(X)
+#endif // ENABLE_RULES_ENGINE
+
+#ifdef ENABLE_ANOMALY_DETECTOR
+#define SCHEMA_ANOMALY_TWIN_LIST(X) \
+    X(anomalyZThreshold,      FLOAT, &anomalyZThreshold,      setAnomalyConfigFunction, "Report samples this many standard deviations from the channel mean") \
+    X(anomalyHalfLifeSeconds, INT,   &anomalyHalfLifeSeconds, setAnomalyConfigFunction, "How quickly the channel statistics forget old samples") \
+    X(anomalySummaryOnly,     BOOL,  &anomalySummaryOnly,     setAnomalyConfigFunction, "Send channel summaries in place of the routine telemetry")
+#else
+#define SCHEMA_ANOMALY_TWIN_LIST(X)
+#endif // ENABLE_ANOMALY_DETECTOR
+
+// liveMode follows the live* settings so a patch with both uses the new settings
+#ifdef ENABLE_LIVE_MODE
+#define SCHEMA_LIVE_MODE_TWIN_LIST(X) \
+    X(livePeriodMs,    INT, &liveModeConfig.periodMs,    setLiveModeConfigFunction, "Live mode sample period") \
+    X(liveBatchFrames, INT, &liveModeConfig.batchFrames, setLiveModeConfigFunction, "Live mode samples per message") \
+    X(liveMaxMessages, INT, &liveModeConfig.maxMessages, setLiveModeConfigFunction, "Live mode message budget per session") \
+    X(liveMaxBytes,    INT, &liveModeConfig.maxBytes,    setLiveModeConfigFunction, "Live mode byte budget per session") \
+    X(liveMode,        INT, &liveModeSeconds,            setLiveModeFunction,       "Seconds to stream sensor data, 0 to stop")
+#else
+#define SCHEMA_LIVE_MODE_TWIN_LIST(X)
+#endif // ENABLE_LIVE_MODE
+
+// 0 in either bound turns the adaptive period off
+#ifdef ENABLE_ADAPTIVE_TELEMETRY
+#define SCHEMA_ADAPTIVE_TWIN_LIST(X) \
+    X(adaptiveMinSeconds, INT,    &adaptiveMinSeconds, setAdaptivePeriodFunction,   "Shortest adaptive telemetry period, 0 to disable") \
+    X(adaptiveMaxSeconds, INT,    &adaptiveMaxSeconds, setAdaptivePeriodFunction,   "Longest adaptive telemetry period, 0 to disable") \
+    X(adaptiveChannels,   STRING, adaptiveChannels,    setAdaptiveChannelsFunction, "Comma separated channels that set the period, empty for all")
+#else
+#define SCHEMA_ADAPTIVE_TWIN_LIST(X)
+#endif // ENABLE_ADAPTIVE_TELEMETRY
+
+#ifdef ENABLE_TELEMETRY_KEY_DICTIONARY
+#define SCHEMA_KEY_DICTIONARY_TWIN_LIST(X) \
+    X(keyDictionary, STRING, keyDictionaryId, setKeyDictionaryFunction, "Id of the short key dictionary to send telemetry with, empty for full keys")
+#else
+#define SCHEMA_KEY_DICTIONARY_TWIN_LIST(X)
+#endif // ENABLE_TELEMETRY_KEY_DICTIONARY
+
+#ifdef DEFER_OTA_UPDATES
+#define SCHEMA_OTA_TWIN_LIST(X) \
+    X(otaTargetUtcTime, STRING, NULL, setOtaTargetUtcTime, "Defer OTA updates until this UTC time, HR:MN")
+#else
+#define SCHEMA_OTA_TWIN_LIST(X)
+#endif // DEFER_OTA_UPDATES
+
+#define SCHEMA_TWIN_LIST(X) \
+    SCHEMA_BASE_TWIN_LIST(X) \
+    SCHEMA_M4_TWIN_LIST(X) \
+    SCHEMA_OLED_TWIN_LIST(X) \
+    SCHEMA_RULES_TWIN_LIST(X) \
+    SCHEMA_ANOMALY_TWIN_LIST(X) \
+    SCHEMA_LIVE_MODE_TWIN_LIST(X) \
+    SCHEMA_ADAPTIVE_TWIN_LIST(X) \
+    SCHEMA_KEY_DICTIONARY_TWIN_LIST(X) \
+    SCHEMA_OTA_TWIN_LIST(X)
+
+// Reported properties that are not in twinArray[].  Writable entries are handled outside the
+// device twin table.
+// X(key, type, writable, "description")
+#define SCHEMA_BASE_PROPERTY_LIST(X) \
+    X(versionString,     STRING, false, "Application version") \
+    X(manufacturer,      STRING, false, "Device manufacturer") \
+    X(model,             STRING, false, "Device model") \
+    X(ssid,              STRING, false, "Connected Wi-Fi network") \
+    X(freq,              INT,    false, "Wi-Fi frequency in MHz") \
+    X(bssid,             STRING, false, "Wi-Fi access point MAC address") \
+    X(MemoryHighWaterKB, INT,    false, "Peak user mode memory use in KiB")
+
+// One "<sensorName>PeriodMs" twin for each sensorArray[] entry (avnet/sensor_registry.c)
+#ifdef ENABLE_SENSOR_REGISTRY
+#ifdef M4_INTERCORE_COMMS
+#define SCHEMA_M4_SENSOR_PROPERTY_LIST(X) \
+    X(realTimePeriodMs, INT, true, "Real time sensor read period in ms, 0 to stop")
+#else
+#define SCHEMA_M4_SENSOR_PROPERTY_LIST(X)
+#endif // M4_INTERCORE_COMMS
+#define SCHEMA_SENSOR_PROPERTY_LIST(X) \
+    X(wifiPeriodMs,   INT, true, "Wi-Fi sensor read period in ms, 0 to stop") \
+    X(memoryPeriodMs, INT, true, "Memory sensor read period in ms, 0 to stop") \
+    SCHEMA_M4_SENSOR_PROPERTY_LIST(X)
+#else
+#define SCHEMA_SENSOR_PROPERTY_LIST(X)
+#endif // ENABLE_SENSOR_REGISTRY
+
+#ifdef ENABLE_RULES_ENGINE
+#define SCHEMA_RULES_PROPERTY_LIST(X) \
+    X(rulesStatus, STRING, false, "Number of rules running or why the last rules were rejected")
+#else
+#define SCHEMA_RULES_PROPERTY_LIST(X)
+#endif // ENABLE_RULES_ENGINE
+
+#ifdef ENABLE_OFFLINE_BACKLOG
+#define SCHEMA_BACKLOG_PROPERTY_LIST(X) \
+    X(backlogLastOutageSeconds, INT, false, "Length of the last connection outage") \
+    X(backlogCompactions,       INT, false, "Times the offline backlog was compacted") \
+    X(backlogMessagesDropped,   INT, false, "Messages dropped from the offline backlog") \
+    X(backlogPeakBytes,         INT, false, "Largest offline backlog in bytes")
+#else
+#define SCHEMA_BACKLOG_PROPERTY_LIST(X)
+#endif // ENABLE_OFFLINE_BACKLOG
+
+// One heapPeak<name> key per MEM_TAG_LIST entry (avnet/mem_accounting.h)
+#ifdef ENABLE_HEAP_ACCOUNTING
+#define SCHEMA_HEAP_PEAK_PROPERTY(id, name, description, X) \
+    X(heapPeak##name, INT, false, "Peak heap bytes, " description)
+#define SCHEMA_HEAP_PROPERTY_LIST(X) MEM_TAG_LIST(SCHEMA_HEAP_PEAK_PROPERTY, X)
+#else
+#define SCHEMA_HEAP_PROPERTY_LIST(X)
+#endif // ENABLE_HEAP_ACCOUNTING
+
+#ifdef ENABLE_LIVE_MODE
+#define SCHEMA_LIVE_MODE_PROPERTY_LIST(X) \
+    X(liveModeStatus, STRING, false, "running, or why the last live mode session ended")
+#else
+#define SCHEMA_LIVE_MODE_PROPERTY_LIST(X)
+#endif // ENABLE_LIVE_MODE
+
+#ifdef ENABLE_ADAPTIVE_TELEMETRY
+#define SCHEMA_ADAPTIVE_PROPERTY_LIST(X) \
+    X(adaptivePeriodSeconds, INT, false, "Telemetry period the adaptive scheduler is using")
+#else
+#define SCHEMA_ADAPTIVE_PROPERTY_LIST(X)
+#endif // ENABLE_ADAPTIVE_TELEMETRY
+
+#define SCHEMA_PROPERTY_LIST(X) \
+    SCHEMA_BASE_PROPERTY_LIST(X) \
+    SCHEMA_SENSOR_PROPERTY_LIST(X) \
+    SCHEMA_RULES_PROPERTY_LIST(X) \
+    SCHEMA_BACKLOG_PROPERTY_LIST(X) \
+    SCHEMA_HEAP_PROPERTY_LIST(X) \
+    SCHEMA_LIVE_MODE_PROPERTY_LIST(X) \
+    SCHEMA_ADAPTIVE_PROPERTY_LIST(X)
+
+// Telemetry.  X(key, type, "description")
+#define SCHEMA_BASE_TELEMETRY_LIST(X) \
+    X(sampleKeyString, STRING, "Example string telemetry") \
+    X(sampleKeyInt,    INT,    "Example integer telemetry") \
+    X(sampleKeyFloat,  FLOAT,  "Example floating point telemetry")
+
+// The outputs of the sensorArray[] entries
+#ifdef ENABLE_SENSOR_REGISTRY
+#define SCHEMA_SENSOR_TELEMETRY_LIST(X) \
+    X(wifiRssi,          FLOAT, "Wi-Fi signal strength in dBm") \
+    X(wifiFrequency,     FLOAT, "Wi-Fi frequency in MHz") \
+    X(memoryHighWaterKB, FLOAT, "Peak user mode memory use in KiB")
+#elif defined(ENABLE_SAMPLE_OBSERVERS)
+// ReadSensorTimerEventHandler() publishes the Wi-Fi signal strength to the sample observers
+#define SCHEMA_SENSOR_TELEMETRY_LIST(X) \
+    X(wifiRssi,          FLOAT, "Wi-Fi signal strength in dBm")
+#else
+#define SCHEMA_SENSOR_TELEMETRY_LIST(X)
+#endif // ENABLE_SENSOR_REGISTRY
+
+// The samples the real time application raw data handlers publish to the sample observers.  The
+// telemetry pipelines send them under these keys.
+#if defined(ENABLE_SAMPLE_OBSERVERS) && defined(ENABLE_ALS_PT19_RT_APP)
+#define SCHEMA_ALS_PT19_TELEMETRY_LIST(X) \
+    X(lightSensorAdc, FLOAT, "Light sensor ADC reading")
+#else
+#define SCHEMA_ALS_PT19_TELEMETRY_LIST(X)
+#endif // ENABLE_SAMPLE_OBSERVERS && ENABLE_ALS_PT19_RT_APP
+
+#if defined(ENABLE_SAMPLE_OBSERVERS) && defined(ENABLE_GENERIC_RT_APP)
+#define SCHEMA_GENERIC_RT_TELEMETRY_LIST(X) \
+    X(rawData8bit,  FLOAT, "Generic real time application 8 bit reading") \
+    X(rawDataFloat, FLOAT, "Generic real time application floating point reading")
+#else
+#define SCHEMA_GENERIC_RT_TELEMETRY_LIST(X)
+#endif // ENABLE_SAMPLE_OBSERVERS && ENABLE_GENERIC_RT_APP
+
+#if defined(ENABLE_SAMPLE_OBSERVERS) && defined(ENABLE_GROVE_GPS_RT_APP)
+#define SCHEMA_GROVE_GPS_TELEMETRY_LIST(X) \
+    X(gpsAltitude, FLOAT, "GPS altitude in meters") \
+    X(gpsNumSats,  FLOAT, "GPS satellites in view")
+#else
+#define SCHEMA_GROVE_GPS_TELEMETRY_LIST(X)
+#endif // ENABLE_SAMPLE_OBSERVERS && ENABLE_GROVE_GPS_RT_APP
+
+#define SCHEMA_RT_APP_TELEMETRY_LIST(X) \
+    SCHEMA_ALS_PT19_TELEMETRY_LIST(X) \
+    SCHEMA_GENERIC_RT_TELEMETRY_LIST(X) \
+    SCHEMA_GROVE_GPS_TELEMETRY_LIST(X)
+
+#ifdef ENABLE_RULES_ENGINE
+#define SCHEMA_RULES_TELEMETRY_LIST(X) \
+    X(ruleAlert, STRING, "Name from the alert() action of the rule that fired") \
+    X(ruleIndex, INT,    "Index of the rule that fired")
+#else
+#define SCHEMA_RULES_TELEMETRY_LIST(X)
+#endif // ENABLE_RULES_ENGINE
+
+#ifdef ENABLE_ANOMALY_DETECTOR
+#define SCHEMA_ANOMALY_TELEMETRY_LIST(X) \
+    X(anomalyChannel, STRING, "Channel the anomaly was seen on") \
+    X(anomalyValue,   FLOAT,  "Sample value") \
+    X(anomalyMean,    FLOAT,  "Channel mean before the sample") \
+    X(anomalyStdDev,  FLOAT,  "Channel standard deviation before the sample") \
+    X(anomalyZScore,  FLOAT,  "Standard deviations from the mean") \
+    X(anomalySamples, INT,    "Samples seen on the channel") \
+    X(summaryChannel, STRING, "Channel the summary is for") \
+    X(summaryCount,   INT,    "Samples since the last summary") \
+    X(summaryMin,     FLOAT,  "Smallest sample since the last summary") \
+    X(summaryMax,     FLOAT,  "Largest sample since the last summary") \
+    X(summaryMean,    FLOAT,  "Channel mean") \
+    X(summaryStdDev,  FLOAT,  "Channel standard deviation")
+#else
+#define SCHEMA_ANOMALY_TELEMETRY_LIST(X)
+#endif // ENABLE_ANOMALY_DETECTOR
+
+// Added to the data of the summary messages the offline backlog compacts the queued telemetry into
+#ifdef ENABLE_OFFLINE_BACKLOG
+#define SCHEMA_BACKLOG_TELEMETRY_LIST(X) \
+    X(backlogFrom,     STRING, "UTC time of the first message the summary covers") \
+    X(backlogTo,       STRING, "UTC time of the last message the summary covers") \
+    X(backlogMessages, INT,    "Messages the summary covers")
+#else
+#define SCHEMA_BACKLOG_TELEMETRY_LIST(X)
+#endif // ENABLE_OFFLINE_BACKLOG
+
+// The header of each live mode batch, the sensor outputs follow as arrays under their own keys
+#ifdef ENABLE_LIVE_MODE
+#define SCHEMA_LIVE_MODE_TELEMETRY_LIST(X) \
+    X(liveSession,       INT, "Live mode session the batch belongs to") \
+    X(liveSeq,           INT, "Batch number in the session") \
+    X(liveOffsetMs,      INT, "Milliseconds from the start of the session to the first frame") \
+    X(liveFramePeriodMs, INT, "Milliseconds between the frames in the batch")
+#else
+#define SCHEMA_LIVE_MODE_TELEMETRY_LIST(X)
+#endif // ENABLE_LIVE_MODE
+
+#ifdef SEND_OTA_STATUS_TELEMETRY
+#define SCHEMA_OTA_STATUS_TELEMETRY_LIST(X) \
+    X(otaUpdateType,        STRING, "Type of the pending OTA update") \
+    X(otaUpdateStatus,      STRING, "Status of the pending OTA update") \
+    X(otaMaxDeferalTime,    INT,    "Longest the OTA update can be deferred, in minutes") \
+    X(otaUpdateDelayPeriod, INT,    "Minutes the OTA update was deferred")
+#else
+#define SCHEMA_OTA_STATUS_TELEMETRY_LIST(X)
+#endif // SEND_OTA_STATUS_TELEMETRY
+
+#ifdef OTA_TRAFFIC_AWARE_DEFERRAL
+#define SCHEMA_OTA_TRAFFIC_TELEMETRY_LIST(X) \
+    X(otaWindowStartUtc,   STRING, "UTC time the OTA update window starts, HR:MN") \
+    X(otaWindowDelay,      INT,    "Minutes until the OTA update window") \
+    X(otaWindowActivity,   FLOAT,  "Traffic score of the OTA update window") \
+    X(otaPredictedGapSecs, INT,    "Predicted telemetry gap while the update installs") \
+    X(otaActualGapSecs,    INT,    "Telemetry gap while the update installed")
+#else
+#define SCHEMA_OTA_TRAFFIC_TELEMETRY_LIST(X)
+#endif // OTA_TRAFFIC_AWARE_DEFERRAL
+
+#ifdef ENABLE_WAKEUP_PROFILE
+#define SCHEMA_WAKEUP_TELEMETRY_LIST(X) \
+    X(wakeupLoopWakes,           INT,    "Event loop wakeups in the period") \
+    X(wakeupDispatches,          INT,    "Timer and I/O callbacks in the period") \
+    X(wakeupCpuDutyPpm,          INT,    "Parts per million of the period spent in callbacks") \
+    X(wakeupTopSource,           STRING, "Source with the most dispatches") \
+    X(wakeupTopSourceDispatches, INT,    "Dispatches from the top source")
+#else
+#define SCHEMA_WAKEUP_TELEMETRY_LIST(X)
+#endif // ENABLE_WAKEUP_PROFILE
+
+// One key per BOOT_PHASE_LIST entry (boot_timeline.h), -1 for phases that were not reached
+#ifdef ENABLE_BOOT_TIMELINE
+#define SCHEMA_BOOT_TELEMETRY_LIST(X) \
+    X(bootKernelToAppMs,       INT, "Milliseconds from kernel start to application start") \
+    X(bootAppStartMs,          INT, "Application start, the other boot phases are measured from here") \
+    X(bootWifiConfigMs,        INT, "Milliseconds from application start to Wi-Fi configuration") \
+    X(bootDirectMethodsMs,     INT, "Milliseconds from application start to direct method registration") \
+    X(bootM4ConnectMs,         INT, "Milliseconds from application start to real time application connection") \
+    X(bootI2cOledMs,           INT, "Milliseconds from application start to I2C and OLED initialization") \
+    X(bootUserInterfaceMs,     INT, "Milliseconds from application start to user interface initialization") \
+    X(bootOtaRegisterMs,       INT, "Milliseconds from application start to OTA update registration") \
+    X(bootCloudInitMs,         INT, "Milliseconds from application start to cloud initialization") \
+    X(bootNetworkReadyMs,      INT, "Milliseconds from application start to network ready") \
+    X(bootConnectStartMs,      INT, "Milliseconds from application start to the first connection attempt") \
+    X(bootConnectCompleteMs,   INT, "Milliseconds from application start to connection complete") \
+    X(bootHubAuthenticatedMs,  INT, "Milliseconds from application start to IoT Hub authentication") \
+    X(bootFirstTwinMs,         INT, "Milliseconds from application start to the first device twin") \
+    X(bootIoTConnectReadyMs,   INT, "Milliseconds from application start to IoTConnect ready") \
+    X(bootFirstTelemetryMs,    INT, "Milliseconds from application start to the first telemetry message") \
+    X(bootFirstTelemetryAckMs, INT, "Milliseconds from application start to the first telemetry acknowledgement")
+#else
+#define SCHEMA_BOOT_TELEMETRY_LIST(X)
+#endif // ENABLE_BOOT_TIMELINE
+
+#define SCHEMA_TELEMETRY_LIST(X) \
+    SCHEMA_BASE_TELEMETRY_LIST(X) \
+    SCHEMA_SENSOR_TELEMETRY_LIST(X) \
+    SCHEMA_RT_APP_TELEMETRY_LIST(X) \
+    SCHEMA_RULES_TELEMETRY_LIST(X) \
+    SCHEMA_ANOMALY_TELEMETRY_LIST(X) \
+    SCHEMA_BACKLOG_TELEMETRY_LIST(X) \
+    SCHEMA_LIVE_MODE_TELEMETRY_LIST(X) \
+    SCHEMA_OTA_STATUS_TELEMETRY_LIST(X) \
+    SCHEMA_OTA_TRAFFIC_TELEMETRY_LIST(X) \
+    SCHEMA_WAKEUP_TELEMETRY_LIST(X) \
+    SCHEMA_BOOT_TELEMETRY_LIST(X)
+
+#endif // SCHEMA_H
@@ -0,0 +1,151 @@
+#ifndef SCHEMA_KEYS_H
+#define SCHEMA_KEYS_H
+
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "schema.h"
+#include "cloud.h"
+#include "../avnet/device_twin.h"
+
+// Key constants, types and typed arguments generated from the lists in schema.h.
+//
+//      SCHEMA_KEY(key)                 "key", a compile error if key is not in the schema
+//      SCHEMA_TELEMETRY(key, value)    TYPE_x, "key", value for Cloud_SendTelemetry()
+//      SCHEMA_PROPERTY(key, value)     TYPE_x, "key", value for updateDeviceTwin()
+//      SCHEMA_VALUE(key, value)        value as the key's type, for messages built with parson
+//
+// SCHEMA_SEND_TELEMETRY() and SCHEMA_UPDATE_DEVICE_TWIN() count their arguments at compile time:
+//
+//      SCHEMA_SEND_TELEMETRY(true, SCHEMA_TELEMETRY(ruleAlert, action->name),
+//                                  SCHEMA_TELEMETRY(ruleIndex, ruleIndex));
+
+// One id per key.  A key declared in two lists is a redeclaration error here.
+#define SCHEMA_GPIO_TWIN_ID(key, variable, fd, gpio, activeHigh, description) SCHEMA_ID_##key,
+#define SCHEMA_TWIN_ID(key, type, variable, handler, description) SCHEMA_ID_##key,
+#define SCHEMA_PROPERTY_ID(key, type, writable, description) SCHEMA_ID_##key,
+#define SCHEMA_TELEMETRY_ID(key, type, description) SCHEMA_ID_##key,
+typedef enum {
+    SCHEMA_GPIO_TWIN_LIST(SCHEMA_GPIO_TWIN_ID)
+    SCHEMA_TWIN_LIST(SCHEMA_TWIN_ID)
+    SCHEMA_PROPERTY_LIST(SCHEMA_PROPERTY_ID)
+    SCHEMA_TELEMETRY_LIST(SCHEMA_TELEMETRY_ID)
+    SCHEMA_KEY_COUNT
+} schemaKeyId_t;
+#undef SCHEMA_GPIO_TWIN_ID
+#undef SCHEMA_TWIN_ID
+#undef SCHEMA_PROPERTY_ID
+#undef SCHEMA_TELEMETRY_ID
+
+// The data_type_t of each key.  Properties and telemetry are kept apart so one can't be sent
+// as the other.
+#define SCHEMA_GPIO_TWIN_TYPE(key, variable, fd, gpio, activeHigh, description) SCHEMA_PROPERTY_TYPE_##key = TYPE_BOOL,
+#define SCHEMA_TWIN_TYPE(key, type, variable, handler, description) SCHEMA_PROPERTY_TYPE_##key = TYPE_##type,
+#define SCHEMA_PROPERTY_TYPE(key, type, writable, description) SCHEMA_PROPERTY_TYPE_##key = TYPE_##type,
+#define SCHEMA_TELEMETRY_TYPE(key, type, description) SCHEMA_TELEMETRY_TYPE_##key = TYPE_##type,
+enum {
+    SCHEMA_GPIO_TWIN_LIST(SCHEMA_GPIO_TWIN_TYPE)
+    SCHEMA_TWIN_LIST(SCHEMA_TWIN_TYPE)
+    SCHEMA_PROPERTY_LIST(SCHEMA_PROPERTY_TYPE)
+};
+enum {
+    SCHEMA_TELEMETRY_LIST(SCHEMA_TELEMETRY_TYPE)
+};
+#undef SCHEMA_GPIO_TWIN_TYPE
+#undef SCHEMA_TWIN_TYPE
+#undef SCHEMA_PROPERTY_TYPE
+#undef SCHEMA_TELEMETRY_TYPE
+
+// The C type a value of each schema type is passed as, and the type va_arg() reads it back as
+#define SCHEMA_C_TYPE_INT       int
+#define SCHEMA_C_TYPE_FLOAT     double
+#define SCHEMA_C_TYPE_BOOL      bool
+#define SCHEMA_C_TYPE_STRING    const char *
+#define SCHEMA_VA_TYPE_INT      int
+#define SCHEMA_VA_TYPE_FLOAT    double
+#define SCHEMA_VA_TYPE_BOOL     int
+#define SCHEMA_VA_TYPE_STRING   const char *
+
+// schemaValue_<key>() passes a value through as its key's type, a value that does not convert
+// (a string for a number, a number for a string) is a compile error
+#define SCHEMA_VALUE_FUNCTION(key, type) \
+    static inline SCHEMA_VA_TYPE_##type schemaValue_##key(SCHEMA_C_TYPE_##type value) { return value; }
+#define SCHEMA_GPIO_TWIN_VALUE(key, variable, fd, gpio, activeHigh, description) SCHEMA_VALUE_FUNCTION(key, BOOL)
+#define SCHEMA_TWIN_VALUE(key, type, variable, handler, description) SCHEMA_VALUE_FUNCTION(key, type)
+#define SCHEMA_PROPERTY_VALUE(key, type, writable, description) SCHEMA_VALUE_FUNCTION(key, type)
+#define SCHEMA_TELEMETRY_VALUE(key, type, description) SCHEMA_VALUE_FUNCTION(key, type)
+SCHEMA_GPIO_TWIN_LIST(SCHEMA_GPIO_TWIN_VALUE)
+SCHEMA_TWIN_LIST(SCHEMA_TWIN_VALUE)
+SCHEMA_PROPERTY_LIST(SCHEMA_PROPERTY_VALUE)
+SCHEMA_TELEMETRY_LIST(SCHEMA_TELEMETRY_VALUE)
+#undef SCHEMA_GPIO_TWIN_VALUE
+#undef SCHEMA_TWIN_VALUE
+#undef SCHEMA_PROPERTY_VALUE
+#undef SCHEMA_TELEMETRY_VALUE
+#undef SCHEMA_VALUE_FUNCTION
+
+// The key string.  This is an address constant so it can be used in static initializers.
+#define SCHEMA_KEY(key) (&#key[0 * SCHEMA_ID_##key])
+
+#define SCHEMA_TELEMETRY(key, value) SCHEMA_TELEMETRY_TYPE_##key, SCHEMA_KEY(key), schemaValue_##key(value)
+#define SCHEMA_PROPERTY(key, value) SCHEMA_PROPERTY_TYPE_##key, SCHEMA_KEY(key), schemaValue_##key(value)
+#define SCHEMA_VALUE(key, value) schemaValue_##key(value)
+
+// The variable behind a twinArray[] entry must have the twin's type, NULL when the handler keeps
+// its own.  STRING twins accept char and uint8_t buffers.
+#define SCHEMA_VARIABLE_INT(variable)    _Generic((variable), int *: (variable), void *: (variable))
+#define SCHEMA_VARIABLE_FLOAT(variable)  _Generic((variable), float *: (variable), void *: (variable))
+#define SCHEMA_VARIABLE_BOOL(variable)   _Generic((variable), bool *: (variable), void *: (variable))
+#define SCHEMA_VARIABLE_STRING(variable) _Generic((variable), char *: (variable), uint8_t *: (variable), void *: (variable))
+
+// Count the arguments SCHEMA_TELEMETRY() and SCHEMA_PROPERTY() expand to, up to 32 items
+#define SCHEMA_ARG_COUNT(...) SCHEMA_ARG_COUNT_N(__VA_ARGS__, \
+    96, 95, 94, 93, 92, 91, 90, 89, 88, 87, 86, 85, 84, 83, 82, 81, \
+    80, 79, 78, 77, 76, 75, 74, 73, 72, 71, 70, 69, 68, 67, 66, 65, \
+    64, 63, 62, 61, 60, 59, 58, 57, 56, 55, 54, 53, 52, 51, 50, 49, \
+    48, 47, 46, 45, 44, 43, 42, 41, 40, 39, 38, 37, 36, 35, 34, 33, \
+    32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17, \
+    16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1)
+#define SCHEMA_ARG_COUNT_N( \
+    _1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, \
+    _17, _18, _19, _20, _21, _22, _23, _24, _25, _26, _27, _28, _29, _30, _31, _32, \
+    _33, _34, _35, _36, _37, _38, _39, _40, _41, _42, _43, _44, _45, _46, _47, _48, \
+    _49, _50, _51, _52, _53, _54, _55, _56, _57, _58, _59, _60, _61, _62, _63, _64, \
+    _65, _66, _67, _68, _69, _70, _71, _72, _73, _74, _75, _76, _77, _78, _79, _80, \
+    _81, _82, _83, _84, _85, _86, _87, _88, _89, _90, _91, _92, _93, _94, _95, _96, \
+    N, ...) N
+
+#define SCHEMA_SEND_TELEMETRY(IoTConnectFormat, ...) \
+    Cloud_SendTelemetry(IoTConnectFormat, SCHEMA_ARG_COUNT(__VA_ARGS__), __VA_ARGS__)
+#define SCHEMA_UPDATE_DEVICE_TWIN(ioTRwFormat, ...) \
+    updateDeviceTwin(ioTRwFormat, SCHEMA_ARG_COUNT(__VA_ARGS__), __VA_ARGS__)
+
+#endif // SCHEMA_KEYS_H
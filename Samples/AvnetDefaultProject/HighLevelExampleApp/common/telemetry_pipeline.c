@@ -0,0 +1,778 @@
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Staged telemetry pipeline
+//
+//  pipeline_Push() is a sample observer (sample_observer.h).  Every sample published by the
+//  sensor path and the real time application raw data handlers is routed through every pipeline
+//  in the table main.c hands to pipeline_Init().  Each pipeline is a chain of small stages, each a name, one or two function
+//  pointers, a context and its own counters:
+//
+//      source -> filters -> aggregate -> encoder -> queue -> sink
+//
+//  Filters drop or adjust single samples.  The aggregate stage holds samples until the
+//  telemetry timer calls pipeline_FlushAll(), or until it is full.  On a flush the aggregate
+//  stage is drained into the encoder, each encoded message goes into the pipeline's queue of
+//  PIPELINE_QUEUE_DEPTH messages and the queue is sent to the sink.  A sink that isn't ready
+//  (not connected) leaves its messages queued for the next flush, when the queue is full the
+//  oldest message is dropped.  No stage allocates memory.
+//
+//  Binary encoding, version 1:
+//      version (1), key count, sample count
+//      time of the first sample in ms, uint32 little endian
+//      per key:
+//          key length, key (no NUL)
+//      per sample:
+//          key index
+//          ms from the first sample, zigzag varint
+//          value, float32 little endian
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "telemetry_pipeline.h"
+
+#ifdef ENABLE_TELEMETRY_PIPELINE
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+// applibs_versions.h defines the API struct versions to use for applibs APIs.
+#include "applibs_versions.h"
+#include <applibs/log.h>
+#include "app_log.h"
+#include <applibs/uart.h>
+#include "azure_iot.h"
+#include "../avnet/iotConnect.h"
+#include "../avnet/direct_methods.h"
+
+#define PIPELINE_BINARY_VERSION 1
+#define PIPELINE_BINARY_CONTENT_TYPE "application/octet-stream"
+#define PIPELINE_UART_BAUD_RATE 115200
+
+static pipeline_t **pipelines = NULL;
+static size_t pipelineCount = 0;
+
+static void Flush(pipeline_t *pipeline);
+static void QueueMessage(pipeline_t *pipeline, const pipelineMessage_t *message);
+static void SendQueued(pipeline_t *pipeline);
+static bool SameKey(const char *key1, const char *key2);
+static uint32_t ZigzagOffset(uint64_t timeMs, uint32_t baseMs);
+static size_t VarintLength(uint32_t value);
+
+ExitCode pipeline_Init(pipeline_t **pipelineTable, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+
+        pipeline_t *pipeline = pipelineTable[i];
+        if ((pipeline->aggregate.add == NULL) || (pipeline->aggregate.drain == NULL) ||
+            (pipeline->encoder.encode == NULL) || (pipeline->sink.send == NULL)) {
+            LOG_ERROR(APP_LOG_CAT_IOT, "ERROR: Telemetry pipeline %s is missing a stage\n", pipeline->name);
+            return ExitCode_Init_TelemetryPipeline;
+        }
+
+        for (size_t j = 0; j < pipeline->filterCount; j++) {
+            if (pipeline->filters[j].accept == NULL) {
+                LOG_ERROR(APP_LOG_CAT_IOT, "ERROR: Telemetry pipeline %s filter %zu has no accept function\n",
+                                           pipeline->name, j);
+                return ExitCode_Init_TelemetryPipeline;
+            }
+        }
+
+        if (pipeline->sink.textOnly && !pipeline->encoder.text) {
+            LOG_ERROR(APP_LOG_CAT_IOT, "ERROR: Telemetry pipeline %s: the %s sink can't carry %s messages\n",
+                                       pipeline->name, pipeline->sink.name, pipeline->encoder.name);
+            return ExitCode_Init_TelemetryPipeline;
+        }
+
+        LOG_INFO(APP_LOG_CAT_IOT, "Telemetry pipeline %s: %zu filter(s) -> %s -> %s -> %s\n", pipeline->name,
+                                  pipeline->filterCount, pipeline->aggregate.name, pipeline->encoder.name,
+                                  pipeline->sink.name);
+    }
+
+    pipelines = pipelineTable;
+    pipelineCount = count;
+    return ExitCode_Success;
+}
+
+void pipeline_Cleanup(void)
+{
+    // Hand the transports whatever they can still take
+    pipeline_FlushAll();
+
+    for (size_t i = 0; i < pipelineCount; i++) {
+        if (pipelines[i]->sink.cleanup != NULL) {
+            pipelines[i]->sink.cleanup(pipelines[i]->sink.context);
+        }
+    }
+
+    pipelines = NULL;
+    pipelineCount = 0;
+}
+
+void pipeline_Push(const char *key, float value, uint64_t timeMs)
+{
+    for (size_t i = 0; i < pipelineCount; i++) {
+
+        pipeline_t *pipeline = pipelines[i];
+        pipelineSample_t sample = {.key = key, .value = value, .timeMs = timeMs};
+
+        // JSON can't carry NaN or infinity
+        pipeline->source.in++;
+        if (!isfinite(value)) {
+            pipeline->source.dropped++;
+            continue;
+        }
+        pipeline->source.out++;
+
+        bool accepted = true;
+        for (size_t j = 0; (j < pipeline->filterCount) && accepted; j++) {
+
+            pipelineFilter_t *filter = &pipeline->filters[j];
+            filter->counters.in++;
+            accepted = filter->accept(filter->context, &sample);
+            if (accepted) {
+                filter->counters.out++;
+            }
+            else {
+                filter->counters.dropped++;
+            }
+        }
+
+        if (!accepted) {
+            continue;
+        }
+
+        // A full aggregate stage is flushed to make room
+        pipeline->aggregate.counters.in++;
+        if (!pipeline->aggregate.add(pipeline->aggregate.context, &sample)) {
+            Flush(pipeline);
+            if (!pipeline->aggregate.add(pipeline->aggregate.context, &sample)) {
+                pipeline->aggregate.counters.dropped++;
+            }
+        }
+    }
+}
+
+void pipeline_FlushAll(void)
+{
+    for (size_t i = 0; i < pipelineCount; i++) {
+        Flush(pipelines[i]);
+    }
+}
+
+/// <summary>
+///     Encode everything the aggregate stage holds and send the queue
+/// </summary>
+static void Flush(pipeline_t *pipeline)
+{
+    pipelineSample_t samples[PIPELINE_DRAIN_SAMPLES];
+    pipelineMessage_t message;
+    size_t count;
+
+    while ((count = pipeline->aggregate.drain(pipeline->aggregate.context, samples,
+                                              PIPELINE_DRAIN_SAMPLES)) > 0) {
+
+        pipeline->aggregate.counters.out += count;
+
+        for (size_t done = 0; done < count;) {
+
+            message.length = 0;
+            message.text = pipeline->encoder.text;
+            size_t used = pipeline->encoder.encode(pipeline->encoder.context, &samples[done],
+                                                   count - done, &message);
+
+            // The sample doesn't fit in an empty message
+            if (used == 0) {
+                pipeline->encoder.counters.in++;
+                pipeline->encoder.counters.dropped++;
+                done++;
+                continue;
+            }
+
+            pipeline->encoder.counters.in += used;
+            pipeline->encoder.counters.out++;
+            pipeline->encoder.counters.bytes += message.length;
+            done += used;
+
+            // Send as we go, the queue only fills while the sink can't send
+            QueueMessage(pipeline, &message);
+            SendQueued(pipeline);
+        }
+    }
+
+    SendQueued(pipeline);
+}
+
+/// <summary>
+///     Add a message to the queue, dropping the oldest if the queue is full
+/// </summary>
+static void QueueMessage(pipeline_t *pipeline, const pipelineMessage_t *message)
+{
+    if (pipeline->queueCount == PIPELINE_QUEUE_DEPTH) {
+        pipeline->queueHead = (pipeline->queueHead + 1) % PIPELINE_QUEUE_DEPTH;
+        pipeline->queueCount--;
+        pipeline->queue.dropped++;
+    }
+
+    size_t tail = (pipeline->queueHead + pipeline->queueCount) % PIPELINE_QUEUE_DEPTH;
+    memcpy(&pipeline->messages[tail], message, sizeof(pipelineMessage_t));
+    pipeline->queueCount++;
+    pipeline->queue.in++;
+    pipeline->queue.bytes += message->length;
+}
+
+/// <summary>
+///     Send queued messages, oldest first, until the queue is empty or the sink asks to retry
+/// </summary>
+static void SendQueued(pipeline_t *pipeline)
+{
+    while (pipeline->queueCount > 0) {
+
+        const pipelineMessage_t *message = &pipeline->messages[pipeline->queueHead];
+
+        pipeline->sink.counters.in++;
+        pipelineSinkResult_t result = pipeline->sink.send(pipeline->sink.context, message);
+        if (result == PIPELINE_SINK_RETRY) {
+            return;
+        }
+
+        if (result == PIPELINE_SINK_SENT) {
+            pipeline->sink.counters.out++;
+            pipeline->sink.counters.bytes += message->length;
+        }
+        else {
+            pipeline->sink.counters.dropped++;
+        }
+
+        pipeline->queueHead = (pipeline->queueHead + 1) % PIPELINE_QUEUE_DEPTH;
+        pipeline->queueCount--;
+        pipeline->queue.out++;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//  Filters
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool pipeline_KeySelectAccept(void *context, pipelineSample_t *sample)
+{
+    pipelineKeySelect_t *select = (pipelineKeySelect_t *)context;
+
+    for (size_t i = 0; i < select->keyCount; i++) {
+        if (SameKey(select->keys[i], sample->key)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool pipeline_DeadbandAccept(void *context, pipelineSample_t *sample)
+{
+    pipelineDeadband_t *deadband = (pipelineDeadband_t *)context;
+
+    for (size_t i = 0; i < deadband->channelCount; i++) {
+        if (SameKey(deadband->channels[i].key, sample->key)) {
+            if (fabsf(sample->value - deadband->channels[i].lastValue) < deadband->deadband) {
+                return false;
+            }
+            deadband->channels[i].lastValue = sample->value;
+            return true;
+        }
+    }
+
+    // The first sample on a channel always passes.  Once the table is full new channels
+    // aren't filtered.
+    if (deadband->channelCount < PIPELINE_MAX_CHANNELS) {
+        deadband->channels[deadband->channelCount].key = sample->key;
+        deadband->channels[deadband->channelCount].lastValue = sample->value;
+        deadband->channelCount++;
+    }
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//  Aggregates
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool pipeline_BatchAdd(void *context, const pipelineSample_t *sample)
+{
+    pipelineBatch_t *batch = (pipelineBatch_t *)context;
+
+    if (batch->count == PIPELINE_BATCH_SAMPLES) {
+        return false;
+    }
+    batch->samples[batch->count++] = *sample;
+    return true;
+}
+
+size_t pipeline_BatchDrain(void *context, pipelineSample_t *samples, size_t maxSamples)
+{
+    pipelineBatch_t *batch = (pipelineBatch_t *)context;
+
+    size_t count = batch->count - batch->drained;
+    if (count == 0) {
+        batch->count = 0;
+        batch->drained = 0;
+        return 0;
+    }
+
+    if (count > maxSamples) {
+        count = maxSamples;
+    }
+    memcpy(samples, &batch->samples[batch->drained], count * sizeof(pipelineSample_t));
+    batch->drained += count;
+    return count;
+}
+
+bool pipeline_ReduceAdd(void *context, const pipelineSample_t *sample)
+{
+    pipelineReduce_t *reduce = (pipelineReduce_t *)context;
+
+    size_t i;
+    for (i = 0; i < reduce->channelCount; i++) {
+        if (SameKey(reduce->channels[i].key, sample->key)) {
+            break;
+        }
+    }
+
+    if (i == reduce->channelCount) {
+        if (reduce->channelCount == PIPELINE_MAX_CHANNELS) {
+            return false;
+        }
+        reduce->channels[i].key = sample->key;
+        reduce->channels[i].count = 0;
+        reduce->channelCount++;
+    }
+
+    if (reduce->channels[i].count == 0) {
+        reduce->channels[i].value = sample->value;
+    }
+    else {
+        switch (reduce->mode) {
+        case PIPELINE_REDUCE_LATEST:
+            reduce->channels[i].value = sample->value;
+            break;
+        case PIPELINE_REDUCE_MEAN:
+            reduce->channels[i].value += sample->value;
+            break;
+        case PIPELINE_REDUCE_MIN:
+            reduce->channels[i].value = fminf(reduce->channels[i].value, sample->value);
+            break;
+        case PIPELINE_REDUCE_MAX:
+            reduce->channels[i].value = fmaxf(reduce->channels[i].value, sample->value);
+            break;
+        }
+    }
+    reduce->channels[i].count++;
+    reduce->channels[i].timeMs = sample->timeMs;
+    return true;
+}
+
+size_t pipeline_ReduceDrain(void *context, pipelineSample_t *samples, size_t maxSamples)
+{
+    pipelineReduce_t *reduce = (pipelineReduce_t *)context;
+    size_t count = 0;
+
+    // Channels keep their place in the table, a drained channel just has no samples
+    for (size_t i = 0; (i < reduce->channelCount) && (count < maxSamples); i++) {
+
+        if (reduce->channels[i].count == 0) {
+            continue;
+        }
+
+        samples[count].key = reduce->channels[i].key;
+        samples[count].value = reduce->channels[i].value;
+        samples[count].timeMs = reduce->channels[i].timeMs;
+        if (reduce->mode == PIPELINE_REDUCE_MEAN) {
+            samples[count].value /= (float)reduce->channels[i].count;
+        }
+        reduce->channels[i].count = 0;
+        count++;
+    }
+    return count;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//  Encoders
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t pipeline_EncodeJson(void *context, const pipelineSample_t *samples, size_t count,
+                           pipelineMessage_t *message)
+{
+    char *buffer = (char *)message->data;
+    size_t length = 1;
+    size_t used;
+
+    buffer[0] = '{';
+    for (used = 0; used < count; used++) {
+
+        // A JSON object can't repeat a key, repeated samples go in the next message
+        bool repeated = false;
+        for (size_t i = 0; (i < used) && !repeated; i++) {
+            repeated = SameKey(samples[i].key, samples[used].key);
+        }
+        if (repeated) {
+            break;
+        }
+
+        int written = snprintf(&buffer[length], sizeof(message->data) - length, "%s\"%s\":%.7g",
+                               (used == 0) ? "" : ",", samples[used].key, (double)samples[used].value);
+
+        // Leave room for the closing brace and the NUL
+        if ((written < 0) || (length + (size_t)written + 2 > sizeof(message->data))) {
+            break;
+        }
+        length += (size_t)written;
+    }
+
+    if (used == 0) {
+        return 0;
+    }
+
+    buffer[length++] = '}';
+    buffer[length] = '\0';
+    message->length = (uint16_t)length;
+    message->text = true;
+    return used;
+}
+
+size_t pipeline_EncodeBinary(void *context, const pipelineSample_t *samples, size_t count,
+                             pipelineMessage_t *message)
+{
+    const char *keys[PIPELINE_DRAIN_SAMPLES];
+    uint8_t keyIndex[PIPELINE_DRAIN_SAMPLES];
+    size_t keyCount = 0;
+    uint32_t baseMs = (uint32_t)samples[0].timeMs;
+    size_t length = 7;
+    size_t used;
+
+    if (count > PIPELINE_DRAIN_SAMPLES) {
+        count = PIPELINE_DRAIN_SAMPLES;
+    }
+
+    // Work out how many samples fit, each key is written once
+    for (used = 0; used < count; used++) {
+
+        size_t keyLength = strlen(samples[used].key);
+        if ((keyLength == 0) || (keyLength > UINT8_MAX)) {
+            break;
+        }
+
+        size_t index;
+        for (index = 0; (index < keyCount) && !SameKey(keys[index], samples[used].key); index++) {
+        }
+
+        size_t sampleLength = 1 + VarintLength(ZigzagOffset(samples[used].timeMs, baseMs)) + 4;
+        if (index == keyCount) {
+            sampleLength += 1 + keyLength;
+        }
+        if (length + sampleLength > sizeof(message->data)) {
+            break;
+        }
+
+        if (index == keyCount) {
+            keys[keyCount++] = samples[used].key;
+        }
+        keyIndex[used] = (uint8_t)index;
+        length += sampleLength;
+    }
+
+    if (used == 0) {
+        return 0;
+    }
+
+    uint8_t *buffer = message->data;
+    length = 0;
+    buffer[length++] = PIPELINE_BINARY_VERSION;
+    buffer[length++] = (uint8_t)keyCount;
+    buffer[length++] = (uint8_t)used;
+    for (int i = 0; i < 4; i++) {
+        buffer[length++] = (uint8_t)(baseMs >> (8 * i));
+    }
+
+    for (size_t i = 0; i < keyCount; i++) {
+        size_t keyLength = strlen(keys[i]);
+        buffer[length++] = (uint8_t)keyLength;
+        memcpy(&buffer[length], keys[i], keyLength);
+        length += keyLength;
+    }
+
+    for (size_t i = 0; i < used; i++) {
+
+        buffer[length++] = keyIndex[i];
+
+        uint32_t zigzag = ZigzagOffset(samples[i].timeMs, baseMs);
+        do {
+            buffer[length++] = (uint8_t)((zigzag & 0x7f) | ((zigzag > 0x7f) ? 0x80 : 0));
+            zigzag >>= 7;
+        } while (zigzag != 0);
+
+        uint32_t bits;
+        memcpy(&bits, &samples[i].value, sizeof(bits));
+        for (int j = 0; j < 4; j++) {
+            buffer[length++] = (uint8_t)(bits >> (8 * j));
+        }
+    }
+
+    message->length = (uint16_t)length;
+    message->text = false;
+    return used;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//  Sinks
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifdef IOT_HUB_APPLICATION
+/// <summary>
+///     Send the message as IoT Hub telemetry.  A message the client won't take (not connected or
+///     not authenticated) stays queued.
+/// </summary>
+pipelineSinkResult_t pipeline_IoTHubSend(void *context, const pipelineMessage_t *message)
+{
+    AzureIoT_Result result;
+
+    if (message->text) {
+        result = AzureIoT_SendTelemetry((const char *)message->data, NULL);
+    }
+    else {
+        result = AzureIoT_SendTelemetryBinary(message->data, message->length,
+                                              PIPELINE_BINARY_CONTENT_TYPE, NULL);
+    }
+
+    return (result == AzureIoT_Result_OK) ? PIPELINE_SINK_SENT : PIPELINE_SINK_RETRY;
+}
+
+#ifdef USE_IOT_CONNECT
+/// <summary>
+///     Wrap the JSON message in the IoTConnect envelope and send it as IoT Hub telemetry
+/// </summary>
+pipelineSinkResult_t pipeline_IoTConnectSend(void *context, const pipelineMessage_t *message)
+{
+    char ioTConnectMessage[PIPELINE_MESSAGE_BYTES + IOTC_TELEMETRY_OVERHEAD];
+
+    if (!IoTConnectIsConnected()) {
+        return PIPELINE_SINK_RETRY;
+    }
+
+    if (!FormatTelemetryForIoTConnect((const char *)message->data, ioTConnectMessage,
+                                      sizeof(ioTConnectMessage))) {
+        return PIPELINE_SINK_FAILED;
+    }
+
+    if (AzureIoT_SendTelemetry(ioTConnectMessage, NULL) != AzureIoT_Result_OK) {
+        return PIPELINE_SINK_RETRY;
+    }
+    return PIPELINE_SINK_SENT;
+}
+#endif // USE_IOT_CONNECT
+#endif // IOT_HUB_APPLICATION
+
+/// <summary>
+///     Write the message to a local UART
+/// </summary>
+pipelineSinkResult_t pipeline_UartSend(void *context, const pipelineMessage_t *message)
+{
+    pipelineUartSink_t *uart = (pipelineUartSink_t *)context;
+
+    if (!uart->opened) {
+        UART_Config uartConfig;
+        UART_InitConfig(&uartConfig);
+        uartConfig.baudRate = PIPELINE_UART_BAUD_RATE;
+        uartConfig.flowControl = UART_FlowControl_None;
+        uart->fd = UART_Open(uart->uartId, &uartConfig);
+        if (uart->fd < 0) {
+            LOG_ERROR(APP_LOG_CAT_IOT, "ERROR: Could not open pipeline UART: %s (%d).\n", strerror(errno), errno);
+            return PIPELINE_SINK_FAILED;
+        }
+        uart->opened = true;
+    }
+
+    uint8_t frame[2 + PIPELINE_MESSAGE_BYTES + 2];
+    size_t frameLength = 0;
+
+    if (message->text) {
+        memcpy(frame, message->data, message->length);
+        frameLength = message->length;
+        frame[frameLength++] = '\r';
+        frame[frameLength++] = '\n';
+    }
+    else {
+        frame[frameLength++] = (uint8_t)message->length;
+        frame[frameLength++] = (uint8_t)(message->length >> 8);
+        memcpy(&frame[frameLength], message->data, message->length);
+        frameLength += message->length;
+    }
+
+    // The UART is non-blocking.  If it can't take anything try again on the next flush, once
+    // part of a frame is written the rest has to follow.
+    size_t totalBytesSent = 0;
+    while (totalBytesSent < frameLength) {
+        ssize_t bytesSent = write(uart->fd, &frame[totalBytesSent], frameLength - totalBytesSent);
+        if (bytesSent < 0) {
+            if (errno != EAGAIN) {
+                LOG_ERROR_RL(APP_LOG_CAT_IOT, APP_LOG_RATE_LIMIT_MS, "ERROR: Could not write to pipeline UART: %s (%d).\n", strerror(errno), errno);
+                return PIPELINE_SINK_FAILED;
+            }
+            if (totalBytesSent == 0) {
+                return PIPELINE_SINK_RETRY;
+            }
+            continue;
+        }
+        totalBytesSent += (size_t)bytesSent;
+    }
+
+    return PIPELINE_SINK_SENT;
+}
+
+void pipeline_UartCleanup(void *context)
+{
+    pipelineUartSink_t *uart = (pipelineUartSink_t *)context;
+
+    if (uart->opened) {
+        close(uart->fd);
+        uart->opened = false;
+    }
+}
+
+/// <summary>
+///     Write the message to the debug log, binary messages as hex
+/// </summary>
+pipelineSinkResult_t pipeline_LogSend(void *context, const pipelineMessage_t *message)
+{
+    if (message->text) {
+        LOG_INFO(APP_LOG_CAT_IOT, "Pipeline: %s\n", (const char *)message->data);
+        return PIPELINE_SINK_SENT;
+    }
+
+    char hex[(2 * 32) + 1];
+    size_t hexBytes = (message->length < 32) ? message->length : 32;
+    for (size_t i = 0; i < hexBytes; i++) {
+        snprintf(&hex[2 * i], 3, "%02x", message->data[i]);
+    }
+    hex[2 * hexBytes] = '\0';
+
+    LOG_INFO(APP_LOG_CAT_IOT, "Pipeline: %u bytes %s%s\n", message->length, hex,
+                              (message->length > hexBytes) ? "..." : "");
+    return PIPELINE_SINK_SENT;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+//
+//  Functions for getPipelineStats directMethod
+//
+//  name: getPipelineStats
+//  Payload: {}
+//
+//  Returns the in, out, dropped and bytes counters of every stage of every pipeline,
+//  and the number of messages waiting in each queue
+//
+//////////////////////////////////////////////////////////////////////////////////////
+
+static void AddCounters(JSON_Object *rootObject, const char *pipelineName, const char *stageName,
+                        const pipelineCounters_t *counters)
+{
+    char keyBuffer[96];
+
+    snprintf(keyBuffer, sizeof(keyBuffer), "%s.%s.in", pipelineName, stageName);
+    json_object_dotset_number(rootObject, keyBuffer, counters->in);
+    snprintf(keyBuffer, sizeof(keyBuffer), "%s.%s.out", pipelineName, stageName);
+    json_object_dotset_number(rootObject, keyBuffer, counters->out);
+    snprintf(keyBuffer, sizeof(keyBuffer), "%s.%s.dropped", pipelineName, stageName);
+    json_object_dotset_number(rootObject, keyBuffer, counters->dropped);
+    snprintf(keyBuffer, sizeof(keyBuffer), "%s.%s.bytes", pipelineName, stageName);
+    json_object_dotset_number(rootObject, keyBuffer, counters->bytes);
+}
+
+int dmGetPipelineStatsHandlerFunction(JSON_Object *JsonPayloadObj, size_t payloadSize, char** responseMsg){
+
+    JSON_Value *rootValue = json_value_init_object();
+    JSON_Object *rootObject = json_value_get_object(rootValue);
+    char keyBuffer[96];
+
+    for (size_t i = 0; i < pipelineCount; i++) {
+
+        const pipeline_t *pipeline = pipelines[i];
+
+        AddCounters(rootObject, pipeline->name, "source", &pipeline->source);
+        for (size_t j = 0; j < pipeline->filterCount; j++) {
+            AddCounters(rootObject, pipeline->name, pipeline->filters[j].name, &pipeline->filters[j].counters);
+        }
+        AddCounters(rootObject, pipeline->name, pipeline->aggregate.name, &pipeline->aggregate.counters);
+        AddCounters(rootObject, pipeline->name, pipeline->encoder.name, &pipeline->encoder.counters);
+        AddCounters(rootObject, pipeline->name, "queue", &pipeline->queue);
+        AddCounters(rootObject, pipeline->name, pipeline->sink.name, &pipeline->sink.counters);
+
+        snprintf(keyBuffer, sizeof(keyBuffer), "%s.queue.waiting", pipeline->name);
+        json_object_dotset_number(rootObject, keyBuffer, pipeline->queueCount);
+    }
+
+    *responseMsg = dmSerializeResponse(rootValue);
+
+    if(*responseMsg == NULL){
+        LOG_ERROR(APP_LOG_CAT_DM, "ERROR: Could not allocate pipeline stats response\n");
+        return 400;
+    }
+
+    return 200;
+}
+
+/// <summary>
+///     Keys normally come from the same table entry or literal, only compare the strings if not
+/// </summary>
+static bool SameKey(const char *key1, const char *key2)
+{
+    return (key1 == key2) || (strcmp(key1, key2) == 0);
+}
+
+/// <summary>
+///     Milliseconds from baseMs, zigzag encoded.  Aggregated samples aren't always in time order,
+///     so the offset can be negative.
+/// </summary>
+static uint32_t ZigzagOffset(uint64_t timeMs, uint32_t baseMs)
+{
+    int32_t offsetMs = (int32_t)((uint32_t)timeMs - baseMs);
+    return ((uint32_t)offsetMs << 1) ^ (uint32_t)(offsetMs >> 31);
+}
+
+static size_t VarintLength(uint32_t value)
+{
+    size_t length = 1;
+    while (value > 0x7f) {
+        value >>= 7;
+        length++;
+    }
+    return length;
+}
+
+#endif // ENABLE_TELEMETRY_PIPELINE
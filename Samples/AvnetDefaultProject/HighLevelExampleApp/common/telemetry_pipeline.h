@@ -0,0 +1,271 @@
+#ifndef TELEMETRY_PIPELINE_H
+#define TELEMETRY_PIPELINE_H
+
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "build_options.h"
+
+// Bytes in one encoded message, the largest payload a pipeline hands to its sink
+#ifndef PIPELINE_MESSAGE_BYTES
+#define PIPELINE_MESSAGE_BYTES 512
+#endif
+
+// Encoded messages each pipeline holds while its sink can't send them.  When the queue is full
+// the oldest message is dropped.
+#ifndef PIPELINE_QUEUE_DEPTH
+#define PIPELINE_QUEUE_DEPTH 4
+#endif
+
+// Most samples the aggregate stage hands to the encoder at once
+#ifndef PIPELINE_DRAIN_SAMPLES
+#define PIPELINE_DRAIN_SAMPLES 16
+#endif
+
+// Samples held by pipelineBatch_t, and channels tracked by pipelineReduce_t and
+// pipelineDeadband_t
+#ifndef PIPELINE_BATCH_SAMPLES
+#define PIPELINE_BATCH_SAMPLES 32
+#endif
+#ifndef PIPELINE_MAX_CHANNELS
+#define PIPELINE_MAX_CHANNELS 16
+#endif
+
+// One reading on its way through a pipeline
+typedef struct {
+    const char *key;            // Not copied, must stay valid (string literal or table entry)
+    float value;
+    uint64_t timeMs;            // CLOCK_MONOTONIC, when the sample was published
+} pipelineSample_t;
+
+// Every stage counts what it was given, what it passed on and what it dropped.  bytes counts
+// encoded bytes out of the encoder, queue and sink.
+typedef struct {
+    uint32_t in;
+    uint32_t out;
+    uint32_t dropped;
+    uint32_t bytes;
+} pipelineCounters_t;
+
+// An encoded message
+typedef struct {
+    uint16_t length;
+    bool text;                  // NUL terminated after length bytes, safe to use as a string
+    uint8_t data[PIPELINE_MESSAGE_BYTES];
+} pipelineMessage_t;
+
+typedef enum {
+    PIPELINE_SINK_SENT,         // The message was handed to the transport
+    PIPELINE_SINK_RETRY,        // The transport isn't ready, keep the message queued
+    PIPELINE_SINK_FAILED        // The message can never be sent, drop it
+} pipelineSinkResult_t;
+
+// Filter stage: return false to drop the sample.  The sample may be modified (scaled, clamped).
+typedef struct {
+    const char *name;
+    bool (*accept)(void *context, pipelineSample_t *sample);
+    void *context;
+    pipelineCounters_t counters;
+} pipelineFilter_t;
+
+// Aggregate stage: add() returns false when the stage is full.  The pipeline then flushes and
+// adds the sample again.  drain() copies out up to maxSamples samples for the encoder and is
+// called until it returns 0.
+typedef struct {
+    const char *name;
+    bool (*add)(void *context, const pipelineSample_t *sample);
+    size_t (*drain)(void *context, pipelineSample_t *samples, size_t maxSamples);
+    void *context;
+    pipelineCounters_t counters;
+} pipelineAggregate_t;
+
+// Encoder stage: encode as many of the samples as fit into message and return how many were
+// used.  The pipeline calls it again with the rest.
+typedef struct {
+    const char *name;
+    size_t (*encode)(void *context, const pipelineSample_t *samples, size_t count,
+                     pipelineMessage_t *message);
+    void *context;
+    bool text;                  // Produces text messages, see pipelineSink_t.textOnly
+    pipelineCounters_t counters;
+} pipelineEncoder_t;
+
+// Sink stage: hands one message to a transport.  cleanup may be NULL.
+typedef struct {
+    const char *name;
+    pipelineSinkResult_t (*send)(void *context, const pipelineMessage_t *message);
+    void (*cleanup)(void *context);
+    void *context;
+    bool textOnly;              // Can only carry messages from a text encoder
+    pipelineCounters_t counters;
+} pipelineSink_t;
+
+// source -> filters -> aggregate -> encoder -> queue -> sink
+typedef struct {
+    const char *name;
+    pipelineFilter_t *filters;  // Run in order, may be NULL
+    size_t filterCount;
+    pipelineAggregate_t aggregate;
+    pipelineEncoder_t encoder;
+    pipelineSink_t sink;
+
+    // Managed by the pipeline
+    pipelineCounters_t source;
+    pipelineCounters_t queue;
+    pipelineMessage_t messages[PIPELINE_QUEUE_DEPTH];
+    size_t queueHead;
+    size_t queueCount;
+} pipeline_t;
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//  Built in stage contexts
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Only pass the listed keys
+typedef struct {
+    const char *const *keys;
+    size_t keyCount;
+} pipelineKeySelect_t;
+
+// Drop samples that are within deadband of the last value passed on the same channel
+typedef struct {
+    float deadband;
+    size_t channelCount;
+    struct {
+        const char *key;
+        float lastValue;
+    } channels[PIPELINE_MAX_CHANNELS];
+} pipelineDeadband_t;
+
+// Every sample in arrival order
+typedef struct {
+    size_t count;
+    size_t drained;
+    pipelineSample_t samples[PIPELINE_BATCH_SAMPLES];
+} pipelineBatch_t;
+
+typedef enum {
+    PIPELINE_REDUCE_LATEST,
+    PIPELINE_REDUCE_MEAN,
+    PIPELINE_REDUCE_MIN,
+    PIPELINE_REDUCE_MAX
+} pipelineReduceMode_t;
+
+// One sample per channel per flush
+typedef struct {
+    pipelineReduceMode_t mode;
+    size_t channelCount;
+    struct {
+        const char *key;
+        float value;            // Running sum for PIPELINE_REDUCE_MEAN
+        uint32_t count;
+        uint64_t timeMs;        // Time of the latest sample
+    } channels[PIPELINE_MAX_CHANNELS];
+} pipelineReduce_t;
+
+// Local UART transport, opened on the first send.  Text messages are written as lines, binary
+// messages with a two byte little endian length in front.
+typedef struct {
+    int uartId;                 // From the hardware definition, add it to the manifest's Uart list
+    bool opened;
+    int fd;
+} pipelineUartSink_t;
+
+#ifdef ENABLE_TELEMETRY_PIPELINE
+
+#include "exitcodes.h"
+#include "parson.h"
+
+bool pipeline_KeySelectAccept(void *context, pipelineSample_t *sample);
+bool pipeline_DeadbandAccept(void *context, pipelineSample_t *sample);
+
+bool pipeline_BatchAdd(void *context, const pipelineSample_t *sample);
+size_t pipeline_BatchDrain(void *context, pipelineSample_t *samples, size_t maxSamples);
+bool pipeline_ReduceAdd(void *context, const pipelineSample_t *sample);
+size_t pipeline_ReduceDrain(void *context, pipelineSample_t *samples, size_t maxSamples);
+
+size_t pipeline_EncodeJson(void *context, const pipelineSample_t *samples, size_t count,
+                           pipelineMessage_t *message);
+size_t pipeline_EncodeBinary(void *context, const pipelineSample_t *samples, size_t count,
+                             pipelineMessage_t *message);
+
+#ifdef IOT_HUB_APPLICATION
+pipelineSinkResult_t pipeline_IoTHubSend(void *context, const pipelineMessage_t *message);
+#ifdef USE_IOT_CONNECT
+pipelineSinkResult_t pipeline_IoTConnectSend(void *context, const pipelineMessage_t *message);
+#endif // USE_IOT_CONNECT
+#endif // IOT_HUB_APPLICATION
+pipelineSinkResult_t pipeline_UartSend(void *context, const pipelineMessage_t *message);
+void pipeline_UartCleanup(void *context);
+pipelineSinkResult_t pipeline_LogSend(void *context, const pipelineMessage_t *message);
+
+// Stage initializers for the built in stages, for example
+//      .aggregate = PIPELINE_REDUCE_STAGE(&sensorMeans),
+//      .encoder = PIPELINE_JSON_ENCODER,
+//      .sink = PIPELINE_IOT_HUB_SINK,
+#define PIPELINE_KEY_SELECT_FILTER(ctx) {.name = "keySelect", .accept = pipeline_KeySelectAccept, .context = (ctx)}
+#define PIPELINE_DEADBAND_FILTER(ctx) {.name = "deadband", .accept = pipeline_DeadbandAccept, .context = (ctx)}
+#define PIPELINE_BATCH_STAGE(ctx) {.name = "batch", .add = pipeline_BatchAdd, .drain = pipeline_BatchDrain, .context = (ctx)}
+#define PIPELINE_REDUCE_STAGE(ctx) {.name = "reduce", .add = pipeline_ReduceAdd, .drain = pipeline_ReduceDrain, .context = (ctx)}
+#define PIPELINE_JSON_ENCODER {.name = "json", .encode = pipeline_EncodeJson, .text = true}
+#define PIPELINE_BINARY_ENCODER {.name = "binary", .encode = pipeline_EncodeBinary, .text = false}
+#define PIPELINE_IOT_HUB_SINK {.name = "iotHub", .send = pipeline_IoTHubSend}
+#define PIPELINE_IOT_CONNECT_SINK {.name = "iotConnect", .send = pipeline_IoTConnectSend, .textOnly = true}
+#define PIPELINE_UART_SINK(ctx) {.name = "uart", .send = pipeline_UartSend, .cleanup = pipeline_UartCleanup, .context = (ctx)}
+#define PIPELINE_LOG_SINK {.name = "log", .send = pipeline_LogSend}
+
+/// <summary>
+///     Check each pipeline's stages and start routing samples to them.  The table and the
+///     pipelines must stay valid until pipeline_Cleanup().
+/// </summary>
+ExitCode pipeline_Init(pipeline_t **pipelineTable, size_t count);
+
+/// <summary>
+///     Send what each pipeline has queued, then stop routing samples
+/// </summary>
+void pipeline_Cleanup(void);
+
+/// <summary>
+///     Pass a sample to every pipeline
+/// </summary>
+void pipeline_Push(const char *key, float value, uint64_t timeMs);
+
+/// <summary>
+///     Drain each pipeline's aggregate stage, encode the samples and send the queued messages
+/// </summary>
+void pipeline_FlushAll(void);
+
+// Direct method handler
+int dmGetPipelineStatsHandlerFunction(JSON_Object *JsonPayloadObj, size_t payloadSize, char** responsePayload);
+
+#endif // ENABLE_TELEMETRY_PIPELINE
+
+#endif // TELEMETRY_PIPELINE_H
@@ -0,0 +1,695 @@
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Compressed in-RAM time series store
+//
+//  Keeps the recent history of every channel published to the sample observers
+//  (sample_observer.h) in a static pool of fixed size blocks, using the Gorilla encoding adapted
+//  to 32 bit floats and ms timestamps:
+//
+//  Timestamps: The first sample of a block is kept in the block header.  Each following sample
+//  writes the change in its delta from the previous one (delta-of-delta):
+//
+//      0                   '0'
+//      -63 .. 64           '10'   + 7 bits
+//      -255 .. 256         '110'  + 9 bits
+//      -2047 .. 2048       '1110' + 12 bits
+//      anything else       '1111' + 32 bits
+//
+//  Sensors polled from a timer almost always write the single '0' bit.
+//
+//  Values: Each value is XOR'd with the previous one.  An unchanged value writes '0'.  If the
+//  meaningful (non zero) bits of the XOR fit inside the previous window '10' is followed by the
+//  bits in that window, otherwise '11' is followed by 5 bits of leading zeros, 5 bits of
+//  (length - 1) and the meaningful bits.  Quantized sensor readings that move by a few LSBs share
+//  most of their sign, exponent and high mantissa bits so the XOR is short.
+//
+//  A block is closed when the next sample would not fit.  When no block is free the oldest block
+//  of the channel holding the most blocks is reused, so the store always holds the most recent
+//  history and a fast channel can't push a slow one out entirely.
+//
+//  Samples are read back with tsStore_Iterate() or as min/max/mean buckets with
+//  tsStore_Downsample().  The getHistory direct method returns a downsampled range to the cloud.
+//
+//  HostTools/bench/ts_bench.c reports the bytes per sample and the encode and decode rates.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "timeseries_store.h"
+#include "../avnet/direct_methods.h"
+
+#ifdef ENABLE_TIMESERIES_STORE
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <applibs/log.h>
+#include "app_log.h"
+#include "channel_stats.h"
+#include "monotonic_time.h"
+
+_Static_assert(sizeof(tsBlock_t) == TS_STORE_BLOCK_BYTES, "tsBlock_t header size changed");
+_Static_assert((TS_STORE_BLOCK_COUNT >= 2) && (TS_STORE_BLOCK_COUNT < INT16_MAX),
+               "Block index must fit an int16_t");
+_Static_assert(TS_STORE_MAX_CHANNELS < INT8_MAX, "Channel index must fit an int8_t");
+
+#define TS_STORE_NO_WINDOW 0xFF
+#define TS_STORE_NO_BLOCK (-1)
+
+// Bit reader over one block's data
+typedef struct {
+    const tsBlock_t *block;
+    uint32_t bitPos;
+    uint16_t remaining;         // Samples left in the block
+    uint64_t timeMs;
+    uint32_t deltaMs;
+    uint32_t value;
+    uint8_t leadingZeros;
+    uint8_t trailingZeros;
+} tsDecoder_t;
+
+static tsBlock_t blocks[TS_STORE_BLOCK_COUNT];
+static tsChannel_t channels[TS_STORE_MAX_CHANNELS];
+static int channelCount = 0;
+static int16_t freeList = TS_STORE_NO_BLOCK;
+static bool initialized = false;
+
+static tsChannel_t *FindChannel(const char *name, bool add);
+static int16_t AllocateBlock(int channelIndex);
+static void StartBlock(tsBlock_t *block, uint64_t timeMs, uint32_t value);
+static bool EncodeSample(tsBlock_t *block, uint64_t timeMs, uint32_t value);
+static void WriteBits(tsBlock_t *block, uint32_t value, int bits);
+static uint32_t ReadBits(tsDecoder_t *decoder, int bits);
+static void DecoderStart(tsDecoder_t *decoder, const tsBlock_t *block);
+static void DecoderNext(tsDecoder_t *decoder);
+
+bool tsStore_Append(const char *channelName, uint64_t timeMs, float value)
+{
+    if (!initialized) {
+        tsStore_Reset();
+    }
+
+    tsChannel_t *channel = FindChannel(channelName, true);
+    if (channel == NULL) {
+        return false;
+    }
+
+    uint32_t valueBits;
+    memcpy(&valueBits, &value, sizeof(valueBits));
+
+    if (channel->newest != TS_STORE_NO_BLOCK) {
+
+        tsBlock_t *block = &blocks[channel->newest];
+        if (timeMs < block->lastTimeMs) {
+            return false;
+        }
+
+        if (EncodeSample(block, timeMs, valueBits)) {
+            channel->sampleCount++;
+            return true;
+        }
+    }
+
+    // First sample or the newest block is full, start a new block
+    int channelIndex = (int)(channel - channels);
+    int16_t index = AllocateBlock(channelIndex);
+
+    StartBlock(&blocks[index], timeMs, valueBits);
+    if (channel->newest == TS_STORE_NO_BLOCK) {
+        channel->oldest = index;
+    }
+    else {
+        blocks[channel->newest].next = index;
+    }
+    channel->newest = index;
+    channel->blockCount++;
+    channel->sampleCount++;
+
+    return true;
+}
+
+int tsStore_Iterate(const char *channelName, uint64_t fromMs, uint64_t toMs, tsSampleCallback_t callback,
+                    void *context)
+{
+    const tsChannel_t *channel = tsStore_GetChannel(channelName);
+    if (channel == NULL) {
+        return 0;
+    }
+
+    int count = 0;
+    for (int16_t index = channel->oldest; index != TS_STORE_NO_BLOCK; index = blocks[index].next) {
+
+        const tsBlock_t *block = &blocks[index];
+        if (block->lastTimeMs < fromMs) {
+            continue;
+        }
+        if (block->firstTimeMs > toMs) {
+            break;
+        }
+
+        tsDecoder_t decoder;
+        DecoderStart(&decoder, block);
+
+        while (true) {
+
+            if (decoder.timeMs > toMs) {
+                return count;
+            }
+
+            if (decoder.timeMs >= fromMs) {
+
+                float value;
+                memcpy(&value, &decoder.value, sizeof(value));
+                count++;
+
+                if (!callback(decoder.timeMs, value, context)) {
+                    return count;
+                }
+            }
+
+            if (decoder.remaining == 0) {
+                break;
+            }
+            DecoderNext(&decoder);
+        }
+    }
+
+    return count;
+}
+
+typedef struct {
+    uint64_t fromMs;
+    uint64_t bucketMs;
+    tsBucket_t *buckets;
+    int bucketCount;
+    double *sums;
+} downsampleContext_t;
+
+static bool DownsampleSample(uint64_t timeMs, float value, void *context)
+{
+    downsampleContext_t *downsample = (downsampleContext_t *)context;
+
+    uint64_t bucketIndex = (timeMs - downsample->fromMs) / downsample->bucketMs;
+    if (bucketIndex >= (uint64_t)downsample->bucketCount) {
+        bucketIndex = (uint64_t)downsample->bucketCount - 1;
+    }
+
+    tsBucket_t *bucket = &downsample->buckets[bucketIndex];
+    if (bucket->count == 0) {
+        bucket->min = value;
+        bucket->max = value;
+    }
+    else {
+        bucket->min = (value < bucket->min) ? value : bucket->min;
+        bucket->max = (value > bucket->max) ? value : bucket->max;
+    }
+    bucket->count++;
+    downsample->sums[bucketIndex] += value;
+
+    return true;
+}
+
+int tsStore_Downsample(const char *channelName, uint64_t fromMs, uint64_t toMs, tsBucket_t *buckets,
+                       int bucketCount)
+{
+    if ((bucketCount <= 0) || (bucketCount > TS_STORE_MAX_POINTS) || (toMs < fromMs)) {
+        return 0;
+    }
+
+    double sums[TS_STORE_MAX_POINTS] = {0};
+    downsampleContext_t downsample = {
+        .fromMs = fromMs,
+        .bucketMs = ((toMs - fromMs) / (uint64_t)bucketCount) + 1,
+        .buckets = buckets,
+        .bucketCount = bucketCount,
+        .sums = sums
+    };
+
+    for (int i = 0; i < bucketCount; i++) {
+        memset(&buckets[i], 0, sizeof(tsBucket_t));
+        buckets[i].startMs = fromMs + ((uint64_t)i * downsample.bucketMs);
+    }
+
+    int count = tsStore_Iterate(channelName, fromMs, toMs, DownsampleSample, &downsample);
+
+    for (int i = 0; i < bucketCount; i++) {
+        if (buckets[i].count != 0) {
+            buckets[i].mean = (float)(sums[i] / (double)buckets[i].count);
+        }
+    }
+
+    return count;
+}
+
+const tsChannel_t *tsStore_GetChannel(const char *channelName)
+{
+    return FindChannel(channelName, false);
+}
+
+uint32_t tsStore_ChannelBytes(const tsChannel_t *channel)
+{
+    uint32_t bytes = 0;
+    for (int16_t index = channel->oldest; index != TS_STORE_NO_BLOCK; index = blocks[index].next) {
+        bytes += TS_STORE_BLOCK_HEADER_BYTES + ((blocks[index].bitCount + 7u) / 8u);
+    }
+    return bytes;
+}
+
+void tsStore_Reset(void)
+{
+    // Chain every block onto the free list
+    for (int i = 0; i < TS_STORE_BLOCK_COUNT; i++) {
+        blocks[i].channel = -1;
+        blocks[i].next = (i + 1 < TS_STORE_BLOCK_COUNT) ? (int16_t)(i + 1) : TS_STORE_NO_BLOCK;
+    }
+    freeList = 0;
+    channelCount = 0;
+    initialized = true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+//
+//  Functions for getHistory directMethod
+//
+//  name: getHistory
+//  Payload: {"channel": "wifiRssi", "seconds": 300, "points": 30}
+//
+//  With a channel, returns the last "seconds" (default 300) of the channel split
+//  into "points" (default 30, max TS_STORE_MAX_POINTS) buckets.  Each bucket has
+//  its age in seconds, sample count, min, max and mean, empty buckets are left out.
+//
+//  Without a channel, returns the stored samples, bytes and history length of
+//  every channel.
+//
+//////////////////////////////////////////////////////////////////////////////////////
+
+int dmGetHistoryHandlerFunction(JSON_Object *JsonPayloadObj, size_t payloadSize, char** responseMsg){
+
+    JSON_Value *rootValue = json_value_init_object();
+    JSON_Object *rootObject = json_value_get_object(rootValue);
+    uint64_t now = monotonicMs();
+    char keyBuffer[64];
+
+    const char *channelName = NULL;
+    int seconds = 300;
+    int points = 30;
+
+    if (JsonPayloadObj != NULL) {
+        channelName = json_object_get_string(JsonPayloadObj, "channel");
+        if (json_object_has_value_of_type(JsonPayloadObj, "seconds", JSONNumber)) {
+            seconds = (int)json_object_get_number(JsonPayloadObj, "seconds");
+        }
+        if (json_object_has_value_of_type(JsonPayloadObj, "points", JSONNumber)) {
+            points = (int)json_object_get_number(JsonPayloadObj, "points");
+        }
+    }
+
+    if ((seconds <= 0) || (points <= 0) || (points > TS_STORE_MAX_POINTS)) {
+        json_value_free(rootValue);
+        return 400;
+    }
+
+    if (channelName == NULL) {
+
+        int freeBlocks = 0;
+        for (int16_t index = freeList; index != TS_STORE_NO_BLOCK; index = blocks[index].next) {
+            freeBlocks++;
+        }
+        json_object_dotset_number(rootObject, "blocks", TS_STORE_BLOCK_COUNT);
+        json_object_dotset_number(rootObject, "freeBlocks", initialized ? freeBlocks : TS_STORE_BLOCK_COUNT);
+
+        for (int i = 0; i < channelCount; i++) {
+
+            const tsChannel_t *channel = &channels[i];
+            snprintf(keyBuffer, sizeof(keyBuffer), "channels.%s.samples", channel->name);
+            json_object_dotset_number(rootObject, keyBuffer, channel->sampleCount);
+            snprintf(keyBuffer, sizeof(keyBuffer), "channels.%s.evicted", channel->name);
+            json_object_dotset_number(rootObject, keyBuffer, channel->evictedCount);
+            snprintf(keyBuffer, sizeof(keyBuffer), "channels.%s.bytes", channel->name);
+            json_object_dotset_number(rootObject, keyBuffer, tsStore_ChannelBytes(channel));
+            if (channel->oldest != TS_STORE_NO_BLOCK) {
+                snprintf(keyBuffer, sizeof(keyBuffer), "channels.%s.historySeconds", channel->name);
+                json_object_dotset_number(rootObject, keyBuffer,
+                                          (double)(now - blocks[channel->oldest].firstTimeMs) / 1000.0);
+            }
+        }
+    }
+    else {
+
+        if (tsStore_GetChannel(channelName) == NULL) {
+            json_value_free(rootValue);
+            return 400;
+        }
+
+        tsBucket_t buckets[TS_STORE_MAX_POINTS];
+        uint64_t spanMs = (uint64_t)seconds * 1000;
+        uint64_t fromMs = (now > spanMs) ? (now - spanMs) : 0;
+        int samples = tsStore_Downsample(channelName, fromMs, now, buckets, points);
+
+        JSON_Value *pointsValue = json_value_init_array();
+        JSON_Array *pointsArray = json_value_get_array(pointsValue);
+
+        for (int i = 0; i < points; i++) {
+
+            if (buckets[i].count == 0) {
+                continue;
+            }
+
+            JSON_Value *pointValue = json_value_init_object();
+            JSON_Object *pointObject = json_value_get_object(pointValue);
+            json_object_set_number(pointObject, "ageSeconds", (double)(now - buckets[i].startMs) / 1000.0);
+            json_object_set_number(pointObject, "count", buckets[i].count);
+            json_object_set_number(pointObject, "min", buckets[i].min);
+            json_object_set_number(pointObject, "max", buckets[i].max);
+            json_object_set_number(pointObject, "mean", buckets[i].mean);
+            json_array_append_value(pointsArray, pointValue);
+        }
+
+        json_object_set_string(rootObject, "channel", channelName);
+        json_object_set_number(rootObject, "samples", samples);
+        json_object_set_value(rootObject, "points", pointsValue);
+    }
+
+    *responseMsg = dmSerializeResponse(rootValue);
+
+    if(*responseMsg == NULL){
+        LOG_ERROR(APP_LOG_CAT_DM, "ERROR: Could not allocate history response\n");
+        return 400;
+    }
+
+    return 200;
+}
+
+/// <summary>
+///     Find a channel by name, optionally adding it if there's room
+/// </summary>
+static tsChannel_t *FindChannel(const char *name, bool add)
+{
+    int previousCount = channelCount;
+    tsChannel_t *channel = CHANNEL_TABLE_FIND(channels, channelCount, name, add);
+
+    if (channelCount != previousCount) {
+        channel->oldest = TS_STORE_NO_BLOCK;
+        channel->newest = TS_STORE_NO_BLOCK;
+    }
+    return channel;
+}
+
+/// <summary>
+///     Take a block from the free list, or reuse the oldest block of the channel with the most
+///     blocks.  The requesting channel's own newest block is never taken.
+/// </summary>
+static int16_t AllocateBlock(int channelIndex)
+{
+    int16_t index = freeList;
+
+    if (index != TS_STORE_NO_BLOCK) {
+        freeList = blocks[index].next;
+    }
+    else {
+
+        // Pick the victim, on a tie the channel with the oldest history gives up a block
+        tsChannel_t *victim = NULL;
+        for (int i = 0; i < channelCount; i++) {
+
+            tsChannel_t *candidate = &channels[i];
+            int minimumBlocks = (i == channelIndex) ? 2 : 1;
+            if (candidate->blockCount < minimumBlocks) {
+                continue;
+            }
+
+            if ((victim == NULL) || (candidate->blockCount > victim->blockCount) ||
+                ((candidate->blockCount == victim->blockCount) &&
+                 (blocks[candidate->oldest].firstTimeMs < blocks[victim->oldest].firstTimeMs))) {
+                victim = candidate;
+            }
+        }
+
+        // With at least two blocks in the pool there is always a victim
+        index = victim->oldest;
+        victim->oldest = blocks[index].next;
+        if (victim->oldest == TS_STORE_NO_BLOCK) {
+            victim->newest = TS_STORE_NO_BLOCK;
+        }
+        victim->blockCount--;
+        victim->sampleCount -= blocks[index].sampleCount;
+        victim->evictedCount += blocks[index].sampleCount;
+    }
+
+    blocks[index].channel = (int8_t)channelIndex;
+    blocks[index].next = TS_STORE_NO_BLOCK;
+    return index;
+}
+
+static void StartBlock(tsBlock_t *block, uint64_t timeMs, uint32_t value)
+{
+    block->firstTimeMs = timeMs;
+    block->lastTimeMs = timeMs;
+    block->firstValue = value;
+    block->lastValue = value;
+    block->lastDeltaMs = 0;
+    block->sampleCount = 1;
+    block->bitCount = 0;
+    block->leadingZeros = TS_STORE_NO_WINDOW;
+    block->trailingZeros = 0;
+}
+
+/// <summary>
+///     Append a sample to the block's bit stream, returns false without writing anything if
+///     the sample doesn't fit
+/// </summary>
+static bool EncodeSample(tsBlock_t *block, uint64_t timeMs, uint32_t value)
+{
+    // Blocks cover at most ~24 days, a longer gap starts a new block
+    if (timeMs - block->lastTimeMs > INT32_MAX) {
+        return false;
+    }
+
+    uint32_t deltaMs = (uint32_t)(timeMs - block->lastTimeMs);
+    int32_t deltaOfDelta = (int32_t)deltaMs - (int32_t)block->lastDeltaMs;
+
+    int timeBits;
+    if (deltaOfDelta == 0) {
+        timeBits = 1;
+    }
+    else if ((deltaOfDelta >= -63) && (deltaOfDelta <= 64)) {
+        timeBits = 2 + 7;
+    }
+    else if ((deltaOfDelta >= -255) && (deltaOfDelta <= 256)) {
+        timeBits = 3 + 9;
+    }
+    else if ((deltaOfDelta >= -2047) && (deltaOfDelta <= 2048)) {
+        timeBits = 4 + 12;
+    }
+    else {
+        timeBits = 4 + 32;
+    }
+
+    uint32_t xorValue = value ^ block->lastValue;
+    int leadingZeros = 0;
+    int trailingZeros = 0;
+    bool reuseWindow = false;
+    int valueBits = 1;
+
+    if (xorValue != 0) {
+
+        leadingZeros = __builtin_clz(xorValue);
+        trailingZeros = __builtin_ctz(xorValue);
+
+        reuseWindow = (block->leadingZeros != TS_STORE_NO_WINDOW) &&
+                      (leadingZeros >= block->leadingZeros) && (trailingZeros >= block->trailingZeros);
+
+        if (reuseWindow) {
+            valueBits = 2 + (32 - block->leadingZeros - block->trailingZeros);
+        }
+        else {
+            valueBits = 2 + 5 + 5 + (32 - leadingZeros - trailingZeros);
+        }
+    }
+
+    if ((block->bitCount + timeBits + valueBits > TS_STORE_BLOCK_DATA_BYTES * 8) ||
+        (block->sampleCount == UINT16_MAX)) {
+        return false;
+    }
+
+    // Timestamp
+    if (deltaOfDelta == 0) {
+        WriteBits(block, 0x0, 1);
+    }
+    else if (timeBits == 2 + 7) {
+        WriteBits(block, 0x2, 2);
+        WriteBits(block, (uint32_t)(deltaOfDelta + 63), 7);
+    }
+    else if (timeBits == 3 + 9) {
+        WriteBits(block, 0x6, 3);
+        WriteBits(block, (uint32_t)(deltaOfDelta + 255), 9);
+    }
+    else if (timeBits == 4 + 12) {
+        WriteBits(block, 0xE, 4);
+        WriteBits(block, (uint32_t)(deltaOfDelta + 2047), 12);
+    }
+    else {
+        WriteBits(block, 0xF, 4);
+        WriteBits(block, (uint32_t)deltaOfDelta, 32);
+    }
+
+    // Value
+    if (xorValue == 0) {
+        WriteBits(block, 0x0, 1);
+    }
+    else if (reuseWindow) {
+        WriteBits(block, 0x2, 2);
+        WriteBits(block, xorValue >> block->trailingZeros, 32 - block->leadingZeros - block->trailingZeros);
+    }
+    else {
+        int meaningfulBits = 32 - leadingZeros - trailingZeros;
+        WriteBits(block, 0x3, 2);
+        WriteBits(block, (uint32_t)leadingZeros, 5);
+        WriteBits(block, (uint32_t)(meaningfulBits - 1), 5);
+        WriteBits(block, xorValue >> trailingZeros, meaningfulBits);
+        block->leadingZeros = (uint8_t)leadingZeros;
+        block->trailingZeros = (uint8_t)trailingZeros;
+    }
+
+    block->lastTimeMs = timeMs;
+    block->lastDeltaMs = deltaMs;
+    block->lastValue = value;
+    block->sampleCount++;
+    return true;
+}
+
+/// <summary>
+///     Write the low "bits" bits of value, most significant first
+/// </summary>
+static void WriteBits(tsBlock_t *block, uint32_t value, int bits)
+{
+    while (bits > 0) {
+
+        int byteIndex = block->bitCount / 8;
+        int bitOffset = block->bitCount % 8;
+        int take = 8 - bitOffset;
+        if (take > bits) {
+            take = bits;
+        }
+
+        // Reused blocks aren't cleared, start each byte from zero
+        if (bitOffset == 0) {
+            block->data[byteIndex] = 0;
+        }
+
+        uint32_t chunk = (value >> (bits - take)) & ((1u << take) - 1u);
+        block->data[byteIndex] |= (uint8_t)(chunk << (8 - bitOffset - take));
+
+        block->bitCount += (uint16_t)take;
+        bits -= take;
+    }
+}
+
+static uint32_t ReadBits(tsDecoder_t *decoder, int bits)
+{
+    uint32_t value = 0;
+
+    while (bits > 0) {
+
+        int bitOffset = (int)(decoder->bitPos % 8);
+        int take = 8 - bitOffset;
+        if (take > bits) {
+            take = bits;
+        }
+
+        uint32_t byte = decoder->block->data[decoder->bitPos / 8];
+        uint32_t chunk = (byte >> (8 - bitOffset - take)) & ((1u << take) - 1u);
+        value = (value << take) | chunk;
+
+        decoder->bitPos += (uint32_t)take;
+        bits -= take;
+    }
+
+    return value;
+}
+
+/// <summary>
+///     Position the decoder on the block's first sample
+/// </summary>
+static void DecoderStart(tsDecoder_t *decoder, const tsBlock_t *block)
+{
+    decoder->block = block;
+    decoder->bitPos = 0;
+    decoder->remaining = (uint16_t)(block->sampleCount - 1);
+    decoder->timeMs = block->firstTimeMs;
+    decoder->deltaMs = 0;
+    decoder->value = block->firstValue;
+    decoder->leadingZeros = 0;
+    decoder->trailingZeros = 0;
+}
+
+/// <summary>
+///     Decode the next sample, the caller checks remaining first
+/// </summary>
+static void DecoderNext(tsDecoder_t *decoder)
+{
+    int32_t deltaOfDelta;
+
+    if (ReadBits(decoder, 1) == 0) {
+        deltaOfDelta = 0;
+    }
+    else if (ReadBits(decoder, 1) == 0) {
+        deltaOfDelta = (int32_t)ReadBits(decoder, 7) - 63;
+    }
+    else if (ReadBits(decoder, 1) == 0) {
+        deltaOfDelta = (int32_t)ReadBits(decoder, 9) - 255;
+    }
+    else if (ReadBits(decoder, 1) == 0) {
+        deltaOfDelta = (int32_t)ReadBits(decoder, 12) - 2047;
+    }
+    else {
+        deltaOfDelta = (int32_t)ReadBits(decoder, 32);
+    }
+
+    decoder->deltaMs = (uint32_t)((int32_t)decoder->deltaMs + deltaOfDelta);
+    decoder->timeMs += decoder->deltaMs;
+
+    if (ReadBits(decoder, 1) == 1) {
+
+        if (ReadBits(decoder, 1) == 1) {
+            decoder->leadingZeros = (uint8_t)ReadBits(decoder, 5);
+            int meaningfulBits = (int)ReadBits(decoder, 5) + 1;
+            decoder->trailingZeros = (uint8_t)(32 - decoder->leadingZeros - meaningfulBits);
+        }
+
+        int meaningfulBits = 32 - decoder->leadingZeros - decoder->trailingZeros;
+        decoder->value ^= ReadBits(decoder, meaningfulBits) << decoder->trailingZeros;
+    }
+
+    decoder->remaining--;
+}
+
+#endif // ENABLE_TIMESERIES_STORE
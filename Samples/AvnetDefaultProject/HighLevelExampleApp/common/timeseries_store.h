@@ -0,0 +1,142 @@
+#ifndef TIMESERIES_STORE_H
+#define TIMESERIES_STORE_H
+
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "build_options.h"
+
+// Size of one compressed block including its header.  The pool is TS_STORE_BLOCK_COUNT blocks.
+#ifndef TS_STORE_BLOCK_BYTES
+#define TS_STORE_BLOCK_BYTES 256
+#endif
+
+#ifndef TS_STORE_BLOCK_COUNT
+#define TS_STORE_BLOCK_COUNT 64
+#endif
+
+// Most channels stored at once, samples for any further channels are ignored
+#ifndef TS_STORE_MAX_CHANNELS
+#define TS_STORE_MAX_CHANNELS 16
+#endif
+
+// Most points returned by the getHistory direct method
+#define TS_STORE_MAX_POINTS 60
+
+// Block header fields, the rest of the block is the compressed bit stream
+#define TS_STORE_BLOCK_HEADER_BYTES 40
+#define TS_STORE_BLOCK_DATA_BYTES (TS_STORE_BLOCK_BYTES - TS_STORE_BLOCK_HEADER_BYTES)
+
+// One fixed size block of compressed samples.  The first sample is kept in the header, every
+// sample after it is written to data[] as a delta-of-delta timestamp and an XOR'd float.
+typedef struct {
+    uint64_t firstTimeMs;
+    uint64_t lastTimeMs;
+    uint32_t firstValue;        // IEEE 754 bits
+    uint32_t lastValue;
+    uint32_t lastDeltaMs;
+    uint16_t sampleCount;
+    uint16_t bitCount;          // Bits used in data[]
+    uint8_t leadingZeros;       // Meaningful bit window of the last XOR, TS_STORE_NO_WINDOW if none
+    uint8_t trailingZeros;
+    int8_t channel;             // Owning channel, -1 when the block is free
+    uint8_t reserved;
+    int16_t next;               // Next newer block of the same channel, -1 at the end
+    uint8_t data[TS_STORE_BLOCK_DATA_BYTES];
+} tsBlock_t;
+
+typedef struct {
+    const char *name;           // Not copied, must stay valid (string literal or table entry)
+    int16_t oldest;             // Block list, oldest to newest
+    int16_t newest;
+    uint16_t blockCount;
+    uint32_t sampleCount;       // Samples currently stored
+    uint32_t evictedCount;      // Samples dropped to make room for newer ones
+} tsChannel_t;
+
+// One bucket of a downsampled readout
+typedef struct {
+    uint64_t startMs;
+    uint32_t count;             // Zero if there were no samples in the bucket
+    float min;
+    float max;
+    float mean;
+} tsBucket_t;
+
+// Called for each sample in a range, return false to stop
+typedef bool (*tsSampleCallback_t)(uint64_t timeMs, float value, void *context);
+
+#ifdef ENABLE_TIMESERIES_STORE
+
+#include "parson.h"
+
+/// <summary>
+///     Append a sample to the channel, adding the channel if there's room.  Returns false if the
+///     channel could not be added or timeMs is older than the channel's newest sample.  When the
+///     pool is full the oldest block of the channel with the most blocks is reused.
+/// </summary>
+bool tsStore_Append(const char *channel, uint64_t timeMs, float value);
+
+/// <summary>
+///     Call the callback for each of the channel's samples with fromMs <= time <= toMs, oldest
+///     first.  Returns the number of samples passed to the callback.
+/// </summary>
+int tsStore_Iterate(const char *channel, uint64_t fromMs, uint64_t toMs, tsSampleCallback_t callback,
+                    void *context);
+
+/// <summary>
+///     Split fromMs to toMs into bucketCount equal buckets and fill in the min, max and mean of
+///     the channel's samples in each.  Returns the number of samples read.
+/// </summary>
+int tsStore_Downsample(const char *channel, uint64_t fromMs, uint64_t toMs, tsBucket_t *buckets,
+                       int bucketCount);
+
+/// <summary>
+///     Find a channel by name, NULL if nothing was ever stored for it
+/// </summary>
+const tsChannel_t *tsStore_GetChannel(const char *channel);
+
+/// <summary>
+///     Bytes of compressed data held by a channel, block headers included
+/// </summary>
+uint32_t tsStore_ChannelBytes(const tsChannel_t *channel);
+
+/// <summary>
+///     Release every block and forget all channels
+/// </summary>
+void tsStore_Reset(void);
+
+// Direct method handler
+int dmGetHistoryHandlerFunction(JSON_Object *JsonPayloadObj, size_t payloadSize, char** responsePayload);
+
+#endif // ENABLE_TIMESERIES_STORE
+
+#endif // TIMESERIES_STORE_H
@@ -0,0 +1,315 @@
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Binary trace ring
+//
+//  Hot paths call TRACE(eventId, arg0, arg1) to write a 16 byte record into a RAM ring buffer.
+//  Writing a record is a relaxed atomic increment, a clock read and four stores, there is no
+//  formatting and no I/O.  The ring always holds the most recent TRACE_RING_ENTRIES records.
+//
+//  The ring can be dumped two ways
+//
+//  1. Direct method dumpTrace: returns the ring as base64 in the response payload
+//     {"version": 1, "recordSize": 16, "records": n, "written": total, "data": "<base64>"}
+//     Send {"target": "log"} to write the dump to the debug output instead, or {"target": "blob"}
+//     to upload the ring as "TRACE <hex>" lines to the blob trace-<written>.log (ENABLE_BLOB_UPLOAD).
+//
+//  2. traceRing_DumpToLog(): writes one "TRACE <hex>" line per record to the debug output.  The
+//     application calls this on exit when exiting with an error.
+//
+//  Use HostTools/trace_decode to turn either dump into a timeline.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "trace_ring.h"
+
+#ifdef ENABLE_TRACE_RING
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <applibs/log.h>
+
+#include "cloud_blob.h"
+#include "monotonic_time.h"
+
+#if (TRACE_RING_ENTRIES & (TRACE_RING_ENTRIES - 1)) != 0
+#error "TRACE_RING_ENTRIES must be a power of two"
+#endif
+
+static traceRecord_t traceRing[TRACE_RING_ENTRIES];
+
+// Total number of records written, the ring index is the low bits
+static uint32_t traceWriteIndex = 0;
+
+static const char base64Table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static uint32_t copyRing(traceRecord_t *outRecords, uint32_t maxRecords, uint32_t *written);
+static size_t base64Encode(const uint8_t *in, size_t inLen, char *out);
+static void formatLine(const traceRecord_t *record, char *line);
+
+#ifdef ENABLE_BLOB_UPLOAD
+// "TRACE " + 32 hex digits + newline, the format traceRing_DumpToLog() writes
+#define TRACE_BLOB_LINE_BYTES (6 + (sizeof(traceRecord_t) * 2) + 1)
+
+// First record index of the blob being uploaded
+static uint32_t traceBlobStart = 0;
+
+static int uploadTraceBlob(void);
+static int traceBlobSource(size_t offset, unsigned char *buffer, size_t size, void *context);
+#endif // ENABLE_BLOB_UPLOAD
+
+/// <summary>
+///     Write a record into the trace ring
+/// </summary>
+void traceRing_Write(traceEvent_t eventId, uint32_t arg0, uint32_t arg1){
+
+    uint32_t timestampUs = (uint32_t)monotonicUs();
+
+    uint32_t index = __atomic_fetch_add(&traceWriteIndex, 1, __ATOMIC_RELAXED);
+    traceRecord_t *record = &traceRing[index & (TRACE_RING_ENTRIES - 1)];
+
+    record->timestampUs = timestampUs;
+    record->eventId = (uint16_t)eventId;
+    record->sequence = (uint16_t)index;
+    record->arg0 = arg0;
+    record->arg1 = arg1;
+}
+
+/// <summary>
+///     Write the ring contents, oldest record first, to the debug output
+/// </summary>
+void traceRing_DumpToLog(void){
+
+    traceRecord_t *records = malloc(sizeof(traceRing));
+    if(records == NULL){
+        Log_Debug("ERROR: Could not allocate memory for the trace dump\n");
+        return;
+    }
+
+    uint32_t written;
+    uint32_t count = copyRing(records, TRACE_RING_ENTRIES, &written);
+
+    Log_Debug("TRACE-BEGIN version=%d records=%u written=%u\n", TRACE_FORMAT_VERSION, count, written);
+    for(uint32_t i = 0; i < count; i++){
+
+        char hexLine[(sizeof(traceRecord_t) * 2) + 1];
+        formatLine(&records[i], hexLine);
+        Log_Debug("TRACE %s\n", hexLine);
+    }
+    Log_Debug("TRACE-END\n");
+
+    free(records);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+//
+//  Functions for dumpTrace directMethod
+//
+//  name: dumpTrace
+//  Payload: {}, {"records": <n>}, {"target": "log"} or {"target": "blob"}
+//
+//////////////////////////////////////////////////////////////////////////////////////
+
+int dmDumpTraceHandlerFunction(JSON_Object *JsonPayloadObj, size_t payloadSize, char** responseMsg){
+
+    uint32_t maxRecords = TRACE_RING_ENTRIES;
+    *responseMsg = NULL;
+
+    if(JsonPayloadObj != NULL){
+
+        // Write the dump to the debug output and return the canned success response
+        const char *target = json_object_get_string(JsonPayloadObj, "target");
+        if((target != NULL) && (strcmp(target, "log") == 0)){
+            TRACE(TRACE_EVT_TRACE_DUMP, TRACE_RING_ENTRIES, 0);
+            traceRing_DumpToLog();
+            return 200;
+        }
+
+#ifdef ENABLE_BLOB_UPLOAD
+        // Upload the ring, the direct method returns as soon as the upload has started
+        if((target != NULL) && (strcmp(target, "blob") == 0)){
+            return uploadTraceBlob();
+        }
+#endif // ENABLE_BLOB_UPLOAD
+
+        if(json_object_has_value_of_type(JsonPayloadObj, "records", JSONNumber)){
+            int requested = (int)json_object_get_number(JsonPayloadObj, "records");
+            if((requested <= 0) || (requested > TRACE_RING_ENTRIES)){
+                Log_Debug("ERROR: records must be between 1 and %d\n", TRACE_RING_ENTRIES);
+                return 400;
+            }
+            maxRecords = (uint32_t)requested;
+        }
+    }
+
+    TRACE(TRACE_EVT_TRACE_DUMP, maxRecords, 0);
+
+    traceRecord_t *records = malloc(maxRecords * sizeof(traceRecord_t));
+    if(records == NULL){
+        Log_Debug("ERROR: Could not allocate memory for the trace dump\n");
+        return 400;
+    }
+
+    uint32_t written;
+    uint32_t count = copyRing(records, maxRecords, &written);
+
+    // The Azure IoT library frees the response with free()
+    static const char responseFormat[] = "{\"version\":%d,\"recordSize\":%d,\"records\":%u,\"written\":%u,\"data\":\"";
+    size_t dataSize = count * sizeof(traceRecord_t);
+    size_t responseSize = sizeof(responseFormat) + 48 + (((dataSize + 2) / 3) * 4) + 3;
+
+    *responseMsg = malloc(responseSize);
+    if(*responseMsg == NULL){
+        Log_Debug("ERROR: Could not allocate memory for the trace dump\n");
+        free(records);
+        return 400;
+    }
+
+    int offset = snprintf(*responseMsg, responseSize, responseFormat, TRACE_FORMAT_VERSION, 
+                          (int)sizeof(traceRecord_t), count, written);
+    offset += base64Encode((const uint8_t *)records, dataSize, &(*responseMsg)[offset]);
+    strcpy(&(*responseMsg)[offset], "\"}");
+
+    free(records);
+    return 200;
+}
+
+/// <summary>
+///     Copy up to maxRecords of the most recent records out of the ring, oldest record first.
+///     Returns the number of records copied.
+/// </summary>
+static uint32_t copyRing(traceRecord_t *outRecords, uint32_t maxRecords, uint32_t *written){
+
+    uint32_t end = __atomic_load_n(&traceWriteIndex, __ATOMIC_ACQUIRE);
+    uint32_t count = (end < TRACE_RING_ENTRIES) ? end : TRACE_RING_ENTRIES;
+    if(count > maxRecords){
+        count = maxRecords;
+    }
+
+    uint32_t start = end - count;
+    for(uint32_t i = 0; i < count; i++){
+        outRecords[i] = traceRing[(start + i) & (TRACE_RING_ENTRIES - 1)];
+    }
+
+    *written = end;
+    return count;
+}
+
+/// <summary>
+///     Write a record as 32 hex digits and a null terminator
+/// </summary>
+static void formatLine(const traceRecord_t *record, char *line){
+
+    static const char hexDigits[] = "0123456789abcdef";
+    const uint8_t *bytes = (const uint8_t *)record;
+
+    for(size_t j = 0; j < sizeof(traceRecord_t); j++){
+        line[j * 2] = hexDigits[bytes[j] >> 4];
+        line[(j * 2) + 1] = hexDigits[bytes[j] & 0x0F];
+    }
+    line[sizeof(traceRecord_t) * 2] = '\0';
+}
+
+#ifdef ENABLE_BLOB_UPLOAD
+/// <summary>
+///     Start uploading the records in the ring.  The ring is not copied, each block is read
+///     from the ring as the upload reaches it, so records written while the upload runs can
+///     replace the oldest records in the blob.  trace_decode shows them by their sequence number.
+/// </summary>
+static int uploadTraceBlob(void){
+
+    uint32_t end = __atomic_load_n(&traceWriteIndex, __ATOMIC_ACQUIRE);
+    uint32_t count = (end < TRACE_RING_ENTRIES) ? end : TRACE_RING_ENTRIES;
+    if(count == 0){
+        return 400;
+    }
+    traceBlobStart = end - count;
+
+    char blobName[32];
+    snprintf(blobName, sizeof(blobName), "trace-%u.log", end);
+
+    TRACE(TRACE_EVT_TRACE_DUMP, count, 0);
+    return cloudBlob_Upload(blobName, count * TRACE_BLOB_LINE_BYTES, traceBlobSource, NULL, NULL) ? 200 : 400;
+}
+
+/// <summary>
+///     Blob source callback, formats the lines covering offset to offset + size
+/// </summary>
+static int traceBlobSource(size_t offset, unsigned char *buffer, size_t size, void *context){
+
+    size_t copied = 0;
+
+    while(copied < size){
+
+        size_t lineIndex = (offset + copied) / TRACE_BLOB_LINE_BYTES;
+        size_t lineOffset = (offset + copied) % TRACE_BLOB_LINE_BYTES;
+
+        char line[TRACE_BLOB_LINE_BYTES + 1];
+        memcpy(line, "TRACE ", 6);
+        formatLine(&traceRing[(traceBlobStart + lineIndex) & (TRACE_RING_ENTRIES - 1)], &line[6]);
+        line[TRACE_BLOB_LINE_BYTES - 1] = '\n';
+
+        size_t length = TRACE_BLOB_LINE_BYTES - lineOffset;
+        if(length > size - copied){
+            length = size - copied;
+        }
+        memcpy(&buffer[copied], &line[lineOffset], length);
+        copied += length;
+    }
+
+    return (int)copied;
+}
+#endif // ENABLE_BLOB_UPLOAD
+
+/// <summary>
+///     Base64 encode inLen bytes, returns the number of characters written (not null terminated)
+/// </summary>
+static size_t base64Encode(const uint8_t *in, size_t inLen, char *out){
+
+    size_t outLen = 0;
+
+    for(size_t i = 0; i < inLen; i += 3){
+
+        uint32_t triple = (uint32_t)in[i] << 16;
+        if(i + 1 < inLen) triple |= (uint32_t)in[i + 1] << 8;
+        if(i + 2 < inLen) triple |= in[i + 2];
+
+        out[outLen++] = base64Table[(triple >> 18) & 0x3F];
+        out[outLen++] = base64Table[(triple >> 12) & 0x3F];
+        out[outLen++] = (i + 1 < inLen) ? base64Table[(triple >> 6) & 0x3F] : '=';
+        out[outLen++] = (i + 2 < inLen) ? base64Table[triple & 0x3F] : '=';
+    }
+
+    return outLen;
+}
+
+#endif // ENABLE_TRACE_RING
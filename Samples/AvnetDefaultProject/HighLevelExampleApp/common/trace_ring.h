@@ -0,0 +1,97 @@
+#ifndef TRACE_RING_H
+#define TRACE_RING_H
+
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+// Note: This header is also included by the host side trace decoder (HostTools/trace_decode.c)
+// so it must not pull in any Azure Sphere specific headers.
+
+#include <stdint.h>
+#include "build_options.h"
+
+// Increment when the record layout changes, the decoder checks this value
+#define TRACE_FORMAT_VERSION 1
+
+// Number of records in the ring, must be a power of two.  Each record is 16 bytes.
+#ifndef TRACE_RING_ENTRIES
+#define TRACE_RING_ENTRIES 1024
+#endif
+
+// Define the trace events.  X(id, "name", "arg0", "arg1")
+// The argument names are only used by the decoder to label the output.
+#define TRACE_EVENT_LIST(X) \
+    X(TRACE_EVT_NONE,              "none",             "",          "") \
+    X(TRACE_EVT_TELEMETRY_SEND,    "telemetrySend",    "length",    "result") \
+    X(TRACE_EVT_TELEMETRY_ACK,     "telemetryAck",     "result",    "context") \
+    X(TRACE_EVT_TWIN_RX,           "twinRx",           "length",    "updateState") \
+    X(TRACE_EVT_TWIN_REPORT,       "twinReport",       "length",    "result") \
+    X(TRACE_EVT_TWIN_REPORT_ACK,   "twinReportAck",    "status",    "context") \
+    X(TRACE_EVT_DOWORK_START,      "doWorkStart",      "",          "") \
+    X(TRACE_EVT_DOWORK_END,        "doWorkEnd",        "",          "") \
+    X(TRACE_EVT_CONNECTION_STATUS, "connectionStatus", "result",    "reason") \
+    X(TRACE_EVT_DIRECT_METHOD,     "directMethod",     "length",    "httpResult") \
+    X(TRACE_EVT_I2C_WRITE,         "i2cWrite",         "address",   "result") \
+    X(TRACE_EVT_M4_TX,             "m4Tx",             "command",   "bytesSent") \
+    X(TRACE_EVT_M4_RX,             "m4Rx",             "command",   "bytesReceived") \
+    X(TRACE_EVT_TRACE_DUMP,        "traceDump",        "records",   "")
+
+#define TRACE_EVENT_ENUM(id, name, arg0, arg1) id,
+typedef enum {
+    TRACE_EVENT_LIST(TRACE_EVENT_ENUM)
+    TRACE_EVT_COUNT
+} traceEvent_t;
+#undef TRACE_EVENT_ENUM
+
+// Define the trace record, this is the layout of the binary dump
+typedef struct {
+    uint32_t timestampUs;   // CLOCK_MONOTONIC in microseconds, wraps every ~71 minutes
+    uint16_t eventId;       // traceEvent_t
+    uint16_t sequence;      // Low 16 bits of the record's write index
+    uint32_t arg0;
+    uint32_t arg1;
+} traceRecord_t;
+
+#ifdef ENABLE_TRACE_RING
+
+#include "parson.h"
+
+void traceRing_Write(traceEvent_t eventId, uint32_t arg0, uint32_t arg1);
+void traceRing_DumpToLog(void);
+
+// Direct method handler
+int dmDumpTraceHandlerFunction(JSON_Object *JsonPayloadObj, size_t payloadSize, char** responsePayload);
+
+#define TRACE(eventId, arg0, arg1) traceRing_Write(eventId, (uint32_t)(arg0), (uint32_t)(arg1))
+
+#else
+
+#define TRACE(eventId, arg0, arg1)
+
+#endif // ENABLE_TRACE_RING
+
+#endif // TRACE_RING_H
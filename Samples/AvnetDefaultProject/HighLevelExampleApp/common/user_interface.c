@@ -10,6 +10,10 @@
 #include "user_interface.h"
 #include "build_options.h"
 #include "../avnet/oled.h"
+#include "../avnet/mem_accounting.h"
+#include "boot_timeline.h"
+#include "../avnet/sensor_registry.h"
+#include "schema_keys.h"
 
 // The following #include imports a "sample appliance" definition. This app comes with multiple
 // implementations of the sample appliance, each in a separate directory, which allow the code to
@@ -176,6 +180,7 @@ ExitCode UserInterface_Initialise(EventLoop *el,
 
     // Initialize the i2c buss to drive the OLED
     lp_imu_initialize();
+    BOOT_MARK(BOOT_PHASE_I2C_OLED);
 
     // Set up a timer to drive quick oled updates.
     static const struct timespec oledUpdatePeriod = {.tv_sec = 0, .tv_nsec = 100 * 1000 * 1000};
@@ -291,13 +296,34 @@ void checkMemoryUsageHighWaterMark(void)
     if(currentMax > memoryHighWaterMark){
 
         memoryHighWaterMark = currentMax;
-        Log_Debug("Memory High Water Mark: %d KiB\n", currentMax);
+        Log_Debug("Memory High Water Mark: %zu KiB\n", currentMax);
 
 #ifdef IOT_HUB_APPLICATION    
         
         // Send the reported property to the IoTHub    
-        updateDeviceTwin(true, ARGS_PER_TWIN_ITEM*1, TYPE_INT, "MemoryHighWaterKB", (int)memoryHighWaterMark);
+        SCHEMA_UPDATE_DEVICE_TWIN(true, SCHEMA_PROPERTY(MemoryHighWaterKB, (int)memoryHighWaterMark));
 
 #endif         
     }
+
+#ifdef ENABLE_HEAP_ACCOUNTING
+    // Report any per module heap peaks that have grown
+    memAcct_ReportPeaks();
+#endif // ENABLE_HEAP_ACCOUNTING
+}
+
+#ifdef ENABLE_SENSOR_REGISTRY
+/// <summary>
+///     Sensor registry read function for the memory high water mark
+/// </summary>
+bool readMemorySensor(void *thisSensor)
+{
+    sensor_t *sensor = (sensor_t*)thisSensor;
+
+    // Reports the high water mark as a device twin when it grows
+    checkMemoryUsageHighWaterMark();
+
+    sensor->values[0] = (float)Applications_GetPeakUserModeMemoryUsageInKB();
+    return true;
 }
+#endif // ENABLE_SENSOR_REGISTRY
@@ -0,0 +1,333 @@
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Wakeup and CPU duty profile
+//
+//  Every event loop timer created with eventloop_timer_utilities and every profiled I/O handler
+//  is a wakeup source.  Each dispatch is counted and the time spent in the handler is added to
+//  the source's busy time.  Comparing busy time to wall time gives the CPU duty for each source,
+//  and comparing dispatch counts shows what is waking the CPU.
+//
+//  Timers are named after their handler function, see eventloop_timer_utilities.h.  I/O handlers
+//  call wakeupProfile_Register() with their own name and wrap the handler in
+//  wakeupProfile_Begin()/wakeupProfile_End().
+//
+//  The main loop calls WAKEUP_PROFILE_LOOP_WAKE() each time EventLoop_Run() returns.  One wakeup
+//  can dispatch more than one handler when several sources are ready at the same time.
+//
+//  Every WAKEUP_PROFILE_SUMMARY_PERIOD_SECONDS the figures for the last period are written to the
+//  debug output and sent as telemetry.  The getWakeupProfile direct method returns the totals
+//  since the application started or since the last reset.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "wakeup_profile.h"
+
+#ifdef ENABLE_WAKEUP_PROFILE
+
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <applibs/log.h>
+#include "app_log.h"
+
+#include "eventloop_timer_utilities.h"
+#include "cloud.h"
+#include "../avnet/device_twin.h"
+#include "schema_keys.h"
+#include "monotonic_time.h"
+#include "../avnet/direct_methods.h"
+
+extern volatile sig_atomic_t exitCode;
+
+struct wakeupSource {
+    const char *name;
+    uint32_t dispatches;
+    uint64_t busyUs;
+    uint64_t maxUs;
+    uint32_t summaryDispatches;     // dispatches when the last summary was sent
+    uint64_t summaryBusyUs;         // busyUs when the last summary was sent
+};
+
+static wakeupSource_t sources[WAKEUP_PROFILE_MAX_SOURCES];
+static int sourceCount = 0;
+static wakeupSource_t otherSource = {.name = "other"};
+
+static uint64_t profileStartUs = 0;
+static uint32_t loopWakes = 0;
+static uint64_t summaryStartUs = 0;
+static uint32_t summaryLoopWakes = 0;
+
+static EventLoopTimer *wakeupSummaryTimer = NULL;
+
+static uint32_t dutyPpm(uint64_t busyUs, uint64_t elapsedUs);
+static void WakeupSummaryTimerEventHandler(EventLoopTimer *timer);
+
+/// <summary>
+///     Start the periodic summary timer
+/// </summary>
+ExitCode wakeupProfile_Init(EventLoop *eventLoop){
+
+    if(profileStartUs == 0){
+        profileStartUs = monotonicUs();
+    }
+    summaryStartUs = monotonicUs();
+
+    static const struct timespec summaryPeriod = {.tv_sec = WAKEUP_PROFILE_SUMMARY_PERIOD_SECONDS, .tv_nsec = 0};
+    wakeupSummaryTimer = CreateEventLoopPeriodicTimer(eventLoop, &WakeupSummaryTimerEventHandler, &summaryPeriod);
+    if(wakeupSummaryTimer == NULL){
+        return ExitCode_Init_WakeupProfileTimer;
+    }
+
+    return ExitCode_Success;
+}
+
+void wakeupProfile_Cleanup(void){
+
+    DisposeEventLoopTimer(wakeupSummaryTimer);
+    wakeupSummaryTimer = NULL;
+}
+
+/// <summary>
+///     Find or add the source with this name.  The name must remain valid for the life of the
+///     application, string literals and table entries are fine.
+/// </summary>
+wakeupSource_t *wakeupProfile_Register(const char *name){
+
+    if(profileStartUs == 0){
+        profileStartUs = monotonicUs();
+    }
+
+    // Timers are named from the handler argument, which may be written as &handler
+    if(name[0] == '&'){
+        name++;
+    }
+
+    for(int i = 0; i < sourceCount; i++){
+        if(strcmp(sources[i].name, name) == 0){
+            return &sources[i];
+        }
+    }
+
+    if(sourceCount == WAKEUP_PROFILE_MAX_SOURCES){
+        return &otherSource;
+    }
+
+    sources[sourceCount].name = name;
+    return &sources[sourceCount++];
+}
+
+/// <summary>
+///     Call before running a handler, pass the return value to wakeupProfile_End()
+/// </summary>
+uint64_t wakeupProfile_Begin(void){
+
+    return monotonicUs();
+}
+
+/// <summary>
+///     Call after running a handler
+/// </summary>
+void wakeupProfile_End(wakeupSource_t *source, uint64_t startUs){
+
+    if(source == NULL){
+        source = &otherSource;
+    }
+
+    uint64_t elapsedUs = monotonicUs() - startUs;
+
+    source->dispatches++;
+    source->busyUs += elapsedUs;
+    if(elapsedUs > source->maxUs){
+        source->maxUs = elapsedUs;
+    }
+}
+
+/// <summary>
+///     Count one return from EventLoop_Run()
+/// </summary>
+void wakeupProfile_LoopWake(void){
+
+    loopWakes++;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+//
+//  Functions for getWakeupProfile directMethod
+//
+//  name: getWakeupProfile
+//  Payload: {}, or {"reset": true}
+//
+//  Returns the dispatch count, busy time and CPU duty (parts per million of wall time)
+//  for each source since the application started or the last reset
+//
+//////////////////////////////////////////////////////////////////////////////////////
+
+int dmGetWakeupProfileHandlerFunction(JSON_Object *JsonPayloadObj, size_t payloadSize, char** responseMsg){
+
+    JSON_Value *rootValue = json_value_init_object();
+    JSON_Object *rootObject = json_value_get_object(rootValue);
+    char keyBuffer[96];
+
+    uint64_t elapsedUs = monotonicUs() - profileStartUs;
+    uint64_t totalBusyUs = 0;
+    uint32_t totalDispatches = 0;
+
+    for(int i = 0; i <= sourceCount; i++){
+
+        wakeupSource_t *source = (i == sourceCount) ? &otherSource : &sources[i];
+        if(source->dispatches == 0){
+            continue;
+        }
+
+        totalBusyUs += source->busyUs;
+        totalDispatches += source->dispatches;
+
+        // Source names are C identifiers so they are safe to use in a dotted path
+        snprintf(keyBuffer, sizeof(keyBuffer), "sources.%s.dispatches", source->name);
+        json_object_dotset_number(rootObject, keyBuffer, source->dispatches);
+        snprintf(keyBuffer, sizeof(keyBuffer), "sources.%s.busyUs", source->name);
+        json_object_dotset_number(rootObject, keyBuffer, (double)source->busyUs);
+        snprintf(keyBuffer, sizeof(keyBuffer), "sources.%s.meanUs", source->name);
+        json_object_dotset_number(rootObject, keyBuffer, (double)(source->busyUs / source->dispatches));
+        snprintf(keyBuffer, sizeof(keyBuffer), "sources.%s.maxUs", source->name);
+        json_object_dotset_number(rootObject, keyBuffer, (double)source->maxUs);
+        snprintf(keyBuffer, sizeof(keyBuffer), "sources.%s.dutyPpm", source->name);
+        json_object_dotset_number(rootObject, keyBuffer, dutyPpm(source->busyUs, elapsedUs));
+    }
+
+    json_object_dotset_number(rootObject, "elapsedMs", (double)(elapsedUs / 1000));
+    json_object_dotset_number(rootObject, "loopWakes", loopWakes);
+    json_object_dotset_number(rootObject, "dispatches", totalDispatches);
+    json_object_dotset_number(rootObject, "busyUs", (double)totalBusyUs);
+    json_object_dotset_number(rootObject, "dutyPpm", dutyPpm(totalBusyUs, elapsedUs));
+
+    *responseMsg = dmSerializeResponse(rootValue);
+
+    // Reset the totals if requested, the periodic summary keeps its own baseline
+    if((JsonPayloadObj != NULL) && (json_object_get_boolean(JsonPayloadObj, "reset") == 1)){
+
+        for(int i = 0; i <= sourceCount; i++){
+            wakeupSource_t *source = (i == sourceCount) ? &otherSource : &sources[i];
+            source->summaryDispatches -= source->dispatches;
+            source->summaryBusyUs -= source->busyUs;
+            source->dispatches = 0;
+            source->busyUs = 0;
+            source->maxUs = 0;
+        }
+        summaryLoopWakes -= loopWakes;
+        loopWakes = 0;
+        profileStartUs = monotonicUs();
+    }
+
+    if(*responseMsg == NULL){
+        LOG_ERROR(APP_LOG_CAT_DM, "ERROR: Could not allocate wakeup profile response\n");
+        return 400;
+    }
+
+    return 200;
+}
+
+/// <summary>
+///     Log the wakeups and CPU duty for the last period and send the totals as telemetry
+/// </summary>
+static void WakeupSummaryTimerEventHandler(EventLoopTimer *timer){
+
+    if (ConsumeEventLoopTimerEvent(timer) != 0) {
+        exitCode = ExitCode_WakeupProfileTimer_Consume;
+        return;
+    }
+
+    uint64_t now = monotonicUs();
+    uint64_t periodUs = now - summaryStartUs;
+    uint64_t periodBusyUs = 0;
+    uint32_t periodDispatches = 0;
+    const char *topSourceName = "none";
+    uint32_t topSourceDispatches = 0;
+
+    LOG_INFO(APP_LOG_CAT_APP, "WAKEUP: %u wakeups in the last %u s\n", loopWakes - summaryLoopWakes, (uint32_t)(periodUs / 1000000));
+    LOG_INFO(APP_LOG_CAT_APP, "WAKEUP: %-40s %10s %10s %8s\n", "source", "dispatches", "busyUs", "dutyPpm");
+
+    for(int i = 0; i <= sourceCount; i++){
+
+        wakeupSource_t *source = (i == sourceCount) ? &otherSource : &sources[i];
+        uint32_t dispatches = source->dispatches - source->summaryDispatches;
+        uint64_t busyUs = source->busyUs - source->summaryBusyUs;
+
+        source->summaryDispatches = source->dispatches;
+        source->summaryBusyUs = source->busyUs;
+
+        if(dispatches == 0){
+            continue;
+        }
+
+        LOG_INFO(APP_LOG_CAT_APP, "WAKEUP: %-40s %10u %10u %8u\n", source->name, dispatches, (uint32_t)busyUs,
+                                  dutyPpm(busyUs, periodUs));
+
+        periodBusyUs += busyUs;
+        periodDispatches += dispatches;
+        if(dispatches > topSourceDispatches){
+            topSourceDispatches = dispatches;
+            topSourceName = source->name;
+        }
+    }
+
+    LOG_INFO(APP_LOG_CAT_APP, "WAKEUP: %u dispatches, duty %u ppm, top source %s\n", periodDispatches,
+                              dutyPpm(periodBusyUs, periodUs), topSourceName);
+
+#ifdef IOT_HUB_APPLICATION
+    SCHEMA_SEND_TELEMETRY(true, SCHEMA_TELEMETRY(wakeupLoopWakes, (int)(loopWakes - summaryLoopWakes)),
+                                SCHEMA_TELEMETRY(wakeupDispatches, (int)periodDispatches),
+                                SCHEMA_TELEMETRY(wakeupCpuDutyPpm, (int)dutyPpm(periodBusyUs, periodUs)),
+                                SCHEMA_TELEMETRY(wakeupTopSource, topSourceName),
+                                SCHEMA_TELEMETRY(wakeupTopSourceDispatches, (int)topSourceDispatches));
+#endif // IOT_HUB_APPLICATION
+
+    summaryLoopWakes = loopWakes;
+    summaryStartUs = now;
+}
+
+/// <summary>
+///     Busy time as parts per million of the elapsed time
+/// </summary>
+static uint32_t dutyPpm(uint64_t busyUs, uint64_t elapsedUs){
+
+    if(elapsedUs == 0){
+        return 0;
+    }
+
+    return (uint32_t)((busyUs * 1000000) / elapsedUs);
+}
+
+#endif // ENABLE_WAKEUP_PROFILE
@@ -0,0 +1,72 @@
+#ifndef WAKEUP_PROFILE_H
+#define WAKEUP_PROFILE_H
+
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#include <stdint.h>
+#include "build_options.h"
+
+// Number of timers and I/O sources that can be profiled.  Sources registered after the table is
+// full are counted together under "other".
+#ifndef WAKEUP_PROFILE_MAX_SOURCES
+#define WAKEUP_PROFILE_MAX_SOURCES 24
+#endif
+
+// How often the summary is logged and sent as telemetry
+#ifndef WAKEUP_PROFILE_SUMMARY_PERIOD_SECONDS
+#define WAKEUP_PROFILE_SUMMARY_PERIOD_SECONDS (10 * 60)
+#endif
+
+#ifdef ENABLE_WAKEUP_PROFILE
+
+#include <applibs/eventloop.h>
+#include "exitcodes.h"
+#include "parson.h"
+
+typedef struct wakeupSource wakeupSource_t;
+
+ExitCode wakeupProfile_Init(EventLoop *eventLoop);
+void wakeupProfile_Cleanup(void);
+wakeupSource_t *wakeupProfile_Register(const char *name);
+uint64_t wakeupProfile_Begin(void);
+void wakeupProfile_End(wakeupSource_t *source, uint64_t startUs);
+void wakeupProfile_LoopWake(void);
+
+// Direct method handler
+int dmGetWakeupProfileHandlerFunction(JSON_Object *JsonPayloadObj, size_t payloadSize, char** responsePayload);
+
+#define WAKEUP_PROFILE_LOOP_WAKE() wakeupProfile_LoopWake()
+
+#else
+
+#define WAKEUP_PROFILE_LOOP_WAKE()
+
+#endif // ENABLE_WAKEUP_PROFILE
+
+#endif // WAKEUP_PROFILE_H
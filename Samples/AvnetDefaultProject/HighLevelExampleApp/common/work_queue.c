@@ -0,0 +1,459 @@
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Worker thread offload
+//
+//  Blocking work (file writes, long computations, network requests) is handed to a small pool
+//  of worker threads so it never delays the event loop.  The main thread calls
+//  workQueue_Submit(job, complete, context).  job(context) runs on a worker thread and
+//  complete(context, result) is then called on the main thread from the event loop.
+//
+//  Each worker has its own single producer/single consumer ring of jobs.  Only the main thread
+//  submits, so the rings need no locks, and a job goes to the worker with the fewest jobs
+//  outstanding.  Finished jobs are pushed onto one multi producer/single consumer completion
+//  ring and the worker writes to an eventfd that is registered with the event loop.  The main
+//  thread drains the completion ring when the eventfd is readable.
+//
+//  Jobs come from a fixed pool of WORK_QUEUE_MAX_JOBS that only the main thread allocates and
+//  frees.  The rings are the same size as the pool, so pushing onto a ring can never fail.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "work_queue.h"
+#include "monotonic_time.h"
+#include "../avnet/direct_methods.h"
+
+#ifdef ENABLE_WORK_QUEUE
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <applibs/log.h>
+#include "app_log.h"
+
+#if (WORK_QUEUE_MAX_JOBS & (WORK_QUEUE_MAX_JOBS - 1)) != 0
+#error "WORK_QUEUE_MAX_JOBS must be a power of two"
+#endif
+
+// Worker thread stack size
+#ifndef WORK_QUEUE_STACK_SIZE
+#define WORK_QUEUE_STACK_SIZE (32 * 1024)
+#endif
+
+typedef struct {
+    workQueueJobFunction job;
+    workQueueCompleteFunction complete;
+    void *context;
+    int result;
+    uint64_t submitUs;      // Written by the main thread
+    uint64_t startUs;       // Written by the worker
+    uint64_t endUs;         // Written by the worker
+    bool inUse;             // Main thread only
+} workJob_t;
+
+// Single producer (main thread), single consumer (one worker) ring
+typedef struct {
+    workJob_t *slot[WORK_QUEUE_MAX_JOBS];
+    uint32_t head;          // Next slot the worker reads, written by the worker
+    uint32_t tail;          // Next slot the main thread writes, written by the main thread
+    sem_t wake;
+    pthread_t thread;
+    bool started;
+} workerQueue_t;
+
+// Multi producer (workers), single consumer (main thread) ring cell
+typedef struct {
+    uint32_t sequence;
+    workJob_t *job;
+} completionCell_t;
+
+static workJob_t jobPool[WORK_QUEUE_MAX_JOBS];
+static workerQueue_t workers[WORK_QUEUE_THREADS];
+static completionCell_t completionRing[WORK_QUEUE_MAX_JOBS];
+static uint32_t completionEnqueuePos = 0;
+static uint32_t completionDequeuePos = 0;
+
+static int completionFd = -1;
+static EventRegistration *completionEventReg = NULL;
+static EventLoop *workQueueEventLoop = NULL;
+static bool workQueueRunning = false;
+static bool workQueueStopping = false;
+
+// Statistics, main thread only
+static uint32_t submittedCount = 0;
+static uint32_t completedCount = 0;
+static uint32_t rejectedCount = 0;
+static uint32_t inFlightCount = 0;
+static uint32_t inFlightPeak = 0;
+static uint64_t waitUsSum = 0;
+static uint64_t waitUsMax = 0;
+static uint64_t runUsSum = 0;
+static uint64_t runUsMax = 0;
+static uint64_t latencyUsSum = 0;
+static uint64_t latencyUsMax = 0;
+
+static void *WorkerThread(void *arg);
+static void CompletionEventHandler(EventLoop *el, int fd, EventLoop_IoEvents events, void *context);
+static void PushCompletion(workJob_t *job);
+static workJob_t *PopCompletion(void);
+static void DrainCompletions(void);
+
+/// <summary>
+///     Start the worker threads and register the completion eventfd with the event loop
+/// </summary>
+ExitCode workQueue_Init(EventLoop *eventLoop){
+
+    workQueueEventLoop = eventLoop;
+
+    for(uint32_t i = 0; i < WORK_QUEUE_MAX_JOBS; i++){
+        completionRing[i].sequence = i;
+        completionRing[i].job = NULL;
+    }
+
+    completionFd = eventfd(0, EFD_NONBLOCK);
+    if(completionFd == -1){
+        LOG_ERROR(APP_LOG_CAT_APP, "ERROR: Could not create the work queue eventfd: %s (%d)\n", strerror(errno), errno);
+        return ExitCode_Init_WorkQueue;
+    }
+
+    completionEventReg = EventLoop_RegisterIo(eventLoop, completionFd, EventLoop_Input, CompletionEventHandler, NULL);
+    if(completionEventReg == NULL){
+        return ExitCode_Init_WorkQueue;
+    }
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, WORK_QUEUE_STACK_SIZE);
+
+    for(int i = 0; i < WORK_QUEUE_THREADS; i++){
+
+        sem_init(&workers[i].wake, 0, 0);
+        if(pthread_create(&workers[i].thread, &attr, WorkerThread, &workers[i]) != 0){
+            LOG_ERROR(APP_LOG_CAT_APP, "ERROR: Could not start work queue thread %d\n", i);
+            pthread_attr_destroy(&attr);
+            return ExitCode_Init_WorkQueue;
+        }
+        workers[i].started = true;
+    }
+
+    pthread_attr_destroy(&attr);
+    workQueueRunning = true;
+
+    return ExitCode_Success;
+}
+
+/// <summary>
+///     Stop the workers.  Jobs that are already queued still run, and their completion
+///     functions are called before this returns.
+/// </summary>
+void workQueue_Cleanup(void){
+
+    workQueueRunning = false;
+    __atomic_store_n(&workQueueStopping, true, __ATOMIC_RELEASE);
+
+    for(int i = 0; i < WORK_QUEUE_THREADS; i++){
+        if(workers[i].started){
+            sem_post(&workers[i].wake);
+            pthread_join(workers[i].thread, NULL);
+            sem_destroy(&workers[i].wake);
+            workers[i].started = false;
+        }
+    }
+
+    DrainCompletions();
+
+    if(completionEventReg != NULL){
+        EventLoop_UnregisterIo(workQueueEventLoop, completionEventReg);
+        completionEventReg = NULL;
+    }
+
+    if(completionFd != -1){
+        close(completionFd);
+        completionFd = -1;
+    }
+}
+
+/// <summary>
+///     Queue a job.  Returns false if the work queue is not running or all jobs are in use,
+///     in which case the caller should do the work itself or try again later.
+/// </summary>
+bool workQueue_Submit(workQueueJobFunction job, workQueueCompleteFunction complete, void *context){
+
+    if(!workQueueRunning){
+        return false;
+    }
+
+    workJob_t *newJob = NULL;
+    for(int i = 0; i < WORK_QUEUE_MAX_JOBS; i++){
+        if(!jobPool[i].inUse){
+            newJob = &jobPool[i];
+            break;
+        }
+    }
+
+    if(newJob == NULL){
+        rejectedCount++;
+        return false;
+    }
+
+    newJob->job = job;
+    newJob->complete = complete;
+    newJob->context = context;
+    newJob->result = 0;
+    newJob->submitUs = monotonicUs();
+    newJob->inUse = true;
+
+    // Give the job to the worker with the fewest jobs outstanding
+    workerQueue_t *worker = &workers[0];
+    uint32_t fewest = UINT32_MAX;
+    for(int i = 0; i < WORK_QUEUE_THREADS; i++){
+        uint32_t outstanding = workers[i].tail - __atomic_load_n(&workers[i].head, __ATOMIC_ACQUIRE);
+        if(outstanding < fewest){
+            fewest = outstanding;
+            worker = &workers[i];
+        }
+    }
+
+    // Publish the job before moving the tail so the worker never sees an empty slot
+    worker->slot[worker->tail & (WORK_QUEUE_MAX_JOBS - 1)] = newJob;
+    __atomic_store_n(&worker->tail, worker->tail + 1, __ATOMIC_RELEASE);
+    sem_post(&worker->wake);
+
+    submittedCount++;
+    if(++inFlightCount > inFlightPeak){
+        inFlightPeak = inFlightCount;
+    }
+
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+//
+//  Functions for getWorkQueueStats directMethod
+//
+//  name: getWorkQueueStats
+//  Payload: {}
+//
+//  Returns job counts, queue depth and the wait (submit to start), run and
+//  total (submit to completion) times in microseconds
+//
+//////////////////////////////////////////////////////////////////////////////////////
+
+int dmGetWorkQueueStatsHandlerFunction(JSON_Object *JsonPayloadObj, size_t payloadSize, char** responseMsg){
+
+    JSON_Value *rootValue = json_value_init_object();
+    JSON_Object *rootObject = json_value_get_object(rootValue);
+
+    json_object_dotset_number(rootObject, "threads", WORK_QUEUE_THREADS);
+    json_object_dotset_number(rootObject, "submitted", submittedCount);
+    json_object_dotset_number(rootObject, "completed", completedCount);
+    json_object_dotset_number(rootObject, "rejected", rejectedCount);
+    json_object_dotset_number(rootObject, "depth", inFlightCount);
+    json_object_dotset_number(rootObject, "depthPeak", inFlightPeak);
+    json_object_dotset_number(rootObject, "waitUs.mean", (double)((completedCount == 0) ? 0 : waitUsSum / completedCount));
+    json_object_dotset_number(rootObject, "waitUs.max", (double)waitUsMax);
+    json_object_dotset_number(rootObject, "runUs.mean", (double)((completedCount == 0) ? 0 : runUsSum / completedCount));
+    json_object_dotset_number(rootObject, "runUs.max", (double)runUsMax);
+    json_object_dotset_number(rootObject, "latencyUs.mean", (double)((completedCount == 0) ? 0 : latencyUsSum / completedCount));
+    json_object_dotset_number(rootObject, "latencyUs.max", (double)latencyUsMax);
+
+    *responseMsg = dmSerializeResponse(rootValue);
+
+    if(*responseMsg == NULL){
+        LOG_ERROR(APP_LOG_CAT_DM, "ERROR: Could not allocate work queue stats response\n");
+        return 400;
+    }
+
+    return 200;
+}
+
+/// <summary>
+///     Worker thread, runs one job each time it is woken until the work queue is stopped
+/// </summary>
+static void *WorkerThread(void *arg){
+
+    workerQueue_t *worker = (workerQueue_t *)arg;
+
+    // Leave signal handling to the main thread
+    sigset_t signals;
+    sigfillset(&signals);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+    for(;;){
+
+        if((sem_wait(&worker->wake) == -1) && (errno == EINTR)){
+            continue;
+        }
+
+        uint32_t head = worker->head;
+        if(head == __atomic_load_n(&worker->tail, __ATOMIC_ACQUIRE)){
+
+            // Woken with nothing queued, only happens when stopping
+            if(__atomic_load_n(&workQueueStopping, __ATOMIC_ACQUIRE)){
+                break;
+            }
+            continue;
+        }
+
+        workJob_t *job = worker->slot[head & (WORK_QUEUE_MAX_JOBS - 1)];
+        __atomic_store_n(&worker->head, head + 1, __ATOMIC_RELEASE);
+
+        job->startUs = monotonicUs();
+        job->result = job->job(job->context);
+        job->endUs = monotonicUs();
+
+        PushCompletion(job);
+
+        uint64_t signal = 1;
+        if(write(completionFd, &signal, sizeof(signal)) == -1){
+            // The counter can only overflow after 2^64 writes, nothing to do
+        }
+    }
+
+    return NULL;
+}
+
+/// <summary>
+///     The completion eventfd is readable, call the completion functions on the main thread
+/// </summary>
+static void CompletionEventHandler(EventLoop *el, int fd, EventLoop_IoEvents events, void *context){
+
+    uint64_t count;
+    if(read(fd, &count, sizeof(count)) == -1){
+        if(errno != EAGAIN){
+            LOG_ERROR(APP_LOG_CAT_APP, "ERROR: Could not read the work queue eventfd: %s (%d)\n", strerror(errno), errno);
+        }
+    }
+
+    DrainCompletions();
+}
+
+/// <summary>
+///     Call the completion function for every finished job and return the jobs to the pool
+/// </summary>
+static void DrainCompletions(void){
+
+    workJob_t *job;
+    while((job = PopCompletion()) != NULL){
+
+        uint64_t doneUs = monotonicUs();
+        uint64_t waitUs = job->startUs - job->submitUs;
+        uint64_t runUs = job->endUs - job->startUs;
+        uint64_t latencyUs = doneUs - job->submitUs;
+
+        waitUsSum += waitUs;
+        runUsSum += runUs;
+        latencyUsSum += latencyUs;
+        waitUsMax = (waitUs > waitUsMax) ? waitUs : waitUsMax;
+        runUsMax = (runUs > runUsMax) ? runUs : runUsMax;
+        latencyUsMax = (latencyUs > latencyUsMax) ? latencyUs : latencyUsMax;
+        completedCount++;
+        inFlightCount--;
+
+        // Free the job before calling the completion function so it can submit a follow up job
+        workQueueCompleteFunction complete = job->complete;
+        void *context = job->context;
+        int result = job->result;
+        job->inUse = false;
+
+        if(complete != NULL){
+            complete(context, result);
+        }
+    }
+}
+
+/// <summary>
+///     Add a finished job to the completion ring, called from the worker threads.  Bounded
+///     multi producer queue, each cell's sequence number says whether it is free to write.
+/// </summary>
+static void PushCompletion(workJob_t *job){
+
+    uint32_t pos = __atomic_load_n(&completionEnqueuePos, __ATOMIC_RELAXED);
+    completionCell_t *cell;
+
+    for(;;){
+        cell = &completionRing[pos & (WORK_QUEUE_MAX_JOBS - 1)];
+        uint32_t sequence = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+        int32_t diff = (int32_t)(sequence - pos);
+
+        if(diff == 0){
+            // The cell is free, claim it
+            if(__atomic_compare_exchange_n(&completionEnqueuePos, &pos, pos + 1, true,
+                                           __ATOMIC_RELAXED, __ATOMIC_RELAXED)){
+                break;
+            }
+        }
+        else if(diff < 0){
+            // Full, cannot happen because the ring holds every job in the pool
+            sched_yield();
+            pos = __atomic_load_n(&completionEnqueuePos, __ATOMIC_RELAXED);
+        }
+        else{
+            // Another worker claimed this cell, try the next one
+            pos = __atomic_load_n(&completionEnqueuePos, __ATOMIC_RELAXED);
+        }
+    }
+
+    cell->job = job;
+    __atomic_store_n(&cell->sequence, pos + 1, __ATOMIC_RELEASE);
+}
+
+/// <summary>
+///     Take the next finished job from the completion ring, NULL if there are none.  Main
+///     thread only.
+/// </summary>
+static workJob_t *PopCompletion(void){
+
+    uint32_t pos = completionDequeuePos;
+    completionCell_t *cell = &completionRing[pos & (WORK_QUEUE_MAX_JOBS - 1)];
+    uint32_t sequence = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+
+    if((int32_t)(sequence - (pos + 1)) < 0){
+        return NULL;
+    }
+
+    workJob_t *job = cell->job;
+    __atomic_store_n(&cell->sequence, pos + WORK_QUEUE_MAX_JOBS, __ATOMIC_RELEASE);
+    completionDequeuePos = pos + 1;
+
+    return job;
+}
+
+#endif // ENABLE_WORK_QUEUE
@@ -0,0 +1,68 @@
+#ifndef WORK_QUEUE_H
+#define WORK_QUEUE_H
+
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#include <stdbool.h>
+#include "build_options.h"
+
+// Number of worker threads
+#ifndef WORK_QUEUE_THREADS
+#define WORK_QUEUE_THREADS 2
+#endif
+
+// Jobs that can be queued or running at once, across all workers.  Must be a power of two.
+#ifndef WORK_QUEUE_MAX_JOBS
+#define WORK_QUEUE_MAX_JOBS 32
+#endif
+
+// Runs on a worker thread.  Must not call Applibs or event loop functions, and must not touch
+// application state that the main thread also uses without its own synchronization.
+typedef int (*workQueueJobFunction)(void *context);
+
+// Runs on the main thread from the event loop after the job has finished.  result is the job's
+// return value.
+typedef void (*workQueueCompleteFunction)(void *context, int result);
+
+#ifdef ENABLE_WORK_QUEUE
+
+#include <applibs/eventloop.h>
+#include "exitcodes.h"
+#include "parson.h"
+
+ExitCode workQueue_Init(EventLoop *eventLoop);
+void workQueue_Cleanup(void);
+bool workQueue_Submit(workQueueJobFunction job, workQueueCompleteFunction complete, void *context);
+
+// Direct method handler
+int dmGetWorkQueueStatsHandlerFunction(JSON_Object *JsonPayloadObj, size_t payloadSize, char** responsePayload);
+
+#endif // ENABLE_WORK_QUEUE
+
+#endif // WORK_QUEUE_H
@@ -0,0 +1,65 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Define one benchmark.  Each table entry is run with the same harness.
+// .name - Printed in the report
+// .setup - Called once before the timed loop, NULL if not required
+// .run - One operation, called repeatedly while timed
+// .teardown - Called once after the timed loop, NULL if not required
+typedef struct {
+    const char *name;
+    void (*setup)(void);
+    void (*run)(void);
+    void (*teardown)(void);
+} benchCase_t;
+
+// Heap counters maintained by the malloc wrappers in bench_alloc.c
+typedef struct {
+    uint64_t allocs;
+    uint64_t frees;
+    uint64_t bytesAllocated;
+    int64_t liveBytes;
+    int64_t peakBytes;
+} benchAllocStats_t;
+
+extern benchAllocStats_t benchAllocStats;
+
+// Reset the peak to the current live bytes
+void benchAlloc_ResetPeak(void);
+
+// Run a table of benchmarks, filter selects cases by substring (NULL runs all)
+void bench_RunTable(const benchCase_t *cases, size_t count, const char *filter, double minSeconds);
+
+#endif // BENCH_H
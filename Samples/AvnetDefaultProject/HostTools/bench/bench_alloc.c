@@ -0,0 +1,113 @@
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Heap accounting for the benchmarks
+//
+//  The bench executable links with -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=free
+//  so every allocation made by the application code (including parson, which calls malloc()
+//  through a function pointer) is counted.  Allocations made inside libc are not counted.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <malloc.h>
+#include <stdlib.h>
+
+#include "bench.h"
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+
+benchAllocStats_t benchAllocStats;
+
+static void recordAlloc(void *ptr)
+{
+    if (ptr != NULL) {
+        size_t usable = malloc_usable_size(ptr);
+        benchAllocStats.allocs++;
+        benchAllocStats.bytesAllocated += usable;
+        benchAllocStats.liveBytes += (int64_t)usable;
+        if (benchAllocStats.liveBytes > benchAllocStats.peakBytes) {
+            benchAllocStats.peakBytes = benchAllocStats.liveBytes;
+        }
+    }
+}
+
+static void recordFree(void *ptr)
+{
+    if (ptr != NULL) {
+        benchAllocStats.frees++;
+        benchAllocStats.liveBytes -= (int64_t)malloc_usable_size(ptr);
+    }
+}
+
+void *__wrap_malloc(size_t size)
+{
+    void *ptr = __real_malloc(size);
+    recordAlloc(ptr);
+    return ptr;
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+    void *ptr = __real_calloc(count, size);
+    recordAlloc(ptr);
+    return ptr;
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    size_t oldUsable = (ptr != NULL) ? malloc_usable_size(ptr) : 0;
+    void *newPtr = __real_realloc(ptr, size);
+
+    // On failure the original block is still allocated
+    if ((newPtr == NULL) && (size != 0)) {
+        return NULL;
+    }
+
+    if (ptr != NULL) {
+        benchAllocStats.frees++;
+        benchAllocStats.liveBytes -= (int64_t)oldUsable;
+    }
+    recordAlloc(newPtr);
+    return newPtr;
+}
+
+void __wrap_free(void *ptr)
+{
+    recordFree(ptr);
+    __real_free(ptr);
+}
+
+void benchAlloc_ResetPeak(void)
+{
+    benchAllocStats.peakBytes = benchAllocStats.liveBytes;
+}
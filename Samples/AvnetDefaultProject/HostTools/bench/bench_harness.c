@@ -0,0 +1,109 @@
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Benchmark harness
+//
+//  Each case is warmed up, then run in batches until at least minSeconds of run time has been
+//  measured.  The report shows the time, heap allocations and bytes allocated per operation, and
+//  the peak heap growth seen while the case ran.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "bench.h"
+
+#define BENCH_WARMUP_ITERATIONS 100
+#define BENCH_FIRST_BATCH 64
+#define BENCH_MAX_ITERATIONS 50000000ULL
+
+static uint64_t nowNs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint64_t)now.tv_sec * 1000000000ULL) + (uint64_t)now.tv_nsec;
+}
+
+static void runCase(const benchCase_t *benchCase, double minSeconds)
+{
+    if (benchCase->setup != NULL) {
+        benchCase->setup();
+    }
+
+    for (int i = 0; i < BENCH_WARMUP_ITERATIONS; i++) {
+        benchCase->run();
+    }
+
+    int64_t startLiveBytes = benchAllocStats.liveBytes;
+    uint64_t startAllocs = benchAllocStats.allocs;
+    uint64_t startBytes = benchAllocStats.bytesAllocated;
+    benchAlloc_ResetPeak();
+
+    uint64_t iterations = 0;
+    uint64_t elapsedNs = 0;
+    uint64_t batch = BENCH_FIRST_BATCH;
+
+    while ((elapsedNs < (uint64_t)(minSeconds * 1e9)) && (iterations < BENCH_MAX_ITERATIONS)) {
+        uint64_t start = nowNs();
+        for (uint64_t i = 0; i < batch; i++) {
+            benchCase->run();
+        }
+        elapsedNs += nowNs() - start;
+        iterations += batch;
+        batch *= 2;
+    }
+
+    double allocsPerOp = (double)(benchAllocStats.allocs - startAllocs) / (double)iterations;
+    double bytesPerOp = (double)(benchAllocStats.bytesAllocated - startBytes) / (double)iterations;
+    int64_t peakGrowth = benchAllocStats.peakBytes - startLiveBytes;
+
+    if (benchCase->teardown != NULL) {
+        benchCase->teardown();
+    }
+
+    printf("%-52s %10llu %12.1f %10.2f %10.1f %12lld\n", benchCase->name,
+           (unsigned long long)iterations, (double)elapsedNs / (double)iterations, allocsPerOp,
+           bytesPerOp, (long long)peakGrowth);
+    fflush(stdout);
+}
+
+void bench_RunTable(const benchCase_t *cases, size_t count, const char *filter, double minSeconds)
+{
+    printf("%-52s %10s %12s %10s %10s %12s\n", "benchmark", "iterations", "ns/op", "allocs/op",
+           "bytes/op", "peak heap");
+
+    for (size_t i = 0; i < count; i++) {
+        if ((filter == NULL) || (strstr(cases[i].name, filter) != NULL)) {
+            runCase(&cases[i], minSeconds);
+        }
+    }
+}
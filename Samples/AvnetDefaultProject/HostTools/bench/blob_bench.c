@@ -0,0 +1,484 @@
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  blob_bench: Throughput and heap use of the chunked blob upload (common/cloud_blob.c)
+//
+//  The upload runs from the application's work queue against the stub IoT Hub, which sends each
+//  block to a local HTTP stand-in for the storage account (a thread in this program listening on
+//  127.0.0.1).  The stand-in accepts Put Block and Put Block List requests, hashes each committed
+//  blob and the bench checks every part against the source data.
+//
+//  The source data is generated from the offset, so the bench holds no copy of the blob and the
+//  heap figures belong to the upload path.
+//
+//  Usage: blob_bench [options]
+//
+//  --size-kb=n           Size of the blob, default 1024
+//  --fail-after=n        The stub fails a part after n blocks, default 0 (no failures)
+//  --fail-uploads=n      Number of parts that fail, default 1
+//  --timeout=s           Give up after s seconds, default 120
+//  --verbose             Show the application's debug output
+//  --json                Print the results as one line of JSON
+//
+//  cloud_blob.c and work_queue.c are compiled into this program with ENABLE_BLOB_UPLOAD,
+//  ENABLE_WORK_QUEUE and a short retry backoff (see CMakeLists.txt), the copies in hla_host are
+//  built without them and are empty.
+//
+//  Exit status is 0 if the upload completed and every part matched.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <getopt.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <applibs/eventloop.h>
+
+#include "bench.h"
+#include "host_stubs.h"
+
+#include "cloud_blob.h"
+#include "exitcodes.h"
+#include "work_queue.h"
+
+#define STORAGE_MAX_BLOBS 1024
+#define STORAGE_HEADER_SIZE 1024
+
+// A blob committed with Put Block List
+typedef struct {
+    char name[CLOUD_BLOB_MAX_NAME];
+    uint64_t bytes;
+    uint64_t hash;
+} storedBlob_t;
+
+// The storage stand-in, blocks are hashed as they arrive and the staged hash is committed by
+// Put Block List.  Block ids restart at zero for each attempt at a blob.
+static struct {
+    int listenSocket;
+    uint16_t port;
+    storedBlob_t blobs[STORAGE_MAX_BLOBS];
+    int blobCount;
+    char stagedName[CLOUD_BLOB_MAX_NAME];
+    uint64_t stagedBytes;
+    uint64_t stagedHash;
+    uint64_t requests;
+} storage;
+
+static unsigned char storageBody[64 * 1024];
+
+static bool uploadDone = false;
+static bool uploadSucceeded = false;
+
+extern volatile sig_atomic_t exitCode;
+extern EventLoop *eventLoop;
+
+static uint64_t nowNs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint64_t)now.tv_sec * 1000000000ULL) + (uint64_t)now.tv_nsec;
+}
+
+// Peak resident set size in kB
+static long peakRssKb(void)
+{
+    char line[128];
+    long kb = -1;
+
+    FILE *status = fopen("/proc/self/status", "r");
+    if (status == NULL) {
+        return -1;
+    }
+    while (fgets(line, sizeof(line), status) != NULL) {
+        if (sscanf(line, "VmHWM: %ld kB", &kb) == 1) {
+            break;
+        }
+    }
+    fclose(status);
+    return kb;
+}
+
+static uint64_t hashBytes(uint64_t hash, const unsigned char *data, size_t length)
+{
+    // FNV-1a
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ data[i]) * 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//  Storage stand-in
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+static bool readHeader(int connection, char *header, size_t size, size_t *length, char **body)
+{
+    *body = NULL;
+    while (*body == NULL) {
+        if (*length == size - 1) {
+            return false;
+        }
+        ssize_t received = recv(connection, &header[*length], size - 1 - *length, 0);
+        if (received <= 0) {
+            return false;
+        }
+        *length += (size_t)received;
+        header[*length] = '\0';
+        *body = strstr(header, "\r\n\r\n");
+    }
+    *body += 4;
+    return true;
+}
+
+static void handleRequest(const char *path, const unsigned char *body, size_t length, bool first,
+                          bool last)
+{
+    // Path is /{container}/{deviceId}/{name}?comp=...
+    const char *query = strchr(path, '?');
+    const char *name = path;
+    for (int i = 0; (i < 2) && (name != NULL); i++) {
+        name = strchr(name + 1, '/');
+    }
+    if ((query == NULL) || (name == NULL)) {
+        return;
+    }
+    name++;
+
+    if (strncmp(query, "?comp=block&blockid=", 20) == 0) {
+        if (first && (strtoul(query + 20, NULL, 16) == 0)) {
+            size_t nameLength = (size_t)(query - name);
+            if (nameLength >= sizeof(storage.stagedName)) {
+                nameLength = sizeof(storage.stagedName) - 1;
+            }
+            memcpy(storage.stagedName, name, nameLength);
+            storage.stagedName[nameLength] = '\0';
+            storage.stagedBytes = 0;
+            storage.stagedHash = 0xCBF29CE484222325ULL;
+        }
+        storage.stagedBytes += length;
+        storage.stagedHash = hashBytes(storage.stagedHash, body, length);
+    } else if (last && (strncmp(query, "?comp=blocklist", 15) == 0) &&
+               (storage.blobCount < STORAGE_MAX_BLOBS)) {
+        storedBlob_t *blob = &storage.blobs[storage.blobCount++];
+        strcpy(blob->name, storage.stagedName);
+        blob->bytes = storage.stagedBytes;
+        blob->hash = storage.stagedHash;
+    }
+}
+
+static void serveConnection(int connection)
+{
+    char header[STORAGE_HEADER_SIZE];
+
+    for (;;) {
+        size_t length = 0;
+        char *body;
+        if (!readHeader(connection, header, sizeof(header), &length, &body)) {
+            return;
+        }
+
+        char path[STORAGE_HEADER_SIZE];
+        size_t contentLength = 0;
+        if (sscanf(header, "PUT %1023s HTTP/1.1", path) != 1) {
+            return;
+        }
+        const char *field = strstr(header, "Content-Length:");
+        if (field != NULL) {
+            contentLength = strtoul(field + strlen("Content-Length:"), NULL, 10);
+        }
+        storage.requests++;
+
+        // The body arrives in pieces of up to sizeof(storageBody), each is handled as it arrives
+        size_t buffered = length - (size_t)(body - header);
+        size_t received = 0;
+        bool first = true;
+        if (buffered > contentLength) {
+            return;
+        }
+        memcpy(storageBody, body, buffered);
+        while (received < contentLength) {
+            while ((buffered < sizeof(storageBody)) && (received + buffered < contentLength)) {
+                ssize_t count = recv(connection, &storageBody[buffered],
+                                     sizeof(storageBody) - buffered, 0);
+                if (count <= 0) {
+                    return;
+                }
+                buffered += (size_t)count;
+            }
+            received += buffered;
+            handleRequest(path, storageBody, buffered, first, received == contentLength);
+            first = false;
+            buffered = 0;
+        }
+        if (contentLength == 0) {
+            handleRequest(path, storageBody, 0, true, true);
+        }
+
+        static const char response[] = "HTTP/1.1 201 Created\r\nContent-Length: 0\r\n\r\n";
+        if (send(connection, response, sizeof(response) - 1, MSG_NOSIGNAL) < 0) {
+            return;
+        }
+    }
+}
+
+static void *storageThread(void *arg)
+{
+    for (;;) {
+        int connection = accept(storage.listenSocket, NULL, NULL);
+        if (connection < 0) {
+            return NULL;
+        }
+        serveConnection(connection);
+        close(connection);
+    }
+}
+
+static bool startStorage(void)
+{
+    storage.listenSocket = socket(AF_INET, SOCK_STREAM, 0);
+    if (storage.listenSocket < 0) {
+        return false;
+    }
+
+    struct sockaddr_in address = {.sin_family = AF_INET, .sin_port = 0};
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addressLength = sizeof(address);
+    if ((bind(storage.listenSocket, (struct sockaddr *)&address, sizeof(address)) != 0) ||
+        (listen(storage.listenSocket, 4) != 0) ||
+        (getsockname(storage.listenSocket, (struct sockaddr *)&address, &addressLength) != 0)) {
+        return false;
+    }
+    storage.port = ntohs(address.sin_port);
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, storageThread, NULL) != 0) {
+        return false;
+    }
+    pthread_detach(thread);
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//  Upload
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+static unsigned char sourceByte(size_t offset)
+{
+    uint32_t x = (uint32_t)offset * 2654435761u;
+    return (unsigned char)((x >> 24) ^ (offset >> 12));
+}
+
+static int SourceCallback(size_t offset, unsigned char *buffer, size_t size, void *context)
+{
+    for (size_t i = 0; i < size; i++) {
+        buffer[i] = sourceByte(offset + i);
+    }
+    return (int)size;
+}
+
+static void DoneCallback(bool success, const char *name, void *context)
+{
+    uploadDone = true;
+    uploadSucceeded = success;
+}
+
+static void BenchExitCodeCallback(ExitCode ec)
+{
+    exitCode = ec;
+}
+
+// Checks the committed blobs against the source, the last commit of each part counts
+static int verifyParts(const char *name, size_t totalBytes, int *matched)
+{
+    uint32_t partCount = (uint32_t)((totalBytes + CLOUD_BLOB_PART_BYTES - 1) / CLOUD_BLOB_PART_BYTES);
+    *matched = 0;
+
+    for (uint32_t part = 0; part < partCount; part++) {
+        char partName[CLOUD_BLOB_MAX_NAME];
+        if (partCount == 1) {
+            snprintf(partName, sizeof(partName), "%s", name);
+        } else {
+            snprintf(partName, sizeof(partName), "%s.part%03u", name, part);
+        }
+
+        size_t start = (size_t)part * CLOUD_BLOB_PART_BYTES;
+        size_t length = (totalBytes - start < CLOUD_BLOB_PART_BYTES) ? totalBytes - start
+                                                                     : CLOUD_BLOB_PART_BYTES;
+        uint64_t hash = 0xCBF29CE484222325ULL;
+        for (size_t i = 0; i < length; i++) {
+            unsigned char byte = sourceByte(start + i);
+            hash = hashBytes(hash, &byte, 1);
+        }
+
+        for (int i = storage.blobCount - 1; i >= 0; i--) {
+            if (strcmp(storage.blobs[i].name, partName) == 0) {
+                if ((storage.blobs[i].bytes == length) && (storage.blobs[i].hash == hash)) {
+                    (*matched)++;
+                }
+                break;
+            }
+        }
+    }
+    return (int)partCount;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t sizeKb = 1024;
+    double timeoutSeconds = 120;
+    bool jsonOutput = false;
+    hostIoTBlobConfig_t config = {.host = "127.0.0.1", .failUploads = 1};
+    hostLogOutput = false;
+
+    static const struct option options[] = {
+        {"size-kb", required_argument, NULL, 's'},
+        {"fail-after", required_argument, NULL, 'f'},
+        {"fail-uploads", required_argument, NULL, 'u'},
+        {"timeout", required_argument, NULL, 't'},
+        {"verbose", no_argument, NULL, 'v'},
+        {"json", no_argument, NULL, 'J'},
+        {NULL, 0, NULL, 0}};
+
+    int option;
+    while ((option = getopt_long(argc, argv, "", options, NULL)) != -1) {
+        switch (option) {
+        case 's':
+            sizeKb = strtoul(optarg, NULL, 10);
+            break;
+        case 'f':
+            config.failAfterBlocks = (uint32_t)strtoul(optarg, NULL, 10);
+            break;
+        case 'u':
+            config.failUploads = (uint32_t)strtoul(optarg, NULL, 10);
+            break;
+        case 't':
+            timeoutSeconds = atof(optarg);
+            break;
+        case 'v':
+            hostLogOutput = true;
+            break;
+        case 'J':
+            jsonOutput = true;
+            break;
+        default:
+            fprintf(stderr, "Usage: see the comment at the top of blob_bench.c\n");
+            return 1;
+        }
+    }
+
+    if ((sizeKb == 0) || !startStorage()) {
+        fprintf(stderr, "ERROR: Could not start the storage stand-in\n");
+        return 1;
+    }
+    config.port = storage.port;
+    hostIoT_SetBlobConfig(&config);
+
+    if (hostApp_Init() != 0) {
+        fprintf(stderr, "ERROR: hostApp_Init() failed, exitCode %d\n", (int)exitCode);
+        return 1;
+    }
+    if (workQueue_Init(eventLoop) != ExitCode_Success) {
+        fprintf(stderr, "ERROR: workQueue_Init() failed\n");
+        return 1;
+    }
+    if (cloudBlob_Init(eventLoop, BenchExitCodeCallback) != ExitCode_Success) {
+        fprintf(stderr, "ERROR: cloudBlob_Init() failed\n");
+        return 1;
+    }
+
+    static const char blobName[] = "bench.bin";
+    size_t totalBytes = sizeKb * 1024;
+
+    benchAlloc_ResetPeak();
+    int64_t liveBefore = benchAllocStats.liveBytes;
+    uint64_t allocsBefore = benchAllocStats.allocs;
+    uint64_t start = nowNs();
+    uint64_t end = start + (uint64_t)(timeoutSeconds * 1e9);
+
+    if (!cloudBlob_Upload(blobName, totalBytes, SourceCallback, DoneCallback, NULL)) {
+        fprintf(stderr, "ERROR: cloudBlob_Upload() failed\n");
+        return 1;
+    }
+
+    cloudBlobStatus_t status = {0};
+    while (!uploadDone && (nowNs() < end) && (exitCode == ExitCode_Success)) {
+        EventLoop_Run(eventLoop, 100, true);
+        if (!uploadDone) {
+            cloudBlob_GetStatus(&status);
+        }
+    }
+    double seconds = (double)(nowNs() - start) / 1e9;
+    int64_t heapPeak = benchAllocStats.peakBytes - liveBefore;
+    uint64_t allocs = benchAllocStats.allocs - allocsBefore;
+
+    int matched;
+    int parts = verifyParts(blobName, totalBytes, &matched);
+    const hostIoTBlobStats_t *stats = hostIoT_GetBlobStats();
+    double kbPerSecond = (seconds > 0) ? (double)stats->bytes / 1024.0 / seconds : 0;
+
+    if (jsonOutput) {
+        printf("{\"bytes\":%zu,\"chunkBytes\":%d,\"partBytes\":%d,\"seconds\":%.3f,"
+               "\"kbPerS\":%.1f,\"succeeded\":%s,\"parts\":%d,\"partsMatched\":%d,"
+               "\"retries\":%u,\"blocksSent\":%llu,\"bytesSent\":%llu,\"httpRequests\":%llu,"
+               "\"uploadsFailed\":%llu,\"heapPeak\":%lld,\"allocs\":%llu,\"peakRssKb\":%ld}\n",
+               totalBytes, CLOUD_BLOB_CHUNK_BYTES, CLOUD_BLOB_PART_BYTES, seconds, kbPerSecond,
+               uploadSucceeded ? "true" : "false", parts, matched, status.retries,
+               (unsigned long long)stats->blocks, (unsigned long long)stats->bytes,
+               (unsigned long long)stats->httpRequests, (unsigned long long)stats->uploadsFailed,
+               (long long)heapPeak, (unsigned long long)allocs, peakRssKb());
+    } else {
+        printf("blob_bench: %zu bytes in %d byte chunks, %d byte parts\n", totalBytes,
+               CLOUD_BLOB_CHUNK_BYTES, CLOUD_BLOB_PART_BYTES);
+        printf("upload       %s in %.3f s, %.1f kB/s, %u retries\n",
+               uploadSucceeded ? "completed" : "FAILED", seconds, kbPerSecond, status.retries);
+        printf("parts        %d of %d committed and matched\n", matched, parts);
+        printf("storage      %llu blocks, %llu bytes sent (retries included), %llu HTTP requests, "
+               "%llu failed parts\n",
+               (unsigned long long)stats->blocks, (unsigned long long)stats->bytes,
+               (unsigned long long)stats->httpRequests, (unsigned long long)stats->uploadsFailed);
+        printf("memory       heap peak %lld bytes above the start, %llu allocs, peak RSS %ld kB\n",
+               (long long)heapPeak, (unsigned long long)allocs, peakRssKb());
+    }
+
+    cloudBlob_Cancel();
+    workQueue_Cleanup();
+    cloudBlob_Cleanup();
+    hostApp_Cleanup();
+    return (uploadSucceeded && (matched == parts) && (exitCode == ExitCode_Success)) ? 0 : 1;
+}
@@ -0,0 +1,278 @@
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  hla_bench: Microbenchmarks for the shared high level application modules
+//
+//  Usage: hla_bench [filter] [seconds]
+//
+//  filter - Only run benchmarks whose name contains this string
+//  seconds - Minimum measured time per benchmark, default 0.5
+//
+//  The application modules are built for the host against the stubs in ../stubs with
+//  USE_IOT_CONNECT, OLED_SD1306 and ENABLE_TELEMETRY_RESEND_LOGIC enabled.  Operations that queue
+//  an IoT Hub send also run one DoWork so the send is confirmed and the resend list entry is
+//  released, this is the steady state on the device.
+//
+//  Host numbers are for comparing changes, not for predicting on device timing.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "host_stubs.h"
+
+#include "cloud.h"
+#include "device_twin.h"
+#include "direct_methods.h"
+#include "iotConnect.h"
+#include "linkedList.h"
+#include "sd1306.h"
+
+extern bool IoTCConnected;
+
+// From the AvnetRSL10Sensor sample, built from its own directory (see CMakeLists.txt)
+extern void parseRsl10Message(char *msgToParse);
+
+// Used by rsl10.c, the RSL10 sample's main.c sends the telemetry
+void SendTelemetry(const char *jsonMessage, bool appendIsoTime)
+{
+    hostStubCounters.telemetrySent++;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//  Telemetry
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void benchSendTelemetry(void)
+{
+    Cloud_SendTelemetry(false, 3*ARGS_PER_TELEMETRY_ITEM,
+                        TYPE_STRING, "sampleKeyString", "AvnetKnowsIoT",
+                        TYPE_INT, "sampleKeyInt", 42,
+                        TYPE_FLOAT, "sampleKeyFloat", 12.34);
+    hostIoT_DoWork();
+}
+
+static void benchSendTelemetryIoTConnect(void)
+{
+    Cloud_SendTelemetry(true, 3*ARGS_PER_TELEMETRY_ITEM,
+                        TYPE_STRING, "sampleKeyString", "AvnetKnowsIoT",
+                        TYPE_INT, "sampleKeyInt", 42,
+                        TYPE_FLOAT, "sampleKeyFloat", 12.34);
+    hostIoT_DoWork();
+}
+
+static void benchFormatTelemetryForIoTConnect(void)
+{
+    static const char telemetry[] = "{\"sampleKeyString\":\"AvnetKnowsIoT\",\"sampleKeyInt\":42,"
+                                    "\"sampleKeyFloat\":12.34}";
+    static char modified[sizeof(telemetry) + IOTC_TELEMETRY_OVERHEAD];
+
+    FormatTelemetryForIoTConnect(telemetry, modified, sizeof(modified));
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//  Device twin
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void benchUpdateDeviceTwinWritable(void)
+{
+    updateDeviceTwin(true, 2*ARGS_PER_TWIN_ITEM,
+                     TYPE_INT, "telemetryPeriod", 30,
+                     TYPE_STRING, "OledDisplayMsg1", "Azure Sphere");
+    hostIoT_DoWork();
+}
+
+static void benchUpdateDeviceTwinReadOnly(void)
+{
+    updateDeviceTwin(false, 3*ARGS_PER_TWIN_ITEM,
+                     TYPE_STRING, "versionString", VERSION_STRING,
+                     TYPE_STRING, "manufacturer", DEVICE_MFG,
+                     TYPE_STRING, "model", DEVICE_MODEL);
+    hostIoT_DoWork();
+}
+
+static void benchDeviceTwinCallbackHandler(void)
+{
+    static const char desired[] = "{\"desired\":{\"telemetryPeriod\":30,\"sensorPollPeriod\":15,"
+                                  "\"OledDisplayMsg1\":\"Azure Sphere\",\"unknownKey\":1,"
+                                  "\"$version\":7},\"reported\":{\"$version\":3}}";
+    DeviceTwinCallbackHandler(desired);
+    hostIoT_DoWork();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//  Direct methods
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void invokeDirectMethod(const char *name, const char *payload)
+{
+    unsigned char *response = NULL;
+    size_t responseSize = 0;
+
+    DeviceMethodCallbackHandler(name, (const unsigned char *)payload, strlen(payload), &response,
+                                &responseSize);
+
+    // The Azure IoT SDK frees the response
+    free(response);
+
+    // Some methods also report device twin updates, confirm them
+    hostIoT_DoWork();
+}
+
+static void benchDirectMethodTest(void)
+{
+    invokeDirectMethod("test", "{\"returnVal\":200}");
+}
+
+static void benchDirectMethodSetInterval(void)
+{
+    invokeDirectMethod("setTelemetryTxInterval", "{\"txInterval\":30}");
+}
+
+static void benchDirectMethodUnknown(void)
+{
+    invokeDirectMethod("noSuchMethod", "{}");
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//  Telemetry resend list
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#define RESEND_LIST_DEPTH 32
+
+static char resendTelemetry[] = "{\"sampleKeyString\":\"AvnetKnowsIoT\",\"sampleKeyInt\":42}";
+static telemetryNode_t *resendNodes[RESEND_LIST_DEPTH];
+static int resendNext = 0;
+
+static void benchResendInsertDelete(void)
+{
+    telemetryNode_t *node = InsertAtTail(resendTelemetry, (int)strlen(resendTelemetry));
+    DeleteNode(node);
+}
+
+static void setupResendList(void)
+{
+    for (int i = 0; i < RESEND_LIST_DEPTH; i++) {
+        resendNodes[i] = InsertAtTail(resendTelemetry, (int)strlen(resendTelemetry));
+    }
+    resendNext = 0;
+}
+
+// With a backlog the send confirmations arrive in order, delete the oldest and add a new one
+static void benchResendRotate(void)
+{
+    DeleteNode(resendNodes[resendNext]);
+    resendNodes[resendNext] = InsertAtTail(resendTelemetry, (int)strlen(resendTelemetry));
+    resendNext = (resendNext + 1) % RESEND_LIST_DEPTH;
+}
+
+static void teardownResendList(void)
+{
+    DeleteEntireList();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//  RSL10 message parsing and OLED drawing
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void benchParseRsl10Environmental(void)
+{
+    char message[] = "ESD00AB896745230100CC094F12B8069BFFFF -50";
+    parseRsl10Message(message);
+}
+
+static void benchParseRsl10Motion(void)
+{
+    char message[] = "MSD00AB89674523010001" "64F9FF1300D9FF00FC0509 -49";
+    parseRsl10Message(message);
+}
+
+static void benchParseRsl10Battery(void)
+{
+    char message[] = "BAT00AB89674523010ABD -52";
+    parseRsl10Message(message);
+}
+
+static void benchSd1306DrawString(void)
+{
+    sd1306_draw_string(0, 16, (uint8_t *)"Temp: 23.45C", 1, white_pixel);
+}
+
+static void benchSd1306DrawStringLarge(void)
+{
+    sd1306_draw_string(0, 0, (uint8_t *)"Avnet", 2, white_pixel);
+}
+
+// Define the benchmarks
+static const benchCase_t benchCases[] = {
+    {.name = "Cloud_SendTelemetry/3 items", .run = benchSendTelemetry},
+    {.name = "Cloud_SendTelemetry/3 items IoTConnect", .run = benchSendTelemetryIoTConnect},
+    {.name = "FormatTelemetryForIoTConnect", .run = benchFormatTelemetryForIoTConnect},
+    {.name = "updateDeviceTwin/2 writable", .run = benchUpdateDeviceTwinWritable},
+    {.name = "updateDeviceTwin/3 read only", .run = benchUpdateDeviceTwinReadOnly},
+    {.name = "DeviceTwinCallbackHandler/3 keys", .run = benchDeviceTwinCallbackHandler},
+    {.name = "DeviceMethodCallbackHandler/test", .run = benchDirectMethodTest},
+    {.name = "DeviceMethodCallbackHandler/setTelemetryTxInterval", .run = benchDirectMethodSetInterval},
+    {.name = "DeviceMethodCallbackHandler/unknown", .run = benchDirectMethodUnknown},
+    {.name = "resendList/insert+delete", .run = benchResendInsertDelete},
+    {.name = "resendList/rotate depth 32", .setup = setupResendList, .run = benchResendRotate,
+     .teardown = teardownResendList},
+    {.name = "parseRsl10Message/ESD", .run = benchParseRsl10Environmental},
+    {.name = "parseRsl10Message/MSD", .run = benchParseRsl10Motion},
+    {.name = "parseRsl10Message/BAT", .run = benchParseRsl10Battery},
+    {.name = "sd1306_draw_string/size 1", .run = benchSd1306DrawString},
+    {.name = "sd1306_draw_string/size 2", .run = benchSd1306DrawStringLarge},
+};
+
+int main(int argc, char *argv[])
+{
+    const char *filter = (argc > 1) ? argv[1] : NULL;
+    double minSeconds = (argc > 2) ? atof(argv[2]) : 0.5;
+
+    if (hostApp_Init() != 0) {
+        fprintf(stderr, "ERROR: hostApp_Init() failed, exitCode %d\n", (int)exitCode);
+        return 1;
+    }
+
+    // Telemetry in IoTConnect format requires the IoTConnect handshake
+    IoTCConnected = true;
+
+    // Keep formatting the log messages, but don't print them
+    hostLogOutput = false;
+
+    bench_RunTable(benchCases, sizeof(benchCases) / sizeof(benchCases[0]), filter, minSeconds);
+
+    hostLogOutput = true;
+    hostApp_Cleanup();
+    return 0;
+}
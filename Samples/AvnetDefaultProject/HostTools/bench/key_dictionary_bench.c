@@ -0,0 +1,246 @@
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  key_dictionary_bench: Bytes saved by the telemetry key dictionary (common/key_dictionary.c)
+//
+//  Usage: key_dictionary_bench [--dictionary]
+//
+//  Checks every dictionary with keyDictionary_Validate(), then compacts one telemetry message
+//  of each kind the Avnet samples send, as the samples format them, with the newest dictionary.
+//  For each message it reports the full and compacted size, the bytes saved after paying for
+//  the "kd" message property, and the host time per compaction.  Every compacted message is
+//  expanded again the way the cloud would and compared with the original.
+//
+//  --dictionary prints the dictionaries as JSON, short key to key, for the cloud side.
+//
+//  key_dictionary.c is compiled into this program with ENABLE_TELEMETRY_KEY_DICTIONARY.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "key_dictionary.h"
+
+#define TIMING_REPEATS 100000
+
+typedef struct {
+    const char *name;
+    const char *message;
+} benchPayload_t;
+
+// Messages as the samples send them.  The DefaultProject messages come from the parson
+// serializer in Cloud_SendTelemetry(), the other samples format theirs with snprintf().
+static const benchPayload_t payloads[] = {
+    {"Default sample telemetry",   "{\"sampleKeyString\":\"AvnetKnowsIoT\",\"sampleKeyInt\":42,\"sampleKeyFloat\":57.312}"},
+    {"Default sensor registry",    "{\"wifiRssi\":-52,\"wifiFrequency\":2437,\"memoryHighWaterKB\":212}"},
+    {"Default rule alert",         "{\"ruleAlert\":\"weakSignal\",\"ruleIndex\":0}"},
+    {"Default anomaly",            "{\"anomalyChannel\":\"wifiRssi\",\"anomalyValue\":-81,\"anomalyMean\":-52.4,"
+                                   "\"anomalyStdDev\":2.1,\"anomalyZScore\":-13.6,\"anomalySamples\":3600}"},
+    {"Default anomaly summary",    "{\"summaryChannel\":\"wifiRssi\",\"summaryCount\":600,\"summaryMin\":-58,"
+                                   "\"summaryMax\":-47,\"summaryMean\":-52.4,\"summaryStdDev\":2.1}"},
+    {"Default OTA window",         "{\"otaWindowStartUtc\":\"02:30\",\"otaWindowDelay\":214,\"otaWindowActivity\":0.12,"
+                                   "\"otaPredictedGapSecs\":95}"},
+    {"Default wakeup profile",     "{\"wakeupLoopWakes\":6123,\"wakeupDispatches\":6410,\"wakeupCpuDutyPpm\":1840,"
+                                   "\"wakeupTopSource\":\"ButtonPollTimerEventHandler\",\"wakeupTopSourceDispatches\":6000}"},
+    {"Default boot timeline",      "{\"bootKernelToAppMs\":4210,\"bootAppStartMs\":0,\"bootWifiConfigMs\":12,"
+                                   "\"bootDirectMethodsMs\":13,\"bootM4ConnectMs\":-1,\"bootI2cOledMs\":58,"
+                                   "\"bootUserInterfaceMs\":61,\"bootOtaRegisterMs\":62,\"bootCloudInitMs\":64,"
+                                   "\"bootNetworkReadyMs\":2210,\"bootConnectStartMs\":2212,"
+                                   "\"bootConnectCompleteMs\":5120,\"bootHubAuthenticatedMs\":5121,"
+                                   "\"bootFirstTwinMs\":5480,\"bootIoTConnectReadyMs\":-1,"
+                                   "\"bootFirstTelemetryMs\":5490,\"bootFirstTelemetryAckMs\":5790}"},
+    {"AdvancedDemo sensors",       "{\"gX\":0.01, \"gY\":-0.02, \"gZ\":1.00, \"aX\": 0.35, \"aY\": -0.70, \"aZ\": 0.14, "
+                                   "\"pressure\": 101.32, \"rssi\": -52}"},
+    {"AdvancedDemo motion state",  "{\"motionState\":\"walking\", \"motionConfidence\":0.93, \"pressure\": 101.32, \"rssi\": -52}"},
+    {"AdvancedDemo motion event",  "{\"motionEvent\":\"walking\",\"motionPrevious\":\"still\",\"motionConfidence\":0.93,"
+                                   "\"motionPreviousSeconds\":312,\"motionTransitions\":17}"},
+    {"AdvancedDemo GPS",           "{\"DeviceLocation\":{\"lat\": 41.87811360,\"lon\": -87.62979820,\"alt\": 181.50}, "
+                                   "\"numSat\": 9, \"fix_qual\": 1, \"horiz_dilution\": 0.900000}"},
+    {"AdvancedDemo burst chunk",   "{\"burstId\":7,\"burstChunk\":0,\"burstChunks\":4,\"burstTrigger\":\"anomaly\","
+                                   "\"burstTime\":1697040000,\"burstOdrHz\":416,\"burstFirstSample\":-32,"
+                                   "\"burstX\":[12,15,9,-3,-8,2,11,14,6,-1,-9,-4,7,13,10,0],"
+                                   "\"burstY\":[-4,-2,1,3,5,2,-1,-3,-5,-2,0,4,6,3,-2,-4],"
+                                   "\"burstZ\":[1002,998,1001,1005,1003,999,997,1000,1004,1006,1001,998,996,1000,1003,1002]}"},
+    {"RSL10 motion",               "{\"RSL10Sensors\":{\"address\":\"60:C0:BF:28:9E:2D\",\"rssi\":-67,\"acc_x\":0.0123,"
+                                   "\"acc_y\":-0.0156,\"acc_z\":0.9981,\"orient_x\":0.0012,\"orient_y\":-0.0034,"
+                                   "\"orient_z\":0.7071,\"orient_w\":0.7071}}"},
+    {"RSL10 environment",          "{\"RSL10Sensors\":{\"address\":\"60:C0:BF:28:9E:2D\",\"rssi\":-67,\"temperature\":23.51,"
+                                   "\"humidity\": 41.20,\"pressure\": 1013.25, \"light\": 312}}"},
+    {"RSL10 battery",              "{\"RSL10Sensors\":{\"address\":\"60:C0:BF:28:9E:2D\",\"rssi\":-67,\"battery\":2.98}}"},
+    {"MethaneClick",               "{\"MethaneVoltage\":1.234}"},
+};
+
+static uint64_t nowNs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint64_t)now.tv_sec * 1000000000ULL) + (uint64_t)now.tv_nsec;
+}
+
+/// <summary>
+///     Expand the short keys of a compacted message, the reverse of keyDictionary_Compact().
+///     Returns false if the message can't be expanded or out is too small.
+/// </summary>
+static bool Expand(const keyDictionary_t *dictionary, const char *message, char *out, size_t outSize)
+{
+    size_t used = 0;
+
+    while (*message != '\0') {
+
+        const char *text = message;
+        size_t length = 1;
+
+        if (*message == '"') {
+            const char *end = message + 1;
+            while ((*end != '\0') && (*end != '"')) {
+                end += ((end[0] == '\\') && (end[1] != '\0')) ? 2 : 1;
+            }
+            if (*end == '\0') {
+                return false;
+            }
+            length = (size_t)(end - message) + 1;
+
+            const char *after = end + 1;
+            while ((*after == ' ') || (*after == '\t') || (*after == '\r') || (*after == '\n')) {
+                after++;
+            }
+            if (*after == ':') {
+                for (size_t i = 0; i < dictionary->entryCount; i++) {
+                    const char *shortKey = dictionary->entries[i].shortKey;
+                    if ((strlen(shortKey) == length - 2) && (strncmp(shortKey, message + 1, length - 2) == 0)) {
+                        if (used + strlen(dictionary->entries[i].key) + 2 >= outSize) {
+                            return false;
+                        }
+                        used += (size_t)snprintf(&out[used], outSize - used, "\"%s\"", dictionary->entries[i].key);
+                        text = NULL;
+                        break;
+                    }
+                }
+            }
+        }
+
+        if (text != NULL) {
+            if (used + length >= outSize) {
+                return false;
+            }
+            memcpy(&out[used], text, length);
+            used += length;
+        }
+        message += length;
+    }
+
+    out[used] = '\0';
+    return true;
+}
+
+static void PrintDictionaries(void)
+{
+    printf("{\n");
+    for (size_t i = 0; i < keyDictionaryCount; i++) {
+        const keyDictionary_t *dictionary = &keyDictionaries[i];
+        printf("  \"%s\": {\n", dictionary->id);
+        for (size_t j = 0; j < dictionary->entryCount; j++) {
+            printf("    \"%s\": \"%s\"%s\n", dictionary->entries[j].shortKey, dictionary->entries[j].key,
+                   (j + 1 < dictionary->entryCount) ? "," : "");
+        }
+        printf("  }%s\n", (i + 1 < keyDictionaryCount) ? "," : "");
+    }
+    printf("}\n");
+}
+
+int main(int argc, char *argv[])
+{
+    if ((argc > 2) || ((argc == 2) && (strcmp(argv[1], "--dictionary") != 0))) {
+        fprintf(stderr, "Usage: key_dictionary_bench [--dictionary]\n");
+        return 1;
+    }
+
+    for (size_t i = 0; i < keyDictionaryCount; i++) {
+        const char *problem = keyDictionary_Validate(&keyDictionaries[i]);
+        if (problem != NULL) {
+            fprintf(stderr, "ERROR: dictionary %s: %s\n", keyDictionaries[i].id, problem);
+            return 1;
+        }
+    }
+
+    if (argc == 2) {
+        PrintDictionaries();
+        return 0;
+    }
+
+    const keyDictionary_t *dictionary = &keyDictionaries[keyDictionaryCount - 1];
+
+    // The property goes in the MQTT topic as "kd=<id>"
+    size_t propertyBytes = strlen(KEY_DICTIONARY_PROPERTY) + 1 + strlen(dictionary->id);
+    printf("dictionary %s, %zu keys, the message property costs %zu bytes\n\n", dictionary->id,
+           dictionary->entryCount, propertyBytes);
+    printf("%-28s %6s %8s %10s %8s %10s\n", "payload", "full", "compact", "net saved", "saved", "ns/msg");
+
+    size_t totalFull = 0;
+    size_t totalSent = 0;
+    bool allExpanded = true;
+
+    for (size_t i = 0; i < sizeof(payloads) / sizeof(payloads[0]); i++) {
+
+        static char compact[KEY_DICTIONARY_BUFFER_SIZE];
+        static char expanded[KEY_DICTIONARY_BUFFER_SIZE * 2];
+        size_t fullLength = strlen(payloads[i].message);
+        size_t compactLength = keyDictionary_Compact(dictionary, payloads[i].message, compact, sizeof(compact));
+
+        // A message that isn't compacted is sent as it is, without the property
+        size_t sentLength = (compactLength == 0) ? fullLength : compactLength + propertyBytes;
+        if ((compactLength != 0) && (!Expand(dictionary, compact, expanded, sizeof(expanded)) ||
+                                     (strcmp(expanded, payloads[i].message) != 0))) {
+            printf("%-28s did not expand to the original message\n", payloads[i].name);
+            allExpanded = false;
+        }
+
+        uint64_t start = nowNs();
+        for (int repeat = 0; repeat < TIMING_REPEATS; repeat++) {
+            keyDictionary_Compact(dictionary, payloads[i].message, compact, sizeof(compact));
+        }
+        double nsPerMessage = (double)(nowNs() - start) / TIMING_REPEATS;
+
+        printf("%-28s %6zu %8zu %10d %7.1f%% %10.1f\n", payloads[i].name, fullLength,
+               (compactLength == 0) ? fullLength : compactLength, (int)fullLength - (int)sentLength,
+               100.0 * (double)((int)fullLength - (int)sentLength) / (double)fullLength, nsPerMessage);
+
+        totalFull += fullLength;
+        totalSent += sentLength;
+    }
+
+    printf("\n%-28s %6zu %8s %10d %7.1f%%\n", "total", totalFull, "", (int)totalFull - (int)totalSent,
+           100.0 * (double)((int)totalFull - (int)totalSent) / (double)totalFull);
+
+    return allExpanded ? 0 : 1;
+}
@@ -0,0 +1,774 @@
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  motion_bench: Accuracy and per window cost of the motion classifier
+//                (AvnetAdvancedDemo/HighLevelExampleApp/motion_model.c)
+//
+//  Usage: motion_bench [options]
+//
+//  --model=file          Model to evaluate, default the one in the AvnetAdvancedDemo image package
+//  --eval=file.csv       Recorded samples to evaluate on, default a synthetic trace
+//  --train=file.csv      Train a new model from recorded samples and evaluate that instead.
+//                        "--train=synthetic" trains on a synthetic trace with a different seed
+//                        from the evaluation trace.
+//  --out=file            Write the trained model, copy it to models/motion_model.bin to ship it
+//  --seconds=n           Length of each synthetic trace, default 3600
+//  --depth=n             Deepest tree --train grows, default 6
+//  --json                Print the results as one line of JSON
+//
+//  Recorded samples are CSV lines "label,ax,ay,az,gx,gy,gz" in g and dps at the device sample
+//  rate (MOTION_SAMPLE_PERIOD_MS).  MOTION_LOG_SAMPLES makes the device print each sample as
+//  "MOTION,ax,ay,az,gx,gy,gz", replace "MOTION" with the label for each stretch of the
+//  recording.  Lines starting with '#' are skipped.
+//
+//  The trace is cut into windows the way the device does it (MOTION_WINDOW_SAMPLES every
+//  MOTION_HOP_SAMPLES).  Windows that span two labels are skipped, there is no right answer
+//  for them.  Feature and inference times are the host's, per window, each measured over
+//  TIMING_REPEATS runs.
+//
+//  The synthetic traces model the starter kit on a bench: sensor noise at the LSM6DSO's
+//  datasheet level, idle and tilted boards at rest, moving boards with low frequency
+//  acceleration and rotation, and vibrating boards with a 8..60Hz oscillation sampled at 25Hz
+//  (so the faster vibrations alias).  They are good enough to exercise the code and to ship a
+//  starting model, not to measure accuracy on a real installation.
+//
+//  motion_model.c is compiled into this program with ENABLE_MOTION_CLASSIFIER, see
+//  CMakeLists.txt.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "motion_model.h"
+#include "build_options.h"
+
+#define TIMING_REPEATS 16
+#define MIN_LEAF_WINDOWS 3
+#define MAX_LABEL_SIZE 32
+
+static const char *defaultClasses[] = {"idle", "moving", "vibrating", "tilted"};
+#define DEFAULT_CLASS_COUNT 4
+
+typedef struct {
+    int count;
+    int capacity;
+    motionSample_t *samples;
+    int *label;                     // Index into the class names, -1 for an unknown label
+} trace_t;
+
+typedef struct {
+    int count;
+    float (*features)[MOTION_FEATURE_COUNT];
+    int8_t (*quantized)[MOTION_FEATURE_COUNT];
+    int *label;
+    int skipped;                    // Windows that spanned two labels
+} windowSet_t;
+
+static uint64_t nowNs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint64_t)now.tv_sec * 1000000000ULL) + (uint64_t)now.tv_nsec;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//  Traces
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+static uint64_t rngState;
+
+static double uniform(void)
+{
+    // xorshift64*, deterministic so runs are comparable
+    rngState ^= rngState >> 12;
+    rngState ^= rngState << 25;
+    rngState ^= rngState >> 27;
+    return (double)((rngState * 0x2545F4914F6CDD1DULL) >> 11) / (double)(1ULL << 53);
+}
+
+static double between(double low, double high)
+{
+    return low + ((high - low) * uniform());
+}
+
+static double gaussian(double sigma)
+{
+    double u1 = uniform() + 1e-12;
+    double u2 = uniform();
+    return sigma * sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+static void addSample(trace_t *trace, const motionSample_t *sample, int label)
+{
+    if (trace->count == trace->capacity) {
+        trace->capacity = (trace->capacity == 0) ? 4096 : trace->capacity * 2;
+        trace->samples = realloc(trace->samples, sizeof(motionSample_t) * (size_t)trace->capacity);
+        trace->label = realloc(trace->label, sizeof(int) * (size_t)trace->capacity);
+    }
+    trace->samples[trace->count] = *sample;
+    trace->label[trace->count] = label;
+    trace->count++;
+}
+
+static void randomAxis(double axis[3])
+{
+    double z = between(-1.0, 1.0);
+    double angle = between(0.0, 2.0 * M_PI);
+    double r = sqrt(1.0 - (z * z));
+    axis[0] = r * cos(angle);
+    axis[1] = r * sin(angle);
+    axis[2] = z;
+}
+
+/// <summary>
+///     Segments of 20..90 seconds, each a random class, until the trace is seconds long
+/// </summary>
+static trace_t *syntheticTrace(int seconds, uint64_t seed)
+{
+    const double rateHz = 1000.0 / MOTION_SAMPLE_PERIOD_MS;
+    trace_t *trace = calloc(1, sizeof(trace_t));
+    rngState = seed;
+
+    double t = 0.0;
+    while (t < seconds) {
+
+        int label = (int)(uniform() * DEFAULT_CLASS_COUNT);
+        int samples = (int)(between(20.0, 90.0) * rateHz);
+
+        // Board orientation: tilted boards sit 25..80 degrees from flat, the others within 10
+        double tilt = ((label == 3) ? between(25.0, 80.0) : between(0.0, 10.0)) * M_PI / 180.0;
+        double heading = between(0.0, 2.0 * M_PI);
+        double gravity[3] = {sin(tilt) * cos(heading), sin(tilt) * sin(heading), cos(tilt)};
+
+        // Moving: two low frequency components on random axes
+        double moveAxis[2][3], moveHz[2], moveG[2], turnHz[2], turnDps[2], phase[2];
+        for (int k = 0; k < 2; k++) {
+            randomAxis(moveAxis[k]);
+            moveHz[k] = between(0.3, 2.0);
+            moveG[k] = between(0.03, 0.25);
+            turnHz[k] = between(0.2, 1.5);
+            turnDps[k] = between(5.0, 60.0);
+            phase[k] = between(0.0, 2.0 * M_PI);
+        }
+
+        // Vibrating: one oscillation along a random axis
+        double vibAxis[3];
+        randomAxis(vibAxis);
+        double vibHz = between(8.0, 60.0);
+        double vibG = between(0.02, 0.4);
+        double vibDps = between(0.5, 4.0);
+
+        for (int i = 0; i < samples; i++, t += 1.0 / rateHz) {
+
+            double a[3] = {gravity[0], gravity[1], gravity[2]};
+            double g[3] = {0.0, 0.0, 0.0};
+
+            if (label == 1) {
+                for (int k = 0; k < 2; k++) {
+                    double s = sin((2.0 * M_PI * moveHz[k] * t) + phase[k]);
+                    double r = sin((2.0 * M_PI * turnHz[k] * t) + phase[k]);
+                    for (int axis = 0; axis < 3; axis++) {
+                        a[axis] += moveG[k] * s * moveAxis[k][axis];
+                        g[axis] += turnDps[k] * r * moveAxis[1 - k][axis];
+                    }
+                }
+            }
+            else if (label == 2) {
+                double s = sin(2.0 * M_PI * vibHz * t);
+                for (int axis = 0; axis < 3; axis++) {
+                    a[axis] += vibG * s * vibAxis[axis];
+                    g[axis] += vibDps * s * vibAxis[(axis + 1) % 3];
+                }
+            }
+
+            // LSM6DSO noise at 2g / 2000dps full scale, after the gyro offset calibration
+            motionSample_t sample = {
+                .ax = (float)(a[0] + gaussian(0.004)), .ay = (float)(a[1] + gaussian(0.004)),
+                .az = (float)(a[2] + gaussian(0.004)), .gx = (float)(g[0] + gaussian(0.25)),
+                .gy = (float)(g[1] + gaussian(0.25)), .gz = (float)(g[2] + gaussian(0.25))};
+            addSample(trace, &sample, label);
+        }
+    }
+    return trace;
+}
+
+static int findClass(const char names[][MOTION_CLASS_NAME_SIZE], int count, const char *label)
+{
+    for (int i = 0; i < count; i++) {
+        if (strcmp(names[i], label) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/// <summary>
+///     Load "label,ax,ay,az,gx,gy,gz" lines.  New labels are added to names[] until it is full.
+/// </summary>
+static trace_t *loadCsvTrace(const char *path, char names[][MOTION_CLASS_NAME_SIZE], int *classCount)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        fprintf(stderr, "ERROR: Can't open %s\n", path);
+        return NULL;
+    }
+
+    trace_t *trace = calloc(1, sizeof(trace_t));
+    char line[256];
+    char label[MAX_LABEL_SIZE];
+    motionSample_t s;
+    int unknown = 0;
+
+    while (fgets(line, sizeof(line), file) != NULL) {
+
+        if ((line[0] == '#') ||
+            (sscanf(line, "%31[^,],%f,%f,%f,%f,%f,%f", label, &s.ax, &s.ay, &s.az, &s.gx, &s.gy,
+                    &s.gz) != 7)) {
+            continue;
+        }
+
+        int index = findClass(names, *classCount, label);
+        if ((index < 0) && (*classCount < MOTION_MAX_CLASSES) &&
+            (strlen(label) < MOTION_CLASS_NAME_SIZE)) {
+            index = (*classCount)++;
+            strcpy(names[index], label);
+        }
+        if (index < 0) {
+            unknown++;
+        }
+        addSample(trace, &s, index);
+    }
+    fclose(file);
+
+    if (unknown > 0) {
+        fprintf(stderr, "WARNING: %s: %d samples have a label the model does not know\n", path, unknown);
+    }
+    return trace;
+}
+
+static void freeTrace(trace_t *trace)
+{
+    free(trace->samples);
+    free(trace->label);
+    free(trace);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//  Windows
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+static windowSet_t *cutWindows(const trace_t *trace)
+{
+    windowSet_t *set = calloc(1, sizeof(windowSet_t));
+    int capacity = (trace->count / MOTION_HOP_SAMPLES) + 1;
+    set->features = malloc(sizeof(*set->features) * (size_t)capacity);
+    set->quantized = malloc(sizeof(*set->quantized) * (size_t)capacity);
+    set->label = malloc(sizeof(int) * (size_t)capacity);
+
+    for (int start = 0; start + MOTION_WINDOW_SAMPLES <= trace->count; start += MOTION_HOP_SAMPLES) {
+
+        int label = trace->label[start];
+        bool mixed = (label < 0);
+        for (int i = 1; (i < MOTION_WINDOW_SAMPLES) && !mixed; i++) {
+            mixed = (trace->label[start + i] != label);
+        }
+        if (mixed) {
+            set->skipped++;
+            continue;
+        }
+
+        motionModel_Features(&trace->samples[start], MOTION_WINDOW_SAMPLES, set->features[set->count]);
+        set->label[set->count] = label;
+        set->count++;
+    }
+    return set;
+}
+
+static void freeWindows(windowSet_t *set)
+{
+    free(set->features);
+    free(set->quantized);
+    free(set->label);
+    free(set);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//  Training
+//
+//  A CART tree on the quantized features: every split is the threshold with the lowest weighted
+//  Gini impurity, found from per value class histograms.  Leaves hold the majority class and its
+//  share of the leaf's training windows as the confidence.
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+static double gini(const int *counts, int classCount, int total)
+{
+    if (total == 0) {
+        return 0.0;
+    }
+    double sum = 0.0;
+    for (int c = 0; c < classCount; c++) {
+        double p = (double)counts[c] / total;
+        sum += p * p;
+    }
+    return 1.0 - sum;
+}
+
+/// <summary>
+///     Scale each feature so the training range maps onto -128..127
+/// </summary>
+static void fitQuantization(motionModel_t *model, const windowSet_t *set)
+{
+    for (int f = 0; f < MOTION_FEATURE_COUNT; f++) {
+
+        float low = INFINITY, high = -INFINITY;
+        for (int i = 0; i < set->count; i++) {
+            low = fminf(low, set->features[i][f]);
+            high = fmaxf(high, set->features[i][f]);
+        }
+        if (!(high > low)) {
+            high = low + 1.0f;
+        }
+
+        model->offset[f] = low;
+        model->scale[f] = (high - low) / 255.0f;
+    }
+}
+
+static int growNode(motionModel_t *model, const windowSet_t *set, int *indexes, int count, int depth,
+                    int maxDepth)
+{
+    int counts[MOTION_MAX_CLASSES] = {0};
+    for (int i = 0; i < count; i++) {
+        counts[set->label[indexes[i]]]++;
+    }
+
+    int majority = 0;
+    for (int c = 1; c < model->classCount; c++) {
+        if (counts[c] > counts[majority]) {
+            majority = c;
+        }
+    }
+
+    int bestFeature = -1, bestThreshold = 0;
+    double bestImpurity = gini(counts, model->classCount, count);
+
+    // Leaves take a node each, a split needs room for at least two more
+    if ((depth < maxDepth) && (bestImpurity > 0.0) && (model->nodeCount + 3 <= MOTION_MAX_NODES)) {
+
+        for (int f = 0; f < MOTION_FEATURE_COUNT; f++) {
+
+            static int histogram[256][MOTION_MAX_CLASSES];
+            memset(histogram, 0, sizeof(histogram));
+            for (int i = 0; i < count; i++) {
+                histogram[set->quantized[indexes[i]][f] + 128][set->label[indexes[i]]]++;
+            }
+
+            int left[MOTION_MAX_CLASSES] = {0};
+            int leftCount = 0;
+            for (int v = 0; v < 255; v++) {
+
+                for (int c = 0; c < model->classCount; c++) {
+                    left[c] += histogram[v][c];
+                    leftCount += histogram[v][c];
+                }
+                int rightCount = count - leftCount;
+                if ((leftCount < MIN_LEAF_WINDOWS) || (rightCount < MIN_LEAF_WINDOWS)) {
+                    continue;
+                }
+
+                int right[MOTION_MAX_CLASSES];
+                for (int c = 0; c < model->classCount; c++) {
+                    right[c] = counts[c] - left[c];
+                }
+                double impurity = ((leftCount * gini(left, model->classCount, leftCount)) +
+                                   (rightCount * gini(right, model->classCount, rightCount))) / count;
+                if (impurity < bestImpurity - 1e-9) {
+                    bestImpurity = impurity;
+                    bestFeature = f;
+                    bestThreshold = v - 128;
+                }
+            }
+        }
+    }
+
+    int index = model->nodeCount++;
+    motionNode_t *node = &model->nodes[index];
+
+    if (bestFeature < 0) {
+        node->feature = MOTION_NODE_LEAF;
+        node->threshold = (int8_t)majority;
+        node->left = (uint8_t)lround(255.0 * counts[majority] / count);
+        node->right = 0;
+        return index;
+    }
+
+    // Partition in place, left side first
+    int split = 0;
+    for (int i = 0; i < count; i++) {
+        if (set->quantized[indexes[i]][bestFeature] <= bestThreshold) {
+            int swap = indexes[split];
+            indexes[split++] = indexes[i];
+            indexes[i] = swap;
+        }
+    }
+
+    node->feature = (int8_t)bestFeature;
+    node->threshold = (int8_t)bestThreshold;
+    node->left = (uint8_t)growNode(model, set, indexes, split, depth + 1, maxDepth);
+    node->right = (uint8_t)growNode(model, set, &indexes[split], count - split, depth + 1, maxDepth);
+    return index;
+}
+
+static void quantizeWindows(const motionModel_t *model, windowSet_t *set)
+{
+    for (int i = 0; i < set->count; i++) {
+        motionModel_Quantize(model, set->features[i], set->quantized[i]);
+    }
+}
+
+static void trainModel(motionModel_t *model, windowSet_t *set, int maxDepth)
+{
+    fitQuantization(model, set);
+    quantizeWindows(model, set);
+
+    int *indexes = malloc(sizeof(int) * (size_t)set->count);
+    for (int i = 0; i < set->count; i++) {
+        indexes[i] = i;
+    }
+    model->nodeCount = 0;
+    growNode(model, set, indexes, set->count, 0, maxDepth);
+    free(indexes);
+}
+
+/// <summary>
+///     Write the model in the format motionModel_Parse() reads, returns the file size
+/// </summary>
+static size_t serializeModel(const motionModel_t *model, uint8_t *buffer)
+{
+    size_t length = 0;
+
+    memcpy(buffer, MOTION_MODEL_MAGIC, 4);
+    buffer[4] = MOTION_FEATURE_COUNT;
+    buffer[5] = (uint8_t)model->classCount;
+    buffer[6] = (uint8_t)model->nodeCount;
+    buffer[7] = 0;
+    length = MOTION_MODEL_HEADER_SIZE;
+
+    memcpy(&buffer[length], model->offset, sizeof(float) * MOTION_FEATURE_COUNT);
+    length += sizeof(float) * MOTION_FEATURE_COUNT;
+    memcpy(&buffer[length], model->scale, sizeof(float) * MOTION_FEATURE_COUNT);
+    length += sizeof(float) * MOTION_FEATURE_COUNT;
+
+    for (int i = 0; i < model->classCount; i++) {
+        memset(&buffer[length], 0, MOTION_CLASS_NAME_SIZE);
+        strncpy((char *)&buffer[length], model->className[i], MOTION_CLASS_NAME_SIZE - 1);
+        length += MOTION_CLASS_NAME_SIZE;
+    }
+
+    for (int i = 0; i < model->nodeCount; i++) {
+        buffer[length++] = (uint8_t)model->nodes[i].feature;
+        buffer[length++] = (uint8_t)model->nodes[i].threshold;
+        buffer[length++] = model->nodes[i].left;
+        buffer[length++] = model->nodes[i].right;
+    }
+
+    uint32_t checksum = motionModel_Checksum(buffer, length);
+    memcpy(&buffer[length], &checksum, sizeof(checksum));
+    return length + sizeof(checksum);
+}
+
+static int treeDepth(const motionModel_t *model, int index)
+{
+    const motionNode_t *node = &model->nodes[index];
+    if (node->feature == MOTION_NODE_LEAF) {
+        return 0;
+    }
+    int left = treeDepth(model, node->left);
+    int right = treeDepth(model, node->right);
+    return 1 + ((left > right) ? left : right);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//  Evaluation
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int compareDouble(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile(double *values, int count, double p)
+{
+    qsort(values, (size_t)count, sizeof(double), compareDouble);
+    return values[(int)(p * (count - 1))];
+}
+
+int main(int argc, char *argv[])
+{
+    const char *modelPath = MOTION_MODEL_DEFAULT_PATH;
+    const char *evalPath = NULL;
+    const char *trainPath = NULL;
+    const char *outPath = NULL;
+    int seconds = 3600;
+    int maxDepth = 6;
+    bool jsonOutput = false;
+
+    static const struct option options[] = {
+        {"model", required_argument, NULL, 'm'},
+        {"eval", required_argument, NULL, 'e'},
+        {"train", required_argument, NULL, 't'},
+        {"out", required_argument, NULL, 'o'},
+        {"seconds", required_argument, NULL, 's'},
+        {"depth", required_argument, NULL, 'd'},
+        {"json", no_argument, NULL, 'J'},
+        {NULL, 0, NULL, 0}};
+
+    int option;
+    while ((option = getopt_long(argc, argv, "", options, NULL)) != -1) {
+        switch (option) {
+        case 'm':
+            modelPath = optarg;
+            break;
+        case 'e':
+            evalPath = optarg;
+            break;
+        case 't':
+            trainPath = optarg;
+            break;
+        case 'o':
+            outPath = optarg;
+            break;
+        case 's':
+            seconds = atoi(optarg);
+            break;
+        case 'd':
+            maxDepth = atoi(optarg);
+            break;
+        case 'J':
+            jsonOutput = true;
+            break;
+        default:
+            fprintf(stderr, "Usage: see the comment at the top of motion_bench.c\n");
+            return 1;
+        }
+    }
+
+    if ((seconds < 60) || (maxDepth < 1) || (maxDepth > 16) || ((outPath != NULL) && (trainPath == NULL))) {
+        fprintf(stderr, "Usage: see the comment at the top of motion_bench.c\n");
+        return 1;
+    }
+
+    static motionModel_t model;
+    static uint8_t modelFile[MOTION_MODEL_MAX_SIZE + 1];
+    size_t modelBytes;
+
+    // The class names come from the model, or from the training labels
+    char names[MOTION_MAX_CLASSES][MOTION_CLASS_NAME_SIZE] = {{0}};
+    int classCount = 0;
+
+    if (trainPath != NULL) {
+
+        trace_t *trace;
+        if (strcmp(trainPath, "synthetic") == 0) {
+            for (classCount = 0; classCount < DEFAULT_CLASS_COUNT; classCount++) {
+                strcpy(names[classCount], defaultClasses[classCount]);
+            }
+            trace = syntheticTrace(seconds, 0x5EED0001ULL);
+        }
+        else if ((trace = loadCsvTrace(trainPath, names, &classCount)) == NULL) {
+            return 1;
+        }
+
+        windowSet_t *train = cutWindows(trace);
+        if (train->count == 0) {
+            fprintf(stderr, "ERROR: No complete windows to train on\n");
+            return 1;
+        }
+
+        memset(&model, 0, sizeof(model));
+        model.classCount = classCount;
+        memcpy(model.className, names, sizeof(names));
+        trainModel(&model, train, maxDepth);
+        freeWindows(train);
+        freeTrace(trace);
+
+        modelBytes = serializeModel(&model, modelFile);
+        if (outPath != NULL) {
+            FILE *file = fopen(outPath, "wb");
+            if ((file == NULL) || (fwrite(modelFile, 1, modelBytes, file) != modelBytes) || (fclose(file) != 0)) {
+                fprintf(stderr, "ERROR: Can't write %s\n", outPath);
+                return 1;
+            }
+        }
+        modelPath = (outPath != NULL) ? outPath : "(trained)";
+    }
+    else {
+        FILE *file = fopen(modelPath, "rb");
+        if (file == NULL) {
+            fprintf(stderr, "ERROR: Can't open %s\n", modelPath);
+            return 1;
+        }
+        modelBytes = fread(modelFile, 1, sizeof(modelFile), file);
+        fclose(file);
+    }
+
+    // Evaluate what the device would load, so the round trip through the file is tested too
+    const char *error = motionModel_Parse(&model, modelFile, modelBytes);
+    if (error != NULL) {
+        fprintf(stderr, "ERROR: %s: %s\n", modelPath, error);
+        return 1;
+    }
+    classCount = model.classCount;
+    memcpy(names, model.className, sizeof(names));
+
+    trace_t *trace;
+    if (evalPath != NULL) {
+        int knownClasses = classCount;
+        trace = loadCsvTrace(evalPath, names, &knownClasses);
+        if (trace == NULL) {
+            return 1;
+        }
+        // Labels the model does not have count as windows to skip
+        for (int i = 0; i < trace->count; i++) {
+            if (trace->label[i] >= classCount) {
+                trace->label[i] = -1;
+            }
+        }
+    }
+    else {
+        trace = syntheticTrace(seconds, 0x5EED0002ULL);
+    }
+
+    windowSet_t *eval = cutWindows(trace);
+    if (eval->count == 0) {
+        fprintf(stderr, "ERROR: No complete windows to evaluate\n");
+        return 1;
+    }
+
+    int confusion[MOTION_MAX_CLASSES][MOTION_MAX_CLASSES] = {{0}};
+    double *featureNs = malloc(sizeof(double) * (size_t)eval->count);
+    double *inferenceNs = malloc(sizeof(double) * (size_t)eval->count);
+    int correct = 0;
+    volatile int sink = 0;
+
+    for (int w = 0, start = 0; start + MOTION_WINDOW_SAMPLES <= trace->count; start += MOTION_HOP_SAMPLES) {
+
+        // cutWindows() kept the same windows in the same order
+        int label = trace->label[start];
+        bool mixed = (label < 0);
+        for (int i = 1; (i < MOTION_WINDOW_SAMPLES) && !mixed; i++) {
+            mixed = (trace->label[start + i] != label);
+        }
+        if (mixed) {
+            continue;
+        }
+
+        float features[MOTION_FEATURE_COUNT];
+        int8_t quantized[MOTION_FEATURE_COUNT];
+        uint8_t confidence;
+        int result = 0;
+
+        uint64_t begin = nowNs();
+        for (int r = 0; r < TIMING_REPEATS; r++) {
+            motionModel_Features(&trace->samples[start], MOTION_WINDOW_SAMPLES, features);
+            sink += (int)features[r % MOTION_FEATURE_COUNT];
+        }
+        featureNs[w] = (double)(nowNs() - begin) / TIMING_REPEATS;
+
+        begin = nowNs();
+        for (int r = 0; r < TIMING_REPEATS; r++) {
+            motionModel_Quantize(&model, features, quantized);
+            result = motionModel_Classify(&model, quantized, &confidence);
+            sink += result;
+        }
+        inferenceNs[w] = (double)(nowNs() - begin) / TIMING_REPEATS;
+
+        confusion[label][result]++;
+        correct += (result == label);
+        w++;
+    }
+
+    double accuracy = 100.0 * correct / eval->count;
+    double featureMean = 0.0, inferenceMean = 0.0;
+    for (int i = 0; i < eval->count; i++) {
+        featureMean += featureNs[i] / eval->count;
+        inferenceMean += inferenceNs[i] / eval->count;
+    }
+    double featureP99 = percentile(featureNs, eval->count, 0.99);
+    double inferenceP99 = percentile(inferenceNs, eval->count, 0.99);
+    int depth = treeDepth(&model, 0);
+
+    if (jsonOutput) {
+        printf("{\"model\":\"%s\",\"modelBytes\":%zu,\"nodes\":%d,\"depth\":%d,\"windows\":%d,"
+               "\"skippedWindows\":%d,\"accuracy\":%.2f,\"featureNsMean\":%.1f,\"featureNsP99\":%.1f,"
+               "\"inferenceNsMean\":%.1f,\"inferenceNsP99\":%.1f}\n",
+               modelPath, modelBytes, model.nodeCount, depth, eval->count, eval->skipped, accuracy,
+               featureMean, featureP99, inferenceMean, inferenceP99);
+    }
+    else {
+        printf("model       %s, %zu bytes, %d nodes, depth %d\n", modelPath, modelBytes,
+               model.nodeCount, depth);
+        printf("data        %s, %d windows of %d samples (%d spanning two labels skipped)\n",
+               (evalPath != NULL) ? evalPath : "synthetic", eval->count, MOTION_WINDOW_SAMPLES,
+               eval->skipped);
+        printf("accuracy    %.2f%%\n", accuracy);
+        printf("per window  features %.0f ns (p99 %.0f), quantize + tree %.0f ns (p99 %.0f)\n\n",
+               featureMean, featureP99, inferenceMean, inferenceP99);
+
+        printf("%-12s", "actual");
+        for (int c = 0; c < classCount; c++) {
+            printf("%12s", names[c]);
+        }
+        printf("%10s\n", "recall");
+        for (int a = 0; a < classCount; a++) {
+            int total = 0;
+            printf("%-12s", names[a]);
+            for (int c = 0; c < classCount; c++) {
+                printf("%12d", confusion[a][c]);
+                total += confusion[a][c];
+            }
+            printf("%9.1f%%\n", (total > 0) ? 100.0 * confusion[a][a] / total : 0.0);
+        }
+    }
+
+    free(featureNs);
+    free(inferenceNs);
+    freeWindows(eval);
+    freeTrace(trace);
+    return 0;
+}
@@ -0,0 +1,290 @@
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  pipeline_bench: Throughput and payload size of the staged telemetry pipeline
+//                  (common/telemetry_pipeline.c)
+//
+//  Usage: pipeline_bench [seconds]
+//
+//  Replays the same sensor trace through pipelines built from the built in stages and reports,
+//  for each, the host time per sample (push plus flush), the messages and payload bytes that
+//  reached the sink, and the per stage drop counters.  The trace is the default project's
+//  sensor registry at its default periods: wifiRssi with +/- 2 dBm of noise, a fixed
+//  wifiFrequency and a slowly climbing memoryHighWaterKB, one reading each per second, with a
+//  flush every SEND_TELEMETRY_PERIOD_SECONDS.  The default trace is 3600 seconds long.
+//
+//  The sink counts the messages and decodes each binary message to check it carries the
+//  samples the encoder was given.  telemetry_pipeline.c is compiled into this program with
+//  ENABLE_TELEMETRY_PIPELINE, the copy in hla_host is built without it and is empty.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "host_stubs.h"
+#include "telemetry_pipeline.h"
+
+#define FLUSH_PERIOD_SECONDS 30
+#define TIMING_REPEATS 20
+
+typedef struct {
+    uint32_t messages;
+    uint32_t bytes;
+    uint32_t samples;           // Decoded from binary messages
+    bool valid;
+} benchSink_t;
+
+typedef struct {
+    const char *name;
+    pipeline_t *pipeline;
+    benchSink_t *sink;
+    void (*reset)(void);
+} benchPipeline_t;
+
+static const char *keys[] = {"wifiRssi", "wifiFrequency", "memoryHighWaterKB"};
+
+static uint64_t nowNs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint64_t)now.tv_sec * 1000000000ULL) + (uint64_t)now.tv_nsec;
+}
+
+static uint64_t rngState = 0x9E3779B97F4A7C15ULL;
+
+static double uniform(void)
+{
+    // xorshift64*, deterministic so runs are comparable
+    rngState ^= rngState >> 12;
+    rngState ^= rngState << 25;
+    rngState ^= rngState >> 27;
+    return (double)((rngState * 0x2545F4914F6CDD1DULL) >> 11) / (double)(1ULL << 53);
+}
+
+/// <summary>
+///     Walk a binary message and count its samples, false if it is malformed
+/// </summary>
+static bool DecodeBinary(const pipelineMessage_t *message, uint32_t *samples)
+{
+    const uint8_t *data = message->data;
+    size_t offset = 7;
+
+    if ((message->length < 7) || (data[0] != 1)) {
+        return false;
+    }
+
+    for (int i = 0; (i < data[1]) && (offset < message->length); i++) {
+        offset += 1 + data[offset];
+    }
+
+    for (int i = 0; i < data[2]; i++) {
+        if ((offset >= message->length) || (data[offset] >= data[1])) {
+            return false;
+        }
+        offset++;
+        while ((offset < message->length) && (data[offset] & 0x80)) {
+            offset++;
+        }
+        offset += 1 + 4;
+    }
+
+    *samples += data[2];
+    return offset == message->length;
+}
+
+static pipelineSinkResult_t BenchSinkSend(void *context, const pipelineMessage_t *message)
+{
+    benchSink_t *sink = (benchSink_t *)context;
+
+    sink->messages++;
+    sink->bytes += message->length;
+    if (!message->text && !DecodeBinary(message, &sink->samples)) {
+        sink->valid = false;
+    }
+    return PIPELINE_SINK_SENT;
+}
+
+#define BENCH_SINK(ctx) {.name = "bench", .send = BenchSinkSend, .context = (ctx)}
+
+static pipelineDeadband_t deadband;
+static pipelineReduce_t latest;
+static pipelineReduce_t mean;
+static pipelineBatch_t batchJson;
+static pipelineBatch_t batchBinary;
+static benchSink_t sinks[5];
+
+static pipelineFilter_t deadbandFilters[] = {PIPELINE_DEADBAND_FILTER(&deadband)};
+
+static pipeline_t latestJson = {
+    .name = "deadband, latest, json",
+    .filters = deadbandFilters, .filterCount = 1,
+    .aggregate = PIPELINE_REDUCE_STAGE(&latest),
+    .encoder = PIPELINE_JSON_ENCODER,
+    .sink = BENCH_SINK(&sinks[0]),
+};
+static pipeline_t meanJson = {
+    .name = "mean, json",
+    .aggregate = PIPELINE_REDUCE_STAGE(&mean),
+    .encoder = PIPELINE_JSON_ENCODER,
+    .sink = BENCH_SINK(&sinks[1]),
+};
+static pipeline_t meanBinary = {
+    .name = "mean, binary",
+    .aggregate = PIPELINE_REDUCE_STAGE(&mean),
+    .encoder = PIPELINE_BINARY_ENCODER,
+    .sink = BENCH_SINK(&sinks[2]),
+};
+static pipeline_t allJson = {
+    .name = "batch, json",
+    .aggregate = PIPELINE_BATCH_STAGE(&batchJson),
+    .encoder = PIPELINE_JSON_ENCODER,
+    .sink = BENCH_SINK(&sinks[3]),
+};
+static pipeline_t allBinary = {
+    .name = "batch, binary",
+    .aggregate = PIPELINE_BATCH_STAGE(&batchBinary),
+    .encoder = PIPELINE_BINARY_ENCODER,
+    .sink = BENCH_SINK(&sinks[4]),
+};
+
+static pipeline_t *benchPipelines[] = {&latestJson, &meanJson, &meanBinary, &allJson, &allBinary};
+#define PIPELINE_COUNT (sizeof(benchPipelines) / sizeof(benchPipelines[0]))
+
+/// <summary>
+///     Clear the stage state and counters so each timing run starts the same way
+/// </summary>
+static void ResetPipeline(pipeline_t *pipeline, size_t index)
+{
+    memset(&pipeline->source, 0, sizeof(pipelineCounters_t));
+    memset(&pipeline->queue, 0, sizeof(pipelineCounters_t));
+    for (size_t i = 0; i < pipeline->filterCount; i++) {
+        memset(&pipeline->filters[i].counters, 0, sizeof(pipelineCounters_t));
+    }
+    memset(&pipeline->aggregate.counters, 0, sizeof(pipelineCounters_t));
+    memset(&pipeline->encoder.counters, 0, sizeof(pipelineCounters_t));
+    memset(&pipeline->sink.counters, 0, sizeof(pipelineCounters_t));
+    pipeline->queueHead = 0;
+    pipeline->queueCount = 0;
+
+    memset(&deadband, 0, sizeof(deadband));
+    deadband.deadband = 1.0f;
+    memset(&latest, 0, sizeof(latest));
+    latest.mode = PIPELINE_REDUCE_LATEST;
+    memset(&mean, 0, sizeof(mean));
+    mean.mode = PIPELINE_REDUCE_MEAN;
+    memset(&batchJson, 0, sizeof(batchJson));
+    memset(&batchBinary, 0, sizeof(batchBinary));
+    memset(&sinks[index], 0, sizeof(benchSink_t));
+    sinks[index].valid = true;
+}
+
+int main(int argc, char *argv[])
+{
+    int seconds = (argc > 1) ? atoi(argv[1]) : 3600;
+    if (seconds <= 0) {
+        fprintf(stderr, "Usage: pipeline_bench [seconds]\n");
+        return 1;
+    }
+
+    hostLogOutput = false;
+
+    // One reading per channel per second
+    int sampleCount = seconds * 3;
+    float *values = malloc(sizeof(float) * (size_t)sampleCount);
+    float memoryKB = 180.0f;
+    for (int i = 0; i < seconds; i++) {
+        values[(3 * i) + 0] = -55.0f + (float)lround((uniform() * 4.0) - 2.0);
+        values[(3 * i) + 1] = 2437.0f;
+        memoryKB += (uniform() < 0.01) ? 4.0f : 0.0f;
+        values[(3 * i) + 2] = memoryKB;
+    }
+
+    printf("%-24s %10s %9s %10s %10s %9s %9s\n", "pipeline", "ns/sample", "messages", "bytes",
+           "bytes/smp", "filtered", "dropped");
+
+    bool valid = true;
+    for (size_t p = 0; p < PIPELINE_COUNT; p++) {
+
+        pipeline_t *pipeline = benchPipelines[p];
+        uint64_t bestNs = UINT64_MAX;
+
+        for (int repeat = 0; repeat < TIMING_REPEATS; repeat++) {
+
+            ResetPipeline(pipeline, p);
+            if (pipeline_Init(&benchPipelines[p], 1) != ExitCode_Success) {
+                fprintf(stderr, "ERROR: %s rejected\n", pipeline->name);
+                return 1;
+            }
+
+            uint64_t startNs = nowNs();
+            for (int i = 0; i < seconds; i++) {
+                for (int k = 0; k < 3; k++) {
+                    pipeline_Push(keys[k], values[(3 * i) + k], (uint64_t)i * 1000);
+                }
+                if ((i + 1) % FLUSH_PERIOD_SECONDS == 0) {
+                    pipeline_FlushAll();
+                }
+            }
+            pipeline_FlushAll();
+            uint64_t elapsedNs = nowNs() - startNs;
+            if (elapsedNs < bestNs) {
+                bestNs = elapsedNs;
+            }
+            pipeline_Cleanup();
+        }
+
+        const benchSink_t *sink = &sinks[p];
+        uint32_t filtered = 0;
+        for (size_t i = 0; i < pipeline->filterCount; i++) {
+            filtered += pipeline->filters[i].counters.dropped;
+        }
+        uint32_t dropped = pipeline->aggregate.counters.dropped + pipeline->encoder.counters.dropped +
+                           pipeline->queue.dropped + pipeline->sink.counters.dropped;
+
+        // Binary messages must carry every sample the encoder was given
+        if (!pipeline->encoder.text &&
+            (!sink->valid || (sink->samples != pipeline->encoder.counters.in))) {
+            printf("%-24s binary messages did not decode\n", pipeline->name);
+            valid = false;
+        }
+
+        printf("%-24s %10.1f %9u %10u %10.2f %9u %9u\n", pipeline->name,
+               (double)bestNs / (double)sampleCount, sink->messages, sink->bytes,
+               (double)sink->bytes / (double)sampleCount, filtered, dropped);
+    }
+
+    free(values);
+    return valid ? 0 : 1;
+}
@@ -0,0 +1,328 @@
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  ts_bench: Compression and throughput of the time series store (common/timeseries_store.c)
+//
+//  Usage: ts_bench [trace.csv ...]
+//
+//  Each trace is appended to an empty store, read back and checked bit for bit, then encoded and
+//  decoded repeatedly to measure the rate.  The report shows the compressed bytes per sample
+//  (block headers included) against 12 bytes for a raw 8 byte timestamp and 4 byte float.
+//
+//  Without arguments the built in traces are generated the way the LSM6DSO and LPS22HH drivers
+//  produce readings: integer LSBs with sensor noise, converted with the driver's sensitivity
+//  (0.061 mg/LSB, 8.75 mdps/LSB, 1/4096 hPa/LSB, 0.01 degC/LSB), and timestamps from a poll
+//  timer with +/- 1 ms jitter.  Recorded traces can be passed as CSV files with one
+//  "timeMs,value" line per sample.
+//
+//  The store is built with a large pool (see CMakeLists.txt) so the longest trace fits without
+//  reusing blocks.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "timeseries_store.h"
+
+#define TRACE_SAMPLES 20000
+#define MIN_SECONDS 0.25
+#define RAW_BYTES_PER_SAMPLE 12.0
+
+typedef struct {
+    const char *name;
+    int count;
+    uint64_t *timeMs;
+    float *value;
+} trace_t;
+
+typedef struct {
+    const trace_t *trace;
+    int index;
+    bool match;
+    double sum;
+} checkContext_t;
+
+static uint64_t nowNs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint64_t)now.tv_sec * 1000000000ULL) + (uint64_t)now.tv_nsec;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//  Trace generation
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+static uint64_t rngState = 0x9E3779B97F4A7C15ULL;
+
+static double uniform(void)
+{
+    // xorshift64*, deterministic so runs are comparable
+    rngState ^= rngState >> 12;
+    rngState ^= rngState << 25;
+    rngState ^= rngState >> 27;
+    return (double)((rngState * 0x2545F4914F6CDD1DULL) >> 11) / (double)(1ULL << 53);
+}
+
+static double gaussian(double sigma)
+{
+    double u1 = uniform() + 1e-12;
+    double u2 = uniform();
+    return sigma * sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+static trace_t *allocTrace(const char *name, int count)
+{
+    trace_t *trace = calloc(1, sizeof(trace_t));
+    trace->name = name;
+    trace->count = count;
+    trace->timeMs = malloc(sizeof(uint64_t) * (size_t)count);
+    trace->value = malloc(sizeof(float) * (size_t)count);
+    return trace;
+}
+
+// Timer polled at periodMs, each read lands up to 1 ms late
+static uint64_t pollTime(int i, double periodMs)
+{
+    return 1000 + (uint64_t)llround(i * periodMs) + (uniform() < 0.2 ? 1 : 0);
+}
+
+// Accelerometer axis at rest: 1 g on the axis plus noise, +/-2 g full scale
+static trace_t *lsm6dsoAccelIdle(const char *name, double periodMs)
+{
+    trace_t *trace = allocTrace(name, TRACE_SAMPLES);
+    for (int i = 0; i < trace->count; i++) {
+        int16_t lsb = (int16_t)lround(16393.0 + gaussian(4.0));
+        trace->timeMs[i] = pollTime(i, periodMs);
+        trace->value[i] = (float)lsb * 0.061f;
+    }
+    return trace;
+}
+
+// Accelerometer axis while the board is carried: 1.5 Hz swing plus vibration
+static trace_t *lsm6dsoAccelMotion(const char *name, double periodMs)
+{
+    trace_t *trace = allocTrace(name, TRACE_SAMPLES);
+    for (int i = 0; i < trace->count; i++) {
+        double seconds = i * periodMs / 1000.0;
+        double mg = 350.0 * sin(2.0 * M_PI * 1.5 * seconds) + 40.0 * sin(2.0 * M_PI * 11.0 * seconds);
+        int16_t lsb = (int16_t)lround((mg / 0.061) + gaussian(6.0));
+        trace->timeMs[i] = pollTime(i, periodMs);
+        trace->value[i] = (float)lsb * 0.061f;
+    }
+    return trace;
+}
+
+// Gyroscope axis at rest, +/-250 dps full scale, reported in dps
+static trace_t *lsm6dsoGyroIdle(const char *name, double periodMs)
+{
+    trace_t *trace = allocTrace(name, TRACE_SAMPLES);
+    for (int i = 0; i < trace->count; i++) {
+        int16_t lsb = (int16_t)lround(-3.0 + gaussian(2.5));
+        trace->timeMs[i] = pollTime(i, periodMs);
+        trace->value[i] = ((float)lsb * 8.75f) / 1000.0f;
+    }
+    return trace;
+}
+
+// Barometric pressure with a slow weather drift
+static trace_t *lps22hhPressure(const char *name, double periodMs)
+{
+    trace_t *trace = allocTrace(name, TRACE_SAMPLES);
+    for (int i = 0; i < trace->count; i++) {
+        double hPa = 1013.25 + 0.8 * sin(2.0 * M_PI * i / (double)TRACE_SAMPLES);
+        int32_t lsb = (int32_t)lround((hPa * 4096.0) + gaussian(30.0));
+        trace->timeMs[i] = pollTime(i, periodMs);
+        trace->value[i] = (float)lsb / 4096.0f;
+    }
+    return trace;
+}
+
+static trace_t *lps22hhTemperature(const char *name, double periodMs)
+{
+    trace_t *trace = allocTrace(name, TRACE_SAMPLES);
+    for (int i = 0; i < trace->count; i++) {
+        double degC = 24.0 + 1.5 * sin(2.0 * M_PI * i / (double)TRACE_SAMPLES);
+        int16_t lsb = (int16_t)lround((degC * 100.0) + gaussian(1.0));
+        trace->timeMs[i] = pollTime(i, periodMs);
+        trace->value[i] = (float)lsb / 100.0f;
+    }
+    return trace;
+}
+
+static trace_t *loadCsvTrace(const char *path)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        fprintf(stderr, "ERROR: Can't open %s\n", path);
+        return NULL;
+    }
+
+    int capacity = 1024;
+    trace_t *trace = allocTrace(path, capacity);
+    trace->count = 0;
+
+    unsigned long long timeMs;
+    float value;
+    char line[128];
+
+    while (fgets(line, sizeof(line), file) != NULL) {
+
+        if (sscanf(line, "%llu,%f", &timeMs, &value) != 2) {
+            continue;
+        }
+
+        if (trace->count == capacity) {
+            capacity *= 2;
+            trace->timeMs = realloc(trace->timeMs, sizeof(uint64_t) * (size_t)capacity);
+            trace->value = realloc(trace->value, sizeof(float) * (size_t)capacity);
+        }
+        trace->timeMs[trace->count] = timeMs;
+        trace->value[trace->count] = value;
+        trace->count++;
+    }
+
+    fclose(file);
+    return trace;
+}
+
+static void freeTrace(trace_t *trace)
+{
+    free(trace->timeMs);
+    free(trace->value);
+    free(trace);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//  Measurement
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void encodeTrace(const trace_t *trace)
+{
+    tsStore_Reset();
+    for (int i = 0; i < trace->count; i++) {
+        tsStore_Append(trace->name, trace->timeMs[i], trace->value[i]);
+    }
+}
+
+static bool checkSample(uint64_t timeMs, float value, void *context)
+{
+    checkContext_t *check = (checkContext_t *)context;
+    const trace_t *trace = check->trace;
+
+    if ((check->index >= trace->count) || (timeMs != trace->timeMs[check->index]) ||
+        (memcmp(&value, &trace->value[check->index], sizeof(float)) != 0)) {
+        check->match = false;
+    }
+    check->index++;
+    return true;
+}
+
+static bool sumSample(uint64_t timeMs, float value, void *context)
+{
+    checkContext_t *check = (checkContext_t *)context;
+    check->sum += value;
+    return true;
+}
+
+static void runTrace(const trace_t *trace)
+{
+    encodeTrace(trace);
+
+    const tsChannel_t *channel = tsStore_GetChannel(trace->name);
+    if ((channel == NULL) || (channel->evictedCount != 0)) {
+        printf("%-34s trace does not fit the store\n", trace->name);
+        return;
+    }
+
+    checkContext_t check = {.trace = trace, .match = true};
+    tsStore_Iterate(trace->name, 0, UINT64_MAX, checkSample, &check);
+    bool lossless = check.match && (check.index == trace->count);
+    double bytesPerSample = (double)tsStore_ChannelBytes(channel) / (double)trace->count;
+
+    uint64_t iterations = 0;
+    uint64_t start = nowNs();
+    do {
+        encodeTrace(trace);
+        iterations++;
+    } while ((double)(nowNs() - start) < MIN_SECONDS * 1e9);
+    double encodeRate = (double)trace->count * (double)iterations / ((double)(nowNs() - start) / 1e9);
+
+    iterations = 0;
+    start = nowNs();
+    do {
+        tsStore_Iterate(trace->name, 0, UINT64_MAX, sumSample, &check);
+        iterations++;
+    } while ((double)(nowNs() - start) < MIN_SECONDS * 1e9);
+    double decodeRate = (double)trace->count * (double)iterations / ((double)(nowNs() - start) / 1e9);
+
+    printf("%-34s %8d %8u %10.2f %8.1fx %12.1f %12.1f %9s\n", trace->name, trace->count,
+           (unsigned)channel->blockCount, bytesPerSample, RAW_BYTES_PER_SAMPLE / bytesPerSample,
+           encodeRate / 1e6, decodeRate / 1e6, lossless ? "yes" : "NO");
+    fflush(stdout);
+}
+
+int main(int argc, char *argv[])
+{
+    trace_t *traces[64];
+    int traceCount = 0;
+
+    if (argc > 1) {
+        for (int i = 1; (i < argc) && (traceCount < 64); i++) {
+            trace_t *trace = loadCsvTrace(argv[i]);
+            if (trace != NULL) {
+                traces[traceCount++] = trace;
+            }
+        }
+    }
+    else {
+        traces[traceCount++] = lsm6dsoAccelIdle("lsm6dso accelZ idle 104Hz", 1000.0 / 104.0);
+        traces[traceCount++] = lsm6dsoAccelMotion("lsm6dso accelX motion 104Hz", 1000.0 / 104.0);
+        traces[traceCount++] = lsm6dsoAccelMotion("lsm6dso accelX motion 12.5Hz", 1000.0 / 12.5);
+        traces[traceCount++] = lsm6dsoGyroIdle("lsm6dso gyroX idle 104Hz", 1000.0 / 104.0);
+        traces[traceCount++] = lps22hhPressure("lps22hh pressure 10Hz", 100.0);
+        traces[traceCount++] = lps22hhTemperature("lps22hh temperature 1Hz", 1000.0);
+    }
+
+    printf("%-34s %8s %8s %10s %9s %12s %12s %9s\n", "trace", "samples", "blocks", "bytes/smp",
+           "vs raw", "enc Msmp/s", "dec Msmp/s", "lossless");
+
+    for (int i = 0; i < traceCount; i++) {
+        runTrace(traces[i]);
+        freeTrace(traces[i]);
+    }
+
+    return 0;
+}
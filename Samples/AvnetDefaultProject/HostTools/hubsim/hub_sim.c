@@ -0,0 +1,416 @@
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  hub_sim: End to end telemetry throughput and latency against an emulated IoT Hub
+//
+//  The application's cloud layer (cloud.c, azure_iot.c, device_twin.c, direct_methods.c) runs
+//  on the host against the emulated IoT Hub in ../stubs/iothub_stubs.c.  The emulator sits at the
+//  Azure IoT device client API and routes traffic by IoT Hub MQTT topic name, so no broker or
+//  network is needed.  It can add acknowledgement latency, loss, throttling and disconnects.
+//
+//  Usage: hub_sim [options]
+//
+//  --duration=s          Seconds to send telemetry, default 10
+//  --rate=n              Telemetry messages per second, 0 sends as fast as possible, default 10
+//  --poll-ms=n           Also run DoWork every n ms.  By default acknowledgements are only
+//                        collected by the application's own Azure IoT timer, as on the device
+//  --latency-ms=n        Acknowledgement latency
+//  --jitter-ms=n         Random extra latency, 0..n ms
+//  --loss=pct            Percentage of telemetry messages that are never acknowledged
+//  --timeout-ms=n        When lost messages time out, default 10000
+//  --throttle=n          Hub telemetry quota in messages per second
+//  --disconnect-every=s  Drop the connection every s seconds
+//  --disconnect-for=s    Refuse to reconnect for s seconds after a drop
+//  --twin-every=s        Send a desired property patch every s seconds
+//  --method-every=s      Invoke the "test" direct method every s seconds
+//  --seed=n              Seed for jitter and loss
+//  --json                Print the results as one line of JSON
+//
+//  Exit status is 0 if the application ran without setting an exit code.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <applibs/eventloop.h>
+
+#include "../bench/bench.h"
+#include "host_stubs.h"
+
+#include "cloud.h"
+#include "device_twin.h"
+#include "exitcodes.h"
+
+// Latency samples kept for the percentiles, reservoir sampled beyond this
+#define HUB_SIM_MAX_SAMPLES (256 * 1024)
+
+typedef struct {
+    uint32_t samplesUs[HUB_SIM_MAX_SAMPLES];
+    uint64_t seen;
+    uint64_t maxUs;
+} latencySamples_t;
+
+static latencySamples_t telemetryLatency;
+static latencySamples_t reportedLatency;
+static unsigned int reservoirState = 1;
+
+static uint64_t telemetryNotSent = 0;
+static uint64_t telemetryTopicMessages = 0;
+static uint64_t telemetryTopicBytes = 0;
+static uint64_t methodResponses = 0;
+
+extern volatile sig_atomic_t exitCode;
+extern EventLoop *eventLoop;
+
+static uint64_t nowNs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint64_t)now.tv_sec * 1000000000ULL) + (uint64_t)now.tv_nsec;
+}
+
+static void addSample(latencySamples_t *samples, uint64_t latencyNs)
+{
+    uint32_t us = (uint32_t)(latencyNs / 1000);
+
+    if (us > samples->maxUs) {
+        samples->maxUs = us;
+    }
+
+    if (samples->seen < HUB_SIM_MAX_SAMPLES) {
+        samples->samplesUs[samples->seen] = us;
+    } else {
+        uint64_t slot = (uint64_t)rand_r(&reservoirState) % (samples->seen + 1);
+        if (slot < HUB_SIM_MAX_SAMPLES) {
+            samples->samplesUs[slot] = us;
+        }
+    }
+    samples->seen++;
+}
+
+static int compareUs(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Sorts the samples and returns the percentile in ms
+static double percentileMs(latencySamples_t *samples, double percentile)
+{
+    size_t count = (samples->seen < HUB_SIM_MAX_SAMPLES) ? samples->seen : HUB_SIM_MAX_SAMPLES;
+    if (count == 0) {
+        return 0;
+    }
+
+    size_t index = (size_t)(percentile / 100.0 * (double)(count - 1) + 0.5);
+    return samples->samplesUs[index] / 1000.0;
+}
+
+static void sortSamples(latencySamples_t *samples)
+{
+    size_t count = (samples->seen < HUB_SIM_MAX_SAMPLES) ? samples->seen : HUB_SIM_MAX_SAMPLES;
+    qsort(samples->samplesUs, count, sizeof(samples->samplesUs[0]), compareUs);
+}
+
+static void AckHook(bool isReportedState, IOTHUB_CLIENT_CONFIRMATION_RESULT result,
+                    uint64_t latencyNs, void *hookContext)
+{
+    // Only successful round trips count towards latency
+    if (result == IOTHUB_CLIENT_CONFIRMATION_OK) {
+        addSample(isReportedState ? &reportedLatency : &telemetryLatency, latencyNs);
+    }
+}
+
+static void TopicHook(const char *topic, const char *payload, size_t length, void *hookContext)
+{
+    if (strncmp(topic, "devices/", 8) == 0) {
+        telemetryTopicMessages++;
+        telemetryTopicBytes += length;
+    } else if (strncmp(topic, "$iothub/methods/res/", 20) == 0) {
+        methodResponses++;
+    }
+}
+
+// Peak resident set size in kB
+static long peakRssKb(void)
+{
+    char line[128];
+    long kb = -1;
+
+    FILE *status = fopen("/proc/self/status", "r");
+    if (status == NULL) {
+        return -1;
+    }
+    while (fgets(line, sizeof(line), status) != NULL) {
+        if (sscanf(line, "VmHWM: %ld kB", &kb) == 1) {
+            break;
+        }
+    }
+    fclose(status);
+    return kb;
+}
+
+static void sendTelemetry(uint64_t sequence)
+{
+    Cloud_Result result = Cloud_SendTelemetry(false, 3*ARGS_PER_TELEMETRY_ITEM,
+                                              TYPE_INT, "sequence", (int)sequence,
+                                              TYPE_FLOAT, "temperature", 21.5,
+                                              TYPE_STRING, "status", "ok");
+    if (result != Cloud_Result_OK) {
+        telemetryNotSent++;
+    }
+}
+
+static void runEventLoop(int waitMs)
+{
+    EventLoop_Run(eventLoop, waitMs, true);
+}
+
+int main(int argc, char *argv[])
+{
+    double durationSeconds = 10;
+    double rate = 10;
+    double pollMs = 0;
+    double twinEverySeconds = 0;
+    double methodEverySeconds = 0;
+    bool jsonOutput = false;
+    hostIoTHubConfig_t config = {.messageTimeoutMs = 10000, .seed = 1};
+
+    static const struct option options[] = {
+        {"duration", required_argument, NULL, 'd'},
+        {"rate", required_argument, NULL, 'r'},
+        {"poll-ms", required_argument, NULL, 'p'},
+        {"latency-ms", required_argument, NULL, 'l'},
+        {"jitter-ms", required_argument, NULL, 'j'},
+        {"loss", required_argument, NULL, 'x'},
+        {"timeout-ms", required_argument, NULL, 'o'},
+        {"throttle", required_argument, NULL, 't'},
+        {"disconnect-every", required_argument, NULL, 'e'},
+        {"disconnect-for", required_argument, NULL, 'f'},
+        {"twin-every", required_argument, NULL, 'w'},
+        {"method-every", required_argument, NULL, 'm'},
+        {"seed", required_argument, NULL, 's'},
+        {"json", no_argument, NULL, 'J'},
+        {NULL, 0, NULL, 0}};
+
+    int option;
+    while ((option = getopt_long(argc, argv, "", options, NULL)) != -1) {
+        switch (option) {
+        case 'd':
+            durationSeconds = atof(optarg);
+            break;
+        case 'r':
+            rate = atof(optarg);
+            break;
+        case 'p':
+            pollMs = atof(optarg);
+            break;
+        case 'l':
+            config.latencyMs = (uint32_t)atoi(optarg);
+            break;
+        case 'j':
+            config.jitterMs = (uint32_t)atoi(optarg);
+            break;
+        case 'x':
+            config.lossPercent = atof(optarg);
+            break;
+        case 'o':
+            config.messageTimeoutMs = (uint32_t)atoi(optarg);
+            break;
+        case 't':
+            config.throttleMsgsPerSecond = (uint32_t)atoi(optarg);
+            break;
+        case 'e':
+            config.disconnectEveryMs = (uint32_t)(atof(optarg) * 1000);
+            break;
+        case 'f':
+            config.disconnectForMs = (uint32_t)(atof(optarg) * 1000);
+            break;
+        case 'w':
+            twinEverySeconds = atof(optarg);
+            break;
+        case 'm':
+            methodEverySeconds = atof(optarg);
+            break;
+        case 's':
+            config.seed = (unsigned int)atoi(optarg);
+            break;
+        case 'J':
+            jsonOutput = true;
+            break;
+        default:
+            fprintf(stderr, "Usage: see the comment at the top of hub_sim.c\n");
+            return 1;
+        }
+    }
+
+    hostLogOutput = false;
+    hostIoT_SetHubConfig(&config);
+    hostIoT_SetAckHook(AckHook, NULL);
+    hostIoT_SetTopicHook(TopicHook, NULL);
+
+    if (hostApp_Init() != 0) {
+        fprintf(stderr, "ERROR: hostApp_Init() failed, exitCode %d\n", (int)exitCode);
+        return 1;
+    }
+
+    const uint64_t sendPeriodNs = (rate > 0) ? (uint64_t)(1e9 / rate) : 0;
+    const uint64_t pollNs = (uint64_t)(pollMs * 1e6);
+    const uint64_t twinNs = (uint64_t)(twinEverySeconds * 1e9);
+    const uint64_t methodNs = (uint64_t)(methodEverySeconds * 1e9);
+
+    uint64_t start = nowNs();
+    uint64_t end = start + (uint64_t)(durationSeconds * 1e9);
+    uint64_t nextSend = start;
+    uint64_t nextPoll = start + pollNs;
+    uint64_t nextTwin = start + twinNs;
+    uint64_t nextMethod = start + methodNs;
+    uint64_t sequence = 0;
+    unsigned int version = 1;
+    unsigned int requestId = 1;
+    char topic[128];
+    char payload[128];
+
+    benchAlloc_ResetPeak();
+
+    uint64_t now;
+    while (((now = nowNs()) < end) && (exitCode == ExitCode_Success)) {
+        if ((sendPeriodNs == 0) || (now >= nextSend)) {
+            sendTelemetry(sequence++);
+            nextSend += sendPeriodNs;
+        }
+
+        if ((twinNs != 0) && (now >= nextTwin)) {
+            version++;
+            snprintf(topic, sizeof(topic), "$iothub/twin/PATCH/properties/desired/?$version=%u",
+                     version);
+            snprintf(payload, sizeof(payload), "{\"sensorPollPeriod\":%u,\"$version\":%u}",
+                     10 + (version % 5), version);
+            hostIoT_Publish(topic, payload);
+            nextTwin += twinNs;
+        }
+
+        if ((methodNs != 0) && (now >= nextMethod)) {
+            snprintf(topic, sizeof(topic), "$iothub/methods/POST/test/?$rid=%u", requestId++);
+            hostIoT_Publish(topic, "{\"returnVal\":200}");
+            nextMethod += methodNs;
+        }
+
+        if ((pollNs != 0) && (now >= nextPoll)) {
+            hostIoT_DoWork();
+            nextPoll += pollNs;
+        }
+
+        runEventLoop((sendPeriodNs == 0) ? 0 : 1);
+    }
+    double sendSeconds = (double)(nowNs() - start) / 1e9;
+
+    // Collect the outstanding acknowledgements
+    uint64_t drainEnd = nowNs() + ((uint64_t)config.messageTimeoutMs + config.latencyMs +
+                                   config.jitterMs + 2000) * 1000000ULL;
+    while ((hostIoT_PendingCount() > 0) && (nowNs() < drainEnd) &&
+           (exitCode == ExitCode_Success)) {
+        hostIoT_DoWork();
+        runEventLoop(1);
+    }
+    double totalSeconds = (double)(nowNs() - start) / 1e9;
+
+    const hostIoTHubStats_t *stats = hostIoT_GetHubStats();
+    sortSamples(&telemetryLatency);
+    sortSamples(&reportedLatency);
+
+    if (jsonOutput) {
+        printf("{\"durationS\":%.3f,\"rate\":%.1f,\"sent\":%llu,\"notSent\":%llu,"
+               "\"acked\":%llu,\"timedOut\":%llu,\"destroyed\":%llu,\"failed\":%llu,"
+               "\"rejected\":%llu,\"throttled\":%llu,\"ackedPerS\":%.2f,\"bytesPerMsg\":%.1f,"
+               "\"ackP50Ms\":%.3f,\"ackP90Ms\":%.3f,\"ackP99Ms\":%.3f,\"ackMaxMs\":%.3f,"
+               "\"reportedAcked\":%llu,\"reportedP50Ms\":%.3f,\"reportedP99Ms\":%.3f,"
+               "\"twinUpdates\":%llu,\"methods\":%llu,\"methodResponses\":%llu,"
+               "\"connects\":%llu,\"disconnects\":%llu,"
+               "\"heapLive\":%lld,\"heapPeak\":%lld,\"allocs\":%llu,\"peakRssKb\":%ld}\n",
+               sendSeconds, rate, (unsigned long long)sequence,
+               (unsigned long long)telemetryNotSent, (unsigned long long)stats->telemetryAcked,
+               (unsigned long long)stats->telemetryTimedOut,
+               (unsigned long long)stats->telemetryDestroyed,
+               (unsigned long long)stats->telemetryFailed,
+               (unsigned long long)stats->telemetryRejected,
+               (unsigned long long)stats->throttled, stats->telemetryAcked / totalSeconds,
+               telemetryTopicMessages ? (double)telemetryTopicBytes / telemetryTopicMessages : 0.0,
+               percentileMs(&telemetryLatency, 50), percentileMs(&telemetryLatency, 90),
+               percentileMs(&telemetryLatency, 99), telemetryLatency.maxUs / 1000.0,
+               (unsigned long long)stats->reportedAcked, percentileMs(&reportedLatency, 50),
+               percentileMs(&reportedLatency, 99), (unsigned long long)stats->twinUpdatesDelivered,
+               (unsigned long long)stats->methodsInvoked, (unsigned long long)methodResponses,
+               (unsigned long long)stats->connects, (unsigned long long)stats->disconnects,
+               (long long)benchAllocStats.liveBytes, (long long)benchAllocStats.peakBytes,
+               (unsigned long long)benchAllocStats.allocs, peakRssKb());
+    } else {
+        printf("hub_sim: %.1f s at %.1f msgs/s, latency %u+%u ms, loss %.2f%%, throttle %u msgs/s, "
+               "disconnect every %.1f s for %.1f s\n",
+               sendSeconds, rate, config.latencyMs, config.jitterMs, config.lossPercent,
+               config.throttleMsgsPerSecond, config.disconnectEveryMs / 1000.0,
+               config.disconnectForMs / 1000.0);
+        printf("telemetry    sent %llu, not sent by the app %llu, acked %llu, timed out %llu, "
+               "destroyed %llu, failed %llu, rejected %llu, throttled %llu\n",
+               (unsigned long long)sequence, (unsigned long long)telemetryNotSent,
+               (unsigned long long)stats->telemetryAcked,
+               (unsigned long long)stats->telemetryTimedOut,
+               (unsigned long long)stats->telemetryDestroyed,
+               (unsigned long long)stats->telemetryFailed,
+               (unsigned long long)stats->telemetryRejected, (unsigned long long)stats->throttled);
+        printf("throughput   %.2f msgs/s acked, %.1f bytes/msg\n",
+               stats->telemetryAcked / totalSeconds,
+               telemetryTopicMessages ? (double)telemetryTopicBytes / telemetryTopicMessages : 0.0);
+        printf("ack latency  p50 %.3f ms, p90 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+               percentileMs(&telemetryLatency, 50), percentileMs(&telemetryLatency, 90),
+               percentileMs(&telemetryLatency, 99), telemetryLatency.maxUs / 1000.0);
+        printf("reported     acked %llu, p50 %.3f ms, p99 %.3f ms\n",
+               (unsigned long long)stats->reportedAcked, percentileMs(&reportedLatency, 50),
+               percentileMs(&reportedLatency, 99));
+        printf("cloud to device  twin updates %llu, methods %llu, method responses %llu\n",
+               (unsigned long long)stats->twinUpdatesDelivered,
+               (unsigned long long)stats->methodsInvoked, (unsigned long long)methodResponses);
+        printf("connection   connects %llu, disconnects %llu\n",
+               (unsigned long long)stats->connects, (unsigned long long)stats->disconnects);
+        printf("memory       heap live %lld bytes, heap peak %lld bytes, %llu allocs, "
+               "peak RSS %ld kB\n",
+               (long long)benchAllocStats.liveBytes, (long long)benchAllocStats.peakBytes,
+               (unsigned long long)benchAllocStats.allocs, peakRssKb());
+    }
+
+    hostApp_Cleanup();
+    return (exitCode == ExitCode_Success) ? 0 : 1;
+}
@@ -0,0 +1,280 @@
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  schema_dtdl: Write the cloud model described by HighLevelExampleApp/common/schema.h
+//
+//  Usage: schema_dtdl [--iotconnect] [-o file]     Writes stdout if no file is given
+//
+//  By default the output is a DTDL v2 interface with the IOT_PLUG_AND_PLAY_MODEL_ID id, one
+//  Telemetry entry per telemetry key and one Property per device twin and reported property.
+//  --iotconnect writes the attributes and twin properties to enter in the IoTConnect device
+//  template instead.
+//
+//  The schema is compiled with the options in build_options.h, the HostTools build writes both
+//  files for the current options.  Keys that are not valid DTDL names are reported and nothing
+//  is written.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "schema.h"
+
+// DTDL name and description limits
+#define DTDL_NAME_MAX 64
+#define DTDL_DESCRIPTION_MAX 512
+
+typedef enum {
+    ENTRY_TELEMETRY,
+    ENTRY_PROPERTY,
+    ENTRY_WRITABLE_PROPERTY
+} entryKind_t;
+
+typedef struct {
+    const char *key;
+    const char *type;
+    entryKind_t kind;
+    const char *description;
+} schemaEntry_t;
+
+#define GPIO_TWIN_ENTRY(key, variable, fd, gpio, activeHigh, description) \
+    {#key, "BOOL", ENTRY_WRITABLE_PROPERTY, description},
+#define TWIN_ENTRY(key, type, variable, handler, description) \
+    {#key, #type, ENTRY_WRITABLE_PROPERTY, description},
+#define PROPERTY_ENTRY(key, type, writable, description) \
+    {#key, #type, (writable) ? ENTRY_WRITABLE_PROPERTY : ENTRY_PROPERTY, description},
+#define TELEMETRY_ENTRY(key, type, description) \
+    {#key, #type, ENTRY_TELEMETRY, description},
+static const schemaEntry_t entries[] = {
+    SCHEMA_GPIO_TWIN_LIST(GPIO_TWIN_ENTRY)
+    SCHEMA_TWIN_LIST(TWIN_ENTRY)
+    SCHEMA_PROPERTY_LIST(PROPERTY_ENTRY)
+    SCHEMA_TELEMETRY_LIST(TELEMETRY_ENTRY)
+};
+#undef GPIO_TWIN_ENTRY
+#undef TWIN_ENTRY
+#undef PROPERTY_ENTRY
+#undef TELEMETRY_ENTRY
+
+static const size_t entryCount = sizeof(entries) / sizeof(entries[0]);
+
+static bool validate(void);
+static const char *dtdlSchema(const char *type);
+static const char *iotConnectType(const char *type);
+static void printString(FILE *out, const char *text);
+static void writeDtdl(FILE *out);
+static void writeIoTConnect(FILE *out);
+
+int main(int argc, char *argv[])
+{
+    bool iotConnect = false;
+    const char *outPath = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--iotconnect") == 0) {
+            iotConnect = true;
+        } else if ((strcmp(argv[i], "-o") == 0) && (i + 1 < argc)) {
+            outPath = argv[++i];
+        } else {
+            fprintf(stderr, "Usage: %s [--iotconnect] [-o file]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (!validate()) {
+        return 1;
+    }
+
+    FILE *out = stdout;
+    if (outPath != NULL) {
+        out = fopen(outPath, "w");
+        if (out == NULL) {
+            fprintf(stderr, "ERROR: Could not open %s\n", outPath);
+            return 1;
+        }
+    }
+
+    if (iotConnect) {
+        writeIoTConnect(out);
+    } else {
+        writeDtdl(out);
+    }
+
+    if (outPath != NULL) {
+        fclose(out);
+    }
+    return 0;
+}
+
+/// <summary>
+///     Check every key is a DTDL name: a letter, then letters, digits and '_' not ending in '_'.
+///     Duplicate keys don't compile in the application (schema_keys.h) so are not checked here.
+/// </summary>
+static bool validate(void)
+{
+    bool valid = true;
+
+    for (size_t i = 0; i < entryCount; i++) {
+        const char *key = entries[i].key;
+        size_t length = strlen(key);
+        bool nameValid = (length <= DTDL_NAME_MAX) && isalpha((unsigned char)key[0]) &&
+                         (key[length - 1] != '_');
+
+        for (size_t j = 1; nameValid && (j < length); j++) {
+            nameValid = isalnum((unsigned char)key[j]) || (key[j] == '_');
+        }
+
+        if (!nameValid) {
+            fprintf(stderr, "ERROR: \"%s\" is not a valid DTDL name\n", key);
+            valid = false;
+        }
+        if (strlen(entries[i].description) > DTDL_DESCRIPTION_MAX) {
+            fprintf(stderr, "ERROR: The description of \"%s\" is over %d characters\n", key,
+                    DTDL_DESCRIPTION_MAX);
+            valid = false;
+        }
+        if (dtdlSchema(entries[i].type) == NULL) {
+            fprintf(stderr, "ERROR: \"%s\" has unknown type %s\n", key, entries[i].type);
+            valid = false;
+        }
+    }
+
+    return valid;
+}
+
+static const char *dtdlSchema(const char *type)
+{
+    if (strcmp(type, "INT") == 0) {
+        return "integer";
+    } else if (strcmp(type, "FLOAT") == 0) {
+        return "double";
+    } else if (strcmp(type, "BOOL") == 0) {
+        return "boolean";
+    } else if (strcmp(type, "STRING") == 0) {
+        return "string";
+    }
+    return NULL;
+}
+
+static const char *iotConnectType(const char *type)
+{
+    if (strcmp(type, "INT") == 0) {
+        return "INTEGER";
+    } else if (strcmp(type, "FLOAT") == 0) {
+        return "DECIMAL";
+    } else if (strcmp(type, "BOOL") == 0) {
+        return "BOOLEAN";
+    }
+    return "STRING";
+}
+
+/// <summary>
+///     Write text as a JSON string
+/// </summary>
+static void printString(FILE *out, const char *text)
+{
+    fputc('"', out);
+    for (const char *c = text; *c != '\0'; c++) {
+        if ((*c == '"') || (*c == '\\')) {
+            fputc('\\', out);
+        }
+        fputc(*c, out);
+    }
+    fputc('"', out);
+}
+
+static void writeDtdl(FILE *out)
+{
+    // build_options.h leaves the model id empty in builds without USE_PNP
+    const char *modelId = IOT_PLUG_AND_PLAY_MODEL_ID;
+    if (modelId[0] == '\0') {
+        modelId = "dtmi:avnet:defaultValidation;1";
+    }
+
+    fprintf(out, "{\n");
+    fprintf(out, "  \"@context\": \"dtmi:dtdl:context;2\",\n");
+    fprintf(out, "  \"@id\": ");
+    printString(out, modelId);
+    fprintf(out, ",\n");
+    fprintf(out, "  \"@type\": \"Interface\",\n");
+    fprintf(out, "  \"displayName\": \"Avnet Default Project\",\n");
+    fprintf(out, "  \"contents\": [\n");
+
+    for (size_t i = 0; i < entryCount; i++) {
+        const schemaEntry_t *entry = &entries[i];
+
+        fprintf(out, "    {\n");
+        fprintf(out, "      \"@type\": \"%s\",\n",
+                (entry->kind == ENTRY_TELEMETRY) ? "Telemetry" : "Property");
+        fprintf(out, "      \"name\": \"%s\",\n", entry->key);
+        fprintf(out, "      \"schema\": \"%s\",\n", dtdlSchema(entry->type));
+        if (entry->kind == ENTRY_WRITABLE_PROPERTY) {
+            fprintf(out, "      \"writable\": true,\n");
+        }
+        fprintf(out, "      \"description\": ");
+        printString(out, entry->description);
+        fprintf(out, "\n    }%s\n", (i + 1 < entryCount) ? "," : "");
+    }
+
+    fprintf(out, "  ]\n");
+    fprintf(out, "}\n");
+}
+
+static void writeIoTConnect(FILE *out)
+{
+    fprintf(out, "{\n");
+
+    // Telemetry keys are template attributes, writable properties are template twin properties.
+    // Read only properties are device twin reported properties and need no template entry.
+    const entryKind_t kinds[] = {ENTRY_TELEMETRY, ENTRY_WRITABLE_PROPERTY};
+    const char *sections[] = {"attributes", "twinProperties"};
+
+    for (size_t k = 0; k < 2; k++) {
+        bool first = true;
+
+        fprintf(out, "  \"%s\": [", sections[k]);
+        for (size_t i = 0; i < entryCount; i++) {
+            if (entries[i].kind != kinds[k]) {
+                continue;
+            }
+            fprintf(out, "%s\n    {\"localName\": \"%s\", \"dataType\": \"%s\", \"description\": ",
+                    first ? "" : ",", entries[i].key, iotConnectType(entries[i].type));
+            printString(out, entries[i].description);
+            fprintf(out, "}");
+            first = false;
+        }
+        fprintf(out, "\n  ]%s\n", (k == 0) ? "," : "");
+    }
+
+    fprintf(out, "}\n");
+}
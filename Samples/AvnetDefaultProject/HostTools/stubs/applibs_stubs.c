@@ -0,0 +1,412 @@
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Host implementations of the applibs functions the application uses
+//
+//  EventLoop is a small epoll based implementation so timerfd based EventLoopTimers work.  The
+//  peripheral functions (GPIO, I2C, UART) hand out /dev/null file descriptors so the application
+//  can write to and close them.  Networking always reports a connected interface.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+#include <applibs/applications.h>
+#include <applibs/application.h>
+#include <applibs/eventloop.h>
+#include <applibs/gpio.h>
+#include <applibs/i2c.h>
+#include <applibs/log.h>
+#include <applibs/networking.h>
+#include <applibs/powermanagement.h>
+#include <applibs/storage.h>
+#include <applibs/sysevent.h>
+#include <applibs/uart.h>
+#include <applibs/wificonfig.h>
+
+#include "host_stubs.h"
+
+// Log_Debug output control, see host_stubs.h
+bool hostLogOutput = true;
+
+// Peripheral call counters
+hostStubCounters_t hostStubCounters;
+
+static int openNullFd(void)
+{
+    return open("/dev/null", O_RDWR | O_CLOEXEC);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//  Log
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+int Log_Debug(const char *fmt, ...)
+{
+    // Always format the message so the host cost of a log call is comparable to the device
+    static char buffer[2048];
+    va_list args;
+
+    va_start(args, fmt);
+    int length = vsnprintf(buffer, sizeof(buffer), fmt, args);
+    va_end(args);
+
+    hostStubCounters.logCalls++;
+    if (hostLogOutput) {
+        fputs(buffer, stderr);
+    }
+    return length;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//  EventLoop
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct EventLoop {
+    int epollFd;
+    bool stopRequested;
+};
+
+struct EventRegistration {
+    int fd;
+    EventLoopIoCallback *callback;
+    void *context;
+};
+
+EventLoop *EventLoop_Create(void)
+{
+    EventLoop *el = calloc(1, sizeof(EventLoop));
+    if (el == NULL) {
+        return NULL;
+    }
+
+    el->epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (el->epollFd == -1) {
+        free(el);
+        return NULL;
+    }
+    return el;
+}
+
+void EventLoop_Close(EventLoop *el)
+{
+    if (el != NULL) {
+        close(el->epollFd);
+        free(el);
+    }
+}
+
+EventLoop_Run_Result EventLoop_Run(EventLoop *el, int duration_in_milliseconds,
+                                   bool process_one_event)
+{
+    struct epoll_event events[16];
+    int maxEvents = process_one_event ? 1 : 16;
+
+    el->stopRequested = false;
+    int count = epoll_wait(el->epollFd, events, maxEvents, duration_in_milliseconds);
+    if (count == -1) {
+        return EventLoop_Run_Failed;
+    }
+
+    for (int i = 0; (i < count) && !el->stopRequested; i++) {
+        EventRegistration *reg = events[i].data.ptr;
+        reg->callback(el, reg->fd, events[i].events, reg->context);
+    }
+
+    return (count == 0) ? EventLoop_Run_FinishedEmpty : EventLoop_Run_Finished;
+}
+
+int EventLoop_Stop(EventLoop *el)
+{
+    el->stopRequested = true;
+    return 0;
+}
+
+int EventLoop_GetWaitDescriptor(EventLoop *el)
+{
+    return el->epollFd;
+}
+
+EventRegistration *EventLoop_RegisterIo(EventLoop *el, int fd, EventLoop_IoEvents eventBitmask,
+                                        EventLoopIoCallback *callback, void *context)
+{
+    EventRegistration *reg = calloc(1, sizeof(EventRegistration));
+    if (reg == NULL) {
+        return NULL;
+    }
+
+    reg->fd = fd;
+    reg->callback = callback;
+    reg->context = context;
+
+    struct epoll_event event = {.events = eventBitmask, .data.ptr = reg};
+    if (epoll_ctl(el->epollFd, EPOLL_CTL_ADD, fd, &event) == -1) {
+        free(reg);
+        return NULL;
+    }
+    return reg;
+}
+
+int EventLoop_ModifyIoEvents(EventLoop *el, EventRegistration *reg, EventLoop_IoEvents eventBitmask)
+{
+    struct epoll_event event = {.events = eventBitmask, .data.ptr = reg};
+    return epoll_ctl(el->epollFd, EPOLL_CTL_MOD, reg->fd, &event);
+}
+
+int EventLoop_UnregisterIo(EventLoop *el, EventRegistration *reg)
+{
+    if (reg == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    int result = epoll_ctl(el->epollFd, EPOLL_CTL_DEL, reg->fd, NULL);
+    free(reg);
+    return result;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//  GPIO, I2C, UART
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+int GPIO_OpenAsOutput(GPIO_Id gpioId, GPIO_OutputMode_Type outputMode, GPIO_Value_Type initialValue)
+{
+    return openNullFd();
+}
+
+int GPIO_OpenAsInput(GPIO_Id gpioId)
+{
+    return openNullFd();
+}
+
+int GPIO_SetValue(int gpioFd, GPIO_Value_Type value)
+{
+    hostStubCounters.gpioWrites++;
+    return 0;
+}
+
+int GPIO_GetValue(int gpioFd, GPIO_Value_Type *outValue)
+{
+    // Buttons are active low, report them as released
+    *outValue = GPIO_Value_High;
+    return 0;
+}
+
+int I2CMaster_Open(I2C_InterfaceId id)
+{
+    return openNullFd();
+}
+
+int I2CMaster_SetBusSpeed(int fd, uint32_t speed)
+{
+    return 0;
+}
+
+int I2CMaster_SetTimeout(int fd, uint32_t timeout)
+{
+    return 0;
+}
+
+int I2CMaster_SetDefaultTargetAddress(int fd, I2C_DeviceAddress address)
+{
+    return 0;
+}
+
+ssize_t I2CMaster_Write(int fd, I2C_DeviceAddress address, const uint8_t *data, size_t length)
+{
+    hostStubCounters.i2cWrites++;
+    hostStubCounters.i2cBytesWritten += length;
+    return (ssize_t)length;
+}
+
+ssize_t I2CMaster_WriteThenRead(int fd, I2C_DeviceAddress address, const uint8_t *writeData,
+                                size_t lenWriteData, uint8_t *readData, size_t lenReadData)
+{
+    hostStubCounters.i2cWrites++;
+    hostStubCounters.i2cBytesWritten += lenWriteData;
+    memset(readData, 0, lenReadData);
+    return (ssize_t)(lenWriteData + lenReadData);
+}
+
+ssize_t I2CMaster_Read(int fd, I2C_DeviceAddress address, uint8_t *buffer, size_t maxLength)
+{
+    memset(buffer, 0, maxLength);
+    return (ssize_t)maxLength;
+}
+
+void UART_InitConfig(UART_Config *uartConfig)
+{
+    memset(uartConfig, 0, sizeof(UART_Config));
+}
+
+int UART_Open(UART_Id uartId, const UART_Config *uartConfig)
+{
+    return openNullFd();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//  Networking, WifiConfig
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+int Networking_IsNetworkingReady(bool *outIsNetworkingReady)
+{
+    *outIsNetworkingReady = true;
+    return 0;
+}
+
+int Networking_GetInterfaceConnectionStatus(const char *networkInterfaceName,
+                                            Networking_InterfaceConnectionStatus *outStatus)
+{
+    *outStatus = Networking_InterfaceConnectionStatus_ConnectedToInternet;
+    return 0;
+}
+
+int WifiConfig_GetCurrentNetwork(WifiConfig_ConnectedNetwork *connectedNetwork)
+{
+    static const char ssid[] = "HostNetwork";
+
+    memset(connectedNetwork, 0, sizeof(WifiConfig_ConnectedNetwork));
+    memcpy(connectedNetwork->ssid, ssid, sizeof(ssid) - 1);
+    connectedNetwork->ssidLength = sizeof(ssid) - 1;
+    connectedNetwork->frequencyMHz = 2412;
+    connectedNetwork->signalRssi = -50;
+    return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//  Application, Applications, Storage, PowerManagement, SysEvent
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+int Application_IsDeviceAuthReady(bool *outIsReady)
+{
+    *outIsReady = true;
+    return 0;
+}
+
+int Application_Connect(const char *componentId)
+{
+    errno = ENOENT;
+    return -1;
+}
+
+static size_t readProcStatusKB(const char *field)
+{
+    char line[128];
+    size_t value = 0;
+    size_t fieldLength = strlen(field);
+
+    FILE *status = fopen("/proc/self/status", "r");
+    if (status == NULL) {
+        return 0;
+    }
+
+    while (fgets(line, sizeof(line), status) != NULL) {
+        if (strncmp(line, field, fieldLength) == 0) {
+            value = strtoul(&line[fieldLength], NULL, 10);
+            break;
+        }
+    }
+
+    fclose(status);
+    return value;
+}
+
+size_t Applications_GetTotalMemoryUsageInKB(void)
+{
+    return readProcStatusKB("VmRSS:");
+}
+
+size_t Applications_GetUserModeMemoryUsageInKB(void)
+{
+    return readProcStatusKB("VmRSS:");
+}
+
+size_t Applications_GetPeakUserModeMemoryUsageInKB(void)
+{
+    return readProcStatusKB("VmHWM:");
+}
+
+int Storage_OpenMutableFile(void)
+{
+    // HLA_MUTABLE_STORAGE selects the backing file, the default is in the working directory
+    const char *path = getenv("HLA_MUTABLE_STORAGE");
+    return open((path != NULL) ? path : "hla_mutable_storage.bin", O_RDWR | O_CREAT | O_CLOEXEC,
+                0644);
+}
+
+int Storage_DeleteMutableFile(void)
+{
+    const char *path = getenv("HLA_MUTABLE_STORAGE");
+    return unlink((path != NULL) ? path : "hla_mutable_storage.bin");
+}
+
+int PowerManagement_ForceSystemReboot(void)
+{
+    Log_Debug("HOST: PowerManagement_ForceSystemReboot() ignored\n");
+    return 0;
+}
+
+EventRegistration *SysEvent_RegisterForEventNotifications(EventLoop *el,
+                                                          SysEvent_Events eventBitmask,
+                                                          SysEvent_EventsCallback callback,
+                                                          void *context)
+{
+    // There are no OS update events on the host, hand back a registration that never fires
+    return calloc(1, sizeof(EventRegistration));
+}
+
+int SysEvent_UnregisterForEventNotifications(EventRegistration *reg)
+{
+    free(reg);
+    return 0;
+}
+
+int SysEvent_Info_GetUpdateData(const SysEvent_Info *info, SysEvent_Info_UpdateData *update_info)
+{
+    errno = EINVAL;
+    return -1;
+}
+
+int SysEvent_DeferEvent(SysEvent_Events event, unsigned int requested_defer_time_in_minutes)
+{
+    return 0;
+}
+
+int SysEvent_ResumeEvent(SysEvent_Events event)
+{
+    return 0;
+}
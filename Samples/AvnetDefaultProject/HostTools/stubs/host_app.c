@@ -0,0 +1,155 @@
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Host replacement for the parts of main.c the shared modules depend on
+//
+//  main.c is not part of the host build, it owns the event loop and the main loop.  This file
+//  defines the globals the other modules reference and a hostApp_Init() that performs the same
+//  initialization as InitPeripheralsAndHandlers(), then connects to the stub IoT Hub.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <signal.h>
+#include <stdio.h>
+
+#include <applibs/eventloop.h>
+#include <applibs/log.h>
+
+#include "eventloop_timer_utilities.h"
+#include "exitcodes.h"
+#include "cloud.h"
+#include "connection.h"
+#include "connection_iot_hub.h"
+#include "device_twin.h"
+#include "direct_methods.h"
+#include "oled.h"
+#include "sensor_registry.h"
+#include "live_mode.h"
+
+#include "host_stubs.h"
+
+// Globals defined in main.c on the device
+volatile sig_atomic_t exitCode = ExitCode_Success;
+EventLoop *eventLoop = NULL;
+EventLoopTimer *telemetryTimer = NULL;
+EventLoopTimer *sensorPollTimer = NULL;
+int readSensorPeriod = SENSOR_READ_PERIOD_SECONDS;
+network_var network_data;
+
+static Connection_IotHub_Config hostConnectionConfig = {.hubHostname = "host.azure-devices.net"};
+
+static void HostExitCodeCallbackHandler(ExitCode ec)
+{
+    exitCode = ec;
+}
+
+#ifndef ENABLE_SENSOR_REGISTRY
+static void HostSensorTimerEventHandler(EventLoopTimer *timer)
+{
+    ConsumeEventLoopTimerEvent(timer);
+}
+#endif // !ENABLE_SENSOR_REGISTRY
+
+#ifdef ENABLE_SENSOR_REGISTRY
+// main.c reads the wifi configuration, the host has no network to report
+bool readWifiSensor(void *thisSensor)
+{
+    return false;
+}
+#endif // ENABLE_SENSOR_REGISTRY
+
+/// <summary>
+///     Initialize the shared modules the way InitPeripheralsAndHandlers() does and connect to
+///     the stub IoT Hub
+/// </summary>
+int hostApp_Init(void)
+{
+    eventLoop = EventLoop_Create();
+    if (eventLoop == NULL) {
+        Log_Debug("Could not create event loop.\n");
+        return ExitCode_Init_EventLoop;
+    }
+
+    deviceTwinOpenFDs();
+
+    ExitCode result = InitDirectMethods();
+    if (result != ExitCode_Success) {
+        return result;
+    }
+
+#ifdef ENABLE_SENSOR_REGISTRY
+    result = sensorRegistry_Init(eventLoop);
+    if (result != ExitCode_Success) {
+        return result;
+    }
+#ifdef ENABLE_LIVE_MODE
+    result = liveMode_Init(eventLoop);
+    if (result != ExitCode_Success) {
+        return result;
+    }
+#endif // ENABLE_LIVE_MODE
+#else
+    static const struct timespec readSensorPeriod = {.tv_sec = SENSOR_READ_PERIOD_SECONDS,
+                                                     .tv_nsec = SENSOR_READ_PERIOD_NANO_SECONDS};
+    sensorPollTimer = CreateEventLoopPeriodicTimer(eventLoop, &HostSensorTimerEventHandler,
+                                                   &readSensorPeriod);
+    if (sensorPollTimer == NULL) {
+        return ExitCode_Init_sensorPollTimer;
+    }
+#endif // ENABLE_SENSOR_REGISTRY
+
+    result = Cloud_Initialize(eventLoop, &hostConnectionConfig, HostExitCodeCallbackHandler, NULL,
+                              NULL);
+    if (result != ExitCode_Success) {
+        return result;
+    }
+
+    // The device connects from the Azure IoT timer, connect now and deliver the authenticated
+    // status so the application can send immediately
+    Connection_Start();
+    hostIoT_DoWork();
+
+    return (exitCode == ExitCode_Success) ? 0 : exitCode;
+}
+
+void hostApp_Cleanup(void)
+{
+    DisposeEventLoopTimer(sensorPollTimer);
+#ifdef ENABLE_LIVE_MODE
+    liveMode_Cleanup();
+#endif // ENABLE_LIVE_MODE
+#ifdef ENABLE_SENSOR_REGISTRY
+    sensorRegistry_Cleanup();
+#endif // ENABLE_SENSOR_REGISTRY
+    Cloud_Cleanup();
+    Connection_Cleanup();
+    EventLoop_Close(eventLoop);
+    eventLoop = NULL;
+}
@@ -0,0 +1,187 @@
+#ifndef HOST_STUBS_H
+#define HOST_STUBS_H
+
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+// Control and inspection API for the host stubs.  Only host side code (benchmarks, test
+// harnesses) includes this file.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <iothub_device_client_ll.h>
+
+// Set false to drop Log_Debug() output.  Messages are still formatted.
+extern bool hostLogOutput;
+
+typedef struct {
+    uint64_t logCalls;
+    uint64_t gpioWrites;
+    uint64_t i2cWrites;
+    uint64_t i2cBytesWritten;
+    uint64_t telemetrySent;
+    uint64_t reportedStatesSent;
+} hostStubCounters_t;
+
+extern hostStubCounters_t hostStubCounters;
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//  Azure IoT device client stub
+//
+//  Sends are queued and complete on the next IoTHubDeviceClient_LL_DoWork() call, the same as
+//  the SDK.  The hooks see each message while the application's buffer is still valid.
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+typedef void (*hostIoTMessageHook)(const char *message, size_t length, void *hookContext);
+
+// Observe outgoing telemetry and reported properties, pass NULL to remove
+void hostIoT_SetTelemetryHook(hostIoTMessageHook hook, void *hookContext);
+void hostIoT_SetReportedStateHook(hostIoTMessageHook hook, void *hookContext);
+
+// Result returned to the application's send confirmation callback, default CONFIRMATION_OK
+void hostIoT_SetSendResult(IOTHUB_CLIENT_CONFIRMATION_RESULT result);
+
+// Fail IoTHubDeviceClient_LL_SendEventAsync() calls while true
+void hostIoT_SetSendRejected(bool rejected);
+
+// Queue a connection status change, delivered by the next DoWork
+void hostIoT_SetAuthenticated(bool authenticated, IOTHUB_CLIENT_CONNECTION_STATUS_REASON reason);
+
+// Deliver cloud to device traffic to the application's registered callbacks
+void hostIoT_DeliverTwin(DEVICE_TWIN_UPDATE_STATE state, const char *json);
+int hostIoT_InvokeMethod(const char *methodName, const char *payload, char **response,
+                         size_t *responseSize);
+void hostIoT_DeliverMessage(const char *message);
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//  Emulated IoT Hub
+//
+//  Device to cloud traffic is reported to the topic hook under the IoT Hub MQTT topic names:
+//      devices/{deviceId}/messages/events/
+//      $iothub/twin/PATCH/properties/reported/?$rid={n}
+//      $iothub/methods/res/{status}/?$rid={n}
+//  hostIoT_Publish() accepts the cloud to device topics:
+//      $iothub/twin/PATCH/properties/desired/?$version={n}
+//      $iothub/twin/res/200/?$rid={n}
+//      $iothub/methods/POST/{method name}/?$rid={n}
+//      devices/{deviceId}/messages/devicebound/
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+typedef struct {
+    uint32_t latencyMs;             // Added to every acknowledgement
+    uint32_t jitterMs;              // Uniform random 0..jitterMs added on top
+    double lossPercent;             // Telemetry sends that are never acknowledged
+    uint32_t messageTimeoutMs;      // When lost sends are confirmed with MESSAGE_TIMEOUT
+    uint32_t throttleMsgsPerSecond; // Telemetry quota, sends over quota wait.  0 for no limit
+    uint32_t disconnectEveryMs;     // Drop the connection this often.  0 to stay connected
+    uint32_t disconnectForMs;       // How long the hub refuses to reconnect after a drop
+    unsigned int seed;              // Seed for jitter and loss
+} hostIoTHubConfig_t;
+
+typedef struct {
+    uint64_t telemetryAcked;
+    uint64_t telemetryTimedOut;
+    uint64_t telemetryDestroyed;
+    uint64_t telemetryFailed;
+    uint64_t telemetryRejected;
+    uint64_t reportedAcked;
+    uint64_t throttled;
+    uint64_t twinUpdatesDelivered;
+    uint64_t methodsInvoked;
+    uint64_t connects;
+    uint64_t disconnects;
+} hostIoTHubStats_t;
+
+typedef void (*hostIoTTopicHook)(const char *topic, const char *payload, size_t length,
+                                 void *hookContext);
+
+// Called as each send is confirmed, latencyNs is from the send call to the confirmation
+typedef void (*hostIoTAckHook)(bool isReportedState, IOTHUB_CLIENT_CONFIRMATION_RESULT result,
+                               uint64_t latencyNs, void *hookContext);
+
+void hostIoT_SetTopicHook(hostIoTTopicHook hook, void *hookContext);
+void hostIoT_SetAckHook(hostIoTAckHook hook, void *hookContext);
+void hostIoT_SetHubConfig(const hostIoTHubConfig_t *config);
+const hostIoTHubStats_t *hostIoT_GetHubStats(void);
+
+// Publish cloud to device traffic on an IoT Hub topic.  Returns -1 for an unknown topic or if
+// the device is not connected.
+int hostIoT_Publish(const char *topic, const char *payload);
+
+// Returns the active client handle, NULL before the application connects
+IOTHUB_DEVICE_CLIENT_LL_HANDLE hostIoT_GetClient(void);
+
+// Run DoWork on the active client
+void hostIoT_DoWork(void);
+
+// Number of sends waiting for DoWork
+size_t hostIoT_PendingCount(void);
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//  Emulated IoT Hub file upload
+//
+//  IoTHubDeviceClient_LL_UploadMultipleBlocksToBlob() blocks until the blob is committed or has
+//  failed.  It asks the application for one block at a time and sends each block to the storage
+//  endpoint as an Azure Storage Put Block request:
+//      PUT /{container}/{deviceId}/{blob name}?comp=block&blockid={n}
+//  When the application ends the blob the blocks are committed with a Put Block List request
+//  (?comp=blocklist) and the application is told the result.  The requests use one keep alive
+//  HTTP/1.1 connection.  Without an endpoint the blocks are only counted.
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+typedef struct {
+    const char *host;               // IPv4 address of the storage endpoint, NULL for no endpoint
+    uint16_t port;
+    uint32_t failAfterBlocks;       // Fail uploads after this many blocks, 0 to never fail
+    uint32_t failUploads;           // How many uploads failAfterBlocks applies to
+} hostIoTBlobConfig_t;
+
+typedef struct {
+    uint64_t uploadsStarted;
+    uint64_t uploadsCompleted;
+    uint64_t uploadsFailed;
+    uint64_t blocks;
+    uint64_t bytes;
+    uint64_t httpRequests;
+    uint64_t httpErrors;
+} hostIoTBlobStats_t;
+
+void hostIoT_SetBlobConfig(const hostIoTBlobConfig_t *config);
+const hostIoTBlobStats_t *hostIoT_GetBlobStats(void);
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//  Application setup (host_app.c)
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Creates the event loop and timers main.c would, initializes the cloud modules and connects
+// to the stub IoT Hub.  Returns 0 on success.
+int hostApp_Init(void);
+void hostApp_Cleanup(void);
+
+#endif // HOST_STUBS_H
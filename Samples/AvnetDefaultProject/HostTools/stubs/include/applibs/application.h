@@ -0,0 +1,6 @@
+// Host build stub for <applibs/application.h>, declares only what the application uses
+#pragma once
+#include <stdbool.h>
+#include <sys/socket.h>
+int Application_IsDeviceAuthReady(bool *outIsReady);
+int Application_Connect(const char *componentId);
@@ -0,0 +1,6 @@
+// Host build stub for <applibs/applications.h>, declares only what the application uses
+#pragma once
+#include <stddef.h>
+size_t Applications_GetTotalMemoryUsageInKB(void);
+size_t Applications_GetUserModeMemoryUsageInKB(void);
+size_t Applications_GetPeakUserModeMemoryUsageInKB(void);
@@ -0,0 +1,19 @@
+// Host build stub for <applibs/eventloop.h>, declares only what the application uses
+#pragma once
+#include <stdint.h>
+typedef struct EventLoop EventLoop;
+typedef struct EventRegistration EventRegistration;
+typedef uint32_t EventLoop_IoEvents;
+#define EventLoop_Input 0x01
+#define EventLoop_Output 0x04
+#define EventLoop_Error 0x08
+typedef void EventLoopIoCallback(EventLoop *el, int fd, EventLoop_IoEvents events, void *context);
+typedef enum { EventLoop_Run_Failed=-1, EventLoop_Run_FinishedEmpty=0, EventLoop_Run_Finished=1 } EventLoop_Run_Result;
+EventLoop *EventLoop_Create(void);
+void EventLoop_Close(EventLoop *el);
+EventLoop_Run_Result EventLoop_Run(EventLoop *el, int duration_in_milliseconds, _Bool process_one_event);
+int EventLoop_Stop(EventLoop *el);
+int EventLoop_GetWaitDescriptor(EventLoop *el);
+EventRegistration *EventLoop_RegisterIo(EventLoop *el, int fd, EventLoop_IoEvents eventBitmask, EventLoopIoCallback *callback, void *context);
+int EventLoop_ModifyIoEvents(EventLoop *el, EventRegistration *reg, EventLoop_IoEvents eventBitmask);
+int EventLoop_UnregisterIo(EventLoop *el, EventRegistration *reg);
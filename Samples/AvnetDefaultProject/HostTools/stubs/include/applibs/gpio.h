@@ -0,0 +1,10 @@
+// Host build stub for <applibs/gpio.h>, declares only what the application uses
+#pragma once
+typedef int GPIO_Id; typedef unsigned char GPIO_Value_Type; typedef unsigned char GPIO_Value;
+typedef enum {GPIO_OutputMode_PushPull=0, GPIO_OutputMode_OpenDrain, GPIO_OutputMode_OpenSource} GPIO_OutputMode_Type;
+#define GPIO_Value_Low 0
+#define GPIO_Value_High 1
+int GPIO_OpenAsOutput(GPIO_Id gpioId, GPIO_OutputMode_Type outputMode, GPIO_Value_Type initialValue);
+int GPIO_OpenAsInput(GPIO_Id gpioId);
+int GPIO_SetValue(int gpioFd, GPIO_Value_Type value);
+int GPIO_GetValue(int gpioFd, GPIO_Value_Type *outValue);
@@ -0,0 +1,3 @@
+// Host build stub for <applibs/log.h>, declares only what the application uses
+#pragma once
+int Log_Debug(const char *fmt, ...) __attribute__((format(printf,1,2)));
@@ -0,0 +1,8 @@
+// Host build stub for <applibs/networking.h>, declares only what the application uses
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+typedef uint32_t Networking_InterfaceConnectionStatus;
+#define Networking_InterfaceConnectionStatus_ConnectedToInternet 8
+int Networking_IsNetworkingReady(bool *outIsNetworkingReady);
+int Networking_GetInterfaceConnectionStatus(const char *networkInterfaceName, Networking_InterfaceConnectionStatus *outStatus);
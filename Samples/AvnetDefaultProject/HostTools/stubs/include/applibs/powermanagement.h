@@ -0,0 +1,3 @@
+// Host build stub for <applibs/powermanagement.h>, declares only what the application uses
+#pragma once
+int PowerManagement_ForceSystemReboot(void);
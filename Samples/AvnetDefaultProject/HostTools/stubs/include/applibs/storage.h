@@ -0,0 +1,6 @@
+// Host build stub for <applibs/storage.h>, declares only what the application uses
+#pragma once
+int Storage_OpenMutableFile(void);
+int Storage_DeleteMutableFile(void);
+int Storage_OpenFileInImagePackage(const char *relativePath);
+char *Storage_GetAbsolutePathInImagePackage(const char *relativePath);
@@ -0,0 +1,14 @@
+// Host build stub for <applibs/sysevent.h>, declares only what the application uses
+#pragma once
+#include <applibs/eventloop.h>
+typedef enum { SysEvent_Events_None=0, SysEvent_Events_UpdateReadyForInstall=2, SysEvent_Events_UpdateStarted=4 } SysEvent_Events;
+typedef enum { SysEvent_Status_Invalid=0, SysEvent_Status_Pending=1, SysEvent_Status_Final=2, SysEvent_Status_Deferred=3, SysEvent_Status_Complete=4 } SysEvent_Status;
+typedef enum { SysEvent_UpdateType_Invalid=0, SysEvent_UpdateType_App=1, SysEvent_UpdateType_System=2 } SysEvent_UpdateType;
+typedef struct SysEvent_Info SysEvent_Info;
+typedef struct { unsigned int max_deferral_time_in_minutes; SysEvent_UpdateType update_type; } SysEvent_Info_UpdateData;
+typedef void SysEvent_EventsCallback(SysEvent_Events event, SysEvent_Status state, const SysEvent_Info *info, void *context);
+EventRegistration *SysEvent_RegisterForEventNotifications(EventLoop *el, SysEvent_Events eventBitmask, SysEvent_EventsCallback callback, void *context);
+int SysEvent_UnregisterForEventNotifications(EventRegistration *reg);
+int SysEvent_Info_GetUpdateData(const SysEvent_Info *info, SysEvent_Info_UpdateData *update_info);
+int SysEvent_DeferEvent(SysEvent_Events event, unsigned int requested_defer_time_in_minutes);
+int SysEvent_ResumeEvent(SysEvent_Events event);
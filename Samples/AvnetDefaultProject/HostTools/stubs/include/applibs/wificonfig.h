@@ -0,0 +1,7 @@
+// Host build stub for <applibs/wificonfig.h>, declares only what the application uses
+#pragma once
+#include <stdint.h>
+#define WIFICONFIG_SSID_MAX_LENGTH 32
+#define WIFICONFIG_BSSID_BUFFER_SIZE 6
+typedef struct { uint32_t z__magicAndVersion; uint8_t ssid[WIFICONFIG_SSID_MAX_LENGTH]; uint8_t bssid[6]; uint8_t ssidLength; uint8_t security; int8_t signalRssi; uint32_t frequencyMHz; } WifiConfig_ConnectedNetwork;
+int WifiConfig_GetCurrentNetwork(WifiConfig_ConnectedNetwork *connectedNetwork);
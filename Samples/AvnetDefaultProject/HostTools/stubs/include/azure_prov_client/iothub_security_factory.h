@@ -0,0 +1,5 @@
+// Host build stub for <azure_prov_client/iothub_security_factory.h>
+#pragma once
+typedef enum { IOTHUB_SECURITY_TYPE_X509 } IOTHUB_SECURITY_TYPE;
+int iothub_security_init(IOTHUB_SECURITY_TYPE t);
+void iothub_security_deinit(void);
@@ -0,0 +1,5 @@
+// Host build stub for <azure_prov_client/prov_security_factory.h>
+#pragma once
+typedef enum { SECURE_DEVICE_TYPE_X509 } SECURE_DEVICE_TYPE;
+int prov_dev_security_init(SECURE_DEVICE_TYPE t);
+void prov_dev_security_deinit(void);
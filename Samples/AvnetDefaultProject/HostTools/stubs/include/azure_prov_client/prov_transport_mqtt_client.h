@@ -0,0 +1,3 @@
+// Host build stub for <azure_prov_client/prov_transport_mqtt_client.h>
+#pragma once
+const void *Prov_Device_MQTT_Protocol(void);
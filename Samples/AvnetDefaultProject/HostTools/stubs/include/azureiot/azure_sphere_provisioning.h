@@ -0,0 +1,6 @@
+// Host build stub for the Azure IoT C SDK <azure_sphere_provisioning.h>
+#pragma once
+#include "iothub_device_client_ll.h"
+typedef enum { AZURE_SPHERE_PROV_RESULT_OK, AZURE_SPHERE_PROV_RESULT_INVALID_PARAM, AZURE_SPHERE_PROV_RESULT_NETWORK_NOT_READY, AZURE_SPHERE_PROV_RESULT_DEVICEAUTH_NOT_READY, AZURE_SPHERE_PROV_RESULT_PROV_DEVICE_ERROR, AZURE_SPHERE_PROV_RESULT_GENERIC_ERROR } AZURE_SPHERE_PROV_RESULT;
+typedef struct { AZURE_SPHERE_PROV_RESULT result; int prov_device_error; } AZURE_SPHERE_PROV_RETURN_VALUE;
+AZURE_SPHERE_PROV_RETURN_VALUE IoTHubDeviceClient_LL_CreateWithAzureSphereDeviceAuthProvisioning(const char *idScope, unsigned int timeout, IOTHUB_DEVICE_CLIENT_LL_HANDLE *handle);
@@ -0,0 +1,2 @@
+// Host build stub for the Azure IoT C SDK <iothub_client_core_common.h>
+#pragma once
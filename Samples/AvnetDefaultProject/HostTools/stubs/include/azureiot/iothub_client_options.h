@@ -0,0 +1,3 @@
+// Host build stub for the Azure IoT C SDK <iothub_client_options.h>
+#pragma once
+#include "iothub_device_client_ll.h"
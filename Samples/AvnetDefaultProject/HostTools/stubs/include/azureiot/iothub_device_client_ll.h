@@ -0,0 +1,59 @@
+// Host build stub for the Azure IoT C SDK <iothub_device_client_ll.h>
+#pragma once
+#include <stddef.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include "iothub_client_core_common.h"
+typedef struct IOTHUB_DEVICE_CLIENT_LL_TAG *IOTHUB_DEVICE_CLIENT_LL_HANDLE;
+typedef struct IOTHUB_MESSAGE_HANDLE_DATA_TAG *IOTHUB_MESSAGE_HANDLE;
+typedef const void *(*IOTHUB_CLIENT_TRANSPORT_PROVIDER)(void);
+typedef enum { IOTHUB_CLIENT_OK, IOTHUB_CLIENT_INVALID_ARG, IOTHUB_CLIENT_ERROR, IOTHUB_CLIENT_INVALID_SIZE, IOTHUB_CLIENT_INDEFINITE_TIME } IOTHUB_CLIENT_RESULT;
+typedef enum { IOTHUB_CLIENT_CONFIRMATION_OK, IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY, IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT, IOTHUB_CLIENT_CONFIRMATION_ERROR } IOTHUB_CLIENT_CONFIRMATION_RESULT;
+typedef enum { IOTHUB_CLIENT_CONNECTION_AUTHENTICATED, IOTHUB_CLIENT_CONNECTION_UNAUTHENTICATED } IOTHUB_CLIENT_CONNECTION_STATUS;
+typedef enum { IOTHUB_CLIENT_CONNECTION_EXPIRED_SAS_TOKEN, IOTHUB_CLIENT_CONNECTION_DEVICE_DISABLED, IOTHUB_CLIENT_CONNECTION_BAD_CREDENTIAL, IOTHUB_CLIENT_CONNECTION_RETRY_EXPIRED, IOTHUB_CLIENT_CONNECTION_NO_NETWORK, IOTHUB_CLIENT_CONNECTION_COMMUNICATION_ERROR, IOTHUB_CLIENT_CONNECTION_OK, IOTHUB_CLIENT_CONNECTION_NO_PING_RESPONSE } IOTHUB_CLIENT_CONNECTION_STATUS_REASON;
+typedef enum { DEVICE_TWIN_UPDATE_COMPLETE, DEVICE_TWIN_UPDATE_PARTIAL } DEVICE_TWIN_UPDATE_STATE;
+typedef enum { IOTHUBMESSAGE_ACCEPTED, IOTHUBMESSAGE_REJECTED, IOTHUBMESSAGE_ABANDONED } IOTHUBMESSAGE_DISPOSITION_RESULT;
+typedef enum { IOTHUB_MESSAGE_OK, IOTHUB_MESSAGE_INVALID_ARG, IOTHUB_MESSAGE_INVALID_TYPE, IOTHUB_MESSAGE_ERROR } IOTHUB_MESSAGE_RESULT;
+typedef enum { IOTHUB_CLIENT_FILE_UPLOAD_OK, IOTHUB_CLIENT_FILE_UPLOAD_ERROR } IOTHUB_CLIENT_FILE_UPLOAD_RESULT;
+typedef enum { IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_OK, IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_ABORT } IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_RESULT;
+typedef IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_RESULT (*IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK_EX)(IOTHUB_CLIENT_FILE_UPLOAD_RESULT result, unsigned char const **data, size_t *size, void *context);
+typedef void (*IOTHUB_CLIENT_FILE_UPLOAD_CALLBACK)(IOTHUB_CLIENT_FILE_UPLOAD_RESULT result, void *userContextCallback);
+typedef void (*IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK)(IOTHUB_CLIENT_CONFIRMATION_RESULT result, void *userContextCallback);
+typedef void (*IOTHUB_CLIENT_CONNECTION_STATUS_CALLBACK)(IOTHUB_CLIENT_CONNECTION_STATUS result, IOTHUB_CLIENT_CONNECTION_STATUS_REASON reason, void *userContextCallback);
+typedef void (*IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK)(DEVICE_TWIN_UPDATE_STATE update_state, const unsigned char *payLoad, size_t size, void *userContextCallback);
+typedef void (*IOTHUB_CLIENT_REPORTED_STATE_CALLBACK)(int status_code, void *userContextCallback);
+typedef int (*IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC)(const char *method_name, const unsigned char *payload, size_t size, unsigned char **response, size_t *response_size, void *userContextCallback);
+typedef IOTHUBMESSAGE_DISPOSITION_RESULT (*IOTHUB_CLIENT_MESSAGE_CALLBACK_ASYNC)(IOTHUB_MESSAGE_HANDLE message, void *userContextCallback);
+const void *MQTT_Protocol(void);
+IOTHUB_DEVICE_CLIENT_LL_HANDLE IoTHubDeviceClient_LL_CreateWithAzureSphereFromDeviceAuth(const char *iotHubUri, IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol);
+void IoTHubDeviceClient_LL_Destroy(IOTHUB_DEVICE_CLIENT_LL_HANDLE h);
+IOTHUB_CLIENT_RESULT IoTHubDeviceClient_LL_SendEventAsync(IOTHUB_DEVICE_CLIENT_LL_HANDLE h, IOTHUB_MESSAGE_HANDLE m, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK cb, void *ctx);
+IOTHUB_CLIENT_RESULT IoTHubDeviceClient_LL_SetOption(IOTHUB_DEVICE_CLIENT_LL_HANDLE h, const char *optionName, const void *value);
+IOTHUB_CLIENT_RESULT IoTHubDeviceClient_LL_SetDeviceTwinCallback(IOTHUB_DEVICE_CLIENT_LL_HANDLE h, IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK cb, void *ctx);
+IOTHUB_CLIENT_RESULT IoTHubDeviceClient_LL_SetDeviceMethodCallback(IOTHUB_DEVICE_CLIENT_LL_HANDLE h, IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC cb, void *ctx);
+IOTHUB_CLIENT_RESULT IoTHubDeviceClient_LL_SetConnectionStatusCallback(IOTHUB_DEVICE_CLIENT_LL_HANDLE h, IOTHUB_CLIENT_CONNECTION_STATUS_CALLBACK cb, void *ctx);
+IOTHUB_CLIENT_RESULT IoTHubDeviceClient_LL_SetMessageCallback(IOTHUB_DEVICE_CLIENT_LL_HANDLE h, IOTHUB_CLIENT_MESSAGE_CALLBACK_ASYNC cb, void *ctx);
+IOTHUB_CLIENT_RESULT IoTHubDeviceClient_LL_SendReportedState(IOTHUB_DEVICE_CLIENT_LL_HANDLE h, const unsigned char *reportedState, size_t size, IOTHUB_CLIENT_REPORTED_STATE_CALLBACK cb, void *ctx);
+IOTHUB_CLIENT_RESULT IoTHubDeviceClient_LL_UploadMultipleBlocksToBlob(IOTHUB_DEVICE_CLIENT_LL_HANDLE iotHubClientHandle, const char *destinationFileName, IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK_EX getDataCallbackEx, void *context);
+void IoTHubDeviceClient_LL_DoWork(IOTHUB_DEVICE_CLIENT_LL_HANDLE h);
+IOTHUB_MESSAGE_HANDLE IoTHubMessage_CreateFromString(const char *source);
+IOTHUB_MESSAGE_HANDLE IoTHubMessage_CreateFromByteArray(const unsigned char *data, size_t size);
+void IoTHubMessage_Destroy(IOTHUB_MESSAGE_HANDLE m);
+const char *IoTHubMessage_GetString(IOTHUB_MESSAGE_HANDLE m);
+IOTHUB_MESSAGE_RESULT IoTHubMessage_GetByteArray(IOTHUB_MESSAGE_HANDLE m, const unsigned char **buffer, size_t *size);
+IOTHUB_MESSAGE_RESULT IoTHubMessage_SetContentTypeSystemProperty(IOTHUB_MESSAGE_HANDLE m, const char *ct);
+IOTHUB_MESSAGE_RESULT IoTHubMessage_SetContentEncodingSystemProperty(IOTHUB_MESSAGE_HANDLE m, const char *ce);
+IOTHUB_MESSAGE_RESULT IoTHubMessage_SetProperty(IOTHUB_MESSAGE_HANDLE m, const char *key, const char *value);
+#define OPTION_MODEL_ID "model_id"
+#define OPTION_AUTO_URL_ENCODE_DECODE "auto_url_encode_decode"
+#define OPTION_KEEP_ALIVE "keepalive"
+#define OPTION_TRUSTED_CERT "TrustedCerts"
+#define IOTHUB_CLIENT_CONNECTION_STATUS_REASON_VALUES IOTHUB_CLIENT_CONNECTION_STATUS_REASON
+#define IOTHUB_CLIENT_RESULT_VALUE IOTHUB_CLIENT_RESULT
+const char *IOTHUB_CLIENT_CONNECTION_STATUS_REASONStrings(IOTHUB_CLIENT_CONNECTION_STATUS_REASON r);
+const char *IOTHUB_CLIENT_RESULTStrings(IOTHUB_CLIENT_RESULT r);
+const char *IOTHUB_CLIENT_CONFIRMATION_RESULTStrings(IOTHUB_CLIENT_CONFIRMATION_RESULT r);
+#define MU_DEFINE_ENUM_STRINGS_WITHOUT_INVALID(a, b) extern int mu_dummy_##a
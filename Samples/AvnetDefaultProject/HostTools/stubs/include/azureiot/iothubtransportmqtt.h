@@ -0,0 +1,2 @@
+// Host build stub for the Azure IoT C SDK <iothubtransportmqtt.h>
+#pragma once
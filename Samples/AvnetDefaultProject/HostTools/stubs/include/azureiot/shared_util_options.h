@@ -0,0 +1,2 @@
+// Host build stub for the Azure IoT C SDK <shared_util_options.h>
+#pragma once
@@ -0,0 +1,25 @@
+// Host build stub for <hw/sample_appliance.h>
+#pragma once
+#define SAMPLE_BUTTON_1 12
+#define SAMPLE_BUTTON_2 13
+#define SAMPLE_LED 8
+#define SAMPLE_RGBLED_RED 8
+#define SAMPLE_RGBLED_GREEN 9
+#define SAMPLE_RGBLED_BLUE 10
+#define SAMPLE_LSM6DSO_I2C 2
+#define WIFI_LED 16
+#define APP_LED 17
+#define WLAN_LED 15
+#define SAMPLE_LED_1 1
+#define SAMPLE_LED_2 2
+#define SAMPLE_LED_3 3
+#define SAMPLE_NRF52_UART 4
+#define RELAY_CLICK_RELAY1 5
+#define RELAY_CLICK_RELAY2 6
+#define ISU2 2
+#define AVNET_MT3620_SK_ISU2_I2C 2
+#define AVNET_MT3620_SK_ISU1_I2C 1
+#define AVNET_MT3620_SK_USER_BUTTON_A 12
+#define AVNET_MT3620_SK_USER_BUTTON_B 13
+#define SAMPLE_APP_LED 17
+#define SAMPLE_WIFI_LED 16
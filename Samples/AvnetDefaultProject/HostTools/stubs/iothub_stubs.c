@@ -0,0 +1,983 @@
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Host implementation of the Azure IoT device client (LL) API
+//
+//  There is no network.  Telemetry and reported state sends are queued and confirmed on the next
+//  IoTHubDeviceClient_LL_DoWork() call.  Cloud to device traffic (twin updates, direct methods,
+//  C2D messages) is injected with the hostIoT_* functions in host_stubs.h.
+//
+//  The stub also emulates the IoT Hub side of the MQTT connection for harnesses like hub_sim.
+//  Traffic in both directions is routed by IoT Hub MQTT topic name, and hostIoT_SetHubConfig()
+//  adds acknowledgement latency, message loss, throttling and disconnects.  Acknowledgements
+//  arrive in order, the way PUBACKs do on a single MQTT connection.  The default configuration
+//  confirms every send on the next DoWork.
+//
+//  File uploads (IoTHubDeviceClient_LL_UploadMultipleBlocksToBlob) block the calling thread, like
+//  the SDK, and PUT each block to a local HTTP stand-in for the storage account, see
+//  hostIoT_SetBlobConfig().
+//
+//  The stub does not allocate memory per message so allocation counts measured on the host
+//  belong to the application.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include <iothub_device_client_ll.h>
+#include <azure_prov_client/iothub_security_factory.h>
+
+#include "host_stubs.h"
+
+#define HOST_IOT_MAX_PENDING 4096
+#define HOST_IOT_MESSAGE_SLOTS 8
+#define HOST_IOT_DEVICE_ID "hla-host"
+#define HOST_IOT_TOPIC_SIZE 128
+#define HOST_IOT_BLOB_CONTAINER "uploads"
+#define HOST_IOT_BLOB_NAME_SIZE 256
+#define HOST_IOT_HTTP_HEADER_SIZE 512
+
+typedef struct {
+    bool isReportedState;
+    IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventCallback;
+    IOTHUB_CLIENT_REPORTED_STATE_CALLBACK reportedStateCallback;
+    void *context;
+    uint64_t queuedNs;
+    uint64_t dueNs;
+} hostPendingSend_t;
+
+// Sends waiting for DoWork in due time order
+typedef struct {
+    hostPendingSend_t sends[HOST_IOT_MAX_PENDING];
+    size_t head;
+    size_t count;
+} hostSendQueue_t;
+
+struct IOTHUB_DEVICE_CLIENT_LL_TAG {
+    IOTHUB_CLIENT_CONNECTION_STATUS_CALLBACK connectionStatusCallback;
+    void *connectionStatusContext;
+    IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK twinCallback;
+    void *twinContext;
+    IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC methodCallback;
+    void *methodContext;
+    IOTHUB_CLIENT_MESSAGE_CALLBACK_ASYNC messageCallback;
+    void *messageContext;
+
+    // Sends the hub will acknowledge, and lost sends that will time out
+    hostSendQueue_t pending;
+    hostSendQueue_t lost;
+};
+
+struct IOTHUB_MESSAGE_HANDLE_DATA_TAG {
+    bool inUse;
+    const unsigned char *data;
+    size_t length;
+};
+
+static struct IOTHUB_DEVICE_CLIENT_LL_TAG client;
+static bool clientActive = false;
+static struct IOTHUB_MESSAGE_HANDLE_DATA_TAG messageSlots[HOST_IOT_MESSAGE_SLOTS];
+
+static hostIoTMessageHook telemetryHook = NULL;
+static void *telemetryHookContext = NULL;
+static hostIoTMessageHook reportedStateHook = NULL;
+static void *reportedStateHookContext = NULL;
+
+static hostIoTTopicHook topicHook = NULL;
+static void *topicHookContext = NULL;
+static hostIoTAckHook ackHook = NULL;
+static void *ackHookContext = NULL;
+
+static IOTHUB_CLIENT_CONFIRMATION_RESULT sendResult = IOTHUB_CLIENT_CONFIRMATION_OK;
+static bool sendRejected = false;
+
+// Emulated hub behavior and state
+static hostIoTHubConfig_t hubConfig;
+static hostIoTHubStats_t hubStats;
+static unsigned int hubRandomState = 1;
+static uint64_t lastDueNs = 0;
+static double throttleTokens = 0;
+static uint64_t throttleRefillNs = 0;
+// Read by a blob upload running on a work queue thread, written with __atomic_store_n()
+static bool hubConnected = false;
+static uint64_t nextDisconnectNs = 0;
+static uint64_t outageEndNs = 0;
+static unsigned int reportedRequestId = 0;
+
+// Connection status to deliver on the next DoWork, the client starts authenticated
+static bool statusChangePending = false;
+static IOTHUB_CLIENT_CONNECTION_STATUS pendingStatus = IOTHUB_CLIENT_CONNECTION_AUTHENTICATED;
+static IOTHUB_CLIENT_CONNECTION_STATUS_REASON pendingReason = IOTHUB_CLIENT_CONNECTION_OK;
+
+// File upload in progress, one at a time like the SDK
+typedef struct {
+    bool active;
+    IOTHUB_CLIENT_FILE_UPLOAD_RESULT result;
+    char name[HOST_IOT_BLOB_NAME_SIZE];
+    IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK_EX getDataCallback;
+    void *context;
+    uint32_t blocks;
+} hostBlobUpload_t;
+
+static hostBlobUpload_t blobUpload;
+static hostIoTBlobConfig_t blobConfig;
+static hostIoTBlobStats_t blobStats;
+static uint32_t blobFailuresLeft = 0;
+static int storageSocket = -1;
+
+static uint64_t nowNs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint64_t)now.tv_sec * 1000000000ULL) + (uint64_t)now.tv_nsec;
+}
+
+static uint64_t msToNs(uint32_t ms)
+{
+    return (uint64_t)ms * 1000000ULL;
+}
+
+static void publishTopic(const char *topic, const unsigned char *payload, size_t length)
+{
+    if (topicHook != NULL) {
+        topicHook(topic, (const char *)payload, length, topicHookContext);
+    }
+}
+
+static bool pushSend(hostSendQueue_t *queue, const hostPendingSend_t *send)
+{
+    if (queue->count == HOST_IOT_MAX_PENDING) {
+        return false;
+    }
+
+    queue->sends[(queue->head + queue->count) % HOST_IOT_MAX_PENDING] = *send;
+    queue->count++;
+    return true;
+}
+
+static hostPendingSend_t popSend(hostSendQueue_t *queue)
+{
+    hostPendingSend_t send = queue->sends[queue->head];
+    queue->head = (queue->head + 1) % HOST_IOT_MAX_PENDING;
+    queue->count--;
+    return send;
+}
+
+// Takes a throttle token, returns how long the send has to wait for one
+static uint64_t throttleDelayNs(uint64_t now)
+{
+    if (hubConfig.throttleMsgsPerSecond == 0) {
+        return 0;
+    }
+
+    // Refill, allowing a burst of up to one second of traffic
+    throttleTokens += (double)(now - throttleRefillNs) * hubConfig.throttleMsgsPerSecond / 1e9;
+    if (throttleTokens > hubConfig.throttleMsgsPerSecond) {
+        throttleTokens = hubConfig.throttleMsgsPerSecond;
+    }
+    throttleRefillNs = now;
+
+    throttleTokens -= 1.0;
+    if (throttleTokens >= 0) {
+        return 0;
+    }
+
+    hubStats.throttled++;
+    return (uint64_t)(-throttleTokens * 1e9 / hubConfig.throttleMsgsPerSecond);
+}
+
+// Works out when the hub acknowledges a send, or queues it to time out if it is lost
+static bool queueSend(hostPendingSend_t *send)
+{
+    uint64_t now = nowNs();
+    send->queuedNs = now;
+
+    if (!send->isReportedState && (hubConfig.lossPercent > 0) &&
+        ((rand_r(&hubRandomState) % 10000) < (unsigned)(hubConfig.lossPercent * 100))) {
+        send->dueNs = now + msToNs(hubConfig.messageTimeoutMs);
+        return pushSend(&client.lost, send);
+    }
+
+    uint64_t due = now + msToNs(hubConfig.latencyMs);
+    if (hubConfig.jitterMs > 0) {
+        due += msToNs((uint32_t)rand_r(&hubRandomState) % (hubConfig.jitterMs + 1));
+    }
+    if (!send->isReportedState) {
+        due += throttleDelayNs(now);
+    }
+
+    // Acknowledgements come back in order on the one connection
+    if (due < lastDueNs) {
+        due = lastDueNs;
+    }
+    lastDueNs = due;
+
+    send->dueNs = due;
+    return pushSend(&client.pending, send);
+}
+
+static void completeSend(const hostPendingSend_t *send, IOTHUB_CLIENT_CONFIRMATION_RESULT result)
+{
+    uint64_t latencyNs = nowNs() - send->queuedNs;
+
+    if (send->isReportedState) {
+        hubStats.reportedAcked++;
+        if (send->reportedStateCallback != NULL) {
+            send->reportedStateCallback(204, send->context);
+        }
+    } else {
+        switch (result) {
+        case IOTHUB_CLIENT_CONFIRMATION_OK:
+            hubStats.telemetryAcked++;
+            break;
+        case IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT:
+            hubStats.telemetryTimedOut++;
+            break;
+        case IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY:
+            hubStats.telemetryDestroyed++;
+            break;
+        default:
+            hubStats.telemetryFailed++;
+            break;
+        }
+        if (send->eventCallback != NULL) {
+            send->eventCallback(result, send->context);
+        }
+    }
+
+    if (ackHook != NULL) {
+        ackHook(send->isReportedState, result, latencyNs, ackHookContext);
+    }
+}
+
+// Drops the connection if a disconnect is due
+static void checkDisconnect(IOTHUB_DEVICE_CLIENT_LL_HANDLE h, uint64_t now)
+{
+    if (!hubConnected || (hubConfig.disconnectEveryMs == 0) || (now < nextDisconnectNs)) {
+        return;
+    }
+
+    __atomic_store_n(&hubConnected, false, __ATOMIC_RELAXED);
+    hubStats.disconnects++;
+    outageEndNs = now + msToNs(hubConfig.disconnectForMs);
+    nextDisconnectNs = now + msToNs(hubConfig.disconnectEveryMs);
+
+    if (h->connectionStatusCallback != NULL) {
+        h->connectionStatusCallback(IOTHUB_CLIENT_CONNECTION_UNAUTHENTICATED,
+                                    IOTHUB_CLIENT_CONNECTION_NO_NETWORK,
+                                    h->connectionStatusContext);
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//  Storage endpoint (Azure Storage block blob REST API over a keep alive HTTP/1.1 connection)
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void closeStorage(void)
+{
+    if (storageSocket >= 0) {
+        close(storageSocket);
+        storageSocket = -1;
+    }
+}
+
+static bool sendAll(const void *data, size_t length)
+{
+    const char *bytes = data;
+    while (length > 0) {
+        ssize_t sent = send(storageSocket, bytes, length, MSG_NOSIGNAL);
+        if (sent <= 0) {
+            return false;
+        }
+        bytes += sent;
+        length -= (size_t)sent;
+    }
+    return true;
+}
+
+// Sends the request line and headers, connecting first if needed
+static bool sendRequestHeader(const char *query, size_t contentLength)
+{
+    if (storageSocket < 0) {
+        struct sockaddr_in address = {.sin_family = AF_INET, .sin_port = htons(blobConfig.port)};
+        if (inet_pton(AF_INET, blobConfig.host, &address.sin_addr) != 1) {
+            return false;
+        }
+        storageSocket = socket(AF_INET, SOCK_STREAM, 0);
+        if (storageSocket < 0) {
+            return false;
+        }
+        int noDelay = 1;
+        setsockopt(storageSocket, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+        if (connect(storageSocket, (struct sockaddr *)&address, sizeof(address)) != 0) {
+            closeStorage();
+            return false;
+        }
+    }
+
+    char header[HOST_IOT_HTTP_HEADER_SIZE];
+    int length = snprintf(header, sizeof(header),
+                          "PUT /" HOST_IOT_BLOB_CONTAINER "/" HOST_IOT_DEVICE_ID "/%s?%s HTTP/1.1\r\n"
+                          "Host: %s\r\n"
+                          "x-ms-version: 2019-12-12\r\n"
+                          "Content-Length: %zu\r\n\r\n",
+                          blobUpload.name, query, blobConfig.host, contentLength);
+    blobStats.httpRequests++;
+    return (length > 0) && ((size_t)length < sizeof(header)) && sendAll(header, (size_t)length);
+}
+
+// Reads the response and returns the HTTP status, -1 if the connection failed
+static int readResponse(void)
+{
+    char response[HOST_IOT_HTTP_HEADER_SIZE];
+    size_t length = 0;
+    char *body = NULL;
+
+    while (body == NULL) {
+        if (length == sizeof(response) - 1) {
+            return -1;
+        }
+        ssize_t received = recv(storageSocket, &response[length], sizeof(response) - 1 - length, 0);
+        if (received <= 0) {
+            return -1;
+        }
+        length += (size_t)received;
+        response[length] = '\0';
+        body = strstr(response, "\r\n\r\n");
+    }
+
+    int status = -1;
+    size_t contentLength = 0;
+    sscanf(response, "HTTP/1.1 %d", &status);
+    const char *field = strstr(response, "Content-Length:");
+    if (field != NULL) {
+        contentLength = strtoul(field + strlen("Content-Length:"), NULL, 10);
+    }
+
+    // Discard the body, the stand-in keeps them short
+    size_t bodyReceived = length - (size_t)((body + 4) - response);
+    while (bodyReceived < contentLength) {
+        ssize_t received = recv(storageSocket, response, sizeof(response), 0);
+        if (received <= 0) {
+            return -1;
+        }
+        bodyReceived += (size_t)received;
+    }
+    return status;
+}
+
+// Put Block, returns true when the endpoint accepted the block
+static bool putBlock(const unsigned char *data, size_t size)
+{
+    if (blobConfig.host == NULL) {
+        return true;
+    }
+
+    char query[64];
+    snprintf(query, sizeof(query), "comp=block&blockid=%08x", blobUpload.blocks);
+    int status = -1;
+    if (sendRequestHeader(query, size) && sendAll(data, size)) {
+        status = readResponse();
+    }
+    if (status != 201) {
+        blobStats.httpErrors++;
+        closeStorage();
+        return false;
+    }
+    return true;
+}
+
+// Put Block List, the list is written in pieces so its size does not matter
+static bool putBlockList(void)
+{
+    static const char listStart[] = "<?xml version=\"1.0\" encoding=\"utf-8\"?><BlockList>";
+    static const char listEnd[] = "</BlockList>";
+    static const size_t entryLength = sizeof("<Latest>00000000</Latest>") - 1;
+
+    if (blobConfig.host == NULL) {
+        return true;
+    }
+
+    size_t contentLength = (sizeof(listStart) - 1) + (blobUpload.blocks * entryLength) +
+                           (sizeof(listEnd) - 1);
+    bool sent = sendRequestHeader("comp=blocklist", contentLength) &&
+                sendAll(listStart, sizeof(listStart) - 1);
+
+    char entries[64 * 32];
+    for (uint32_t block = 0; sent && (block < blobUpload.blocks);) {
+        size_t length = 0;
+        for (uint32_t i = 0; (i < 64) && (block < blobUpload.blocks); i++, block++) {
+            length += (size_t)snprintf(&entries[length], sizeof(entries) - length,
+                                       "<Latest>%08x</Latest>", block);
+        }
+        sent = sendAll(entries, length);
+    }
+
+    int status = (sent && sendAll(listEnd, sizeof(listEnd) - 1)) ? readResponse() : -1;
+    if (status != 201) {
+        blobStats.httpErrors++;
+        closeStorage();
+        return false;
+    }
+    return true;
+}
+
+// Reports the result of the upload to the application
+static void finishBlobUpload(IOTHUB_CLIENT_FILE_UPLOAD_RESULT result)
+{
+    blobUpload.active = false;
+    blobUpload.result = result;
+    if (result == IOTHUB_CLIENT_FILE_UPLOAD_OK) {
+        blobStats.uploadsCompleted++;
+    } else {
+        blobStats.uploadsFailed++;
+    }
+    blobUpload.getDataCallback(result, NULL, NULL, blobUpload.context);
+}
+
+// Moves the upload on by one block
+static void blobStep(void)
+{
+    if (!__atomic_load_n(&hubConnected, __ATOMIC_RELAXED)) {
+        finishBlobUpload(IOTHUB_CLIENT_FILE_UPLOAD_ERROR);
+        return;
+    }
+
+    if ((blobFailuresLeft > 0) && (blobUpload.blocks == blobConfig.failAfterBlocks)) {
+        blobFailuresLeft--;
+        finishBlobUpload(IOTHUB_CLIENT_FILE_UPLOAD_ERROR);
+        return;
+    }
+
+    const unsigned char *data = NULL;
+    size_t size = 0;
+    if (blobUpload.getDataCallback(IOTHUB_CLIENT_FILE_UPLOAD_OK, &data, &size, blobUpload.context) ==
+        IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_ABORT) {
+        finishBlobUpload(IOTHUB_CLIENT_FILE_UPLOAD_ERROR);
+        return;
+    }
+
+    if ((data == NULL) || (size == 0)) {
+        finishBlobUpload(putBlockList() ? IOTHUB_CLIENT_FILE_UPLOAD_OK
+                                        : IOTHUB_CLIENT_FILE_UPLOAD_ERROR);
+        return;
+    }
+
+    if (!putBlock(data, size)) {
+        finishBlobUpload(IOTHUB_CLIENT_FILE_UPLOAD_ERROR);
+        return;
+    }
+    blobUpload.blocks++;
+    blobStats.blocks++;
+    blobStats.bytes += size;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//  Azure IoT SDK API
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+const void *MQTT_Protocol(void)
+{
+    return &client;
+}
+
+int iothub_security_init(IOTHUB_SECURITY_TYPE t)
+{
+    return 0;
+}
+
+void iothub_security_deinit(void) {}
+
+IOTHUB_DEVICE_CLIENT_LL_HANDLE
+IoTHubDeviceClient_LL_CreateWithAzureSphereFromDeviceAuth(const char *iotHubUri,
+                                                          IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol)
+{
+    memset(&client, 0, sizeof(client));
+    clientActive = true;
+    lastDueNs = 0;
+
+    // The SDK reports the connection once it has authenticated
+    statusChangePending = true;
+    pendingStatus = IOTHUB_CLIENT_CONNECTION_AUTHENTICATED;
+    pendingReason = IOTHUB_CLIENT_CONNECTION_OK;
+    return &client;
+}
+
+void IoTHubDeviceClient_LL_Destroy(IOTHUB_DEVICE_CLIENT_LL_HANDLE h)
+{
+    // Outstanding sends are confirmed with BECAUSE_DESTROY, the same as the SDK
+    hostSendQueue_t *queues[] = {&h->pending, &h->lost};
+    for (size_t q = 0; q < sizeof(queues) / sizeof(queues[0]); q++) {
+        while (queues[q]->count > 0) {
+            hostPendingSend_t send = popSend(queues[q]);
+            if (!send.isReportedState) {
+                completeSend(&send, IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY);
+            }
+        }
+    }
+
+    // The application does not destroy the client while an upload is running
+    closeStorage();
+
+    clientActive = false;
+    __atomic_store_n(&hubConnected, false, __ATOMIC_RELAXED);
+}
+
+IOTHUB_CLIENT_RESULT IoTHubDeviceClient_LL_SetOption(IOTHUB_DEVICE_CLIENT_LL_HANDLE h,
+                                                     const char *optionName, const void *value)
+{
+    return IOTHUB_CLIENT_OK;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubDeviceClient_LL_SetConnectionStatusCallback(
+    IOTHUB_DEVICE_CLIENT_LL_HANDLE h, IOTHUB_CLIENT_CONNECTION_STATUS_CALLBACK cb, void *ctx)
+{
+    h->connectionStatusCallback = cb;
+    h->connectionStatusContext = ctx;
+    return IOTHUB_CLIENT_OK;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubDeviceClient_LL_SetDeviceTwinCallback(
+    IOTHUB_DEVICE_CLIENT_LL_HANDLE h, IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK cb, void *ctx)
+{
+    h->twinCallback = cb;
+    h->twinContext = ctx;
+    return IOTHUB_CLIENT_OK;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubDeviceClient_LL_SetDeviceMethodCallback(
+    IOTHUB_DEVICE_CLIENT_LL_HANDLE h, IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC cb, void *ctx)
+{
+    h->methodCallback = cb;
+    h->methodContext = ctx;
+    return IOTHUB_CLIENT_OK;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubDeviceClient_LL_SetMessageCallback(
+    IOTHUB_DEVICE_CLIENT_LL_HANDLE h, IOTHUB_CLIENT_MESSAGE_CALLBACK_ASYNC cb, void *ctx)
+{
+    h->messageCallback = cb;
+    h->messageContext = ctx;
+    return IOTHUB_CLIENT_OK;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubDeviceClient_LL_SendEventAsync(IOTHUB_DEVICE_CLIENT_LL_HANDLE h,
+                                                          IOTHUB_MESSAGE_HANDLE m,
+                                                          IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK cb,
+                                                          void *ctx)
+{
+    hostPendingSend_t send = {.isReportedState = false, .eventCallback = cb, .context = ctx};
+
+    if (sendRejected || !queueSend(&send)) {
+        hubStats.telemetryRejected++;
+        return IOTHUB_CLIENT_ERROR;
+    }
+
+    hostStubCounters.telemetrySent++;
+    if (telemetryHook != NULL) {
+        telemetryHook((const char *)m->data, m->length, telemetryHookContext);
+    }
+    publishTopic("devices/" HOST_IOT_DEVICE_ID "/messages/events/", m->data, m->length);
+    return IOTHUB_CLIENT_OK;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubDeviceClient_LL_SendReportedState(IOTHUB_DEVICE_CLIENT_LL_HANDLE h,
+                                                             const unsigned char *reportedState,
+                                                             size_t size,
+                                                             IOTHUB_CLIENT_REPORTED_STATE_CALLBACK cb,
+                                                             void *ctx)
+{
+    hostPendingSend_t send = {.isReportedState = true, .reportedStateCallback = cb, .context = ctx};
+
+    if (!queueSend(&send)) {
+        return IOTHUB_CLIENT_ERROR;
+    }
+
+    hostStubCounters.reportedStatesSent++;
+    if (reportedStateHook != NULL) {
+        reportedStateHook((const char *)reportedState, size, reportedStateHookContext);
+    }
+    if (topicHook != NULL) {
+        char topic[HOST_IOT_TOPIC_SIZE];
+        snprintf(topic, sizeof(topic), "$iothub/twin/PATCH/properties/reported/?$rid=%u",
+                 ++reportedRequestId);
+        publishTopic(topic, reportedState, size);
+    }
+    return IOTHUB_CLIENT_OK;
+}
+
+void IoTHubDeviceClient_LL_DoWork(IOTHUB_DEVICE_CLIENT_LL_HANDLE h)
+{
+    uint64_t now = nowNs();
+
+    // The hub refuses connections until an outage is over
+    if (statusChangePending && (now >= outageEndNs)) {
+        statusChangePending = false;
+        __atomic_store_n(&hubConnected, (pendingStatus == IOTHUB_CLIENT_CONNECTION_AUTHENTICATED),
+                         __ATOMIC_RELAXED);
+        if (hubConnected) {
+            hubStats.connects++;
+            if (nextDisconnectNs == 0 || nextDisconnectNs < now) {
+                nextDisconnectNs = now + msToNs(hubConfig.disconnectEveryMs);
+            }
+        }
+        if (h->connectionStatusCallback != NULL) {
+            h->connectionStatusCallback(pendingStatus, pendingReason, h->connectionStatusContext);
+        }
+    }
+
+    checkDisconnect(h, now);
+    if (!hubConnected) {
+        return;
+    }
+
+    // Only complete the sends that were queued before this call
+    size_t toComplete = h->pending.count;
+    while ((toComplete-- > 0) && (h->pending.count > 0) &&
+           (h->pending.sends[h->pending.head].dueNs <= now)) {
+        hostPendingSend_t send = popSend(&h->pending);
+        completeSend(&send, sendResult);
+    }
+
+    toComplete = h->lost.count;
+    while ((toComplete-- > 0) && (h->lost.count > 0) &&
+           (h->lost.sends[h->lost.head].dueNs <= now)) {
+        hostPendingSend_t send = popSend(&h->lost);
+        completeSend(&send, IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT);
+    }
+}
+
+IOTHUB_CLIENT_RESULT IoTHubDeviceClient_LL_UploadMultipleBlocksToBlob(
+    IOTHUB_DEVICE_CLIENT_LL_HANDLE h, const char *destinationFileName,
+    IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK_EX getDataCallbackEx, void *context)
+{
+    // The SDK needs the hub to hand out the storage SAS URI
+    if (!clientActive || !__atomic_load_n(&hubConnected, __ATOMIC_RELAXED) || blobUpload.active ||
+        (getDataCallbackEx == NULL) || (strlen(destinationFileName) >= sizeof(blobUpload.name))) {
+        return IOTHUB_CLIENT_ERROR;
+    }
+
+    strcpy(blobUpload.name, destinationFileName);
+    blobUpload.getDataCallback = getDataCallbackEx;
+    blobUpload.context = context;
+    blobUpload.blocks = 0;
+    blobUpload.result = IOTHUB_CLIENT_FILE_UPLOAD_ERROR;
+    blobUpload.active = true;
+    blobStats.uploadsStarted++;
+
+    while (blobUpload.active) {
+        blobStep();
+    }
+    return (blobUpload.result == IOTHUB_CLIENT_FILE_UPLOAD_OK) ? IOTHUB_CLIENT_OK : IOTHUB_CLIENT_ERROR;
+}
+
+IOTHUB_MESSAGE_HANDLE IoTHubMessage_CreateFromByteArray(const unsigned char *data, size_t size)
+{
+    // The application destroys each message right after sending it, so the slots reference
+    // the caller's buffer instead of copying it
+    for (int i = 0; i < HOST_IOT_MESSAGE_SLOTS; i++) {
+        if (!messageSlots[i].inUse) {
+            messageSlots[i].inUse = true;
+            messageSlots[i].data = data;
+            messageSlots[i].length = size;
+            return &messageSlots[i];
+        }
+    }
+    return NULL;
+}
+
+IOTHUB_MESSAGE_HANDLE IoTHubMessage_CreateFromString(const char *source)
+{
+    return IoTHubMessage_CreateFromByteArray((const unsigned char *)source, strlen(source));
+}
+
+void IoTHubMessage_Destroy(IOTHUB_MESSAGE_HANDLE m)
+{
+    if (m != NULL) {
+        m->inUse = false;
+    }
+}
+
+const char *IoTHubMessage_GetString(IOTHUB_MESSAGE_HANDLE m)
+{
+    return (const char *)m->data;
+}
+
+IOTHUB_MESSAGE_RESULT IoTHubMessage_GetByteArray(IOTHUB_MESSAGE_HANDLE m,
+                                                 const unsigned char **buffer, size_t *size)
+{
+    *buffer = m->data;
+    *size = m->length;
+    return IOTHUB_MESSAGE_OK;
+}
+
+IOTHUB_MESSAGE_RESULT IoTHubMessage_SetContentTypeSystemProperty(IOTHUB_MESSAGE_HANDLE m,
+                                                                 const char *ct)
+{
+    return IOTHUB_MESSAGE_OK;
+}
+
+IOTHUB_MESSAGE_RESULT IoTHubMessage_SetContentEncodingSystemProperty(IOTHUB_MESSAGE_HANDLE m,
+                                                                     const char *ce)
+{
+    return IOTHUB_MESSAGE_OK;
+}
+
+IOTHUB_MESSAGE_RESULT IoTHubMessage_SetProperty(IOTHUB_MESSAGE_HANDLE m, const char *key,
+                                                const char *value)
+{
+    return IOTHUB_MESSAGE_OK;
+}
+
+const char *IOTHUB_CLIENT_CONNECTION_STATUS_REASONStrings(IOTHUB_CLIENT_CONNECTION_STATUS_REASON r)
+{
+    static const char *names[] = {"IOTHUB_CLIENT_CONNECTION_EXPIRED_SAS_TOKEN",
+                                  "IOTHUB_CLIENT_CONNECTION_DEVICE_DISABLED",
+                                  "IOTHUB_CLIENT_CONNECTION_BAD_CREDENTIAL",
+                                  "IOTHUB_CLIENT_CONNECTION_RETRY_EXPIRED",
+                                  "IOTHUB_CLIENT_CONNECTION_NO_NETWORK",
+                                  "IOTHUB_CLIENT_CONNECTION_COMMUNICATION_ERROR",
+                                  "IOTHUB_CLIENT_CONNECTION_OK",
+                                  "IOTHUB_CLIENT_CONNECTION_NO_PING_RESPONSE"};
+    return ((unsigned)r < sizeof(names) / sizeof(names[0])) ? names[r] : "UNKNOWN";
+}
+
+const char *IOTHUB_CLIENT_RESULTStrings(IOTHUB_CLIENT_RESULT r)
+{
+    static const char *names[] = {"IOTHUB_CLIENT_OK", "IOTHUB_CLIENT_INVALID_ARG",
+                                  "IOTHUB_CLIENT_ERROR", "IOTHUB_CLIENT_INVALID_SIZE",
+                                  "IOTHUB_CLIENT_INDEFINITE_TIME"};
+    return ((unsigned)r < sizeof(names) / sizeof(names[0])) ? names[r] : "UNKNOWN";
+}
+
+const char *IOTHUB_CLIENT_CONFIRMATION_RESULTStrings(IOTHUB_CLIENT_CONFIRMATION_RESULT r)
+{
+    static const char *names[] = {"IOTHUB_CLIENT_CONFIRMATION_OK",
+                                  "IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY",
+                                  "IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT",
+                                  "IOTHUB_CLIENT_CONFIRMATION_ERROR"};
+    return ((unsigned)r < sizeof(names) / sizeof(names[0])) ? names[r] : "UNKNOWN";
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//  Host control API
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void hostIoT_SetTelemetryHook(hostIoTMessageHook hook, void *hookContext)
+{
+    telemetryHook = hook;
+    telemetryHookContext = hookContext;
+}
+
+void hostIoT_SetReportedStateHook(hostIoTMessageHook hook, void *hookContext)
+{
+    reportedStateHook = hook;
+    reportedStateHookContext = hookContext;
+}
+
+void hostIoT_SetTopicHook(hostIoTTopicHook hook, void *hookContext)
+{
+    topicHook = hook;
+    topicHookContext = hookContext;
+}
+
+void hostIoT_SetAckHook(hostIoTAckHook hook, void *hookContext)
+{
+    ackHook = hook;
+    ackHookContext = hookContext;
+}
+
+void hostIoT_SetHubConfig(const hostIoTHubConfig_t *config)
+{
+    hubConfig = *config;
+    hubRandomState = (config->seed != 0) ? config->seed : 1;
+    throttleTokens = config->throttleMsgsPerSecond;
+    throttleRefillNs = nowNs();
+    nextDisconnectNs = (config->disconnectEveryMs != 0)
+                           ? throttleRefillNs + msToNs(config->disconnectEveryMs)
+                           : 0;
+}
+
+const hostIoTHubStats_t *hostIoT_GetHubStats(void)
+{
+    return &hubStats;
+}
+
+void hostIoT_SetSendResult(IOTHUB_CLIENT_CONFIRMATION_RESULT result)
+{
+    sendResult = result;
+}
+
+void hostIoT_SetSendRejected(bool rejected)
+{
+    sendRejected = rejected;
+}
+
+void hostIoT_SetAuthenticated(bool authenticated, IOTHUB_CLIENT_CONNECTION_STATUS_REASON reason)
+{
+    statusChangePending = true;
+    pendingStatus = authenticated ? IOTHUB_CLIENT_CONNECTION_AUTHENTICATED
+                                  : IOTHUB_CLIENT_CONNECTION_UNAUTHENTICATED;
+    pendingReason = reason;
+}
+
+void hostIoT_DeliverTwin(DEVICE_TWIN_UPDATE_STATE state, const char *json)
+{
+    if (clientActive && (client.twinCallback != NULL)) {
+        hubStats.twinUpdatesDelivered++;
+        client.twinCallback(state, (const unsigned char *)json, strlen(json), client.twinContext);
+    }
+}
+
+int hostIoT_InvokeMethod(const char *methodName, const char *payload, char **response,
+                         size_t *responseSize)
+{
+    unsigned char *responseBytes = NULL;
+    size_t size = 0;
+    int result = 404;
+
+    if (clientActive && (client.methodCallback != NULL)) {
+        hubStats.methodsInvoked++;
+        result = client.methodCallback(methodName, (const unsigned char *)payload, strlen(payload),
+                                       &responseBytes, &size, client.methodContext);
+    }
+
+    // The caller owns the response and must free() it, as the SDK would
+    *response = (char *)responseBytes;
+    *responseSize = size;
+    return result;
+}
+
+void hostIoT_DeliverMessage(const char *message)
+{
+    if (clientActive && (client.messageCallback != NULL)) {
+        IOTHUB_MESSAGE_HANDLE handle = IoTHubMessage_CreateFromString(message);
+        client.messageCallback(handle, client.messageContext);
+        IoTHubMessage_Destroy(handle);
+    }
+}
+
+// Returns the value of a "$name=value" topic property, or 0 if it's missing
+static unsigned int topicProperty(const char *topic, const char *name)
+{
+    const char *property = strstr(topic, name);
+    return (property != NULL) ? (unsigned int)strtoul(property + strlen(name), NULL, 10) : 0;
+}
+
+int hostIoT_Publish(const char *topic, const char *payload)
+{
+    static const char desiredTopic[] = "$iothub/twin/PATCH/properties/desired/";
+    static const char twinResponseTopic[] = "$iothub/twin/res/200/";
+    static const char methodTopic[] = "$iothub/methods/POST/";
+    static const char c2dTopic[] = "devices/" HOST_IOT_DEVICE_ID "/messages/devicebound/";
+
+    if (!clientActive || !hubConnected) {
+        return -1;
+    }
+
+    if (strncmp(topic, desiredTopic, sizeof(desiredTopic) - 1) == 0) {
+        hostIoT_DeliverTwin(DEVICE_TWIN_UPDATE_PARTIAL, payload);
+        return 0;
+    }
+
+    if (strncmp(topic, twinResponseTopic, sizeof(twinResponseTopic) - 1) == 0) {
+        hostIoT_DeliverTwin(DEVICE_TWIN_UPDATE_COMPLETE, payload);
+        return 0;
+    }
+
+    if (strncmp(topic, methodTopic, sizeof(methodTopic) - 1) == 0) {
+
+        // $iothub/methods/POST/{method name}/?$rid={request id}
+        char methodName[HOST_IOT_TOPIC_SIZE];
+        const char *nameStart = topic + sizeof(methodTopic) - 1;
+        size_t nameLength = strcspn(nameStart, "/");
+        if (nameLength >= sizeof(methodName)) {
+            return -1;
+        }
+        memcpy(methodName, nameStart, nameLength);
+        methodName[nameLength] = '\0';
+
+        char *response = NULL;
+        size_t responseSize = 0;
+        int status = hostIoT_InvokeMethod(methodName, payload, &response, &responseSize);
+
+        char responseTopic[HOST_IOT_TOPIC_SIZE];
+        snprintf(responseTopic, sizeof(responseTopic), "$iothub/methods/res/%d/?$rid=%u", status,
+                 topicProperty(topic, "$rid="));
+        publishTopic(responseTopic, (const unsigned char *)response, responseSize);
+        free(response);
+        return 0;
+    }
+
+    if (strncmp(topic, c2dTopic, sizeof(c2dTopic) - 1) == 0) {
+        hostIoT_DeliverMessage(payload);
+        return 0;
+    }
+
+    return -1;
+}
+
+void hostIoT_SetBlobConfig(const hostIoTBlobConfig_t *config)
+{
+    closeStorage();
+    blobConfig = *config;
+    blobFailuresLeft = (config->failAfterBlocks > 0) ? config->failUploads : 0;
+    memset(&blobStats, 0, sizeof(blobStats));
+}
+
+const hostIoTBlobStats_t *hostIoT_GetBlobStats(void)
+{
+    return &blobStats;
+}
+
+IOTHUB_DEVICE_CLIENT_LL_HANDLE hostIoT_GetClient(void)
+{
+    return clientActive ? &client : NULL;
+}
+
+void hostIoT_DoWork(void)
+{
+    if (clientActive) {
+        IoTHubDeviceClient_LL_DoWork(&client);
+    }
+}
+
+size_t hostIoT_PendingCount(void)
+{
+    return clientActive ? (client.pending.count + client.lost.count) : 0;
+}
@@ -0,0 +1,255 @@
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  backlog_test: Unit tests for the offline telemetry backlog (common/offline_backlog.c)
+//
+//  Messages are added to the resend list the way Cloud_SendTelemetry() adds them, with
+//  backlog_CheckSize() after each one, and the compacted list is checked against what was
+//  added.  The backlog is compiled in with a BACKLOG_MAX_BYTES small enough to compact after a
+//  few dozen messages (see CMakeLists.txt).
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+// The checks are asserts, keep them in Release builds
+#undef NDEBUG
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "linkedList.h"
+#include "offline_backlog.h"
+#include "parson.h"
+
+#define TEST_MESSAGES 400
+
+// 2023-10-11T16:00:00Z, each message is one second after the last
+#define TEST_START_TIME ((time_t)1697040000)
+
+static telemetryNode_t *AddMessage(const char *json, int index)
+{
+    telemetryNode_t *node = InsertAtTail((char *)json, (int)strlen(json));
+    assert(node != NULL);
+    node->firstTime = TEST_START_TIME + index;
+    node->lastTime = node->firstTime;
+    backlog_CheckSize();
+    return node;
+}
+
+static size_t ListBytes(void)
+{
+    size_t bytes = 0;
+    for (telemetryNode_t *node = head; node != NULL; node = node->next) {
+        bytes += sizeof(telemetryNode_t) + strlen(node->telemetryJson) + 1;
+    }
+    return bytes;
+}
+
+/// <summary>
+///     The "temp" statistics of a node, a plain message counts as one sample
+/// </summary>
+static void NodeStats(const telemetryNode_t *node, double *min, double *max, double *mean, double *count)
+{
+    JSON_Value *rootValue = json_parse_string(node->telemetryJson);
+    assert(rootValue != NULL);
+
+    JSON_Object *data = json_value_get_object(rootValue);
+    JSON_Array *envelope = json_object_get_array(data, "d");
+    if (envelope != NULL) {
+        data = json_object_get_object(json_array_get_object(envelope, 0), "d");
+        assert(data != NULL);
+    }
+
+    if (node->level == 0) {
+        *min = *max = *mean = json_object_get_number(data, "temp");
+        *count = 1;
+    }
+    else {
+        JSON_Object *stat = json_object_get_object(data, "temp");
+        assert(stat != NULL);
+        *min = json_object_get_number(stat, "min");
+        *max = json_object_get_number(stat, "max");
+        *mean = json_object_get_number(stat, "mean");
+        *count = json_object_get_number(stat, "count");
+
+        assert(json_object_get_number(data, "backlogMessages") == node->messageCount);
+        assert(strcmp(json_object_get_string(data, "status"), "ok") == 0);
+    }
+
+    json_value_free(rootValue);
+}
+
+/// <summary>
+///     Every message is accounted for, oldest first, and coarser summaries are older than
+///     finer ones
+/// </summary>
+static void CheckList(int added, bool ioTConnect)
+{
+    assert(ListBytes() <= BACKLOG_MAX_BYTES);
+
+    uint32_t messages = 0;
+    int previousLevel = INT32_MAX;
+    double nextTemp = 0;
+
+    for (telemetryNode_t *node = head; node != NULL; node = node->next) {
+
+        double min, max, mean, count;
+        NodeStats(node, &min, &max, &mean, &count);
+
+        // A summary covers a contiguous run, temp counts up by one per message
+        assert(count == node->messageCount);
+        assert(min == nextTemp);
+        assert(max == nextTemp + count - 1);
+        assert(fabs(mean - (min + max) / 2.0) < 1e-9);
+        assert(node->lastTime - node->firstTime == (time_t)count - 1);
+        assert(node->firstTime == TEST_START_TIME + (time_t)nextTemp);
+
+        // Nodes the SDK holds keep their place and level
+        if (node->sendsPending == 0) {
+            assert(node->level <= previousLevel);
+            previousLevel = node->level;
+        }
+
+        nextTemp += count;
+        messages += node->messageCount;
+        assert((strstr(node->telemetryJson, "\"mt\":0") != NULL) == ioTConnect);
+    }
+
+    assert(messages == (uint32_t)added);
+    assert(nextTemp == added);
+}
+
+static void TestCompaction(void)
+{
+    char json[128];
+    uint32_t compactions = backlog_GetStats()->compactions;
+
+    InitLinkedList();
+    for (int i = 0; i < TEST_MESSAGES; i++) {
+        snprintf(json, sizeof(json), "{\"temp\":%d,\"status\":\"ok\"}", i);
+        AddMessage(json, i);
+        CheckList(i + 1, false);
+    }
+
+    // The newest messages are kept as sent, the oldest have been folded more than once
+    assert(backlog_GetStats()->compactions > compactions);
+    assert(backlog_GetStats()->messagesDropped == 0);
+    assert(head->level >= 2);
+    assert(head->prev == NULL);
+
+    telemetryNode_t *tail = head;
+    while (tail->next != NULL) {
+        tail = tail->next;
+    }
+    snprintf(json, sizeof(json), "{\"temp\":%d,\"status\":\"ok\"}", TEST_MESSAGES - 1);
+    assert(strcmp(tail->telemetryJson, json) == 0);
+
+    // The summary times are the first and last message it covers
+    JSON_Value *rootValue = json_parse_string(head->telemetryJson);
+    assert(strcmp(json_object_get_string(json_value_get_object(rootValue), "backlogFrom"),
+                  "2023-10-11T16:00:00Z") == 0);
+    json_value_free(rootValue);
+
+    DeleteEntireList();
+}
+
+static void TestIoTConnectEnvelope(void)
+{
+    char json[128];
+
+    InitLinkedList();
+    for (int i = 0; i < TEST_MESSAGES / 4; i++) {
+        snprintf(json, sizeof(json), "{\"mt\":0,\"d\":[{\"id\":\"dev\",\"d\":{\"temp\":%d,\"status\":\"ok\"}}]}", i);
+        AddMessage(json, i);
+    }
+
+    CheckList(TEST_MESSAGES / 4, true);
+    assert(head->level >= 1);
+
+    DeleteEntireList();
+}
+
+static void TestPendingNodes(void)
+{
+    char json[128];
+
+    InitLinkedList();
+
+    // The SDK holds the first message, it can't be folded into a summary
+    telemetryNode_t *pending = AddMessage("{\"temp\":0,\"status\":\"ok\"}", 0);
+    backlog_SendAttempted(pending, true);
+    assert(backlog_CanResend(pending));
+
+    for (int i = 1; i < TEST_MESSAGES / 4; i++) {
+        snprintf(json, sizeof(json), "{\"temp\":%d,\"status\":\"ok\"}", i);
+        AddMessage(json, i);
+    }
+
+    assert(head == pending);
+    assert(pending->level == 0);
+    assert(strcmp(pending->telemetryJson, "{\"temp\":0,\"status\":\"ok\"}") == 0);
+    CheckList(TEST_MESSAGES / 4, false);
+
+    // Delivered, the node is freed once the SDK has called back for every send
+    backlog_SendAttempted(pending, true);
+    backlog_SendCompleted(pending, true);
+    assert(IsNodeInList(pending));
+    assert(!backlog_CanResend(pending));
+    backlog_SendCompleted(pending, false);
+    assert(!IsNodeInList(pending));
+
+    DeleteEntireList();
+}
+
+static void TestDrop(void)
+{
+    static char json[BACKLOG_MAX_BYTES + 64];
+    uint32_t dropped = backlog_GetStats()->messagesDropped;
+
+    // A single message over the limit has nothing to be compacted with
+    InitLinkedList();
+    snprintf(json, sizeof(json), "{\"temp\":0,\"status\":\"%0*d\"}", BACKLOG_MAX_BYTES, 0);
+    AddMessage(json, 0);
+
+    assert(head == NULL);
+    assert(backlog_GetStats()->messagesDropped == dropped + 1);
+    assert(backlog_GetStats()->peakBytes > BACKLOG_MAX_BYTES);
+}
+
+int main(void)
+{
+    TestCompaction();
+    TestIoTConnectEnvelope();
+    TestPendingNodes();
+    TestDrop();
+
+    printf("backlog_test: passed\n");
+    return 0;
+}
@@ -0,0 +1,196 @@
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  key_dictionary_test: Unit tests for the telemetry key dictionary (common/key_dictionary.c)
+//
+//  Messages are compacted with keyDictionary_Compact() and expanded again the way the cloud
+//  side does, the result must match the original message.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+// The checks are asserts, keep them in Release builds
+#undef NDEBUG
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "key_dictionary.h"
+
+#define COUNT_OF(a) (sizeof(a) / sizeof((a)[0]))
+
+static const keyDictionaryEntry_t testEntries[] = {
+    {"humidity",    "h"},
+    {"pressure",    "p"},
+    {"temperature", "t"},
+};
+static const keyDictionary_t testDictionary = {"t1", testEntries, COUNT_OF(testEntries)};
+
+/// <summary>
+///     Replace each object key that is a short key with its full key, the cloud side of
+///     keyDictionary_Compact()
+/// </summary>
+static void Expand(const keyDictionary_t *dictionary, const char *message, char *out, size_t outSize)
+{
+    size_t used = 0;
+
+    while (*message != '\0') {
+
+        size_t length = 1;
+        const char *replacement = NULL;
+
+        if (*message == '"') {
+            const char *end = message + 1;
+            while (*end != '"') {
+                assert(*end != '\0');
+                end += (end[0] == '\\') ? 2 : 1;
+            }
+            length = (size_t)(end - message) + 1;
+
+            const char *after = end + 1;
+            while (*after == ' ') {
+                after++;
+            }
+            for (size_t i = 0; (*after == ':') && (i < dictionary->entryCount); i++) {
+                const char *shortKey = dictionary->entries[i].shortKey;
+                if ((strlen(shortKey) == length - 2) && (strncmp(shortKey, message + 1, length - 2) == 0)) {
+                    replacement = dictionary->entries[i].key;
+                }
+            }
+        }
+
+        if (replacement != NULL) {
+            used += (size_t)snprintf(&out[used], outSize - used, "\"%s\"", replacement);
+        }
+        else {
+            assert(used + length < outSize);
+            memcpy(&out[used], message, length);
+            used += length;
+        }
+        assert(used < outSize);
+        message += length;
+    }
+
+    out[used] = '\0';
+}
+
+static void AssertRoundTrip(const keyDictionary_t *dictionary, const char *message, const char *expected)
+{
+    char compact[KEY_DICTIONARY_BUFFER_SIZE];
+    char expanded[KEY_DICTIONARY_BUFFER_SIZE];
+
+    size_t length = keyDictionary_Compact(dictionary, message, compact, sizeof(compact));
+    assert(length == strlen(expected));
+    assert(strcmp(compact, expected) == 0);
+
+    Expand(dictionary, compact, expanded, sizeof(expanded));
+    assert(strcmp(expanded, message) == 0);
+}
+
+static void TestMapUnmap(void)
+{
+    // Keys are replaced, values, spacing and keys not in the dictionary are kept
+    AssertRoundTrip(&testDictionary, "{\"temperature\":23.5,\"humidity\":41}", "{\"t\":23.5,\"h\":41}");
+    AssertRoundTrip(&testDictionary, "{\"temperature\": 23.5, \"rssi\": -52}", "{\"t\": 23.5, \"rssi\": -52}");
+
+    // String values that look like keys are not keys
+    AssertRoundTrip(&testDictionary, "{\"pressure\":\"temperature\",\"note\":\"a \\\"humidity\\\": b\"}",
+                    "{\"p\":\"temperature\",\"note\":\"a \\\"humidity\\\": b\"}");
+
+    // Keys of nested objects are replaced too
+    AssertRoundTrip(&testDictionary, "{\"env\":{\"humidity\":41,\"pressure\":101.3}}",
+                    "{\"env\":{\"h\":41,\"p\":101.3}}");
+}
+
+static void TestFullKeys(void)
+{
+    char compact[KEY_DICTIONARY_BUFFER_SIZE];
+
+    // Nothing to replace
+    assert(keyDictionary_Compact(&testDictionary, "{\"rssi\":-52}", compact, sizeof(compact)) == 0);
+
+    // A key that is already a short key would be expanded by the cloud
+    assert(keyDictionary_Compact(&testDictionary, "{\"temperature\":23.5,\"t\":1}", compact,
+                                 sizeof(compact)) == 0);
+
+    // Too small for the compacted message
+    const char *message = "{\"temperature\":23.5,\"humidity\":41}";
+    assert(keyDictionary_Compact(&testDictionary, message, compact, strlen("{\"t\":23.5,\"h\":41}")) == 0);
+    assert(keyDictionary_Compact(&testDictionary, message, compact, strlen("{\"t\":23.5,\"h\":41}") + 1) > 0);
+
+    // No dictionary selected by the device twin
+    const char *dictionaryId = NULL;
+    assert(keyDictionary_CompactMessage(message, &dictionaryId) == NULL);
+    assert(dictionaryId == NULL);
+}
+
+static void TestValidate(void)
+{
+    assert(keyDictionary_Validate(&testDictionary) == NULL);
+
+    static const keyDictionaryEntry_t unsorted[] = {{"pressure", "p"}, {"humidity", "h"}};
+    static const keyDictionaryEntry_t notShorter[] = {{"hum", "hum"}};
+    static const keyDictionaryEntry_t tooLong[] = {{"temperature", "temp"}};
+    static const keyDictionaryEntry_t duplicate[] = {{"humidity", "h"}, {"hysteresis", "h"}};
+    static const keyDictionaryEntry_t shortIsKey[] = {{"p", "x"}, {"pressure", "p"}};
+
+    const keyDictionary_t broken[] = {
+        {"u", unsorted, COUNT_OF(unsorted)},
+        {"n", notShorter, COUNT_OF(notShorter)},
+        {"l", tooLong, COUNT_OF(tooLong)},
+        {"d", duplicate, COUNT_OF(duplicate)},
+        {"k", shortIsKey, COUNT_OF(shortIsKey)},
+    };
+    for (size_t i = 0; i < COUNT_OF(broken); i++) {
+        assert(keyDictionary_Validate(&broken[i]) != NULL);
+    }
+
+    // The published dictionaries must stay valid and their ids fit the twin setting
+    for (size_t i = 0; i < keyDictionaryCount; i++) {
+        assert(keyDictionary_Validate(&keyDictionaries[i]) == NULL);
+        assert(strlen(keyDictionaries[i].id) < KEY_DICTIONARY_ID_MAX_LENGTH);
+    }
+}
+
+static void TestPublishedDictionary(void)
+{
+    AssertRoundTrip(&keyDictionaries[0], "{\"wifiRssi\":-52,\"memoryHighWaterKB\":212}",
+                    "{\"wR\":-52,\"mH\":212}");
+}
+
+int main(void)
+{
+    TestMapUnmap();
+    TestFullKeys();
+    TestValidate();
+    TestPublishedDictionary();
+
+    printf("key_dictionary_test: passed\n");
+    return 0;
+}
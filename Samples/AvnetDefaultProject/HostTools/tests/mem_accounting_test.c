@@ -0,0 +1,169 @@
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  mem_accounting_test: Unit tests for the per module heap accounting (avnet/mem_accounting.c)
+//
+//  Allocations are made through the accounting allocator and the breakdown is read back from
+//  the getHeapStats direct method, the way the cloud sees it.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+// The checks are asserts, keep them in Release builds
+#undef NDEBUG
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mem_accounting.h"
+
+/// <summary>
+///     Call getHeapStats and return the response, free it with json_value_free()
+/// </summary>
+static JSON_Value *GetHeapStats(const char *payload)
+{
+    JSON_Value *payloadValue = (payload != NULL) ? json_parse_string(payload) : NULL;
+    char *response = NULL;
+
+    assert(dmGetHeapStatsHandlerFunction(json_value_get_object(payloadValue), 0, &response) == 200);
+    json_value_free(payloadValue);
+
+    JSON_Value *responseValue = json_parse_string(response);
+    assert(responseValue != NULL);
+    free(response);
+    return responseValue;
+}
+
+static double TagStat(JSON_Value *stats, const char *tag, const char *field)
+{
+    char key[64];
+    snprintf(key, sizeof(key), "tags.%s.%s", tag, field);
+    return json_object_dotget_number(json_value_get_object(stats), key);
+}
+
+static double SizeClass(JSON_Value *stats, const char *tag, size_t sizeClass)
+{
+    char key[64];
+    snprintf(key, sizeof(key), "tags.%s.sizeClasses", tag);
+    return json_array_get_number(json_object_dotget_array(json_value_get_object(stats), key), sizeClass);
+}
+
+static void TestTags(void)
+{
+    memAcct_Init();
+
+    void *small = memAcct_Malloc(MEM_TAG_TELEMETRY, 100);
+    void *large = memAcct_Malloc(MEM_TAG_TELEMETRY, 5000);
+    void *node = memAcct_Malloc(MEM_TAG_RESEND_LIST, 16);
+    void *unknown = memAcct_Malloc(MEM_TAG_COUNT + 3, 17);
+    assert((small != NULL) && (large != NULL) && (node != NULL) && (unknown != NULL));
+
+    // Allocations are 8 byte aligned and usable
+    assert(((uintptr_t)large % 8) == 0);
+    memset(large, 0x55, 5000);
+
+    memAcct_Free(small);
+    memAcct_Free(NULL);
+
+    JSON_Value *stats = GetHeapStats(NULL);
+    assert(TagStat(stats, "Telemetry", "live") == 5000);
+    assert(TagStat(stats, "Telemetry", "peak") == 5100);
+    assert(TagStat(stats, "Telemetry", "allocs") == 2);
+    assert(TagStat(stats, "Telemetry", "frees") == 1);
+
+    // Size classes: <=16, <=32, <=64, <=128, ... >4K
+    assert(SizeClass(stats, "Telemetry", 3) == 1);
+    assert(SizeClass(stats, "Telemetry", MEM_ACCT_SIZE_CLASSES - 1) == 1);
+    assert(SizeClass(stats, "ResendList", 0) == 1);
+
+    // Tags out of range are charged to Other
+    assert(TagStat(stats, "Other", "live") == 17);
+    assert(SizeClass(stats, "Other", 1) == 1);
+
+    assert(json_object_get_number(json_value_get_object(stats), "trackedPeak") >=
+           json_object_get_number(json_value_get_object(stats), "trackedLive"));
+    json_value_free(stats);
+
+    memAcct_Free(large);
+    memAcct_Free(node);
+    memAcct_Free(unknown);
+}
+
+static void TestResetPeaks(void)
+{
+    memAcct_Init();
+
+    void *buffer = memAcct_Malloc(MEM_TAG_M4, 1024);
+    memAcct_Free(buffer);
+    buffer = memAcct_Malloc(MEM_TAG_M4, 256);
+
+    // The response carries the peaks being reset, the next one starts from the live bytes
+    JSON_Value *stats = GetHeapStats("{\"resetPeaks\":true}");
+    assert(TagStat(stats, "M4", "peak") == 1024);
+    json_value_free(stats);
+
+    stats = GetHeapStats(NULL);
+    assert(TagStat(stats, "M4", "peak") == 256);
+    assert(TagStat(stats, "M4", "live") == 256);
+    json_value_free(stats);
+
+    memAcct_Free(buffer);
+}
+
+static void TestParsonAndUntracked(void)
+{
+    memAcct_Init();
+
+    // parson allocates through the accounting once it's installed
+    JSON_Value *value = json_parse_string("{\"wifiRssi\":-52,\"status\":\"ok\"}");
+    JSON_Value *stats = GetHeapStats(NULL);
+    assert(TagStat(stats, "Parson", "allocs") > 0);
+    json_value_free(stats);
+    json_value_free(value);
+
+    // Memory from malloc() is refused and the counts are left alone
+    uint64_t *untracked = calloc(4, sizeof(uint64_t));
+    memAcct_Free(&untracked[1]);
+    free(untracked);
+
+    stats = GetHeapStats(NULL);
+    assert(TagStat(stats, "Other", "frees") == 0);
+    json_value_free(stats);
+}
+
+int main(void)
+{
+    TestTags();
+    TestResetPeaks();
+    TestParsonAndUntracked();
+
+    printf("mem_accounting_test: passed\n");
+    return 0;
+}
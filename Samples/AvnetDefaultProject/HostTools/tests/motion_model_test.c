@@ -0,0 +1,195 @@
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  motion_model_test: Unit tests for the AvnetAdvancedDemo motion classifier
+//                     (AvnetAdvancedDemo/HighLevelExampleApp/motion_model.c)
+//
+//  A two class model is built in memory in the model file format, parsed, and used to classify
+//  a still and a shaking window.  Damaged copies of it must be rejected, and the model shipped
+//  with the sample (MOTION_MODEL_DEFAULT_PATH) must load.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+// The checks are asserts, keep them in Release builds
+#undef NDEBUG
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "motion_model.h"
+
+#define WINDOW_SAMPLES 52
+#define TEST_NODES 3
+
+static uint8_t modelFile[MOTION_MODEL_MAX_SIZE];
+
+/// <summary>
+///     Write a model that splits on the acceleration standard deviation: q <= 0 is "still",
+///     anything above is "moving".  Returns the file length.
+/// </summary>
+static size_t BuildModel(const motionNode_t *nodes, int nodeCount)
+{
+    static const char classNames[2][MOTION_CLASS_NAME_SIZE] = {"still", "moving"};
+    size_t length = 0;
+
+    memcpy(&modelFile[length], MOTION_MODEL_MAGIC, 4);
+    modelFile[4] = MOTION_FEATURE_COUNT;
+    modelFile[5] = 2;
+    modelFile[6] = (uint8_t)nodeCount;
+    modelFile[7] = 0;
+    length = MOTION_MODEL_HEADER_SIZE;
+
+    // accelStd from 0 g in 0.001 g steps, the other features are unused
+    for (int i = 0; i < MOTION_FEATURE_COUNT; i++) {
+        float offset = 0.0f;
+        memcpy(&modelFile[length], &offset, sizeof(offset));
+        length += sizeof(offset);
+    }
+    for (int i = 0; i < MOTION_FEATURE_COUNT; i++) {
+        float scale = 0.001f;
+        memcpy(&modelFile[length], &scale, sizeof(scale));
+        length += sizeof(scale);
+    }
+
+    memcpy(&modelFile[length], classNames, sizeof(classNames));
+    length += sizeof(classNames);
+
+    for (int i = 0; i < nodeCount; i++) {
+        modelFile[length++] = (uint8_t)nodes[i].feature;
+        modelFile[length++] = (uint8_t)nodes[i].threshold;
+        modelFile[length++] = nodes[i].left;
+        modelFile[length++] = nodes[i].right;
+    }
+
+    uint32_t checksum = motionModel_Checksum(modelFile, length);
+    memcpy(&modelFile[length], &checksum, sizeof(checksum));
+    return length + sizeof(checksum);
+}
+
+static const motionNode_t splitNodes[TEST_NODES] = {
+    {MOTION_FEATURE_ACCEL_STD, -118, 1, 2},     // accelStd <= 0.010 g
+    {MOTION_NODE_LEAF, 0, 230, 0},
+    {MOTION_NODE_LEAF, 1, 200, 0},
+};
+
+static int ClassifyWindow(const motionModel_t *model, float shake, uint8_t *confidence)
+{
+    motionSample_t window[WINDOW_SAMPLES];
+    float features[MOTION_FEATURE_COUNT];
+    int8_t quantized[MOTION_FEATURE_COUNT];
+
+    // Flat on the table, plus a shake along Z
+    for (int i = 0; i < WINDOW_SAMPLES; i++) {
+        window[i] = (motionSample_t){.ax = 0.0f, .ay = 0.0f, .az = 1.0f + ((i % 2) ? shake : -shake),
+                                     .gx = 0.0f, .gy = 0.0f, .gz = 0.0f};
+    }
+
+    motionModel_Features(window, WINDOW_SAMPLES, features);
+    assert(fabsf(features[MOTION_FEATURE_ACCEL_MEAN] - 1.0f) < 1e-5f);
+    assert(fabsf(features[MOTION_FEATURE_ACCEL_STD] - shake) < 1e-3f);
+    assert(fabsf(features[MOTION_FEATURE_ACCEL_RANGE] - (2.0f * shake)) < 1e-5f);
+    assert(fabsf(features[MOTION_FEATURE_TILT]) < 1e-3f);
+
+    motionModel_Quantize(model, features, quantized);
+    return motionModel_Classify(model, quantized, confidence);
+}
+
+static void TestClassify(void)
+{
+    motionModel_t model;
+    size_t length = BuildModel(splitNodes, TEST_NODES);
+
+    assert(motionModel_Parse(&model, modelFile, length) == NULL);
+    assert((model.classCount == 2) && (model.nodeCount == TEST_NODES));
+    assert(strcmp(model.className[1], "moving") == 0);
+
+    uint8_t confidence;
+    assert(ClassifyWindow(&model, 0.0f, &confidence) == 0);
+    assert(confidence == 230);
+    assert(ClassifyWindow(&model, 0.2f, &confidence) == 1);
+    assert(confidence == 200);
+
+    // Features outside the trained range clamp, NAN from a failed read is the bottom of it
+    float features[MOTION_FEATURE_COUNT] = {-5.0f, 1000.0f, NAN};
+    int8_t quantized[MOTION_FEATURE_COUNT];
+    motionModel_Quantize(&model, features, quantized);
+    assert((quantized[0] == -128) && (quantized[1] == 127) && (quantized[2] == -128));
+}
+
+static void TestRejects(void)
+{
+    motionModel_t model;
+    size_t length = BuildModel(splitNodes, TEST_NODES);
+
+    assert(strcmp(motionModel_Parse(&model, modelFile, length - 1), "wrong length") == 0);
+
+    modelFile[MOTION_MODEL_HEADER_SIZE + 1] ^= 0x01;
+    assert(strcmp(motionModel_Parse(&model, modelFile, length), "checksum mismatch") == 0);
+
+    modelFile[0] = 'X';
+    assert(strcmp(motionModel_Parse(&model, modelFile, length), "not a motion model") == 0);
+
+    // A child before its parent could loop forever
+    static const motionNode_t loop[TEST_NODES] = {
+        {MOTION_FEATURE_ACCEL_STD, 0, 1, 2},
+        {MOTION_FEATURE_ACCEL_STD, 0, 0, 2},
+        {MOTION_NODE_LEAF, 0, 255, 0},
+    };
+    length = BuildModel(loop, TEST_NODES);
+    assert(strcmp(motionModel_Parse(&model, modelFile, length), "bad split node") == 0);
+
+    static const motionNode_t badLeaf[1] = {{MOTION_NODE_LEAF, 2, 255, 0}};
+    length = BuildModel(badLeaf, 1);
+    assert(strcmp(motionModel_Parse(&model, modelFile, length), "leaf class out of range") == 0);
+}
+
+static void TestShippedModel(void)
+{
+    static uint8_t data[MOTION_MODEL_MAX_SIZE + 1];
+    motionModel_t model;
+
+    FILE *file = fopen(MOTION_MODEL_DEFAULT_PATH, "rb");
+    assert(file != NULL);
+    size_t length = fread(data, 1, sizeof(data), file);
+    fclose(file);
+
+    assert(motionModel_Parse(&model, data, length) == NULL);
+}
+
+int main(void)
+{
+    TestClassify();
+    TestRejects();
+    TestShippedModel();
+
+    printf("motion_model_test: passed\n");
+    return 0;
+}
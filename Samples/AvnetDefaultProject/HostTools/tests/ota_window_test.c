@@ -0,0 +1,154 @@
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  ota_window_test: Unit tests for the traffic aware OTA window selection
+//                   (avnet/deferred_updates.c, OTA_TRAFFIC_AWARE_DEFERRAL)
+//
+//  The selection is static, so deferred_updates.c is included here rather than compiled on its
+//  own.  Each test fills the activity histogram relative to the current UTC hour and checks the
+//  hour and deferral the selection picks.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+// The checks are asserts, keep them in Release builds
+#undef NDEBUG
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../../HighLevelExampleApp/avnet/deferred_updates.c"
+
+typedef struct {
+    int delay;
+    int hour;
+    float score;
+    struct tm now;
+} selection_t;
+
+/// <summary>
+///     Run the selection within one minute of the wall clock, so the expected delay can be
+///     worked out from the same time
+/// </summary>
+static selection_t Select(int maxDeferralMinutes)
+{
+    selection_t selection;
+    time_t before, after;
+
+    do {
+        before = time(NULL);
+        selection.delay = otaActivity_SelectWindow(maxDeferralMinutes, &selection.hour, &selection.score);
+        after = time(NULL);
+    } while ((before / 60) != (after / 60));
+
+    memcpy(&selection.now, gmtime(&before), sizeof(struct tm));
+    return selection;
+}
+
+static otaActivityBucket_t *Bucket(int hoursFromNow)
+{
+    time_t now = time(NULL);
+    return &otaActivity.bucket[(gmtime(&now)->tm_hour + hoursFromNow) % OTA_ACTIVITY_HOURS];
+}
+
+static void SetHistory(float telemetry)
+{
+    memset(&otaActivity, 0, sizeof(otaActivity));
+    for (int i = 0; i < OTA_ACTIVITY_HOURS; i++) {
+        otaActivity.bucket[i].avgTelemetry = telemetry;
+        otaActivity.bucket[i].daysObserved = 3;
+    }
+}
+
+static void TestNoHistory(void)
+{
+    memset(&otaActivity, 0, sizeof(otaActivity));
+
+    // Nothing known, apply now
+    selection_t selection = Select(24 * 60);
+    assert(selection.delay == 0);
+    assert(selection.score < 0.0f);
+    assert(selection.hour == selection.now.tm_hour);
+}
+
+static void TestQuietestHour(void)
+{
+    SetHistory(120.0f);
+    Bucket(3)->avgTelemetry = 10.0f;
+
+    // Deferred to the top of the quiet hour
+    selection_t selection = Select(24 * 60);
+    assert(selection.hour == (selection.now.tm_hour + 3) % OTA_ACTIVITY_HOURS);
+    assert(selection.delay == (3 * 60) - selection.now.tm_min);
+    assert(selection.score == 10.0f);
+
+    // Out of reach of the deferral limit, the best hour within it wins
+    Bucket(1)->avgTelemetry = 60.0f;
+    selection = Select(90);
+    assert(selection.hour == (selection.now.tm_hour + 1) % OTA_ACTIVITY_HOURS);
+    assert(selection.delay == 60 - selection.now.tm_min);
+
+    // Hours never observed are skipped however quiet they look
+    Bucket(1)->daysObserved = 0;
+    selection = Select(90);
+    assert(selection.delay == 0);
+    assert(selection.score == 120.0f);
+}
+
+static void TestWeights(void)
+{
+    // Direct methods and a backed up resend queue count against an hour
+    SetHistory(50.0f);
+    Bucket(1)->avgTelemetry = 20.0f;
+    Bucket(1)->avgDirectMethods = 4.0f;
+    Bucket(2)->avgTelemetry = 30.0f;
+    Bucket(2)->avgQueueDepth = 4.0f;
+    Bucket(3)->avgTelemetry = 45.0f;
+
+    selection_t selection = Select(24 * 60);
+    assert(selection.hour == (selection.now.tm_hour + 3) % OTA_ACTIVITY_HOURS);
+    assert(otaActivity_Score(Bucket(1)) == 20.0f + (4.0f * OTA_DIRECT_METHOD_WEIGHT));
+    assert(otaActivity_Score(Bucket(2)) == 30.0f + (4.0f * OTA_QUEUE_DEPTH_WEIGHT));
+
+    // Ties go to the earliest hour, now when the current hour is as quiet as any
+    SetHistory(50.0f);
+    selection = Select(24 * 60);
+    assert(selection.delay == 0);
+    assert(selection.hour == selection.now.tm_hour);
+}
+
+int main(void)
+{
+    TestNoHistory();
+    TestQuietestHour();
+    TestWeights();
+
+    printf("ota_window_test: passed\n");
+    return 0;
+}
@@ -0,0 +1,283 @@
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  pipeline_test: Unit tests for the staged telemetry pipeline (common/telemetry_pipeline.c)
+//
+//  The recording stages below append each call to a trace, the tests compare the trace with
+//  the order the pipeline must call its stages in: filters in table order, then the aggregate
+//  stage, and on a flush drain, encode and send, one message at a time.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+// The checks are asserts, keep them in Release builds
+#undef NDEBUG
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "telemetry_pipeline.h"
+
+#define RECORD_CAPACITY 2
+
+static char trace[1024];
+
+static void Record(const char *tag, const char *event, const char *detail)
+{
+    size_t used = strlen(trace);
+    snprintf(&trace[used], sizeof(trace) - used, "%s%s:%s ", tag, event, detail);
+}
+
+// Context of every recording stage, tag tells the pipelines apart in the trace
+typedef struct {
+    const char *tag;
+    size_t count;
+    pipelineSample_t samples[RECORD_CAPACITY];
+    bool retry;
+} recordStage_t;
+
+// Doubles the value
+static bool ScaleAccept(void *context, pipelineSample_t *sample)
+{
+    Record(((recordStage_t *)context)->tag, "scale", sample->key);
+    sample->value *= 2.0f;
+    return true;
+}
+
+// Drops values over 100
+static bool LimitAccept(void *context, pipelineSample_t *sample)
+{
+    Record(((recordStage_t *)context)->tag, "limit", sample->key);
+    return sample->value <= 100.0f;
+}
+
+// Holds RECORD_CAPACITY samples
+static bool RecordAdd(void *context, const pipelineSample_t *sample)
+{
+    recordStage_t *stage = (recordStage_t *)context;
+    if (stage->count == RECORD_CAPACITY) {
+        Record(stage->tag, "full", sample->key);
+        return false;
+    }
+    Record(stage->tag, "add", sample->key);
+    stage->samples[stage->count++] = *sample;
+    return true;
+}
+
+static size_t RecordDrain(void *context, pipelineSample_t *samples, size_t maxSamples)
+{
+    recordStage_t *stage = (recordStage_t *)context;
+    size_t count = stage->count;
+    char detail[8];
+
+    snprintf(detail, sizeof(detail), "%zu", count);
+    Record(stage->tag, "drain", detail);
+    memcpy(samples, stage->samples, count * sizeof(pipelineSample_t));
+    stage->count = 0;
+    return count;
+}
+
+// One sample per message, "key=value"
+static size_t RecordEncode(void *context, const pipelineSample_t *samples, size_t count,
+                           pipelineMessage_t *message)
+{
+    Record(((recordStage_t *)context)->tag, "encode", samples[0].key);
+    message->length = (uint16_t)snprintf((char *)message->data, sizeof(message->data), "%s=%g",
+                                         samples[0].key, (double)samples[0].value);
+    return 1;
+}
+
+static pipelineSinkResult_t RecordSend(void *context, const pipelineMessage_t *message)
+{
+    recordStage_t *stage = (recordStage_t *)context;
+    Record(stage->tag, stage->retry ? "retry" : "send", (const char *)message->data);
+    return stage->retry ? PIPELINE_SINK_RETRY : PIPELINE_SINK_SENT;
+}
+
+#define RECORD_PIPELINE(stage) \
+    .aggregate = {.name = "record", .add = RecordAdd, .drain = RecordDrain, .context = (stage)}, \
+    .encoder = {.name = "record", .encode = RecordEncode, .context = (stage), .text = true}, \
+    .sink = {.name = "record", .send = RecordSend, .context = (stage)}
+
+static void TestStageOrder(void)
+{
+    static recordStage_t stage = {.tag = ""};
+    static pipelineFilter_t filters[] = {
+        {.name = "scale", .accept = ScaleAccept, .context = &stage},
+        {.name = "limit", .accept = LimitAccept, .context = &stage},
+    };
+    static pipeline_t pipeline = {.name = "record", .filters = filters, .filterCount = 2,
+                                  RECORD_PIPELINE(&stage)};
+    static pipeline_t *table[] = {&pipeline};
+
+    assert(pipeline_Init(table, 1) == ExitCode_Success);
+    trace[0] = '\0';
+
+    // Filters run in order on the value the previous filter passed on, a dropped sample goes
+    // no further
+    pipeline_Push("a", 10.0f, 1000);
+    pipeline_Push("b", 60.0f, 2000);
+    assert(strcmp(trace, "scale:a limit:a add:a scale:b limit:b ") == 0);
+    assert((filters[1].counters.in == 2) && (filters[1].counters.dropped == 1));
+
+    // The stage is full after c, d flushes it and is added again
+    trace[0] = '\0';
+    pipeline_Push("c", 1.0f, 3000);
+    pipeline_Push("d", 2.0f, 4000);
+    assert(strcmp(trace, "scale:c limit:c add:c scale:d limit:d full:d "
+                         "drain:2 encode:a send:a=20 encode:c send:c=2 drain:0 add:d ") == 0);
+
+    // Non finite values stop at the source
+    trace[0] = '\0';
+    pipeline_Push("e", NAN, 5000);
+    assert(trace[0] == '\0');
+    assert(pipeline.source.dropped == 1);
+
+    trace[0] = '\0';
+    pipeline_FlushAll();
+    assert(strcmp(trace, "drain:1 encode:d send:d=4 drain:0 ") == 0);
+    assert((pipeline.sink.counters.out == 3) && (pipeline.queue.dropped == 0));
+
+    pipeline_Cleanup();
+}
+
+static void TestPipelineOrder(void)
+{
+    static recordStage_t first = {.tag = "1."};
+    static recordStage_t second = {.tag = "2."};
+    static pipelineFilter_t firstFilters[] = {{.name = "limit", .accept = LimitAccept, .context = &first}};
+    static pipeline_t firstPipeline = {.name = "first", .filters = firstFilters, .filterCount = 1,
+                                       RECORD_PIPELINE(&first)};
+    static pipeline_t secondPipeline = {.name = "second", RECORD_PIPELINE(&second)};
+    static pipeline_t *table[] = {&firstPipeline, &secondPipeline};
+
+    assert(pipeline_Init(table, 2) == ExitCode_Success);
+    trace[0] = '\0';
+
+    // Each sample goes through every pipeline in table order, a filter only affects its own
+    pipeline_Push("a", 500.0f, 1000);
+    pipeline_Push("b", 5.0f, 2000);
+    pipeline_FlushAll();
+    assert(strcmp(trace, "1.limit:a 2.add:a 1.limit:b 1.add:b 2.add:b "
+                         "1.drain:1 1.encode:b 1.send:b=5 1.drain:0 "
+                         "2.drain:2 2.encode:a 2.send:a=500 2.encode:b 2.send:b=5 2.drain:0 ") == 0);
+
+    pipeline_Cleanup();
+}
+
+static void TestQueue(void)
+{
+    static recordStage_t stage = {.tag = "", .retry = true};
+    static pipeline_t pipeline = {.name = "queue", RECORD_PIPELINE(&stage)};
+    static pipeline_t *table[] = {&pipeline};
+    static const char *keys[] = {"a", "b", "c", "d", "e", "f"};
+
+    assert(pipeline_Init(table, 1) == ExitCode_Success);
+
+    // While the sink asks to retry, each flush tries the oldest message and keeps the rest
+    for (size_t i = 0; i < PIPELINE_QUEUE_DEPTH + 1; i++) {
+        pipeline_Push(keys[i], (float)i, i * 1000);
+        pipeline_FlushAll();
+    }
+    assert(pipeline.queueCount == PIPELINE_QUEUE_DEPTH);
+    assert(pipeline.queue.dropped == 1);
+    assert(pipeline.sink.counters.out == 0);
+
+    // The newest messages go out oldest first once the sink is ready
+    stage.retry = false;
+    trace[0] = '\0';
+    pipeline_FlushAll();
+    assert(strcmp(trace, "drain:0 send:b=1 send:c=2 send:d=3 send:e=4 ") == 0);
+    assert((pipeline.queueCount == 0) && (pipeline.sink.counters.out == PIPELINE_QUEUE_DEPTH));
+
+    pipeline_Cleanup();
+}
+
+static pipelineMessage_t lastMessage;
+
+static pipelineSinkResult_t CaptureSend(void *context, const pipelineMessage_t *message)
+{
+    lastMessage = *message;
+    return PIPELINE_SINK_SENT;
+}
+
+static void TestBuiltInStages(void)
+{
+    static const char *const selected[] = {"wifiRssi", "memoryHighWaterKB"};
+    static pipelineKeySelect_t select = {.keys = selected, .keyCount = 2};
+    static pipelineDeadband_t deadband = {.deadband = 1.0f};
+    static pipelineReduce_t mean = {.mode = PIPELINE_REDUCE_MEAN};
+    static pipelineFilter_t filters[] = {PIPELINE_KEY_SELECT_FILTER(&select),
+                                         PIPELINE_DEADBAND_FILTER(&deadband)};
+    static pipeline_t pipeline = {
+        .name = "builtIn",
+        .filters = filters, .filterCount = 2,
+        .aggregate = PIPELINE_REDUCE_STAGE(&mean),
+        .encoder = PIPELINE_JSON_ENCODER,
+        .sink = {.name = "capture", .send = CaptureSend},
+    };
+    static pipeline_t *table[] = {&pipeline};
+
+    assert(pipeline_Init(table, 1) == ExitCode_Success);
+
+    pipeline_Push("wifiRssi", -50.0f, 1000);
+    pipeline_Push("wifiRssi", -50.5f, 2000);        // Inside the deadband
+    pipeline_Push("wifiFrequency", 2437.0f, 2000);  // Not selected
+    pipeline_Push("wifiRssi", -52.0f, 3000);
+    pipeline_Push("memoryHighWaterKB", 212.0f, 3000);
+    pipeline_FlushAll();
+
+    assert(lastMessage.text);
+    assert(strcmp((const char *)lastMessage.data, "{\"wifiRssi\":-51,\"memoryHighWaterKB\":212}") == 0);
+    assert((filters[0].counters.dropped == 1) && (filters[1].counters.dropped == 1));
+
+    pipeline_Cleanup();
+
+    // A text only sink can't take binary messages
+    static pipeline_t mismatched = {
+        .name = "mismatched",
+        .aggregate = PIPELINE_REDUCE_STAGE(&mean),
+        .encoder = PIPELINE_BINARY_ENCODER,
+        .sink = {.name = "capture", .send = CaptureSend, .textOnly = true},
+    };
+    static pipeline_t *badTable[] = {&mismatched};
+    assert(pipeline_Init(badTable, 1) == ExitCode_Init_TelemetryPipeline);
+}
+
+int main(void)
+{
+    TestStageOrder();
+    TestPipelineOrder();
+    TestQueue();
+    TestBuiltInStages();
+
+    printf("pipeline_test: passed\n");
+    return 0;
+}
@@ -0,0 +1,205 @@
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  rules_engine_test: Unit tests for the rules engine parser (avnet/rules_engine.c)
+//
+//  The compiler is static, so rules_engine.c is included here rather than compiled on its own.
+//  The sensor registry is compiled in with ENABLE_SENSOR_REGISTRY (see CMakeLists.txt) and
+//  provides the wifiRssi, wifiFrequency and memoryHighWaterKB keys, the real time application
+//  channels (gpsNumSats, ...) come from schema.h with ENABLE_GROVE_GPS_RT_APP.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+// The checks are asserts, keep them in Release builds
+#undef NDEBUG
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../../HighLevelExampleApp/avnet/rules_engine.c"
+
+#define COUNT_OF(a) (sizeof(a) / sizeof((a)[0]))
+
+// The registry's read functions live in main.c and user_interface.c, the tests set the values
+bool readWifiSensor(void *thisSensor)
+{
+    return false;
+}
+
+bool readMemorySensor(void *thisSensor)
+{
+    return false;
+}
+
+static char status[96];
+
+static int Compile(const char *text)
+{
+    return CompileRules(text, status, sizeof(status));
+}
+
+static void AssertCode(const rule_t *rule, const ruleOpcode_t *ops, int count)
+{
+    assert(rule->codeLength == count);
+    for (int i = 0; i < count; i++) {
+        assert(rule->code[i].op == ops[i]);
+    }
+}
+
+static void TestPrecedence(void)
+{
+    // * binds tighter than +, comparisons tighter than &&, && tighter than ||
+    assert(Compile("1 + 2 * 3 > 6 || 0 && 1 -> alert(a)") == 1);
+    static const ruleOpcode_t expected[] = {
+        RULE_OP_CONST, RULE_OP_CONST, RULE_OP_CONST, RULE_OP_MUL, RULE_OP_ADD, RULE_OP_CONST, RULE_OP_GT,
+        RULE_OP_CONST, RULE_OP_CONST, RULE_OP_AND, RULE_OP_OR};
+    AssertCode(&compiledRules[0], expected, COUNT_OF(expected));
+    assert(compiledRules[0].code[0].constant == 1.0f);
+    assert(compiledRules[0].code[2].constant == 3.0f);
+    assert(strcmp(status, "1 rules") == 0);
+
+    // Left associative, parentheses and unary operators
+    assert(Compile("10 - 4 - 3 == -(2 - 5) && !0 -> alert(b)") == 1);
+    static const ruleOpcode_t grouped[] = {
+        RULE_OP_CONST, RULE_OP_CONST, RULE_OP_SUB, RULE_OP_CONST, RULE_OP_SUB,
+        RULE_OP_CONST, RULE_OP_CONST, RULE_OP_SUB, RULE_OP_NEG, RULE_OP_EQ,
+        RULE_OP_CONST, RULE_OP_NOT, RULE_OP_AND};
+    AssertCode(&compiledRules[0], grouped, COUNT_OF(grouped));
+    assert(RunRule(&compiledRules[0]));
+}
+
+static void TestKeysAndActions(void)
+{
+    assert(Compile("wifiRssi < -80 -> alert(weakSignal), gpio(appLed); "
+                   "rate(memoryHighWaterKB) > 10 -> sensorPeriod(wifi, 500), telemetryPeriod(5);"
+                   "gpsNumSats < 4 -> alert(gpsFixLost);") == 3);
+    assert(strcmp(status, "3 rules") == 0);
+
+    // Registry outputs and real time application channels resolve to their indexes
+    const rule_t *rule = &compiledRules[0];
+    assert((rule->code[0].op == RULE_OP_LOAD) &&
+           (rule->code[0].outputIndex == sensorRegistry_FindOutput("wifiRssi")));
+    assert((rule->actionCount == 2) && (rule->actions[0].type == RULE_ACTION_ALERT) &&
+           (strcmp(rule->actions[0].name, "weakSignal") == 0));
+    assert((rule->actions[1].type == RULE_ACTION_GPIO) &&
+           (strcmp(twinArray[rule->actions[1].target].twinKey, "appLed") == 0));
+
+    rule = &compiledRules[1];
+    assert((rule->code[0].op == RULE_OP_RATE) && (rule->rateCount == 1) &&
+           (rule->code[0].outputIndex == sensorRegistry_FindOutput("memoryHighWaterKB")));
+    assert((rule->actions[0].type == RULE_ACTION_SENSOR_PERIOD) &&
+           (rule->actions[0].target == sensorRegistry_FindSensor("wifi")) && (rule->actions[0].value == 500));
+    assert((rule->actions[1].type == RULE_ACTION_TELEMETRY_PERIOD) && (rule->actions[1].value == 5));
+
+    rule = &compiledRules[2];
+    assert((rule->code[0].op == RULE_OP_LOAD) &&
+           (rule->code[0].outputIndex == RULE_CHANNEL_INDEX(FindChannel("gpsNumSats"))));
+
+    // Empty rule text and empty rules
+    assert(Compile("") == 0);
+    assert(Compile(" ; ;") == 0);
+    assert(strcmp(status, "0 rules") == 0);
+}
+
+static void TestErrors(void)
+{
+    static const struct {
+        const char *text;
+        const char *status;
+    } errors[] = {
+        {"wifiRssi < -80",                      "error: rule 1: expected '->' at ''"},
+        {"1 -> alert(a); noSuchKey > 1 -> alert(b)", "error: rule 2: unknown key at 'noSuchKey > 1 ->'"},
+        {"1 -> beep(a)",                        "error: rule 1: unknown action at 'beep(a)'"},
+        {"1 -> gpio(wifiRssi)",                 "error: rule 1: expected a GPIO twin key at 'wifiRssi)'"},
+        {"1 -> sensorPeriod(wifi, 1)",          "error: rule 1: expected a period in ms at '1)'"},
+        {"1 -> telemetryPeriod(0)",             "error: rule 1: expected a period in seconds at '0)'"},
+        {"(1 -> alert(a)",                      "error: rule 1: expected ')' at '-> alert(a)'"},
+        {"1 < -> alert(a)",                     "error: rule 1: expected a value at '-> alert(a)'"},
+        {"1 # 2 -> alert(a)",                   "error: rule 1: unexpected character at '# 2 -> alert(a)'"},
+        {"1 -> alert(a) alert(b)",              "error: rule 1: expected ';' at 'alert(b)'"},
+        {"rate(wifiRssi) + rate(wifiRssi) + rate(wifiRssi) > 0 -> alert(a)",
+                                                "error: rule 1: too many rate()s at 'wifiRssi) > 0 ->'"},
+        {"1 -> alert(a), alert(b), alert(c), alert(d)", "error: rule 1: too many actions at 'alert(d)'"},
+        {"1 -> alert(a);1 -> alert(a);1 -> alert(a);1 -> alert(a);1 -> alert(a);1 -> alert(a);"
+         "1 -> alert(a);1 -> alert(a);1 -> alert(a)", "error: rule 9: too many rules at '1 -> alert(a)'"},
+        {"1+1+1+1+1+1+1+1+1+1+1+1+1 > 0 -> alert(a)", "error: rule 1: expression too long at '> 0 -> alert(a)'"},
+        {"1+(1+(1+(1+(1+(1+(1+(1+1))))))) > 0 -> alert(a)",
+                                                "error: rule 1: expression too deep at '))))))) > 0 -> a'"},
+    };
+
+    bool failed = false;
+    for (size_t i = 0; i < COUNT_OF(errors); i++) {
+        if (Compile(errors[i].text) != -1 || strcmp(status, errors[i].status) != 0) {
+            fprintf(stderr, "%s\n    got \"%s\"\n", errors[i].text, status);
+            failed = true;
+        }
+    }
+    assert(!failed);
+}
+
+static void TestTwinUpdate(void)
+{
+    twin_t rulesTwin = {.twinKey = "rules"};
+    JSON_Value *desired = json_parse_string("{\"rules\":\"gpsNumSats < 4 -> alert(gpsFixLost)\"}");
+
+    setRulesFunction(&rulesTwin, json_value_get_object(desired));
+    json_value_free(desired);
+    assert(strcmp(rulesText, "gpsNumSats < 4 -> alert(gpsFixLost)") == 0);
+    assert(ruleCount == 1);
+
+    // The rule runs on each sample of the channel it uses
+    rulesEngine_Observe("gpsNumSats", 9.0f, 1000);
+    assert(!rules[0].active);
+    rulesEngine_Observe("gpsNumSats", 2.0f, 2000);
+    assert(rules[0].active && (rules[0].triggerCount == 1));
+
+    // A rule that doesn't compile leaves the running rules in place
+    desired = json_parse_string("{\"rules\":\"gpsNumSats < -> alert(gpsFixLost)\"}");
+    setRulesFunction(&rulesTwin, json_value_get_object(desired));
+    json_value_free(desired);
+    assert(strcmp(rulesText, "gpsNumSats < 4 -> alert(gpsFixLost)") == 0);
+    assert((ruleCount == 1) && rules[0].active);
+
+    rulesEngine_Cleanup();
+}
+
+int main(void)
+{
+    assert(sensorRegistry_Init(EventLoop_Create()) == ExitCode_Success);
+
+    TestPrecedence();
+    TestKeysAndActions();
+    TestErrors();
+    TestTwinUpdate();
+
+    sensorRegistry_Cleanup();
+    printf("rules_engine_test: passed\n");
+    return 0;
+}
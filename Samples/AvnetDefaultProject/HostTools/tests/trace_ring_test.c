@@ -0,0 +1,164 @@
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  trace_ring_test: Unit tests for the binary trace ring (common/trace_ring.c)
+//
+//  Records are written with TRACE() and read back through the dumpTrace direct method.  The ring
+//  is compiled in with TRACE_RING_ENTRIES=8 (see CMakeLists.txt) so the tests can wrap it.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+// The checks are asserts, keep them in Release builds
+#undef NDEBUG
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trace_ring.h"
+
+#define MAX_RECORDS 16
+
+static size_t Base64Decode(const char *in, uint8_t *out)
+{
+    static const char table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    uint32_t bits = 0;
+    int bitCount = 0;
+    size_t length = 0;
+
+    for (; (*in != '\0') && (*in != '='); in++) {
+        const char *digit = strchr(table, *in);
+        assert(digit != NULL);
+        bits = (bits << 6) | (uint32_t)(digit - table);
+        bitCount += 6;
+        if (bitCount >= 8) {
+            bitCount -= 8;
+            out[length++] = (uint8_t)(bits >> bitCount);
+        }
+    }
+    return length;
+}
+
+/// <summary>
+///     Call dumpTrace and decode the records, returns the record count
+/// </summary>
+static uint32_t DumpTrace(const char *payload, traceRecord_t *records, uint32_t *written)
+{
+    JSON_Value *payloadValue = json_parse_string(payload);
+    char *response = NULL;
+
+    assert(dmDumpTraceHandlerFunction(json_value_get_object(payloadValue), 0, &response) == 200);
+    json_value_free(payloadValue);
+
+    JSON_Value *responseValue = json_parse_string(response);
+    JSON_Object *responseObject = json_value_get_object(responseValue);
+    assert(responseObject != NULL);
+    assert(json_object_get_number(responseObject, "version") == TRACE_FORMAT_VERSION);
+    assert(json_object_get_number(responseObject, "recordSize") == sizeof(traceRecord_t));
+
+    uint32_t count = (uint32_t)json_object_get_number(responseObject, "records");
+    *written = (uint32_t)json_object_get_number(responseObject, "written");
+
+    static uint8_t data[MAX_RECORDS * sizeof(traceRecord_t) + 3];
+    size_t length = Base64Decode(json_object_get_string(responseObject, "data"), data);
+    assert(length == count * sizeof(traceRecord_t));
+    memcpy(records, data, length);
+
+    json_value_free(responseValue);
+    free(response);
+    return count;
+}
+
+static void TestDump(void)
+{
+    traceRecord_t records[MAX_RECORDS];
+    uint32_t written;
+
+    TRACE(TRACE_EVT_TELEMETRY_SEND, 120, 0);
+    TRACE(TRACE_EVT_TELEMETRY_ACK, 0, 0x1234);
+
+    // The dump adds its own record, the ring isn't full yet so everything is returned
+    assert(DumpTrace("{}", records, &written) == 3);
+    assert(written == 3);
+    assert((records[0].eventId == TRACE_EVT_TELEMETRY_SEND) && (records[0].arg0 == 120));
+    assert((records[1].eventId == TRACE_EVT_TELEMETRY_ACK) && (records[1].arg1 == 0x1234));
+    assert((records[2].eventId == TRACE_EVT_TRACE_DUMP) && (records[2].arg0 == TRACE_RING_ENTRIES));
+    assert((records[0].sequence == 0) && (records[2].sequence == 2));
+    assert(records[1].timestampUs >= records[0].timestampUs);
+}
+
+static void TestWrap(void)
+{
+    traceRecord_t records[MAX_RECORDS];
+    uint32_t written;
+    uint32_t start;
+
+    DumpTrace("{}", records, &start);
+
+    // Overwrite the ring twice, only the newest TRACE_RING_ENTRIES remain, oldest first
+    for (uint32_t i = 0; i < 2 * TRACE_RING_ENTRIES; i++) {
+        TRACE(TRACE_EVT_M4_TX, i, 0);
+    }
+
+    assert(DumpTrace("{\"records\": 4}", records, &written) == 4);
+    assert(written == start + (2 * TRACE_RING_ENTRIES) + 1);
+    for (uint32_t i = 0; i < 3; i++) {
+        assert(records[i].eventId == TRACE_EVT_M4_TX);
+        assert(records[i].arg0 == (2 * TRACE_RING_ENTRIES) - 3 + i);
+        assert(records[i].sequence == (uint16_t)(written - 4 + i));
+    }
+    assert(records[3].eventId == TRACE_EVT_TRACE_DUMP);
+
+    assert(DumpTrace("{}", records, &written) == TRACE_RING_ENTRIES);
+    assert(records[TRACE_RING_ENTRIES - 1].sequence == (uint16_t)(written - 1));
+}
+
+static void TestBadRequest(void)
+{
+    char *response = NULL;
+    JSON_Value *payload = json_parse_string("{\"records\": 0}");
+    assert(dmDumpTraceHandlerFunction(json_value_get_object(payload), 0, &response) == 400);
+    json_value_free(payload);
+
+    payload = json_parse_string("{\"records\": 9}");
+    assert(dmDumpTraceHandlerFunction(json_value_get_object(payload), 0, &response) == 400);
+    json_value_free(payload);
+    assert(response == NULL);
+}
+
+int main(void)
+{
+    TestDump();
+    TestWrap();
+    TestBadRequest();
+
+    printf("trace_ring_test: passed\n");
+    return 0;
+}
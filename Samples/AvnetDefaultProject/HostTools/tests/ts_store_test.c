@@ -0,0 +1,212 @@
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  ts_store_test: Unit tests for the time series store (common/timeseries_store.c)
+//
+//  The store is compiled in with a pool of TS_STORE_BLOCK_COUNT blocks (see CMakeLists.txt) so
+//  the eviction tests can fill it with a few hundred samples.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+// The checks are asserts, keep them in Release builds
+#undef NDEBUG
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "timeseries_store.h"
+
+#define TEST_SAMPLES 120
+
+typedef struct {
+    uint64_t timeMs[TEST_SAMPLES * 8];
+    float value[TEST_SAMPLES * 8];
+    int count;
+} sampleLog_t;
+
+static bool LogSample(uint64_t timeMs, float value, void *context)
+{
+    sampleLog_t *log = (sampleLog_t *)context;
+    log->timeMs[log->count] = timeMs;
+    log->value[log->count] = value;
+    log->count++;
+    return true;
+}
+
+static bool SameBits(float a, float b)
+{
+    return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+// Timestamps with jitter and a gap, values that repeat, change sign, span exponents and include
+// the special values, all must read back bit for bit
+static void TestRoundTrip(void)
+{
+    static const float specials[] = {0.0f, -0.0f, INFINITY, -INFINITY, 1.0e-38f, 3.4e38f};
+    uint64_t timeMs[TEST_SAMPLES];
+    float value[TEST_SAMPLES];
+
+    tsStore_Reset();
+
+    uint64_t t = 1700000000000ULL;
+    for (int i = 0; i < TEST_SAMPLES; i++) {
+
+        t += 1000 + (uint64_t)((i * 7) % 3) - 1;
+        if (i == TEST_SAMPLES / 2) {
+            t += 3600000;
+        }
+        timeMs[i] = t;
+
+        if (i < 20) {
+            value[i] = 21.5f;
+        }
+        else if (i < (20 + (int)(sizeof(specials) / sizeof(specials[0])))) {
+            value[i] = specials[i - 20];
+        }
+        else {
+            value[i] = (float)((i % 2) ? -1 : 1) * (float)i * 0.061f;
+        }
+
+        assert(tsStore_Append("temp", timeMs[i], value[i]));
+    }
+
+    const tsChannel_t *channel = tsStore_GetChannel("temp");
+    assert(channel != NULL);
+    assert(channel->sampleCount == TEST_SAMPLES);
+    assert(channel->evictedCount == 0);
+
+    // Headers plus the bits used, less than the raw 12 bytes a sample for a steady clock
+    uint32_t bytes = tsStore_ChannelBytes(channel);
+    assert(bytes > channel->blockCount * TS_STORE_BLOCK_HEADER_BYTES);
+    assert(bytes <= channel->blockCount * TS_STORE_BLOCK_BYTES);
+    assert(bytes < TEST_SAMPLES * 12);
+
+    static sampleLog_t log;
+    log.count = 0;
+    assert(tsStore_Iterate("temp", 0, UINT64_MAX, LogSample, &log) == TEST_SAMPLES);
+    assert(log.count == TEST_SAMPLES);
+    for (int i = 0; i < TEST_SAMPLES; i++) {
+        assert(log.timeMs[i] == timeMs[i]);
+        assert(SameBits(log.value[i], value[i]));
+    }
+
+    // A range inside the history returns only the samples in it
+    log.count = 0;
+    assert(tsStore_Iterate("temp", timeMs[10], timeMs[19], LogSample, &log) == 10);
+    assert((log.timeMs[0] == timeMs[10]) && (log.timeMs[9] == timeMs[19]));
+
+    // Older samples are refused, equal timestamps are kept
+    assert(!tsStore_Append("temp", timeMs[TEST_SAMPLES - 1] - 1, 1.0f));
+    assert(tsStore_Append("temp", timeMs[TEST_SAMPLES - 1], 1.0f));
+
+    assert(tsStore_GetChannel("missing") == NULL);
+    assert(tsStore_Iterate("missing", 0, UINT64_MAX, LogSample, &log) == 0);
+}
+
+static void TestDownsample(void)
+{
+    tsStore_Reset();
+
+    // Ten samples one second apart, two buckets of five
+    for (int i = 0; i < 10; i++) {
+        assert(tsStore_Append("pressure", (uint64_t)i * 1000, (float)i));
+    }
+
+    tsBucket_t buckets[3];
+    assert(tsStore_Downsample("pressure", 0, 9999, buckets, 2) == 10);
+    assert((buckets[0].count == 5) && (buckets[1].count == 5));
+    assert((buckets[0].min == 0.0f) && (buckets[0].max == 4.0f) && (buckets[0].mean == 2.0f));
+    assert((buckets[1].min == 5.0f) && (buckets[1].max == 9.0f) && (buckets[1].mean == 7.0f));
+
+    // A bucket with no samples has a zero count
+    assert(tsStore_Downsample("pressure", 0, 29999, buckets, 3) == 10);
+    assert((buckets[0].count == 10) && (buckets[1].count == 0) && (buckets[2].count == 0));
+}
+
+// A channel that fills the pool reuses its own oldest blocks, a new channel takes the oldest
+// block of the channel holding the most
+static void TestEviction(void)
+{
+    tsStore_Reset();
+
+    int appended = 0;
+    uint32_t value = 0x3f800000;
+    while (tsStore_GetChannel("accel") == NULL ||
+           tsStore_GetChannel("accel")->evictedCount == 0) {
+
+        // Values with random looking low bits so each block holds few samples
+        value = value * 1103515245u + 12345u;
+        float sample;
+        uint32_t bits = 0x3f800000 | (value & 0x007fffff);
+        memcpy(&sample, &bits, sizeof(sample));
+
+        assert(tsStore_Append("accel", (uint64_t)appended * 10, sample));
+        appended++;
+        assert(appended < TS_STORE_BLOCK_COUNT * TS_STORE_BLOCK_BYTES);
+    }
+
+    const tsChannel_t *accel = tsStore_GetChannel("accel");
+    assert(accel->blockCount == TS_STORE_BLOCK_COUNT);
+    assert(accel->sampleCount + accel->evictedCount == (uint32_t)appended);
+
+    // What's left is the newest samples, in order
+    static sampleLog_t log;
+    log.count = 0;
+    assert(tsStore_Iterate("accel", 0, UINT64_MAX, LogSample, &log) == (int)accel->sampleCount);
+    assert(log.timeMs[0] == (uint64_t)accel->evictedCount * 10);
+    assert(log.timeMs[log.count - 1] == (uint64_t)(appended - 1) * 10);
+
+    uint32_t evictedBefore = accel->evictedCount;
+    assert(tsStore_Append("gyro", 0, 1.0f));
+
+    const tsChannel_t *gyro = tsStore_GetChannel("gyro");
+    assert(gyro->blockCount == 1);
+    assert(accel->blockCount == TS_STORE_BLOCK_COUNT - 1);
+    assert(accel->evictedCount > evictedBefore);
+    assert(accel->sampleCount + accel->evictedCount == (uint32_t)appended);
+
+    log.count = 0;
+    assert(tsStore_Iterate("accel", 0, UINT64_MAX, LogSample, &log) == (int)accel->sampleCount);
+    assert(log.timeMs[0] == (uint64_t)accel->evictedCount * 10);
+
+    tsStore_Reset();
+    assert(tsStore_GetChannel("accel") == NULL);
+}
+
+int main(void)
+{
+    TestRoundTrip();
+    TestDownsample();
+    TestEviction();
+
+    printf("ts_store_test: passed\n");
+    return 0;
+}
@@ -0,0 +1,317 @@
+/*
+
+MIT License
+
+Copyright (c) Avnet Corporation. All rights reserved.
+Author: Brian Willess
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  trace_decode: Convert a trace ring dump into a timeline
+//
+//  Usage: trace_decode [file]     Reads stdin if no file is given
+//
+//  The input can be either
+//
+//  1. The dumpTrace direct method response: {"version": 1, ... "data": "<base64>"}
+//  2. Debug output containing "TRACE <hex>" lines, other lines are ignored
+//
+//  Output is one line per record: time since the first record (ms), time since the previous
+//  record (ms), the record sequence number, the event name and the labeled arguments.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trace_ring.h"
+
+typedef struct {
+    const char *name;
+    const char *arg0;
+    const char *arg1;
+} traceEventName_t;
+
+#define TRACE_EVENT_NAME(id, name, arg0, arg1) {name, arg0, arg1},
+static const traceEventName_t eventNames[TRACE_EVT_COUNT] = {
+    TRACE_EVENT_LIST(TRACE_EVENT_NAME)
+};
+#undef TRACE_EVENT_NAME
+
+static char *readAll(FILE *in, size_t *length);
+static size_t decodeJson(const char *text, traceRecord_t **records);
+static size_t decodeLog(const char *text, traceRecord_t **records);
+static size_t base64Decode(const char *in, size_t inLen, uint8_t *out);
+static int hexValue(char c);
+static void printTimeline(const traceRecord_t *records, size_t count);
+
+int main(int argc, char *argv[])
+{
+    FILE *in = stdin;
+
+    if (argc > 2) {
+        fprintf(stderr, "Usage: %s [file]\n", argv[0]);
+        return 1;
+    }
+
+    if (argc == 2) {
+        in = fopen(argv[1], "rb");
+        if (in == NULL) {
+            fprintf(stderr, "ERROR: Could not open %s\n", argv[1]);
+            return 1;
+        }
+    }
+
+    size_t length;
+    char *text = readAll(in, &length);
+    if (in != stdin) {
+        fclose(in);
+    }
+    if (text == NULL) {
+        fprintf(stderr, "ERROR: Could not read input\n");
+        return 1;
+    }
+
+    traceRecord_t *records = NULL;
+    size_t count = (strstr(text, "\"data\"") != NULL) ? decodeJson(text, &records)
+                                                     : decodeLog(text, &records);
+    free(text);
+
+    if (count == 0) {
+        fprintf(stderr, "ERROR: No trace records found\n");
+        free(records);
+        return 1;
+    }
+
+    printTimeline(records, count);
+    free(records);
+    return 0;
+}
+
+/// <summary>
+///     Read the whole input stream into a null terminated buffer
+/// </summary>
+static char *readAll(FILE *in, size_t *length)
+{
+    size_t size = 64 * 1024;
+    size_t used = 0;
+    char *buffer = malloc(size);
+
+    while (buffer != NULL) {
+        used += fread(&buffer[used], 1, size - used - 1, in);
+        if (used < size - 1) {
+            break;
+        }
+        size *= 2;
+        char *larger = realloc(buffer, size);
+        if (larger == NULL) {
+            free(buffer);
+            return NULL;
+        }
+        buffer = larger;
+    }
+
+    if (buffer != NULL) {
+        buffer[used] = '\0';
+        *length = used;
+    }
+    return buffer;
+}
+
+/// <summary>
+///     Decode the dumpTrace direct method response
+/// </summary>
+static size_t decodeJson(const char *text, traceRecord_t **records)
+{
+    const char *version = strstr(text, "\"version\"");
+    if (version != NULL) {
+        version = strchr(version, ':');
+        if ((version != NULL) && (atoi(version + 1) != TRACE_FORMAT_VERSION)) {
+            fprintf(stderr, "WARNING: Trace format version %d, decoder expects %d\n",
+                    atoi(version + 1), TRACE_FORMAT_VERSION);
+        }
+    }
+
+    // Find the opening quote of the base64 string
+    const char *data = strchr(strstr(text, "\"data\"") + strlen("\"data\""), '"');
+    if (data == NULL) {
+        return 0;
+    }
+    data++;
+
+    const char *end = strchr(data, '"');
+    if (end == NULL) {
+        return 0;
+    }
+
+    size_t dataLength = (size_t)(end - data);
+    uint8_t *bytes = malloc(((dataLength / 4) * 3) + 3);
+    if (bytes == NULL) {
+        return 0;
+    }
+
+    size_t byteCount = base64Decode(data, dataLength, bytes);
+    *records = (traceRecord_t *)bytes;
+    return byteCount / sizeof(traceRecord_t);
+}
+
+/// <summary>
+///     Decode "TRACE <hex>" lines from the debug output
+/// </summary>
+static size_t decodeLog(const char *text, traceRecord_t **records)
+{
+    size_t count = 0;
+    size_t capacity = TRACE_RING_ENTRIES;
+
+    *records = malloc(capacity * sizeof(traceRecord_t));
+    if (*records == NULL) {
+        return 0;
+    }
+
+    for (const char *line = strstr(text, "TRACE "); line != NULL; line = strstr(line, "TRACE ")) {
+
+        line += strlen("TRACE ");
+
+        uint8_t bytes[sizeof(traceRecord_t)];
+        size_t i;
+        for (i = 0; i < sizeof(traceRecord_t); i++) {
+            int high = hexValue(line[i * 2]);
+            int low = (high < 0) ? -1 : hexValue(line[(i * 2) + 1]);
+            if (low < 0) {
+                break;
+            }
+            bytes[i] = (uint8_t)((high << 4) | low);
+        }
+        if (i != sizeof(traceRecord_t)) {
+            continue;
+        }
+
+        if (count == capacity) {
+            capacity *= 2;
+            traceRecord_t *larger = realloc(*records, capacity * sizeof(traceRecord_t));
+            if (larger == NULL) {
+                break;
+            }
+            *records = larger;
+        }
+        memcpy(&(*records)[count++], bytes, sizeof(traceRecord_t));
+    }
+
+    return count;
+}
+
+static size_t base64Decode(const char *in, size_t inLen, uint8_t *out)
+{
+    uint32_t accumulator = 0;
+    int bits = 0;
+    size_t outLen = 0;
+
+    for (size_t i = 0; i < inLen; i++) {
+        char c = in[i];
+        int value;
+
+        if ((c >= 'A') && (c <= 'Z')) {
+            value = c - 'A';
+        } else if ((c >= 'a') && (c <= 'z')) {
+            value = c - 'a' + 26;
+        } else if ((c >= '0') && (c <= '9')) {
+            value = c - '0' + 52;
+        } else if (c == '+') {
+            value = 62;
+        } else if (c == '/') {
+            value = 63;
+        } else {
+            // Padding or whitespace
+            continue;
+        }
+
+        accumulator = (accumulator << 6) | (uint32_t)value;
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            out[outLen++] = (uint8_t)(accumulator >> bits);
+        }
+    }
+
+    return outLen;
+}
+
+static int hexValue(char c)
+{
+    if (isdigit((unsigned char)c)) {
+        return c - '0';
+    }
+    c = (char)tolower((unsigned char)c);
+    if ((c >= 'a') && (c <= 'f')) {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+/// <summary>
+///     Print one line per record.  The 32 bit microsecond timestamp wraps every ~71 minutes, the
+///     unsigned subtraction handles a single wrap between consecutive records.
+/// </summary>
+static void printTimeline(const traceRecord_t *records, size_t count)
+{
+    double elapsedMs = 0.0;
+
+    printf("%12s %10s %6s  %-18s %s\n", "time(ms)", "delta(ms)", "seq", "event", "arguments");
+
+    for (size_t i = 0; i < count; i++) {
+
+        const traceRecord_t *record = &records[i];
+        double deltaMs = 0.0;
+
+        if (i > 0) {
+            deltaMs = (uint32_t)(record->timestampUs - records[i - 1].timestampUs) / 1000.0;
+            elapsedMs += deltaMs;
+
+            if ((uint16_t)(record->sequence - records[i - 1].sequence) != 1) {
+                printf("   --- %u records missing ---\n",
+                       (uint16_t)(record->sequence - records[i - 1].sequence - 1));
+            }
+        }
+
+        printf("%12.3f %10.3f %6u  ", elapsedMs, deltaMs, record->sequence);
+
+        if (record->eventId >= TRACE_EVT_COUNT) {
+            printf("%-18s id=%u 0x%08x 0x%08x\n", "unknown", record->eventId, record->arg0,
+                   record->arg1);
+            continue;
+        }
+
+        const traceEventName_t *event = &eventNames[record->eventId];
+        printf("%-18s", event->name);
+        if (event->arg0[0] != '\0') {
+            printf(" %s=%d", event->arg0, (int32_t)record->arg0);
+        }
+        if (event->arg1[0] != '\0') {
+            printf(" %s=%d", event->arg1, (int32_t)record->arg1);
+        }
+        printf("\n");
+    }
+}
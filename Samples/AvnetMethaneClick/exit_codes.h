@@ -64,7 +64,11 @@ typedef enum {
     ExitCode_Init_UnexpectedBitCount = 38,
     ExitCode_Init_SetRefVoltage = 39,
     ExitCode_Init_AdcPollTimer = 40,
-    ExitCode_AdcTimerHandler_Poll = 41
+    ExitCode_AdcTimerHandler_Poll = 41,
+
+    // DPS PnP provisioning exit codes
+    ExitCode_Init_DpsPnPTimer = 42,
+    ExitCode_DpsPnPTimer_Consume = 43
 
 
 } ExitCode;
@@ -62,12 +62,12 @@ void parseRsl10Message(char *msgToParse)
     // The battery message is the smallest message we expect, if this message is smaller than that,
     // then exit without doing any processing.
     if(strlen(msgToParse) < MIN_RSL10_MSG_LENGTH){
-        Log_Debug("RSL10 message is not valid, message length = %d, minimum valid length is %d.\n", strlen(msgToParse), MIN_RSL10_MSG_LENGTH);
+        Log_Debug("RSL10 message is not valid, message length = %zu, minimum valid length is %d.\n", strlen(msgToParse), MIN_RSL10_MSG_LENGTH);
         return;
     }
 
     // Variable to hold the message identifier "ESD", "MSD" or "BAT"
-    char messageID[3];
+    char messageID[4];
 
     // Generic message pointer for message ID and BdAddress
     RSL10MessageHeader_t *msgPtr;
@@ -142,11 +142,11 @@ void parseRsl10Message(char *msgToParse)
 }
 
 // Worker routine to convert a string to an integer
-int stringToInt(char *stringData, size_t stringLength)
+int stringToInt(const uint8_t *stringData, size_t stringLength)
 {
 
     char tempString[64];
-    strncpy(tempString, stringData, stringLength);
+    strncpy(tempString, (const char *)stringData, stringLength);
     tempString[stringLength] = '\0';
     return (int)(strtol(tempString, NULL, 16));
 }
@@ -272,10 +272,11 @@ void getBdAddress(char *bdAddress, RSL10MessageHeader_t *rxMessage)
 // Set the global rssi variable from the end of the message
 void getRxRssi(int16_t* rssiVariable, char *rxMessage)
 {
-    char tempRssi[3];
+    char tempRssi[4];
     tempRssi[0] = rxMessage[0];
     tempRssi[1] = rxMessage[1];
     tempRssi[2] = rxMessage[2];
+    tempRssi[3] = '\0';
     *rssiVariable  = (int16_t)atoi(tempRssi);
 }
 
@@ -332,7 +333,7 @@ void getBattery(float *battery, Rsl10BatteryMessage_t *rxMessage){
 void getSensorSettings(RSL10Device_t* currentDevPtr, Rsl10MotionMessage_t* rxMessage){
 
     uint8_t sensorSettings = 0;
-    sensorSettings = (uint8_t)stringToInt((char*)&rxMessage->SensorSetting, 2);
+    sensorSettings = (uint8_t)stringToInt(rxMessage->SensorSetting, 2);
     currentDevPtr->lastsampleRate = sensorSettings >> 4 & 0x0F;
     currentDevPtr->lastAccelRange = sensorSettings >> 2 & 0x03;
     currentDevPtr->lastDataType = sensorSettings & 0x03;
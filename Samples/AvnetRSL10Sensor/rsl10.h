@@ -154,7 +154,7 @@ extern RSL10Device_t Rsl10DeviceList[MAX_RSL10_DEVICES];
 extern char authorizedDeviceList[MAX_RSL10_DEVICES][RSL10_ADDRESS_LEN];
 
 // RSL10 Specific routines
-int stringToInt(char *, size_t);
+int stringToInt(const uint8_t *, size_t);
 void textFromHexString(char *, char *, int);
 void getBdMessageID(char *, RSL10MessageHeader_t *);
 void getBdAddress(char *, RSL10MessageHeader_t *);